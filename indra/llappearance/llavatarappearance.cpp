@@ -1414,6 +1414,26 @@ BOOL LLAvatarAppearance::isValid() const
 }
 
 
+void LLAvatarAppearance::applyMorphs()
+{
+	for (polymesh_map_t::iterator iter = mPolyMeshes.begin(); iter != mPolyMeshes.end(); ++iter)
+	{
+		iter->second->applyMorphs();
+	}
+}
+
+bool LLAvatarAppearance::hasQueuedMorphs() const
+{
+	for (polymesh_map_t::const_iterator iter = mPolyMeshes.begin(); iter != mPolyMeshes.end(); ++iter)
+	{
+		if (iter->second->hasQueuedMorphs())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 // adds a morph mask to the appropriate baked texture structure
 void LLAvatarAppearance::addMaskedMorph(EBakedTextureIndex index, LLVisualParam* morph_target, BOOL invert, std::string layer)
 {
@@ -261,6 +261,13 @@ public:
 protected:
 	virtual void	dirtyMesh(S32 priority) = 0; // Dirty the avatar mesh, with priority
 
+public:
+	// When true, morph targets queue on their meshes until applyMorphs(),
+	// see LLPolyMesh::addMorph()
+	virtual bool	isMorphingDeferred() const { return false; }
+	void			applyMorphs();
+	bool			hasQueuedMorphs() const;
+
 protected:
 	typedef std::multimap<std::string, LLPolyMesh*> polymesh_map_t;
 	polymesh_map_t 									mPolyMeshes;
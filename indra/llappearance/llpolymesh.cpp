@@ -992,6 +992,126 @@ void LLPolyMesh::initializeForMorph()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// addMorph()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::addMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, bool clothing)
+{
+	queueMorph(morph_data, mask_weights, weight, clothing);
+
+	if (!mAvatarp || !mAvatarp->isMorphingDeferred())
+	{
+		applyMorphs();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// queueMorph()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::queueMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, bool clothing)
+{
+	LLQueuedMorph morph;
+	morph.mMorphData = morph_data;
+	morph.mMaskWeights = mask_weights;
+	morph.mWeight = weight;
+	morph.mClothing = clothing;
+	mQueuedMorphs.push_back(morph);
+}
+
+//-----------------------------------------------------------------------------
+// applyMorphs()
+//-----------------------------------------------------------------------------
+static LLTrace::BlockTimerStatHandle FTM_APPLY_MORPHS("Apply Morphs");
+
+void LLPolyMesh::applyMorphs()
+{
+	if (mQueuedMorphs.empty())
+	{
+		return;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_APPLY_MORPHS);
+
+	const U32 num_vertices = mSharedData->mNumVertices;
+	mMorphedVertices.resize(num_vertices);
+	U8* morphed = &mMorphedVertices[0];
+	U32 first = num_vertices;
+	U32 last = 0;
+
+	// The deltas add up in the order the morphs came in, and each vertex's
+	// normal and binormal only depend on the sums, so this comes out the
+	// same as applying the morphs one at a time.
+	for (U32 i = 0; i < mQueuedMorphs.size(); ++i)
+	{
+		const LLQueuedMorph& morph = mQueuedMorphs[i];
+		const LLPolyMorphData* data = morph.mMorphData;
+		const U32* indices = data->mVertexIndices;
+		const LLVector4a* delta_coords = data->mCoords;
+		const LLVector4a* delta_normals = data->mNormals;
+		const LLVector4a* delta_binormals = data->mBinormals;
+		const LLVector2* delta_tex_coords = data->mTexCoords;
+		LLVector4a* clothing_weights = morph.mClothing ? mClothingWeights : NULL;
+
+		for (U32 j = 0; j < data->mNumIndices; ++j)
+		{
+			U32 vert = indices[j];
+			F32 weight = morph.mWeight;
+			F32 mask_weight = morph.mMaskWeights ? morph.mMaskWeights[j] : 1.f;
+			F32 scale = weight * mask_weight;
+
+			LLVector4a t = delta_coords[j];
+			t.mul(scale);
+			mCoords[vert].add(t);
+
+			if (clothing_weights)
+			{
+				LLVector4a* clothing_weight = &clothing_weights[vert];
+				clothing_weight->add(t);
+				clothing_weight->getF32ptr()[VW] = mask_weight;
+			}
+
+			t = delta_normals[j];
+			t.mul(scale * NORMAL_SOFTEN_FACTOR);
+			mScaledNormals[vert].add(t);
+
+			// guard against degenerate input data before we create NaNs
+			t = delta_binormals[j];
+			if (!t.isFinite3() || (t.dot3(t).getF32() <= F_APPROXIMATELY_ZERO))
+			{
+				t.set(1, 0, 0, 1);
+			}
+			t.mul(scale * NORMAL_SOFTEN_FACTOR);
+			mScaledBinormals[vert].add(t);
+
+			mTexCoords[vert] += delta_tex_coords[j] * weight * mask_weight;
+
+			morphed[vert] = 1;
+			first = llmin(first, vert);
+			last = llmax(last, vert);
+		}
+	}
+	mQueuedMorphs.clear();
+
+	// normals based on half angles
+	for (U32 vert = first; vert <= last && vert < num_vertices; ++vert)
+	{
+		if (!morphed[vert])
+		{
+			continue;
+		}
+		morphed[vert] = 0;
+
+		LLVector4a norm = mScaledNormals[vert];
+		norm.normalize3fast();
+		mNormals[vert] = norm;
+
+		LLVector4a tangent;
+		tangent.setCross3(mScaledBinormals[vert], norm);
+		mBinormals[vert].setCross3(norm, tangent);
+		mBinormals[vert].normalize3fast();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // getMorphData()
 //-----------------------------------------------------------------------------
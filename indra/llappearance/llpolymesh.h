@@ -128,10 +128,10 @@ private:
 	// Retrieve the number of KB of memory used by this instance
 	U32 getNumKB();
 
+public:
 	// Load mesh data from file
 	BOOL loadMesh( const std::string& fileName );
 
-public:
 	void genIndices(S32 offset);
 
 	const LLVector2 &getUVs(U32 index);
@@ -281,6 +281,20 @@ public:
 		return mClothingWeights;	
 	}
 
+	//--------------------------------------------------------------------
+	// Morphing
+	//--------------------------------------------------------------------
+	// Morph targets add their deltas with addMorph(), which applies them
+	// at once unless the avatar defers morphing, see
+	// LLAvatarAppearance::isMorphingDeferred().  Then they queue up until
+	// applyMorphs() adds them all in one pass, renormalizing each vertex
+	// they touch once rather than once per morph.
+	void	addMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, bool clothing);
+	// queues whatever the avatar does
+	void	queueMorph(LLPolyMorphData* morph_data, const F32* mask_weights, F32 weight, bool clothing);
+	void	applyMorphs();
+	bool	hasQueuedMorphs() const		{ return !mQueuedMorphs.empty(); }
+
 	//--------------------------------------------------------------------
 	// Face Data Access
 	//--------------------------------------------------------------------
@@ -356,6 +370,17 @@ protected:
 	
 	LLPolyMesh				*mReferenceMesh;
 
+	struct LLQueuedMorph
+	{
+		LLPolyMorphData*	mMorphData;
+		const F32*			mMaskWeights;
+		F32					mWeight;
+		bool				mClothing;
+	};
+	std::vector<LLQueuedMorph>	mQueuedMorphs;
+	// per vertex, set while applyMorphs() has it to renormalize
+	std::vector<U8>				mMorphedVertices;
+
 	// global mesh list
 	typedef std::map<std::string, LLPolyMeshSharedData*> LLPolyMeshSharedDataTable; 
 	static LLPolyMeshSharedDataTable sGlobalSharedMeshList;
@@ -38,6 +38,9 @@ class LLVector2;
 class LLAvatarJointCollisionVolume;
 class LLWearable;
 
+// share of a morph's normal and binormal deltas that is applied
+const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
+
 //-----------------------------------------------------------------------------
 // LLPolyMorphData()
 //-----------------------------------------------------------------------------
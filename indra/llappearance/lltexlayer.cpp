@@ -464,6 +464,79 @@ BOOL LLTexLayerSet::render( S32 x, S32 y, S32 width, S32 height )
 }
 
 
+// The same walk as render(), into a painter instead of GL
+BOOL LLTexLayerSet::paint(LLTexLayerPainter& painter)
+{
+	BOOL success = TRUE;
+	mIsVisible = TRUE;
+
+	if (mMaskLayerList.size() > 0)
+	{
+		for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+		{
+			LLTexLayerInterface* layer = *iter;
+			if (layer->isInvisibleAlphaMask())
+			{
+				mIsVisible = FALSE;
+			}
+		}
+	}
+
+	painter.setColorMask(true, true);
+	painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+
+	// clear buffer area to ensure we don't pick up UI elements
+	painter.setMinimumAlpha(0.f);
+	painter.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+	painter.fill();
+	painter.setMinimumAlpha(0.004f);
+
+	if (mIsVisible)
+	{
+		// composite color layers
+		for( layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++ )
+		{
+			LLTexLayerInterface* layer = *iter;
+			if (layer->getRenderPass() == LLTexLayer::RP_COLOR)
+			{
+				success &= layer->paint(painter);
+			}
+		}
+		
+		paintAlphaMasks(painter, false);
+	}
+	else
+	{
+		painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+		painter.setMinimumAlpha(0.f);
+		painter.setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+		painter.fill();
+		painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+		painter.setMinimumAlpha(0.004f);
+	}
+
+	return success;
+}
+
+BOOL LLTexLayerSet::hasLayer(const LLTexLayer* layer) const
+{
+	for (layer_list_t::const_iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+	{
+		const LLTexLayerInterface* layer_interface = *iter;
+		if (layer_interface == layer)
+		{
+			return TRUE;
+		}
+		const LLTexLayerTemplate* layer_template = dynamic_cast<const LLTexLayerTemplate*>(layer_interface);
+		if (layer_template && layer_template->hasLayer(layer))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+
 BOOL LLTexLayerSet::isBodyRegion(const std::string& region) const 
 { 
 	return mInfo->mBodyRegion == region; 
@@ -609,6 +682,46 @@ void LLTexLayerSet::renderAlphaMaskTextures(S32 x, S32 y, S32 width, S32 height,
 	gGL.setSceneBlendType(LLRender::BT_ALPHA);
 }
 
+void LLTexLayerSet::paintAlphaMasks(LLTexLayerPainter& painter, bool forceClear)
+{
+	LL_RECORD_BLOCK_TIME(FTM_RENDER_ALPHA_MASK_TEXTURES);
+	const LLTexLayerSetInfo *info = getInfo();
+	
+	painter.setColorMask(false, true);
+	painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+	painter.setTextureReplace(true);
+	
+	// (Optionally) replace alpha with a single component image from a tga file.
+	if (!info->mStaticAlphaFileName.empty())
+	{
+		painter.drawStaticImage(info->mStaticAlphaFileName, TRUE);
+	}
+	else if (forceClear || info->mClearAlpha || (mMaskLayerList.size() > 0))
+	{
+		// Set the alpha channel to one (clean up after previous blending)
+		painter.setMinimumAlpha(0.f);
+		painter.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+		painter.fill();
+		painter.setMinimumAlpha(0.004f);
+	}
+	
+	// (Optional) Mask out part of the baked texture with alpha masks
+	// will still have an effect even if mClearAlpha is set or the alpha component was replaced
+	if (mMaskLayerList.size() > 0)
+	{
+		painter.setBlend(LLImageCompositor::BLEND_MULT_DEST_ALPHA);
+		for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+		{
+			LLTexLayerInterface* layer = *iter;
+			layer->paintAlphaTexture(painter);
+		}
+	}
+	
+	painter.setTextureReplace(false);
+	painter.setColorMask(true, true);
+	painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+}
+
 void LLTexLayerSet::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components)
 {
 	mAvatarAppearance->applyMorphMask(tex_data, width, height, num_components, mBakedTexIndex);
@@ -1306,7 +1419,129 @@ BOOL LLTexLayer::render(S32 x, S32 y, S32 width, S32 height)
 	return success;
 }
 
-const U8*	LLTexLayer::getAlphaData() const
+BOOL LLTexLayer::paint(LLTexLayerPainter& painter)
+{
+	LLColor4 net_color;
+	BOOL color_specified = findNetColor(&net_color);
+	
+	if (mTexLayerSet->getAvatarAppearance()->mIsDummy)
+	{
+		color_specified = true;
+		net_color = LLAvatarAppearance::getDummyColor();
+	}
+
+	BOOL success = TRUE;
+	
+	// If you can't see the layer, don't render it.
+	if( is_approx_zero( net_color.mV[VW] ) )
+	{
+		return success;
+	}
+
+	BOOL alpha_mask_specified = FALSE;
+	param_alpha_list_t::const_iterator iter = mParamAlphaList.begin();
+	if( iter != mParamAlphaList.end() )
+	{
+		// If we have alpha masks, but we're skipping all of them, skip the whole layer.
+		// However, we can't do this optimization if we have morph masks that need updating.
+/*		if (!mHasMorph)
+		{
+			BOOL skip_layer = TRUE;
+
+			while( iter != mParamAlphaList.end() )
+			{
+				const LLTexLayerParamAlpha* param = *iter;
+		
+				if( !param->getSkip() )
+				{
+					skip_layer = FALSE;
+					break;
+				}
+
+				iter++;
+			} 
+
+			if( skip_layer )
+			{
+				return success;
+			}
+		}//*/
+
+		const bool force_render = true;
+		paintMorphMasks(painter, net_color, force_render);
+		alpha_mask_specified = TRUE;
+		painter.setBlend(LLImageCompositor::BLEND_DEST_ALPHA);
+	}
+
+	painter.setColor(net_color);
+
+	if( getInfo()->mWriteAllChannels )
+	{
+		painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+	}
+
+	if( (getInfo()->mLocalTexture != -1) && !getInfo()->mUseLocalTextureAlphaOnly )
+	{
+		LLGLTexture* tex = NULL;
+		if (mLocalTextureObject && mLocalTextureObject->getImage())
+		{
+			tex = mLocalTextureObject->getImage();
+			if (mLocalTextureObject->getID() == IMG_DEFAULT_AVATAR)
+			{
+				tex = NULL;
+			}
+		}
+		else
+		{
+			LL_INFOS() << "lto not defined or image not defined: " << getInfo()->getLocalTexture() << " lto: " << mLocalTextureObject << LL_ENDL;
+		}
+		if( tex )
+		{
+			bool no_alpha_test = getInfo()->mWriteAllChannels;
+			if (no_alpha_test)
+			{
+				painter.setMinimumAlpha(0.f);
+			}
+
+			success &= painter.drawTexture(tex, true);
+
+			if (no_alpha_test)
+			{
+				painter.setMinimumAlpha(0.004f);
+			}
+		}
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		success &= painter.drawStaticImage(getInfo()->mStaticImageFileName, getInfo()->mStaticImageIsMask);
+	}
+
+	if(((-1 == getInfo()->mLocalTexture) ||
+		 getInfo()->mUseLocalTextureAlphaOnly) &&
+		getInfo()->mStaticImageFileName.empty() &&
+		color_specified )
+	{
+		painter.setMinimumAlpha(0.f);
+		painter.setColor(net_color);
+		painter.fill();
+		painter.setMinimumAlpha(0.004f);
+	}
+
+	if( alpha_mask_specified || getInfo()->mWriteAllChannels )
+	{
+		// Restore standard blend func value
+		painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+	}
+
+	if( !success )
+	{
+		LL_INFOS() << "LLTexLayer::render() partial: " << getInfo()->mName << LL_ENDL;
+	}
+	return success;
+}
+
+U32 LLTexLayer::getAlphaCacheIndex() const
 {
 	LLCRC alpha_mask_crc;
 	const LLUUID& uuid = getUUID();
@@ -1320,9 +1555,12 @@ const U8*	LLTexLayer::getAlphaData() const
 		alpha_mask_crc.update((U8*)&param_weight, sizeof(F32));
 	}
 
-	U32 cache_index = alpha_mask_crc.getCRC();
+	return alpha_mask_crc.getCRC();
+}
 
-	alpha_cache_t::const_iterator iter2 = mAlphaCache.find(cache_index);
+const U8*	LLTexLayer::getAlphaData() const
+{
+	alpha_cache_t::const_iterator iter2 = mAlphaCache.find(getAlphaCacheIndex());
 	return (iter2 == mAlphaCache.end()) ? 0 : iter2->second;
 }
 
@@ -1428,6 +1666,31 @@ BOOL LLTexLayer::blendAlphaTexture(S32 x, S32 y, S32 width, S32 height)
 	return success;
 }
 
+BOOL LLTexLayer::paintAlphaTexture(LLTexLayerPainter& painter)
+{
+	BOOL success = TRUE;
+
+	painter.setMinimumAlpha(0.f);
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		success = painter.drawStaticImage(getInfo()->mStaticImageFileName, getInfo()->mStaticImageIsMask);
+	}
+	else
+	{
+		if (getInfo()->mLocalTexture >=0 && getInfo()->mLocalTexture < TEX_NUM_INDICES)
+		{
+			LLGLTexture* tex = mLocalTextureObject->getImage();
+			if (tex)
+			{
+				success = painter.drawTexture(tex, false);
+			}
+		}
+	}
+	painter.setMinimumAlpha(0.004f);
+	
+	return success;
+}
+
 /*virtual*/ void LLTexLayer::gatherAlphaMasks(U8 *data, S32 originX, S32 originY, S32 width, S32 height)
 {
 	addAlphaMask(data, originX, originY, width, height);
@@ -1591,6 +1854,98 @@ void LLTexLayer::renderMorphMasks(S32 x, S32 y, S32 width, S32 height, const LLC
 	}
 }
 
+void LLTexLayer::paintMorphMasks(LLTexLayerPainter& painter, const LLColor4 &layer_color, bool force_render)
+{
+	if (!force_render && !hasMorph())
+	{
+		LL_DEBUGS() << "skipping renderMorphMasks for " << getUUID() << LL_ENDL;
+		return;
+	}
+	LL_RECORD_BLOCK_TIME(FTM_RENDER_MORPH_MASKS);
+	BOOL success = TRUE;
+
+	llassert( !mParamAlphaList.empty() );
+
+	painter.setMinimumAlpha(0.f);
+	painter.setColorMask(false, true);
+
+	LLTexLayerParamAlpha* first_param = *mParamAlphaList.begin();
+	// Note: if the first param is a mulitply, multiply against the current buffer's alpha
+	if( !first_param || !first_param->getMultiplyBlend() )
+	{
+		// Clear the alpha
+		painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+		painter.setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+		painter.fill();
+	}
+
+	// Accumulate alphas
+	painter.setColor(LLColor4(1.f, 1.f, 1.f, 1.f));
+	for (param_alpha_list_t::iterator iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++)
+	{
+		LLTexLayerParamAlpha* param = *iter;
+		success &= param->paint(painter);
+		if (!success && !force_render)
+		{
+			LL_DEBUGS() << "Failed to render param " << param->getID() << " ; skipping morph mask." << LL_ENDL;
+			return;
+		}
+	}
+
+	// Approximates a min() function
+	painter.setBlend(LLImageCompositor::BLEND_MULT_DEST_ALPHA);
+
+	// Accumulate the alpha component of the texture
+	if( getInfo()->mLocalTexture != -1 )
+	{
+		LLGLTexture* tex = mLocalTextureObject->getImage();
+		if( tex && (tex->getComponents() == 4) )
+		{
+			success &= painter.drawTexture(tex, true);
+		}
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() && getInfo()->mStaticImageIsMask )
+	{
+		const bool need_alpha = true;
+		painter.drawStaticImage(getInfo()->mStaticImageFileName, getInfo()->mStaticImageIsMask, need_alpha);
+	}
+
+	// Draw a rectangle with the layer color to multiply the alpha by that color's alpha.
+	// Note: we're still using gGL.blendFunc( GL_DST_ALPHA, GL_ZERO );
+	if ( !is_approx_equal(layer_color.mV[VW], 1.f) )
+	{
+		painter.setColor(layer_color);
+		painter.fill();
+	}
+
+	painter.setMinimumAlpha(0.004f);
+	painter.setColorMask(true, true);
+	
+	if (hasMorph() && success)
+	{
+		painter.captureMorphMask(this, getAlphaCacheIndex());
+	}
+}
+
+void LLTexLayer::setMorphMask(U32 cache_index, U8* alpha_data, S32 width, S32 height)
+{
+	// clear out a slot if we have filled our cache
+	S32 max_cache_entries = getTexLayerSet()->getAvatarAppearance()->isSelf() ? 4 : 1;
+	while ((S32)mAlphaCache.size() >= max_cache_entries)
+	{
+		alpha_cache_t::iterator iter2 = mAlphaCache.begin(); // arbitrarily grab the first entry
+		delete [] iter2->second;
+		mAlphaCache.erase(iter2);
+	}
+	mAlphaCache[cache_index] = alpha_data;
+
+	getTexLayerSet()->getAvatarAppearance()->dirtyMesh();
+
+	mMorphMasksValid = TRUE;
+	getTexLayerSet()->applyMorphMask(alpha_data, width, height, 1);
+}
+
 static LLTrace::BlockTimerStatHandle FTM_ADD_ALPHA_MASK("addAlphaMask");
 void LLTexLayer::addAlphaMask(U8 *data, S32 originX, S32 originY, S32 width, S32 height)
 {
@@ -1772,6 +2127,40 @@ LLTexLayer* LLTexLayerTemplate::getLayer(U32 i) const
 	return success;
 }
 
+/*virtual*/ BOOL LLTexLayerTemplate::paint(LLTexLayerPainter& painter)
+{
+	if(!mInfo)
+	{
+		return FALSE ;
+	}
+
+	BOOL success = TRUE;
+	updateWearableCache();
+	for (wearable_cache_t::const_iterator iter = mWearableCache.begin(); iter!= mWearableCache.end(); iter++)
+	{
+		LLWearable* wearable = NULL;
+		LLLocalTextureObject *lto = NULL;
+		LLTexLayer *layer = NULL;
+		wearable = *iter;
+		if (wearable)
+		{
+			lto = wearable->getLocalTextureObject(mInfo->mLocalTexture);
+		}
+		if (lto)
+		{
+			layer = lto->getTexLayer(getName());
+		}
+		if (layer)
+		{
+			wearable->writeToAvatar(mAvatarAppearance);
+			layer->setLTO(lto);
+			success &= layer->paint(painter);
+		}
+	}
+
+	return success;
+}
+
 /*virtual*/ BOOL LLTexLayerTemplate::blendAlphaTexture( S32 x, S32 y, S32 width, S32 height) // Multiplies a single alpha texture against the frame buffer
 {
 	BOOL success = TRUE;
@@ -1787,6 +2176,34 @@ LLTexLayer* LLTexLayerTemplate::getLayer(U32 i) const
 	return success;
 }
 
+/*virtual*/ BOOL LLTexLayerTemplate::paintAlphaTexture(LLTexLayerPainter& painter)
+{
+	BOOL success = TRUE;
+	U32 num_wearables = updateWearableCache();
+	for (U32 i = 0; i < num_wearables; i++)
+	{
+		LLTexLayer *layer = getLayer(i);
+		if (layer)
+		{
+			success &= layer->paintAlphaTexture(painter);
+		}
+	}
+	return success;
+}
+
+BOOL LLTexLayerTemplate::hasLayer(const LLTexLayer* layer) const
+{
+	U32 num_wearables = updateWearableCache();
+	for (U32 i = 0; i < num_wearables; i++)
+	{
+		if (getLayer(i) == layer)
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /*virtual*/ void LLTexLayerTemplate::gatherAlphaMasks(U8 *data, S32 originX, S32 originY, S32 width, S32 height)
 {
 	U32 num_wearables = updateWearableCache();
@@ -1895,6 +2312,7 @@ void LLTexLayerSet::cloneTemplates(LLLocalTextureObject *lto, LLAvatarAppearance
 LLTexLayerStaticImageList::LLTexLayerStaticImageList() :
 	mGLBytes(0),
 	mTGABytes(0),
+	mRawBytes(0),
 	mImageNames(16384)
 {
 }
@@ -1908,24 +2326,29 @@ void LLTexLayerStaticImageList::dumpByteCount() const
 {
 	LL_INFOS() << "Avatar Static Textures " <<
 		"KB GL:" << (mGLBytes / 1024) <<
-		"KB TGA:" << (mTGABytes / 1024) << "KB" << LL_ENDL;
+		"KB TGA:" << (mTGABytes / 1024) <<
+		"KB Raw:" << (mRawBytes / 1024) << "KB" << LL_ENDL;
 }
 
 void LLTexLayerStaticImageList::deleteCachedImages()
 {
-	if( mGLBytes || mTGABytes )
+	if( mGLBytes || mTGABytes || mRawBytes )
 	{
 		LL_INFOS() << "Clearing Static Textures " <<
 			"KB GL:" << (mGLBytes / 1024) <<
-			"KB TGA:" << (mTGABytes / 1024) << "KB" << LL_ENDL;
+			"KB TGA:" << (mTGABytes / 1024) <<
+			"KB Raw:" << (mRawBytes / 1024) << "KB" << LL_ENDL;
 
 		//mStaticImageLists uses LLPointers, clear() will cause deletion
 		
 		mStaticImageListTGA.clear();
 		mStaticImageList.clear();
+		mStaticImageListRaw.clear();
+		mStaticMaskListRaw.clear();
 		
 		mGLBytes = 0;
 		mTGABytes = 0;
+		mRawBytes = 0;
 	}
 }
 
@@ -2013,6 +2436,36 @@ LLGLTexture* LLTexLayerStaticImageList::getTexture(const std::string& file_name,
 	return tex;
 }
 
+// Returns the decoded data of a tga file named file_name, grayscale masks
+// expanded to RGBA the way getTexture() does.  Caches the result.
+static LLTrace::BlockTimerStatHandle FTM_LOAD_STATIC_RAW("getImageRaw");
+LLImageRaw* LLTexLayerStaticImageList::getImageRaw(const std::string& file_name, BOOL is_mask)
+{
+	LL_RECORD_BLOCK_TIME(FTM_LOAD_STATIC_RAW);
+	const char *namekey = mImageNames.addString(file_name);
+	image_raw_map_t& image_list = is_mask ? mStaticMaskListRaw : mStaticImageListRaw;
+	image_raw_map_t::const_iterator iter = image_list.find(namekey);
+	if (iter != image_list.end())
+	{
+		return iter->second;
+	}
+
+	LLPointer<LLImageRaw> image_raw = new LLImageRaw;
+	if (!loadImageRaw(file_name, image_raw))
+	{
+		return NULL;
+	}
+	if ((image_raw->getComponents() == 1) && is_mask)
+	{
+		LLPointer<LLImageRaw> alpha_image_raw = image_raw;
+		image_raw = new LLImageRaw(image_raw->getWidth(), image_raw->getHeight(), 4);
+		image_raw->copyUnscaledAlphaMask(alpha_image_raw, LLColor4U::black);
+	}
+	image_list[namekey] = image_raw;
+	mRawBytes += image_raw->getDataSize();
+	return image_raw;
+}
+
 // Reads a .tga file, decodes it, and puts the decoded data in image_raw.
 // Returns TRUE if successful.
 static LLTrace::BlockTimerStatHandle FTM_LOAD_IMAGE_RAW("loadImageRaw");
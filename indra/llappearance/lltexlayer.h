@@ -31,6 +31,7 @@
 #include "llglslshader.h"
 #include "llgltexture.h"
 #include "llavatarappearancedefines.h"
+#include "llimagecompositor.h"
 #include "lltexlayerparams.h"
 
 class LLAvatarAppearance;
@@ -42,9 +43,45 @@ class LLTexLayerSet;
 class LLTexLayerSetInfo;
 class LLTexLayerInfo;
 class LLTexLayerSetBuffer;
+class LLTexLayer;
 class LLWearable;
 class LLViewerVisualParam;
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// LLTexLayerPainter
+//
+// What a layer set paints into when it is baked on the CPU, as
+// LLTexLayerSetComposite does.  The calls mirror the GL state changes and
+// draws render() makes, which all cover the whole bake.  The blends are
+// named the way LLImageCompositor names them.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLTexLayerPainter
+{
+public:
+	virtual ~LLTexLayerPainter() {}
+
+	// like gGL's, the color tints whatever is drawn until it changes
+	virtual void			setColor(const LLColor4& color) = 0;
+	virtual void			setColorMask(bool color, bool alpha) = 0;
+	virtual void			setBlend(LLImageCompositor::EBlend blend) = 0;
+	// the alpha mask shader's, 0 draws everything
+	virtual void			setMinimumAlpha(F32 alpha) = 0;
+	// textures replace the color instead of being tinted by it, which
+	// only fixed function GL does
+	virtual void			setTextureReplace(bool replace) = 0;
+
+	virtual void			fill() = 0;
+	// FALSE if tex can't be drawn yet
+	virtual BOOL			drawTexture(LLGLTexture* tex, bool clamp) = 0;
+	// FALSE if the image can't be loaded.  need_alpha skips, with a
+	// warning, images with neither 1 nor 4 components.
+	virtual BOOL			drawStaticImage(const std::string& file_name, BOOL is_mask, bool need_alpha = false) = 0;
+	// param's static image, processed for its weight
+	virtual void			drawAlphaParam(LLTexLayerParamAlpha* param) = 0;
+	// the alpha at this point becomes layer's morph mask
+	virtual void			captureMorphMask(LLTexLayer* layer, U32 cache_index) = 0;
+};
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // LLTexLayerInterface
 //
@@ -68,6 +105,9 @@ public:
 	virtual BOOL			render(S32 x, S32 y, S32 width, S32 height) = 0;
 	virtual void			deleteCaches() = 0;
 	virtual BOOL			blendAlphaTexture(S32 x, S32 y, S32 width, S32 height) = 0;
+	// render() and blendAlphaTexture() for the CPU
+	virtual BOOL			paint(LLTexLayerPainter& painter) = 0;
+	virtual BOOL			paintAlphaTexture(LLTexLayerPainter& painter) = 0;
 	virtual BOOL			isInvisibleAlphaMask() const = 0;
 
 	const LLTexLayerInfo* 	getInfo() const 			{ return mInfo; }
@@ -124,10 +164,13 @@ public:
 	/*virtual*/ BOOL		render(S32 x, S32 y, S32 width, S32 height);
 	/*virtual*/ BOOL		setInfo(const LLTexLayerInfo *info, LLWearable* wearable); // This sets mInfo and calls initialization functions
 	/*virtual*/ BOOL		blendAlphaTexture(S32 x, S32 y, S32 width, S32 height); // Multiplies a single alpha texture against the frame buffer
+	/*virtual*/ BOOL		paint(LLTexLayerPainter& painter);
+	/*virtual*/ BOOL		paintAlphaTexture(LLTexLayerPainter& painter);
 	/*virtual*/ void		gatherAlphaMasks(U8 *data, S32 originX, S32 originY, S32 width, S32 height);
 	/*virtual*/ void		setHasMorph(BOOL newval);
 	/*virtual*/ void		deleteCaches();
 	/*virtual*/ BOOL		isInvisibleAlphaMask() const;
+	BOOL					hasLayer(const LLTexLayer* layer) const;
 protected:
 	U32 					updateWearableCache() const;
 	LLTexLayer* 			getLayer(U32 i) const;
@@ -153,16 +196,21 @@ public:
 
 	/*virtual*/ BOOL		setInfo(const LLTexLayerInfo *info, LLWearable* wearable); // This sets mInfo and calls initialization functions
 	/*virtual*/ BOOL		render(S32 x, S32 y, S32 width, S32 height);
+	/*virtual*/ BOOL		paint(LLTexLayerPainter& painter);
 
 	/*virtual*/ void		deleteCaches();
 	const U8*				getAlphaData() const;
 
 	BOOL					findNetColor(LLColor4* color) const;
 	/*virtual*/ BOOL		blendAlphaTexture(S32 x, S32 y, S32 width, S32 height); // Multiplies a single alpha texture against the frame buffer
+	/*virtual*/ BOOL		paintAlphaTexture(LLTexLayerPainter& painter);
 	/*virtual*/ void		gatherAlphaMasks(U8 *data, S32 originX, S32 originY, S32 width, S32 height);
 	void					renderMorphMasks(S32 x, S32 y, S32 width, S32 height, const LLColor4 &layer_color, bool force_render);
+	void					paintMorphMasks(LLTexLayerPainter& painter, const LLColor4 &layer_color, bool force_render);
 	void					addAlphaMask(U8 *data, S32 originX, S32 originY, S32 width, S32 height);
 	/*virtual*/ BOOL		isInvisibleAlphaMask() const;
+	// caches alpha_data, which it takes, and applies it as the morph mask
+	void					setMorphMask(U32 cache_index, U8* alpha_data, S32 width, S32 height);
 
 	void					setLTO(LLLocalTextureObject *lto) 	{ mLocalTextureObject = lto; }
 	LLLocalTextureObject* 	getLTO() 							{ return mLocalTextureObject; }
@@ -172,6 +220,7 @@ public:
 	static void 			calculateTexLayerColor(const param_color_list_t &param_list, LLColor4 &net_color);
 protected:
 	LLUUID					getUUID() const;
+	U32						getAlphaCacheIndex() const;
 	typedef std::map<U32, U8*> alpha_cache_t;
 	alpha_cache_t			mAlphaCache;
 	LLLocalTextureObject* 	mLocalTextureObject;
@@ -200,7 +249,9 @@ public:
 	BOOL						setInfo(const LLTexLayerSetInfo *info); // This sets mInfo and calls initialization functions
 
 	BOOL						render(S32 x, S32 y, S32 width, S32 height);
+	BOOL						paint(LLTexLayerPainter& painter);
 	void						renderAlphaMaskTextures(S32 x, S32 y, S32 width, S32 height, bool forceClear = false);
+	BOOL						hasLayer(const LLTexLayer* layer) const;
 
 	BOOL						isBodyRegion(const std::string& region) const;
 	void						applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components);
@@ -232,6 +283,9 @@ protected:
 
 	LLAvatarAppearanceDefines::EBakedTextureIndex mBakedTexIndex;
 	const LLTexLayerSetInfo* 	mInfo;
+
+private:
+	void						paintAlphaMasks(LLTexLayerPainter& painter, bool forceClear);
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -297,6 +351,8 @@ public:
 	LLTexLayerStaticImageList();
 	~LLTexLayerStaticImageList();
 	LLGLTexture*		getTexture(const std::string& file_name, BOOL is_mask);
+	// the decoded image getTexture() makes its texture from
+	LLImageRaw*			getImageRaw(const std::string& file_name, BOOL is_mask);
 	LLImageTGA*			getImageTGA(const std::string& file_name);
 	void				deleteCachedImages();
 	void				dumpByteCount() const;
@@ -308,8 +364,12 @@ private:
 	texture_map_t 		mStaticImageList;
 	typedef std::map<const char*, LLPointer<LLImageTGA> > image_tga_map_t;
 	image_tga_map_t 	mStaticImageListTGA;
+	typedef std::map<const char*, LLPointer<LLImageRaw> > image_raw_map_t;
+	image_raw_map_t 	mStaticImageListRaw;
+	image_raw_map_t 	mStaticMaskListRaw;
 	S32 				mGLBytes;
 	S32 				mTGABytes;
+	S32 				mRawBytes;
 };
 
 #endif  // LL_LLTEXLAYER_H
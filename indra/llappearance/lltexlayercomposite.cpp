@@ -0,0 +1,268 @@
+/**
+ * @file lltexlayercomposite.cpp
+ * @brief LLTexLayerSetComposite class, a layer set bake done on the CPU.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltexlayercomposite.h"
+
+#include "llfasttimer.h"
+#include "llimage.h"
+#include "llqueuedthread.h"
+#include "lltexlayer.h"
+#include "lltexlayerparams.h"
+#include "lltexturemanagerbridge.h"
+
+//-----------------------------------------------------------------------------
+// LLTexLayerCompositeThread
+//-----------------------------------------------------------------------------
+
+class LLTexLayerCompositeThread : public LLQueuedThread
+{
+public:
+	class CompositeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~CompositeRequest() {}	// use deleteRequest()
+
+	public:
+		CompositeRequest(handle_t handle, LLTexLayerSetComposite* composite)
+		:	LLQueuedThread::QueuedRequest(handle, PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+			mComposite(composite)
+		{
+		}
+
+		// for one that never got queued
+		void discard()
+		{
+			deleteRequest();
+		}
+
+		/*virtual*/ bool processRequest()
+		{
+			mComposite->render();
+			return true;
+		}
+
+	private:
+		LLPointer<LLTexLayerSetComposite> mComposite;
+	};
+
+	LLTexLayerCompositeThread()
+	:	LLQueuedThread("texlayer composite")
+	{
+	}
+
+	bool composite(LLTexLayerSetComposite* composite)
+	{
+		CompositeRequest* req = new CompositeRequest(generateHandle(), composite);
+		if (!addRequest(req))
+		{
+			req->discard();
+			return false;
+		}
+		return true;
+	}
+};
+
+// only touched on the main thread
+static std::vector<LLTexLayerCompositeThread*> sCompositeThreads;
+
+//-----------------------------------------------------------------------------
+// LLTexLayerSetComposite
+//-----------------------------------------------------------------------------
+
+LLTexLayerSetComposite::LLTexLayerSetComposite(S32 width, S32 height)
+:	mCompositor(width, height),
+	mImage(new LLImageRaw(width, height, 4)),
+	mColor(255, 255, 255, 255),
+	mDone(0)
+{
+}
+
+LLTexLayerSetComposite::~LLTexLayerSetComposite()
+{
+}
+
+void LLTexLayerSetComposite::setColor(const LLColor4& color)
+{
+	// the way gGL.color4f() takes it to 8 bits
+	mColor.set((U8) (llclamp(color.mV[VRED], 0.f, 1.f) * 255),
+			   (U8) (llclamp(color.mV[VGREEN], 0.f, 1.f) * 255),
+			   (U8) (llclamp(color.mV[VBLUE], 0.f, 1.f) * 255),
+			   (U8) (llclamp(color.mV[VALPHA], 0.f, 1.f) * 255));
+}
+
+void LLTexLayerSetComposite::fill()
+{
+	mCompositor.fill(mColor);
+}
+
+void LLTexLayerSetComposite::draw(LLImageRaw* image)
+{
+	if (image && image->getData())
+	{
+		mSources.push_back(image);
+		mCompositor.draw(image->getData(), image->getWidth(), image->getHeight(), image->getComponents(), mColor);
+	}
+}
+
+BOOL LLTexLayerSetComposite::drawTexture(LLGLTexture* tex, bool clamp)
+{
+	llassert(gTextureManagerBridgep);
+	LLImageRaw* image = gTextureManagerBridgep->getRawImage(tex);
+	if (!image)
+	{
+		return FALSE;
+	}
+	mRawImageIDs.push_back(tex->getID());
+	draw(image);
+	return TRUE;
+}
+
+BOOL LLTexLayerSetComposite::drawStaticImage(const std::string& file_name, BOOL is_mask, bool need_alpha)
+{
+	LLImageRaw* image = LLTexLayerStaticImageList::getInstance()->getImageRaw(file_name, is_mask);
+	if (!image)
+	{
+		return FALSE;
+	}
+	if (need_alpha && (image->getComponents() != 4) && (image->getComponents() != 1))
+	{
+		LL_WARNS() << "Skipping rendering of " << file_name
+				<< "; expected 1 or 4 components." << LL_ENDL;
+		return TRUE;
+	}
+	draw(image);
+	return TRUE;
+}
+
+void LLTexLayerSetComposite::drawAlphaParam(LLTexLayerParamAlpha* param)
+{
+	draw(param->getProcessedImage());
+}
+
+void LLTexLayerSetComposite::captureMorphMask(LLTexLayer* layer, U32 cache_index)
+{
+	MorphMask mask;
+	mask.mLayer = layer;
+	mask.mCacheIndex = cache_index;
+	mask.mCapture = mCompositor.captureAlpha();
+	mMorphMasks.push_back(mask);
+}
+
+void LLTexLayerSetComposite::post()
+{
+	if (!sCompositeThreads.empty())
+	{
+		LLTexLayerCompositeThread* thread = sCompositeThreads[0];
+		S32 pending = thread->getPending();
+		for (U32 i = 1; i < sCompositeThreads.size() && pending > 0; ++i)
+		{
+			S32 count = sCompositeThreads[i]->getPending();
+			if (count < pending)
+			{
+				thread = sCompositeThreads[i];
+				pending = count;
+			}
+		}
+		if (thread->composite(this))
+		{
+			return;
+		}
+	}
+	render();
+}
+
+static LLTrace::BlockTimerStatHandle FTM_RENDER_TEX_LAYER_COMPOSITE("Render Tex Layer Composite");
+
+void LLTexLayerSetComposite::render()
+{
+	LL_RECORD_BLOCK_TIME(FTM_RENDER_TEX_LAYER_COMPOSITE);
+	mCompositor.render(mImage->getData());
+	mDone = 1;
+}
+
+void LLTexLayerSetComposite::finish(LLTexLayerSet* layer_set)
+{
+	llassert(isDone());
+	const S32 width = mCompositor.getWidth();
+	const S32 height = mCompositor.getHeight();
+	for (U32 i = 0; i < mMorphMasks.size(); ++i)
+	{
+		const MorphMask& mask = mMorphMasks[i];
+		const U8* alpha = mCompositor.getCapturedAlpha(mask.mCapture);
+		if (alpha && layer_set->hasLayer(mask.mLayer))
+		{
+			U8* alpha_data = new U8[width * height];
+			memcpy(alpha_data, alpha, width * height);
+			mask.mLayer->setMorphMask(mask.mCacheIndex, alpha_data, width, height);
+		}
+	}
+	mMorphMasks.clear();
+	mSources.clear();
+}
+
+void LLTexLayerSetComposite::releaseRawImages()
+{
+	llassert(gTextureManagerBridgep);
+	for (uuid_vec_t::const_iterator iter = mRawImageIDs.begin(); iter != mRawImageIDs.end(); ++iter)
+	{
+		gTextureManagerBridgep->releaseRawImage(*iter);
+	}
+	mRawImageIDs.clear();
+}
+
+// static
+void LLTexLayerSetComposite::startThreads(U32 count)
+{
+	while (sCompositeThreads.size() < count)
+	{
+		sCompositeThreads.push_back(new LLTexLayerCompositeThread());
+	}
+	if (count)
+	{
+		LL_INFOS() << "Compositing tex layer sets on " << count << " threads" << LL_ENDL;
+	}
+}
+
+// static
+void LLTexLayerSetComposite::stopThreads()
+{
+	// composites still queued never finish
+	for (U32 i = 0; i < sCompositeThreads.size(); ++i)
+	{
+		sCompositeThreads[i]->shutdown();
+		if (sCompositeThreads[i]->isStopped())
+		{
+			delete sCompositeThreads[i];
+		}
+		else
+		{
+			LL_WARNS() << "Leaking a stuck tex layer composite thread" << LL_ENDL;
+		}
+	}
+	sCompositeThreads.clear();
+}
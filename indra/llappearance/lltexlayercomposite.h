@@ -0,0 +1,120 @@
+/**
+ * @file lltexlayercomposite.h
+ * @brief LLTexLayerSetComposite class, a layer set bake done on the CPU.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXLAYERCOMPOSITE_H
+#define LL_LLTEXLAYERCOMPOSITE_H
+
+#include <vector>
+
+#include "llatomic.h"
+#include "llimagecompositor.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "lltexlayer.h"
+#include "lluuid.h"
+#include "v4color.h"
+
+class LLImageRaw;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// LLTexLayerSetComposite
+//
+// An LLTexLayerSet composited on the CPU instead of into a GL render target.
+// LLTexLayerSet::paint() paints into it on the main thread, recording the
+// same state changes and draws as into GL, with the images GL would bind.
+// render() then blends them with LLImageCompositor on whatever thread it
+// is posted to, and finish(), back on the main thread, hands the morph
+// masks it captured to their layers.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLTexLayerSetComposite : public LLTexLayerPainter, public LLThreadSafeRefCount
+{
+public:
+	LLTexLayerSetComposite(S32 width, S32 height);
+
+	//--------------------------------------------------------------------
+	// Painting, main thread
+	//--------------------------------------------------------------------
+	/*virtual*/ void setColor(const LLColor4& color);
+	/*virtual*/ void setColorMask(bool color, bool alpha)	{ mCompositor.setColorMask(color, alpha); }
+	/*virtual*/ void setBlend(LLImageCompositor::EBlend blend)	{ mCompositor.setBlend(blend); }
+	/*virtual*/ void setMinimumAlpha(F32 alpha)				{ mCompositor.setMinimumAlpha(alpha); }
+	// like the shaders, textures are always tinted
+	/*virtual*/ void setTextureReplace(bool replace)		{}
+
+	/*virtual*/ void fill();
+	// from the pixels gTextureManagerBridgep keeps of tex
+	/*virtual*/ BOOL drawTexture(LLGLTexture* tex, bool clamp);
+	/*virtual*/ BOOL drawStaticImage(const std::string& file_name, BOOL is_mask, bool need_alpha);
+	/*virtual*/ void drawAlphaParam(LLTexLayerParamAlpha* param);
+	// the mask goes to layer in finish()
+	/*virtual*/ void captureMorphMask(LLTexLayer* layer, U32 cache_index);
+
+	// keeps a reference to image until the composite goes
+	void draw(LLImageRaw* image);
+
+	//--------------------------------------------------------------------
+	// Rendering, any thread
+	//--------------------------------------------------------------------
+	// Renders on a worker, or right away without workers.
+	void post();
+	void render();
+	bool isDone() const							{ return mDone != 0; }
+
+	//--------------------------------------------------------------------
+	// Finishing, main thread
+	//--------------------------------------------------------------------
+	// Skips layers no longer in layer_set.
+	void finish(LLTexLayerSet* layer_set);
+	LLImageRaw* getImage() const				{ return mImage; }
+	// Tells gTextureManagerBridgep the bake is done with the pixels
+	// drawTexture() had it keep.
+	void releaseRawImages();
+
+	static void startThreads(U32 count);
+	static void stopThreads();
+
+protected:
+	~LLTexLayerSetComposite();
+
+private:
+	struct MorphMask
+	{
+		LLTexLayer*	mLayer;
+		U32			mCacheIndex;
+		S32			mCapture;
+	};
+
+	LLImageCompositor	mCompositor;
+	LLPointer<LLImageRaw>	mImage;
+	std::vector<LLPointer<LLImageRaw> >	mSources;
+	std::vector<MorphMask>	mMorphMasks;
+	// textures drawn from their kept pixels
+	uuid_vec_t			mRawImageIDs;
+	LLColor4U			mColor;
+	LLAtomicS32			mDone;
+};
+
+#endif // LL_LLTEXLAYERCOMPOSITE_H
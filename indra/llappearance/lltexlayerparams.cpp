@@ -373,6 +373,98 @@ BOOL LLTexLayerParamAlpha::render(S32 x, S32 y, S32 width, S32 height)
 	return success;
 }
 
+static LLTrace::BlockTimerStatHandle FTM_TEX_LAYER_PARAM_ALPHA_PAINT("alpha paint");
+BOOL LLTexLayerParamAlpha::paint(LLTexLayerPainter& painter)
+{
+	LL_RECORD_BLOCK_TIME(FTM_TEX_LAYER_PARAM_ALPHA_PAINT);
+	BOOL success = TRUE;
+
+	if (!mTexLayer)
+	{
+		return success;
+	}
+
+	F32 effective_weight = (mTexLayer->getTexLayerSet()->getAvatarAppearance()->getSex() & getSex()) ? mCurWeight : getDefaultWeight();
+	BOOL weight_changed = effective_weight != mCachedEffectiveWeight;
+	if (getSkip())
+	{
+		return success;
+	}
+
+	LLTexLayerParamAlphaInfo *info = (LLTexLayerParamAlphaInfo *)getInfo();
+	if (info->mMultiplyBlend)
+	{
+		painter.setBlend(LLImageCompositor::BLEND_MULT_DEST_ALPHA); // Multiplication: approximates a min() function
+	}
+	else
+	{
+		painter.setBlend(LLImageCompositor::BLEND_ADD);  // Addition: approximates a max() function
+	}
+
+	if (!info->mStaticImageFileName.empty() && !mStaticImageInvalid)
+	{
+		if (!loadStaticImage())
+		{
+			return FALSE;
+		}
+
+		if (mStaticImageRaw.isNull() || weight_changed)
+		{
+			processStaticImage(effective_weight);
+		}
+
+		painter.drawAlphaParam(this);
+
+		// Don't keep the cache for other people's avatars
+		// (It's not really a "cache" in that case, but the logic is the same)
+		if (!mAvatarAppearance->isSelf())
+		{
+			mCachedProcessedTexture = NULL;
+		}
+	}
+	else
+	{
+		painter.setColor(LLColor4(0.f, 0.f, 0.f, effective_weight));
+		painter.fill();
+	}
+
+	return success;
+}
+
+BOOL LLTexLayerParamAlpha::loadStaticImage()
+{
+	if (mStaticImageTGA.isNull())
+	{
+		LLTexLayerParamAlphaInfo *info = (LLTexLayerParamAlphaInfo *)getInfo();
+		// Don't load the image file until we actually need it the first time.  Like now.
+		mStaticImageTGA = LLTexLayerStaticImageList::getInstance()->getImageTGA(info->mStaticImageFileName);  
+		// We now have something in one of our caches
+		LLTexLayerSet::sHasCaches |= mStaticImageTGA.notNull() ? TRUE : FALSE;
+
+		if (mStaticImageTGA.isNull())
+		{
+			LL_WARNS() << "Unable to load static file: " << info->mStaticImageFileName << LL_ENDL;
+			mStaticImageInvalid = TRUE; // don't try again.
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+void LLTexLayerParamAlpha::processStaticImage(F32 effective_weight)
+{
+	LLTexLayerParamAlphaInfo *info = (LLTexLayerParamAlphaInfo *)getInfo();
+	mCachedEffectiveWeight = effective_weight;
+
+	// Applies domain and effective weight to data as it is decoded. Also resizes the raw image if needed.
+	// A new image rather than the old one redone, a composite may still be reading that.
+	mStaticImageRaw = NULL;
+	mStaticImageRaw = new LLImageRaw;
+	mStaticImageTGA->decodeAndProcess(mStaticImageRaw, info->mDomain, effective_weight);
+	mNeedsCreateTexture = TRUE;			
+	LL_DEBUGS() << "Built Cached Alpha: " << info->mStaticImageFileName << ": (" << mStaticImageRaw->getWidth() << ", " << mStaticImageRaw->getHeight() << ") " << "Domain: " << info->mDomain << " Weight: " << effective_weight << LL_ENDL;
+}
+
 //-----------------------------------------------------------------------------
 // LLTexLayerParamAlphaInfo
 //-----------------------------------------------------------------------------
@@ -36,6 +36,7 @@ class LLImageRaw;
 class LLImageTGA;
 class LLTexLayer;
 class LLTexLayerInterface;
+class LLTexLayerPainter;
 class LLGLTexture;
 class LLWearable;
 
@@ -99,13 +100,22 @@ public:
 
 	// New functions
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
+	// render() on the CPU
+	BOOL					paint(LLTexLayerPainter& painter);
 	BOOL					getSkip() const;
 	void					deleteCaches();
 	BOOL					getMultiplyBlend() const;
 
+	// the static image processed for the weight, for painters to draw
+	LLImageRaw*				getProcessedImage() const		{ return mStaticImageRaw; }
+
 private:
 	LLTexLayerParamAlpha(const LLTexLayerParamAlpha& pOther);
 
+	BOOL					loadStaticImage();
+	// mStaticImageRaw at effective_weight
+	void					processStaticImage(F32 effective_weight);
+
 	LLPointer<LLGLTexture>	mCachedProcessedTexture;
 	LLPointer<LLImageTGA>	mStaticImageTGA;
 	LLPointer<LLImageRaw>	mStaticImageRaw;
@@ -31,6 +31,8 @@
 #include "llpointer.h"
 #include "llgltexture.h"
 
+class LLImageRaw;
+
 // Abstract bridge interface
 class LLTextureManagerBridge
 {
@@ -40,6 +42,12 @@ public:
 	virtual LLPointer<LLGLTexture> getLocalTexture(BOOL usemipmaps = TRUE, BOOL generate_gl_tex = TRUE) = 0;
 	virtual LLPointer<LLGLTexture> getLocalTexture(const U32 width, const U32 height, const U8 components, BOOL usemipmaps, BOOL generate_gl_tex = TRUE) = 0;
 	virtual LLGLTexture* getFetchedTexture(const LLUUID &image_id) = 0;
+	// A texture's pixels, for compositing bakes on the CPU.  NULL if they
+	// aren't kept, which asks for them to be until releaseRawImage().
+	virtual LLImageRaw* getRawImage(LLGLTexture* tex) = 0;
+	// Once a bake is done with them, lets go of the pixels getRawImage()
+	// asked to keep.  Pixels kept for anything else stay.
+	virtual void releaseRawImage(const LLUUID& image_id) = 0;
 };
 
 extern LLTextureManagerBridge* gTextureManagerBridgep;
@@ -0,0 +1,344 @@
+/**
+ * @file llpolymesh_test.cpp
+ * @brief LLPolyMesh morph tests, queued morphs applied in one pass against
+ * the same morphs applied one at a time.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpolymesh.h"
+#include "../llpolymorph.h"
+#include "llformat.h"
+
+#include "../test/lltut.h"
+#include "../test/namedtempfile.h"
+
+namespace
+{
+	// the last two vertices are left out of every morph
+	const S32 NUM_VERTICES = 8;
+
+	// how the morphs add up differs from one at a time only in when the
+	// normals get renormalized, so this only leaves room for the compiler
+	const U32 MATCHING_BITS = 20;
+
+	// A binary .llm mesh, as LLPolyMeshSharedData::loadMesh() reads it:
+	// no faces, no weights, and the morph targets the tests apply.
+	class MeshWriter
+	{
+	public:
+		MeshWriter()
+		{
+			putString("Linden Binary Mesh 1.0", 24);
+			put<U8>(0);									// has weights
+			put<U8>(0);									// has detail tex coords
+			putVector(LLVector3::zero);					// position
+			putVector(LLVector3::zero);					// rotation angles
+			put<U8>(0);									// rotation order
+			putVector(LLVector3(1.f, 1.f, 1.f));		// scale
+
+			put<U16>(NUM_VERTICES);
+			for (S32 i = 0; i < NUM_VERTICES; ++i)
+			{
+				putVector(LLVector3(0.1f * i, 0.2f, 1.f - 0.05f * i));
+			}
+			for (S32 i = 0; i < NUM_VERTICES; ++i)
+			{
+				LLVector3 normal(0.1f * i, 1.f, 0.2f);
+				normal.normalize();
+				putVector(normal);
+			}
+			for (S32 i = 0; i < NUM_VERTICES; ++i)
+			{
+				putVector(LLVector3(1.f, 0.f, 0.1f * i));
+			}
+			for (S32 i = 0; i < NUM_VERTICES; ++i)
+			{
+				put<F32>((F32) i / NUM_VERTICES);
+				put<F32>(0.5f);
+			}
+
+			put<U16>(0);								// faces
+		}
+
+		// k scales the deltas, so no two morphs move a vertex alike
+		void addMorph(const std::string& name, const U32* vertices, S32 count, F32 k, S32 degenerate_binormal = -1)
+		{
+			putString(name, 64);
+			put<S32>(count);
+			for (S32 i = 0; i < count; ++i)
+			{
+				U32 v = vertices[i];
+				put<U32>(v);
+				putVector(LLVector3(0.01f * (v + 1) * k, -0.02f * k, 0.03f));
+				putVector(LLVector3(0.3f, -0.2f * k, 0.1f * v));
+				putVector(i == degenerate_binormal ? LLVector3::zero : LLVector3(0.1f, 0.2f * v, -0.3f * k));
+				put<F32>(0.01f * k);
+				put<F32>(-0.01f * v);
+			}
+		}
+
+		std::string finish()
+		{
+			putString("End Morphs", 64);
+			return mBytes;
+		}
+
+	private:
+		template <class T> void put(T value)
+		{
+			mBytes.append((const char*) &value, sizeof(T));
+		}
+
+		void putVector(const LLVector3& v)
+		{
+			put<F32>(v.mV[VX]);
+			put<F32>(v.mV[VY]);
+			put<F32>(v.mV[VZ]);
+		}
+
+		void putString(const std::string& s, U32 length)
+		{
+			std::string field(s);
+			field.resize(length, '\0');
+			mBytes += field;
+		}
+
+		std::string mBytes;
+	};
+
+	const U32 SHAPE_VERTICES[] = { 0, 1, 2, 3 };
+	const U32 MASKED_VERTICES[] = { 2, 3, 4 };
+	const F32 MASK_WEIGHTS[] = { 0.25f, 1.f, 0.5f };
+	const U32 CLOTHING_VERTICES[] = { 1, 4, 5 };
+
+	std::string test_mesh()
+	{
+		MeshWriter writer;
+		writer.addMorph("Shape", SHAPE_VERTICES, LL_ARRAY_SIZE(SHAPE_VERTICES), 1.f);
+		writer.addMorph("Masked", MASKED_VERTICES, LL_ARRAY_SIZE(MASKED_VERTICES), 2.f);
+		writer.addMorph("Clothing", CLOTHING_VERTICES, LL_ARRAY_SIZE(CLOTHING_VERTICES), -1.5f, 2);
+		return writer.finish();
+	}
+
+	// What LLPolyMorphTarget::apply() did with a morph before morphs queued
+	// on their mesh: add it and renormalize every vertex it touches.
+	void apply_one_morph(LLPolyMesh* mesh, LLPolyMorphData* data, const F32* mask_weights, F32 delta_weight, bool clothing)
+	{
+		LLVector4a* coords = mesh->getWritableCoords();
+		LLVector4a* scaled_normals = mesh->getScaledNormals();
+		LLVector4a* normals = mesh->getWritableNormals();
+		LLVector4a* scaled_binormals = mesh->getScaledBinormals();
+		LLVector4a* binormals = mesh->getWritableBinormals();
+		LLVector4a* clothing_weights = mesh->getWritableClothingWeights();
+		LLVector2* tex_coords = mesh->getWritableTexCoords();
+
+		for (U32 j = 0; j < data->mNumIndices; ++j)
+		{
+			S32 vert = data->mVertexIndices[j];
+			F32 mask_weight = mask_weights ? mask_weights[j] : 1.f;
+
+			LLVector4a pos = data->mCoords[j];
+			pos.mul(delta_weight * mask_weight);
+			coords[vert].add(pos);
+
+			if (clothing)
+			{
+				LLVector4a clothing_offset = data->mCoords[j];
+				clothing_offset.mul(delta_weight * mask_weight);
+				clothing_weights[vert].add(clothing_offset);
+				clothing_weights[vert].getF32ptr()[VW] = mask_weight;
+			}
+
+			LLVector4a norm = data->mNormals[j];
+			norm.mul(delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR);
+			scaled_normals[vert].add(norm);
+			norm = scaled_normals[vert];
+			norm.normalize3fast();
+			normals[vert] = norm;
+
+			LLVector4a binorm = data->mBinormals[j];
+			if (!binorm.isFinite3() || (binorm.dot3(binorm).getF32() <= F_APPROXIMATELY_ZERO))
+			{
+				binorm.set(1, 0, 0, 1);
+			}
+			binorm.mul(delta_weight * mask_weight * NORMAL_SOFTEN_FACTOR);
+			scaled_binormals[vert].add(binorm);
+			LLVector4a tangent;
+			tangent.setCross3(scaled_binormals[vert], norm);
+			binormals[vert].setCross3(norm, tangent);
+			binormals[vert].normalize3fast();
+
+			tex_coords[vert] += data->mTexCoords[j] * delta_weight * mask_weight;
+		}
+	}
+}
+
+namespace tut
+{
+	struct polymesh_data
+	{
+		polymesh_data()
+		:	mFile("llm", test_mesh())
+		{
+			mSharedData.loadMesh(mFile.getName());
+			mMesh = new LLPolyMesh(&mSharedData, NULL);
+			mExpected = new LLPolyMesh(&mSharedData, NULL);
+			mShape = mMesh->getMorphData("Shape");
+			mMasked = mMesh->getMorphData("Masked");
+			mClothing = mMesh->getMorphData("Clothing");
+		}
+
+		~polymesh_data()
+		{
+			delete mMesh;
+			delete mExpected;
+		}
+
+		// the same morph on mMesh and, the old way, on mExpected
+		void queueMorph(LLPolyMorphData* data, const F32* mask_weights, F32 weight, bool clothing)
+		{
+			mMesh->queueMorph(data, mask_weights, weight, clothing);
+			apply_one_morph(mExpected, data, mask_weights, weight, clothing);
+		}
+
+		void addMorph(LLPolyMorphData* data, const F32* mask_weights, F32 weight, bool clothing)
+		{
+			mMesh->addMorph(data, mask_weights, weight, clothing);
+			apply_one_morph(mExpected, data, mask_weights, weight, clothing);
+		}
+
+		void ensureVector(const std::string& msg, const LLVector4a& actual, const LLVector4a& expected, S32 count = 3)
+		{
+			for (S32 i = 0; i < count; ++i)
+			{
+				ensure_approximately_equals(llformat("%s[%d]", msg.c_str(), i).c_str(), actual[i], expected[i], MATCHING_BITS);
+			}
+		}
+
+		// everything the morphs write
+		void ensureMatch(const std::string& msg)
+		{
+			ensure_equals(msg + ": vertices", mMesh->getNumVertices(), (U32) NUM_VERTICES);
+			for (S32 v = 0; v < NUM_VERTICES; ++v)
+			{
+				std::string where = llformat("%s: vertex %d", msg.c_str(), v);
+				ensureVector(where + " coords", mMesh->getCoords()[v], mExpected->getCoords()[v]);
+				ensureVector(where + " normal", mMesh->getNormals()[v], mExpected->getNormals()[v]);
+				ensureVector(where + " binormal", mMesh->getBinormals()[v], mExpected->getBinormals()[v]);
+				ensureVector(where + " scaled normal", mMesh->getScaledNormals()[v], mExpected->getScaledNormals()[v]);
+				ensureVector(where + " scaled binormal", mMesh->getScaledBinormals()[v], mExpected->getScaledBinormals()[v]);
+				ensureVector(where + " clothing weight", mMesh->getClothingWeights()[v], mExpected->getClothingWeights()[v], 4);
+				ensure_approximately_equals((where + " u").c_str(), mMesh->getTexCoords()[v].mV[VX], mExpected->getTexCoords()[v].mV[VX], MATCHING_BITS);
+				ensure_approximately_equals((where + " v").c_str(), mMesh->getTexCoords()[v].mV[VY], mExpected->getTexCoords()[v].mV[VY], MATCHING_BITS);
+			}
+		}
+
+		NamedTempFile mFile;
+		LLPolyMeshSharedData mSharedData;
+		LLPolyMesh* mMesh;
+		LLPolyMesh* mExpected;	// morphed one morph at a time
+		LLPolyMorphData* mShape;
+		LLPolyMorphData* mMasked;
+		LLPolyMorphData* mClothing;
+	};
+
+	typedef test_group<polymesh_data> polymesh_t;
+	typedef polymesh_t::object polymesh_object_t;
+	tut::polymesh_t tut_polymesh("LLPolyMesh");
+
+	// the mesh and its morphs loaded
+	template<> template<>
+	void polymesh_object_t::test<1>()
+	{
+		ensure("shape morph", mShape != NULL);
+		ensure("masked morph", mMasked != NULL);
+		ensure("clothing morph", mClothing != NULL);
+		ensure_equals("clothing morph vertices", mClothing->mNumIndices, (U32) LL_ARRAY_SIZE(CLOTHING_VERTICES));
+		ensureMatch("unmorphed");
+	}
+
+	// overlapping, masked and clothing morphs queued up and applied in
+	// one pass come out as applied one at a time
+	template<> template<>
+	void polymesh_object_t::test<2>()
+	{
+		queueMorph(mShape, NULL, 0.7f, false);
+		queueMorph(mMasked, MASK_WEIGHTS, -0.4f, false);
+		queueMorph(mClothing, NULL, 0.9f, true);
+		queueMorph(mShape, NULL, -0.3f, false);
+		mMesh->applyMorphs();
+		ensureMatch("one pass");
+	}
+
+	// queued morphs wait for applyMorphs()
+	template<> template<>
+	void polymesh_object_t::test<3>()
+	{
+		LLVector4a unmorphed = mMesh->getCoords()[0];
+		mMesh->queueMorph(mShape, NULL, 0.5f, false);
+		ensure("queued", mMesh->hasQueuedMorphs());
+		ensureVector("not applied yet", mMesh->getCoords()[0], unmorphed);
+
+		mMesh->applyMorphs();
+		ensure("queue emptied", !mMesh->hasQueuedMorphs());
+		apply_one_morph(mExpected, mShape, NULL, 0.5f, false);
+		ensureMatch("applied");
+
+		mMesh->applyMorphs();
+		ensureMatch("nothing left to apply");
+	}
+
+	// a pass after another one, touching some of the same vertices
+	template<> template<>
+	void polymesh_object_t::test<4>()
+	{
+		queueMorph(mShape, NULL, 0.7f, false);
+		queueMorph(mClothing, NULL, 0.2f, true);
+		mMesh->applyMorphs();
+		ensureMatch("first pass");
+
+		queueMorph(mMasked, MASK_WEIGHTS, 0.6f, false);
+		mMesh->applyMorphs();
+		ensureMatch("second pass");
+
+		queueMorph(mClothing, NULL, -0.2f, true);
+		queueMorph(mShape, NULL, -0.5f, false);
+		mMesh->applyMorphs();
+		ensureMatch("third pass");
+	}
+
+	// with no avatar deferring them, added morphs apply right away
+	template<> template<>
+	void polymesh_object_t::test<5>()
+	{
+		addMorph(mShape, NULL, 0.7f, false);
+		ensure("not queued", !mMesh->hasQueuedMorphs());
+		ensureMatch("first morph");
+
+		addMorph(mMasked, MASK_WEIGHTS, -0.4f, false);
+		addMorph(mClothing, NULL, 0.9f, true);
+		ensureMatch("all morphs");
+	}
+}
@@ -0,0 +1,300 @@
+/**
+ * @file lltexlayercomposite_test.cpp
+ * @brief LLTexLayerSetComposite tests, a small layer set against pixels
+ * worked out by hand from GL's blend equations.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltexlayercomposite.h"
+
+#include "llimage.h"
+#include "llimagetga.h"
+#include "lltimer.h"
+#include "../lltexturemanagerbridge.h"
+
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+// the layer that is still in the set, and the mask finish() handed it
+static const LLTexLayer* sLiveLayer = NULL;
+static std::vector<U8> sMorphMask;
+static U32 sMorphMaskIndex = 0;
+
+BOOL LLTexLayerSet::hasLayer(const LLTexLayer* layer) const
+{
+	return layer == sLiveLayer;
+}
+
+void LLTexLayer::setMorphMask(U32 cache_index, U8* alpha_data, S32 width, S32 height)
+{
+	sMorphMaskIndex = cache_index;
+	sMorphMask.assign(alpha_data, alpha_data + width * height);
+	delete[] alpha_data;
+}
+
+LLTexLayerStaticImageList::LLTexLayerStaticImageList() : mImageNames(16) {}
+LLTexLayerStaticImageList::~LLTexLayerStaticImageList() {}
+LLImageRaw* LLTexLayerStaticImageList::getImageRaw(const std::string& file_name, BOOL is_mask) { return NULL; }
+
+// Keeps no pixels, and counts what it was asked for.
+class LLTestTextureManagerBridge : public LLTextureManagerBridge
+{
+public:
+	LLTestTextureManagerBridge() : mGets(0), mReleases(0) {}
+
+	/*virtual*/ LLPointer<LLGLTexture> getLocalTexture(BOOL usemipmaps, BOOL generate_gl_tex) { return NULL; }
+	/*virtual*/ LLPointer<LLGLTexture> getLocalTexture(const U32 width, const U32 height, const U8 components, BOOL usemipmaps, BOOL generate_gl_tex) { return NULL; }
+	/*virtual*/ LLGLTexture* getFetchedTexture(const LLUUID &image_id) { return NULL; }
+	/*virtual*/ LLImageRaw* getRawImage(LLGLTexture* tex) { ++mGets; return NULL; }
+	/*virtual*/ void releaseRawImage(const LLUUID& image_id) { ++mReleases; }
+
+	S32 mGets;
+	S32 mReleases;
+};
+
+LLTextureManagerBridge* gTextureManagerBridgep = NULL;
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	const S32 WIDTH = 4;
+	const S32 HEIGHT = 1;
+
+	LLImageRaw* make_image(S32 components, const U8* data)
+	{
+		LLImageRaw* image = new LLImageRaw(WIDTH, HEIGHT, components);
+		memcpy(image->getData(), data, WIDTH * HEIGHT * components);
+		return image;
+	}
+
+	// The calls LLTexLayerSet::paint() makes for a set of
+	//   a skin layer, a fixed color fill
+	//   a tinted clothing layer, with a morph mask from one alpha param
+	//   a mask layer
+	// where every image is the size of the bake, so nothing is stretched.
+	struct KnownLayerSet
+	{
+		KnownLayerSet()
+		{
+			const U8 param[WIDTH] = { 0, 255, 255, 128 };
+			const U8 clothing[WIDTH * 4] = { 255, 255, 255, 255,  255, 255, 255, 255,
+											 255, 255, 255, 255,  255, 255, 255, 255 };
+			const U8 mask[WIDTH] = { 255, 0, 255, 255 };
+			mParam = make_image(1, param);
+			mClothing = make_image(4, clothing);
+			mMask = make_image(1, mask);
+		}
+
+		void paint(LLTexLayerSetComposite& painter, LLTexLayer* clothing_layer) const
+		{
+			// clear
+			painter.setColorMask(true, true);
+			painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+			painter.setMinimumAlpha(0.f);
+			painter.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+			painter.fill();
+			painter.setMinimumAlpha(0.004f);
+
+			// skin
+			painter.setMinimumAlpha(0.f);
+			painter.setColor(LLColor4(1.f, 0.5f, 0.f, 1.f));
+			painter.fill();
+			painter.setMinimumAlpha(0.004f);
+
+			// clothing, morph mask first
+			painter.setMinimumAlpha(0.f);
+			painter.setColorMask(false, true);
+			painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+			painter.setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+			painter.fill();
+			painter.setColor(LLColor4(1.f, 1.f, 1.f, 1.f));
+			painter.setBlend(LLImageCompositor::BLEND_ADD);
+			painter.draw(mParam);
+			painter.setBlend(LLImageCompositor::BLEND_MULT_DEST_ALPHA);
+			painter.setMinimumAlpha(0.004f);
+			painter.setColorMask(true, true);
+			painter.captureMorphMask(clothing_layer, 7);
+			painter.setBlend(LLImageCompositor::BLEND_DEST_ALPHA);
+			painter.setColor(LLColor4(1.f, 0.5f, 1.f, 1.f));
+			painter.draw(mClothing);
+			painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+
+			// alpha masks
+			painter.setColorMask(false, true);
+			painter.setBlend(LLImageCompositor::BLEND_REPLACE);
+			painter.setTextureReplace(true);
+			painter.setMinimumAlpha(0.f);
+			painter.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+			painter.fill();
+			painter.setMinimumAlpha(0.004f);
+			painter.setBlend(LLImageCompositor::BLEND_MULT_DEST_ALPHA);
+			painter.setMinimumAlpha(0.f);
+			painter.draw(mMask);
+			painter.setMinimumAlpha(0.004f);
+			painter.setTextureReplace(false);
+			painter.setColorMask(true, true);
+			painter.setBlend(LLImageCompositor::BLEND_ALPHA);
+		}
+
+		LLPointer<LLImageRaw> mParam;
+		LLPointer<LLImageRaw> mClothing;
+		LLPointer<LLImageRaw> mMask;
+	};
+
+	// Worked out a step at a time from GL's blend equations, in 8 bits:
+	//   skin              255 127   0 255 everywhere
+	//   morph mask alpha    0 255 255 128
+	//   clothing, 255 127 255 255 blended by that alpha
+	//     pixel 0 stays skin, 1 and 2 become clothing,
+	//     pixel 3 is (s * 128 + d * 127) / 255 = 255 127 128 192
+	//   the mask replaces the alpha with 255 0 255 255
+	const U8 EXPECTED[WIDTH * 4] = { 255, 127,   0, 255,
+									 255, 127, 255,   0,
+									 255, 127, 255, 255,
+									 255, 127, 128, 255 };
+	const U8 EXPECTED_MORPH_MASK[WIDTH] = { 0, 255, 255, 128 };
+
+	// never looked into, the stubs only compare pointers
+	char sLayerStandIn;
+	char sLayerSetStandIn;
+}
+
+namespace tut
+{
+	struct texlayercomposite_test
+	{
+		texlayercomposite_test()
+		{
+			sLiveLayer = NULL;
+			sMorphMask.clear();
+			sMorphMaskIndex = 0;
+		}
+
+		LLTexLayer* clothingLayer() const				{ return reinterpret_cast<LLTexLayer*>(&sLayerStandIn); }
+		LLTexLayerSet* layerSet() const					{ return reinterpret_cast<LLTexLayerSet*>(&sLayerSetStandIn); }
+
+		void ensure_known_result(const std::string& msg, LLTexLayerSetComposite* composite)
+		{
+			ensure(msg + " done", composite->isDone());
+			const U8* data = composite->getImage()->getData();
+			for (S32 i = 0; i < WIDTH * 4; ++i)
+			{
+				ensure_equals(msg + " pixel " + llformat("%d channel %d", i / 4, i % 4), (S32) data[i], (S32) EXPECTED[i]);
+			}
+
+			sLiveLayer = clothingLayer();
+			composite->finish(layerSet());
+			ensure_equals(msg + " morph mask size", sMorphMask.size(), (size_t) WIDTH);
+			ensure_equals(msg + " morph mask index", sMorphMaskIndex, 7U);
+			for (S32 i = 0; i < WIDTH; ++i)
+			{
+				ensure_equals(msg + " morph mask", (S32) sMorphMask[i], (S32) EXPECTED_MORPH_MASK[i]);
+			}
+		}
+	};
+	typedef test_group<texlayercomposite_test> texlayercomposite_t;
+	typedef texlayercomposite_t::object texlayercomposite_object_t;
+	tut::texlayercomposite_t tut_texlayercomposite("LLTexLayerSetComposite");
+
+	// the known set rendered right away
+	template<> template<>
+	void texlayercomposite_object_t::test<1>()
+	{
+		KnownLayerSet layer_set;
+		LLPointer<LLTexLayerSetComposite> composite = new LLTexLayerSetComposite(WIDTH, HEIGHT);
+		layer_set.paint(*composite, clothingLayer());
+		ensure("not done before rendering", !composite->isDone());
+		composite->render();
+		ensure_known_result("render", composite);
+	}
+
+	// the same set on the composite threads
+	template<> template<>
+	void texlayercomposite_object_t::test<2>()
+	{
+		KnownLayerSet layer_set;
+		LLTexLayerSetComposite::startThreads(2);
+		std::vector<LLPointer<LLTexLayerSetComposite> > composites;
+		for (S32 i = 0; i < 8; ++i)
+		{
+			composites.push_back(new LLTexLayerSetComposite(WIDTH, HEIGHT));
+			layer_set.paint(*composites.back(), clothingLayer());
+			composites.back()->post();
+		}
+
+		LLTimer timer;
+		bool done = false;
+		while (!done && timer.getElapsedTimeF32() < 10.f)
+		{
+			done = true;
+			for (U32 i = 0; i < composites.size(); ++i)
+			{
+				done = done && composites[i]->isDone();
+			}
+			if (!done)
+			{
+				ms_sleep(1);
+			}
+		}
+		LLTexLayerSetComposite::stopThreads();
+
+		for (U32 i = 0; i < composites.size(); ++i)
+		{
+			ensure_known_result(llformat("posted %d", i), composites[i]);
+		}
+	}
+
+	// a morph mask for a layer that left the set is dropped, and a texture
+	// without kept pixels makes the walk partial
+	template<> template<>
+	void texlayercomposite_object_t::test<3>()
+	{
+		KnownLayerSet layer_set;
+		LLPointer<LLTexLayerSetComposite> composite = new LLTexLayerSetComposite(WIDTH, HEIGHT);
+		layer_set.paint(*composite, clothingLayer());
+		composite->render();
+		sLiveLayer = NULL;
+		composite->finish(layerSet());
+		ensure("no morph mask", sMorphMask.empty());
+
+		LLTestTextureManagerBridge bridge;
+		gTextureManagerBridgep = &bridge;
+		composite = new LLTexLayerSetComposite(WIDTH, HEIGHT);
+		ensure("partial", !composite->drawTexture(NULL, true));
+		ensure_equals("asked for the pixels", bridge.mGets, 1);
+		composite->releaseRawImages();
+		ensure_equals("nothing kept to release", bridge.mReleases, 0);
+		gTextureManagerBridgep = NULL;
+	}
+}
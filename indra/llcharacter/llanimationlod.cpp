@@ -0,0 +1,229 @@
+/**
+ * @file llanimationlod.cpp
+ * @brief LLAnimationLOD class, evaluates a character's motions every few
+ * frames and eases its skeleton in between.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llanimationlod.h"
+
+#include "lljoint.h"
+
+const S32 LLAnimationLOD::PERIODS[LLAnimationLOD::NUM_RATES] = { 1, 2, 4, 8 };
+
+namespace
+{
+	const F32 RATE_MIN_AREA[LLAnimationLOD::NUM_RATES] = { 10000.f, 2500.f, 600.f, 0.f }; // pixels
+	const F32 RATE_MAX_DISTANCE[LLAnimationLOD::NUM_RATES] = { 10.f, 32.f, 64.f, F32_MAX }; // meters
+	const F32 COST_SMOOTHING = 0.1f;
+}
+
+//static
+LLAnimationLOD::ERate LLAnimationLOD::selectRate(F32 pixel_area, F32 distance)
+{
+	S32 by_area = RATE_FULL;
+	while (by_area < RATE_EIGHTH && pixel_area < RATE_MIN_AREA[by_area])
+	{
+		++by_area;
+	}
+	S32 by_distance = RATE_FULL;
+	while (by_distance < RATE_EIGHTH && distance > RATE_MAX_DISTANCE[by_distance])
+	{
+		++by_distance;
+	}
+	return (ERate)llmin(by_area, by_distance);
+}
+
+//-----------------------------------------------------------------------------
+// Budget
+//-----------------------------------------------------------------------------
+LLAnimationLOD::Budget::Budget()
+:	mLimit(0.f),
+	mUsed(0.f),
+	mCost(0.f),
+	mEvaluated(0),
+	mDeferred(0)
+{
+}
+
+void LLAnimationLOD::Budget::startFrame()
+{
+	mUsed = 0.f;
+	mEvaluated = 0;
+	mDeferred = 0;
+}
+
+void LLAnimationLOD::Budget::addCost(F64 seconds, S32 count)
+{
+	if (count > 0)
+	{
+		F32 cost = (F32)(seconds / count);
+		mCost = mCost > 0.f ? lerp(mCost, cost, COST_SMOOTHING) : cost;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// LLAnimationLOD
+//-----------------------------------------------------------------------------
+LLAnimationLOD::LLAnimationLOD()
+:	mRate(RATE_FULL),
+	mPeriod(1),
+	mLastFrame(0)
+{
+}
+
+bool LLAnimationLOD::isDue(U32 frame, S32 skeleton_size, Budget& budget)
+{
+	S32 period = PERIODS[mRate];
+	U32 elapsed = frame - mLastFrame;
+	if (period > 1 && mPeriod > 1 && (S32)mPose.size() == skeleton_size)
+	{
+		if (elapsed < (U32)period)
+		{
+			return false;
+		}
+
+		// never hold a character back for more than a period
+		if (budget.mUsed + budget.mCost > budget.mLimit && elapsed < (U32)period * 2)
+		{
+			budget.mDeferred++;
+			return false;
+		}
+	}
+
+	budget.mEvaluated++;
+	if (period > 1)
+	{
+		// the budget only spreads out reduced rate evaluations, full
+		// rate ones happen whatever it says
+		budget.mUsed += budget.mCost;
+	}
+	return true;
+}
+
+bool LLAnimationLOD::startPose(S32 skeleton_size)
+{
+	if (mPeriod == 1 && mRate == RATE_FULL)
+	{
+		return false;
+	}
+
+	if ((S32)mPose.size() != skeleton_size)
+	{
+		mPose.resize(skeleton_size);
+		mPeriod = 1;
+	}
+	return true;
+}
+
+bool LLAnimationLOD::finishPose(S32 skeleton_size, U32 frame, U32 phase)
+{
+	S32 period = PERIODS[mRate];
+	if (period > 1 && mPeriod == 1)
+	{
+		mLastFrame = frame - phase % period;
+	}
+	else
+	{
+		mLastFrame = frame;
+	}
+	mPeriod = period;
+	if (period == 1 || (S32)mPose.size() != skeleton_size)
+	{
+		mPeriod = 1;
+		return false;
+	}
+	return true;
+}
+
+F32 LLAnimationLOD::getInterpolation(U32 frame) const
+{
+	U32 elapsed = frame - mLastFrame;
+	return llmin((F32)(elapsed + 1) / mPeriod, 1.f);
+}
+
+//-----------------------------------------------------------------------------
+// JointPose
+//-----------------------------------------------------------------------------
+void LLAnimationLOD::JointPose::begin(LLJoint* joint, bool carry_on)
+{
+	mStartRotation = joint->getRotation();
+	mStartPosition = joint->getPosition();
+	if (carry_on)
+	{
+		// the motions carry on from the pose they set, not from part way
+		// there, unless something else has moved the joint since
+		if (mRotating && mRotation == mStartRotation)
+		{
+			joint->setRotation(mTargetRotation);
+		}
+		if (mMoving && mPosition == mStartPosition)
+		{
+			joint->setPosition(mTargetPosition);
+		}
+	}
+}
+
+void LLAnimationLOD::JointPose::end(LLJoint* joint, F32 u)
+{
+	mTargetRotation = joint->getRotation();
+	mRotating = !(mTargetRotation == mStartRotation);
+	if (mRotating)
+	{
+		mRotation = nlerp(u, mStartRotation, mTargetRotation);
+		joint->setRotation(mRotation);
+	}
+
+	mTargetPosition = joint->getPosition();
+	mMoving = mTargetPosition != mStartPosition;
+	if (mMoving)
+	{
+		mPosition = lerp(mStartPosition, mTargetPosition, u);
+		joint->setPosition(mPosition);
+	}
+}
+
+void LLAnimationLOD::JointPose::interpolate(LLJoint* joint, F32 u)
+{
+	if (mRotating)
+	{
+		// a joint moved by anything else is left to it
+		mRotating = joint->getRotation() == mRotation;
+		if (mRotating)
+		{
+			mRotation = nlerp(u, mStartRotation, mTargetRotation);
+			joint->setRotation(mRotation);
+		}
+	}
+	if (mMoving)
+	{
+		mMoving = joint->getPosition() == mPosition;
+		if (mMoving)
+		{
+			mPosition = lerp(mStartPosition, mTargetPosition, u);
+			joint->setPosition(mPosition);
+		}
+	}
+}
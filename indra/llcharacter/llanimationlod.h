@@ -0,0 +1,180 @@
+/**
+ * @file llanimationlod.h
+ * @brief LLAnimationLOD class, evaluates a character's motions every few
+ * frames and eases its skeleton in between.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLANIMATIONLOD_H
+#define LL_LLANIMATIONLOD_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llquaternion.h"
+#include "v3math.h"
+
+class LLJoint;
+
+// A character animated at a reduced rate evaluates its motions every
+// period frames.  In between its joints ease toward the last evaluated
+// pose, so the skeleton trails the motions by up to a period.  The
+// evaluations of one frame at the reduced rates share a Budget, a
+// character over it waits for a later frame and holds its pose.
+//
+// The skeleton handed to the pose calls is the same one every time, the
+// pose is kept per joint in its order.
+class LLAnimationLOD
+{
+public:
+	typedef enum e_rate
+	{
+		RATE_FULL = 0,
+		RATE_HALF,
+		RATE_QUARTER,
+		RATE_EIGHTH,
+		NUM_RATES
+	} ERate;
+
+	// frames between evaluations at each rate
+	static const S32 PERIODS[NUM_RATES];
+
+	// the fastest rate either the screen area or the distance from the
+	// camera asks for
+	static ERate selectRate(F32 pixel_area, F32 distance);
+
+	struct Budget
+	{
+		Budget();
+
+		// once a frame, before the characters' updates
+		void	startFrame();
+		// what evaluating count characters' motions took
+		void	addCost(F64 seconds, S32 count);
+
+		F32		mLimit;		// seconds a frame
+		F32		mUsed;		// this frame, at reduced rates
+		F32		mCost;		// seconds per evaluation, running average
+		S32		mEvaluated;	// this frame
+		S32		mDeferred;	// this frame, held back by the budget
+	};
+
+	LLAnimationLOD();
+
+	ERate	getRate() const			{ return mRate; }
+	void	setRate(ERate rate)		{ mRate = rate; }
+
+	// whether to evaluate the motions at frame, false to ease the pose;
+	// skeleton_size is the number of joints of the skeleton posed
+	bool	isDue(U32 frame, S32 skeleton_size, Budget& budget);
+
+	// around evaluating the motions of a frame isDue() allowed, phase
+	// spreads the characters dropping to a rate together over its frames
+	template <class T> void beginPose(const std::vector<T*>& skeleton);
+	template <class T> void endPose(const std::vector<T*>& skeleton, U32 frame, U32 phase);
+	// on the frames in between
+	template <class T> void interpolatePose(const std::vector<T*>& skeleton, U32 frame);
+
+	// of the pose being eased toward, 1 when none
+	S32		getPeriod() const		{ return mPeriod; }
+
+private:
+	struct JointPose
+	{
+		void	begin(LLJoint* joint, bool carry_on);
+		void	end(LLJoint* joint, F32 u);
+		void	interpolate(LLJoint* joint, F32 u);
+
+		LLQuaternion	mStartRotation;
+		LLQuaternion	mTargetRotation;
+		LLQuaternion	mRotation;		// as last set here
+		LLVector3		mStartPosition;
+		LLVector3		mTargetPosition;
+		LLVector3		mPosition;		// as last set here
+		bool			mRotating;
+		bool			mMoving;
+	};
+
+	// false when there's no pose to keep
+	bool	startPose(S32 skeleton_size);
+	// false when the pose isn't eased toward
+	bool	finishPose(S32 skeleton_size, U32 frame, U32 phase);
+	F32		getInterpolation(U32 frame) const;
+
+	std::vector<JointPose> mPose;
+	ERate	mRate;
+	S32		mPeriod;
+	U32		mLastFrame;
+};
+
+template <class T>
+void LLAnimationLOD::beginPose(const std::vector<T*>& skeleton)
+{
+	if (!startPose(skeleton.size()))
+	{
+		return;
+	}
+
+	bool carry_on = mPeriod > 1;
+	for (U32 i = 0; i < skeleton.size(); ++i)
+	{
+		if (skeleton[i])
+		{
+			mPose[i].begin(skeleton[i], carry_on);
+		}
+	}
+}
+
+template <class T>
+void LLAnimationLOD::endPose(const std::vector<T*>& skeleton, U32 frame, U32 phase)
+{
+	if (!finishPose(skeleton.size(), frame, phase))
+	{
+		return;
+	}
+
+	F32 u = 1.f / mPeriod;
+	for (U32 i = 0; i < skeleton.size(); ++i)
+	{
+		if (skeleton[i])
+		{
+			mPose[i].end(skeleton[i], u);
+		}
+	}
+}
+
+template <class T>
+void LLAnimationLOD::interpolatePose(const std::vector<T*>& skeleton, U32 frame)
+{
+	F32 u = getInterpolation(frame);
+	U32 count = llmin((U32)skeleton.size(), (U32)mPose.size());
+	for (U32 i = 0; i < count; ++i)
+	{
+		if (skeleton[i])
+		{
+			mPose[i].interpolate(skeleton[i], u);
+		}
+	}
+}
+
+#endif // LL_LLANIMATIONLOD_H
@@ -33,6 +33,7 @@
 #include "llcharacter.h"
 #include "llstring.h"
 #include "llfasttimer.h"
+#include "llskeletontransforms.h"
 
 #define SKEL_HEADER "Linden Skeleton 1.0"
 
@@ -50,7 +51,9 @@ LLCharacter::LLCharacter()
 	mPreferredPelvisHeight( 0.f ),
 	mSex( SEX_FEMALE ),
 	mAppearanceSerialNum( 0 ),
-	mSkeletonSerialNum( 0 )
+	mSkeletonSerialNum( 0 ),
+	mMotionsPrepared( false ),
+	mSkeletonTransforms( NULL )
 {
 	llassert_always(sAllowInstancesChange) ;
 	sInstances.push_back(this);
@@ -88,6 +91,8 @@ LLCharacter::~LLCharacter()
 	llassert_always(sAllowInstancesChange) ;
 	sInstances[i] = sInstances[size - 1] ;
 	sInstances.pop_back() ;
+
+	delete mSkeletonTransforms;
 }
 
 
@@ -210,11 +215,7 @@ void LLCharacter::updateMotions(e_update_t update_type)
 	else
 	{
 		LL_RECORD_BLOCK_TIME(FTM_UPDATE_ANIMATION);
-		// unpause if the number of outstanding pause requests has dropped to the initial one
-		if (mMotionController.isPaused() && mPauseRequest->getNumRefs() == 1)
-		{
-			mMotionController.unpauseAllMotions();
-		}
+		checkUnpause();
 		bool force_update = (update_type == FORCE_UPDATE);
 		{
 			LL_RECORD_BLOCK_TIME(FTM_UPDATE_MOTIONS);
@@ -223,6 +224,90 @@ void LLCharacter::updateMotions(e_update_t update_type)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// prepareMotions()
+//-----------------------------------------------------------------------------
+bool LLCharacter::prepareMotions(e_update_t update_type)
+{
+	if (update_type == HIDDEN_UPDATE)
+	{
+		updateMotions(update_type);
+		return false;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_UPDATE_ANIMATION);
+	checkUnpause();
+	mMotionsPrepared = mMotionController.prepareUpdate(update_type == FORCE_UPDATE);
+
+	// motions only get activated in prepareUpdate(), so this holds until
+	// the commit
+	if (mMotionsPrepared && !mMotionController.canUpdateOffThread())
+	{
+		LL_RECORD_BLOCK_TIME(FTM_UPDATE_MOTIONS);
+		mMotionController.evaluateMotions();
+		mMotionsPrepared = false;
+		return false;
+	}
+	// even without motions to evaluate the skeleton is updated in parallel
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// evaluateMotions()
+//-----------------------------------------------------------------------------
+void LLCharacter::evaluateMotions()
+{
+	if (mMotionsPrepared)
+	{
+		LL_RECORD_BLOCK_TIME(FTM_UPDATE_MOTIONS);
+		mMotionController.evaluateMotions(true);
+	}
+
+	updateWorldMatrices();
+}
+
+//-----------------------------------------------------------------------------
+// updateWorldMatrices()
+//-----------------------------------------------------------------------------
+void LLCharacter::updateWorldMatrices()
+{
+	LLJoint* root = getRootJoint();
+	if (!root)
+	{
+		return;
+	}
+
+	if (!mSkeletonTransforms)
+	{
+		mSkeletonTransforms = new LLSkeletonTransforms;
+	}
+	mSkeletonTransforms->update(root);
+}
+
+//-----------------------------------------------------------------------------
+// commitMotions()
+//-----------------------------------------------------------------------------
+void LLCharacter::commitMotions()
+{
+	if (mMotionsPrepared)
+	{
+		mMotionsPrepared = false;
+		mMotionController.commitUpdate();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// checkUnpause()
+//-----------------------------------------------------------------------------
+void LLCharacter::checkUnpause()
+{
+	// unpause if the number of outstanding pause requests has dropped to the initial one
+	if (mMotionController.isPaused() && mPauseRequest->getNumRefs() == 1)
+	{
+		mMotionController.unpauseAllMotions();
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // deactivateAllMotions()
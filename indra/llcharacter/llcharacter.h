@@ -40,6 +40,7 @@
 #include "llrefcount.h"
 
 class LLPolyMesh;
+class LLSkeletonTransforms;
 
 class LLPauseRequestHandle : public LLThreadSafeRefCount
 {
@@ -161,6 +162,20 @@ public:
 	enum e_update_t { NORMAL_UPDATE, HIDDEN_UPDATE, FORCE_UPDATE };
 	void updateMotions(e_update_t update_type);
 
+	// updateMotions() split around the part that may run on an animation
+	// thread, see LLMotionEvaluator.  prepareMotions() returns false if it
+	// updated the motions right away, as it does for hidden updates and when
+	// an active motion has to update on the main thread.  Otherwise
+	// evaluateMotions() follows on one thread, which then owns the character
+	// until commitMotions() on the main thread.
+	bool prepareMotions(e_update_t update_type);
+	void evaluateMotions();
+	void commitMotions();
+
+	// updates the world matrices of the joints under getRootJoint() like
+	// updateWorldMatrixChildren() does, through LLSkeletonTransforms
+	void updateWorldMatrices();
+
 	LLAnimPauseRequest requestPause();
 	BOOL areAnimationsPaused() const { return mMotionController.isPaused(); }
 	void setAnimTimeFactor(F32 factor) { mMotionController.setTimeFactor(factor); }
@@ -283,6 +298,11 @@ protected:
 	LLAnimPauseRequest	mPauseRequest;
 
 private:
+	void checkUnpause();
+
+	bool				mMotionsPrepared;
+	LLSkeletonTransforms*	mSkeletonTransforms;
+
 	// visual parameter stuff
 	typedef std::map<S32, LLVisualParam *> 		visual_param_index_map_t;
 	typedef std::map<char *, LLVisualParam *> 	visual_param_name_map_t;
@@ -116,6 +116,8 @@ public:
 	// must return FALSE when the motion is completed.
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
 
+	virtual BOOL canUpdateOffThread() { return TRUE; }
+
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
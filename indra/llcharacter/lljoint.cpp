@@ -33,6 +33,7 @@
 
 #include "llmath.h"
 #include "llcallstack.h"
+#include "llskeletontransforms.h"
 #include <boost/algorithm/string.hpp>
 
 //<FS:ND> Query by JointKey rather than just a string, the key can be a U32 index for faster lookup
@@ -57,8 +58,8 @@ JointKey JointKey::construct( std::string aName )
 }
 // </FS:ND>
 
-S32 LLJoint::sNumUpdates = 0;
-S32 LLJoint::sNumTouches = 0;
+LLAtomicS32 LLJoint::sNumUpdates(0);
+LLAtomicS32 LLJoint::sNumTouches(0);
 
 template <class T> 
 bool attachment_map_iter_compare_key(const T& a, const T& b)
@@ -128,6 +129,8 @@ void LLJoint::init()
 {
 	mName = "unnamed";
 	mParent = NULL;
+	mTransforms = NULL;
+	mTransformIndex = -1;
 	mXform.setScaleChildOffset(TRUE);
 	mXform.setScale(LLVector3(1.0f, 1.0f, 1.0f));
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
@@ -178,6 +181,10 @@ LLJoint::~LLJoint()
 	{
 		mParent->removeChild( this );
 	}
+	if (mTransforms)
+	{
+		mTransforms->invalidate();
+	}
 	removeAllChildren();
 }
 
@@ -296,6 +303,11 @@ void LLJoint::addChild(LLJoint* joint)
 	if (joint->mParent)
 		joint->mParent->removeChild(joint);
 
+	if (mTransforms)
+	{
+		mTransforms->invalidate();
+	}
+
 	mChildren.push_back(joint);
 	joint->mXform.setParent(&mXform);
 	joint->mParent = this;	
@@ -312,6 +324,11 @@ void LLJoint::removeChild(LLJoint* joint)
 	if (iter != mChildren.end())
 	{
 		mChildren.erase(iter);
+
+		if (joint->mTransforms)
+		{
+			joint->mTransforms->invalidate();
+		}
 	
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
@@ -331,6 +348,10 @@ void LLJoint::removeAllChildren()
 		child_list_t::iterator curiter = iter++;
 		LLJoint* joint = *curiter;
 		mChildren.erase(curiter);
+		if (joint->mTransforms)
+		{
+			joint->mTransforms->invalidate();
+		}
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
 		joint->touch();
@@ -969,6 +990,23 @@ void LLJoint::setWorldMatrix( const LLMatrix4& mat )
 	setWorldRotation( rot );
 }
 
+//--------------------------------------------------------------------
+// loadWorldMatrix()
+//--------------------------------------------------------------------
+void LLJoint::loadWorldMatrix( LLMatrix4a& mat )
+{
+	updateWorldMatrixParent();
+
+	if (mTransforms)
+	{
+		mat = mTransforms->getWorldMatrix(mTransformIndex);
+	}
+	else
+	{
+		mat.loadu(mXform.getWorldMatrix());
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateWorldMatrixParent()
 //-----------------------------------------------------------------------------
@@ -1032,6 +1070,10 @@ void LLJoint::updateWorldMatrix()
 		sNumUpdates++;
 		mXform.updateMatrix(FALSE);
 		mDirtyFlags = 0x0;
+		if (mTransforms)
+		{
+			mTransforms->copyFromJoint(mTransformIndex);
+		}
 	}
 }
 
@@ -33,12 +33,16 @@
 #include <string>
 #include <list>
 
+#include "llatomic.h"
 #include "v3math.h"
 #include "v4math.h"
 #include "m4math.h"
 #include "llquaternion.h"
 #include "xform.h"
 
+class LLMatrix4a;
+class LLSkeletonTransforms;
+
 //<FS:ND> Query by JointKey rather than just a string, the key can be a U32 index for faster lookup
 struct JointKey
 {
@@ -140,6 +144,11 @@ protected:
 
     LLVector3       mDefaultPosition;
     LLVector3       mDefaultScale;
+
+	// the flattened hierarchy the joint is in, if any, and where
+	friend class LLSkeletonTransforms;
+	LLSkeletonTransforms* mTransforms;
+	S32				mTransformIndex;
     
 public:
 	U32				mDirtyFlags;
@@ -158,9 +167,9 @@ public:
 	typedef std::list<LLJoint*> child_list_t;
 	child_list_t mChildren;
 
-	// debug statics
-	static S32		sNumTouches;
-	static S32		sNumUpdates;
+	// debug statics, counted from the motion threads as well
+	static LLAtomicS32	sNumTouches;
+	static LLAtomicS32	sNumUpdates;
     typedef std::set<std::string> debug_joint_name_t;
     static debug_joint_name_t s_debugJointNames;
     static void setDebugJointNames(const debug_joint_name_t& names);
@@ -272,6 +281,8 @@ public:
 	// get/set world matrix
 	const LLMatrix4 &getWorldMatrix();
 	void setWorldMatrix( const LLMatrix4& mat );
+	// getWorldMatrix(), from the skeleton transforms when the joint is in one
+	void loadWorldMatrix( LLMatrix4a& mat );
 
 	void updateWorldMatrixChildren();
 	void updateWorldMatrixParent();
@@ -0,0 +1,551 @@
+/**
+ * @file llkeyframecurves.cpp
+ * @brief LLKeyframeCurves class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llkeyframecurves.h"
+
+#include <algorithm>
+
+#include "llkeyframemotion.h"
+
+#include "llmath.h"
+#include "llquaternion.h"
+#include "llsimdmath.h"
+#include "v3math.h"
+
+namespace
+{
+	inline LLQuad gather(const std::vector<F32>& values, const S32* keys)
+	{
+		return _mm_setr_ps(values[keys[0]], values[keys[1]], values[keys[2]], values[keys[3]]);
+	}
+
+	inline LLQuad select(LLQuad mask, LLQuad a, LLQuad b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	template<typename T>
+	inline U32 vector_bytes(const std::vector<T>& v)
+	{
+		return v.capacity() * sizeof(T);
+	}
+}
+
+LLKeyframeCurves::LLKeyframeCurves()
+:	mAddingRotations(false)
+{
+}
+
+void LLKeyframeCurves::beginCurve(EChannel channel, U32 joint_index, bool step)
+{
+	mAddingRotations = channel == ROTATION;
+	(mAddingRotations ? mRotations : mVectors).beginCurve(channel, joint_index, step);
+}
+
+void LLKeyframeCurves::addKey(F32 time, const LLQuaternion& rotation)
+{
+	llassert(mAddingRotations);
+	mRotations.addKey(time, rotation.mQ[VX], rotation.mQ[VY], rotation.mQ[VZ], rotation.mQ[VW]);
+}
+
+void LLKeyframeCurves::addKey(F32 time, const LLVector3& value)
+{
+	llassert(!mAddingRotations);
+	mVectors.addKey(time, value.mV[VX], value.mV[VY], value.mV[VZ], 0.f);
+}
+
+LLKeyframeCurves::EChannel LLKeyframeCurves::getChannel(U32 curve) const
+{
+	U32 rotations = getNumRotationCurves();
+	return (EChannel) (curve < rotations ? mRotations.mChannels[curve] : mVectors.mChannels[curve - rotations]);
+}
+
+U32 LLKeyframeCurves::getJointIndex(U32 curve) const
+{
+	U32 rotations = getNumRotationCurves();
+	return curve < rotations ? mRotations.mJointIndices[curve] : mVectors.mJointIndices[curve - rotations];
+}
+
+void LLKeyframeCurves::evaluate(F32 time, LLQuaternion* rotations, LLVector3* vectors) const
+{
+	evaluateRotations(time, rotations);
+	evaluateVectors(time, vectors);
+}
+
+U32 LLKeyframeCurves::getMemoryUsage() const
+{
+	U32 bytes = sizeof(LLKeyframeCurves);
+	const Group* groups[] = { &mRotations, &mVectors };
+	for (S32 i = 0; i < 2; ++i)
+	{
+		const Group& group = *groups[i];
+		bytes += vector_bytes(group.mChannels) + vector_bytes(group.mJointIndices)
+			+ vector_bytes(group.mStep) + vector_bytes(group.mFirstKey)
+			+ vector_bytes(group.mTimes) + vector_bytes(group.mX) + vector_bytes(group.mY)
+			+ vector_bytes(group.mZ) + vector_bytes(group.mW);
+	}
+	return bytes;
+}
+
+void LLKeyframeCurves::Group::beginCurve(EChannel channel, U32 joint_index, bool step)
+{
+	// the last curve needs its keys before the next one starts
+	llassert(mFirstKey.empty() || mFirstKey.back() < mTimes.size());
+
+	mChannels.push_back((U8) channel);
+	mJointIndices.push_back(joint_index);
+	mStep.push_back(step ? 1 : 0);
+	mFirstKey.push_back(mTimes.size());
+}
+
+void LLKeyframeCurves::Group::addKey(F32 time, F32 x, F32 y, F32 z, F32 w)
+{
+	llassert(!mFirstKey.empty());
+	llassert(mTimes.size() == mFirstKey.back() || mTimes.back() < time);
+
+	mTimes.push_back(time);
+	mX.push_back(x);
+	mY.push_back(y);
+	mZ.push_back(z);
+	mW.push_back(w);
+}
+
+void LLKeyframeCurves::Group::findKeys(U32 curve, F32 time, S32& before, S32& after, F32& u) const
+{
+	S32 first = mFirstKey[curve];
+	S32 end = curve + 1 < mFirstKey.size() ? mFirstKey[curve + 1] : mTimes.size();
+	llassert(first < end);
+
+	const F32* times = &mTimes[0];
+	const F32* right = std::lower_bound(times + first, times + end, time);
+	S32 key = right - times;
+	u = 0.f;
+	if (key == end)
+	{
+		// past last key
+		before = after = end - 1;
+	}
+	else if (key == first || *right == time)
+	{
+		// before first key or exactly on a key
+		before = after = key;
+	}
+	else if (mStep[curve])
+	{
+		before = after = key - 1;
+	}
+	else
+	{
+		// between two keys
+		before = key - 1;
+		after = key;
+		u = (time - times[before]) / (times[after] - times[before]);
+	}
+}
+
+// Four curves at a time, the way nlerp() does one: a normalized lerp where
+// the keys are in the same hemisphere, else slerp(), which is rare enough to
+// leave to LLQuaternion.
+void LLKeyframeCurves::evaluateRotations(F32 time, LLQuaternion* rotations) const
+{
+	const Group& group = mRotations;
+	const S32 count = group.getNumCurves();
+
+	const LLQuad one = _mm_set1_ps(1.f);
+	const LLQuad zero = _mm_setzero_ps();
+	const LLQuad sign = _mm_set1_ps(-0.f);
+	const LLQuad one_part_in_a_million = _mm_set1_ps(ONE_PART_IN_A_MILLION);
+	const LLQuad mag_threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+
+	for (S32 first = 0; first < count; first += 4)
+	{
+		const S32 lanes = llmin(count - first, 4);
+		S32 before[4];
+		S32 after[4];
+		F32 u[4];
+		for (S32 lane = 0; lane < 4; ++lane)
+		{
+			// spare lanes repeat the last curve
+			group.findKeys(first + llmin(lane, lanes - 1), time, before[lane], after[lane], u[lane]);
+		}
+
+		LLQuad ax = gather(group.mX, before);
+		LLQuad ay = gather(group.mY, before);
+		LLQuad az = gather(group.mZ, before);
+		LLQuad aw = gather(group.mW, before);
+		LLQuad bx = gather(group.mX, after);
+		LLQuad by = gather(group.mY, after);
+		LLQuad bz = gather(group.mZ, after);
+		LLQuad bw = gather(group.mW, after);
+
+		// lerp(), t * b + (1 - t) * a
+		LLQuad t = _mm_loadu_ps(u);
+		LLQuad inv_t = _mm_sub_ps(one, t);
+		LLQuad x = _mm_add_ps(_mm_mul_ps(t, bx), _mm_mul_ps(inv_t, ax));
+		LLQuad y = _mm_add_ps(_mm_mul_ps(t, by), _mm_mul_ps(inv_t, ay));
+		LLQuad z = _mm_add_ps(_mm_mul_ps(t, bz), _mm_mul_ps(inv_t, az));
+		LLQuad w = _mm_add_ps(_mm_mul_ps(t, bw), _mm_mul_ps(inv_t, aw));
+
+		// LLQuaternion::normalize(), which leaves nearly unit quaternions
+		// alone and makes degenerate ones the identity
+		LLQuad mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), _mm_mul_ps(w, w)));
+		LLQuad off_unit = _mm_andnot_ps(sign, _mm_sub_ps(one, mag));
+		LLQuad oomag = select(_mm_cmpgt_ps(off_unit, one_part_in_a_million), _mm_div_ps(one, mag), one);
+		LLQuad valid = _mm_cmpgt_ps(mag, mag_threshold);
+		x = select(valid, _mm_mul_ps(x, oomag), zero);
+		y = select(valid, _mm_mul_ps(y, oomag), zero);
+		z = select(valid, _mm_mul_ps(z, oomag), zero);
+		w = select(valid, _mm_mul_ps(w, oomag), one);
+
+		// keys taken as they are
+		LLQuad exact = _mm_castsi128_ps(_mm_cmpeq_epi32(
+			_mm_loadu_si128((const __m128i*) before), _mm_loadu_si128((const __m128i*) after)));
+		x = select(exact, ax, x);
+		y = select(exact, ay, y);
+		z = select(exact, az, z);
+		w = select(exact, aw, w);
+
+		LLQuad dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+		S32 opposite = _mm_movemask_ps(_mm_andnot_ps(exact, _mm_cmplt_ps(dot, zero)));
+
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		LLQuaternion* out = rotations + first;
+		_mm_storeu_ps(out[0].mQ, x);
+		if (lanes > 1) _mm_storeu_ps(out[1].mQ, y);
+		if (lanes > 2) _mm_storeu_ps(out[2].mQ, z);
+		if (lanes > 3) _mm_storeu_ps(out[3].mQ, w);
+
+		for (S32 lane = 0; opposite && lane < lanes; ++lane)
+		{
+			if (opposite & (1 << lane))
+			{
+				LLQuaternion a;
+				LLQuaternion b;
+				a.mQ[VX] = group.mX[before[lane]];
+				a.mQ[VY] = group.mY[before[lane]];
+				a.mQ[VZ] = group.mZ[before[lane]];
+				a.mQ[VW] = group.mW[before[lane]];
+				b.mQ[VX] = group.mX[after[lane]];
+				b.mQ[VY] = group.mY[after[lane]];
+				b.mQ[VZ] = group.mZ[after[lane]];
+				b.mQ[VW] = group.mW[after[lane]];
+				out[lane] = slerp(u[lane], a, b);
+			}
+		}
+	}
+}
+
+void LLKeyframeCurves::evaluateVectors(F32 time, LLVector3* vectors) const
+{
+	const Group& group = mVectors;
+	const S32 count = group.getNumCurves();
+
+	for (S32 first = 0; first < count; first += 4)
+	{
+		const S32 lanes = llmin(count - first, 4);
+		S32 before[4];
+		S32 after[4];
+		F32 u[4];
+		for (S32 lane = 0; lane < 4; ++lane)
+		{
+			// spare lanes repeat the last curve
+			group.findKeys(first + llmin(lane, lanes - 1), time, before[lane], after[lane], u[lane]);
+		}
+
+		// lerp(), a + (b - a) * u
+		LLQuad t = _mm_loadu_ps(u);
+		LLQuad ax = gather(group.mX, before);
+		LLQuad ay = gather(group.mY, before);
+		LLQuad az = gather(group.mZ, before);
+		LLQuad x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(gather(group.mX, after), ax), t));
+		LLQuad y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(gather(group.mY, after), ay), t));
+		LLQuad z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(gather(group.mZ, after), az), t));
+
+		F32 values[3][4];
+		_mm_storeu_ps(values[0], x);
+		_mm_storeu_ps(values[1], y);
+		_mm_storeu_ps(values[2], z);
+		for (S32 lane = 0; lane < lanes; ++lane)
+		{
+			vectors[first + lane].set(values[0][lane], values[1][lane], values[2][lane]);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// ****LLKeyframeMotion's curve classes, the keys LLKeyframeCurves is
+// compiled from, kept here so both can be tested without the motion
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+
+//-----------------------------------------------------------------------------
+// ScaleCurve::ScaleCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::ScaleCurve::ScaleCurve()
+{
+	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// ScaleCurve::~ScaleCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::ScaleCurve::~ScaleCurve() 
+{
+	mKeys.clear();
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// getValue()
+//-----------------------------------------------------------------------------
+LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+{
+	LLVector3 value;
+
+	if (mKeys.empty())
+	{
+		value.clearVec();
+		return value;
+	}
+	
+	key_map_t::iterator right = mKeys.lower_bound(time);
+	if (right == mKeys.end())
+	{
+		// Past last key
+		--right;
+		value = right->second.mScale;
+	}
+	else if (right == mKeys.begin() || right->first == time)
+	{
+		// Before first key or exactly on a key
+		value = right->second.mScale;
+	}
+	else
+	{
+		// Between two keys
+		key_map_t::iterator left = right; --left;
+		F32 index_before = left->first;
+		F32 index_after = right->first;
+		ScaleKey& scale_before = left->second;
+		ScaleKey& scale_after = right->second;
+		if (right == mKeys.end())
+		{
+			scale_after = mLoopInKey;
+			index_after = duration;
+		}
+
+		F32 u = (time - index_before) / (index_after - index_before);
+		value = interp(u, scale_before, scale_after);
+	}
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// interp()
+//-----------------------------------------------------------------------------
+LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey& after)
+{
+	switch (mInterpolationType)
+	{
+	case IT_STEP:
+		return before.mScale;
+
+	default:
+	case IT_LINEAR:
+	case IT_SPLINE:
+		return lerp(before.mScale, after.mScale, u);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// RotationCurve::RotationCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::RotationCurve::RotationCurve()
+{
+	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// RotationCurve::~RotationCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::RotationCurve::~RotationCurve()
+{
+	mKeys.clear();
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// RotationCurve::getValue()
+//-----------------------------------------------------------------------------
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
+{
+	LLQuaternion value;
+
+	if (mKeys.empty())
+	{
+		value = LLQuaternion::DEFAULT;
+		return value;
+	}
+	
+	key_map_t::iterator right = mKeys.lower_bound(time);
+	if (right == mKeys.end())
+	{
+		// Past last key
+		--right;
+		value = right->second.mRotation;
+	}
+	else if (right == mKeys.begin() || right->first == time)
+	{
+		// Before first key or exactly on a key
+		value = right->second.mRotation;
+	}
+	else
+	{
+		// Between two keys
+		key_map_t::iterator left = right; --left;
+		F32 index_before = left->first;
+		F32 index_after = right->first;
+		RotationKey& rot_before = left->second;
+		RotationKey& rot_after = right->second;
+		if (right == mKeys.end())
+		{
+			rot_after = mLoopInKey;
+			index_after = duration;
+		}
+
+		F32 u = (time - index_before) / (index_after - index_before);
+		value = interp(u, rot_before, rot_after);
+	}
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// interp()
+//-----------------------------------------------------------------------------
+LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before, RotationKey& after)
+{
+	switch (mInterpolationType)
+	{
+	case IT_STEP:
+		return before.mRotation;
+
+	default:
+	case IT_LINEAR:
+	case IT_SPLINE:
+		return nlerp(u, before.mRotation, after.mRotation);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// PositionCurve::PositionCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::PositionCurve::PositionCurve()
+{
+	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// PositionCurve::~PositionCurve()
+//-----------------------------------------------------------------------------
+LLKeyframeMotion::PositionCurve::~PositionCurve()
+{
+	mKeys.clear();
+	mNumKeys = 0;
+}
+
+//-----------------------------------------------------------------------------
+// PositionCurve::getValue()
+//-----------------------------------------------------------------------------
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+{
+	LLVector3 value;
+
+	if (mKeys.empty())
+	{
+		value.clearVec();
+		return value;
+	}
+	
+	key_map_t::iterator right = mKeys.lower_bound(time);
+	if (right == mKeys.end())
+	{
+		// Past last key
+		--right;
+		value = right->second.mPosition;
+	}
+	else if (right == mKeys.begin() || right->first == time)
+	{
+		// Before first key or exactly on a key
+		value = right->second.mPosition;
+	}
+	else
+	{
+		// Between two keys
+		key_map_t::iterator left = right; --left;
+		F32 index_before = left->first;
+		F32 index_after = right->first;
+		PositionKey& pos_before = left->second;
+		PositionKey& pos_after = right->second;
+		if (right == mKeys.end())
+		{
+			pos_after = mLoopInKey;
+			index_after = duration;
+		}
+
+		F32 u = (time - index_before) / (index_after - index_before);
+		value = interp(u, pos_before, pos_after);
+	}
+
+	llassert(value.isFinite());
+	
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// interp()
+//-----------------------------------------------------------------------------
+LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, PositionKey& after)
+{
+	switch (mInterpolationType)
+	{
+	case IT_STEP:
+		return before.mPosition;
+	default:
+	case IT_LINEAR:
+	case IT_SPLINE:
+		return lerp(before.mPosition, after.mPosition, u);
+	}
+}
@@ -0,0 +1,113 @@
+/**
+ * @file llkeyframecurves.h
+ * @brief LLKeyframeCurves class, the keyframe curves of an animation
+ * compiled for evaluation.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLKEYFRAMECURVES_H
+#define LL_LLKEYFRAMECURVES_H
+
+#include <vector>
+
+class LLQuaternion;
+class LLVector3;
+
+// All the rotation, position and scale curves of one animation, flattened
+// into arrays: the key times of every curve back to back, and the key values
+// the same way with each component in an array of its own.  Built once when
+// the animation loads and shared, read only, by every motion playing it.
+//
+// evaluate() samples every curve at once, binary searching each curve's
+// times and interpolating four curves at a time.  The results match
+// LLKeyframeMotion's per curve getValue().
+class LLKeyframeCurves
+{
+public:
+	enum EChannel
+	{
+		ROTATION,
+		POSITION,
+		SCALE
+	};
+
+	LLKeyframeCurves();
+
+	// Starts a curve for one channel of the joint at joint_index, its keys,
+	// at least one, follow in increasing time order.  A step curve holds
+	// each key until the next one instead of interpolating.
+	void beginCurve(EChannel channel, U32 joint_index, bool step);
+	void addKey(F32 time, const LLQuaternion& rotation);
+	void addKey(F32 time, const LLVector3& value);
+
+	// Rotation curves come first, in the order they were added, then
+	// positions and scales.
+	U32 getNumCurves() const				{ return getNumRotationCurves() + getNumVectorCurves(); }
+	U32 getNumRotationCurves() const		{ return mRotations.getNumCurves(); }
+	U32 getNumVectorCurves() const			{ return mVectors.getNumCurves(); }
+	EChannel getChannel(U32 curve) const;
+	U32 getJointIndex(U32 curve) const;
+
+	// Samples every curve at time.  rotations needs room for
+	// getNumRotationCurves() values and vectors for getNumVectorCurves().
+	void evaluate(F32 time, LLQuaternion* rotations, LLVector3* vectors) const;
+
+	U32 getNumKeys() const					{ return mRotations.mTimes.size() + mVectors.mTimes.size(); }
+	U32 getMemoryUsage() const;
+
+private:
+	struct Group
+	{
+		U32 getNumCurves() const			{ return mChannels.size(); }
+
+		void beginCurve(EChannel channel, U32 joint_index, bool step);
+		void addKey(F32 time, F32 x, F32 y, F32 z, F32 w);
+
+		// finds the keys on either side of time on curve, before and after
+		// are the same key where the curve doesn't interpolate
+		void findKeys(U32 curve, F32 time, S32& before, S32& after, F32& u) const;
+
+		// per curve, each curve's keys run to the next curve's first key
+		std::vector<U8>		mChannels;
+		std::vector<U32>	mJointIndices;
+		std::vector<U8>		mStep;
+		std::vector<U32>	mFirstKey;
+
+		// per key
+		std::vector<F32>	mTimes;
+		std::vector<F32>	mX;
+		std::vector<F32>	mY;
+		std::vector<F32>	mZ;
+		std::vector<F32>	mW;
+	};
+
+	void evaluateRotations(F32 time, LLQuaternion* rotations) const;
+	void evaluateVectors(F32 time, LLVector3* vectors) const;
+
+	Group	mRotations;
+	Group	mVectors;
+	// which group beginCurve() last started a curve in
+	bool	mAddingRotations;
+};
+
+#endif // LL_LLKEYFRAMECURVES_H
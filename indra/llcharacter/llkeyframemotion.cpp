@@ -117,308 +117,58 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 			total_size += joint_motion_p->mPositionCurve.mNumKeys * sizeof(PositionKey);
 		}
 	}
-	LL_INFOS() << "Size: " << total_size << " bytes" << LL_ENDL;
+	LL_INFOS() << "\t" << mCurves.getNumKeys() << " compiled keys at " 
+		<< mCurves.getMemoryUsage() << " bytes" << LL_ENDL;
 
-	return total_size;
-}
+	total_size += mCurves.getMemoryUsage();
 
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-// ****Curve classes
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-
-
-//-----------------------------------------------------------------------------
-// ScaleCurve::ScaleCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::ScaleCurve::ScaleCurve()
-{
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
-}
+	LL_INFOS() << "Size: " << total_size << " bytes" << LL_ENDL;
 
-//-----------------------------------------------------------------------------
-// ScaleCurve::~ScaleCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::ScaleCurve::~ScaleCurve() 
-{
-	mKeys.clear();
-	mNumKeys = 0;
+	return total_size;
 }
 
-//-----------------------------------------------------------------------------
-// getValue()
-//-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+void LLKeyframeMotion::JointMotionList::compileCurves()
 {
-	LLVector3 value;
-
-	if (mKeys.empty())
-	{
-		value.clearVec();
-		return value;
-	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mScale;
-	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mScale;
-	}
-	else
+	llassert(!mCurves.getNumCurves());
+	for (U32 i = 0; i < getNumJointMotions(); i++)
 	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
+		JointMotion* joint_motion = mJointMotionArray[i];
+
+		RotationCurve& rot_curve = joint_motion->mRotationCurve;
+		if (!rot_curve.mKeys.empty())
 		{
-			scale_after = mLoopInKey;
-			index_after = duration;
+			mCurves.beginCurve(LLKeyframeCurves::ROTATION, i, rot_curve.mInterpolationType == IT_STEP);
+			for (RotationCurve::key_map_t::iterator iter = rot_curve.mKeys.begin();
+				 iter != rot_curve.mKeys.end(); ++iter)
+			{
+				mCurves.addKey(iter->first, iter->second.mRotation);
+			}
 		}
 
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
-	}
-	return value;
-}
-
-//-----------------------------------------------------------------------------
-// interp()
-//-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey& after)
-{
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mScale;
-
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return lerp(before.mScale, after.mScale, u);
-	}
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::RotationCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::RotationCurve::RotationCurve()
-{
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::~RotationCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::RotationCurve::~RotationCurve()
-{
-	mKeys.clear();
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::getValue()
-//-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
-{
-	LLQuaternion value;
-
-	if (mKeys.empty())
-	{
-		value = LLQuaternion::DEFAULT;
-		return value;
-	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mRotation;
-	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mRotation;
-	}
-	else
-	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
+		PositionCurve& pos_curve = joint_motion->mPositionCurve;
+		if (!pos_curve.mKeys.empty())
 		{
-			rot_after = mLoopInKey;
-			index_after = duration;
+			mCurves.beginCurve(LLKeyframeCurves::POSITION, i, pos_curve.mInterpolationType == IT_STEP);
+			for (PositionCurve::key_map_t::iterator iter = pos_curve.mKeys.begin();
+				 iter != pos_curve.mKeys.end(); ++iter)
+			{
+				mCurves.addKey(iter->first, iter->second.mPosition);
+			}
 		}
 
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
-	}
-	return value;
-}
-
-//-----------------------------------------------------------------------------
-// interp()
-//-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before, RotationKey& after)
-{
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mRotation;
-
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return nlerp(u, before.mRotation, after.mRotation);
-	}
-}
-
-
-//-----------------------------------------------------------------------------
-// PositionCurve::PositionCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::PositionCurve::PositionCurve()
-{
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// PositionCurve::~PositionCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::PositionCurve::~PositionCurve()
-{
-	mKeys.clear();
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// PositionCurve::getValue()
-//-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
-{
-	LLVector3 value;
-
-	if (mKeys.empty())
-	{
-		value.clearVec();
-		return value;
-	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mPosition;
-	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mPosition;
-	}
-	else
-	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
+		ScaleCurve& scale_curve = joint_motion->mScaleCurve;
+		if (!scale_curve.mKeys.empty())
 		{
-			pos_after = mLoopInKey;
-			index_after = duration;
+			mCurves.beginCurve(LLKeyframeCurves::SCALE, i, scale_curve.mInterpolationType == IT_STEP);
+			for (ScaleCurve::key_map_t::iterator iter = scale_curve.mKeys.begin();
+				 iter != scale_curve.mKeys.end(); ++iter)
+			{
+				mCurves.addKey(iter->first, iter->second.mScale);
+			}
 		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
-	}
-
-	llassert(value.isFinite());
-	
-	return value;
-}
-
-//-----------------------------------------------------------------------------
-// interp()
-//-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, PositionKey& after)
-{
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mPosition;
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return lerp(before.mPosition, after.mPosition, u);
-	}
-}
-
-
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-// JointMotion class
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// JointMotion::update()
-//-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
-{
-	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
-	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
-	if ( joint_state == NULL )
-	{
-		return;
-	}
-
-	U32 usage = joint_state->getUsage();
-
-	//-------------------------------------------------------------------------
-	// update scale component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
-	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
-	}
-
-	//-------------------------------------------------------------------------
-	// update rotation component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
-	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
-	}
-
-	//-------------------------------------------------------------------------
-	// update position component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
-	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
 	}
 }
 
-
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLKeyframeMotion class
@@ -729,11 +479,50 @@ BOOL LLKeyframeMotion::onUpdate(F32 time, U8* joint_mask)
 void LLKeyframeMotion::applyKeyframes(F32 time)
 {
 	llassert_always (mJointMotionList->getNumJointMotions() <= mJointStates.size());
-	for (U32 i=0; i<mJointMotionList->getNumJointMotions(); i++)
+
+	// every curve at once, then into the joint states that use them
+	const LLKeyframeCurves& curves = mJointMotionList->mCurves;
+	U32 num_rotations = curves.getNumRotationCurves();
+	mCurveRotations.resize(num_rotations);
+	mCurveVectors.resize(curves.getNumVectorCurves());
+	if (curves.getNumCurves())
 	{
-		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
-													  time, 
-													  mJointMotionList->mDuration );
+		curves.evaluate(time,
+						mCurveRotations.empty() ? NULL : &mCurveRotations[0],
+						mCurveVectors.empty() ? NULL : &mCurveVectors[0]);
+	}
+
+	for (U32 i = 0; i < curves.getNumCurves(); i++)
+	{
+		LLJointState* joint_state = mJointStates[curves.getJointIndex(i)];
+		// this being 0 was the cause of https://jira.lindenlab.com/browse/SL-22678
+		if (!joint_state)
+		{
+			continue;
+		}
+
+		U32 usage = joint_state->getUsage();
+		switch (curves.getChannel(i))
+		{
+		case LLKeyframeCurves::ROTATION:
+			if (usage & LLJointState::ROT)
+			{
+				joint_state->setRotation(mCurveRotations[i]);
+			}
+			break;
+		case LLKeyframeCurves::POSITION:
+			if (usage & LLJointState::POS)
+			{
+				joint_state->setPosition(mCurveVectors[i - num_rotations]);
+			}
+			break;
+		case LLKeyframeCurves::SCALE:
+			if (usage & LLJointState::SCALE)
+			{
+				joint_state->setScale(mCurveVectors[i - num_rotations]);
+			}
+			break;
+		}
 	}
 
 	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
@@ -1922,6 +1711,8 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		}
 	}
 
+	mJointMotionList->compileCurves();
+
 	// *FIX: support cleanup of old keyframe data
 	LLKeyframeDataCache::addKeyframeData(getID(),  mJointMotionList);
 	mAssetStatus = ASSET_LOADED;
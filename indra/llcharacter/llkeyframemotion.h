@@ -37,6 +37,7 @@
 #include "llbboxlocal.h"
 #include "llhandmotion.h"
 #include "lljointstate.h"
+#include "llkeyframecurves.h"
 #include "llmotion.h"
 #include "llquaternion.h"
 #include "v3dmath.h"
@@ -136,6 +137,8 @@ public:
 	// must return FALSE when the motion is completed.
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
 
+	virtual BOOL canUpdateOffThread() { return TRUE; }
+
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
@@ -381,8 +384,6 @@ public:
 		std::string		mJointName;
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
-
-		void update(LLJointState* joint_state, F32 time, F32 duration);
 	};
 	
 	//-------------------------------------------------------------------------
@@ -408,10 +409,14 @@ public:
 		// TODO: LLKeyframeDataCache::getKeyframeData should probably return a class containing 
 		// JointMotionList and mEmoteName, see LLKeyframeMotion::onInitialize.
 		std::string				mEmoteName; 
+		// the curves of all joint motions as applyKeyframes() evaluates them
+		LLKeyframeCurves		mCurves;
 	public:
 		JointMotionList();
 		~JointMotionList();
 		U32 dumpDiagInfo();
+		// call once the curves are loaded
+		void compileCurves();
 		JointMotion* getJointMotion(U32 index) const { llassert(index < mJointMotionArray.size()); return mJointMotionArray[index]; }
 		U32 getNumJointMotions() const { return mJointMotionArray.size(); }
 	};
@@ -425,6 +430,9 @@ protected:
 	//-------------------------------------------------------------------------
 	JointMotionList*				mJointMotionList;
 	std::vector<LLPointer<LLJointState> > mJointStates;
+	// what applyKeyframes() samples from mJointMotionList->mCurves
+	std::vector<LLQuaternion>		mCurveRotations;
+	std::vector<LLVector3>			mCurveVectors;
 	LLJoint*						mPelvisp;
 	LLCharacter*					mCharacter;
 	typedef std::list<JointConstraint*>	constraint_list_t;
@@ -103,6 +103,7 @@ public:
 	virtual BOOL onActivate();
 	virtual void onDeactivate();
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
+	virtual BOOL canUpdateOffThread() { return TRUE; }
 	virtual LLJoint::JointPriority getPriority(){return LLJoint::HIGH_PRIORITY;}
 	virtual BOOL getLoop() { return TRUE; }
 	virtual F32 getDuration() { return 0.f; }
@@ -153,6 +154,7 @@ public:
 	virtual BOOL onActivate();
 	virtual void onDeactivate() {};
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
+	virtual BOOL canUpdateOffThread() { return TRUE; }
 	virtual LLJoint::JointPriority getPriority(){return LLJoint::HIGHER_PRIORITY;}
 	virtual BOOL getLoop() { return TRUE; }
 	virtual F32 getDuration() { return 0.f; }
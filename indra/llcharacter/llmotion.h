@@ -153,6 +153,11 @@ public:
 	// requires this
 	virtual BOOL canDeprecate();
 
+	// can onUpdate() run on an animation thread?  it may then only change
+	// this motion, its joint states, the character's joints and visual param
+	// weights and the character's animation data, see LLMotionEvaluator
+	virtual BOOL canUpdateOffThread() { return FALSE; }
+
 	// optional callback routine called when animation deactivated.
 	void	setDeactivateCallback( void (*cb)(void *), void* userdata );
 
@@ -257,6 +262,8 @@ public:
 	// must return FALSE when the motion is completed.
 	/*virtual*/ BOOL onUpdate(F32 activeTime, U8* joint_mask) { return TRUE; }
 
+	/*virtual*/ BOOL canUpdateOffThread() { return TRUE; }
+
 	// called when a motion is deactivated
 	/*virtual*/ void onDeactivate() {}
 };
@@ -139,7 +139,9 @@ LLMotionController::LLMotionController()
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
 	  mLastInterp(0.f),
-	  mIsSelf(FALSE)
+	  mIsSelf(FALSE),
+	  mDeferSideEffects(false),
+	  mVisualParamsDirty(false)
 {
 }
 
@@ -501,7 +503,7 @@ void LLMotionController::updateIdleMotion(LLMotion* motionp)
 {
 	if (motionp->isStopped() && mAnimTime > motionp->getStopTime() + motionp->getEaseOutDuration())
 	{
-		deactivateMotionInstance(motionp);
+		deactivateOnUpdate(motionp);
 	}
 	else if (motionp->isStopped() && mAnimTime > motionp->getStopTime())
 	{
@@ -518,8 +520,7 @@ void LLMotionController::updateIdleMotion(LLMotion* motionp)
 		// this will only be called when an animation stops itself (runs out of time)
 		if (mLastTime <= motionp->mSendStopTimestamp)
 		{
-			mCharacter->requestStopMotion( motionp );
-			stopMotionInstance(motionp, FALSE);
+			requestStopOnUpdate(motionp);
 		}
 	}
 	else if (mAnimTime >= motionp->mActivationTimestamp)
@@ -620,8 +621,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// this will only be called when an animation stops itself (runs out of time)
 				if (mLastTime <= motionp->mSendStopTimestamp)
 				{
-					mCharacter->requestStopMotion( motionp );
-					stopMotionInstance(motionp, FALSE);
+					requestStopOnUpdate(motionp);
 				}
 			}
 
@@ -630,7 +630,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				if (motionp->isStopped() && mAnimTime > motionp->getStopTime() + motionp->getEaseOutDuration())
 				{
 					posep->setWeight(0.f);
-					deactivateMotionInstance(motionp);
+					deactivateOnUpdate(motionp);
 				}
 				continue;
 			}
@@ -657,7 +657,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 			else
 			{
 				posep->setWeight(0.f);
-				deactivateMotionInstance(motionp);
+				deactivateOnUpdate(motionp);
 				continue;
 			}
 		}
@@ -701,8 +701,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// this will only be called when an animation stops itself (runs out of time)
 				if (mLastTime <= motionp->mSendStopTimestamp)
 				{
-					mCharacter->requestStopMotion( motionp );
-					stopMotionInstance(motionp, FALSE);
+					requestStopOnUpdate(motionp);
 				}
 			}
 
@@ -748,8 +747,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// animation has stopped itself due to internal logic
 				// propagate this to the network
 				// as not all viewers are guaranteed to have access to the same logic
-				mCharacter->requestStopMotion( motionp );
-				stopMotionInstance(motionp, FALSE);
+				requestStopOnUpdate(motionp);
 			}
 
 		}
@@ -810,6 +808,19 @@ void LLMotionController::updateLoadingMotions()
 // updateMotion()
 //-----------------------------------------------------------------------------
 void LLMotionController::updateMotions(bool force_update)
+{
+	if (prepareUpdate(force_update))
+	{
+		evaluateMotions();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// prepareUpdate()
+// the part of updateMotions() that stays on the main thread: timing, and
+// loading and activating motions
+//-----------------------------------------------------------------------------
+bool LLMotionController::prepareUpdate(bool force_update)
 {
 	BOOL use_quantum = (mTimeStep != 0.f);
 
@@ -844,7 +855,7 @@ void LLMotionController::updateMotions(bool force_update)
 
 				updateLoadingMotions();
 				
-				return;
+				return false;
 			}
 			
 			// is calculating a new keyframe pose, make sure the last one gets applied
@@ -868,31 +879,133 @@ void LLMotionController::updateMotions(bool force_update)
 	if (mPaused && !force_update)
 	{
 		updateIdleActiveMotions();
+		mHasRunOnce = TRUE;
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// evaluateMotions()
+// runs the active motions and blends their poses into the joints
+//-----------------------------------------------------------------------------
+void LLMotionController::evaluateMotions(bool defer)
+{
+	mDeferSideEffects = defer;
+
+	// update additive motions
+	updateAdditiveMotions();
+			
+	resetJointSignatures();
+	
+	// update all regular motions
+	updateRegularMotions();
+	
+	if (mTimeStep != 0.f)
+	{
+		mPoseBlender.blendAndCache(TRUE);
 	}
 	else
 	{
-		// update additive motions
-		updateAdditiveMotions();
-				
-		resetJointSignatures();
-		
-		// update all regular motions
-		updateRegularMotions();
-		
-		if (use_quantum)
-		{
-			mPoseBlender.blendAndCache(TRUE);
-		}
-		else
-		{
-			mPoseBlender.blendAndApply();
-		}
+		mPoseBlender.blendAndApply();
 	}
 
 	mHasRunOnce = TRUE;
 //	LL_INFOS() << "Motion controller time " << motionTimer.getElapsedTimeF32() << LL_ENDL;
 }
 
+//-----------------------------------------------------------------------------
+// commitUpdate()
+//-----------------------------------------------------------------------------
+void LLMotionController::commitUpdate()
+{
+	mDeferSideEffects = false;
+
+	for (U32 i = 0; i < mDeferredStops.size(); ++i)
+	{
+		mCharacter->requestStopMotion(mDeferredStops[i]);
+	}
+	mDeferredStops.clear();
+
+	// may delete deprecated motions, so after the stop requests
+	for (U32 i = 0; i < mDeferredDeactivations.size(); ++i)
+	{
+		deactivateMotionInstance(mDeferredDeactivations[i]);
+	}
+	mDeferredDeactivations.clear();
+
+	if (mVisualParamsDirty)
+	{
+		mVisualParamsDirty = false;
+		mCharacter->updateVisualParams();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// canUpdateOffThread()
+//-----------------------------------------------------------------------------
+BOOL LLMotionController::canUpdateOffThread()
+{
+	for (motion_list_t::iterator iter = mActiveMotions.begin();
+		 iter != mActiveMotions.end(); ++iter)
+	{
+		if (!(*iter)->canUpdateOffThread())
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// deferVisualParamUpdate()
+//-----------------------------------------------------------------------------
+bool LLMotionController::deferVisualParamUpdate()
+{
+	if (mDeferSideEffects)
+	{
+		mVisualParamsDirty = true;
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// requestStopOnUpdate()
+// a motion ran out of time or stopped itself while updating
+//-----------------------------------------------------------------------------
+void LLMotionController::requestStopOnUpdate(LLMotion* motionp)
+{
+	if (mDeferSideEffects)
+	{
+		// the character may tell the simulator
+		mDeferredStops.push_back(motionp);
+	}
+	else
+	{
+		mCharacter->requestStopMotion(motionp);
+	}
+	stopMotionInstance(motionp, FALSE);
+}
+
+//-----------------------------------------------------------------------------
+// deactivateOnUpdate()
+//-----------------------------------------------------------------------------
+void LLMotionController::deactivateOnUpdate(LLMotion* motionp)
+{
+	if (mDeferSideEffects)
+	{
+		// onDeactivate() may reach past the character, and deprecated
+		// motions get deleted
+		mDeferredDeactivations.push_back(motionp);
+	}
+	else
+	{
+		deactivateMotionInstance(motionp);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateMotionsMinimal()
 // minimal update (e.g. while hidden)
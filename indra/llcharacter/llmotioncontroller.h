@@ -33,6 +33,7 @@
 #include <string>
 #include <map>
 #include <deque>
+#include <vector>
 
 #include "llmotion.h"
 #include "llpose.h"
@@ -134,6 +135,23 @@ public:
 	// minimal update (e.g. while hidden)
 	void updateMotionsMinimal();
 
+	// updateMotions() in steps, for evaluating many characters in parallel,
+	// see LLMotionEvaluator.  prepareUpdate() and commitUpdate() run on the
+	// main thread.  prepareUpdate() returns false if there is nothing to
+	// evaluate this frame, otherwise evaluateMotions() runs next on any one
+	// thread.  With defer, stop requests, deactivations and visual param
+	// updates wait for commitUpdate().
+	bool prepareUpdate(bool force_update);
+	void evaluateMotions(bool defer = false);
+	void commitUpdate();
+
+	// TRUE if every active motion can be updated off the main thread
+	BOOL canUpdateOffThread();
+
+	// for the character's updateVisualParams(), returns true if the update
+	// has to wait for commitUpdate()
+	bool deferVisualParamUpdate();
+
 	void clearBlenders() { mPoseBlender.clearBlenders(); }
 
 	// flush motions
@@ -186,6 +204,8 @@ protected:
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
 	void deactivateStoppedMotions();
+	void requestStopOnUpdate(LLMotion* motionp);
+	void deactivateOnUpdate(LLMotion* motionp);
 
 protected:
 	F32					mTimeFactor;			// 1.f for normal speed
@@ -223,6 +243,12 @@ protected:
 	F32					mLastInterp;
 
 	U8					mJointSignature[2][LL_CHARACTER_MAX_ANIMATED_JOINTS];
+
+	// held back by evaluateMotions(true) for commitUpdate()
+	bool				mDeferSideEffects;
+	bool				mVisualParamsDirty;
+	std::vector<LLMotion*>	mDeferredStops;
+	std::vector<LLMotion*>	mDeferredDeactivations;
 };
 
 //-----------------------------------------------------------------------------
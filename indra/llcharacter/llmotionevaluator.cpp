@@ -0,0 +1,81 @@
+/**
+ * @file llmotionevaluator.cpp
+ * @brief LLMotionEvaluator class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmotionevaluator.h"
+
+#include "llcharacter.h"
+#include "llfasttimer.h"
+
+// below this the workers cost more to wake than they save
+static const S32 MIN_PARALLEL_CHARACTERS = 2;
+
+static LLTrace::BlockTimerStatHandle FTM_EVALUATE_MOTIONS("Evaluate Motions");
+
+namespace
+{
+	struct CharacterBatch
+	{
+		LLCharacter* const*						mCharacters;
+		LLMotionEvaluator::character_func_t	mFunc;
+	};
+
+	void run_character(void* context, S32 index)
+	{
+		CharacterBatch* batch = (CharacterBatch*)context;
+		batch->mFunc(batch->mCharacters[index]);
+	}
+}
+
+static void evaluate_motions(LLCharacter* character)
+{
+	character->evaluateMotions();
+}
+
+LLMotionEvaluator::LLMotionEvaluator(U32 threads)
+:	mFanOut("Motion evaluation", threads)
+{
+}
+
+void LLMotionEvaluator::evaluate(const std::vector<LLCharacter*>& characters)
+{
+	LL_RECORD_BLOCK_TIME(FTM_EVALUATE_MOTIONS);
+
+	run(characters, evaluate_motions);
+}
+
+void LLMotionEvaluator::run(const std::vector<LLCharacter*>& characters, character_func_t func)
+{
+	if (characters.empty())
+	{
+		return;
+	}
+	CharacterBatch batch;
+	batch.mCharacters = &characters[0];
+	batch.mFunc = func;
+	mFanOut.run(characters.size(), run_character, &batch, MIN_PARALLEL_CHARACTERS);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file llmotionevaluator.h
+ * @brief LLMotionEvaluator class, evaluates the motions of many characters
+ * on worker threads.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMOTIONEVALUATOR_H
+#define LL_LLMOTIONEVALUATOR_H
+
+#include <vector>
+
+#include "llfanout.h"
+
+class LLCharacter;
+
+// Runs LLCharacter::evaluateMotions() for a batch of prepared characters,
+// fanned out over the worker threads and the calling thread.
+//
+// While a batch runs, each character - its motion controller, motions,
+// joints and visual params - belongs to the one thread that claimed it.
+// Everything else, other characters and the world included, may only be
+// read, which holds because the main thread is inside evaluate() and can't
+// change it.  Whatever a motion does past its character waits in the
+// motion controller for LLCharacter::commitMotions().
+class LLMotionEvaluator
+{
+public:
+	// no threads evaluates every character on the calling thread
+	LLMotionEvaluator(U32 threads);
+
+	// returns once every character is evaluated
+	void evaluate(const std::vector<LLCharacter*>& characters);
+
+	// Other per character work can share the threads under the same rules,
+	// run() returns once func has been called on every character.
+	typedef void (*character_func_t)(LLCharacter* character);
+	void run(const std::vector<LLCharacter*>& characters, character_func_t func);
+
+	U32 getThreadCount() const					{ return mFanOut.getThreadCount(); }
+
+private:
+	LLFanOut	mFanOut;
+};
+
+#endif // LL_LLMOTIONEVALUATOR_H
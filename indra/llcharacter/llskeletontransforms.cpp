@@ -0,0 +1,296 @@
+/**
+ * @file llskeletontransforms.cpp
+ * @brief LLSkeletonTransforms class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llskeletontransforms.h"
+
+#include "lljoint.h"
+
+// The math below is LLXformMatrix::updateMatrix() four lanes at a time.  It
+// keeps the order of every scalar operation, so the results match the xforms
+// bit for bit whichever way a joint was updated.
+namespace
+{
+	template<int X, int Y, int Z, int W>
+	inline LLQuad swizzle(LLQuad v)
+	{
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X));
+	}
+
+	inline LLQuad splat_w(LLQuad v)
+	{
+		return swizzle<3, 3, 3, 3>(v);
+	}
+
+	// LLQuaternion operator*(a, b)
+	inline LLQuad quat_mul(LLQuad a, LLQuad b)
+	{
+		const LLQuad negate_w = _mm_setr_ps(0.f, 0.f, 0.f, -0.f);
+		LLQuad t1 = _mm_mul_ps(splat_w(b), a);
+		LLQuad t2 = _mm_xor_ps(_mm_mul_ps(swizzle<0, 1, 2, 0>(b), swizzle<3, 3, 3, 0>(a)), negate_w);
+		LLQuad t3 = _mm_xor_ps(_mm_mul_ps(swizzle<1, 2, 0, 1>(b), swizzle<2, 0, 1, 1>(a)), negate_w);
+		LLQuad t4 = _mm_mul_ps(swizzle<2, 0, 1, 2>(b), swizzle<1, 2, 0, 2>(a));
+		return _mm_sub_ps(_mm_add_ps(_mm_add_ps(t1, t2), t3), t4);
+	}
+
+	// LLVector3 operator*(v, q)
+	inline LLQuad quat_rotate(LLQuad v, LLQuad q)
+	{
+		const LLQuad negate_w = _mm_setr_ps(0.f, 0.f, 0.f, -0.f);
+		const LLQuad negate = _mm_set1_ps(-0.f);
+		LLQuad t1 = _mm_xor_ps(_mm_mul_ps(swizzle<3, 3, 3, 0>(q), swizzle<0, 1, 2, 0>(v)), negate_w);
+		LLQuad t2 = _mm_xor_ps(_mm_mul_ps(swizzle<1, 2, 0, 1>(q), swizzle<2, 0, 1, 1>(v)), negate_w);
+		LLQuad t3 = _mm_mul_ps(swizzle<2, 0, 1, 2>(q), swizzle<1, 2, 0, 2>(v));
+		// rx, ry, rz, rw
+		LLQuad r = _mm_sub_ps(_mm_add_ps(t1, t2), t3);
+
+		LLQuad s1 = _mm_mul_ps(_mm_xor_ps(splat_w(r), negate), q);
+		LLQuad s2 = _mm_mul_ps(r, splat_w(q));
+		LLQuad s3 = _mm_mul_ps(swizzle<1, 2, 0, 3>(r), swizzle<2, 0, 1, 3>(q));
+		LLQuad s4 = _mm_mul_ps(swizzle<2, 0, 1, 3>(r), swizzle<1, 2, 0, 3>(q));
+		return _mm_add_ps(_mm_sub_ps(_mm_add_ps(s1, s2), s3), s4);
+	}
+
+	// the rotation and scale rows of LLMatrix4::initAll()
+	inline void matrix_rows(LLQuad q, const LLVector3& scale, LLQuad rows[3])
+	{
+		const LLQuad two = _mm_set1_ps(2.f);
+		const LLQuad one = _mm_set1_ps(1.f);
+
+		// xx yy zz, xy yz xz, xw yw zw
+		LLQuad sq = _mm_mul_ps(q, q);
+		LLQuad cr = _mm_mul_ps(swizzle<0, 1, 0, 3>(q), swizzle<1, 2, 2, 3>(q));
+		LLQuad wq = _mm_mul_ps(q, splat_w(q));
+
+		// yy + zz, xy + zw, xz - yw
+		LLQuad a0 = swizzle<0, 2, 3, 3>(_mm_shuffle_ps(sq, cr, _MM_SHUFFLE(2, 0, 1, 1)));
+		LLQuad b0 = _mm_xor_ps(swizzle<0, 2, 3, 3>(_mm_shuffle_ps(sq, wq, _MM_SHUFFLE(1, 2, 2, 2))),
+							   _mm_setr_ps(0.f, 0.f, -0.f, 0.f));
+		// xy - zw, xx + zz, yz + xw
+		LLQuad a1 = swizzle<0, 2, 1, 1>(_mm_shuffle_ps(cr, sq, _MM_SHUFFLE(0, 0, 1, 0)));
+		LLQuad b1 = _mm_xor_ps(swizzle<0, 2, 1, 1>(_mm_shuffle_ps(wq, sq, _MM_SHUFFLE(2, 2, 0, 2))),
+							   _mm_setr_ps(-0.f, 0.f, 0.f, 0.f));
+		// xz + yw, yz - xw, xx + yy
+		LLQuad a2 = _mm_shuffle_ps(cr, sq, _MM_SHUFFLE(0, 0, 1, 2));
+		LLQuad b2 = _mm_xor_ps(_mm_shuffle_ps(wq, sq, _MM_SHUFFLE(1, 1, 0, 1)),
+							   _mm_setr_ps(0.f, -0.f, 0.f, 0.f));
+
+		LLQuad p0 = _mm_mul_ps(_mm_add_ps(a0, b0), two);
+		LLQuad p1 = _mm_mul_ps(_mm_add_ps(a1, b1), two);
+		LLQuad p2 = _mm_mul_ps(_mm_add_ps(a2, b2), two);
+
+		// 1 - p on the diagonal
+		const LLQuad diag0 = _mm_castsi128_ps(_mm_setr_epi32(-1, 0, 0, 0));
+		const LLQuad diag1 = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, 0));
+		const LLQuad diag2 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, 0));
+		p0 = _mm_or_ps(_mm_and_ps(diag0, _mm_sub_ps(one, p0)), _mm_andnot_ps(diag0, p0));
+		p1 = _mm_or_ps(_mm_and_ps(diag1, _mm_sub_ps(one, p1)), _mm_andnot_ps(diag1, p1));
+		p2 = _mm_or_ps(_mm_and_ps(diag2, _mm_sub_ps(one, p2)), _mm_andnot_ps(diag2, p2));
+
+		rows[0] = _mm_mul_ps(p0, _mm_set1_ps(scale.mV[VX]));
+		rows[1] = _mm_mul_ps(p1, _mm_set1_ps(scale.mV[VY]));
+		rows[2] = _mm_mul_ps(p2, _mm_set1_ps(scale.mV[VZ]));
+	}
+}
+
+LLSkeletonTransforms::LLSkeletonTransforms()
+:	mRoot(NULL)
+{
+}
+
+LLSkeletonTransforms::~LLSkeletonTransforms()
+{
+	invalidate();
+}
+
+void LLSkeletonTransforms::update(LLJoint* root)
+{
+	if (root != mRoot)
+	{
+		build(root);
+	}
+
+	const S32 count = mJoints.size();
+	S32 updates = 0;
+	for (S32 i = 0; i < count; )
+	{
+		LLJoint* joint = mJoints[i];
+		if (!joint->mUpdateXform)
+		{
+			// nor anything under it
+			i = mSubtreeEnds[i];
+			continue;
+		}
+
+		if (joint->mDirtyFlags & LLJoint::MATRIX_DIRTY)
+		{
+			updateJoint(i);
+			++updates;
+		}
+		++i;
+	}
+	if (updates)
+	{
+		// once per skeleton, the threads share the counter
+		LLJoint::sNumUpdates += updates;
+	}
+}
+
+void LLSkeletonTransforms::invalidate()
+{
+	for (U32 i = 0; i < mJoints.size(); ++i)
+	{
+		mJoints[i]->mTransforms = NULL;
+		mJoints[i]->mTransformIndex = -1;
+	}
+	mJoints.clear();
+	mParents.clear();
+	mSubtreeEnds.clear();
+	mWorldPositions.resize(0);
+	mWorldRotations.resize(0);
+	mWorldMatrices.resize(0);
+	mRoot = NULL;
+}
+
+void LLSkeletonTransforms::copyFromJoint(S32 index)
+{
+	const LLXformMatrix* xform = mJoints[index]->getXform();
+	mWorldPositions[index].load3(xform->getWorldPosition().mV);
+	mWorldRotations[index].loadua(xform->getWorldRotation().mQ);
+	mWorldMatrices[index].loadu(xform->getWorldMatrix());
+}
+
+void LLSkeletonTransforms::build(LLJoint* root)
+{
+	invalidate();
+	if (!root)
+	{
+		return;
+	}
+
+	mRoot = root;
+	addJoint(root, -1);
+
+	const S32 count = mJoints.size();
+	mWorldPositions.resize(count);
+	mWorldRotations.resize(count);
+	mWorldMatrices.resize(count);
+	for (S32 i = 0; i < count; ++i)
+	{
+		copyFromJoint(i);
+	}
+}
+
+void LLSkeletonTransforms::addJoint(LLJoint* joint, S32 parent)
+{
+	if (joint->mTransforms)
+	{
+		// moved over from another hierarchy without being removed from it
+		joint->mTransforms->invalidate();
+	}
+
+	S32 index = mJoints.size();
+	joint->mTransforms = this;
+	joint->mTransformIndex = index;
+	mJoints.push_back(joint);
+	mParents.push_back(parent);
+	mSubtreeEnds.push_back(index + 1);
+
+	for (LLJoint::child_list_t::iterator iter = joint->mChildren.begin();
+		 iter != joint->mChildren.end(); ++iter)
+	{
+		addJoint(*iter, index);
+	}
+	mSubtreeEnds[index] = mJoints.size();
+}
+
+// LLJoint::updateWorldMatrix() from the arrays
+void LLSkeletonTransforms::updateJoint(S32 index)
+{
+	LLJoint* joint = mJoints[index];
+	LLXformMatrix* xform = joint->getXform();
+
+	LLVector4a position;
+	LLVector4a rotation;
+	position.load3(xform->getPosition().mV);
+	rotation.loadua(xform->getRotation().mQ);
+
+	// the root's xform can have a parent outside of the hierarchy, like
+	// the object an avatar sits on
+	const LLXform* xform_parent = xform->getParent();
+	if (xform_parent)
+	{
+		LLVector4a parent_position;
+		LLVector4a parent_rotation;
+		S32 parent = mParents[index];
+		if (parent >= 0)
+		{
+			parent_position = mWorldPositions[parent];
+			parent_rotation = mWorldRotations[parent];
+		}
+		else
+		{
+			parent_position.load3(xform_parent->getWorldPosition().mV);
+			parent_rotation.loadua(xform_parent->getWorldRotation().mQ);
+		}
+
+		if (xform_parent->getScaleChildOffset())
+		{
+			LLVector4a parent_scale;
+			parent_scale.load3(xform_parent->getScale().mV);
+			position.mul(parent_scale);
+		}
+		position = _mm_add_ps(quat_rotate(position, parent_rotation), parent_position);
+		rotation = quat_mul(rotation, parent_rotation);
+	}
+	mWorldPositions[index] = position;
+	mWorldRotations[index] = rotation;
+
+	LLQuad rows[3];
+	matrix_rows(rotation, xform->getScale(), rows);
+
+	// initAll() leaves the last column alone
+	const LLMatrix4& old_matrix = xform->getWorldMatrix();
+	LLMatrix4 matrix;
+	for (S32 i = 0; i < 3; ++i)
+	{
+		_mm_storeu_ps(matrix.mMatrix[i], rows[i]);
+		matrix.mMatrix[i][VW] = old_matrix.mMatrix[i][VW];
+	}
+	const F32* world_position = position.getF32ptr();
+	matrix.mMatrix[VW][VX] = world_position[VX];
+	matrix.mMatrix[VW][VY] = world_position[VY];
+	matrix.mMatrix[VW][VZ] = world_position[VZ];
+	matrix.mMatrix[VW][VW] = 1.f;
+	mWorldMatrices[index].loadu(matrix);
+
+	LLQuaternion world_rotation;
+	_mm_storeu_ps(world_rotation.mQ, rotation);
+	xform->setWorldTransform(LLVector3(world_position), world_rotation, matrix);
+
+	joint->mDirtyFlags = 0x0;
+}
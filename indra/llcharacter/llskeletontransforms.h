@@ -0,0 +1,85 @@
+/**
+ * @file llskeletontransforms.h
+ * @brief LLSkeletonTransforms class, the world transforms of a joint
+ * hierarchy in flat arrays.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKELETONTRANSFORMS_H
+#define LL_LLSKELETONTRANSFORMS_H
+
+#include <vector>
+
+#include "llalignedarray.h"
+#include "llmath.h"
+#include "llsimdmath.h"
+#include "llmatrix4a.h"
+
+class LLJoint;
+
+// The joints under a root - bones, collision volumes and attachment points -
+// flattened parents first, with their world positions, rotations and
+// matrices in arrays alongside.  update() does what
+// updateWorldMatrixChildren() does on the root in one pass down the arrays,
+// writing each joint's xform as well, so whatever reads the xforms sees the
+// same transforms.  Rigging reads the matrices straight from here, see
+// LLJoint::loadWorldMatrix().
+//
+// The arrays hold for every joint that isn't MATRIX_DIRTY: LLJoint keeps
+// them current when it updates a joint itself, and drops them when the
+// hierarchy under the root changes, to be rebuilt on the next update().
+class LLSkeletonTransforms
+{
+public:
+	LLSkeletonTransforms();
+	~LLSkeletonTransforms();
+
+	void update(LLJoint* root);
+
+	// forgets the flattened hierarchy
+	void invalidate();
+
+	U32 getNumJoints() const						{ return mJoints.size(); }
+	const LLMatrix4a& getWorldMatrix(S32 index) const	{ return mWorldMatrices[index]; }
+
+	// copies in a joint LLJoint updated
+	void copyFromJoint(S32 index);
+
+private:
+	void build(LLJoint* root);
+	void addJoint(LLJoint* joint, S32 parent);
+	void updateJoint(S32 index);
+
+	LLJoint*				mRoot;
+	std::vector<LLJoint*>	mJoints;
+	// index of the parent joint, -1 for the root
+	std::vector<S32>		mParents;
+	// index past the last joint under each one
+	std::vector<S32>		mSubtreeEnds;
+
+	LLAlignedArray<LLVector4a, 64>	mWorldPositions;
+	LLAlignedArray<LLVector4a, 64>	mWorldRotations;
+	LLAlignedArray<LLMatrix4a, 64>	mWorldMatrices;
+};
+
+#endif // LL_LLSKELETONTRANSFORMS_H
@@ -0,0 +1,274 @@
+/**
+ * @file llanimationlod_test.cpp
+ * @brief LLAnimationLOD rate selection, schedule, budget and pose easing
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llanimationlod.h"
+#include "../lljoint.h"
+#include "llformat.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 NUM_JOINTS = 3;
+	const U32 START_FRAME = 1000;
+}
+
+namespace tut
+{
+	struct animationlod_data
+	{
+		animationlod_data()
+		{
+			for (S32 i = 0; i < NUM_JOINTS; ++i)
+			{
+				mSkeleton.push_back(&mJoints[i]);
+			}
+			// nothing holds an evaluation back unless a test says so
+			mBudget.mLimit = F32_MAX;
+		}
+
+		// what an avatar's update does at frame, the motions put the
+		// joints where they were asked to be; true if they were evaluated
+		bool update(LLAnimationLOD& lod, U32 frame, U32 phase = 0)
+		{
+			if (!lod.isDue(frame, mSkeleton.size(), mBudget))
+			{
+				lod.interpolatePose(mSkeleton, frame);
+				return false;
+			}
+
+			lod.beginPose(mSkeleton);
+			for (S32 i = 0; i < NUM_JOINTS; ++i)
+			{
+				mJoints[i].setPosition(mMotionPosition[i]);
+				mJoints[i].setRotation(mMotionRotation[i]);
+			}
+			lod.endPose(mSkeleton, frame, phase);
+			return true;
+		}
+
+		// the frames after frame up to the next evaluation
+		U32 framesToNextEvaluation(LLAnimationLOD& lod, U32 frame, U32 phase = 0)
+		{
+			U32 next = frame + 1;
+			while (!update(lod, next, phase) && next < frame + 100)
+			{
+				++next;
+			}
+			return next - frame;
+		}
+
+		LLJoint mJoints[NUM_JOINTS];
+		std::vector<LLJoint*> mSkeleton;
+		LLVector3 mMotionPosition[NUM_JOINTS];
+		LLQuaternion mMotionRotation[NUM_JOINTS];
+		LLAnimationLOD::Budget mBudget;
+	};
+
+	typedef test_group<animationlod_data> animationlod_t;
+	typedef animationlod_t::object animationlod_object_t;
+	tut::animationlod_t tut_animationlod("LLAnimationLOD");
+
+	// the fastest of the rates screen area and distance ask for
+	template<> template<>
+	void animationlod_object_t::test<1>()
+	{
+		ensure_equals("close and large", LLAnimationLOD::selectRate(20000.f, 5.f), LLAnimationLOD::RATE_FULL);
+		ensure_equals("large but far", LLAnimationLOD::selectRate(20000.f, 200.f), LLAnimationLOD::RATE_FULL);
+		ensure_equals("small but close", LLAnimationLOD::selectRate(10.f, 5.f), LLAnimationLOD::RATE_FULL);
+		ensure_equals("medium", LLAnimationLOD::selectRate(5000.f, 20.f), LLAnimationLOD::RATE_HALF);
+		ensure_equals("small", LLAnimationLOD::selectRate(1000.f, 50.f), LLAnimationLOD::RATE_QUARTER);
+		ensure_equals("area asks for more", LLAnimationLOD::selectRate(1000.f, 200.f), LLAnimationLOD::RATE_QUARTER);
+		ensure_equals("distance asks for more", LLAnimationLOD::selectRate(100.f, 50.f), LLAnimationLOD::RATE_QUARTER);
+		ensure_equals("tiny and far", LLAnimationLOD::selectRate(100.f, 200.f), LLAnimationLOD::RATE_EIGHTH);
+	}
+
+	// every rate evaluates once a period
+	template<> template<>
+	void animationlod_object_t::test<2>()
+	{
+		for (S32 rate = 0; rate < LLAnimationLOD::NUM_RATES; ++rate)
+		{
+			LLAnimationLOD lod;
+			lod.setRate((LLAnimationLOD::ERate) rate);
+			ensure(llformat("rate %d, first update", rate), update(lod, START_FRAME));
+
+			U32 frame = START_FRAME;
+			for (S32 i = 0; i < 3; ++i)
+			{
+				U32 frames = framesToNextEvaluation(lod, frame);
+				ensure_equals(llformat("rate %d, period %d", rate, i), frames, (U32) LLAnimationLOD::PERIODS[rate]);
+				frame += frames;
+			}
+		}
+		ensure_equals("no evaluation deferred", mBudget.mDeferred, 0);
+	}
+
+	// avatars dropping to a rate together spread over its frames
+	template<> template<>
+	void animationlod_object_t::test<3>()
+	{
+		const S32 period = LLAnimationLOD::PERIODS[LLAnimationLOD::RATE_QUARTER];
+		for (U32 phase = 0; phase < (U32) period; ++phase)
+		{
+			LLAnimationLOD lod;
+			update(lod, START_FRAME, phase);
+			lod.setRate(LLAnimationLOD::RATE_QUARTER);
+			ensure(llformat("phase %d, dropping", phase), update(lod, START_FRAME + 1, phase));
+			U32 first = framesToNextEvaluation(lod, START_FRAME + 1, phase);
+			ensure_equals(llformat("phase %d, first period", phase), first, period - phase);
+			U32 second = framesToNextEvaluation(lod, START_FRAME + 1 + first, phase);
+			ensure_equals(llformat("phase %d, second period", phase), second, (U32) period);
+		}
+	}
+
+	// over the budget waits, but never longer than a period
+	template<> template<>
+	void animationlod_object_t::test<4>()
+	{
+		LLAnimationLOD lod;
+		lod.setRate(LLAnimationLOD::RATE_HALF);
+		update(lod, START_FRAME);
+
+		mBudget.mLimit = 0.002f;
+		mBudget.mCost = 0.003f;
+		U32 frames = framesToNextEvaluation(lod, START_FRAME);
+		ensure_equals("held back a period", frames, (U32) LLAnimationLOD::PERIODS[LLAnimationLOD::RATE_HALF] * 2);
+		ensure_equals("deferred once a frame", mBudget.mDeferred, LLAnimationLOD::PERIODS[LLAnimationLOD::RATE_HALF]);
+	}
+
+	// reduced rate evaluations are charged to the budget, full rate ones
+	// are neither charged nor held back
+	template<> template<>
+	void animationlod_object_t::test<5>()
+	{
+		const S32 count = 4;
+		LLAnimationLOD lods[count];
+		for (S32 i = 0; i < count; ++i)
+		{
+			lods[i].setRate(LLAnimationLOD::RATE_QUARTER);
+			update(lods[i], START_FRAME);
+		}
+		LLAnimationLOD full;
+		update(full, START_FRAME);
+
+		mBudget.startFrame();
+		mBudget.mLimit = 0.0025f;
+		mBudget.mCost = 0.001f;
+		ensure("full rate, first", full.isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure_equals("full rate not charged", mBudget.mUsed, 0.f);
+		ensure("first due", lods[0].isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure("second due", lods[1].isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure("third over the budget", !lods[2].isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure("fourth over the budget", !lods[3].isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure("full rate, over the budget", full.isDue(START_FRAME + 4, NUM_JOINTS, mBudget));
+		ensure_approximately_equals("two charged", mBudget.mUsed, 0.002f, 20);
+		ensure_equals("evaluated", mBudget.mEvaluated, 4);
+		ensure_equals("deferred", mBudget.mDeferred, 2);
+
+		mBudget.startFrame();
+		ensure("third, next frame", lods[2].isDue(START_FRAME + 5, NUM_JOINTS, mBudget));
+		ensure("fourth, next frame", lods[3].isDue(START_FRAME + 5, NUM_JOINTS, mBudget));
+	}
+
+	// between evaluations the joints ease toward the motions' pose, the
+	// next evaluation carries on from that pose
+	template<> template<>
+	void animationlod_object_t::test<6>()
+	{
+		LLAnimationLOD lod;
+		lod.setRate(LLAnimationLOD::RATE_QUARTER);
+		update(lod, START_FRAME);
+		ensure_equals("full pose at the first evaluation", mJoints[0].getPosition(), mMotionPosition[0]);
+
+		const LLVector3 start = mMotionPosition[0];
+		const LLQuaternion start_rotation = mMotionRotation[0];
+		mMotionPosition[0] = LLVector3(4.f, 0.f, 0.f);
+		mMotionRotation[0] = LLQuaternion(F_PI_BY_TWO, LLVector3::z_axis);
+		ensure("evaluated", update(lod, START_FRAME + 4));
+		ensure_equals("a quarter there", mJoints[0].getPosition(), lerp(start, mMotionPosition[0], 0.25f));
+		ensure("rotated a quarter", mJoints[0].getRotation() == nlerp(0.25f, start_rotation, mMotionRotation[0]));
+		ensure_equals("still joint left alone", mJoints[1].getPosition(), mMotionPosition[1]);
+
+		for (U32 i = 1; i < 4; ++i)
+		{
+			ensure("eased", !update(lod, START_FRAME + 4 + i));
+			F32 u = (i + 1) / 4.f;
+			ensure_equals(llformat("frame %d", i), mJoints[0].getPosition(), lerp(start, mMotionPosition[0], u));
+		}
+		ensure("rotation reached", mJoints[0].getRotation() == nlerp(1.f, start_rotation, mMotionRotation[0]));
+
+		// the motions would see their own pose, not the eased one
+		lod.beginPose(mSkeleton);
+		ensure_equals("carried on from the target", mJoints[0].getPosition(), mMotionPosition[0]);
+	}
+
+	// a joint something else moves is left to it
+	template<> template<>
+	void animationlod_object_t::test<7>()
+	{
+		LLAnimationLOD lod;
+		lod.setRate(LLAnimationLOD::RATE_QUARTER);
+		update(lod, START_FRAME);
+
+		mMotionPosition[0] = LLVector3(4.f, 0.f, 0.f);
+		mMotionPosition[1] = LLVector3(0.f, 4.f, 0.f);
+		update(lod, START_FRAME + 4);
+
+		const LLVector3 moved(-1.f, -1.f, -1.f);
+		mJoints[0].setPosition(moved);
+		update(lod, START_FRAME + 5);
+		ensure_equals("moved joint kept", mJoints[0].getPosition(), moved);
+		ensure_equals("other joint eased", mJoints[1].getPosition(), lerp(LLVector3::zero, mMotionPosition[1], 0.5f));
+
+		lod.beginPose(mSkeleton);
+		ensure_equals("moved joint not carried on", mJoints[0].getPosition(), moved);
+		ensure_equals("other joint carried on", mJoints[1].getPosition(), mMotionPosition[1]);
+	}
+
+	// a skeleton that changed size is evaluated and posed afresh
+	template<> template<>
+	void animationlod_object_t::test<8>()
+	{
+		LLAnimationLOD lod;
+		lod.setRate(LLAnimationLOD::RATE_EIGHTH);
+		update(lod, START_FRAME);
+		ensure_equals("easing", lod.getPeriod(), 8);
+
+		LLJoint extra;
+		mSkeleton.push_back(&extra);
+		ensure("due right away", update(lod, START_FRAME + 1));
+		ensure_equals("easing the new pose", lod.getPeriod(), 8);
+		ensure_equals("next after a period", framesToNextEvaluation(lod, START_FRAME + 1), (U32) 8);
+
+		lod.setRate(LLAnimationLOD::RATE_FULL);
+		ensure("back to full rate", update(lod, START_FRAME + 20));
+		ensure_equals("no easing at full rate", lod.getPeriod(), 1);
+		ensure_equals("posed as the motions left it", mJoints[0].getPosition(), mMotionPosition[0]);
+	}
+}
@@ -0,0 +1,318 @@
+/**
+ * @file llkeyframecurves_test.cpp
+ * @brief LLKeyframeCurves tests, against LLKeyframeMotion's map curves.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llkeyframecurves.h"
+#include "../llkeyframemotion.h"
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef LLKeyframeMotion::RotationCurve RotationCurve;
+	typedef LLKeyframeMotion::PositionCurve PositionCurve;
+	typedef LLKeyframeMotion::ScaleCurve ScaleCurve;
+
+	// the same pseudo random numbers on every platform
+	struct Random
+	{
+		Random(U32 seed) : mState(seed) {}
+
+		U32 next()
+		{
+			mState = mState * 1664525 + 1013904223;
+			return mState >> 8;
+		}
+
+		// in [low, high]
+		F32 range(F32 low, F32 high)
+		{
+			return low + (high - low) * (F32) (next() & 0xffff) / 65535.f;
+		}
+
+		U32 mState;
+	};
+
+	// key times quantized like the animation asset stores them
+	F32 key_time(U32 key, U32 num_keys, F32 duration)
+	{
+		U16 quantized = (U16) (65535.f * (F32) key / (F32) num_keys);
+		return (F32) quantized * duration / 65535.f;
+	}
+
+	// Curves shaped like a typical avatar animation, each kept both as
+	// LLKeyframeMotion's key maps and compiled into LLKeyframeCurves the way
+	// JointMotionList::compileCurves() does it.
+	//
+	// Every seventh curve steps, every eleventh has a single key, and
+	// rotation keys flip hemisphere at random to take the slerp() fallback.
+	struct Animation
+	{
+		Animation(Random& random, U32 num_rotations, U32 num_positions, U32 num_scales, U32 num_keys)
+		:	mDuration(random.range(2.f, 8.f))
+		{
+			mRotations.resize(num_rotations);
+			mPositions.resize(num_positions);
+			mScales.resize(num_scales);
+
+			U32 curve = 0;
+			for (U32 i = 0; i < num_rotations; ++i, ++curve)
+			{
+				RotationCurve& rot_curve = mRotations[i];
+				rot_curve.mInterpolationType = curve % 7 == 6 ? LLKeyframeMotion::IT_STEP : LLKeyframeMotion::IT_LINEAR;
+				U32 keys = curve % 11 == 10 ? 1 : num_keys;
+				for (U32 k = 0; k < keys; ++k)
+				{
+					LLQuaternion rotation(random.range(-1.f, 1.f), random.range(-1.f, 1.f),
+										  random.range(-1.f, 1.f), random.range(0.1f, 1.f));
+					rotation.normalize();
+					if (random.next() & 1)
+					{
+						rotation = LLQuaternion(-rotation.mQ[VX], -rotation.mQ[VY], -rotation.mQ[VZ], -rotation.mQ[VW]);
+					}
+					F32 time = key_time(k + 1, keys + 1, mDuration);
+					rot_curve.mKeys[time] = LLKeyframeMotion::RotationKey(time, rotation);
+				}
+				rot_curve.mNumKeys = rot_curve.mKeys.size();
+			}
+			for (U32 i = 0; i < num_positions; ++i, ++curve)
+			{
+				PositionCurve& pos_curve = mPositions[i];
+				pos_curve.mInterpolationType = curve % 7 == 6 ? LLKeyframeMotion::IT_STEP : LLKeyframeMotion::IT_LINEAR;
+				U32 keys = curve % 11 == 10 ? 1 : num_keys;
+				for (U32 k = 0; k < keys; ++k)
+				{
+					LLVector3 position(random.range(-2.f, 2.f), random.range(-2.f, 2.f), random.range(-2.f, 2.f));
+					F32 time = key_time(k + 1, keys + 1, mDuration);
+					pos_curve.mKeys[time] = LLKeyframeMotion::PositionKey(time, position);
+				}
+				pos_curve.mNumKeys = pos_curve.mKeys.size();
+			}
+			for (U32 i = 0; i < num_scales; ++i, ++curve)
+			{
+				ScaleCurve& scale_curve = mScales[i];
+				scale_curve.mInterpolationType = curve % 7 == 6 ? LLKeyframeMotion::IT_STEP : LLKeyframeMotion::IT_LINEAR;
+				U32 keys = curve % 11 == 10 ? 1 : num_keys;
+				for (U32 k = 0; k < keys; ++k)
+				{
+					LLVector3 scale(random.range(0.5f, 2.f), random.range(0.5f, 2.f), random.range(0.5f, 2.f));
+					F32 time = key_time(k + 1, keys + 1, mDuration);
+					scale_curve.mKeys[time] = LLKeyframeMotion::ScaleKey(time, scale);
+				}
+				scale_curve.mNumKeys = scale_curve.mKeys.size();
+			}
+
+			for (U32 i = 0; i < mRotations.size(); ++i)
+			{
+				mCurves.beginCurve(LLKeyframeCurves::ROTATION, i, mRotations[i].mInterpolationType == LLKeyframeMotion::IT_STEP);
+				for (RotationCurve::key_map_t::iterator iter = mRotations[i].mKeys.begin(); iter != mRotations[i].mKeys.end(); ++iter)
+				{
+					mCurves.addKey(iter->first, iter->second.mRotation);
+				}
+			}
+			for (U32 i = 0; i < mPositions.size(); ++i)
+			{
+				mCurves.beginCurve(LLKeyframeCurves::POSITION, i, mPositions[i].mInterpolationType == LLKeyframeMotion::IT_STEP);
+				for (PositionCurve::key_map_t::iterator iter = mPositions[i].mKeys.begin(); iter != mPositions[i].mKeys.end(); ++iter)
+				{
+					mCurves.addKey(iter->first, iter->second.mPosition);
+				}
+			}
+			for (U32 i = 0; i < mScales.size(); ++i)
+			{
+				mCurves.beginCurve(LLKeyframeCurves::SCALE, i, mScales[i].mInterpolationType == LLKeyframeMotion::IT_STEP);
+				for (ScaleCurve::key_map_t::iterator iter = mScales[i].mKeys.begin(); iter != mScales[i].mKeys.end(); ++iter)
+				{
+					mCurves.addKey(iter->first, iter->second.mScale);
+				}
+			}
+		}
+
+		// the way applyKeyframes() did it, a map lookup per curve
+		void evaluateMaps(F32 time, LLQuaternion* rotations, LLVector3* vectors)
+		{
+			for (U32 i = 0; i < mRotations.size(); ++i)
+			{
+				rotations[i] = mRotations[i].getValue(time, mDuration);
+			}
+			for (U32 i = 0; i < mPositions.size(); ++i)
+			{
+				vectors[i] = mPositions[i].getValue(time, mDuration);
+			}
+			for (U32 i = 0; i < mScales.size(); ++i)
+			{
+				vectors[mPositions.size() + i] = mScales[i].getValue(time, mDuration);
+			}
+		}
+
+		U32 getNumVectors() const				{ return mPositions.size() + mScales.size(); }
+
+		F32 mDuration;
+		std::vector<RotationCurve> mRotations;
+		std::vector<PositionCurve> mPositions;
+		std::vector<ScaleCurve> mScales;
+		LLKeyframeCurves mCurves;
+	};
+
+	// Samples both forms at time, into the next slots of the outputs.
+	void sample(Animation& animation, F32 time,
+				std::vector<LLQuaternion>& map_rotations, std::vector<LLVector3>& map_vectors,
+				std::vector<LLQuaternion>& rotations, std::vector<LLVector3>& vectors)
+	{
+		U32 rot_offset = rotations.size();
+		U32 vec_offset = vectors.size();
+		map_rotations.resize(rot_offset + animation.mRotations.size());
+		rotations.resize(map_rotations.size());
+		map_vectors.resize(vec_offset + animation.getNumVectors());
+		vectors.resize(map_vectors.size());
+		animation.evaluateMaps(time, &map_rotations[rot_offset], &map_vectors[vec_offset]);
+		animation.mCurves.evaluate(time, &rotations[rot_offset], &vectors[vec_offset]);
+	}
+
+	// how many values differ in any bit
+	template<typename T>
+	U32 count_mismatches(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		U32 mismatches = 0;
+		for (U32 i = 0; i < a.size(); ++i)
+		{
+			if (memcmp(&a[i], &b[i], sizeof(T)))
+			{
+				++mismatches;
+			}
+		}
+		return mismatches;
+	}
+}
+
+namespace tut
+{
+	struct keyframecurves_test
+	{
+	};
+	typedef test_group<keyframecurves_test> keyframecurves_t;
+	typedef keyframecurves_t::object keyframecurves_object_t;
+	tut::keyframecurves_t tut_keyframecurves("LLKeyframeCurves");
+
+	// bit for bit the map curves, before, on, between and past the keys
+	template<> template<>
+	void keyframecurves_object_t::test<1>()
+	{
+		Random random(1);
+		Animation animation(random, 26, 2, 2, 40);
+		ensure_equals("curves", animation.mCurves.getNumCurves(), 30U);
+		ensure_equals("rotations first", animation.mCurves.getChannel(25), LLKeyframeCurves::ROTATION);
+		ensure_equals("then positions", animation.mCurves.getChannel(26), LLKeyframeCurves::POSITION);
+		ensure_equals("then scales", animation.mCurves.getChannel(29), LLKeyframeCurves::SCALE);
+		ensure_equals("joint index", animation.mCurves.getJointIndex(27), 1U);
+
+		std::vector<F32> times;
+		times.push_back(-1.f);
+		times.push_back(0.f);
+		times.push_back(animation.mDuration);
+		times.push_back(animation.mDuration + 1.f);
+		const RotationCurve::key_map_t& keys = animation.mRotations[0].mKeys;
+		for (RotationCurve::key_map_t::const_iterator iter = keys.begin(); iter != keys.end(); ++iter)
+		{
+			times.push_back(iter->first);
+		}
+		for (U32 i = 0; i < 1000; ++i)
+		{
+			times.push_back(random.range(0.f, animation.mDuration));
+		}
+
+		std::vector<LLQuaternion> map_rotations, rotations;
+		std::vector<LLVector3> map_vectors, vectors;
+		for (U32 i = 0; i < times.size(); ++i)
+		{
+			sample(animation, times[i], map_rotations, map_vectors, rotations, vectors);
+		}
+		ensure_equals("rotation mismatches", count_mismatches(map_rotations, rotations), 0U);
+		ensure_equals("vector mismatches", count_mismatches(map_vectors, vectors), 0U);
+	}
+
+	// 200 motions playing 20 animations of 26 rotation and 2 position curves
+	// with 150 keys each, a second of frames through both forms
+	template<> template<>
+	void keyframecurves_object_t::test<2>()
+	{
+		const U32 NUM_ANIMATIONS = 20;
+		const U32 NUM_MOTIONS = 200;
+		const U32 NUM_FRAMES = 45;
+		const F32 FRAME_TIME = 1.f / 45.f;
+
+		Random random(2);
+		std::vector<Animation*> animations;
+		for (U32 i = 0; i < NUM_ANIMATIONS; ++i)
+		{
+			animations.push_back(new Animation(random, 26, 2, 0, 150));
+		}
+		std::vector<F32> start_times;
+		for (U32 i = 0; i < NUM_MOTIONS; ++i)
+		{
+			start_times.push_back(random.range(0.f, 8.f));
+		}
+
+		std::vector<LLQuaternion> map_rotations(26), rotations(26);
+		std::vector<LLVector3> map_vectors(2), vectors(2);
+		U32 mismatches = 0;
+		U32 samples = 0;
+		F64 map_seconds = 0.0;
+		F64 curve_seconds = 0.0;
+		LLTimer timer;
+		for (U32 frame = 0; frame < NUM_FRAMES; ++frame)
+		{
+			for (U32 i = 0; i < NUM_MOTIONS; ++i)
+			{
+				Animation& animation = *animations[i % NUM_ANIMATIONS];
+				F32 time = fmodf(start_times[i] + frame * FRAME_TIME, animation.mDuration);
+
+				timer.reset();
+				animation.evaluateMaps(time, &map_rotations[0], &map_vectors[0]);
+				map_seconds += timer.getElapsedTimeF64();
+
+				timer.reset();
+				animation.mCurves.evaluate(time, &rotations[0], &vectors[0]);
+				curve_seconds += timer.getElapsedTimeF64();
+
+				mismatches += count_mismatches(map_rotations, rotations) + count_mismatches(map_vectors, vectors);
+				samples += 28;
+			}
+		}
+		for (U32 i = 0; i < animations.size(); ++i)
+		{
+			delete animations[i];
+		}
+
+		LL_INFOS() << NUM_MOTIONS << " motions, " << samples << " samples, " << mismatches << " mismatches: map curves "
+			<< map_seconds * 1000.0 / NUM_FRAMES << " ms per frame, compiled curves "
+			<< curve_seconds * 1000.0 / NUM_FRAMES << " ms per frame" << LL_ENDL;
+		ensure_equals("mismatches", mismatches, 0U);
+	}
+}
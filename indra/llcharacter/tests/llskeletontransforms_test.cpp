@@ -0,0 +1,219 @@
+/**
+ * @file llskeletontransforms_test.cpp
+ * @brief LLSkeletonTransforms against the recursive joint update
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llskeletontransforms.h"
+#include "../lljoint.h"
+#include "llformat.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// a pelvis with two short chains, the first one branching
+	const S32 NUM_JOINTS = 7;
+	const S32 PARENTS[NUM_JOINTS] = { -1, 0, 1, 2, 1, 0, 5 };
+
+	// the flat update keeps the scalar order of the recursive one, so this
+	// only leaves room for the compiler
+	const U32 MATCHING_BITS = 20;
+}
+
+namespace tut
+{
+	struct skeletontransforms_data
+	{
+		skeletontransforms_data()
+		{
+			for (S32 i = 1; i < NUM_JOINTS; ++i)
+			{
+				mFlat[PARENTS[i]].addChild(&mFlat[i]);
+				mLegacy[PARENTS[i]].addChild(&mLegacy[i]);
+			}
+			for (S32 i = 0; i < NUM_JOINTS; ++i)
+			{
+				setPosition(i, LLVector3(0.1f * i, 0.05f, 0.2f + 0.01f * i));
+				setRotation(i, LLQuaternion(0.1f * i, LLVector3::z_axis));
+			}
+		}
+
+		// the same change to both skeletons
+		void setPosition(S32 i, const LLVector3& position)
+		{
+			mFlat[i].setPosition(position);
+			mLegacy[i].setPosition(position);
+		}
+
+		void setRotation(S32 i, const LLQuaternion& rotation)
+		{
+			mFlat[i].setRotation(rotation);
+			mLegacy[i].setRotation(rotation);
+		}
+
+		void setScale(S32 i, const LLVector3& scale)
+		{
+			mFlat[i].setScale(scale);
+			mLegacy[i].setScale(scale);
+		}
+
+		void update()
+		{
+			mTransforms.update(&mFlat[0]);
+			mLegacy[0].updateWorldMatrixChildren();
+		}
+
+		// both the joint's own matrix and the one rigging reads
+		void ensureMatch(const std::string& msg)
+		{
+			for (S32 i = 0; i < NUM_JOINTS; ++i)
+			{
+				const LLMatrix4& expected = mLegacy[i].getWorldMatrix();
+				const LLMatrix4& flat = mFlat[i].getWorldMatrix();
+				LLMatrix4a loaded;
+				mFlat[i].loadWorldMatrix(loaded);
+
+				for (S32 row = 0; row < 4; ++row)
+				{
+					const F32* loaded_row = loaded.mMatrix[row].getF32ptr();
+					for (S32 col = 0; col < 4; ++col)
+					{
+						std::string where = llformat("%s: joint %d [%d][%d]", msg.c_str(), i, row, col);
+						ensure_approximately_equals(where.c_str(), flat.mMatrix[row][col], expected.mMatrix[row][col], MATCHING_BITS);
+						ensure_approximately_equals(where.c_str(), loaded_row[col], expected.mMatrix[row][col], MATCHING_BITS);
+					}
+				}
+			}
+		}
+
+		LLJoint mFlat[NUM_JOINTS];
+		LLJoint mLegacy[NUM_JOINTS];
+		// after the joints, it lets go of them when it goes
+		LLSkeletonTransforms mTransforms;
+	};
+
+	typedef test_group<skeletontransforms_data> skeletontransforms_t;
+	typedef skeletontransforms_t::object skeletontransforms_object_t;
+	tut::skeletontransforms_t tut_skeletontransforms("LLSkeletonTransforms");
+
+	// a fresh skeleton
+	template<> template<>
+	void skeletontransforms_object_t::test<1>()
+	{
+		update();
+		ensure_equals("every joint flattened", mTransforms.getNumJoints(), (U32) NUM_JOINTS);
+		ensureMatch("first update");
+	}
+
+	// moving a joint moves what's under it
+	template<> template<>
+	void skeletontransforms_object_t::test<2>()
+	{
+		update();
+
+		setPosition(1, LLVector3(0.3f, -0.2f, 0.4f));
+		update();
+		ensureMatch("inner joint moved");
+
+		setPosition(0, LLVector3(12.f, 128.f, 24.f));
+		setPosition(6, LLVector3(0.f, 0.f, -0.5f));
+		update();
+		ensureMatch("root and leaf moved");
+	}
+
+	// rotations compose down the chains
+	template<> template<>
+	void skeletontransforms_object_t::test<3>()
+	{
+		update();
+
+		LLQuaternion rotation;
+		rotation.setQuat(0.4f, 0.3f, -0.2f);
+		setRotation(0, rotation);
+		update();
+		ensureMatch("root rotated");
+
+		rotation.setQuat(-1.1f, 0.7f, 0.25f);
+		setRotation(2, rotation);
+		setRotation(5, LLQuaternion(F_PI_BY_TWO, LLVector3::x_axis));
+		update();
+		ensureMatch("inner joints rotated");
+	}
+
+	// scale, with and without scaling the children's offsets
+	template<> template<>
+	void skeletontransforms_object_t::test<4>()
+	{
+		update();
+
+		setScale(1, LLVector3(1.5f, 0.5f, 2.f));
+		update();
+		ensureMatch("scaled");
+
+		mFlat[1].getXform()->setScaleChildOffset(TRUE);
+		mLegacy[1].getXform()->setScaleChildOffset(TRUE);
+		setScale(1, LLVector3(2.f, 1.f, 0.75f));
+		update();
+		ensureMatch("scaled child offsets");
+	}
+
+	// all of it between two updates, after updates with nothing to do
+	template<> template<>
+	void skeletontransforms_object_t::test<5>()
+	{
+		update();
+		update();
+
+		LLQuaternion rotation;
+		rotation.setQuat(0.2f, -0.6f, 1.3f);
+		setPosition(3, LLVector3(-0.1f, 0.2f, 0.1f));
+		setRotation(4, rotation);
+		setScale(5, LLVector3(0.9f, 1.1f, 1.f));
+		setRotation(0, LLQuaternion(-0.8f, LLVector3::y_axis));
+		update();
+		ensureMatch("mixed changes");
+	}
+
+	// a skeleton whose root hangs off something outside of it, like an
+	// avatar sitting on an object
+	template<> template<>
+	void skeletontransforms_object_t::test<6>()
+	{
+		LLXformMatrix seat;
+		seat.setPosition(LLVector3(100.f, 50.f, 20.f));
+		seat.setRotation(LLQuaternion(0.5f, LLVector3::z_axis));
+		seat.update();
+		mFlat[0].getXform()->setParent(&seat);
+		mLegacy[0].getXform()->setParent(&seat);
+
+		setPosition(0, LLVector3(0.f, 0.f, 0.6f));
+		update();
+		ensureMatch("seated");
+
+		mFlat[0].getXform()->setParent(NULL);
+		mLegacy[0].getXform()->setParent(NULL);
+	}
+}
@@ -46,6 +46,7 @@ public:
 	T* append(S32 N);
 	T& operator[](int idx);
 	const T& operator[](int idx) const;
+	void swap(LLAlignedArray& other);
 };
 
 template <class T, U32 alignment>
@@ -66,6 +67,14 @@ LLAlignedArray<T, alignment>::~LLAlignedArray()
 	mCapacity = 0;
 }
 
+template <class T, U32 alignment>
+void LLAlignedArray<T, alignment>::swap(LLAlignedArray& other)
+{
+	std::swap(mArray, other.mArray);
+	std::swap(mElementCount, other.mElementCount);
+	std::swap(mCapacity, other.mCapacity);
+}
+
 template <class T, U32 alignment>
 void LLAlignedArray<T, alignment>::push_back(const T& elem)
 {
@@ -27,6 +27,7 @@
 #include "linden_common.h"
 
 #include "llcriticaldamp.h"
+#include "llmutex.h"
 #include <algorithm>
 
 //-----------------------------------------------------------------------------
@@ -34,6 +35,7 @@
 //-----------------------------------------------------------------------------
 LLFrameTimer LLSmoothInterpolation::sInternalTimer;
 std::vector<LLSmoothInterpolation::Interpolant> LLSmoothInterpolation::sInterpolants;
+LLMutex LLSmoothInterpolation::sInterpolantsMutex;
 F32 LLSmoothInterpolation::sTimeDelta;
 
 // helper functors
@@ -71,6 +73,7 @@ void LLSmoothInterpolation::updateInterpolants()
 {
 	sTimeDelta = sInternalTimer.getElapsedTimeAndResetF32();
 
+	LLMutexLock lock(&sInterpolantsMutex);
 	for (S32 i = 0; i < sInterpolants.size(); i++)
 	{
 		Interpolant& interp = sInterpolants[i];
@@ -90,6 +93,7 @@ F32 LLSmoothInterpolation::getInterpolant(F32SecondsImplicit time_constant, bool
 
 	if (use_cache)
 	{
+		LLMutexLock lock(&sInterpolantsMutex);
 		interpolant_vec_t::iterator find_it = std::lower_bound(sInterpolants.begin(), sInterpolants.end(), time_constant.value(), CompareTimeConstants());
 		if (find_it != sInterpolants.end() && find_it->mTimeScale == time_constant) 
 		{
@@ -33,6 +33,8 @@
 #include "llframetimer.h"
 #include "llunits.h"
 
+class LLMutex;
+
 class LL_COMMON_API LLSmoothInterpolation 
 {
 public:
@@ -65,6 +67,8 @@ protected:
 	};
 	typedef std::vector<Interpolant> interpolant_vec_t;
 	static interpolant_vec_t 	sInterpolants;
+	// motions read the cache from animation threads
+	static LLMutex				sInterpolantsMutex;
 	static F32					sTimeDelta;
 };
 
@@ -0,0 +1,164 @@
+/**
+ * @file llfanout.cpp
+ * @brief LLFanOut class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llfanout.h"
+
+#include "llthread.h"
+#include "lltracethreadrecorder.h"
+
+class LLFanOutThread : public LLThread
+{
+public:
+	LLFanOutThread(const std::string& name, LLFanOut& fan_out)
+	:	LLThread(name),
+		mFanOut(fan_out)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		U32 batch = 0;
+		LLCondition& condition = mFanOut.mCondition;
+		condition.lock();
+		while (!mFanOut.mQuitting)
+		{
+			if (batch == mFanOut.mBatch)
+			{
+				condition.wait();
+				continue;
+			}
+
+			batch = mFanOut.mBatch;
+			mFanOut.mActiveThreads++;
+			condition.unlock();
+
+			S32 ran = mFanOut.runIndices();
+			// timers and stats taken in the batch show up on the main thread
+			if (LLTrace::get_thread_recorder().notNull())
+			{
+				LLTrace::get_thread_recorder()->pushToParent();
+			}
+
+			condition.lock();
+			mFanOut.mDone += ran;
+			mFanOut.mActiveThreads--;
+			condition.broadcast();
+		}
+		condition.unlock();
+	}
+
+private:
+	LLFanOut& mFanOut;
+};
+
+LLFanOut::LLFanOut(const std::string& name, U32 threads)
+:	mFunc(NULL),
+	mContext(NULL),
+	mCount(0),
+	mNextIndex(0),
+	mBatch(0),
+	mDone(0),
+	mActiveThreads(0),
+	mQuitting(false)
+{
+	for (U32 i = 0; i < threads; ++i)
+	{
+		mThreads.push_back(new LLFanOutThread(name, *this));
+		mThreads.back()->start();
+	}
+}
+
+LLFanOut::~LLFanOut()
+{
+	mCondition.lock();
+	mQuitting = true;
+	mCondition.broadcast();
+	mCondition.unlock();
+
+	for (U32 i = 0; i < mThreads.size(); ++i)
+	{
+		mThreads[i]->shutdown();
+		if (mThreads[i]->isStopped())
+		{
+			delete mThreads[i];
+		}
+	}
+	mThreads.clear();
+}
+
+void LLFanOut::run(S32 count, index_func_t func, void* context, S32 min_parallel)
+{
+	if (mThreads.empty() || count < llmax(min_parallel, 2))
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			func(context, i);
+		}
+		return;
+	}
+
+	// A worker that wakes up too late for the last batch finds all of its
+	// indices claimed, but may still be looking.
+	mCondition.lock();
+	while (mActiveThreads)
+	{
+		mCondition.wait();
+	}
+	mFunc = func;
+	mContext = context;
+	mCount = count;
+	mNextIndex = 0;
+	mDone = 0;
+	mBatch++;
+	mCondition.broadcast();
+	mCondition.unlock();
+
+	S32 ran = runIndices();
+
+	mCondition.lock();
+	mDone += ran;
+	while (mDone < count || mActiveThreads)
+	{
+		mCondition.wait();
+	}
+	mFunc = NULL;
+	mContext = NULL;
+	mCondition.unlock();
+}
+
+S32 LLFanOut::runIndices()
+{
+	S32 ran = 0;
+	for (S32 i = mNextIndex++; i < mCount; i = mNextIndex++)
+	{
+		mFunc(mContext, i);
+		++ran;
+	}
+	return ran;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file llfanout.h
+ * @brief LLFanOut class, runs a batch of independent calls on worker
+ * threads and the calling thread.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFANOUT_H
+#define LL_LLFANOUT_H
+
+#include <string>
+#include <vector>
+
+#include "llatomic.h"
+#include "llmutex.h"
+
+class LLFanOutThread;
+
+// A set of worker threads that wait for batches.  run() hands out the
+// indices of a batch one at a time to the workers and the calling thread,
+// and only returns once every call has returned, so whatever the calls
+// write is visible to the caller afterwards.
+//
+// The calls of a batch may run in any order and at the same time.  They
+// can read anything the caller doesn't change while it waits in run(),
+// but must only write what belongs to their own index.
+class LL_COMMON_API LLFanOut
+{
+public:
+	// no threads runs every batch on the calling thread
+	LLFanOut(const std::string& name, U32 threads);
+	~LLFanOut();
+
+	typedef void (*index_func_t)(void* context, S32 index);
+
+	// Calls func(context, i) for every i below count.  Batches smaller than
+	// min_parallel aren't worth waking the workers for.
+	void run(S32 count, index_func_t func, void* context, S32 min_parallel = 2);
+
+	U32 getThreadCount() const					{ return mThreads.size(); }
+
+private:
+	friend class LLFanOutThread;
+
+	// claims indices of the current batch until none are left, returns how
+	// many it ran
+	S32 runIndices();
+
+	std::vector<LLFanOutThread*>	mThreads;
+
+	// the batch handed to the workers, only changed while none of them is
+	// active
+	index_func_t		mFunc;
+	void*				mContext;
+	S32					mCount;
+	LLAtomicS32			mNextIndex;
+
+	// guards the rest, workers wait on it for batches and the caller for
+	// the batch to finish
+	LLCondition			mCondition;
+	U32					mBatch;
+	S32					mDone;
+	S32					mActiveThreads;
+	bool				mQuitting;
+};
+
+#endif // LL_LLFANOUT_H
@@ -65,6 +65,10 @@ public:
 	void reset() { mVector.resize(0); mIndexMap.resize(0); }
 	bool empty() const { return mVector.empty(); }
 	size_type size() const { return mVector.size(); }
+
+	// by insertion order
+	Type& at(size_type n) { return mVector[n]; }
+	const Type& at(size_type n) const { return mVector[n]; }
 	
 	Type& operator[](const Key& k)
 	{
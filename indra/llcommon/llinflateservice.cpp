@@ -0,0 +1,225 @@
+/**
+ * @file llinflateservice.cpp
+ * @brief LLInflateService class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llinflateservice.h"
+
+#include "llqueuedthread.h"
+#include "llsdserialize.h"
+
+LLInflateService gInflateService;
+
+class LLInflateThread : public LLQueuedThread
+{
+public:
+	class InflateRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~InflateRequest()	// use deleteRequest()
+		{
+			// only left over when the thread stopped before getting to it
+			delete mJob;
+		}
+
+	public:
+		InflateRequest(handle_t handle, LLInflateThread* thread, LLInflateService::Job* job)
+		:	LLQueuedThread::QueuedRequest(handle, PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+			mThread(thread),
+			mJob(job)
+		{
+		}
+
+		// for one that never got queued
+		void discard()
+		{
+			deleteRequest();
+		}
+
+		/*virtual*/ bool processRequest()
+		{
+			mThread->mService.run(mJob, mThread->mBuffer);
+			mJob = NULL;
+			return true;
+		}
+
+	private:
+		LLInflateThread* mThread;
+		LLInflateService::Job* mJob;
+	};
+
+	LLInflateThread(LLInflateService& service)
+	:	LLQueuedThread("inflate"),
+		mService(service)
+	{
+	}
+
+	void inflate(LLInflateService::Job* job)
+	{
+		InflateRequest* req = new InflateRequest(generateHandle(), this, job);
+		if (!addRequest(req))
+		{
+			LL_WARNS() << "Inflate job posted after shutdown" << LL_ENDL;
+			req->discard();
+		}
+	}
+
+private:
+	LLInflateService& mService;
+	// only touched by this thread once it is running
+	std::vector<U8> mBuffer;
+};
+
+LLInflateService::Job::Job(const U8* data, S32 size)
+:	mCompressed(data, data + llmax(size, 0))
+{
+}
+
+bool LLInflateService::LLSDJob::inflated(U8* data, size_t size)
+{
+	return parse_unzipped_llsd(mData, data, size);
+}
+
+LLInflateService::LLInflateService()
+:	mJobsDone(0),
+	mJobsFailed(0)
+{
+}
+
+LLInflateService::~LLInflateService()
+{
+	stopThreads();
+}
+
+void LLInflateService::startThreads(U32 count)
+{
+	LLMutexLock lock(&mThreadsMutex);
+	while (mThreads.size() < count)
+	{
+		mThreads.push_back(new LLInflateThread(*this));
+	}
+	if (count)
+	{
+		LL_INFOS() << "Inflating on " << count << " threads" << LL_ENDL;
+	}
+}
+
+void LLInflateService::stopThreads()
+{
+	std::vector<LLInflateThread*> threads;
+	{
+		LLMutexLock lock(&mThreadsMutex);
+		threads.swap(mThreads);
+	}
+	if (threads.empty())
+	{
+		return;
+	}
+
+	for (U32 i = 0; i < threads.size(); ++i)
+	{
+		threads[i]->shutdown();
+		if (threads[i]->isStopped())
+		{
+			delete threads[i];
+		}
+		else
+		{
+			LL_WARNS() << "Leaking a stuck inflate thread" << LL_ENDL;
+		}
+	}
+
+	LL_INFOS() << "Inflated " << (U32) mJobsDone << " blocks, " << (U32) mJobsFailed << " failed" << LL_ENDL;
+}
+
+bool LLInflateService::isThreaded() const
+{
+	LLMutexLock lock(&mThreadsMutex);
+	return !mThreads.empty();
+}
+
+S32 LLInflateService::getPending()
+{
+	LLMutexLock lock(&mThreadsMutex);
+	S32 pending = 0;
+	for (U32 i = 0; i < mThreads.size(); ++i)
+	{
+		pending += mThreads[i]->getPending();
+	}
+	return pending;
+}
+
+void LLInflateService::post(Job* job)
+{
+	{
+		LLMutexLock lock(&mThreadsMutex);
+		if (!mThreads.empty())
+		{
+			LLInflateThread* thread = mThreads[0];
+			S32 pending = thread->getPending();
+			for (U32 i = 1; i < mThreads.size() && pending > 0; ++i)
+			{
+				S32 count = mThreads[i]->getPending();
+				if (count < pending)
+				{
+					thread = mThreads[i];
+					pending = count;
+				}
+			}
+			thread->inflate(job);
+			return;
+		}
+	}
+
+	// no reuse for these, the posting threads can't share a buffer
+	std::vector<U8> buffer;
+	run(job, buffer);
+}
+
+void LLInflateService::run(Job* job, std::vector<U8>& buffer)
+{
+	size_t size = 0;
+	bool success = !job->mCompressed.empty()
+		&& unzip_buffer(&job->mCompressed[0], job->mCompressed.size(), buffer, size)
+		&& job->inflated(size ? &buffer[0] : NULL, size);
+	job->finished(success);
+	delete job;
+
+	if (buffer.size() > MAX_KEPT_BUFFER)
+	{
+		// a rare huge block shouldn't pin its size on the worker for good
+		std::vector<U8>().swap(buffer);
+	}
+
+	if (success)
+	{
+		mJobsDone++;
+	}
+	else
+	{
+		mJobsFailed++;
+	}
+}
@@ -0,0 +1,114 @@
+/**
+ * @file llinflateservice.h
+ * @brief LLInflateService class, inflates zipped payloads on a pool of
+ * worker threads.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINFLATESERVICE_H
+#define LL_LLINFLATESERVICE_H
+
+#include "llatomic.h"
+#include "llmutex.h"
+#include "llsd.h"
+
+class LLInflateThread;
+
+// Inflates zlib blocks (mesh LODs, zipped LLSD responses) away from the
+// thread that received them.  Each worker inflates into a buffer it keeps
+// for its next job, so steady traffic doesn't allocate.
+class LL_COMMON_API LLInflateService
+{
+public:
+	// largest buffer a worker keeps between jobs, a bigger one is let go
+	// once its job is done
+	enum { MAX_KEPT_BUFFER = 4 * 1024 * 1024 };
+
+	class LL_COMMON_API Job
+	{
+	public:
+		// copies the compressed data
+		Job(const U8* data, S32 size);
+		virtual ~Job() {}
+
+		// On a worker, with the inflated data in the worker's buffer, which
+		// is only good until this returns.  Returns false if the data is no
+		// good.
+		virtual bool inflated(U8* data, size_t size) = 0;
+
+		// On the same worker after inflated(), or instead of it if the data
+		// doesn't inflate.  The job is deleted after this returns.
+		virtual void finished(bool success) {}
+
+		const std::vector<U8>& getCompressed() const	{ return mCompressed; }
+
+	private:
+		friend class LLInflateService;
+		std::vector<U8> mCompressed;
+	};
+
+	// Parses the inflated data as a zipped LLSD block, see unzip_llsd().
+	class LL_COMMON_API LLSDJob : public Job
+	{
+	public:
+		LLSDJob(const U8* data, S32 size) : Job(data, size) {}
+
+		/*virtual*/ bool inflated(U8* data, size_t size);
+
+	protected:
+		LLSD mData;
+	};
+
+	LLInflateService();
+	~LLInflateService();
+
+	// Without threads every job runs on the thread that posts it.  Jobs
+	// still queued when the threads stop are deleted without running.
+	void startThreads(U32 count);
+	void stopThreads();
+	bool isThreaded() const;
+
+	// Takes ownership of job, may be called from any thread.
+	void post(Job* job);
+
+	// runs a job through and deletes it, on the calling thread, buffer is
+	// kept for the next job unless it grew past MAX_KEPT_BUFFER
+	void run(Job* job, std::vector<U8>& buffer);
+
+	U32 getThreadCount() const					{ return mThreads.size(); }
+	S32 getPending();
+	U32 getJobsDone() const						{ return mJobsDone; }
+	U32 getJobsFailed() const					{ return mJobsFailed; }
+
+private:
+	// guards mThreads against jobs posted while the threads stop
+	mutable LLMutex mThreadsMutex;
+	std::vector<LLInflateThread*> mThreads;
+
+	LLAtomicU32 mJobsDone;
+	LLAtomicU32 mJobsFailed;
+};
+
+extern LL_COMMON_API LLInflateService gInflateService;
+
+#endif // LL_LLINFLATESERVICE_H
@@ -0,0 +1,138 @@
+/**
+ * @file llmappedfile.cpp
+ * @brief LLMappedFile class, a read-only memory map of a whole file.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmappedfile.h"
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#include "llstring.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LLMappedFile::LLMappedFile()
+:	mData(NULL),
+	mSize(0)
+#if LL_WINDOWS
+	, mFile(INVALID_HANDLE_VALUE),
+	mMapping(NULL)
+#endif
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+bool LLMappedFile::open(const std::string& filename)
+{
+	close();
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	mFile = CreateFileW((LPCWSTR) utf16filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+						NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx((HANDLE) mFile, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	mSize = (size_t) size.QuadPart;
+	mMapping = CreateFileMappingW((HANDLE) mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mMapping)
+	{
+		close();
+		return false;
+	}
+	mData = (const U8*) MapViewOfFile((HANDLE) mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mData)
+	{
+		close();
+		return false;
+	}
+	return true;
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	size_t size = (size_t) st.st_size;
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	mData = (const U8*) data;
+	mSize = size;
+	return true;
+#endif
+}
+
+void LLMappedFile::close()
+{
+#if LL_WINDOWS
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping)
+	{
+		CloseHandle((HANDLE) mMapping);
+		mMapping = NULL;
+	}
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE) mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mData)
+	{
+		munmap((void*) mData, mSize);
+	}
+#endif
+	mData = NULL;
+	mSize = 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file llmappedfile.h
+ * @brief LLMappedFile class, a read-only memory map of a whole file.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <string>
+
+#include "stdtypes.h"
+
+// Read-only view of a whole file, unmapped when it goes.  Empty files
+// don't map.
+class LL_COMMON_API LLMappedFile
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	bool open(const std::string& filename);
+	void close();
+
+	const U8* data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	// not copyable
+	LLMappedFile(const LLMappedFile&);
+	LLMappedFile& operator=(const LLMappedFile&);
+
+	const U8* mData;
+	size_t mSize;
+#if LL_WINDOWS
+	void* mFile;
+	void* mMapping;
+#endif
+};
+
+#endif // LL_LLMAPPEDFILE_H
@@ -36,6 +36,10 @@
 #include "llsdserialize.h"
 #include "stringize.h"
 #include "llrand.h"
+#include "llmutex.h"
+#include "llstringtable.h"
+
+#include <boost/thread/tss.hpp>
 
 #ifndef LL_RELEASE_FOR_DOWNLOAD
 #define NAME_UNNAMED_NAMESPACE
@@ -142,7 +146,7 @@ public:
 	virtual const LLSD& ref(Integer) const		{ return undef(); }
 
 	virtual LLSD::map_const_iterator beginMap() const { return endMap(); }
-	virtual LLSD::map_const_iterator endMap() const { static const std::map<String, LLSD> empty; return empty.end(); }
+	virtual LLSD::map_const_iterator endMap() const { static const std::vector<LLSD::MapEntry*> empty; return empty.end(); }
 	virtual LLSD::array_const_iterator beginArray() const { return endArray(); }
 	virtual LLSD::array_const_iterator endArray() const { static const std::vector<LLSD> empty; return empty.end(); }
 
@@ -356,18 +360,97 @@ namespace
 	};
 
 
+	// Keys up to this long are interned.  Longer ones are mostly ids, which
+	// would only fill up the table, and stay with their entries.
+	const size_t MAX_INTERNED_KEY_LENGTH = 32;
+
+	// the shared table's strings a thread has already looked up
+	typedef std::set<LLStdStringHandle, compare_pointer_contents<std::string> > key_cache_t;
+
+	// Keys live as long as the process.  The table is never destroyed, maps
+	// in other statics may still use it on the way out.
+	const LLSD::String& intern_key(const LLSD::String& k)
+	{
+		static LLStdStringTable* sKeys = new LLStdStringTable(4096);
+		static LLMutex* sKeysMutex = new LLMutex();
+		// Parsers on different threads only meet on the lock for keys
+		// their own thread hasn't seen yet, which are few after warm up.
+		static boost::thread_specific_ptr<key_cache_t>* sThreadKeys = new boost::thread_specific_ptr<key_cache_t>();
+
+		key_cache_t* cache = sThreadKeys->get();
+		if (!cache)
+		{
+			cache = new key_cache_t();
+			sThreadKeys->reset(cache);
+		}
+
+		key_cache_t::const_iterator iter = cache->find(&k);
+		if (iter != cache->end())
+		{
+			return **iter;
+		}
+
+		LLStdStringHandle key;
+		{
+			LLMutexLock lock(sKeysMutex);
+			key = sKeys->insert(k);
+		}
+		cache->insert(key);
+		return *key;
+	}
+
+	struct OwnedMapEntry : public LLSD::MapEntry
+	{
+		OwnedMapEntry(const LLSD::String& k, const LLSD& v)
+		:	LLSD::MapEntry(mKey, v),
+			mKey(k)
+		{
+		}
+
+		LLSD::String mKey;
+	};
+
+	LLSD::MapEntry* new_map_entry(const LLSD::String& k, const LLSD& v)
+	{
+		if (k.size() > MAX_INTERNED_KEY_LENGTH)
+		{
+			return new OwnedMapEntry(k, v);
+		}
+		return new LLSD::MapEntry(intern_key(k), v);
+	}
+
+	void delete_map_entry(LLSD::MapEntry* entry)
+	{
+		if (entry->first.size() > MAX_INTERNED_KEY_LENGTH)
+		{
+			delete static_cast<OwnedMapEntry*>(entry);
+		}
+		else
+		{
+			delete entry;
+		}
+	}
+
+	bool entry_less(const LLSD::MapEntry* entry, const LLSD::String& k)
+	{
+		return entry->first < k;
+	}
+
 	class ImplMap : public LLSD::Impl
 	{
 	private:
-		typedef std::map<LLSD::String, LLSD>	DataMap;
+		// sorted by key, the entries themselves never move so references
+		// to their values stay good
+		typedef std::vector<LLSD::MapEntry*>	DataMap;
 		
 		DataMap mData;
 		
 	protected:
-		ImplMap(const DataMap& data) : mData(data) { }
+		ImplMap(const DataMap& data);
 		
 	public:
 		ImplMap() { }
+		~ImplMap();
 		
 		virtual ImplMap& makeMap(LLSD::Impl*&);
 
@@ -388,15 +471,48 @@ namespace
 
 		virtual int size() const { return mData.size(); }
 
-		LLSD::map_iterator beginMap() { return mData.begin(); }
-		LLSD::map_iterator endMap() { return mData.end(); }
-		virtual LLSD::map_const_iterator beginMap() const { return mData.begin(); }
-		virtual LLSD::map_const_iterator endMap() const { return mData.end(); }
+		LLSD::map_iterator beginMap() { return LLSD::map_iterator(mData.begin()); }
+		LLSD::map_iterator endMap() { return LLSD::map_iterator(mData.end()); }
+		virtual LLSD::map_const_iterator beginMap() const { return LLSD::map_const_iterator(mData.begin()); }
+		virtual LLSD::map_const_iterator endMap() const { return LLSD::map_const_iterator(mData.end()); }
 
 		virtual void dumpStats() const;
 		virtual void calcStats(S32 type_counts[], S32 share_counts[]) const;
+
+	private:
+		// where k is or would go
+		DataMap::iterator lowerBound(const LLSD::String& k);
+		DataMap::const_iterator lowerBound(const LLSD::String& k) const;
+		// the entry for k, or NULL
+		const LLSD::MapEntry* find(const LLSD::String& k) const;
 	};
 	
+	ImplMap::ImplMap(const DataMap& data)
+	{
+		mData.reserve(data.size());
+		for (DataMap::const_iterator i = data.begin(); i != data.end(); ++i)
+		{
+			// already interned, only share the key
+			LLSD::MapEntry* entry = *i;
+			if (entry->first.size() > MAX_INTERNED_KEY_LENGTH)
+			{
+				mData.push_back(new OwnedMapEntry(entry->first, entry->second));
+			}
+			else
+			{
+				mData.push_back(new LLSD::MapEntry(entry->first, entry->second));
+			}
+		}
+	}
+
+	ImplMap::~ImplMap()
+	{
+		for (DataMap::iterator i = mData.begin(); i != mData.end(); ++i)
+		{
+			delete_map_entry(*i);
+		}
+	}
+
 	ImplMap& ImplMap::makeMap(LLSD::Impl*& var)
 	{
 		if (shared())
@@ -411,42 +527,71 @@ namespace
 		}
 	}
 	
+	ImplMap::DataMap::iterator ImplMap::lowerBound(const LLSD::String& k)
+	{
+		// maps are mostly built in key order
+		if (mData.empty() || mData.back()->first < k)
+		{
+			return mData.end();
+		}
+		return std::lower_bound(mData.begin(), mData.end(), k, entry_less);
+	}
+
+	ImplMap::DataMap::const_iterator ImplMap::lowerBound(const LLSD::String& k) const
+	{
+		return std::lower_bound(mData.begin(), mData.end(), k, entry_less);
+	}
+
+	const LLSD::MapEntry* ImplMap::find(const LLSD::String& k) const
+	{
+		DataMap::const_iterator i = lowerBound(k);
+		return (i != mData.end() && (*i)->first == k) ? *i : NULL;
+	}
+
 	bool ImplMap::has(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.find(k);
-		return i != mData.end();
+		return find(k) != NULL;
 	}
 	
 	LLSD ImplMap::get(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.find(k);
-		return (i != mData.end()) ? i->second : LLSD();
+		const LLSD::MapEntry* entry = find(k);
+		return entry ? entry->second : LLSD();
 	}
 	
 	void ImplMap::insert(const LLSD::String& k, const LLSD& v)
 	{
-		mData.insert(DataMap::value_type(k, v));
+		DataMap::iterator i = lowerBound(k);
+		if (i == mData.end() || (*i)->first != k)
+		{
+			mData.insert(i, new_map_entry(k, v));
+		}
 	}
 	
 	void ImplMap::erase(const LLSD::String& k)
 	{
-		mData.erase(k);
+		DataMap::iterator i = lowerBound(k);
+		if (i != mData.end() && (*i)->first == k)
+		{
+			delete_map_entry(*i);
+			mData.erase(i);
+		}
 	}
 	
 	LLSD& ImplMap::ref(const LLSD::String& k)
 	{
-		return mData[k];
+		DataMap::iterator i = lowerBound(k);
+		if (i == mData.end() || (*i)->first != k)
+		{
+			i = mData.insert(i, new_map_entry(k, LLSD()));
+		}
+		return (*i)->second;
 	}
 	
 	const LLSD& ImplMap::ref(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.lower_bound(k);
-		if (i == mData.end()  ||  mData.key_comp()(k, i->first))
-		{
-			return undef();
-		}
-		
-		return i->second;
+		const LLSD::MapEntry* entry = find(k);
+		return entry ? entry->second : undef();
 	}
 
 	void ImplMap::dumpStats() const
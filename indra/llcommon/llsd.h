@@ -31,6 +31,8 @@
 #include <string>
 #include <vector>
 
+#include <boost/iterator/indirect_iterator.hpp>
+
 #include "stdtypes.h"
 
 #include "lldate.h"
@@ -77,6 +79,11 @@
 	A map is a dictionary mapping String keys to LLSD values.  The keys are
 	unique within a map, and have only one value (though that value could be
 	an LLSD array).
+
+	Maps are kept as a sorted vector of entries, and iterate in key order
+	like a std::map.  Short keys are interned and shared by every map that
+	uses them.  References to values stay good while a map grows, but
+	iterators don't: adding a key invalidates the map's iterators.
 	
 	An array is a sequence of zero or more LLSD values.
 	
@@ -313,8 +320,9 @@ public:
 	//@{
 		int size() const;
 
-		typedef std::map<String, LLSD>::iterator		map_iterator;
-		typedef std::map<String, LLSD>::const_iterator	map_const_iterator;
+		struct MapEntry;
+		typedef boost::indirect_iterator<std::vector<MapEntry*>::iterator, MapEntry>				map_iterator;
+		typedef boost::indirect_iterator<std::vector<MapEntry*>::const_iterator, const MapEntry>	map_const_iterator;
 		
 		map_iterator		beginMap();
 		map_iterator		endMap();
@@ -412,6 +420,16 @@ public:
 	static std::string		typeString(Type type);		// Return human-readable type as a string
 };
 
+/// What a map iterator points at, used like the std::pair of a std::map.
+/// The key may be shared with other maps, so entries can't be assigned.
+struct LLSD::MapEntry
+{
+	MapEntry(const String& key, const LLSD& value) : first(key), second(value) { }
+
+	const String&	first;
+	LLSD			second;
+};
+
 struct llsd_select_bool : public std::unary_function<LLSD, LLSD::Boolean>
 {
 	LLSD::Boolean operator()(const LLSD& sd) const
@@ -29,6 +29,7 @@
 #include "linden_common.h"
 #include "llsdserialize.h"
 #include "llpointer.h"
+#include "llmemorystream.h"
 #include "llstreamtools.h" // for fullread
 
 #include <iostream>
@@ -305,6 +306,154 @@ static const char BINARY_TRUE_SERIAL = '1';
 static const char BINARY_FALSE_SERIAL = '0';
 
 
+/**
+ * LLSDVisitor
+ */
+// virtual
+LLSDVisitor::~LLSDVisitor()
+{ }
+
+void LLSDVisitor::visit(const LLSD& data)
+{
+	switch(data.type())
+	{
+	case LLSD::TypeMap:
+		if(beginMap())
+		{
+			for(LLSD::map_const_iterator it = data.beginMap(); it != data.endMap(); ++it)
+			{
+				if(key(it->first))
+				{
+					visit(it->second);
+				}
+			}
+			endMap();
+		}
+		break;
+
+	case LLSD::TypeArray:
+		if(beginArray())
+		{
+			for(LLSD::array_const_iterator it = data.beginArray(); it != data.endArray(); ++it)
+			{
+				visit(*it);
+			}
+			endArray();
+		}
+		break;
+
+	case LLSD::TypeBoolean:
+		boolean(data.asBoolean());
+		break;
+
+	case LLSD::TypeInteger:
+		integer(data.asInteger());
+		break;
+
+	case LLSD::TypeReal:
+		real(data.asReal());
+		break;
+
+	case LLSD::TypeString:
+		string(data.asStringRef());
+		break;
+
+	case LLSD::TypeUUID:
+		uuid(data.asUUID());
+		break;
+
+	case LLSD::TypeDate:
+		date(data.asDate());
+		break;
+
+	case LLSD::TypeURI:
+		uri(data.asURI());
+		break;
+
+	case LLSD::TypeBinary:
+		binary(data.asBinary());
+		break;
+
+	default:
+		undefined();
+		break;
+	}
+}
+
+// virtual
+void LLSDVisitor::binaryView(const U8* data, size_t size)
+{
+	binary(LLSD::Binary(data, data + size));
+}
+
+
+/**
+ * LLSDBuilder
+ */
+LLSDBuilder::LLSDBuilder(LLSD& result)
+	: mResult(result)
+{
+}
+
+LLSD& LLSDBuilder::next()
+{
+	if(mContainers.empty())
+	{
+		return mResult;
+	}
+	LLSD& container = *mContainers.back();
+	if(container.isArray())
+	{
+		container.append(LLSD());
+		return container[container.size() - 1];
+	}
+	// references to map values stay valid as the map grows
+	return container[mKey];
+}
+
+bool LLSDBuilder::beginMap()
+{
+	LLSD& map = next();
+	map = LLSD::emptyMap();
+	mContainers.push_back(&map);
+	return true;
+}
+
+void LLSDBuilder::endMap()
+{
+	mContainers.pop_back();
+}
+
+bool LLSDBuilder::key(const LLSD::String& key)
+{
+	mKey = key;
+	return true;
+}
+
+bool LLSDBuilder::beginArray()
+{
+	LLSD& array = next();
+	array = LLSD::emptyArray();
+	mContainers.push_back(&array);
+	return true;
+}
+
+void LLSDBuilder::endArray()
+{
+	mContainers.pop_back();
+}
+
+void LLSDBuilder::undefined()							{ next().clear(); }
+void LLSDBuilder::boolean(LLSD::Boolean value)			{ next() = value; }
+void LLSDBuilder::integer(LLSD::Integer value)			{ next() = value; }
+void LLSDBuilder::real(LLSD::Real value)				{ next() = value; }
+void LLSDBuilder::string(const LLSD::String& value)		{ next() = value; }
+void LLSDBuilder::uuid(const LLSD::UUID& value)			{ next() = value; }
+void LLSDBuilder::date(const LLSD::Date& value)			{ next() = value; }
+void LLSDBuilder::uri(const LLSD::URI& value)			{ next() = value; }
+void LLSDBuilder::binary(const LLSD::Binary& value)		{ next() = value; }
+
+
 /**
  * LLSDParser
  */
@@ -333,6 +482,25 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 	return doParse(istr, data);
 }
 
+S32 LLSDParser::visit(std::istream& istr, LLSDVisitor& visitor, S32 max_bytes)
+{
+	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
+	mMaxBytesLeft = max_bytes;
+	return doVisit(istr, visitor);
+}
+
+// virtual
+S32 LLSDParser::doVisit(std::istream& istr, LLSDVisitor& visitor) const
+{
+	LLSD data;
+	S32 parse_count = doParse(istr, data);
+	if(parse_count > 0)
+	{
+		visitor.visit(data);
+	}
+	return parse_count;
+}
+
 
 int LLSDParser::get(std::istream& istr) const
 {
@@ -1211,163 +1379,1075 @@ bool LLSDBinaryParser::parseString(
 	return true;
 }
 
-
-/**
- * LLSDFormatter
- */
-LLSDFormatter::LLSDFormatter() :
-	mBoolAlpha(false)
-{
-}
-
-// virtual
-LLSDFormatter::~LLSDFormatter()
-{ }
-
-void LLSDFormatter::boolalpha(bool alpha)
-{
-	mBoolAlpha = alpha;
-}
-
-void LLSDFormatter::realFormat(const std::string& format)
-{
-	mRealFormat = format;
-}
-
-void LLSDFormatter::formatReal(LLSD::Real real, std::ostream& ostr) const
-{
-	std::string buffer = llformat(mRealFormat.c_str(), real);
-	ostr << buffer;
-}
-
-/**
- * LLSDNotationFormatter
- */
-LLSDNotationFormatter::LLSDNotationFormatter()
-{
-}
-
-// virtual
-LLSDNotationFormatter::~LLSDNotationFormatter()
-{ }
-
-// static
-std::string LLSDNotationFormatter::escapeString(const std::string& in)
+bool LLSDBinaryParser::skipSized(std::istream& istr) const
 {
-	std::ostringstream ostr;
-	serialize_string(in, ostr);
-	return ostr.str();
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
+	if(size < 0) return false;
+	istr.ignore(size);
+	account((int)istr.gcount());
+	return istr.gcount() == size;
 }
 
 // virtual
-S32 LLSDNotationFormatter::format(const LLSD& data, std::ostream& ostr, U32 options) const
+S32 LLSDBinaryParser::doVisit(std::istream& istr, LLSDVisitor& visitor) const
 {
-	S32 rv = format_impl(data, ostr, options, 0);
-	return rv;
+	return visitValue(istr, &visitor);
 }
 
-S32 LLSDNotationFormatter::format_impl(const LLSD& data, std::ostream& ostr, U32 options, U32 level) const
+// Reads the same as doParse(), but nothing is kept: values go to the
+// visitor as they are read, and skipped strings and binaries are never
+// copied out of the stream.
+S32 LLSDBinaryParser::visitValue(std::istream& istr, LLSDVisitor* visitor) const
 {
-	S32 format_count = 1;
-	std::string pre;
-	std::string post;
-
-	if (options & LLSDFormatter::OPTIONS_PRETTY)
+	char c;
+	c = get(istr);
+	if(!istr.good())
 	{
-		for (U32 i = 0; i < level; i++)
-		{
-			pre += "    ";
-		}
-		post = "\n";
+		return 0;
 	}
-
-	switch(data.type())
+	S32 parse_count = 1;
+	switch(c)
 	{
-	case LLSD::TypeMap:
+	case '{':
 	{
-		if (0 != level) ostr << post << pre;
-		ostr << "{";
-		std::string inner_pre;
-		if (options & LLSDFormatter::OPTIONS_PRETTY)
+		S32 child_count = visitMap(istr, visitor);
+		if(child_count == PARSE_FAILURE)
 		{
-			inner_pre = pre + "    ";
+			parse_count = PARSE_FAILURE;
 		}
-
-		bool need_comma = false;
-		LLSD::map_const_iterator iter = data.beginMap();
-		LLSD::map_const_iterator end = data.endMap();
-		for(; iter != end; ++iter)
+		else
 		{
-			if(need_comma) ostr << ",";
-			need_comma = true;
-			ostr << post << inner_pre << '\'';
-			serialize_string((*iter).first, ostr);
-			ostr << "':";
-			format_count += format_impl((*iter).second, ostr, options, level + 2);
+			parse_count += child_count;
 		}
-		ostr << post << pre << "}";
 		break;
 	}
 
-	case LLSD::TypeArray:
+	case '[':
 	{
-		ostr << post << pre << "[";
-		bool need_comma = false;
-		LLSD::array_const_iterator iter = data.beginArray();
-		LLSD::array_const_iterator end = data.endArray();
-		for(; iter != end; ++iter)
+		S32 child_count = visitArray(istr, visitor);
+		if(child_count == PARSE_FAILURE)
 		{
-			if(need_comma) ostr << ",";
-			need_comma = true;
-			format_count += format_impl(*iter, ostr, options, level + 1);
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
 		}
-		ostr << "]";
 		break;
 	}
 
-	case LLSD::TypeUndefined:
-		ostr << "!";
+	case '!':
+		if(visitor) visitor->undefined();
 		break;
 
-	case LLSD::TypeBoolean:
-		if(mBoolAlpha ||
-#if( LL_WINDOWS || __GNUC__ > 2)
-		   (ostr.flags() & std::ios::boolalpha)
-#else
-		   (ostr.flags() & 0x0100)
-#endif
-			)
-		{
-			ostr << (data.asBoolean()
-					 ? NOTATION_TRUE_SERIAL : NOTATION_FALSE_SERIAL);
-		}
-		else
-		{
-			ostr << (data.asBoolean() ? 1 : 0);
-		}
+	case '0':
+		if(visitor) visitor->boolean(false);
 		break;
 
-	case LLSD::TypeInteger:
-		ostr << "i" << data.asInteger();
+	case '1':
+		if(visitor) visitor->boolean(true);
 		break;
 
-	case LLSD::TypeReal:
-		ostr << "r";
-		if(mRealFormat.empty())
+	case 'i':
+	{
+		U32 value_nbo = 0;
+		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
+		if(istr.fail())
 		{
-			ostr << data.asReal();
+			LL_INFOS() << "STREAM FAILURE reading binary integer." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
 		}
-		else
+		else if(visitor)
 		{
-			formatReal(data.asReal(), ostr);
+			visitor->integer((S32)ntohl(value_nbo));
 		}
 		break;
+	}
 
-	case LLSD::TypeUUID:
-		ostr << "u" << data.asUUID();
-		break;
-
-	case LLSD::TypeString:
+	case 'r':
+	{
+		F64 real_nbo = 0.0;
+		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary real." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else if(visitor)
+		{
+			visitor->real(ll_ntohd(real_nbo));
+		}
+		break;
+	}
+
+	case 'u':
+	{
+		LLUUID id;
+		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary uuid." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else if(visitor)
+		{
+			visitor->uuid(id);
+		}
+		break;
+	}
+
+	case '\'':
+	case '"':
+	{
+		std::string value;
+		int cnt = deserialize_string_delim(istr, value, c);
+		if((PARSE_FAILURE == cnt) || istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary (notation-style) string."
+				<< LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			account(cnt);
+			if(visitor) visitor->string(value);
+		}
+		break;
+	}
+
+	case 's':
+	case 'l':
+	{
+		bool ok;
+		std::string value;
+		if(visitor)
+		{
+			ok = parseString(istr, value);
+		}
+		else
+		{
+			ok = skipSized(istr);
+		}
+		if(!ok || istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary " << (c == 's' ? "string." : "link.")
+				<< LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else if(visitor)
+		{
+			if(c == 's')
+			{
+				visitor->string(value);
+			}
+			else
+			{
+				visitor->uri(LLURI(value));
+			}
+		}
+		break;
+	}
+
+	case 'd':
+	{
+		F64 real = 0.0;
+		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary date." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else if(visitor)
+		{
+			visitor->date(LLDate(real));
+		}
+		break;
+	}
+
+	case 'b':
+	{
+		if(!visitor)
+		{
+			if(!skipSized(istr))
+			{
+				parse_count = PARSE_FAILURE;
+			}
+			break;
+		}
+		U32 size_nbo = 0;
+		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
+		S32 size = (S32)ntohl(size_nbo);
+		if(mCheckLimits && (size > mMaxBytesLeft))
+		{
+			parse_count = PARSE_FAILURE;
+			break;
+		}
+		std::vector<U8> value;
+		if(size > 0)
+		{
+			value.resize(size);
+			account((int)fullread(istr, (char*)&value[0], size));
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			visitor->binary(value);
+		}
+		break;
+	}
+
+	default:
+		parse_count = PARSE_FAILURE;
+		LL_INFOS() << "Unrecognized character while parsing: int(" << (int)c
+			<< ")" << LL_ENDL;
+		break;
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::visitMap(std::istream& istr, LLSDVisitor* visitor) const
+{
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	if(visitor && !visitor->beginMap())
+	{
+		visitor = NULL;
+	}
+	S32 parse_count = 0;
+	S32 count = 0;
+	std::string name;
+	char c = get(istr);
+	while(c != '}' && (count < size) && istr.good())
+	{
+		name.clear();
+		switch(c)
+		{
+		case 'k':
+			if(!(visitor ? parseString(istr, name) : skipSized(istr)))
+			{
+				return PARSE_FAILURE;
+			}
+			break;
+		case '\'':
+		case '"':
+		{
+			int cnt = deserialize_string_delim(istr, name, c);
+			if(PARSE_FAILURE == cnt) return PARSE_FAILURE;
+			account(cnt);
+			break;
+		}
+		}
+		LLSDVisitor* child_visitor = (visitor && visitor->key(name)) ? visitor : NULL;
+		S32 child_count = visitValue(istr, child_visitor);
+		if(child_count > 0)
+		{
+			// There must be a value for every key, thus child_count
+			// must be greater than 0.
+			parse_count += child_count;
+		}
+		else
+		{
+			return PARSE_FAILURE;
+		}
+		++count;
+		c = get(istr);
+	}
+	if((c != '}') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	if(visitor) visitor->endMap();
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::visitArray(std::istream& istr, LLSDVisitor* visitor) const
+{
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	if(visitor && !visitor->beginArray())
+	{
+		visitor = NULL;
+	}
+	S32 parse_count = 0;
+	S32 count = 0;
+	char c = istr.peek();
+	while((c != ']') && (count < size) && istr.good())
+	{
+		S32 child_count = visitValue(istr, visitor);
+		if(PARSE_FAILURE == child_count)
+		{
+			return PARSE_FAILURE;
+		}
+		parse_count += child_count;
+		++count;
+		c = istr.peek();
+	}
+	c = get(istr);
+	if((c != ']') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	if(visitor) visitor->endArray();
+	return parse_count;
+}
+
+
+/**
+ * LLSDBinaryBufferReader
+ */
+namespace
+{
+	// The binary format again, straight out of memory for the buffer
+	// versions of LLSDSerialize::fromBinary() and visitBinary().  It
+	// reads what LLSDBinaryParser reads, with the end of the buffer
+	// checked before every read, and hands out binaries as views into
+	// the buffer when visiting.
+	class LLSDBinaryBufferReader
+	{
+	public:
+		LLSDBinaryBufferReader(const U8* data, size_t size)
+		:	mPos(data),
+			mEnd(data + size)
+		{
+		}
+
+		S32 parse(LLSD& data);
+		// skips the value when visitor is NULL
+		S32 visit(LLSDVisitor* visitor);
+
+		const U8* getPosition() const	{ return mPos; }
+
+	private:
+		S32 parseMap(LLSD& map);
+		S32 parseArray(LLSD& array);
+		S32 visitMap(LLSDVisitor* visitor);
+		S32 visitArray(LLSDVisitor* visitor);
+
+		bool readU32(U32& value);
+		bool readF64(F64& value);
+		bool readUUID(LLUUID& value);
+		// a size prefixed string or binary, left where it is
+		bool readSized(const U8*& data, S32& size);
+		// a notation style string, after its delimiter
+		bool readDelimited(std::string& value, char delim);
+		bool readKey(std::string& key);
+
+		bool atEnd(char c) const	{ return mPos < mEnd && *mPos == c; }
+
+		const U8* mPos;
+		const U8* mEnd;
+	};
+
+	bool LLSDBinaryBufferReader::readU32(U32& value)
+	{
+		if(mEnd - mPos < (S32)sizeof(U32))
+		{
+			return false;
+		}
+		U32 value_nbo;
+		memcpy(&value_nbo, mPos, sizeof(U32));		/* Flawfinder: ignore */
+		value = ntohl(value_nbo);
+		mPos += sizeof(U32);
+		return true;
+	}
+
+	bool LLSDBinaryBufferReader::readF64(F64& value)
+	{
+		if(mEnd - mPos < (S32)sizeof(F64))
+		{
+			return false;
+		}
+		memcpy(&value, mPos, sizeof(F64));		/* Flawfinder: ignore */
+		mPos += sizeof(F64);
+		return true;
+	}
+
+	bool LLSDBinaryBufferReader::readUUID(LLUUID& value)
+	{
+		if(mEnd - mPos < UUID_BYTES)
+		{
+			return false;
+		}
+		memcpy(value.mData, mPos, UUID_BYTES);		/* Flawfinder: ignore */
+		mPos += UUID_BYTES;
+		return true;
+	}
+
+	bool LLSDBinaryBufferReader::readSized(const U8*& data, S32& size)
+	{
+		U32 size_nbo;
+		if(!readU32(size_nbo))
+		{
+			return false;
+		}
+		size = (S32)size_nbo;
+		if(size < 0 || size > mEnd - mPos)
+		{
+			return false;
+		}
+		data = mPos;
+		mPos += size;
+		return true;
+	}
+
+	bool LLSDBinaryBufferReader::readDelimited(std::string& value, char delim)
+	{
+		// rare enough in binary LLSD to go through the stream version
+		LLMemoryStream istr(mPos, (S32)(mEnd - mPos));
+		int cnt = deserialize_string_delim(istr, value, delim);
+		if(LLSDParser::PARSE_FAILURE == cnt)
+		{
+			return false;
+		}
+		mPos += cnt;
+		return true;
+	}
+
+	bool LLSDBinaryBufferReader::readKey(std::string& key)
+	{
+		key.clear();
+		char c = *mPos++;
+		switch(c)
+		{
+		case 'k':
+		{
+			const U8* data;
+			S32 size;
+			if(!readSized(data, size))
+			{
+				return false;
+			}
+			key.assign((const char*)data, size);
+			break;
+		}
+		case '\'':
+		case '"':
+			return readDelimited(key, c);
+		}
+		return true;
+	}
+
+	S32 LLSDBinaryBufferReader::parse(LLSD& data)
+	{
+		if(mPos >= mEnd)
+		{
+			return 0;
+		}
+		char c = *mPos++;
+		S32 parse_count = 1;
+		switch(c)
+		{
+		case '{':
+		case '[':
+		{
+			S32 child_count = (c == '{') ? parseMap(data) : parseArray(data);
+			if(child_count == LLSDParser::PARSE_FAILURE)
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else
+			{
+				parse_count += child_count;
+			}
+			break;
+		}
+
+		case '!':
+			data.clear();
+			break;
+
+		case '0':
+			data = false;
+			break;
+
+		case '1':
+			data = true;
+			break;
+
+		case 'i':
+		{
+			U32 value;
+			if(readU32(value))
+			{
+				data = (S32)value;
+			}
+			else
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'r':
+		{
+			F64 real_nbo;
+			if(readF64(real_nbo))
+			{
+				data = ll_ntohd(real_nbo);
+			}
+			else
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 'u':
+		{
+			LLUUID id;
+			if(readUUID(id))
+			{
+				data = id;
+			}
+			else
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case '\'':
+		case '"':
+		{
+			std::string value;
+			if(readDelimited(value, c))
+			{
+				data = value;
+			}
+			else
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		case 's':
+		case 'l':
+		case 'b':
+		{
+			const U8* value;
+			S32 size;
+			if(!readSized(value, size))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(c == 's')
+			{
+				data = std::string((const char*)value, size);
+			}
+			else if(c == 'l')
+			{
+				data = LLURI(std::string((const char*)value, size));
+			}
+			else
+			{
+				data = LLSD::Binary(value, value + size);
+			}
+			break;
+		}
+
+		case 'd':
+		{
+			F64 real;
+			if(readF64(real))
+			{
+				data = LLDate(real);
+			}
+			else
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			break;
+		}
+
+		default:
+			parse_count = LLSDParser::PARSE_FAILURE;
+			LL_INFOS() << "Unrecognized character while parsing: int(" << (int)c
+				<< ")" << LL_ENDL;
+			break;
+		}
+		if(LLSDParser::PARSE_FAILURE == parse_count)
+		{
+			data.clear();
+		}
+		return parse_count;
+	}
+
+	S32 LLSDBinaryBufferReader::parseMap(LLSD& map)
+	{
+		map = LLSD::emptyMap();
+		U32 size_nbo;
+		if(!readU32(size_nbo))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		S32 size = (S32)size_nbo;
+		S32 parse_count = 0;
+		S32 count = 0;
+		std::string name;
+		while(mPos < mEnd && !atEnd('}') && (count < size))
+		{
+			if(!readKey(name))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			LLSD child;
+			S32 child_count = parse(child);
+			if(child_count <= 0)
+			{
+				// There must be a value for every key.
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += child_count;
+			map.insert(name, child);
+			++count;
+		}
+		if(!atEnd('}') || (count < size))
+		{
+			// Make sure it is correctly terminated and we parsed as many
+			// as were said to be there.
+			return LLSDParser::PARSE_FAILURE;
+		}
+		++mPos;
+		return parse_count;
+	}
+
+	S32 LLSDBinaryBufferReader::parseArray(LLSD& array)
+	{
+		array = LLSD::emptyArray();
+		U32 size_nbo;
+		if(!readU32(size_nbo))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		S32 size = (S32)size_nbo;
+		S32 parse_count = 0;
+		S32 count = 0;
+		while(mPos < mEnd && !atEnd(']') && (count < size))
+		{
+			LLSD child;
+			S32 child_count = parse(child);
+			if(LLSDParser::PARSE_FAILURE == child_count)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += child_count;
+			array.append(child);
+			++count;
+		}
+		if(!atEnd(']') || (count < size))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		++mPos;
+		return parse_count;
+	}
+
+	S32 LLSDBinaryBufferReader::visit(LLSDVisitor* visitor)
+	{
+		if(mPos >= mEnd)
+		{
+			return 0;
+		}
+		char c = *mPos++;
+		S32 parse_count = 1;
+		switch(c)
+		{
+		case '{':
+		case '[':
+		{
+			S32 child_count = (c == '{') ? visitMap(visitor) : visitArray(visitor);
+			if(child_count == LLSDParser::PARSE_FAILURE)
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else
+			{
+				parse_count += child_count;
+			}
+			break;
+		}
+
+		case '!':
+			if(visitor) visitor->undefined();
+			break;
+
+		case '0':
+		case '1':
+			if(visitor) visitor->boolean(c == '1');
+			break;
+
+		case 'i':
+		{
+			U32 value;
+			if(!readU32(value))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(visitor)
+			{
+				visitor->integer((S32)value);
+			}
+			break;
+		}
+
+		case 'r':
+		{
+			F64 real_nbo;
+			if(!readF64(real_nbo))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(visitor)
+			{
+				visitor->real(ll_ntohd(real_nbo));
+			}
+			break;
+		}
+
+		case 'u':
+		{
+			LLUUID id;
+			if(!readUUID(id))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(visitor)
+			{
+				visitor->uuid(id);
+			}
+			break;
+		}
+
+		case '\'':
+		case '"':
+		{
+			std::string value;
+			if(!readDelimited(value, c))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(visitor)
+			{
+				visitor->string(value);
+			}
+			break;
+		}
+
+		case 's':
+		case 'l':
+		case 'b':
+		{
+			const U8* value;
+			S32 size;
+			if(!readSized(value, size))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(!visitor)
+			{
+				// skipped
+			}
+			else if(c == 's')
+			{
+				visitor->string(std::string((const char*)value, size));
+			}
+			else if(c == 'l')
+			{
+				visitor->uri(LLURI(std::string((const char*)value, size)));
+			}
+			else
+			{
+				visitor->binaryView(value, size);
+			}
+			break;
+		}
+
+		case 'd':
+		{
+			F64 real;
+			if(!readF64(real))
+			{
+				parse_count = LLSDParser::PARSE_FAILURE;
+			}
+			else if(visitor)
+			{
+				visitor->date(LLDate(real));
+			}
+			break;
+		}
+
+		default:
+			parse_count = LLSDParser::PARSE_FAILURE;
+			LL_INFOS() << "Unrecognized character while parsing: int(" << (int)c
+				<< ")" << LL_ENDL;
+			break;
+		}
+		return parse_count;
+	}
+
+	S32 LLSDBinaryBufferReader::visitMap(LLSDVisitor* visitor)
+	{
+		U32 size_nbo;
+		if(!readU32(size_nbo))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		S32 size = (S32)size_nbo;
+		if(visitor && !visitor->beginMap())
+		{
+			visitor = NULL;
+		}
+		S32 parse_count = 0;
+		S32 count = 0;
+		std::string name;
+		while(mPos < mEnd && !atEnd('}') && (count < size))
+		{
+			if(!readKey(name))
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			LLSDVisitor* child_visitor = (visitor && visitor->key(name)) ? visitor : NULL;
+			S32 child_count = visit(child_visitor);
+			if(child_count <= 0)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += child_count;
+			++count;
+		}
+		if(!atEnd('}') || (count < size))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		++mPos;
+		if(visitor) visitor->endMap();
+		return parse_count;
+	}
+
+	S32 LLSDBinaryBufferReader::visitArray(LLSDVisitor* visitor)
+	{
+		U32 size_nbo;
+		if(!readU32(size_nbo))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		S32 size = (S32)size_nbo;
+		if(visitor && !visitor->beginArray())
+		{
+			visitor = NULL;
+		}
+		S32 parse_count = 0;
+		S32 count = 0;
+		while(mPos < mEnd && !atEnd(']') && (count < size))
+		{
+			S32 child_count = visit(visitor);
+			if(LLSDParser::PARSE_FAILURE == child_count)
+			{
+				return LLSDParser::PARSE_FAILURE;
+			}
+			parse_count += child_count;
+			++count;
+		}
+		if(!atEnd(']') || (count < size))
+		{
+			return LLSDParser::PARSE_FAILURE;
+		}
+		++mPos;
+		if(visitor) visitor->endArray();
+		return parse_count;
+	}
+}
+
+// static
+S32 LLSDSerialize::fromBinary(LLSD& sd, const U8* data, size_t size, size_t* used)
+{
+	LLSDBinaryBufferReader reader(data, size);
+	S32 parse_count = reader.parse(sd);
+	if(used)
+	{
+		*used = reader.getPosition() - data;
+	}
+	return parse_count;
+}
+
+// static
+S32 LLSDSerialize::visitBinary(LLSDVisitor& visitor, const U8* data, size_t size)
+{
+	LLSDBinaryBufferReader reader(data, size);
+	return reader.visit(&visitor);
+}
+
+
+/**
+ * LLSDFormatter
+ */
+LLSDFormatter::LLSDFormatter() :
+	mBoolAlpha(false)
+{
+}
+
+// virtual
+LLSDFormatter::~LLSDFormatter()
+{ }
+
+void LLSDFormatter::boolalpha(bool alpha)
+{
+	mBoolAlpha = alpha;
+}
+
+void LLSDFormatter::realFormat(const std::string& format)
+{
+	mRealFormat = format;
+}
+
+void LLSDFormatter::formatReal(LLSD::Real real, std::ostream& ostr) const
+{
+	std::string buffer = llformat(mRealFormat.c_str(), real);
+	ostr << buffer;
+}
+
+/**
+ * LLSDNotationFormatter
+ */
+LLSDNotationFormatter::LLSDNotationFormatter()
+{
+}
+
+// virtual
+LLSDNotationFormatter::~LLSDNotationFormatter()
+{ }
+
+// static
+std::string LLSDNotationFormatter::escapeString(const std::string& in)
+{
+	std::ostringstream ostr;
+	serialize_string(in, ostr);
+	return ostr.str();
+}
+
+// virtual
+S32 LLSDNotationFormatter::format(const LLSD& data, std::ostream& ostr, U32 options) const
+{
+	S32 rv = format_impl(data, ostr, options, 0);
+	return rv;
+}
+
+S32 LLSDNotationFormatter::format_impl(const LLSD& data, std::ostream& ostr, U32 options, U32 level) const
+{
+	S32 format_count = 1;
+	std::string pre;
+	std::string post;
+
+	if (options & LLSDFormatter::OPTIONS_PRETTY)
+	{
+		for (U32 i = 0; i < level; i++)
+		{
+			pre += "    ";
+		}
+		post = "\n";
+	}
+
+	switch(data.type())
+	{
+	case LLSD::TypeMap:
+	{
+		if (0 != level) ostr << post << pre;
+		ostr << "{";
+		std::string inner_pre;
+		if (options & LLSDFormatter::OPTIONS_PRETTY)
+		{
+			inner_pre = pre + "    ";
+		}
+
+		bool need_comma = false;
+		LLSD::map_const_iterator iter = data.beginMap();
+		LLSD::map_const_iterator end = data.endMap();
+		for(; iter != end; ++iter)
+		{
+			if(need_comma) ostr << ",";
+			need_comma = true;
+			ostr << post << inner_pre << '\'';
+			serialize_string((*iter).first, ostr);
+			ostr << "':";
+			format_count += format_impl((*iter).second, ostr, options, level + 2);
+		}
+		ostr << post << pre << "}";
+		break;
+	}
+
+	case LLSD::TypeArray:
+	{
+		ostr << post << pre << "[";
+		bool need_comma = false;
+		LLSD::array_const_iterator iter = data.beginArray();
+		LLSD::array_const_iterator end = data.endArray();
+		for(; iter != end; ++iter)
+		{
+			if(need_comma) ostr << ",";
+			need_comma = true;
+			format_count += format_impl(*iter, ostr, options, level + 1);
+		}
+		ostr << "]";
+		break;
+	}
+
+	case LLSD::TypeUndefined:
+		ostr << "!";
+		break;
+
+	case LLSD::TypeBoolean:
+		if(mBoolAlpha ||
+#if( LL_WINDOWS || __GNUC__ > 2)
+		   (ostr.flags() & std::ios::boolalpha)
+#else
+		   (ostr.flags() & 0x0100)
+#endif
+			)
+		{
+			ostr << (data.asBoolean()
+					 ? NOTATION_TRUE_SERIAL : NOTATION_FALSE_SERIAL);
+		}
+		else
+		{
+			ostr << (data.asBoolean() ? 1 : 0);
+		}
+		break;
+
+	case LLSD::TypeInteger:
+		ostr << "i" << data.asInteger();
+		break;
+
+	case LLSD::TypeReal:
+		ostr << "r";
+		if(mRealFormat.empty())
+		{
+			ostr << data.asReal();
+		}
+		else
+		{
+			formatReal(data.asReal(), ostr);
+		}
+		break;
+
+	case LLSD::TypeUUID:
+		ostr << "u" << data.asUUID();
+		break;
+
+	case LLSD::TypeString:
 		ostr << '\'';
 		serialize_string(data.asStringRef(), ostr);
 		ostr << '\'';
@@ -2042,15 +3122,12 @@ std::ostream& operator<<(std::ostream& s, const LLSD& llsd)
 //dirty little zippers -- yell at davep if these are horrid
 
 //return a string containing gzipped bytes of binary serialized LLSD
-// VERY inefficient -- creates several copies of LLSD block in memory
 std::string zip_llsd(LLSD& data)
 { 
-	std::stringstream llsd_strm;
+	std::ostringstream llsd_strm;
 
 	LLSDSerialize::toBinary(data, llsd_strm);
 
-	const U32 CHUNK = 65536;
-
 	z_stream strm;
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
@@ -2065,50 +3142,22 @@ std::string zip_llsd(LLSD& data)
 
 	std::string source = llsd_strm.str();
 
-	U8 out[CHUNK];
+	// deflateBound() is enough to deflate it all in one go
+	std::string result(deflateBound(&strm, source.size()), '\0');
 
 	strm.avail_in = source.size();
 	strm.next_in = (U8*) source.data();
-	U8* output = NULL;
-
-	U32 cur_size = 0;
+	strm.avail_out = result.size();
+	strm.next_out = (U8*) &result[0];
 
-	U32 have = 0;
-
-	do
+	ret = deflate(&strm, Z_FINISH);
+	deflateEnd(&strm);
+	if (ret != Z_STREAM_END)
 	{
-		strm.avail_out = CHUNK;
-		strm.next_out = out;
-
-		ret = deflate(&strm, Z_FINISH);
-		if (ret == Z_OK || ret == Z_STREAM_END)
-		{ //copy result into output
-			if (strm.avail_out >= CHUNK)
-			{
-				free(output);
-				LL_WARNS() << "Failed to compress LLSD block." << LL_ENDL;
-				return std::string();
-			}
-
-			have = CHUNK-strm.avail_out;
-			output = (U8*) realloc(output, cur_size+have);
-			memcpy(output+cur_size, out, have);
-			cur_size += have;
-		}
-		else 
-		{
-			free(output);
-			LL_WARNS() << "Failed to compress LLSD block." << LL_ENDL;
-			return std::string();
-		}
+		LL_WARNS() << "Failed to compress LLSD block." << LL_ENDL;
+		return std::string();
 	}
-	while (ret == Z_OK);
-
-	std::string::size_type size = cur_size;
-
-	std::string result((char*) output, size);
-	deflateEnd(&strm);
-	free(output);
+	result.resize(strm.total_out);
 
 #if 0 //verify results work with unzip_llsd
 	std::istringstream test(result);
@@ -2123,112 +3172,122 @@ std::string zip_llsd(LLSD& data)
 }
 
 //decompress a block of LLSD from provided istream
-// not very efficient -- creats a copy of decompressed LLSD block in memory
-// and deserializes from that copy using LLSDSerialize
 bool unzip_llsd(LLSD& data, std::istream& is, S32 size)
 {
-	U8* result = NULL;
-	U32 cur_size = 0;
-	z_stream strm;
-		
-	const U32 CHUNK = 65536;
-
 	U8 *in = new U8[size];
 	is.read((char*) in, size); 
+	bool success = unzip_llsd(data, in, size);
+	delete [] in;
+	return success;
+}
 
-	U8 out[CHUNK];
-		
+bool unzip_llsd(LLSD& data, const U8* in, S32 size)
+{
+	std::vector<U8> buffer;
+	return unzip_llsd(data, in, size, buffer);
+}
+
+bool unzip_llsd(LLSD& data, const U8* in, S32 size, std::vector<U8>& buffer)
+{
+	size_t cur_size = 0;
+	if (!unzip_buffer(in, size, buffer, cur_size))
+	{
+		return false;
+	}
+	return parse_unzipped_llsd(data, cur_size ? &buffer[0] : NULL, cur_size);
+}
+
+bool parse_unzipped_llsd(LLSD& data, const U8* in, size_t size)
+{
+	static const char deprecated_header[] = "<? LLSD/Binary ?>";
+	const size_t header_size = sizeof(deprecated_header) - 1;
+
+	size_t offset = 0;
+	if (size >= header_size && !memcmp(in, deprecated_header, header_size))
+	{
+		offset = llmin(header_size + 1, size);
+	}
+
+	if (LLSDSerialize::fromBinary(data, in + offset, size - offset) <= 0)
+	{
+		LL_DEBUGS() << "Failed to unzip LLSD block" << LL_ENDL;
+		return false;
+	}
+
+	return true;
+}
+
+bool unzip_buffer(const U8* in, S32 size, std::vector<U8>& buffer, size_t& out_size)
+{
+	// minimum room to start with, and to leave for the next inflate() call
+	const size_t CHUNK = 65536;
+
+	out_size = 0;
+	if (buffer.size() < CHUNK)
+	{
+		buffer.resize(llmax(CHUNK, (size_t) llmax(size, 0) * 4));
+	}
+
+	z_stream strm;
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
 	strm.avail_in = size;
-	strm.next_in = in;
+	strm.next_in = const_cast<U8*>(in);
 
 	S32 ret = inflateInit(&strm);
-	
+	if (ret != Z_OK)
+	{
+		LL_DEBUGS() << "Unzip error: " << ret << LL_ENDL;
+		return false;
+	}
+
+	// Inflate straight into the buffer, a big output window keeps zlib on
+	// its fast path and there is nothing to copy afterwards.
 	do
 	{
-		strm.avail_out = CHUNK;
-		strm.next_out = out;
-		ret = inflate(&strm, Z_NO_FLUSH);
-		if (ret == Z_STREAM_ERROR)
+		if (buffer.size() - out_size < CHUNK)
 		{
-			LL_DEBUGS() << "Unzip error: Z_STREAM_ERROR" << LL_ENDL;	// <FS>
-			inflateEnd(&strm);
-			free(result);
-			delete [] in;
-			return false;
+			try
+			{
+				buffer.resize(buffer.size() * 2);
+			}
+			catch (std::bad_alloc&)
+			{
+				inflateEnd(&strm);
+				LL_WARNS() << "Unzip error: out of memory, needed " << buffer.size() * 2 << " bytes" << LL_ENDL;
+				return false;
+			}
 		}
-		
+
+		strm.avail_out = buffer.size() - out_size;
+		strm.next_out = &buffer[out_size];
+		ret = inflate(&strm, Z_NO_FLUSH);
+		out_size = buffer.size() - strm.avail_out;
+
 		switch (ret)
 		{
 		case Z_NEED_DICT:
-			ret = Z_DATA_ERROR;
 		case Z_DATA_ERROR:
 		case Z_MEM_ERROR:
-			LL_DEBUGS() << "Unzip error: " << ret << LL_ENDL;	// <FS>
+		case Z_STREAM_ERROR:
+			LL_DEBUGS() << "Unzip error: " << ret << LL_ENDL;
 			inflateEnd(&strm);
-			free(result);
-			delete [] in;
 			return false;
-			break;
-		}
-
-		U32 have = CHUNK-strm.avail_out;
-
-		// result = (U8*) realloc(result, cur_size + have);
-		U8 *pNew = (U8*) realloc(result, cur_size + have);
-		if( !pNew )
-		{
-			free( result );
-			LL_WARNS() << "Unzip error: out of memory, needed " << cur_size+have << " bytes" << LL_ENDL;
-			return  false;
 		}
-		
-		result = pNew;
-
-		// </FS:ND>
-
-		memcpy(result+cur_size, out, have);
-		cur_size += have;
-
-	} while (ret == Z_OK);
+	} while (ret == Z_OK && (strm.avail_in || !strm.avail_out));
 
 	inflateEnd(&strm);
-	delete [] in;
 
 	if (ret != Z_STREAM_END)
 	{
-		LL_DEBUGS() << "Unzip error: !Z_STREAM_END" << LL_ENDL;	// <FS>
-		free(result);
+		LL_DEBUGS() << "Unzip error: !Z_STREAM_END" << LL_ENDL;
 		return false;
 	}
 
-	//result now points to the decompressed LLSD block
-	{
-		std::string res_str((char*) result, cur_size);
-
-		std::string deprecated_header("<? LLSD/Binary ?>");
-
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
-		{
-			res_str = res_str.substr(deprecated_header.size()+1, cur_size);
-		}
-		cur_size = res_str.size();
-
-		std::istringstream istr(res_str);
-		
-		if (!LLSDSerialize::fromBinary(data, istr, cur_size))
-		{
-			LL_DEBUGS() << "Failed to unzip LLSD block" << LL_ENDL;
-			free(result);
-			return false;
-		}		
-	}
-
-	free(result);
 	return true;
 }
+
 //This unzip function will only work with a gzip header and trailer - while the contents
 //of the actual compressed data is the same for either format (gzip vs zlib ), the headers
 //and trailers are different for the formats.
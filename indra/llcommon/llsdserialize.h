@@ -34,6 +34,89 @@
 #include "llrefcount.h"
 #include "llsd.h"
 
+/** 
+ * @class LLSDVisitor
+ * @brief Receives structured data from a parser as it is read, without
+ * a tree being built for it.
+ *
+ * Maps and arrays are reported by begin and end calls around their
+ * contents, and every map value is preceded by key(). Returning false
+ * from beginMap(), beginArray() or key() skips that container or value:
+ * it is still read past, but nothing in it is reported, not even the
+ * matching end call. Keys and values passed in are only valid during
+ * the call. When a parse fails part way the calls made up to that point
+ * stand, and open containers are never ended.
+ */
+class LL_COMMON_API LLSDVisitor
+{
+public:
+	virtual ~LLSDVisitor();
+
+	virtual bool beginMap()							{ return true; }
+	virtual void endMap()							{ }
+	virtual bool key(const LLSD::String& key)		{ return true; }
+	virtual bool beginArray()						{ return true; }
+	virtual void endArray()							{ }
+
+	virtual void undefined()						{ }
+	virtual void boolean(LLSD::Boolean value)		{ }
+	virtual void integer(LLSD::Integer value)		{ }
+	virtual void real(LLSD::Real value)				{ }
+	virtual void string(const LLSD::String& value)	{ }
+	virtual void uuid(const LLSD::UUID& value)		{ }
+	virtual void date(const LLSD::Date& value)		{ }
+	virtual void uri(const LLSD::URI& value)		{ }
+	virtual void binary(const LLSD::Binary& value)	{ }
+
+	/** 
+	 * @brief Binary data parsed out of a buffer in memory.
+	 *
+	 * Only parses of a buffer call this, with a view into it that is
+	 * good for as long as the buffer is. The default copies it for
+	 * binary().
+	 */
+	virtual void binaryView(const U8* data, size_t size);
+
+	/** 
+	 * @brief Reports data that is already parsed the same way.
+	 */
+	void visit(const LLSD& data);
+};
+
+/** 
+ * @class LLSDBuilder
+ * @brief Visitor which builds the tree the visited data describes.
+ */
+class LL_COMMON_API LLSDBuilder : public LLSDVisitor
+{
+public:
+	LLSDBuilder(LLSD& result);
+
+	/*virtual*/ bool beginMap();
+	/*virtual*/ void endMap();
+	/*virtual*/ bool key(const LLSD::String& key);
+	/*virtual*/ bool beginArray();
+	/*virtual*/ void endArray();
+
+	/*virtual*/ void undefined();
+	/*virtual*/ void boolean(LLSD::Boolean value);
+	/*virtual*/ void integer(LLSD::Integer value);
+	/*virtual*/ void real(LLSD::Real value);
+	/*virtual*/ void string(const LLSD::String& value);
+	/*virtual*/ void uuid(const LLSD::UUID& value);
+	/*virtual*/ void date(const LLSD::Date& value);
+	/*virtual*/ void uri(const LLSD::URI& value);
+	/*virtual*/ void binary(const LLSD::Binary& value);
+
+private:
+	// where the next value goes
+	LLSD& next();
+
+	LLSD& mResult;
+	std::vector<LLSD*> mContainers;
+	LLSD::String mKey;
+};
+
 /** 
  * @class LLSDParser
  * @brief Abstract base class for LLSD parsers.
@@ -85,6 +168,20 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/** 
+	 * @brief Call this method to parse a stream into a visitor.
+	 *
+	 * Like parse(), but reports what it reads to the visitor instead
+	 * of building a tree from it.
+	 * @param istr The input stream.
+	 * @param visitor The visitor which receives the parsed data.
+	 * @param max_bytes The maximum number of bytes that will be in
+	 * the stream, or LLSDSerialize::SIZE_UNLIMITED.
+	 * @return Returns the number of LLSD objects parsed. Returns
+	 * PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 visit(std::istream& istr, LLSDVisitor& visitor, S32 max_bytes);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
@@ -108,6 +205,17 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const = 0;
 
+	/** 
+	 * @brief Virtual function for parsing into a visitor.
+	 *
+	 * The default builds the tree with doParse() and visits that.
+	 * @param istr The input stream.
+	 * @param visitor The visitor which receives the parsed data.
+	 * @return Returns the number of LLSD objects parsed. Returns
+	 * PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doVisit(std::istream& istr, LLSDVisitor& visitor) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -319,6 +427,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parses the stream into a visitor as it is read.
+	 */
+	virtual S32 doVisit(std::istream& istr, LLSDVisitor& visitor) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -367,6 +480,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parses the stream into a visitor as it is read.
+	 */
+	virtual S32 doVisit(std::istream& istr, LLSDVisitor& visitor) const;
+
 private:
 	/** 
 	 * @brief Parse a map from the istream
@@ -394,6 +512,33 @@ private:
 	 * @return Retuns true if a complete string was parsed.
 	 */
 	bool parseString(std::istream& istr, std::string& value) const;
+
+	/** 
+	 * @brief Read past a size prefixed string or binary.
+	 *
+	 * @param istr The input stream.
+	 * @return Retuns true if all of it was there.
+	 */
+	bool skipSized(std::istream& istr) const;
+
+	/** 
+	 * @brief Parse a value from the istream into a visitor.
+	 *
+	 * @param istr The input stream.
+	 * @param visitor The visitor to report to, or NULL to skip the value.
+	 * @return Returns The number of LLSD objects parsed.
+	 */
+	S32 visitValue(std::istream& istr, LLSDVisitor* visitor) const;
+
+	/** 
+	 * @brief Parse a map into a visitor, after its '{'.
+	 */
+	S32 visitMap(std::istream& istr, LLSDVisitor* visitor) const;
+
+	/** 
+	 * @brief Parse an array into a visitor, after its '['.
+	 */
+	S32 visitArray(std::istream& istr, LLSDVisitor* visitor) const;
 };
 
 
@@ -791,6 +936,11 @@ public:
 		return fromXMLEmbedded(sd, str, emit_errors);
 //		return fromXMLDocument(sd, str, emit_errors);
 	}
+	static S32 visitXML(LLSDVisitor& visitor, std::istream& str, bool emit_errors=true)
+	{
+		LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
+		return p->visit(str, visitor, LLSDSerialize::SIZE_UNLIMITED);
+	}
 
 	/*
 	 * Binary Methods
@@ -812,10 +962,36 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 visitBinary(LLSDVisitor& visitor, std::istream& str, S32 max_bytes)
+	{
+		LLPointer<LLSDBinaryParser> p = new LLSDBinaryParser;
+		return p->visit(str, visitor, max_bytes);
+	}
+
+	/**
+	 * @brief Parse binary LLSD straight out of a buffer in memory.
+	 *
+	 * Reads the same as the stream versions, with every read checked
+	 * against the end of the buffer and no stream in between.
+	 * @param used [out] If not NULL, how much of the buffer the parse
+	 * took up.
+	 * @return Returns the number of LLSD objects parsed. Returns
+	 * LLSDParser::PARSE_FAILURE (-1) on parse failure.
+	 */
+	static S32 fromBinary(LLSD& sd, const U8* data, size_t size, size_t* used = NULL);
+	static S32 visitBinary(LLSDVisitor& visitor, const U8* data, size_t size);
 };
 
 //dirty little zip functions -- yell at davep
 LL_COMMON_API std::string zip_llsd(LLSD& data);
 LL_COMMON_API bool unzip_llsd(LLSD& data, std::istream& is, S32 size);
+LL_COMMON_API bool unzip_llsd(LLSD& data, const U8* in, S32 size);
+// buffer holds the inflated block and may be reused across calls
+LL_COMMON_API bool unzip_llsd(LLSD& data, const U8* in, S32 size, std::vector<U8>& buffer);
+// inflates into buffer, which only ever grows; out_size is how much of it
+// was used
+LL_COMMON_API bool unzip_buffer(const U8* in, S32 size, std::vector<U8>& buffer, size_t& out_size);
+// the parse unzip_llsd() does on what unzip_buffer() gives
+LL_COMMON_API bool parse_unzipped_llsd(LLSD& data, const U8* in, size_t size);
 LL_COMMON_API U8* unzip_llsdNavMesh( bool& valid, unsigned int& outsize,std::istream& is, S32 size);
 #endif // LL_LLSDSERIALIZE_H
@@ -265,6 +265,7 @@ public:
 	
 	S32 parse(std::istream& input, LLSD& data);
 	S32 parseLines(std::istream& input, LLSD& data);
+	S32 visit(std::istream& input, LLSDVisitor& visitor, bool parse_lines);
 
 	void parsePart(const char *buf, int len);
 	
@@ -274,6 +275,9 @@ private:
 	void startElementHandler(const XML_Char* name, const XML_Char** attributes);
 	void endElementHandler(const XML_Char* name);
 	void characterDataHandler(const XML_Char* data, int length);
+
+	void visitStartElement(const XML_Char** attributes);
+	void visitEndElement();
 	
 	static void sStartElementHandler(
 		void* userData, const XML_Char* name, const XML_Char** attributes);
@@ -303,9 +307,15 @@ private:
 	static Element readElement(const XML_Char* name);
 	
 	static const XML_Char* findAttribute(const XML_Char* name, const XML_Char** pairs);
+
+	static S32 decodeInteger(const std::string& content);
+	static void decodeBinary(const std::string& content, std::vector<U8>& data);
 	
 	bool mEmitErrors;
 
+	// when set, values go to it instead of into mResult
+	LLSDVisitor* mVisitor;
+
 	XML_Parser	mParser;
 
 	LLSD mResult;
@@ -328,7 +338,8 @@ private:
 
 
 LLSDXMLParser::Impl::Impl(bool emit_errors)
-	: mEmitErrors(emit_errors)
+	: mEmitErrors(emit_errors),
+	  mVisitor(NULL)
 {
 	mParser = XML_ParserCreate(NULL);
 	reset();
@@ -506,6 +517,16 @@ S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
 }
 
 
+S32 LLSDXMLParser::Impl::visit(std::istream& input, LLSDVisitor& visitor, bool parse_lines)
+{
+	LLSD unused;
+	mVisitor = &visitor;
+	S32 parse_count = parse_lines ? parseLines(input, unused) : parse(input, unused);
+	mVisitor = NULL;
+	return parse_count;
+}
+
+
 void LLSDXMLParser::Impl::reset()
 {
 	mResult.clear();
@@ -609,6 +630,11 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	mStackElements.push( element );
 	mCurrentContent.clear();
 
+	if (mVisitor)
+	{
+		return visitStartElement(attributes);
+	}
+
 	switch (element)
 	{
 		case ELEMENT_LLSD:
@@ -717,6 +743,11 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	
 	// <FS:ND>: we've saved the element we need in a stack, so we can avoid readElement()
 	// Element element = readElement(name);
+	if (mVisitor)
+	{
+		return visitEndElement();
+	}
+
 	Element element = mStackElements.top(); //readElement(name);
 	mStackElements.pop();
 	// </FS:ND>
@@ -757,18 +788,7 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			break;
 		
 		case ELEMENT_INTEGER:
-			{
-				S32 i;
-				// sscanf okay here with different locales - ints don't change for different locale settings like floats do.
-				if ( sscanf(mCurrentContent.c_str(), "%d", &i ) == 1 )
-				{	// See if sscanf works - it's faster
-					value = i;
-				}
-				else
-				{
-					value = LLSD(mCurrentContent).asInteger();
-				}
-			}
+			value = decodeInteger(mCurrentContent);
 			break;
 		
 		case ELEMENT_REAL:
@@ -807,18 +827,8 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 		
 		case ELEMENT_BINARY:
 		{
-			// Regex is expensive, but only fix for whitespace in base64,
-			// created by python and other non-linden systems - DEV-39358
-			// Fortunately we have very little binary passing now,
-			// so performance impact shold be negligible. + poppy 2009-09-04
-			boost::regex r;
-			r.assign("\\s");
-			std::string stripped = boost::regex_replace(mCurrentContent, r, "");
-			S32 len = apr_base64_decode_len(stripped.c_str());
 			std::vector<U8> data;
-			data.resize(len);
-			len = apr_base64_decode_binary(&data[0], stripped.c_str());
-			data.resize(len);
+			decodeBinary(mCurrentContent, data);
 			value = data;
 			break;
 		}
@@ -841,9 +851,187 @@ void LLSDXMLParser::Impl::characterDataHandler(const XML_Char* data, int length)
 	XML_Timer timer( &charDataTime );
 	#endif	// XML_PARSER_PERFORMANCE_TESTS
 
+	if (mSkipping && mVisitor)
+	{
+		// nothing in a skipped element is reported
+		return;
+	}
 	mCurrentContent.append(data, length);
 }
 
+// Takes the same elements as startElementHandler(), with the open
+// containers kept in mStackElements alone.  A value the visitor does not
+// want is skipped like a malformed one.
+void LLSDXMLParser::Impl::visitStartElement(const XML_Char** attributes)
+{
+	Element element = mStackElements.top();
+	mStackElements.pop();
+	Element parent = mStackElements.empty() ? ELEMENT_UNKNOWN : mStackElements.top();
+
+	switch (element)
+	{
+		case ELEMENT_LLSD:
+			if (mInLLSDElement)
+			{
+				return startSkipping();
+			}
+			mInLLSDElement = true;
+			mStackElements.push(element);
+			return;
+
+		case ELEMENT_KEY:
+			if (parent != ELEMENT_MAP)
+			{
+				return startSkipping();
+			}
+			mStackElements.push(element);
+			return;
+
+		case ELEMENT_BINARY:
+		{
+			const XML_Char* encoding = findAttribute("encoding", attributes);
+			if(encoding && strcmp("base64", encoding) != 0)
+			{
+				return startSkipping();
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	if (!mInLLSDElement)
+	{
+		return startSkipping();
+	}
+
+	if (parent == ELEMENT_MAP)
+	{
+		if (mCurrentKey.empty())
+		{
+			return startSkipping();
+		}
+		bool wanted = mVisitor->key(mCurrentKey);
+		mCurrentKey.clear();
+		if (!wanted)
+		{
+			++mParseCount;
+			return startSkipping();
+		}
+	}
+	else if (parent != ELEMENT_ARRAY && parent != ELEMENT_LLSD)
+	{
+		// improperly nested value in a non-structure
+		return startSkipping();
+	}
+
+	++mParseCount;
+	if ((element == ELEMENT_MAP && !mVisitor->beginMap())
+		|| (element == ELEMENT_ARRAY && !mVisitor->beginArray()))
+	{
+		return startSkipping();
+	}
+	mStackElements.push(element);
+}
+
+void LLSDXMLParser::Impl::visitEndElement()
+{
+	Element element = mStackElements.top();
+	mStackElements.pop();
+
+	switch (element)
+	{
+		case ELEMENT_LLSD:
+			mInLLSDElement = false;
+			mGracefullStop = true;
+			XML_StopParser(mParser, false);
+			return;
+
+		case ELEMENT_KEY:
+			mCurrentKey = mCurrentContent;
+			return;
+
+		case ELEMENT_MAP:
+			mVisitor->endMap();
+			break;
+
+		case ELEMENT_ARRAY:
+			mVisitor->endArray();
+			break;
+
+		case ELEMENT_BOOL:
+			mVisitor->boolean(mCurrentContent == "true" || mCurrentContent == "1");
+			break;
+
+		case ELEMENT_INTEGER:
+			mVisitor->integer(decodeInteger(mCurrentContent));
+			break;
+
+		case ELEMENT_REAL:
+			mVisitor->real(LLSD(mCurrentContent).asReal());
+			break;
+
+		case ELEMENT_STRING:
+			mVisitor->string(mCurrentContent);
+			break;
+
+		case ELEMENT_UUID:
+			mVisitor->uuid(LLUUID(mCurrentContent));
+			break;
+
+		case ELEMENT_DATE:
+			mVisitor->date(LLDate(mCurrentContent));
+			break;
+
+		case ELEMENT_URI:
+			mVisitor->uri(LLURI(mCurrentContent));
+			break;
+
+		case ELEMENT_BINARY:
+		{
+			std::vector<U8> data;
+			decodeBinary(mCurrentContent, data);
+			mVisitor->binary(data);
+			break;
+		}
+
+		default:
+			mVisitor->undefined();
+			break;
+	}
+
+	mCurrentContent.clear();
+}
+
+// static
+S32 LLSDXMLParser::Impl::decodeInteger(const std::string& content)
+{
+	S32 i;
+	// sscanf okay here with different locales - ints don't change for different locale settings like floats do.
+	if ( sscanf(content.c_str(), "%d", &i ) == 1 )
+	{	// See if sscanf works - it's faster
+		return i;
+	}
+	return LLSD(content).asInteger();
+}
+
+// static
+void LLSDXMLParser::Impl::decodeBinary(const std::string& content, std::vector<U8>& data)
+{
+	// Regex is expensive, but only fix for whitespace in base64,
+	// created by python and other non-linden systems - DEV-39358
+	// Fortunately we have very little binary passing now,
+	// so performance impact shold be negligible. + poppy 2009-09-04
+	boost::regex r;
+	r.assign("\\s");
+	std::string stripped = boost::regex_replace(content, r, "");
+	S32 len = apr_base64_decode_len(stripped.c_str());
+	data.resize(len);
+	len = apr_base64_decode_binary(&data[0], stripped.c_str());
+	data.resize(len);
+}
+
 
 void LLSDXMLParser::Impl::sStartElementHandler(
 	void* userData, const XML_Char* name, const XML_Char** attributes)
@@ -967,6 +1155,12 @@ S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 	return impl.parse(input, data);
 }
 
+// virtual
+S32 LLSDXMLParser::doVisit(std::istream& input, LLSDVisitor& visitor) const
+{
+	return impl.visit(input, visitor, mParseLines);
+}
+
 //	virtual 
 void LLSDXMLParser::doReset()
 {
@@ -395,7 +395,7 @@ private:
 };
 
 /// MapEntry is what you get from dereferencing an LLSD::map_[const_]iterator.
-typedef std::map<LLSD::String, LLSD>::value_type MapEntry;
+typedef LLSD::MapEntry MapEntry;
 
 /// Usage: BOOST_FOREACH([const] MapEntry& e, inMap(someLLSDmap)) { ... }
 class inMap
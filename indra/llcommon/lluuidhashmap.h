@@ -0,0 +1,289 @@
+/**
+ * @file lluuidhashmap.h
+ * @brief LLUUIDHashMap class, an open addressed map keyed by LLUUID.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLUUIDHASHMAP_H
+#define LL_LLUUIDHASHMAP_H
+
+#include <utility>
+#include <vector>
+
+#include "lluuid.h"
+
+// A map from LLUUID to T in one flat table, probed linearly from the
+// slot the id hashes to.  It stands in for std::map<LLUUID, T> where
+// there are a lot of ids and nobody needs them in order: lookups touch
+// one or two cache lines instead of walking a tree, and there is no
+// allocation per entry.
+//
+// Unlike std::map, inserting may move every entry and erasing may move
+// the ones after it, so iterators and references into the map only last
+// until the next insert or erase.  Keep pointers as the values where
+// something must outlive that.  Iteration order is the table's: it isn't
+// sorted, and the same ids can come out in a different order depending on
+// what was inserted and erased before.
+template <class T>
+class LLUUIDHashMap
+{
+public:
+	typedef LLUUID key_type;
+	typedef T mapped_type;
+	typedef std::pair<LLUUID, T> value_type;
+	typedef size_t size_type;
+
+	template <class MAP, class VALUE>
+	class iterator_base
+	{
+	public:
+		iterator_base() : mMap(NULL), mIndex(0) {}
+		iterator_base(MAP* map, U32 index) : mMap(map), mIndex(index) {}
+		// iterator to const_iterator
+		template <class OTHER_MAP, class OTHER_VALUE>
+		iterator_base(const iterator_base<OTHER_MAP, OTHER_VALUE>& other)
+		:	mMap(other.mMap), mIndex(other.mIndex)
+		{
+		}
+
+		VALUE& operator*() const					{ return mMap->mSlots[mIndex]; }
+		VALUE* operator->() const					{ return &mMap->mSlots[mIndex]; }
+
+		iterator_base& operator++()
+		{
+			mIndex = mMap->nextUsed(mIndex + 1);
+			return *this;
+		}
+		iterator_base operator++(int)
+		{
+			iterator_base result(*this);
+			++*this;
+			return result;
+		}
+
+		template <class OTHER_MAP, class OTHER_VALUE>
+		bool operator==(const iterator_base<OTHER_MAP, OTHER_VALUE>& other) const
+		{
+			return mIndex == other.mIndex;
+		}
+		template <class OTHER_MAP, class OTHER_VALUE>
+		bool operator!=(const iterator_base<OTHER_MAP, OTHER_VALUE>& other) const
+		{
+			return mIndex != other.mIndex;
+		}
+
+	private:
+		template <class OTHER_MAP, class OTHER_VALUE> friend class iterator_base;
+		MAP* mMap;
+		U32 mIndex;
+	};
+	typedef iterator_base<LLUUIDHashMap, value_type> iterator;
+	typedef iterator_base<const LLUUIDHashMap, const value_type> const_iterator;
+
+	LLUUIDHashMap()
+	:	mSize(0),
+		mMask(0)
+	{
+	}
+
+	size_type size() const							{ return mSize; }
+	bool empty() const								{ return mSize == 0; }
+
+	iterator begin()								{ return iterator(this, nextUsed(0)); }
+	iterator end()									{ return iterator(this, capacity()); }
+	const_iterator begin() const					{ return const_iterator(this, nextUsed(0)); }
+	const_iterator end() const						{ return const_iterator(this, capacity()); }
+
+	iterator find(const LLUUID& id)					{ return iterator(this, findSlot(id)); }
+	const_iterator find(const LLUUID& id) const		{ return const_iterator(this, findSlot(id)); }
+	size_type count(const LLUUID& id) const			{ return findSlot(id) != capacity() ? 1 : 0; }
+
+	T& operator[](const LLUUID& id)
+	{
+		return insert(value_type(id, T())).first->second;
+	}
+
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		U32 index = findSlot(value.first);
+		if (index != capacity())
+		{
+			return std::make_pair(iterator(this, index), false);
+		}
+		if ((mSize + 1) * 4 > capacity() * 3)
+		{
+			rehash(capacity() ? capacity() * 2 : MIN_CAPACITY);
+		}
+		index = homeSlot(value.first);
+		while (mUsed[index])
+		{
+			index = (index + 1) & mMask;
+		}
+		mSlots[index] = value;
+		mUsed[index] = 1;
+		++mSize;
+		return std::make_pair(iterator(this, index), true);
+	}
+
+	size_type erase(const LLUUID& id)
+	{
+		U32 hole = findSlot(id);
+		if (hole == capacity())
+		{
+			return 0;
+		}
+		// Shift back the entries after the hole that probed past it, so
+		// lookups never need tombstones.
+		for (U32 index = (hole + 1) & mMask; mUsed[index]; index = (index + 1) & mMask)
+		{
+			U32 home = homeSlot(mSlots[index].first);
+			bool stays = (hole <= index) ? (hole < home && home <= index)
+										 : (hole < home || home <= index);
+			if (!stays)
+			{
+				mSlots[hole] = mSlots[index];
+				hole = index;
+			}
+		}
+		mSlots[hole] = value_type();
+		mUsed[hole] = 0;
+		--mSize;
+		return 1;
+	}
+
+	void clear()
+	{
+		std::vector<value_type>().swap(mSlots);
+		std::vector<U8>().swap(mUsed);
+		mSize = 0;
+		mMask = 0;
+	}
+
+	// makes room for count entries without growing again
+	void reserve(size_type count)
+	{
+		U32 wanted = MIN_CAPACITY;
+		while (count * 4 > wanted * 3)
+		{
+			wanted *= 2;
+		}
+		if (wanted > capacity())
+		{
+			rehash(wanted);
+		}
+	}
+
+	void swap(LLUUIDHashMap& other)
+	{
+		mSlots.swap(other.mSlots);
+		mUsed.swap(other.mUsed);
+		std::swap(mSize, other.mSize);
+		std::swap(mMask, other.mMask);
+	}
+
+private:
+	static const U32 MIN_CAPACITY = 16;
+
+	U32 capacity() const							{ return mUsed.size(); }
+
+	// Ids are mostly random already, the multiply takes care of the ones
+	// that aren't.
+	U32 homeSlot(const LLUUID& id) const
+	{
+		U64 low;
+		U64 high;
+		memcpy(&low, id.mData, sizeof(low));
+		memcpy(&high, id.mData + sizeof(low), sizeof(high));
+		return (U32) (((low ^ high) * 0x9e3779b97f4a7c15ULL) >> 32) & mMask;
+	}
+
+	// the slot holding id, capacity() if none does
+	U32 findSlot(const LLUUID& id) const
+	{
+		if (!mSize)
+		{
+			return capacity();
+		}
+		for (U32 index = homeSlot(id); mUsed[index]; index = (index + 1) & mMask)
+		{
+			if (mSlots[index].first == id)
+			{
+				return index;
+			}
+		}
+		return capacity();
+	}
+
+	U32 nextUsed(U32 index) const
+	{
+		const U32 end = capacity();
+		while (index < end && !mUsed[index])
+		{
+			++index;
+		}
+		return index;
+	}
+
+	void rehash(U32 new_capacity)
+	{
+		std::vector<value_type> slots(new_capacity);
+		std::vector<U8> used(new_capacity, 0);
+		mSlots.swap(slots);
+		mUsed.swap(used);
+		mMask = new_capacity - 1;
+		for (U32 i = 0; i < used.size(); ++i)
+		{
+			if (used[i])
+			{
+				U32 index = homeSlot(slots[i].first);
+				while (mUsed[index])
+				{
+					index = (index + 1) & mMask;
+				}
+				mSlots[index] = slots[i];
+				mUsed[index] = 1;
+			}
+		}
+	}
+
+	std::vector<value_type> mSlots;
+	std::vector<U8> mUsed;
+	U32 mSize;
+	U32 mMask;
+};
+
+// the llstl.h helpers, for LLUUIDHashMap
+template <typename T>
+inline T* get_ptr_in_map(const LLUUIDHashMap<T*>& inmap, const LLUUID& key)
+{
+	typename LLUUIDHashMap<T*>::const_iterator iter = inmap.find(key);
+	return (iter == inmap.end()) ? NULL : iter->second;
+}
+
+template <typename T>
+inline bool is_in_map(const LLUUIDHashMap<T>& inmap, const LLUUID& key)
+{
+	return inmap.find(key) != inmap.end();
+}
+
+#endif // LL_LLUUIDHASHMAP_H
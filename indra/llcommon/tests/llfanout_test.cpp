@@ -0,0 +1,140 @@
+/**
+ * @file llfanout_test.cpp
+ * @brief LLFanOut tests.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llfanout.h"
+#include "../llthread.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	struct Batch
+	{
+		std::vector<S32>	mCalls;
+		std::vector<S32>	mValues;
+		LLAtomicS32			mOffCaller;
+		boost::thread::id	mCaller;
+	};
+
+	void count_call(void* context, S32 index)
+	{
+		Batch* batch = (Batch*)context;
+		batch->mCalls[index]++;
+		batch->mValues[index] = index * 3 + 1;
+		if (LLThread::currentID() != batch->mCaller)
+		{
+			batch->mOffCaller++;
+		}
+	}
+
+	bool every_index_once(const Batch& batch)
+	{
+		for (U32 i = 0; i < batch.mCalls.size(); ++i)
+		{
+			if (batch.mCalls[i] != 1 || batch.mValues[i] != (S32) i * 3 + 1)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void start_batch(Batch& batch, S32 count)
+	{
+		batch.mCalls.assign(count, 0);
+		batch.mValues.assign(count, 0);
+		batch.mOffCaller = 0;
+		batch.mCaller = LLThread::currentID();
+	}
+}
+
+namespace tut
+{
+	struct fanout_test
+	{
+	};
+	typedef test_group<fanout_test> fanout_t;
+	typedef fanout_t::object fanout_object_t;
+	tut::fanout_t tut_fanout("LLFanOut");
+
+	// no threads, and small batches, run on the caller
+	template<> template<>
+	void fanout_object_t::test<1>()
+	{
+		Batch batch;
+		{
+			LLFanOut fan_out("test", 0);
+			ensure_equals("threads", fan_out.getThreadCount(), 0U);
+			start_batch(batch, 100);
+			fan_out.run(100, count_call, &batch);
+			ensure("every index once", every_index_once(batch));
+			ensure_equals("on the caller", (S32) batch.mOffCaller, 0);
+		}
+
+		LLFanOut fan_out("test", 3);
+		start_batch(batch, 7);
+		fan_out.run(7, count_call, &batch, 8);
+		ensure("small batch", every_index_once(batch));
+		ensure_equals("small batch on the caller", (S32) batch.mOffCaller, 0);
+
+		fan_out.run(0, count_call, &batch);
+	}
+
+	// Batches one after another each see every index exactly once, and
+	// everything written is there when run() returns.
+	template<> template<>
+	void fanout_object_t::test<2>()
+	{
+		LLFanOut fan_out("test", 3);
+		ensure_equals("threads", fan_out.getThreadCount(), 3U);
+		for (S32 round = 0; round < 200; ++round)
+		{
+			Batch batch;
+			S32 count = 2 + (round * 37) % 5000;
+			start_batch(batch, count);
+			fan_out.run(count, count_call, &batch);
+			ensure("every index once", every_index_once(batch));
+		}
+	}
+
+	// shutting down idle workers, and right after a batch
+	template<> template<>
+	void fanout_object_t::test<3>()
+	{
+		{
+			LLFanOut fan_out("test", 4);
+		}
+		Batch batch;
+		{
+			LLFanOut fan_out("test", 4);
+			start_batch(batch, 10000);
+			fan_out.run(10000, count_call, &batch);
+		}
+		ensure("finished before shutdown", every_index_once(batch));
+	}
+}
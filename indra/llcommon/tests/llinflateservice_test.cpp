@@ -0,0 +1,303 @@
+/**
+ * @file llinflateservice_test.cpp
+ * @brief Tests for LLInflateService and the buffer reusing unzip_llsd().
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinflateservice.h"
+#include "../llsdserialize.h"
+#include "llformat.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// LOD-like block: a few faces of vertex data that compresses somewhat
+	LLSD make_lod(S32 seed, S32 faces, S32 vertices)
+	{
+		LLSD lod = LLSD::emptyArray();
+		for (S32 f = 0; f < faces; ++f)
+		{
+			LLSD::Binary positions(vertices * 6);
+			for (S32 i = 0; i < (S32) positions.size(); ++i)
+			{
+				positions[i] = (U8) ((i * 7 + seed + f) % 61);
+			}
+			LLSD face;
+			face["Position"] = positions;
+			face["TriangleList"] = LLSD::Binary(vertices * 6, (U8) (seed + f));
+			face["PositionDomain"]["Min"].append(-0.5);
+			face["PositionDomain"]["Max"].append(0.5);
+			lod.append(face);
+		}
+		return lod;
+	}
+
+	// records what it was handed, the way LLMeshLODJob hands on its volume
+	class RecordingJob : public LLInflateService::LLSDJob
+	{
+	public:
+		RecordingJob(const std::string& zipped, LLSD* result, bool* success, LLAtomicS32* finished)
+		:	LLInflateService::LLSDJob((const U8*) zipped.data(), zipped.size()),
+			mResult(result),
+			mSuccess(success),
+			mFinished(finished)
+		{
+		}
+
+		/*virtual*/ void finished(bool success)
+		{
+			*mResult = mData;
+			mData.clear();
+			*mSuccess = success;
+			(*mFinished)++;
+		}
+
+	private:
+		LLSD* mResult;
+		bool* mSuccess;
+		LLAtomicS32* mFinished;
+	};
+
+	// counts the inflated bytes and nothing else
+	class SizeJob : public LLInflateService::Job
+	{
+	public:
+		SizeJob(const std::string& zipped, LLAtomicS32* bytes)
+		:	LLInflateService::Job((const U8*) zipped.data(), zipped.size()),
+			mBytes(bytes)
+		{
+		}
+
+		/*virtual*/ bool inflated(U8* data, size_t size)
+		{
+			(*mBytes) += (S32) size;
+			return true;
+		}
+
+	private:
+		LLAtomicS32* mBytes;
+	};
+
+	void wait_for(LLAtomicS32& finished, S32 count)
+	{
+		LLTimer timer;
+		while (finished < count && timer.getElapsedTimeF32() < 30.f)
+		{
+			ms_sleep(1);
+		}
+	}
+}
+
+namespace tut
+{
+	struct llinflateservice_test
+	{
+		std::string toBinary(const LLSD& sd)
+		{
+			std::ostringstream ostr;
+			LLSDSerialize::toBinary(sd, ostr);
+			return ostr.str();
+		}
+
+		void ensure_same(const std::string& msg, const LLSD& actual, const LLSD& expected)
+		{
+			ensure_equals(msg, toBinary(actual), toBinary(expected));
+		}
+	};
+	typedef test_group<llinflateservice_test> llinflateservice_test_t;
+	typedef llinflateservice_test_t::object llinflateservice_test_object_t;
+	tut::llinflateservice_test_t tut_llinflateservice_test("LLInflateService");
+
+	// a reused buffer inflates the same as a fresh one, through blocks
+	// larger and smaller than what it already holds
+	template<> template<>
+	void llinflateservice_test_object_t::test<1>()
+	{
+		std::vector<U8> buffer;
+		const S32 sizes[] = { 10, 20000, 3, 70000, 500 };
+		for (S32 i = 0; i < 5; ++i)
+		{
+			LLSD lod = make_lod(i, 2, sizes[i]);
+			std::string zipped = zip_llsd(lod);
+			LLSD unzipped;
+			ensure(llformat("unzipped %d", i), unzip_llsd(unzipped, (const U8*) zipped.data(), zipped.size(), buffer));
+			ensure_same(llformat("contents %d", i), unzipped, lod);
+		}
+		size_t capacity = buffer.size();
+
+		LLSD small = make_lod(0, 1, 100);
+		std::string zipped = zip_llsd(small);
+		LLSD unzipped;
+		ensure("reused", unzip_llsd(unzipped, (const U8*) zipped.data(), zipped.size(), buffer));
+		ensure_equals("not regrown", buffer.size(), capacity);
+
+		// truncated and corrupt blocks fail
+		std::string broken = zipped.substr(0, zipped.size() - 5);
+		ensure("truncated", !unzip_llsd(unzipped, (const U8*) broken.data(), broken.size(), buffer));
+		broken = zipped;
+		broken[broken.size() / 2] ^= 0x55;
+		ensure("corrupt", !unzip_llsd(unzipped, (const U8*) broken.data(), broken.size(), buffer));
+	}
+
+	// without threads jobs run before post() returns
+	template<> template<>
+	void llinflateservice_test_object_t::test<2>()
+	{
+		LLInflateService service;
+		ensure("not threaded", !service.isThreaded());
+
+		LLSD lod = make_lod(1, 3, 1000);
+		LLSD result;
+		bool success = false;
+		LLAtomicS32 finished(0);
+		service.post(new RecordingJob(zip_llsd(lod), &result, &success, &finished));
+		ensure_equals("finished inline", (S32) finished, 1);
+		ensure("succeeded", success);
+		ensure_same("parsed", result, lod);
+
+		service.post(new RecordingJob(std::string("not zipped"), &result, &success, &finished));
+		ensure_equals("failure finished inline", (S32) finished, 2);
+		ensure("failed", !success);
+		ensure_equals("counted", service.getJobsDone(), (U32) 1);
+		ensure_equals("failures counted", service.getJobsFailed(), (U32) 1);
+	}
+
+	// jobs spread over the threads all come back right
+	template<> template<>
+	void llinflateservice_test_object_t::test<3>()
+	{
+		LLInflateService service;
+		service.startThreads(4);
+		ensure_equals("threads", service.getThreadCount(), (U32) 4);
+
+		const S32 JOBS = 200;
+		std::vector<LLSD> expected(JOBS);
+		std::vector<LLSD> results(JOBS);
+		bool success[JOBS];
+		LLAtomicS32 finished(0);
+		for (S32 i = 0; i < JOBS; ++i)
+		{
+			expected[i] = make_lod(i, 1 + i % 4, 100 + (i * 131) % 5000);
+			success[i] = false;
+			std::string zipped = i % 50 == 49 ? std::string("garbage") : zip_llsd(expected[i]);
+			service.post(new RecordingJob(zipped, &results[i], &success[i], &finished));
+		}
+		wait_for(finished, JOBS);
+		ensure_equals("all finished", (S32) finished, JOBS);
+
+		for (S32 i = 0; i < JOBS; ++i)
+		{
+			if (i % 50 == 49)
+			{
+				ensure(llformat("job %d failed", i), !success[i]);
+			}
+			else
+			{
+				ensure(llformat("job %d succeeded", i), success[i]);
+				ensure_same(llformat("job %d parsed", i), results[i], expected[i]);
+			}
+		}
+		// the counts go up after the jobs finish
+		service.stopThreads();
+		ensure("stopped", !service.isThreaded());
+		ensure_equals("done", service.getJobsDone(), (U32) (JOBS - 4));
+		ensure_equals("failed", service.getJobsFailed(), (U32) 4);
+	}
+
+	// a burst of LOD sized blocks inflated on the calling thread and on the
+	// pool
+	template<> template<>
+	void llinflateservice_test_object_t::test<4>()
+	{
+		const S32 JOBS = 64;
+		std::vector<std::string> zipped;
+		S32 total = 0;
+		for (S32 i = 0; i < JOBS; ++i)
+		{
+			LLSD lod = make_lod(i, 4, 20000);
+			total += toBinary(lod).size();
+			zipped.push_back(zip_llsd(lod));
+		}
+
+		const U32 thread_counts[] = { 0, 1, 2, 4 };
+		for (S32 t = 0; t < 4; ++t)
+		{
+			LLInflateService service;
+			service.startThreads(thread_counts[t]);
+
+			LLAtomicS32 bytes(0);
+			LLTimer timer;
+			for (S32 i = 0; i < JOBS; ++i)
+			{
+				service.post(new SizeJob(zipped[i], &bytes));
+			}
+			LLTimer wait;
+			while (service.getJobsDone() + service.getJobsFailed() < (U32) JOBS && wait.getElapsedTimeF32() < 30.f)
+			{
+				ms_sleep(0);
+			}
+			F32 elapsed = timer.getElapsedTimeF32();
+
+			ensure_equals(llformat("all done with %d threads", thread_counts[t]), service.getJobsDone(), (U32) JOBS);
+			ensure_equals("all inflated", (S32) bytes, total);
+			LL_INFOS() << JOBS << " LOD blocks, " << total / 1024 << " KB, inflated on "
+				<< thread_counts[t] << " threads in " << elapsed * 1000.f << " ms" << LL_ENDL;
+		}
+	}
+
+	// an oversized block doesn't leave its buffer behind, smaller ones
+	// keep reusing theirs
+	template<> template<>
+	void llinflateservice_test_object_t::test<5>()
+	{
+		LLInflateService service;
+		std::vector<U8> buffer;
+		LLSD result;
+		bool success = false;
+		LLAtomicS32 finished(0);
+
+		LLSD lod = make_lod(2, 2, 20000);
+		service.run(new RecordingJob(zip_llsd(lod), &result, &success, &finished), buffer);
+		ensure("small succeeded", success);
+		ensure_same("small parsed", result, lod);
+		size_t kept = buffer.size();
+		ensure("small kept", kept > 0 && kept <= LLInflateService::MAX_KEPT_BUFFER);
+
+		LLSD huge = make_lod(3, 4, 400000);
+		ensure("bigger than kept", toBinary(huge).size() > LLInflateService::MAX_KEPT_BUFFER);
+		service.run(new RecordingJob(zip_llsd(huge), &result, &success, &finished), buffer);
+		ensure("huge succeeded", success);
+		ensure_same("huge parsed", result, huge);
+		ensure_equals("huge let go", buffer.capacity(), (size_t) 0);
+
+		service.run(new RecordingJob(zip_llsd(lod), &result, &success, &finished), buffer);
+		ensure("small again succeeded", success);
+		ensure_same("small again parsed", result, lod);
+		ensure_equals("small again kept", buffer.size(), kept);
+		ensure_equals("all finished", (S32) finished, 3);
+	}
+}
@@ -51,10 +51,12 @@ typedef U32 uint32_t;
 #include "boost/phoenix/core/argument.hpp"
 using namespace boost::phoenix;
 
+#include "../llatomic.h"
 #include "../llsd.h"
 #include "../llsdserialize.h"
 #include "llsdutil.h"
 #include "../llformat.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 #include "../test/namedtempfile.h"
@@ -65,6 +67,58 @@ std::vector<U8> string_to_vector(const std::string& str)
 	return std::vector<U8>(str.begin(), str.end());
 }
 
+// Live heap bytes, for the map storage benchmark.  Only counted where the
+// libraries allocate through the test's operator new, which they don't
+// from their own DLLs on Windows.
+LLAtomicS32 sHeapBytes(0);
+
+#if ! LL_WINDOWS
+static const size_t HEAP_HEADER_SIZE = 16;
+
+void* operator new(size_t size)
+{
+	size_t* block = (size_t*) malloc(size + HEAP_HEADER_SIZE);
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+	*block = size;
+	sHeapBytes += size;
+	return (char*) block + HEAP_HEADER_SIZE;
+}
+
+void operator delete(void* ptr) throw()
+{
+	if (ptr)
+	{
+		size_t* block = (size_t*) ((char*) ptr - HEAP_HEADER_SIZE);
+		sHeapBytes -= *block;
+		free(block);
+	}
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	operator delete(ptr);
+}
+
+// what libraries built for C++14 call
+void operator delete(void* ptr, size_t) throw()
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) throw()
+{
+	operator delete(ptr);
+}
+#endif
+
 namespace tut
 {
 	struct sd_xml_data
@@ -1506,6 +1560,862 @@ namespace tut
 		ensureBinaryAndXML("map", test);
 	}
 
+	struct TestLLSDMapStorage
+	{
+		// something like a large inventory descendents response
+		static LLSD makeInventory(S32 num_folders, S32 items_per_folder)
+		{
+			LLSD folders = LLSD::emptyArray();
+			for (S32 f = 0; f < num_folders; ++f)
+			{
+				LLUUID folder_id(llformat("%08x-0000-4000-8000-000000000000", f));
+				LLSD folder;
+				folder["folder_id"] = folder_id;
+				folder["name"] = llformat("Folder %d", f);
+				folder["parent_id"] = LLUUID::null;
+				folder["type"] = -1;
+				folder["version"] = f;
+
+				LLSD& items = folder["items"];
+				for (S32 i = 0; i < items_per_folder; ++i)
+				{
+					LLSD item;
+					item["asset_id"] = LLUUID(llformat("%08x-0000-4000-8000-%012x", f, i + 1));
+					item["created_at"] = 1400000000 + i;
+					item["desc"] = "(No Description)";
+					item["flags"] = 0;
+					item["inv_type"] = 6;
+					item["item_id"] = LLUUID(llformat("%08x-0001-4000-8000-%012x", f, i + 1));
+					item["name"] = llformat("Object %d", i);
+					item["parent_id"] = folder_id;
+
+					LLSD& permissions = item["permissions"];
+					permissions["base_mask"] = 0x7fffffff;
+					permissions["creator_id"] = folder_id;
+					permissions["everyone_mask"] = 0;
+					permissions["group_id"] = LLUUID::null;
+					permissions["group_mask"] = 0;
+					permissions["last_owner_id"] = folder_id;
+					permissions["next_owner_mask"] = 0x82000;
+					permissions["owner_id"] = folder_id;
+					permissions["owner_mask"] = 0x7fffffff;
+
+					item["sale_info"]["sale_price"] = 10;
+					item["sale_info"]["sale_type"] = 0;
+					item["type"] = 6;
+					items.append(item);
+				}
+				folders.append(folder);
+			}
+
+			LLSD inventory;
+			inventory["agent_id"] = LLUUID("01234567-89ab-4cde-8f01-23456789abcd");
+			inventory["folders"] = folders;
+			return inventory;
+		}
+
+		static void collectMaps(const LLSD& sd, std::vector<LLSD>& maps)
+		{
+			if (sd.isMap())
+			{
+				maps.push_back(sd);
+				for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+				{
+					collectMaps(it->second, maps);
+				}
+			}
+			else if (sd.isArray())
+			{
+				for (LLSD::array_const_iterator it = sd.beginArray(); it != sd.endArray(); ++it)
+				{
+					collectMaps(*it, maps);
+				}
+			}
+		}
+	};
+	typedef tut::test_group<TestLLSDMapStorage> TestLLSDMapStorageGroup;
+	typedef TestLLSDMapStorageGroup::object TestLLSDMapStorageObject;
+	TestLLSDMapStorageGroup gTestLLSDMapStorageGroup("llsd map storage");
+
+	// parse time and memory of a large response, and what its maps take
+	// compared to the std::maps they used to be
+	template<> template<>
+	void TestLLSDMapStorageObject::test<1>()
+	{
+		const S32 PASSES = 5;
+		LLSD inventory = makeInventory(200, 50);
+
+		std::ostringstream binary_stream;
+		LLSDSerialize::toBinary(inventory, binary_stream);
+		const std::string binary = binary_stream.str();
+		std::ostringstream xml_stream;
+		LLSDSerialize::toXML(inventory, xml_stream);
+		const std::string xml = xml_stream.str();
+
+		LLTimer timer;
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			LLSD parsed;
+			std::istringstream istr(binary);
+			LLSDSerialize::fromBinary(parsed, istr, binary.size());
+		}
+		F32 binary_time = timer.getElapsedTimeF32() / PASSES;
+		timer.reset();
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			LLSD parsed;
+			std::istringstream istr(xml);
+			LLSDSerialize::fromXML(parsed, istr);
+		}
+		F32 xml_time = timer.getElapsedTimeF32() / PASSES;
+
+		S32 before = sHeapBytes;
+		LLSD parsed;
+		{
+			std::istringstream istr(binary);
+			LLSDSerialize::fromBinary(parsed, istr, binary.size());
+		}
+		S32 tree_bytes = sHeapBytes - before;
+		ensure_equals("parsed back", parsed, inventory);
+
+		// the same entries in both kinds of storage, sharing their values
+		std::vector<LLSD> maps;
+		collectMaps(parsed, maps);
+
+		typedef std::map<LLSD::String, LLSD> legacy_map_t;
+		before = sHeapBytes;
+		timer.reset();
+		std::vector<legacy_map_t>* legacy_maps = new std::vector<legacy_map_t>(maps.size());
+		for (size_t i = 0; i < maps.size(); ++i)
+		{
+			for (LLSD::map_const_iterator it = maps[i].beginMap(); it != maps[i].endMap(); ++it)
+			{
+				(*legacy_maps)[i].insert(legacy_map_t::value_type(it->first, it->second));
+			}
+		}
+		F32 legacy_time = timer.getElapsedTimeF32();
+		S32 legacy_bytes = sHeapBytes - before;
+
+		before = sHeapBytes;
+		timer.reset();
+		std::vector<LLSD>* llsd_maps = new std::vector<LLSD>(maps.size(), LLSD::emptyMap());
+		for (size_t i = 0; i < maps.size(); ++i)
+		{
+			for (LLSD::map_const_iterator it = maps[i].beginMap(); it != maps[i].endMap(); ++it)
+			{
+				(*llsd_maps)[i].insert(it->first, it->second);
+			}
+		}
+		F32 llsd_time = timer.getElapsedTimeF32();
+		S32 llsd_bytes = sHeapBytes - before;
+
+		LL_INFOS() << "parsed " << binary.size() << " bytes of binary in " << binary_time * 1000.f
+			<< " ms, " << xml.size() << " bytes of XML in " << xml_time * 1000.f << " ms, "
+			<< tree_bytes << " bytes in the tree" << LL_ENDL;
+		LL_INFOS() << maps.size() << " maps: " << llsd_bytes << " bytes and " << llsd_time * 1000.f
+			<< " ms to fill, as std::maps " << legacy_bytes << " bytes and " << legacy_time * 1000.f
+			<< " ms" << LL_ENDL;
+
+		for (size_t i = 0; i < maps.size(); ++i)
+		{
+			ensure_equals("same maps", (*llsd_maps)[i], maps[i]);
+		}
+		if (legacy_bytes)
+		{
+			ensure("maps take less than std::maps", llsd_bytes < legacy_bytes);
+		}
+		delete legacy_maps;
+		delete llsd_maps;
+	}
+
+	// Writes down what it is told in notation-like form, skipping any
+	// "skip" keys and the arrays after the first.
+	struct RecordingVisitor : public LLSDVisitor
+	{
+		RecordingVisitor() : mArrays(0) { }
+
+		/*virtual*/ bool beginMap()							{ mLog += "{"; return true; }
+		/*virtual*/ void endMap()							{ mLog += "}"; }
+		/*virtual*/ bool key(const LLSD::String& key)
+		{
+			if (key == "skip")
+			{
+				return false;
+			}
+			mLog += key + ":";
+			return true;
+		}
+		/*virtual*/ bool beginArray()
+		{
+			if (mArrays++)
+			{
+				mLog += "[...]";
+				return false;
+			}
+			mLog += "[";
+			return true;
+		}
+		/*virtual*/ void endArray()							{ mLog += "]"; }
+
+		/*virtual*/ void undefined()						{ mLog += "! "; }
+		/*virtual*/ void boolean(LLSD::Boolean value)		{ mLog += value ? "true " : "false "; }
+		/*virtual*/ void integer(LLSD::Integer value)		{ mLog += llformat("i%d ", value); }
+		/*virtual*/ void real(LLSD::Real value)				{ mLog += llformat("r%g ", value); }
+		/*virtual*/ void string(const LLSD::String& value)	{ mLog += "'" + value + "' "; }
+		/*virtual*/ void uuid(const LLSD::UUID& value)		{ mLog += "u" + value.asString() + " "; }
+		/*virtual*/ void binary(const LLSD::Binary& value)	{ mLog += llformat("b(%d) ", (S32) value.size()); }
+
+		S32 mArrays;
+		std::string mLog;
+	};
+
+	struct TestLLSDVisitor
+	{
+		static LLSD makeValues()
+		{
+			LLSD values;
+			values["undef"] = LLSD();
+			values["true"] = true;
+			values["integer"] = -42;
+			values["real"] = 1.5;
+			values["string"] = "some text";
+			values["uuid"] = LLUUID("01234567-89ab-4cde-8f01-23456789abcd");
+			values["uri"] = LLURI("http://secondlife.com/");
+			values["binary"] = LLSD::Binary(300, 7);
+			values["empty map"] = LLSD::emptyMap();
+			values["empty array"] = LLSD::emptyArray();
+			values["array"].append(1);
+			values["array"].append("two");
+			values["array"][2]["three"] = 3.0;
+			values["map"]["a"]["b"]["c"] = "deep";
+			values["map"]["skip"] = LLSD::Binary(20, 1);
+			return values;
+		}
+
+		static std::string toBinary(const LLSD& sd)
+		{
+			std::ostringstream ostr;
+			LLSDSerialize::toBinary(sd, ostr);
+			return ostr.str();
+		}
+
+		static std::string toXML(const LLSD& sd)
+		{
+			std::ostringstream ostr;
+			LLSDSerialize::toXML(sd, ostr);
+			return ostr.str();
+		}
+
+		// what a fetch handler keeps of an inventory item
+		struct Item
+		{
+			LLUUID mItemID;
+			LLUUID mParentID;
+			std::string mName;
+			S32 mType;
+			S32 mInvType;
+
+			bool operator==(const Item& rhs) const
+			{
+				return mItemID == rhs.mItemID && mParentID == rhs.mParentID && mName == rhs.mName
+					&& mType == rhs.mType && mInvType == rhs.mInvType;
+			}
+		};
+
+		static void readItems(const LLSD& inventory, std::vector<Item>& items)
+		{
+			const LLSD& folders = inventory["folders"];
+			for (LLSD::array_const_iterator folder = folders.beginArray(); folder != folders.endArray(); ++folder)
+			{
+				const LLSD& folder_items = (*folder)["items"];
+				for (LLSD::array_const_iterator it = folder_items.beginArray(); it != folder_items.endArray(); ++it)
+				{
+					Item item;
+					item.mItemID = (*it)["item_id"].asUUID();
+					item.mParentID = (*it)["parent_id"].asUUID();
+					item.mName = (*it)["name"].asString();
+					item.mType = (*it)["type"].asInteger();
+					item.mInvType = (*it)["inv_type"].asInteger();
+					items.push_back(item);
+				}
+			}
+		}
+
+		// the same straight off the parser, skipping everything else
+		struct ItemVisitor : public LLSDVisitor
+		{
+			ItemVisitor(std::vector<Item>& items) : mItems(items), mDepth(0) { }
+
+			/*virtual*/ bool beginMap()
+			{
+				if (++mDepth == ITEM_DEPTH)
+				{
+					mItems.push_back(Item());
+				}
+				return true;
+			}
+			/*virtual*/ void endMap()						{ --mDepth; }
+			/*virtual*/ bool beginArray()					{ ++mDepth; return true; }
+			/*virtual*/ void endArray()						{ --mDepth; }
+
+			/*virtual*/ bool key(const LLSD::String& key)
+			{
+				mKey = key;
+				switch (mDepth)
+				{
+				case 1:
+					return key == "folders";
+				case 3:
+					return key == "items";
+				case ITEM_DEPTH:
+					return key == "item_id" || key == "parent_id" || key == "name"
+						|| key == "type" || key == "inv_type";
+				default:
+					return false;
+				}
+			}
+
+			/*virtual*/ void integer(LLSD::Integer value)
+			{
+				if (mKey == "type")
+				{
+					mItems.back().mType = value;
+				}
+				else
+				{
+					mItems.back().mInvType = value;
+				}
+			}
+			/*virtual*/ void string(const LLSD::String& value)	{ mItems.back().mName = value; }
+			/*virtual*/ void uuid(const LLSD::UUID& value)
+			{
+				if (mKey == "item_id")
+				{
+					mItems.back().mItemID = value;
+				}
+				else
+				{
+					mItems.back().mParentID = value;
+				}
+			}
+
+			// root map, folders array, folder map, items array, item map
+			enum { ITEM_DEPTH = 5 };
+
+			std::vector<Item>& mItems;
+			S32 mDepth;
+			LLSD::String mKey;
+		};
+
+		// a materials response, once unzipped
+		static LLSD makeMaterials(S32 count)
+		{
+			LLSD materials = LLSD::emptyArray();
+			for (S32 i = 0; i < count; ++i)
+			{
+				LLUUID id(llformat("%08x-0000-4000-8000-000000000000", i + 1));
+				LLSD entry;
+				entry["ID"] = LLSD::Binary(id.mData, id.mData + UUID_BYTES);
+				LLSD& material = entry["Material"];
+				material["AlphaMaskCutoff"] = 0;
+				material["DiffuseAlphaMode"] = 1;
+				material["EnvIntensity"] = 0;
+				material["NormMap"] = LLUUID(llformat("%08x-0001-4000-8000-000000000000", i));
+				material["NormOffsetX"] = 0;
+				material["NormOffsetY"] = 0;
+				material["NormRepeatX"] = 10000;
+				material["NormRepeatY"] = 10000;
+				material["NormRotation"] = 0;
+				material["SpecColor"].append(255);
+				material["SpecColor"].append(255);
+				material["SpecColor"].append(255);
+				material["SpecColor"].append(255);
+				material["SpecExp"] = 51;
+				material["SpecMap"] = LLUUID(llformat("%08x-0002-4000-8000-000000000000", i));
+				material["SpecOffsetX"] = 0;
+				material["SpecOffsetY"] = 0;
+				material["SpecRepeatX"] = 10000;
+				material["SpecRepeatY"] = 10000;
+				material["SpecRotation"] = 0;
+				materials.append(entry);
+			}
+			return materials;
+		}
+
+		// what the material manager keeps of one
+		struct Material
+		{
+			LLUUID mID;
+			LLUUID mNormalID;
+			LLUUID mSpecularID;
+			S32 mSpecularExponent;
+			S32 mSpecularColor[4];
+
+			bool operator==(const Material& rhs) const
+			{
+				return mID == rhs.mID && mNormalID == rhs.mNormalID && mSpecularID == rhs.mSpecularID
+					&& mSpecularExponent == rhs.mSpecularExponent
+					&& !memcmp(mSpecularColor, rhs.mSpecularColor, sizeof(mSpecularColor));
+			}
+		};
+
+		static void readMaterials(const LLSD& materials, std::vector<Material>& out)
+		{
+			for (LLSD::array_const_iterator it = materials.beginArray(); it != materials.endArray(); ++it)
+			{
+				Material material;
+				const LLSD::Binary& id = (*it)["ID"].asBinary();
+				memcpy(material.mID.mData, &id[0], UUID_BYTES);
+				const LLSD& data = (*it)["Material"];
+				material.mNormalID = data["NormMap"].asUUID();
+				material.mSpecularID = data["SpecMap"].asUUID();
+				material.mSpecularExponent = data["SpecExp"].asInteger();
+				for (S32 i = 0; i < 4; ++i)
+				{
+					material.mSpecularColor[i] = data["SpecColor"][i].asInteger();
+				}
+				out.push_back(material);
+			}
+		}
+
+		struct MaterialVisitor : public LLSDVisitor
+		{
+			MaterialVisitor(std::vector<Material>& materials) : mMaterials(materials), mDepth(0) { }
+
+			/*virtual*/ bool beginMap()
+			{
+				if (++mDepth == ENTRY_DEPTH)
+				{
+					mMaterials.push_back(Material());
+				}
+				return true;
+			}
+			/*virtual*/ void endMap()						{ --mDepth; }
+			/*virtual*/ bool beginArray()
+			{
+				mColor = 0;
+				++mDepth;
+				return true;
+			}
+			/*virtual*/ void endArray()						{ --mDepth; }
+
+			/*virtual*/ bool key(const LLSD::String& key)
+			{
+				mKey = key;
+				if (mDepth == ENTRY_DEPTH)
+				{
+					return key == "ID" || key == "Material";
+				}
+				return key == "NormMap" || key == "SpecMap" || key == "SpecExp" || key == "SpecColor";
+			}
+
+			/*virtual*/ void binary(const LLSD::Binary& value)
+			{
+				if (value.size() == UUID_BYTES)
+				{
+					memcpy(mMaterials.back().mID.mData, &value[0], UUID_BYTES);
+				}
+			}
+			/*virtual*/ void uuid(const LLSD::UUID& value)
+			{
+				if (mKey == "NormMap")
+				{
+					mMaterials.back().mNormalID = value;
+				}
+				else
+				{
+					mMaterials.back().mSpecularID = value;
+				}
+			}
+			/*virtual*/ void integer(LLSD::Integer value)
+			{
+				if (mDepth > ENTRY_DEPTH + 1)
+				{
+					if (mColor < 4)
+					{
+						mMaterials.back().mSpecularColor[mColor++] = value;
+					}
+				}
+				else
+				{
+					mMaterials.back().mSpecularExponent = value;
+				}
+			}
+
+			// response array, entry map
+			enum { ENTRY_DEPTH = 2 };
+
+			std::vector<Material>& mMaterials;
+			S32 mDepth;
+			S32 mColor;
+			LLSD::String mKey;
+		};
+	};
+	typedef tut::test_group<TestLLSDVisitor> TestLLSDVisitorGroup;
+	typedef TestLLSDVisitorGroup::object TestLLSDVisitorObject;
+	TestLLSDVisitorGroup gTestLLSDVisitorGroup("llsd visitor");
+
+	// visiting into a builder gives back the tree, from either format
+	template<> template<>
+	void TestLLSDVisitorObject::test<1>()
+	{
+		LLSD values = makeValues();
+
+		LLSD built;
+		LLSDBuilder tree_builder(built);
+		tree_builder.visit(values);
+		ensure_equals("tree", built, values);
+
+		std::istringstream binary(toBinary(values));
+		LLSD from_binary;
+		LLSDBuilder binary_builder(from_binary);
+		ensure("binary parsed", LLSDSerialize::visitBinary(binary_builder, binary, binary.str().size()) > 0);
+		ensure_equals("binary", from_binary, values);
+
+		std::istringstream xml(toXML(values));
+		LLSD from_xml;
+		LLSDBuilder xml_builder(from_xml);
+		ensure("xml parsed", LLSDSerialize::visitXML(xml_builder, xml) > 0);
+		ensure_equals("xml", from_xml, values);
+
+		LLSD scalar;
+		LLSDBuilder scalar_builder(scalar);
+		std::istringstream binary_scalar(toBinary(LLSD("alone")));
+		ensure_equals("scalar count", LLSDSerialize::visitBinary(scalar_builder, binary_scalar, 100), 1);
+		ensure_equals("scalar", scalar.asString(), std::string("alone"));
+	}
+
+	// skipped keys and containers are left out of the calls the same way
+	// from the tree and both parsers, and a broken stream fails part way
+	template<> template<>
+	void TestLLSDVisitorObject::test<2>()
+	{
+		LLSD values;
+		values["a"] = 1;
+		values["list"].append("x");
+		values["list"].append(LLSD());
+		values["list"][2].append(true);
+		values["list"].append(LLSD::emptyArray());
+		values["skip"]["big"] = LLSD::Binary(1000, 0);
+		values["z"]["skip"] = "no";
+		values["z"]["y"] = 2.5;
+		const std::string expected("{a:i1 list:['x' ! [...][...]]z:{y:r2.5 }}");
+
+		RecordingVisitor tree;
+		tree.visit(values);
+		ensure_equals("tree", tree.mLog, expected);
+
+		std::istringstream binary(toBinary(values));
+		RecordingVisitor from_binary;
+		ensure("binary parsed", LLSDSerialize::visitBinary(from_binary, binary, binary.str().size()) > 0);
+		ensure_equals("binary", from_binary.mLog, expected);
+
+		std::istringstream xml(toXML(values));
+		RecordingVisitor from_xml;
+		ensure("xml parsed", LLSDSerialize::visitXML(from_xml, xml) > 0);
+		ensure_equals("xml", from_xml.mLog, expected);
+
+		// the limit is kept while skipping
+		std::string serialized = toBinary(values);
+		std::istringstream limited(serialized);
+		RecordingVisitor from_limited;
+		ensure_equals("limited", LLSDSerialize::visitBinary(from_limited, limited, 200),
+					  (S32) LLSDParser::PARSE_FAILURE);
+
+		std::istringstream truncated(serialized.substr(0, serialized.size() - 20));
+		RecordingVisitor from_truncated;
+		ensure_equals("truncated", LLSDSerialize::visitBinary(from_truncated, truncated, serialized.size()),
+					  (S32) LLSDParser::PARSE_FAILURE);
+		ensure_equals("calls up to the failure", from_truncated.mLog, std::string("{a:i1 list:['x' ! [...][...]]z:{"));
+	}
+
+	// picking the items out of a large inventory response
+	template<> template<>
+	void TestLLSDVisitorObject::test<3>()
+	{
+		const S32 PASSES = 5;
+		LLSD inventory = TestLLSDMapStorage::makeInventory(200, 50);
+		const std::string binary = toBinary(inventory);
+		const std::string xml = toXML(inventory);
+
+		std::vector<Item> expected;
+		readItems(inventory, expected);
+		ensure_equals("item count", expected.size(), (size_t) 10000);
+
+		F32 times[4];
+		LLTimer timer;
+		for (S32 format = 0; format < 2; ++format)
+		{
+			const std::string& serialized = format ? xml : binary;
+
+			timer.reset();
+			for (S32 i = 0; i < PASSES; ++i)
+			{
+				std::istringstream istr(serialized);
+				LLSD parsed;
+				if (format)
+				{
+					LLSDSerialize::fromXML(parsed, istr);
+				}
+				else
+				{
+					LLSDSerialize::fromBinary(parsed, istr, serialized.size());
+				}
+				std::vector<Item> items;
+				readItems(parsed, items);
+				ensure("tree items", items == expected);
+			}
+			times[format * 2] = timer.getElapsedTimeF32() / PASSES;
+
+			timer.reset();
+			for (S32 i = 0; i < PASSES; ++i)
+			{
+				std::istringstream istr(serialized);
+				std::vector<Item> items;
+				ItemVisitor visitor(items);
+				if (format)
+				{
+					LLSDSerialize::visitXML(visitor, istr);
+				}
+				else
+				{
+					LLSDSerialize::visitBinary(visitor, istr, serialized.size());
+				}
+				ensure("visited items", items == expected);
+			}
+			times[format * 2 + 1] = timer.getElapsedTimeF32() / PASSES;
+		}
+
+		LL_INFOS() << expected.size() << " inventory items, binary: " << times[0] * 1000.f << " ms from the tree, "
+			<< times[1] * 1000.f << " ms visited; XML: " << times[2] * 1000.f << " ms from the tree, "
+			<< times[3] * 1000.f << " ms visited" << LL_ENDL;
+	}
+
+	// decoding a large materials response
+	template<> template<>
+	void TestLLSDVisitorObject::test<4>()
+	{
+		const S32 PASSES = 5;
+		LLSD response = makeMaterials(5000);
+		const std::string binary = toBinary(response);
+
+		std::vector<Material> expected;
+		readMaterials(response, expected);
+
+		LLTimer timer;
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			std::istringstream istr(binary);
+			LLSD parsed;
+			LLSDSerialize::fromBinary(parsed, istr, binary.size());
+			std::vector<Material> materials;
+			readMaterials(parsed, materials);
+			ensure("tree materials", materials == expected);
+		}
+		F32 tree_time = timer.getElapsedTimeF32() / PASSES;
+
+		timer.reset();
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			std::istringstream istr(binary);
+			std::vector<Material> materials;
+			MaterialVisitor visitor(materials);
+			LLSDSerialize::visitBinary(visitor, istr, binary.size());
+			ensure("visited materials", materials == expected);
+		}
+		F32 visit_time = timer.getElapsedTimeF32() / PASSES;
+
+		LL_INFOS() << expected.size() << " materials: " << tree_time * 1000.f << " ms from the tree, "
+			<< visit_time * 1000.f << " ms visited" << LL_ENDL;
+	}
+
+	struct TestLLSDBinaryBuffer
+	{
+		// LOD-like: a few faces of large binary streams
+		static LLSD makeMesh(S32 faces, S32 vertices)
+		{
+			LLSD mesh = LLSD::emptyArray();
+			for (S32 i = 0; i < faces; ++i)
+			{
+				LLSD face;
+				face["Position"] = LLSD::Binary(vertices * 6, (U8) i);
+				face["Normal"] = LLSD::Binary(vertices * 6, (U8) (i + 1));
+				face["TexCoord0"] = LLSD::Binary(vertices * 4, (U8) (i + 2));
+				face["TriangleList"] = LLSD::Binary(vertices * 6, (U8) (i + 3));
+				face["PositionDomain"]["Min"].append(-0.5);
+				face["PositionDomain"]["Max"].append(0.5);
+				mesh.append(face);
+			}
+			return mesh;
+		}
+
+		// adds up binary sizes, checking views point into the buffer
+		struct ViewVisitor : public LLSDVisitor
+		{
+			ViewVisitor(const U8* begin, const U8* end)
+			:	mBegin(begin), mEnd(end), mBytes(0), mOutside(0)
+			{
+			}
+
+			/*virtual*/ void binaryView(const U8* data, size_t size)
+			{
+				if (data < mBegin || data + size > mEnd)
+				{
+					++mOutside;
+				}
+				mBytes += size;
+			}
+
+			const U8* mBegin;
+			const U8* mEnd;
+			size_t mBytes;
+			S32 mOutside;
+		};
+	};
+	typedef tut::test_group<TestLLSDBinaryBuffer> TestLLSDBinaryBufferGroup;
+	typedef TestLLSDBinaryBufferGroup::object TestLLSDBinaryBufferObject;
+	TestLLSDBinaryBufferGroup gTestLLSDBinaryBufferGroup("llsd binary buffer");
+
+	// parses the same as the stream, and says how much it took up
+	template<> template<>
+	void TestLLSDBinaryBufferObject::test<1>()
+	{
+		LLSD values = TestLLSDVisitor::makeValues();
+		std::string serialized = TestLLSDVisitor::toBinary(values);
+		std::istringstream istr(serialized);
+		LLSD from_stream;
+		S32 stream_count = LLSDSerialize::fromBinary(from_stream, istr, serialized.size());
+
+		serialized += "trailing";
+		const U8* data = (const U8*) serialized.data();
+		LLSD from_buffer;
+		size_t used = 0;
+		ensure_equals("count", LLSDSerialize::fromBinary(from_buffer, data, serialized.size(), &used), stream_count);
+		ensure_equals("values", from_buffer, values);
+		ensure_equals("used", used, serialized.size() - 8);
+
+		LLSD visited;
+		LLSDBuilder builder(visited);
+		ensure_equals("visit count", LLSDSerialize::visitBinary(builder, data, serialized.size()), stream_count);
+		ensure_equals("visited", visited, values);
+
+		// notation style strings and keys are read too
+		const char notation[] = "{\x00\x00\x00\x02'a\\x41\\tb'\"q\\\"\"k\x00\x00\x00\x01z'\\''}";
+		LLSD quoted;
+		ensure("quoted parsed", LLSDSerialize::fromBinary(quoted, (const U8*) notation, sizeof(notation) - 1) > 0);
+		ensure_equals("quoted key", quoted["aA\tb"].asString(), std::string("q\""));
+		ensure_equals("quoted value", quoted["z"].asString(), std::string("'"));
+	}
+
+	// every truncation and broken size fails without reading past the end
+	template<> template<>
+	void TestLLSDBinaryBufferObject::test<2>()
+	{
+		const std::string serialized = TestLLSDVisitor::toBinary(TestLLSDVisitor::makeValues());
+		for (size_t size = 0; size < serialized.size(); ++size)
+		{
+			// exactly sized, so reading past it is caught by the sanitizers
+			std::vector<U8> buffer(serialized.begin(), serialized.begin() + size);
+			const U8* data = size ? &buffer[0] : NULL;
+			LLSD parsed;
+			ensure(llformat("truncated at %d", (S32) size),
+				   LLSDSerialize::fromBinary(parsed, data, size) <= 0);
+			ensure("cleared", parsed.isUndefined());
+			RecordingVisitor visitor;
+			ensure(llformat("truncated visit at %d", (S32) size),
+				   LLSDSerialize::visitBinary(visitor, data, size) <= 0);
+		}
+
+		// a string claiming more than there is
+		std::vector<U8> bad(serialized.begin(), serialized.end());
+		size_t string_pos = serialized.find("some text") - 4;
+		bad[string_pos] = 0x7f;
+		LLSD parsed;
+		ensure_equals("oversized string", LLSDSerialize::fromBinary(parsed, &bad[0], bad.size()),
+					  (S32) LLSDParser::PARSE_FAILURE);
+		// and one claiming less than nothing
+		bad[string_pos] = 0x80;
+		ensure_equals("negative string", LLSDSerialize::fromBinary(parsed, &bad[0], bad.size()),
+					  (S32) LLSDParser::PARSE_FAILURE);
+	}
+
+	// binaries are handed out as views into the buffer, and unzip_llsd()
+	// parses its output in place
+	template<> template<>
+	void TestLLSDBinaryBufferObject::test<3>()
+	{
+		LLSD mesh = makeMesh(8, 20000);
+		const std::string serialized = TestLLSDVisitor::toBinary(mesh);
+		const U8* data = (const U8*) serialized.data();
+
+		ViewVisitor visitor(data, data + serialized.size());
+		ensure("visited", LLSDSerialize::visitBinary(visitor, data, serialized.size()) > 0);
+		ensure_equals("views in the buffer", visitor.mOutside, 0);
+		ensure_equals("binary bytes", visitor.mBytes, (size_t) 8 * 20000 * 22);
+
+		std::string zipped = zip_llsd(mesh);
+		LLSD unzipped;
+		ensure("unzipped from memory", unzip_llsd(unzipped, (const U8*) zipped.data(), zipped.size()));
+		ensure_equals("unzipped", unzipped, mesh);
+		std::istringstream zipped_stream(zipped);
+		LLSD unzipped_stream;
+		ensure("unzipped from stream", unzip_llsd(unzipped_stream, zipped_stream, zipped.size()));
+		ensure_equals("unzipped stream", unzipped_stream, mesh);
+
+		std::string broken = zipped.substr(0, zipped.size() / 2);
+		LLSD unzipped_broken;
+		ensure("broken", !unzip_llsd(unzipped_broken, (const U8*) broken.data(), broken.size()));
+	}
+
+	// stream against buffer parses of an inventory response and a mesh LOD
+	template<> template<>
+	void TestLLSDBinaryBufferObject::test<4>()
+	{
+		const S32 PASSES = 5;
+		const std::string payloads[2] = {
+			TestLLSDVisitor::toBinary(TestLLSDMapStorage::makeInventory(200, 50)),
+			TestLLSDVisitor::toBinary(makeMesh(8, 65536))
+		};
+		const char* names[2] = { "inventory", "mesh" };
+
+		for (S32 p = 0; p < 2; ++p)
+		{
+			const std::string& serialized = payloads[p];
+			const U8* data = (const U8*) serialized.data();
+
+			LLTimer timer;
+			for (S32 i = 0; i < PASSES; ++i)
+			{
+				// what unzip_llsd() used to do with its output
+				std::string copy(serialized);
+				std::istringstream istr(copy);
+				LLSD parsed;
+				LLSDSerialize::fromBinary(parsed, istr, copy.size());
+			}
+			F32 stream_time = timer.getElapsedTimeF32() / PASSES;
+
+			timer.reset();
+			for (S32 i = 0; i < PASSES; ++i)
+			{
+				LLSD parsed;
+				LLSDSerialize::fromBinary(parsed, data, serialized.size());
+			}
+			F32 buffer_time = timer.getElapsedTimeF32() / PASSES;
+
+			timer.reset();
+			for (S32 i = 0; i < PASSES; ++i)
+			{
+				ViewVisitor visitor(data, data + serialized.size());
+				LLSDSerialize::visitBinary(visitor, data, serialized.size());
+			}
+			F32 view_time = timer.getElapsedTimeF32() / PASSES;
+
+			LL_INFOS() << names[p] << ", " << serialized.size() << " bytes: " << stream_time * 1000.f
+				<< " ms through a stream, " << buffer_time * 1000.f << " ms from the buffer, "
+				<< view_time * 1000.f << " ms visited with views" << LL_ENDL;
+		}
+	}
+
     struct TestPythonCompatible
     {
         TestPythonCompatible():
@@ -0,0 +1,429 @@
+/**
+ * @file lluuidhashmap_test.cpp
+ * @brief LLUUIDHashMap tests, against std::map.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <map>
+
+#include "../lluuidhashmap.h"
+#include "../llfanout.h"
+#include "../llstl.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// ids that share their low bytes, the way made up ones often do
+	LLUUID make_id(U32 seed)
+	{
+		LLUUID id;
+		id.mData[12] = (U8) (seed >> 24);
+		id.mData[13] = (U8) (seed >> 16);
+		id.mData[14] = (U8) (seed >> 8);
+		id.mData[15] = (U8) seed;
+		return id;
+	}
+
+	// ids spread over all of their bytes, like generated ones
+	LLUUID random_id(U32& seed)
+	{
+		LLUUID id;
+		for (S32 i = 0; i < UUID_BYTES; ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			id.mData[i] = (U8) (seed >> 24);
+		}
+		return id;
+	}
+
+	template <class T>
+	bool same_contents(const LLUUIDHashMap<T>& map, const std::map<LLUUID, T>& expected)
+	{
+		if (map.size() != expected.size())
+		{
+			return false;
+		}
+		size_t visited = 0;
+		for (typename LLUUIDHashMap<T>::const_iterator it = map.begin(); it != map.end(); ++it)
+		{
+			typename std::map<LLUUID, T>::const_iterator found = expected.find(it->first);
+			if (found == expected.end() || found->second != it->second)
+			{
+				return false;
+			}
+			++visited;
+		}
+		return visited == expected.size();
+	}
+}
+
+namespace tut
+{
+	struct uuidhashmap_test
+	{
+	};
+	typedef test_group<uuidhashmap_test> uuidhashmap_t;
+	typedef uuidhashmap_t::object uuidhashmap_object_t;
+	tut::uuidhashmap_t tut_uuidhashmap("LLUUIDHashMap");
+
+	// the basics, the null id included
+	template<> template<>
+	void uuidhashmap_object_t::test<1>()
+	{
+		LLUUIDHashMap<S32> map;
+		ensure("starts empty", map.empty());
+		ensure("nothing to find", map.find(LLUUID::null) == map.end());
+		ensure("begin is end", map.begin() == map.end());
+		ensure_equals("nothing to erase", (S32) map.erase(LLUUID::null), 0);
+
+		map[LLUUID::null] = 7;
+		LLUUID id;
+		id.generate();
+		ensure("inserted", map.insert(std::make_pair(id, 3)).second);
+		ensure("not twice", !map.insert(std::make_pair(id, 4)).second);
+
+		ensure_equals("size", (S32) map.size(), 2);
+		ensure_equals("null", map[LLUUID::null], 7);
+		ensure_equals("id", map.find(id)->second, 3);
+		ensure_equals("count", (S32) map.count(id), 1);
+		ensure("helper", is_in_map(map, id));
+
+		ensure_equals("erased", (S32) map.erase(LLUUID::null), 1);
+		ensure("gone", map.find(LLUUID::null) == map.end());
+		ensure_equals("other left", map.find(id)->second, 3);
+
+		map.clear();
+		ensure("cleared", map.empty() && map.find(id) == map.end());
+	}
+
+	// mixed inserts and erases, with clustered ids, stay in step with
+	// std::map through growing and back shifting
+	template<> template<>
+	void uuidhashmap_object_t::test<2>()
+	{
+		LLUUIDHashMap<U32> map;
+		std::map<LLUUID, U32> expected;
+		U32 seed = 99;
+		for (U32 i = 0; i < 20000; ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			LLUUID id = make_id((seed >> 16) % 3000);
+			if (seed & 0x100)
+			{
+				map[id] = i;
+				expected[id] = i;
+			}
+			else
+			{
+				ensure_equals("erase result", map.erase(id), expected.erase(id));
+			}
+			if (i % 997 == 0)
+			{
+				ensure("contents", same_contents(map, expected));
+			}
+		}
+		ensure("final contents", same_contents(map, expected));
+
+		for (U32 i = 0; i < 3000; ++i)
+		{
+			LLUUID id = make_id(i);
+			ensure_equals("lookup", map.count(id), expected.count(id));
+		}
+	}
+
+	// pointers as values, the way the inventory keeps its child arrays
+	template<> template<>
+	void uuidhashmap_object_t::test<3>()
+	{
+		LLUUIDHashMap<std::vector<S32>*> map;
+		map.reserve(100);
+		std::vector<S32>* first = new std::vector<S32>(1, 1);
+		map[make_id(1)] = first;
+		for (U32 i = 2; i < 1000; ++i)
+		{
+			map[make_id(i)] = new std::vector<S32>(1, i);
+		}
+		ensure("stable value", get_ptr_in_map(map, make_id(1)) == first);
+		ensure("missing", get_ptr_in_map(map, make_id(5000)) == NULL);
+
+		std::for_each(map.begin(), map.end(), DeletePairedPointer());
+		map.clear();
+	}
+
+	// An inventory sized like a big one, 15,000 folders and 150,000 items
+	// under a root with a trash folder, run the way LLInventoryModel uses
+	// it: index everything by id, file everything under its parent's child
+	// array, then collect every descendent of the root outside the trash.
+	struct InventoryShape
+	{
+		enum { FOLDER_COUNT = 15000, ITEM_COUNT = 150000, TOP_FOLDERS = 25, TRASH = 1 };
+
+		InventoryShape()
+		{
+			U32 seed = 1234;
+			for (S32 i = 0; i < FOLDER_COUNT; ++i)
+			{
+				mFolders.push_back(random_id(seed));
+				S32 parent = -1;
+				if (i > 0 && i <= TOP_FOLDERS)
+				{
+					parent = 0;
+				}
+				else if (i > TOP_FOLDERS)
+				{
+					seed = seed * 1664525 + 1013904223;
+					parent = 1 + (seed >> 8) % (i - 1);
+				}
+				mFolderParents.push_back(parent < 0 ? LLUUID::null : mFolders[parent]);
+			}
+			for (S32 i = 0; i < ITEM_COUNT; ++i)
+			{
+				mItems.push_back(random_id(seed));
+				seed = seed * 1664525 + 1013904223;
+				mItemParents.push_back(mFolders[(seed >> 8) % FOLDER_COUNT]);
+			}
+		}
+
+		std::vector<LLUUID> mFolders;
+		std::vector<LLUUID> mFolderParents;
+		std::vector<LLUUID> mItems;
+		std::vector<LLUUID> mItemParents;
+	};
+
+	template <class INDEX_MAP, class CHILD_MAP>
+	struct InventoryIndex
+	{
+		typedef std::vector<S32> child_array_t;
+
+		InventoryIndex()
+		:	mCollectedFolders(0),
+			mCollectedItems(0)
+		{
+		}
+
+		~InventoryIndex()
+		{
+			std::for_each(mChildFolders.begin(), mChildFolders.end(), DeletePairedPointer());
+			std::for_each(mChildItems.begin(), mChildItems.end(), DeletePairedPointer());
+		}
+
+		void build(const InventoryShape& shape)
+		{
+			for (S32 i = 0; i < InventoryShape::FOLDER_COUNT; ++i)
+			{
+				mFolders[shape.mFolders[i]] = i;
+				mChildFolders[shape.mFolders[i]] = new child_array_t;
+				mChildItems[shape.mFolders[i]] = new child_array_t;
+			}
+			for (S32 i = 0; i < InventoryShape::ITEM_COUNT; ++i)
+			{
+				mItems[shape.mItems[i]] = i;
+			}
+			for (S32 i = 1; i < InventoryShape::FOLDER_COUNT; ++i)
+			{
+				mChildFolders[shape.mFolderParents[i]]->push_back(i);
+			}
+			for (S32 i = 0; i < InventoryShape::ITEM_COUNT; ++i)
+			{
+				mChildItems[shape.mItemParents[i]]->push_back(i);
+			}
+		}
+
+		// the trash is found by walking the root's folders
+		S32 findTrash(const InventoryShape& shape)
+		{
+			const child_array_t& top = *mChildFolders[shape.mFolders[0]];
+			for (U32 i = 0; i < top.size(); ++i)
+			{
+				if (top[i] == InventoryShape::TRASH)
+				{
+					return top[i];
+				}
+			}
+			return -1;
+		}
+
+		// per_folder_lookup looks the trash up again in every folder, the
+		// way collectDescendentsIf used to
+		void collect(const InventoryShape& shape, const LLUUID& id, S32 trash, bool per_folder_lookup)
+		{
+			if (per_folder_lookup)
+			{
+				trash = findTrash(shape);
+			}
+			mCollectedItems += mChildItems[id]->size();
+			const child_array_t& folders = *mChildFolders[id];
+			for (U32 i = 0; i < folders.size(); ++i)
+			{
+				if (folders[i] != trash)
+				{
+					++mCollectedFolders;
+					collect(shape, shape.mFolders[folders[i]], trash, per_folder_lookup);
+				}
+			}
+		}
+
+		INDEX_MAP	mFolders;
+		INDEX_MAP	mItems;
+		CHILD_MAP	mChildFolders;
+		CHILD_MAP	mChildItems;
+		size_t		mCollectedFolders;
+		size_t		mCollectedItems;
+	};
+
+	typedef InventoryIndex<std::map<LLUUID, S32>, std::map<LLUUID, std::vector<S32>*> > tree_index_t;
+	typedef InventoryIndex<LLUUIDHashMap<S32>, LLUUIDHashMap<std::vector<S32>*> > hash_index_t;
+
+	// The inventory's old std::map index, and its old per folder trash
+	// lookup, against the hash tables.  Both must find the same things,
+	// the timings go to the log.
+	template<> template<>
+	void uuidhashmap_object_t::test<4>()
+	{
+		const InventoryShape shape;
+		const LLUUID& root = shape.mFolders[0];
+		LLTimer timer;
+
+		tree_index_t tree;
+		timer.reset();
+		tree.build(shape);
+		F64 tree_build = timer.getElapsedTimeF64();
+		timer.reset();
+		tree.collect(shape, root, -1, true);
+		F64 tree_collect = timer.getElapsedTimeF64();
+
+		hash_index_t hash;
+		timer.reset();
+		hash.mFolders.reserve(InventoryShape::FOLDER_COUNT);
+		hash.mItems.reserve(InventoryShape::ITEM_COUNT);
+		hash.mChildFolders.reserve(InventoryShape::FOLDER_COUNT);
+		hash.mChildItems.reserve(InventoryShape::FOLDER_COUNT);
+		hash.build(shape);
+		F64 hash_build = timer.getElapsedTimeF64();
+		timer.reset();
+		hash.collect(shape, root, hash.findTrash(shape), false);
+		F64 hash_collect = timer.getElapsedTimeF64();
+
+		ensure("some folders left out", tree.mCollectedFolders < InventoryShape::FOLDER_COUNT - 1);
+		ensure_equals("folders", hash.mCollectedFolders, tree.mCollectedFolders);
+		ensure_equals("items", hash.mCollectedItems, tree.mCollectedItems);
+		ensure_equals("sizes", hash.mItems.size(), tree.mItems.size());
+
+		LL_INFOS("UUIDHashMapBench") << InventoryShape::FOLDER_COUNT << " folders, "
+			<< InventoryShape::ITEM_COUNT << " items, collected " << hash.mCollectedFolders
+			<< " and " << hash.mCollectedItems << ": std::map build " << tree_build * 1000.0
+			<< " ms, collect " << tree_collect * 1000.0 << " ms; hash build "
+			<< hash_build * 1000.0 << " ms, collect " << hash_collect * 1000.0 << " ms" << LL_ENDL;
+	}
+
+	// The parent lookups of buildParentChildMap(): every folder and item
+	// finds its parent's child array, in slices of the skeleton.
+	struct ParentLookup
+	{
+		enum { SLICE = 2048 };
+		typedef hash_index_t::child_array_t child_array_t;
+
+		ParentLookup(const InventoryShape& shape, const hash_index_t& index)
+		:	mShape(shape),
+			mIndex(index),
+			mFolderParents(InventoryShape::FOLDER_COUNT),
+			mItemParents(InventoryShape::ITEM_COUNT)
+		{
+		}
+
+		static S32 getSliceCount()
+		{
+			return (InventoryShape::FOLDER_COUNT + InventoryShape::ITEM_COUNT + SLICE - 1) / SLICE;
+		}
+
+		static void lookupSlice(void* context, S32 slice)
+		{
+			ParentLookup* lookup = (ParentLookup*)context;
+			const S32 end = llmin((slice + 1) * (S32) SLICE, InventoryShape::FOLDER_COUNT + InventoryShape::ITEM_COUNT);
+			for (S32 i = slice * SLICE; i < end; ++i)
+			{
+				if (i < InventoryShape::FOLDER_COUNT)
+				{
+					lookup->mFolderParents[i] = get_ptr_in_map(lookup->mIndex.mChildFolders, lookup->mShape.mFolderParents[i]);
+				}
+				else
+				{
+					S32 item = i - InventoryShape::FOLDER_COUNT;
+					lookup->mItemParents[item] = get_ptr_in_map(lookup->mIndex.mChildItems, lookup->mShape.mItemParents[item]);
+				}
+			}
+		}
+
+		const InventoryShape& mShape;
+		const hash_index_t& mIndex;
+		std::vector<child_array_t*> mFolderParents;
+		std::vector<child_array_t*> mItemParents;
+	};
+
+	// The parent lookups for the same 150,000 items on the calling thread
+	// alone and spread over three workers, as buildParentChildMap() does
+	// with its default PVInventory_ParentChildMapThreads.  Both must find
+	// the same arrays, the timings go to the log.
+	template<> template<>
+	void uuidhashmap_object_t::test<5>()
+	{
+		const InventoryShape shape;
+		hash_index_t index;
+		index.mChildFolders.reserve(InventoryShape::FOLDER_COUNT);
+		index.mChildItems.reserve(InventoryShape::FOLDER_COUNT);
+		index.build(shape);
+
+		LLTimer timer;
+		ParentLookup serial(shape, index);
+		LLFanOut inline_fan_out("inline", 0);
+		timer.reset();
+		inline_fan_out.run(ParentLookup::getSliceCount(), ParentLookup::lookupSlice, &serial);
+		F64 serial_time = timer.getElapsedTimeF64();
+
+		ParentLookup parallel(shape, index);
+		LLFanOut fan_out("parent lookup", 3);
+		timer.reset();
+		fan_out.run(ParentLookup::getSliceCount(), ParentLookup::lookupSlice, &parallel);
+		F64 parallel_time = timer.getElapsedTimeF64();
+
+		ensure_equals("root has no parent", (void*) serial.mFolderParents[0], (void*) NULL);
+		for (S32 i = 1; i < InventoryShape::FOLDER_COUNT; ++i)
+		{
+			ensure("folder parent found", serial.mFolderParents[i] != NULL);
+			ensure("same folder parent", serial.mFolderParents[i] == parallel.mFolderParents[i]);
+		}
+		for (S32 i = 0; i < InventoryShape::ITEM_COUNT; ++i)
+		{
+			ensure("item parent found", serial.mItemParents[i] == index.mChildItems[shape.mItemParents[i]]);
+			ensure("same item parent", serial.mItemParents[i] == parallel.mItemParents[i]);
+		}
+
+		LL_INFOS("UUIDHashMapBench") << InventoryShape::FOLDER_COUNT + InventoryShape::ITEM_COUNT
+			<< " parent lookups: calling thread " << serial_time * 1000.0 << " ms, 3 workers and the calling thread "
+			<< parallel_time * 1000.0 << " ms" << LL_ENDL;
+	}
+}
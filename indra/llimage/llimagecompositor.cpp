@@ -0,0 +1,419 @@
+/**
+ * @file llimagecompositor.cpp
+ * @brief LLImageCompositor class, blends images the way the GL texture
+ * bake does, on the CPU.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagecompositor.h"
+
+#include <emmintrin.h>
+
+#include "llmath.h"
+
+//---------------------------------------------------------------------------
+// Kernels
+//---------------------------------------------------------------------------
+
+// x / 255 rounded to nearest, for x up to 255 * 255
+static inline U32 div255(U32 x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline __m128i div255(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// each pixel's alpha in all four of its lanes
+static inline __m128i splat_alpha(__m128i x)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static void blend_pixel(U8* dst, const U8* src, const LLColor4U& color,
+						LLImageCompositor::EBlend blend, U32 write_mask, U8 min_alpha)
+{
+	U32 s[4];
+	for (S32 c = 0; c < 4; ++c)
+	{
+		s[c] = div255(src[c] * color.mV[c]);
+	}
+	if (s[3] < min_alpha)
+	{
+		return;
+	}
+
+	U8 result[4];
+	const U32 sa = s[3];
+	const U32 da = dst[3];
+	for (S32 c = 0; c < 4; ++c)
+	{
+		const U32 d = dst[c];
+		U32 r;
+		switch (blend)
+		{
+		case LLImageCompositor::BLEND_REPLACE:
+			r = s[c];
+			break;
+		case LLImageCompositor::BLEND_ALPHA:
+			r = div255(s[c] * sa + d * (255 - sa));
+			break;
+		case LLImageCompositor::BLEND_ADD:
+			r = llmin(s[c] + d, (U32) 255);
+			break;
+		case LLImageCompositor::BLEND_MULT_DEST_ALPHA:
+			r = div255(s[c] * da);
+			break;
+		case LLImageCompositor::BLEND_DEST_ALPHA:
+		default:
+			r = div255(s[c] * da + d * (255 - da));
+			break;
+		}
+		result[c] = (U8) r;
+	}
+
+	U32 out;
+	U32 in;
+	memcpy(&out, result, 4);
+	memcpy(&in, dst, 4);
+	out = (out & write_mask) | (in & ~write_mask);
+	memcpy(dst, &out, 4);
+}
+
+// two pixels' worth of 16 bit lanes
+template <S32 BLEND>
+static inline __m128i blend_lanes(__m128i s, __m128i d)
+{
+	const __m128i c255 = _mm_set1_epi16(255);
+	switch (BLEND)
+	{
+	case LLImageCompositor::BLEND_REPLACE:
+		return s;
+	case LLImageCompositor::BLEND_ALPHA:
+		{
+			__m128i sa = splat_alpha(s);
+			return div255(_mm_add_epi16(_mm_mullo_epi16(s, sa), _mm_mullo_epi16(d, _mm_sub_epi16(c255, sa))));
+		}
+	case LLImageCompositor::BLEND_ADD:
+		// saturates when packed
+		return _mm_add_epi16(s, d);
+	case LLImageCompositor::BLEND_MULT_DEST_ALPHA:
+		return div255(_mm_mullo_epi16(s, splat_alpha(d)));
+	case LLImageCompositor::BLEND_DEST_ALPHA:
+	default:
+		{
+			__m128i da = splat_alpha(d);
+			return div255(_mm_add_epi16(_mm_mullo_epi16(s, da), _mm_mullo_epi16(d, _mm_sub_epi16(c255, da))));
+		}
+	}
+}
+
+template <S32 BLEND>
+static S32 blend_row_sse2(U8* dst, const U8* src, S32 count, const LLColor4U& color,
+						  U32 write_mask, U8 min_alpha)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i tint = _mm_set_epi16(color.mV[3], color.mV[2], color.mV[1], color.mV[0],
+									   color.mV[3], color.mV[2], color.mV[1], color.mV[0]);
+	const __m128i min = _mm_set1_epi16(min_alpha);
+	const __m128i mask = _mm_set1_epi32(write_mask);
+
+	S32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s8 = _mm_loadu_si128((const __m128i*) (src + i * 4));
+		__m128i d8 = _mm_loadu_si128((const __m128i*) (dst + i * 4));
+
+		__m128i s_lo = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(s8, zero), tint));
+		__m128i s_hi = div255(_mm_mullo_epi16(_mm_unpackhi_epi8(s8, zero), tint));
+		__m128i d_lo = _mm_unpacklo_epi8(d8, zero);
+		__m128i d_hi = _mm_unpackhi_epi8(d8, zero);
+
+		__m128i r8 = _mm_packus_epi16(blend_lanes<BLEND>(s_lo, d_lo), blend_lanes<BLEND>(s_hi, d_hi));
+		__m128i dropped = _mm_packs_epi16(_mm_cmplt_epi16(splat_alpha(s_lo), min),
+										  _mm_cmplt_epi16(splat_alpha(s_hi), min));
+		__m128i write = _mm_andnot_si128(dropped, mask);
+		_mm_storeu_si128((__m128i*) (dst + i * 4),
+						 _mm_or_si128(_mm_and_si128(write, r8), _mm_andnot_si128(write, d8)));
+	}
+	return i;
+}
+
+// static
+void LLImageCompositor::blendRow(U8* dst, const U8* src, S32 count, const LLColor4U& color,
+								 EBlend blend, U32 write_mask, U8 min_alpha)
+{
+	S32 done;
+	switch (blend)
+	{
+	case BLEND_REPLACE:
+		done = blend_row_sse2<BLEND_REPLACE>(dst, src, count, color, write_mask, min_alpha);
+		break;
+	case BLEND_ALPHA:
+		done = blend_row_sse2<BLEND_ALPHA>(dst, src, count, color, write_mask, min_alpha);
+		break;
+	case BLEND_ADD:
+		done = blend_row_sse2<BLEND_ADD>(dst, src, count, color, write_mask, min_alpha);
+		break;
+	case BLEND_MULT_DEST_ALPHA:
+		done = blend_row_sse2<BLEND_MULT_DEST_ALPHA>(dst, src, count, color, write_mask, min_alpha);
+		break;
+	case BLEND_DEST_ALPHA:
+	default:
+		done = blend_row_sse2<BLEND_DEST_ALPHA>(dst, src, count, color, write_mask, min_alpha);
+		break;
+	}
+
+	for (S32 i = done; i < count; ++i)
+	{
+		blend_pixel(dst + i * 4, src + i * 4, color, blend, write_mask, min_alpha);
+	}
+}
+
+//---------------------------------------------------------------------------
+// LLImageCompositor
+//---------------------------------------------------------------------------
+
+LLImageCompositor::LLImageCompositor(S32 width, S32 height)
+:	mWidth(llmax(width, 0)),
+	mHeight(llmax(height, 0)),
+	mBlend(BLEND_ALPHA),
+	mWriteMask(0xffffffff),
+	mMinAlpha(0)
+{
+}
+
+void LLImageCompositor::setColorMask(bool color, bool alpha)
+{
+	U8 mask[4];
+	mask[0] = mask[1] = mask[2] = color ? 0xff : 0;
+	mask[3] = alpha ? 0xff : 0;
+	memcpy(&mWriteMask, mask, 4);
+}
+
+void LLImageCompositor::setBlend(EBlend blend)
+{
+	mBlend = blend;
+}
+
+void LLImageCompositor::setMinimumAlpha(F32 alpha)
+{
+	// GL drops alpha / 255 < min
+	mMinAlpha = (U8) llclamp(ll_round(ceilf(alpha * 255.f - 0.0001f)), 0, 255);
+}
+
+LLImageCompositor::Command& LLImageCompositor::addCommand(Command::EType type)
+{
+	mCommands.push_back(Command());
+	Command& command = mCommands.back();
+	command.mType = type;
+	command.mBlend = mBlend;
+	command.mWriteMask = mWriteMask;
+	command.mMinAlpha = mMinAlpha;
+	command.mColor.setToWhite();
+	command.mData = NULL;
+	command.mWidth = 0;
+	command.mHeight = 0;
+	command.mComponents = 0;
+	command.mCapture = -1;
+	return command;
+}
+
+void LLImageCompositor::fill(const LLColor4U& color)
+{
+	addCommand(Command::FILL).mColor = color;
+}
+
+void LLImageCompositor::draw(const U8* data, S32 width, S32 height, S32 components, const LLColor4U& color)
+{
+	if (!data || width <= 0 || height <= 0 || components < 1 || components > 4)
+	{
+		LL_WARNS() << "Skipping a " << width << "x" << height << "x" << components << " image" << LL_ENDL;
+		return;
+	}
+	Command& command = addCommand(Command::DRAW);
+	command.mColor = color;
+	command.mData = data;
+	command.mWidth = width;
+	command.mHeight = height;
+	command.mComponents = components;
+}
+
+S32 LLImageCompositor::captureAlpha()
+{
+	S32 index = mCaptures.size();
+	mCaptures.push_back(std::vector<U8>());
+	addCommand(Command::CAPTURE).mCapture = index;
+	return index;
+}
+
+const U8* LLImageCompositor::getCapturedAlpha(S32 index) const
+{
+	if (index < 0 || index >= (S32) mCaptures.size() || mCaptures[index].empty())
+	{
+		return NULL;
+	}
+	return &mCaptures[index][0];
+}
+
+// a source pixel as RGBA
+static inline void fetch_pixel(const U8* row, S32 x, S32 components, U8* out)
+{
+	const U8* p = row + x * components;
+	switch (components)
+	{
+	case 1:
+		out[0] = out[1] = out[2] = 0;
+		out[3] = p[0];
+		break;
+	case 2:
+		out[0] = out[1] = out[2] = p[0];
+		out[3] = p[1];
+		break;
+	case 3:
+		out[0] = p[0];
+		out[1] = p[1];
+		out[2] = p[2];
+		out[3] = 255;
+		break;
+	default:
+		memcpy(out, p, 4);
+		break;
+	}
+}
+
+// source coordinate of a target pixel's center, in 8.8 fixed point
+static inline S32 source_coord(S32 i, S32 target_size, S32 source_size)
+{
+	F32 coord = ((F32) i + 0.5f) * (F32) source_size / (F32) target_size - 0.5f;
+	return ll_round(llclamp(coord, 0.f, (F32) (source_size - 1)) * 256.f);
+}
+
+void LLImageCompositor::expandRow(const Command& command, S32 y, U8* out) const
+{
+	const S32 components = command.mComponents;
+	const S32 stride = command.mWidth * components;
+
+	if (command.mWidth == mWidth && command.mHeight == mHeight)
+	{
+		const U8* row = command.mData + y * stride;
+		if (components == 4)
+		{
+			memcpy(out, row, mWidth * 4);
+			return;
+		}
+		for (S32 x = 0; x < mWidth; ++x)
+		{
+			fetch_pixel(row, x, components, out + x * 4);
+		}
+		return;
+	}
+
+	// stretched, bilinear like the GL texture
+	S32 sy = source_coord(y, mHeight, command.mHeight);
+	S32 y0 = sy >> 8;
+	S32 y1 = llmin(y0 + 1, command.mHeight - 1);
+	U32 fy = sy & 0xff;
+	const U8* row0 = command.mData + y0 * stride;
+	const U8* row1 = command.mData + y1 * stride;
+
+	for (S32 x = 0; x < mWidth; ++x)
+	{
+		S32 sx = source_coord(x, mWidth, command.mWidth);
+		S32 x0 = sx >> 8;
+		S32 x1 = llmin(x0 + 1, command.mWidth - 1);
+		U32 fx = sx & 0xff;
+
+		U8 p00[4], p01[4], p10[4], p11[4];
+		fetch_pixel(row0, x0, components, p00);
+		fetch_pixel(row0, x1, components, p01);
+		fetch_pixel(row1, x0, components, p10);
+		fetch_pixel(row1, x1, components, p11);
+		for (S32 c = 0; c < 4; ++c)
+		{
+			U32 top = p00[c] * (256 - fx) + p01[c] * fx;
+			U32 bottom = p10[c] * (256 - fx) + p11[c] * fx;
+			out[x * 4 + c] = (U8) ((top * (256 - fy) + bottom * fy + 32768) >> 16);
+		}
+	}
+}
+
+void LLImageCompositor::render(U8* target)
+{
+	if (!target || !mWidth || !mHeight)
+	{
+		return;
+	}
+
+	const S32 row_size = mWidth * 4;
+	mRow.resize(row_size);
+	U8* row = &mRow[0];
+
+	for (U32 i = 0; i < mCommands.size(); ++i)
+	{
+		const Command& command = mCommands[i];
+		switch (command.mType)
+		{
+		case Command::FILL:
+			{
+				for (S32 x = 0; x < mWidth; ++x)
+				{
+					memcpy(row + x * 4, command.mColor.mV, 4);
+				}
+				const LLColor4U white(255, 255, 255, 255);
+				for (S32 y = 0; y < mHeight; ++y)
+				{
+					blendRow(target + y * row_size, row, mWidth, white,
+							 command.mBlend, command.mWriteMask, command.mMinAlpha);
+				}
+			}
+			break;
+
+		case Command::DRAW:
+			for (S32 y = 0; y < mHeight; ++y)
+			{
+				expandRow(command, y, row);
+				blendRow(target + y * row_size, row, mWidth, command.mColor,
+						 command.mBlend, command.mWriteMask, command.mMinAlpha);
+			}
+			break;
+
+		case Command::CAPTURE:
+			{
+				std::vector<U8>& capture = mCaptures[command.mCapture];
+				capture.resize(mWidth * mHeight);
+				for (S32 p = 0; p < mWidth * mHeight; ++p)
+				{
+					capture[p] = target[p * 4 + 3];
+				}
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,128 @@
+/**
+ * @file llimagecompositor.h
+ * @brief LLImageCompositor class, blends images the way the GL texture
+ * bake does, on the CPU.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGECOMPOSITOR_H
+#define LL_LLIMAGECOMPOSITOR_H
+
+#include <vector>
+
+#include "v4coloru.h"
+
+// Stands in for the little of GL that compositing avatar bakes uses: an
+// RGBA target, a color mask, a blend function and the alpha mask shader's
+// minimum alpha, drawing rectangles over the whole target that are either
+// a flat color or a texture stretched over it and tinted.
+//
+// Drawing is recorded, with the state at the time, and played back into a
+// target by render(), which touches nothing but the compositor, its
+// target and the source images, so it can run on any thread.  Like a GL
+// framebuffer the target's rows go bottom up, and the results come out in
+// 8 bits per channel, rounded the way GL rounds them.
+class LLImageCompositor
+{
+public:
+	typedef enum e_blend
+	{
+		BLEND_REPLACE = 0,		// src
+		BLEND_ALPHA,			// src * src_alpha + dst * (1 - src_alpha)
+		BLEND_ADD,				// src + dst
+		BLEND_MULT_DEST_ALPHA,	// src * dst_alpha
+		BLEND_DEST_ALPHA,		// src * dst_alpha + dst * (1 - dst_alpha)
+		NUM_BLENDS
+	} EBlend;
+
+	LLImageCompositor(S32 width, S32 height);
+
+	S32 getWidth() const						{ return mWidth; }
+	S32 getHeight() const						{ return mHeight; }
+
+	// State for the draws after it.  Starts out writing every channel,
+	// alpha blended, dropping nothing.
+	void setColorMask(bool color, bool alpha);
+	void setBlend(EBlend blend);
+	// drops source pixels with less alpha than this
+	void setMinimumAlpha(F32 alpha);
+
+	void fill(const LLColor4U& color);
+	// Single channel sources are alpha, two channel ones luminance and
+	// alpha.  The caller keeps the data until render() is done with it.
+	void draw(const U8* data, S32 width, S32 height, S32 components, const LLColor4U& color);
+	// keeps a copy of the target's alpha at this point, returns its index
+	// for getCapturedAlpha()
+	S32 captureAlpha();
+
+	// Plays back what was recorded into target, getWidth() * getHeight()
+	// RGBA pixels.
+	void render(U8* target);
+
+	S32 getNumCaptures() const					{ return mCaptures.size(); }
+	const U8* getCapturedAlpha(S32 index) const;
+
+	// Blends count RGBA src pixels, tinted by color, over dst with the
+	// given blend.  write_mask has the bits of the channels to write, as
+	// one RGBA pixel read as a U32.  Source pixels with less alpha than
+	// min_alpha, after the tint, leave dst alone.
+	static void blendRow(U8* dst, const U8* src, S32 count, const LLColor4U& color,
+						 EBlend blend, U32 write_mask, U8 min_alpha);
+
+private:
+	struct Command
+	{
+		enum EType
+		{
+			FILL,
+			DRAW,
+			CAPTURE
+		};
+
+		EType		mType;
+		EBlend		mBlend;
+		U32			mWriteMask;
+		U8			mMinAlpha;
+		LLColor4U	mColor;
+		const U8*	mData;
+		S32			mWidth;
+		S32			mHeight;
+		S32			mComponents;
+		S32			mCapture;
+	};
+
+	Command& addCommand(Command::EType type);
+	// one row of a source as RGBA, stretched to the target's width
+	void expandRow(const Command& command, S32 y, U8* out) const;
+
+	S32					mWidth;
+	S32					mHeight;
+	EBlend				mBlend;
+	U32					mWriteMask;
+	U8					mMinAlpha;
+	std::vector<Command>	mCommands;
+	std::vector<std::vector<U8> >	mCaptures;
+	std::vector<U8>		mRow;
+};
+
+#endif // LL_LLIMAGECOMPOSITOR_H
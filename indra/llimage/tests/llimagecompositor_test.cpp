@@ -0,0 +1,254 @@
+/**
+ * @file llimagecompositor_test.cpp
+ * @brief LLImageCompositor tests, against GL's blend equations.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagecompositor.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	U8 to_byte(F64 value)
+	{
+		return (U8) llclamp((S32) floor(value * 255.0 + 0.5), 0, 255);
+	}
+
+	// one pixel the way GL blends it, in floats
+	void reference_blend(U8* dst, const U8* src, const LLColor4U& color,
+						 LLImageCompositor::EBlend blend, bool color_mask, bool alpha_mask, U8 min_alpha)
+	{
+		F64 s[4];
+		F64 d[4];
+		for (S32 c = 0; c < 4; ++c)
+		{
+			// the texture times the vertex color, into 8 bits
+			s[c] = to_byte((src[c] / 255.0) * (color.mV[c] / 255.0)) / 255.0;
+			d[c] = dst[c] / 255.0;
+		}
+		if (s[3] * 255.0 < min_alpha - 0.5)
+		{
+			return;
+		}
+		for (S32 c = 0; c < 4; ++c)
+		{
+			if ((c < 3 && !color_mask) || (c == 3 && !alpha_mask))
+			{
+				continue;
+			}
+			F64 r;
+			switch (blend)
+			{
+			case LLImageCompositor::BLEND_REPLACE:
+				r = s[c];
+				break;
+			case LLImageCompositor::BLEND_ALPHA:
+				r = s[c] * s[3] + d[c] * (1.0 - s[3]);
+				break;
+			case LLImageCompositor::BLEND_ADD:
+				r = s[c] + d[c];
+				break;
+			case LLImageCompositor::BLEND_MULT_DEST_ALPHA:
+				r = s[c] * d[3];
+				break;
+			default:
+				r = s[c] * d[3] + d[c] * (1.0 - d[3]);
+				break;
+			}
+			dst[c] = to_byte(r);
+		}
+	}
+
+	U32 write_mask(bool color_mask, bool alpha_mask)
+	{
+		U8 mask[4] = { 0, 0, 0, 0 };
+		if (color_mask)
+		{
+			mask[0] = mask[1] = mask[2] = 0xff;
+		}
+		if (alpha_mask)
+		{
+			mask[3] = 0xff;
+		}
+		U32 result;
+		memcpy(&result, mask, 4);
+		return result;
+	}
+
+	U8 random_byte(U32& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return (U8) (seed >> 24);
+	}
+}
+
+namespace tut
+{
+	struct compositor_test
+	{
+	};
+	typedef test_group<compositor_test> compositor_t;
+	typedef compositor_t::object compositor_object_t;
+	tut::compositor_t tut_compositor("LLImageCompositor");
+
+	// blendRow() matches GL for every blend, mask and row length, in the
+	// vector loop and the tail
+	template<> template<>
+	void compositor_object_t::test<1>()
+	{
+		U32 seed = 1234;
+		const S32 MAX_COUNT = 23;
+		U8 src[MAX_COUNT * 4];
+		U8 dst[MAX_COUNT * 4];
+		U8 expected[MAX_COUNT * 4];
+
+		for (S32 blend = 0; blend < LLImageCompositor::NUM_BLENDS; ++blend)
+		{
+			for (S32 mask = 1; mask < 4; ++mask)
+			{
+				bool color_mask = mask & 1;
+				bool alpha_mask = mask & 2;
+				for (S32 count = 1; count <= MAX_COUNT; ++count)
+				{
+					for (S32 i = 0; i < count * 4; ++i)
+					{
+						src[i] = random_byte(seed);
+						dst[i] = random_byte(seed);
+					}
+					// now and then the extremes
+					if (count % 5 == 0)
+					{
+						src[3] = 0;
+						src[7] = 255;
+						dst[3] = 255;
+						dst[7] = 0;
+					}
+					LLColor4U color(random_byte(seed), random_byte(seed), random_byte(seed), random_byte(seed));
+					if (count % 3 == 0)
+					{
+						color.setToWhite();
+					}
+					U8 min_alpha = (count % 4 == 0) ? 2 : 0;
+
+					memcpy(expected, dst, count * 4);
+					for (S32 i = 0; i < count; ++i)
+					{
+						reference_blend(expected + i * 4, src + i * 4, color, (LLImageCompositor::EBlend) blend,
+										color_mask, alpha_mask, min_alpha);
+					}
+					LLImageCompositor::blendRow(dst, src, count, color, (LLImageCompositor::EBlend) blend,
+												write_mask(color_mask, alpha_mask), min_alpha);
+
+					for (S32 i = 0; i < count * 4; ++i)
+					{
+						ensure_equals(llformat("blend %d mask %d count %d byte %d", blend, mask, count, i),
+									  (S32) dst[i], (S32) expected[i]);
+					}
+				}
+			}
+		}
+	}
+
+	// A layer the way LLTexLayer::render() composites one with an alpha
+	// mask: the mask into alpha only, then the texture blended by it.
+	template<> template<>
+	void compositor_object_t::test<2>()
+	{
+		const S32 W = 8;
+		const S32 H = 4;
+		LLImageCompositor compositor(W, H);
+
+		U8 mask[W * H];
+		U8 texture[W * H * 3];
+		for (S32 i = 0; i < W * H; ++i)
+		{
+			mask[i] = (U8) (i * 8);
+			texture[i * 3] = 200;
+			texture[i * 3 + 1] = 100;
+			texture[i * 3 + 2] = 50;
+		}
+
+		compositor.setBlend(LLImageCompositor::BLEND_REPLACE);
+		compositor.fill(LLColor4U(10, 20, 30, 255));
+		compositor.setColorMask(false, true);
+		compositor.fill(LLColor4U(0, 0, 0, 0));
+		compositor.setBlend(LLImageCompositor::BLEND_ADD);
+		compositor.draw(mask, W, H, 1, LLColor4U::white);
+		S32 capture = compositor.captureAlpha();
+		compositor.setColorMask(true, true);
+		compositor.setBlend(LLImageCompositor::BLEND_DEST_ALPHA);
+		compositor.draw(texture, W, H, 3, LLColor4U::white);
+
+		std::vector<U8> target(W * H * 4, 0x55);
+		compositor.render(&target[0]);
+
+		const U8* alpha = compositor.getCapturedAlpha(capture);
+		ensure("captured", alpha != NULL);
+		for (S32 i = 0; i < W * H; ++i)
+		{
+			ensure_equals("captured mask", (S32) alpha[i], (S32) mask[i]);
+
+			U8 expected[4] = { 10, 20, 30, mask[i] };
+			U8 src[4] = { 200, 100, 50, 255 };
+			reference_blend(expected, src, LLColor4U::white, LLImageCompositor::BLEND_DEST_ALPHA, true, true, 0);
+			for (S32 c = 0; c < 4; ++c)
+			{
+				ensure_equals("layer", (S32) target[i * 4 + c], (S32) expected[c]);
+			}
+		}
+	}
+
+	// stretched sources land on the same values at matching texels, and
+	// the minimum alpha drops what GL's alpha test would
+	template<> template<>
+	void compositor_object_t::test<3>()
+	{
+		const U8 source[2 * 2 * 4] =
+		{
+			255, 0, 0, 255,		0, 255, 0, 255,
+			0, 0, 255, 255,		255, 255, 255, 1
+		};
+
+		LLImageCompositor compositor(4, 4);
+		compositor.setBlend(LLImageCompositor::BLEND_REPLACE);
+		compositor.fill(LLColor4U(1, 2, 3, 4));
+		compositor.setMinimumAlpha(0.004f);
+		compositor.draw(source, 2, 2, 4, LLColor4U::white);
+
+		std::vector<U8> target(4 * 4 * 4, 0);
+		compositor.render(&target[0]);
+
+		// corners take their texel as is, bottom row first
+		ensure_equals("bottom left", (S32) target[0], 255);
+		ensure_equals("bottom right", (S32) target[(3) * 4 + 1], 255);
+		ensure_equals("top left", (S32) target[(3 * 4) * 4 + 2], 255);
+		// alpha 1 / 255 is under the minimum, the fill stays
+		ensure_equals("dropped", (S32) target[(3 * 4 + 3) * 4], 1);
+		ensure_equals("dropped alpha", (S32) target[(3 * 4 + 3) * 4 + 3], 4);
+		// halfway between red and green
+		ensure("blended", target[1 * 4] > 100 && target[1 * 4] < 255 && target[1 * 4 + 1] > 0);
+	}
+}
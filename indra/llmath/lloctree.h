@@ -27,18 +27,10 @@
 #ifndef LL_LLOCTREE_H
 #define LL_LLOCTREE_H
 
-#define LL_OCTREE_POOLS 0
-
 #include "lltreenode.h"
 #include "v3math.h"
 #include "llvector4a.h"
 #include <vector>
-#if LL_OCTREE_POOLS
-#include "fix_macros.h"
-#define TBB_PREVIEW_MEMORY_POOL 1
-#include <tbb/memory_pool.h>
-#include <boost/align.hpp>
-#endif
 
 #define OCT_ERRS LL_WARNS("OctreeErrors")
 
@@ -54,6 +46,7 @@ extern float gOctreeMinSize;
 #endif*/
 
 template <class T> class LLOctreeNode;
+template <class T> class LLOctreePool;
 
 template <class T>
 class LLOctreeListener: public LLTreeListener<T>
@@ -103,38 +96,38 @@ public:
 	typedef LLOctreeNode<T>		oct_node;
 	typedef LLOctreeListener<T>	oct_listener;
 
-#if LL_OCTREE_POOLS
-	static tbb::memory_pool< boost::alignment::aligned_allocator<LLOctreeNode<T>, 16> >& getPool()
-	{
-		static tbb::memory_pool< boost::alignment::aligned_allocator<LLOctreeNode<T>, 16> > my_pool;
-		return my_pool;
-	}
+	typedef LLOctreePool<T>		oct_pool;
+
+	// Nodes created without a pool (the root, volume octrees) come straight
+	// off the heap.  Either way every node is preceded by a header that tells
+	// operator delete where the memory came from, see LLOctreePool.
 	void* operator new(size_t size)
 	{
-		return getPool().malloc(size);
+		return oct_pool::allocateUnpooled(size);
 	}
-	void operator delete(void* ptr)
+
+	void* operator new(size_t size, void* mem)
 	{
-		getPool().free(ptr);
+		return mem;
 	}
-#else
-	void* operator new(size_t size)
+
+	void operator delete(void* ptr)
 	{
-		return ll_aligned_malloc_16(size);
+		oct_pool::release(ptr);
 	}
 
-	void operator delete(void* ptr)
+	void operator delete(void* ptr, void* mem)
 	{
-		ll_aligned_free_16(ptr);
+		oct_pool::release(ptr);
 	}
-#endif
 
 	LLOctreeNode(	const LLVector4a& center, 
 					const LLVector4a& size, 
 					BaseType* parent, 
 					U8 octant = 255)
 	:	mParent((oct_node*)parent), 
-		mOctant(octant) 
+		mOctant(octant),
+		mPool(parent ? ((oct_node*) parent)->mPool : NULL)
 	{ 
 		llassert(size[0] >= gOctreeMinSize*0.5f);
 		//always keep a NULL terminated list to avoid out of bounds exceptions in debug builds
@@ -185,6 +178,8 @@ public:
 	inline U8 getOctant() const							{ return mOctant; }
 	inline const oct_node*	getOctParent() const		{ return (const oct_node*) getParent(); }
 	inline oct_node* getOctParent() 					{ return (oct_node*) getParent(); }
+	inline oct_pool* getPool() const					{ return mPool; }
+	inline void setPool(oct_pool* pool)					{ mPool = pool; }
 	
 	U8 getOctant(const LLVector4a& pos) const			//get the octant pos is in
 	{
@@ -423,7 +418,7 @@ public:
 
 				llassert(size[0] >= gOctreeMinSize*0.5f);
 				//make the new kid
-				child = new LLOctreeNode<T>(center, size, this);
+				child = createChild(center, size);
 				addChild(child);
 								
 				child->insert(data);
@@ -541,6 +536,19 @@ public:
 		}
 	}
 
+	//allocate a new child node centered at center, taking it from this node's
+	//pool (next to its siblings, or to us for the first child) when there is one
+	oct_node* createChild(const LLVector4a& center, const LLVector4a& size)
+	{
+		U8 octant = getOctant(center);
+		if (mPool)
+		{
+			void* mem = mPool->allocate(mChildCount > 0 ? mChild[0] : this);
+			return new(mem) LLOctreeNode<T>(center, size, this, octant);
+		}
+		return new LLOctreeNode<T>(center, size, this, octant);
+	}
+
 	void clearChildren()
 	{
 		mChildCount = 0;
@@ -693,6 +701,7 @@ protected:
 	
 	oct_node* mParent;
 	U8 mOctant;
+	oct_pool* mPool;
 
 	LLOctreeNode<T>* mChild[8];
 	U8 mChildMap[8];
@@ -719,26 +728,6 @@ public:
 	{
 	}
 
-#if LL_OCTREE_POOLS
-	void* operator new(size_t size)
-	{
-		return LLOctreeNode<T>::getPool().malloc(size);
-	}
-	void operator delete(void* ptr)
-	{
-		LLOctreeNode<T>::getPool().free(ptr);
-	}
-#else
-	void* operator new(size_t size)
-	{
-		return ll_aligned_malloc_16(size);
-	}
-	void operator delete(void* ptr)
-	{
-		ll_aligned_free_16(ptr);
-	}
-#endif
-	
 	bool balance()
 	{	
 		if (this->getChildCount() == 1 && 
@@ -852,7 +841,7 @@ public:
 				llassert(size[0] >= gOctreeMinSize);
 
 				//copy our children to a new branch
-				LLOctreeNode<T>* newnode = new LLOctreeNode<T>(center, size, this);
+				LLOctreeNode<T>* newnode = this->createChild(center, size);
 				
 				for (U32 i = 0; i < this->getChildCount(); i++)
 				{
@@ -873,6 +862,195 @@ public:
 	}
 };
 
+//========================
+//		LLOctreePool
+//========================
+
+// Slab allocator for the nodes of one octree (one per spatial partition).
+// Memory is handed out from "broods" of eight node slots, and a new node is
+// placed in the same brood as its siblings whenever there is room, so that
+// children -- which every traversal visits back to back -- share cache lines
+// instead of being scattered across the heap.  Broods are carved out of slabs
+// that double in size as the tree grows (so sparse partitions stay small) and
+// are recycled through a list of broods with free slots; slabs are only
+// returned to the system when the pool itself is destroyed.  Not thread safe,
+// like the octree.
+template <class T>
+class LLOctreePool
+{
+public:
+	typedef LLOctreeNode<T> oct_node;
+
+	enum
+	{
+		MIN_SLAB_BROODS = 8,
+		MAX_SLAB_BROODS = 512
+	};
+
+	LLOctreePool()
+	:	mOpenBroods(NULL),
+		mNextSlabBroods(MIN_SLAB_BROODS),
+		mBroodCount(0),
+		mNodeCount(0)
+	{
+	}
+
+	~LLOctreePool()
+	{
+		llassert(mNodeCount == 0);
+		for (U32 i = 0; i < mSlabs.size(); ++i)
+		{
+			ll_aligned_free_16(mSlabs[i]);
+		}
+	}
+
+	// memory for a new node, next to sibling if its brood has room
+	void* allocate(const oct_node* sibling)
+	{
+		Brood* brood = sibling ? getHeader(sibling)->mBrood : NULL;
+		if (!brood || brood->mPool != this || brood->mUsed == 0xFF)
+		{
+			brood = getOpenBrood();
+		}
+
+		U8 slot = 0;
+		while (brood->mUsed & (1 << slot))
+		{
+			++slot;
+		}
+
+		brood->mUsed |= (1 << slot);
+		++mNodeCount;
+
+		Header* header = (Header*) ((U8*) brood + BROOD_HEADER_SIZE + slot * getSlotSize());
+		header->mBrood = brood;
+		header->mSlot = slot;
+		return (U8*) header + NODE_HEADER_SIZE;
+	}
+
+	static void* allocateUnpooled(size_t size)
+	{
+		Header* header = (Header*) ll_aligned_malloc_16(size + NODE_HEADER_SIZE);
+		header->mBrood = NULL;
+		header->mSlot = 0;
+		return (U8*) header + NODE_HEADER_SIZE;
+	}
+
+	static void release(void* ptr)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+
+		Header* header = getHeader(ptr);
+		Brood* brood = header->mBrood;
+		if (!brood)
+		{
+			ll_aligned_free_16(header);
+			return;
+		}
+
+		LLOctreePool<T>* pool = brood->mPool;
+		llassert(brood->mUsed & (1 << header->mSlot));
+		brood->mUsed &= ~(1 << header->mSlot);
+		--pool->mNodeCount;
+
+		if (!brood->mOpen)
+		{
+			brood->mOpen = true;
+			brood->mNextOpen = pool->mOpenBroods;
+			pool->mOpenBroods = brood;
+		}
+	}
+
+	U32 getNodeCount() const			{ return mNodeCount; }
+	U32 getBroodCount() const			{ return mBroodCount; }
+	U32 getSlabCount() const			{ return mSlabs.size(); }
+	size_t getAllocatedBytes() const	{ return (size_t) mBroodCount * getBroodSize(); }
+
+private:
+	struct Brood
+	{
+		LLOctreePool<T>* mPool;
+		Brood* mNextOpen;
+		U8 mUsed; // bit per occupied slot
+		bool mOpen; // on the open list (may have filled up since)
+	};
+
+	struct Header
+	{
+		Brood* mBrood; // NULL for nodes allocated off the heap
+		U8 mSlot;
+	};
+
+	enum
+	{
+		BROOD_HEADER_SIZE = (sizeof(Brood) + 15) & ~15,
+		NODE_HEADER_SIZE = (sizeof(Header) + 15) & ~15
+	};
+
+	static Header* getHeader(const void* node)
+	{
+		return (Header*) ((U8*) node - NODE_HEADER_SIZE);
+	}
+
+	static size_t getSlotSize()
+	{
+		return NODE_HEADER_SIZE + ((sizeof(LLOctreeRoot<T>) + 15) & ~15);
+	}
+
+	static size_t getBroodSize()
+	{
+		return BROOD_HEADER_SIZE + 8 * getSlotSize();
+	}
+
+	Brood* getOpenBrood()
+	{
+		//broods that filled up through sibling allocation are dropped lazily
+		while (mOpenBroods && mOpenBroods->mUsed == 0xFF)
+		{
+			mOpenBroods->mOpen = false;
+			mOpenBroods = mOpenBroods->mNextOpen;
+		}
+
+		if (!mOpenBroods)
+		{
+			addSlab();
+		}
+
+		return mOpenBroods;
+	}
+
+	void addSlab()
+	{
+		const size_t brood_size = getBroodSize();
+		U8* slab = (U8*) ll_aligned_malloc_16(brood_size * mNextSlabBroods);
+		mSlabs.push_back(slab);
+		mBroodCount += mNextSlabBroods;
+
+		//thread broods onto the open list in address order so consecutive
+		//allocations walk forward through the slab
+		for (S32 i = mNextSlabBroods - 1; i >= 0; --i)
+		{
+			Brood* brood = (Brood*) (slab + i * brood_size);
+			brood->mPool = this;
+			brood->mUsed = 0;
+			brood->mOpen = true;
+			brood->mNextOpen = mOpenBroods;
+			mOpenBroods = brood;
+		}
+
+		mNextSlabBroods = llmin(mNextSlabBroods * 2, (U32) MAX_SLAB_BROODS);
+	}
+
+	std::vector<U8*> mSlabs;
+	Brood* mOpenBroods;
+	U32 mNextSlabBroods;
+	U32 mBroodCount;
+	U32 mNodeCount;
+};
+
 //========================
 //		LLOctreeTraveler
 //========================
@@ -45,6 +45,7 @@
 #include "llmatrix3a.h"
 #include "lloctree.h"
 #include "llvolume.h"
+#include "llvolumecache.h"
 #include "llvolumeoctree.h"
 #include "llstl.h"
 #include "llsdserialize.h"
@@ -698,7 +699,8 @@ LLProfile::Face* LLProfile::addHole(const LLProfileParams& params, BOOL flat, F3
 
 	Face *face = addFace(mTotalOut, mTotal-mTotalOut,0,LL_FACE_INNER_SIDE, flat);
 
-	static LLAlignedArray<LLVector4a,64> pt;
+	// not static, profiles are generated on volume worker threads
+	LLAlignedArray<LLVector4a,64> pt;
 	pt.resize(mTotal) ;
 
 	for (S32 i=mTotalOut;i<mTotal;i++)
@@ -2064,7 +2066,7 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+LLAtomicS32 LLVolume::sNumMeshPoints(0);
 
 LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
 	: mParams(params)
@@ -2099,7 +2101,11 @@ LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL ge
 	
 	if ((mParams.getSculptID().isNull() && mParams.getSculptType() == LL_SCULPT_TYPE_NONE) || mParams.getSculptType() == LL_SCULPT_TYPE_MESH)
 	{
-		createVolumeFaces();
+		if (!LLVolumeCache::loadFaces(this))
+		{
+			createVolumeFaces();
+			LLVolumeCache::storeFaces(this);
+		}
 	}
 }
 
@@ -2110,6 +2116,18 @@ void LLVolume::resizePath(S32 length)
 	setDirty();
 }
 
+void LLVolume::swapGeometry(LLVolume& other)
+{
+	llassert(mParams == other.mParams);
+	std::swap(mPathp, other.mPathp);
+	std::swap(mProfilep, other.mProfilep);
+	mMesh.swap(other.mMesh);
+	mVolumeFaces.swap(other.mVolumeFaces);
+	std::swap(mFaceMask, other.mFaceMask);
+	std::swap(mSculptLevel, other.mSculptLevel);
+	std::swap(mSurfaceArea, other.mSurfaceArea);
+}
+
 void LLVolume::regen()
 {
 	generate();
@@ -2412,7 +2430,22 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << LL_ENDL;
 		return false;
 	}
-	
+	return unpackVolumeFaces(mdl);
+}
+
+bool LLVolume::unpackVolumeFaces(const U8* in, S32 size)
+{
+	LLSD mdl;
+	if (!unzip_llsd(mdl, in, size))
+	{
+		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << LL_ENDL;
+		return false;
+	}
+	return unpackVolumeFaces(mdl);
+}
+
+bool LLVolume::unpackVolumeFaces(LLSD& mdl)
+{
 	{
 		U32 face_count = mdl.size();
 
@@ -3219,7 +3252,11 @@ void LLVolume::sculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
 	// Delete any existing faces so that they get regenerated
 	mVolumeFaces.clear();
 	
-	createVolumeFaces();
+	if (!LLVolumeCache::loadFaces(this))
+	{
+		createVolumeFaces();
+		LLVolumeCache::storeFaces(this);
+	}
 }
 
 
@@ -4942,399 +4979,227 @@ void LLVolumeFace::optimize(F32 angle_cutoff)
 
 }
 
-class LLVCacheTriangleData;
-
-class LLVCacheVertexData
+namespace
 {
-public:
-	S32 mIdx;
-	S32 mCacheTag;
-	F64 mScore;
-	U32 mActiveTriangles;
-	std::vector<LLVCacheTriangleData*> mTriangles;
+	// Forsyth's scoring constants, see
+	// http://home.comcast.net/~tom_forsyth/papers/fast_vert_cache_opt.html
+	const F32 VCACHE_DECAY_POWER = 1.5f;
+	const F32 VCACHE_LAST_TRI_SCORE = 0.75f;
+	const F32 VCACHE_VALENCE_BOOST_SCALE = 2.0f;
+	const F32 VCACHE_VALENCE_BOOST_POWER = 0.5f;
+	const S32 VCACHE_SIZE = 32;
+	const U32 VCACHE_MAX_TABLE_VALENCE = 64;
 
-	LLVCacheVertexData()
+	// vertex scores by cache position and remaining valence, so the inner
+	// loop of the optimizer never calls pow()
+	class LLVCacheScoreTable
 	{
-		mCacheTag = -1;
-		mScore = 0.0;
-		mActiveTriangles = 0;
-		mIdx = -1;
-	}
-};
-
-class LLVCacheTriangleData
-{
-public:
-	bool mActive;
-	F64 mScore;
-	LLVCacheVertexData* mVertex[3];
-
-	LLVCacheTriangleData()
-	{
-		mActive = true;
-		mScore = 0.0;
-		mVertex[0] = mVertex[1] = mVertex[2] = NULL;
-	}
-
-	void complete()
-	{
-		mActive = false;
-		for (S32 i = 0; i < 3; ++i)
+	public:
+		LLVCacheScoreTable()
 		{
-			if (mVertex[i])
+			for (S32 i = 0; i < VCACHE_SIZE; ++i)
 			{
-				llassert(mVertex[i]->mActiveTriangles > 0);
-				mVertex[i]->mActiveTriangles--;
+				if (i < 3)
+				{ //vertex was in the last triangle
+					mCacheScore[i] = VCACHE_LAST_TRI_SCORE;
+				}
+				else
+				{ //more points for being higher in the cache
+					F32 score = 1.f - (F32) (i - 3) / (F32) (VCACHE_SIZE - 3);
+					mCacheScore[i] = powf(score, VCACHE_DECAY_POWER);
+				}
 			}
-		}
-	}
-
-	bool operator<(const LLVCacheTriangleData& rhs) const
-	{ //highest score first
-		return rhs.mScore < mScore;
-	}
-};
 
-const F64 FindVertexScore_CacheDecayPower = 1.5;
-const F64 FindVertexScore_LastTriScore = 0.75;
-const F64 FindVertexScore_ValenceBoostScale = 2.0;
-const F64 FindVertexScore_ValenceBoostPower = 0.5;
-const U32 MaxSizeVertexCache = 32;
-const F64 FindVertexScore_Scaler = 1.0/(MaxSizeVertexCache-3);
-
-F64 find_vertex_score(LLVCacheVertexData& data)
-{
-	F64 score = -1.0;
-
-	score = 0.0;
-
-	S32 cache_idx = data.mCacheTag;
-
-	if (cache_idx < 0)
-	{
-		//not in cache
-	}
-	else
-	{
-		if (cache_idx < 3)
-		{ //vertex was in the last triangle
-			score = FindVertexScore_LastTriScore;
-		}
-		else
-		{ //more points for being higher in the cache
-				score = 1.0-((cache_idx-3)*FindVertexScore_Scaler);
-				score = pow(score, FindVertexScore_CacheDecayPower);
-		}
-	}
-
-	//bonus points for having low valence
-	F64 valence_boost = pow((F64)data.mActiveTriangles, -FindVertexScore_ValenceBoostPower);
-	score += FindVertexScore_ValenceBoostScale * valence_boost;
-
-	return score;
-}
-
-class LLVCacheFIFO
-{
-public:
-	LLVCacheVertexData* mCache[MaxSizeVertexCache];
-	U32 mMisses;
-
-	LLVCacheFIFO()
-	{
-		mMisses = 0;
-		for (U32 i = 0; i < MaxSizeVertexCache; ++i)
-		{
-			mCache[i] = NULL;
+			mValenceScore[0] = 0.f;
+			for (U32 i = 1; i < VCACHE_MAX_TABLE_VALENCE; ++i)
+			{ //bonus points for having low valence
+				mValenceScore[i] = VCACHE_VALENCE_BOOST_SCALE * powf((F32) i, -VCACHE_VALENCE_BOOST_POWER);
+			}
 		}
-	}
 
-	void addVertex(LLVCacheVertexData* data)
-	{
-		if (data->mCacheTag == -1)
+		F32 getScore(S32 cache_pos, U32 valence) const
 		{
-			mMisses++;
-
-			S32 end = MaxSizeVertexCache-1;
-
-			if (mCache[end])
-			{
-				mCache[end]->mCacheTag = -1;
+			if (valence == 0)
+			{ //no triangles left to draw
+				return -1.f;
 			}
 
-			for (S32 i = end; i > 0; --i)
+			F32 score = cache_pos < 0 ? 0.f : mCacheScore[cache_pos];
+			if (valence < VCACHE_MAX_TABLE_VALENCE)
 			{
-				mCache[i] = mCache[i-1];
-				if (mCache[i])
-				{
-					mCache[i]->mCacheTag = i;
-				}
+				return score + mValenceScore[valence];
 			}
-
-			mCache[0] = data;
-			data->mCacheTag = 0;
+			return score + VCACHE_VALENCE_BOOST_SCALE * powf((F32) valence, -VCACHE_VALENCE_BOOST_POWER);
 		}
-	}
-};
 
-class LLVCacheLRU
-{
-public:
-	LLVCacheVertexData* mCache[MaxSizeVertexCache+3];
+	private:
+		F32 mCacheScore[VCACHE_SIZE];
+		F32 mValenceScore[VCACHE_MAX_TABLE_VALENCE];
+	};
 
-	LLVCacheTriangleData* mBestTriangle;
-	
-	U32 mMisses;
+	const LLVCacheScoreTable sVCacheScores;
+}
 
-	LLVCacheLRU()
-	{
-		for (U32 i = 0; i < MaxSizeVertexCache+3; ++i)
-		{
-			mCache[i] = NULL;
-		}
+void LLVolumeFace::cacheOptimize()
+{ //optimize for vertex cache according to Forsyth method, linear time
+  //version working on flat arrays: only the triangles of vertices in
+  //the simulated cache are rescored after each triangle is emitted
+	
+	llassert(!mOptimized);
+	mOptimized = TRUE;
 
-		mBestTriangle = NULL;
-		mMisses = 0;
+	if (mNumVertices < 3 || mNumIndices < 3)
+	{ //nothing to do
+		return;
 	}
 
-	void addVertex(LLVCacheVertexData* data)
-	{
-		S32 end = MaxSizeVertexCache+2;
-		if (data->mCacheTag != -1)
-		{ //just moving a vertex to the front of the cache
-			end = data->mCacheTag;
-		}
-		else
-		{
-			mMisses++;
-			if (mCache[end])
-			{ //adding a new vertex, vertex at end of cache falls off
-				mCache[end]->mCacheTag = -1;
-			}
-		}
+	const U32 num_verts = mNumVertices;
+	const U32 num_tris = mNumIndices/3;
+	const U32 num_indices = num_tris*3;
 
-		for (S32 i = end; i > 0; --i)
-		{ //adjust cache pointers and tags
-			mCache[i] = mCache[i-1];
-
-			if (mCache[i])
-			{
-				mCache[i]->mCacheTag = i;			
-			}
-		}
-
-		mCache[0] = data;
-		mCache[0]->mCacheTag = 0;
+	//vertex -> triangle adjacency, the first mActive entries of each
+	//vertex's range are the triangles not emitted yet
+	std::vector<U32> tri_start(num_verts+1, 0);
+	for (U32 i = 0; i < num_indices; ++i)
+	{
+		tri_start[mIndices[i]+1]++;
+	}
+	for (U32 i = 0; i < num_verts; ++i)
+	{
+		tri_start[i+1] += tri_start[i];
 	}
 
-	void addTriangle(LLVCacheTriangleData* data)
+	std::vector<U32> vert_tris(num_indices);
+	std::vector<U32> active(num_verts, 0);
+	for (U32 i = 0; i < num_indices; ++i)
 	{
-		addVertex(data->mVertex[0]);
-		addVertex(data->mVertex[1]);
-		addVertex(data->mVertex[2]);
+		U16 idx = mIndices[i];
+		vert_tris[tri_start[idx] + active[idx]++] = i/3;
 	}
 
-	void updateScores()
+	std::vector<S32> cache_pos(num_verts, -1);
+	std::vector<F32> vert_score(num_verts);
+	for (U32 i = 0; i < num_verts; ++i)
 	{
-		LLVCacheVertexData** data_iter = mCache+MaxSizeVertexCache;
-		LLVCacheVertexData** end_data = mCache+MaxSizeVertexCache+3;
+		vert_score[i] = sVCacheScores.getScore(-1, active[i]);
+	}
 
-		while(data_iter != end_data)
+	std::vector<F32> tri_score(num_tris);
+	std::vector<U8> emitted(num_tris, 0);
+	S32 best_tri = 0;
+	for (U32 i = 0; i < num_tris; ++i)
+	{
+		const U16* idx = mIndices + i*3;
+		tri_score[i] = vert_score[idx[0]] + vert_score[idx[1]] + vert_score[idx[2]];
+		if (tri_score[i] > tri_score[best_tri])
 		{
-			LLVCacheVertexData* data = *data_iter++;
-			//trailing 3 vertices aren't actually in the cache for scoring purposes
-			if (data)
-			{
-				data->mCacheTag = -1;
-			}
+			best_tri = i;
 		}
+	}
 
-		data_iter = mCache;
-		end_data = mCache+MaxSizeVertexCache;
+	std::vector<U16> new_indices(num_indices);
+	S32 cache[VCACHE_SIZE+3];
+	S32 new_cache[VCACHE_SIZE+3];
+	S32 cache_count = 0;
+	U32 scan_cursor = 0;
 
-		while (data_iter != end_data)
-		{ //update scores of vertices in cache
-			LLVCacheVertexData* data = *data_iter++;
-			if (data)
+	for (U32 out = 0; out < num_tris; ++out)
+	{
+		if (best_tri < 0)
+		{ //cache went cold, continue with the next triangle in input order
+			while (emitted[scan_cursor])
 			{
-				data->mScore = find_vertex_score(*data);
+				scan_cursor++;
 			}
+			best_tri = scan_cursor;
 		}
 
-		mBestTriangle = NULL;
-		//update triangle scores
-		data_iter = mCache;
-		end_data = mCache+MaxSizeVertexCache+3;
+		const U16* tri = mIndices + best_tri*3;
+		emitted[best_tri] = 1;
+		new_indices[out*3+0] = tri[0];
+		new_indices[out*3+1] = tri[1];
+		new_indices[out*3+2] = tri[2];
 
-		while (data_iter != end_data)
-		{
-			LLVCacheVertexData* data = *data_iter++;
-			if (data)
+		for (U32 j = 0; j < 3; ++j)
+		{ //remove triangle from its vertices' active lists
+			U16 v = tri[j];
+			U32* list = &vert_tris[tri_start[v]];
+			U32 count = active[v];
+			for (U32 k = 0; k < count; ++k)
 			{
-				for (std::vector<LLVCacheTriangleData*>::iterator iter = data->mTriangles.begin(), end_iter = data->mTriangles.end(); iter != end_iter; ++iter)
+				if (list[k] == (U32) best_tri)
 				{
-					LLVCacheTriangleData* tri = *iter;
-					if (tri->mActive)
-					{
-						tri->mScore = tri->mVertex[0]->mScore;
-						tri->mScore += tri->mVertex[1]->mScore;
-						tri->mScore += tri->mVertex[2]->mScore;
-
-						if (!mBestTriangle || mBestTriangle->mScore < tri->mScore)
-						{
-							mBestTriangle = tri;
-						}
-					}
+					list[k] = list[count-1];
+					list[count-1] = best_tri;
+					active[v]--;
+					break;
 				}
 			}
 		}
 
-		//knock trailing 3 vertices off the cache
-		data_iter = mCache+MaxSizeVertexCache;
-		end_data = mCache+MaxSizeVertexCache+3;
-		while (data_iter != end_data)
+		//LRU update: triangle's vertices go to the front
+		S32 new_count = 0;
+		for (U32 j = 0; j < 3; ++j)
 		{
-			LLVCacheVertexData* data = *data_iter;
-			if (data)
+			S32 v = tri[j];
+			if (cache_pos[v] != -2)
 			{
-				llassert(data->mCacheTag == -1);
-				*data_iter = NULL;
+				new_cache[new_count++] = v;
+				cache_pos[v] = -2; // mark as placed
 			}
-			++data_iter;
 		}
-	}
-};
-
-
-void LLVolumeFace::cacheOptimize()
-{ //optimize for vertex cache according to Forsyth method: 
-  // http://home.comcast.net/~tom_forsyth/papers/fast_vert_cache_opt.html
-	
-	llassert(!mOptimized);
-	mOptimized = TRUE;
-
-	LLVCacheLRU cache;
-	
-	if (mNumVertices < 3)
-	{ //nothing to do
-		return;
-	}
-
-	//mapping of vertices to triangles and indices
-	std::vector<LLVCacheVertexData> vertex_data;
-
-	//mapping of triangles do vertices
-	std::vector<LLVCacheTriangleData> triangle_data;
-
-	triangle_data.resize(mNumIndices/3);
-	vertex_data.resize(mNumVertices);
-
-	for (U32 i = 0; i < mNumIndices; i++)
-	{ //populate vertex data and triangle data arrays
-		U16 idx = mIndices[i];
-		U32 tri_idx = i/3;
-
-		vertex_data[idx].mTriangles.push_back(&(triangle_data[tri_idx]));
-		vertex_data[idx].mIdx = idx;
-		triangle_data[tri_idx].mVertex[i%3] = &(vertex_data[idx]);
-	}
-
-	/*F32 pre_acmr = 1.f;
-	//measure cache misses from before rebuild
-	{
-		LLVCacheFIFO test_cache;
-		for (U32 i = 0; i < mNumIndices; ++i)
+		for (S32 j = 0; j < cache_count; ++j)
 		{
-			test_cache.addVertex(&vertex_data[mIndices[i]]);
+			S32 v = cache[j];
+			if (cache_pos[v] != -2)
+			{
+				new_cache[new_count++] = v;
+				cache_pos[v] = -2;
+			}
 		}
 
-		for (U32 i = 0; i < mNumVertices; i++)
+		//rescore everything that moved, including the vertices that fell off
+		best_tri = -1;
+		F32 best_score = -1.f;
+		for (S32 j = 0; j < new_count; ++j)
 		{
-			vertex_data[i].mCacheTag = -1;
-		}
+			S32 v = new_cache[j];
+			S32 pos = j < VCACHE_SIZE ? j : -1;
+			cache_pos[v] = pos;
 
-		pre_acmr = (F32) test_cache.mMisses/(mNumIndices/3);
-	}*/
+			F32 score = sVCacheScores.getScore(pos, active[v]);
+			F32 delta = score - vert_score[v];
+			vert_score[v] = score;
 
-	for (U32 i = 0; i < mNumVertices; i++)
-	{ //initialize score values (no cache -- might try a fifo cache here)
-		LLVCacheVertexData& data = vertex_data[i];
-
-		data.mScore = find_vertex_score(data);
-		data.mActiveTriangles = data.mTriangles.size();
-
-		for (U32 j = 0; j < data.mActiveTriangles; ++j)
-		{
-			data.mTriangles[j]->mScore += data.mScore;
+			const U32* list = &vert_tris[tri_start[v]];
+			for (U32 k = 0; k < active[v]; ++k)
+			{
+				tri_score[list[k]] += delta;
+			}
 		}
-	}
-
-	//sort triangle data by score
-	std::sort(triangle_data.begin(), triangle_data.end());
-
-	std::vector<U16> new_indices;
 
-	LLVCacheTriangleData* tri;
-
-	//prime pump by adding first triangle to cache;
-	tri = &(triangle_data[0]);
-	cache.addTriangle(tri);
-	new_indices.push_back(tri->mVertex[0]->mIdx);
-	new_indices.push_back(tri->mVertex[1]->mIdx);
-	new_indices.push_back(tri->mVertex[2]->mIdx);
-	tri->complete();
-
-	U32 breaks = 0;
-	for (U32 i = 1; i < mNumIndices/3; ++i)
-	{
-		cache.updateScores();
-		tri = cache.mBestTriangle;
-		if (!tri)
-		{
-			breaks++;
-			for (U32 j = 0; j < triangle_data.size(); ++j)
+		cache_count = llmin(new_count, VCACHE_SIZE);
+		for (S32 j = 0; j < cache_count; ++j)
+		{ //best triangle touching the cache
+			S32 v = new_cache[j];
+			cache[j] = v;
+			const U32* list = &vert_tris[tri_start[v]];
+			for (U32 k = 0; k < active[v]; ++k)
 			{
-				if (triangle_data[j].mActive)
+				if (tri_score[list[k]] > best_score)
 				{
-					tri = &(triangle_data[j]);
-					break;
+					best_score = tri_score[list[k]];
+					best_tri = list[k];
 				}
 			}
-		}	
-		
-		cache.addTriangle(tri);
-		new_indices.push_back(tri->mVertex[0]->mIdx);
-		new_indices.push_back(tri->mVertex[1]->mIdx);
-		new_indices.push_back(tri->mVertex[2]->mIdx);
-		tri->complete();
-	}
-
-	for (U32 i = 0; i < mNumIndices; ++i)
-	{
-		mIndices[i] = new_indices[i];
-	}
-
-	/*F32 post_acmr = 1.f;
-	//measure cache misses from after rebuild
-	{
-		LLVCacheFIFO test_cache;
-		for (U32 i = 0; i < mNumVertices; i++)
-		{
-			vertex_data[i].mCacheTag = -1;
 		}
+	}
 
-		for (U32 i = 0; i < mNumIndices; ++i)
-		{
-			test_cache.addVertex(&vertex_data[mIndices[i]]);
-		}
-		
-		post_acmr = (F32) test_cache.mMisses/(mNumIndices/3);
-	}*/
+	memcpy(mIndices, &new_indices[0], num_indices*sizeof(U16));
 
 	//optimize for pre-TnL cache
 	
 	//allocate space for new buffer
-	S32 num_verts = mNumVertices;
 	S32 size = ((num_verts*sizeof(LLVector2)) + 0xF) & ~0xF;
 	LLVector4a* pos = (LLVector4a*) ll_aligned_malloc<64>(sizeof(LLVector4a)*2*num_verts+size);
 	LLVector4a* norm = pos + num_verts;
@@ -6615,7 +6480,8 @@ BOOL LLVolumeFace::createSide(LLVolume* volume, BOOL partial_build)
 
 	LLVector4a* norm = mNormals;
 
-	static LLAlignedArray<LLVector4a, 64> triangle_normals;
+	// not static, faces are generated on volume worker threads
+	LLAlignedArray<LLVector4a, 64> triangle_normals;
 	triangle_normals.resize(count);
 	LLVector4a* output = triangle_normals.mArray;
 	LLVector4a* end_output = output+count;
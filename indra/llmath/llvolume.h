@@ -57,6 +57,7 @@ class LLVolumeTriangle;
 #include "llpointer.h"
 #include "llfile.h"
 #include "llalignedarray.h"
+#include "llatomic.h"
 
 //============================================================================
 
@@ -969,6 +970,7 @@ private:
 class LLVolume : public LLRefCount
 {
 	friend class LLVolumeLODGroup;
+	friend class LLVolumeCache;
 
 protected:
 	~LLVolume(); // use unref
@@ -1007,6 +1009,10 @@ public:
 	void regen();
 	void genTangents(S32 face);
 
+	// Exchange generated path, profile, mesh and faces with a volume of the
+	// same params, e.g. one built off the main thread by LLVolumeMgr.
+	void swapGeometry(LLVolume& other);
+
 	BOOL isConvex() const;
 	BOOL isCap(S32 face);
 	BOOL isFlat(S32 face);
@@ -1045,7 +1051,7 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static LLAtomicS32 sNumMeshPoints;
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -1082,6 +1088,10 @@ protected:
 	void createVolumeFaces();
 public:
 	virtual bool unpackVolumeFaces(std::istream& is, S32 size);
+	// the same for a compressed block already in memory, without a
+	// stream over it
+	bool unpackVolumeFaces(const U8* in, S32 size);
+	bool unpackVolumeFaces(LLSD& mdl);
 
 	virtual void setMeshAssetLoaded(BOOL loaded);
 	virtual BOOL isMeshAssetLoaded();
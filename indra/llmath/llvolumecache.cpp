@@ -0,0 +1,489 @@
+/**
+ * @file llvolumecache.cpp
+ * @brief LLVolumeCache class, on-disk cache of generated volume faces.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumecache.h"
+#include "llvolume.h"
+#include "llfile.h"
+#include "llmappedfile.h"
+#include "llmd5.h"
+
+#include <algorithm>
+#include <ctime>
+#include <boost/filesystem.hpp>
+
+//static
+std::string LLVolumeCache::sCacheDir;
+bool LLVolumeCache::sReadOnly = false;
+LLAtomicU32 LLVolumeCache::sHits(0);
+LLAtomicU32 LLVolumeCache::sMisses(0);
+LLAtomicU32 LLVolumeCache::sWrites(0);
+LLAtomicU32 LLVolumeCache::sTempCounter(0);
+
+namespace
+{
+	// fewer mesh points than this are built faster than they are read
+	const U32 MIN_CACHED_MESH_POINTS = 512;
+
+	const U32 CACHE_MAGIC = 0x43564c4c; // "LLVC"
+
+	// faces are indexed with U16
+	const U32 MAX_FACE_VERTICES = 65536;
+
+	// how much to take a cache over budget below it, so it isn't pruned
+	// again on every start
+	const F32 CACHE_PURGE_AMOUNT = .20f;
+
+#if LL_WINDOWS
+	const char DIR_DELIM = '\\';
+#else
+	const char DIR_DELIM = '/';
+#endif
+
+	struct FileHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mKeySize;
+		U32 mFaceCount;
+	};
+
+	// followed by positions, normals, texcoords, indices and edges, each
+	// padded to 16 bytes
+	struct FaceHeader
+	{
+		S32 mID;
+		U32 mTypeMask;
+		S32 mBeginS;
+		S32 mBeginT;
+		S32 mNumS;
+		S32 mNumT;
+		S32 mNumVertices;
+		S32 mNumIndices;
+		U32 mNumEdges;
+		U32 mPad[3];
+		LLVector4a mExtents[3];
+		LLVector2 mTexCoordExtents[2];
+	};
+
+	inline size_t pad16(size_t size)
+	{
+		return (size + 0xF) & ~0xF;
+	}
+
+	template <class T>
+	void append(std::vector<U8>& out, const T& value)
+	{
+		const U8* bytes = (const U8*) &value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	void append_block(std::vector<U8>& out, const void* data, U32 size)
+	{
+		const U8* bytes = (const U8*) data;
+		out.insert(out.end(), bytes, bytes + size);
+		out.resize(pad16(out.size()), 0);
+	}
+
+	boost::filesystem::path make_path(const std::string& filename)
+	{
+#if LL_WINDOWS
+		return boost::filesystem::path(utf8str_to_utf16str(filename).c_str());
+#else
+		return boost::filesystem::path(filename);
+#endif
+	}
+
+	struct CacheFile
+	{
+		boost::filesystem::path	mPath;
+		std::time_t				mTime;
+		U64						mSize;
+
+		// oldest first
+		bool operator<(const CacheFile& other) const
+		{
+			return mTime < other.mTime;
+		}
+	};
+}
+
+//static
+void LLVolumeCache::initClass(const std::string& cache_dir, bool read_only, U64 max_bytes)
+{
+	sCacheDir = cache_dir;
+	sReadOnly = read_only;
+	if (sCacheDir.empty())
+	{
+		return;
+	}
+
+	if (!read_only)
+	{
+		LLFile::mkdir(sCacheDir);
+		for (U32 i = 0; i < 16; ++i)
+		{
+			LLFile::mkdir(sCacheDir + DIR_DELIM + "0123456789abcdef"[i]);
+		}
+		pruneFiles(max_bytes);
+	}
+	LL_INFOS("VolumeCache") << "Caching generated volume faces in " << sCacheDir << LL_ENDL;
+}
+
+// Entries are dated by their last write, which hits move to the time they
+// were used.  Writes cut short by a crash leave temporary files behind,
+// those always go.
+//static
+void LLVolumeCache::pruneFiles(U64 max_bytes)
+{
+	std::vector<CacheFile> files;
+	U64 total_size = 0;
+	for (U32 i = 0; i < 16; ++i)
+	{
+		boost::system::error_code ec;
+		boost::filesystem::directory_iterator iter(make_path(sCacheDir + DIR_DELIM + "0123456789abcdef"[i]), ec);
+		for (boost::filesystem::directory_iterator end; !ec && iter != end; iter.increment(ec))
+		{
+			CacheFile file;
+			file.mPath = iter->path();
+			boost::system::error_code file_ec;
+			if (file.mPath.extension() == ".tmp")
+			{
+				boost::filesystem::remove(file.mPath, file_ec);
+				continue;
+			}
+			if (file.mPath.extension() != ".vol")
+			{
+				continue;
+			}
+			file.mSize = boost::filesystem::file_size(file.mPath, file_ec);
+			file.mTime = boost::filesystem::last_write_time(file.mPath, file_ec);
+			if (!file_ec)
+			{
+				files.push_back(file);
+				total_size += file.mSize;
+			}
+		}
+	}
+
+	if (!max_bytes || total_size <= max_bytes)
+	{
+		return;
+	}
+
+	std::sort(files.begin(), files.end());
+	const U64 target_size = (U64) (max_bytes * (1.f - CACHE_PURGE_AMOUNT));
+	const U64 old_size = total_size;
+	U32 removed = 0;
+	for (U32 i = 0; i < files.size() && total_size > target_size; ++i)
+	{
+		boost::system::error_code ec;
+		if (boost::filesystem::remove(files[i].mPath, ec))
+		{
+			total_size -= files[i].mSize;
+			++removed;
+		}
+	}
+	LL_INFOS("VolumeCache") << "Pruned " << removed << " of " << files.size() << " entries, "
+		<< old_size << " bytes down to " << total_size << LL_ENDL;
+}
+
+//static
+void LLVolumeCache::cleanupClass()
+{
+	if (isEnabled())
+	{
+		LL_INFOS("VolumeCache") << "Volume cache hits " << sHits << " misses " << sMisses
+			<< " writes " << sWrites << LL_ENDL;
+	}
+	sCacheDir.clear();
+}
+
+//static
+bool LLVolumeCache::shouldCache(const LLVolume* volume)
+{
+	if (!isEnabled() || volume->mGenerateSingleFace)
+	{
+		return false;
+	}
+
+	const LLVolumeParams& params = volume->getParams();
+	if (params.getPathParams().getCurveType() == LL_PCODE_PATH_FLEXIBLE)
+	{
+		// flexies are rebuilt every frame they move
+		return false;
+	}
+
+	if (params.isSculpt())
+	{
+		// no map yet, or a mesh which has its own cache
+		return params.getSculptType() != LL_SCULPT_TYPE_MESH && volume->getSculptLevel() >= 0;
+	}
+
+	return volume->getMesh().size() >= MIN_CACHED_MESH_POINTS;
+}
+
+//static
+void LLVolumeCache::makeKey(const LLVolume* volume, std::vector<U8>& key)
+{
+	const LLVolumeParams& params = volume->getParams();
+	const LLProfileParams& profile = params.getProfileParams();
+	const LLPathParams& path = params.getPathParams();
+
+	key.clear();
+	key.reserve(128);
+	append(key, profile.getCurveType());
+	append(key, profile.getBegin());
+	append(key, profile.getEnd());
+	append(key, profile.getHollow());
+	append(key, path.getCurveType());
+	append(key, path.getBegin());
+	append(key, path.getEnd());
+	append(key, path.getScale());
+	append(key, path.getShear());
+	append(key, path.getTwistBegin());
+	append(key, path.getTwistEnd());
+	append(key, path.getRadiusOffset());
+	append(key, path.getTaper());
+	append(key, path.getRevolutions());
+	append(key, path.getSkew());
+	append(key, params.getSculptID());
+	append(key, params.getSculptType());
+	append(key, volume->getDetail());
+	append(key, volume->getSculptLevel());
+}
+
+//static
+std::string LLVolumeCache::getFilename(const std::vector<U8>& key)
+{
+	LLMD5 md5;
+	md5.update(&key[0], key.size());
+	md5.finalize();
+	char digest[33];
+	md5.hex_digest(digest);
+	return sCacheDir + DIR_DELIM + digest[0] + DIR_DELIM + digest + ".vol";
+}
+
+//static
+bool LLVolumeCache::loadFaces(LLVolume* volume)
+{
+	if (!shouldCache(volume))
+	{
+		return false;
+	}
+
+	std::vector<U8> key;
+	makeKey(volume, key);
+
+	const std::string filename = getFilename(key);
+	LLMappedFile file;
+	if (!file.open(filename))
+	{
+		sMisses++;
+		return false;
+	}
+
+	const U8* data = file.data();
+	const U8* end = data + file.size();
+	const size_t header_size = pad16(sizeof(FileHeader) + key.size());
+	if (file.size() < header_size)
+	{
+		sMisses++;
+		return false;
+	}
+
+	const FileHeader* header = (const FileHeader*) data;
+	if (header->mMagic != CACHE_MAGIC || header->mVersion != CACHE_VERSION
+		|| header->mKeySize != key.size()
+		|| memcmp(data + sizeof(FileHeader), &key[0], key.size()) != 0
+		|| header->mFaceCount != (U32) volume->getNumFaces())
+	{
+		// stale or colliding entry, it gets replaced by the next store
+		sMisses++;
+		return false;
+	}
+
+	LLVolume::face_list_t faces(header->mFaceCount);
+	const U8* cur = data + header_size;
+	for (U32 i = 0; i < header->mFaceCount; ++i)
+	{
+		if (cur + sizeof(FaceHeader) > end)
+		{
+			sMisses++;
+			return false;
+		}
+		const FaceHeader* face_header = (const FaceHeader*) cur;
+		cur += sizeof(FaceHeader);
+
+		// The counts of a damaged entry can be anything, check them
+		// against what is left before working out any size from them.
+		const size_t remaining = end - cur;
+		if (face_header->mNumVertices < 0
+			|| (U32) face_header->mNumVertices > MAX_FACE_VERTICES
+			|| (size_t) face_header->mNumVertices > remaining / sizeof(LLVector4a)
+			|| face_header->mNumIndices < 0
+			|| (size_t) face_header->mNumIndices > remaining / sizeof(U16)
+			|| face_header->mNumEdges > remaining / sizeof(S32))
+		{
+			sMisses++;
+			return false;
+		}
+		const S32 num_verts = face_header->mNumVertices;
+		const S32 num_indices = face_header->mNumIndices;
+		const size_t num_edges = face_header->mNumEdges;
+		const size_t vert_size = pad16((size_t) num_verts * sizeof(LLVector4a));
+		const size_t tc_size = pad16((size_t) num_verts * sizeof(LLVector2));
+		const size_t index_size = pad16((size_t) num_indices * sizeof(U16));
+		const size_t edge_size = pad16(num_edges * sizeof(S32));
+		if (remaining < vert_size * 2 + tc_size + index_size + edge_size)
+		{
+			sMisses++;
+			return false;
+		}
+
+		LLVolumeFace& face = faces[i];
+		face.mID = face_header->mID;
+		face.mTypeMask = face_header->mTypeMask;
+		face.mBeginS = face_header->mBeginS;
+		face.mBeginT = face_header->mBeginT;
+		face.mNumS = face_header->mNumS;
+		face.mNumT = face_header->mNumT;
+		face.mExtents[0] = face_header->mExtents[0];
+		face.mExtents[1] = face_header->mExtents[1];
+		*face.mCenter = face_header->mExtents[2];
+		face.mTexCoordExtents[0] = face_header->mTexCoordExtents[0];
+		face.mTexCoordExtents[1] = face_header->mTexCoordExtents[1];
+
+		face.resizeVertices(num_verts);
+		face.resizeIndices(num_indices);
+		if (num_verts)
+		{
+			memcpy(face.mPositions, cur, (size_t) num_verts * sizeof(LLVector4a));
+			memcpy(face.mNormals, cur + vert_size, (size_t) num_verts * sizeof(LLVector4a));
+			memcpy(face.mTexCoords, cur + vert_size * 2, (size_t) num_verts * sizeof(LLVector2));
+		}
+		cur += vert_size * 2 + tc_size;
+		if (num_indices)
+		{
+			memcpy(face.mIndices, cur, (size_t) num_indices * sizeof(U16));
+		}
+		cur += index_size;
+		face.mEdge.assign((const S32*) cur, (const S32*) cur + num_edges);
+		cur += edge_size;
+	}
+
+	volume->mVolumeFaces.swap(faces);
+	sHits++;
+
+	if (!sReadOnly)
+	{
+		// the least recently used entries are pruned first
+		boost::system::error_code ec;
+		boost::filesystem::last_write_time(make_path(filename), std::time(NULL), ec);
+	}
+	return true;
+}
+
+//static
+void LLVolumeCache::storeFaces(const LLVolume* volume)
+{
+	if (sReadOnly || !shouldCache(volume))
+	{
+		return;
+	}
+
+	std::vector<U8> key;
+	makeKey(volume, key);
+
+	std::vector<U8> out;
+	FileHeader header;
+	header.mMagic = CACHE_MAGIC;
+	header.mVersion = CACHE_VERSION;
+	header.mKeySize = key.size();
+	header.mFaceCount = volume->getNumVolumeFaces();
+	append(out, header);
+	append_block(out, &key[0], key.size());
+
+	for (S32 i = 0; i < volume->getNumVolumeFaces(); ++i)
+	{
+		const LLVolumeFace& face = volume->getVolumeFace(i);
+		if (face.mNumVertices && (!face.mNormals || !face.mTexCoords))
+		{
+			return;
+		}
+
+		FaceHeader face_header;
+		memset(&face_header, 0, sizeof(FaceHeader));
+		face_header.mID = face.mID;
+		face_header.mTypeMask = face.mTypeMask;
+		face_header.mBeginS = face.mBeginS;
+		face_header.mBeginT = face.mBeginT;
+		face_header.mNumS = face.mNumS;
+		face_header.mNumT = face.mNumT;
+		face_header.mNumVertices = face.mNumVertices;
+		face_header.mNumIndices = face.mNumIndices;
+		face_header.mNumEdges = face.mEdge.size();
+		face_header.mExtents[0] = face.mExtents[0];
+		face_header.mExtents[1] = face.mExtents[1];
+		face_header.mExtents[2] = *face.mCenter;
+		face_header.mTexCoordExtents[0] = face.mTexCoordExtents[0];
+		face_header.mTexCoordExtents[1] = face.mTexCoordExtents[1];
+		append(out, face_header);
+
+		append_block(out, face.mPositions, face.mNumVertices * sizeof(LLVector4a));
+		append_block(out, face.mNormals, face.mNumVertices * sizeof(LLVector4a));
+		append_block(out, face.mTexCoords, face.mNumVertices * sizeof(LLVector2));
+		append_block(out, face.mIndices, face.mNumIndices * sizeof(U16));
+		append_block(out, face.mEdge.empty() ? NULL : &face.mEdge[0], face.mEdge.size() * sizeof(S32));
+	}
+
+	// write under a private name so readers never see a partial entry
+	std::string filename = getFilename(key);
+	std::string temp_name = filename + llformat(".%u.tmp", (U32) sTempCounter++);
+	LLFILE* fp = LLFile::fopen(temp_name, "wb");
+	if (!fp)
+	{
+		return;
+	}
+	bool written = fwrite(&out[0], 1, out.size(), fp) == out.size();
+	LLFile::close(fp);
+
+	if (written)
+	{
+		if (LLFile::isfile(filename))
+		{
+			LLFile::remove(filename);
+		}
+		if (LLFile::rename(temp_name, filename) == 0)
+		{
+			sWrites++;
+			return;
+		}
+	}
+	LL_WARNS("VolumeCache") << "Failed to write " << filename << LL_ENDL;
+	LLFile::remove(temp_name);
+}
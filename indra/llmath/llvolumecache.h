@@ -0,0 +1,84 @@
+/**
+ * @file llvolumecache.h
+ * @brief LLVolumeCache class, on-disk cache of generated volume faces.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMECACHE_H
+#define LL_LLVOLUMECACHE_H
+
+#include <string>
+#include <vector>
+
+#include "llatomic.h"
+
+class LLVolume;
+
+// Face geometry of a prim or sculpt volume only depends on its params,
+// detail and sculpt level, so the output of LLVolume::createVolumeFaces()
+// is stored per key and memory mapped back in on later sessions.
+//
+// Only complex shapes and sculpts are cached, simple prims are cheaper to
+// build than to look up.  Safe to use from the volume generation threads.
+//
+// Hits mark their entry as used, and initClass() prunes the least recently
+// used entries when the cache has grown past its budget.
+class LLVolumeCache
+{
+public:
+	enum
+	{
+		CACHE_VERSION = 1
+	};
+
+	// an empty directory disables the cache, a max_bytes of 0 doesn't limit
+	// its size
+	static void initClass(const std::string& cache_dir, bool read_only = false, U64 max_bytes = 0);
+	static void cleanupClass();
+	static bool isEnabled() { return !sCacheDir.empty(); }
+
+	// true if volume is worth caching in its current state
+	static bool shouldCache(const LLVolume* volume);
+
+	// fill volume's faces from the cache, false on miss
+	static bool loadFaces(LLVolume* volume);
+	static void storeFaces(const LLVolume* volume);
+
+	static U32 getHits() { return sHits; }
+	static U32 getMisses() { return sMisses; }
+	static U32 getWrites() { return sWrites; }
+
+private:
+	static void pruneFiles(U64 max_bytes);
+	static void makeKey(const LLVolume* volume, std::vector<U8>& key);
+	static std::string getFilename(const std::vector<U8>& key);
+
+	static std::string sCacheDir;
+	static bool sReadOnly;
+	static LLAtomicU32 sHits;
+	static LLAtomicU32 sMisses;
+	static LLAtomicU32 sWrites;
+	static LLAtomicU32 sTempCounter;
+};
+
+#endif // LL_LLVOLUMECACHE_H
@@ -27,6 +27,9 @@
 
 #include "llvolumemgr.h"
 #include "llvolume.h"
+#include "llqueuedthread.h"
+
+#include <algorithm>
 
 
 const F32 BASE_THRESHOLD = 0.03f;
@@ -40,6 +43,95 @@ F32 LLVolumeLODGroup::mDetailThresholds[NUM_LODS] = {BASE_THRESHOLD,
 //static
 F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 
+//============================================================================
+
+// One volume to build off the main thread.  Owned by LLVolumeMgr on the main
+// thread; the worker only reads the inputs, writes mResult and then sets mDone.
+struct LLVolumeMgr::GenerationJob
+{
+	GenerationJob(const LLVolumeParams& params, S32 detail)
+	:	mParams(params),
+		mDetail(detail),
+		mGroup(NULL),
+		mHasSculpt(false),
+		mSuperseded(false),
+		mResult(NULL),
+		mDone(false)
+	{
+	}
+
+	void build()
+	{
+		F32 scale = LLVolumeLODGroup::getVolumeScaleFromDetail(mDetail);
+		// LOD jobs build a shared volume, sculpt jobs a unique scratch copy
+		mResult = new LLVolume(mParams, scale, FALSE, mTarget.notNull());
+		if (mHasSculpt)
+		{
+			mResult->sculpt(mSculpt.mWidth, mSculpt.mHeight, mSculpt.mComponents,
+							mSculpt.mData.empty() ? NULL : &mSculpt.mData[0], mSculpt.mLevel);
+		}
+	}
+
+	LLVolumeParams mParams;
+	S32 mDetail;
+	LLVolumeLODGroup* mGroup;		// LOD jobs, pinned by the pending LOD
+	LLPointer<LLVolume> mTarget;	// sculpt jobs
+	SculptMap mSculpt;
+	bool mHasSculpt;
+	bool mSuperseded;				// a newer sculpt job replaced this one
+	std::vector<GenerationObserver*> mObservers;
+
+	LLVolume* mResult;				// not referenced until back on the main thread
+	LLAtomic32<bool> mDone;
+};
+
+class LLVolumeGenThread : public LLQueuedThread
+{
+public:
+	class GenerationRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~GenerationRequest() {} // use deleteRequest()
+
+	public:
+		GenerationRequest(handle_t handle, U32 priority, LLVolumeMgr::GenerationJob* job)
+		:	LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+			mJob(job)
+		{
+		}
+
+		/*virtual*/ bool processRequest()
+		{
+			mJob->build();
+			return true;
+		}
+
+		/*virtual*/ void finishRequest(bool completed)
+		{
+			// job is only touched by the main thread after this
+			mJob->mDone = true;
+		}
+
+	private:
+		LLVolumeMgr::GenerationJob* mJob;
+	};
+
+	LLVolumeGenThread()
+	:	LLQueuedThread("volumegen")
+	{
+	}
+
+	void generate(LLVolumeMgr::GenerationJob* job)
+	{
+		// finer LODs are the ones the camera is closest to
+		U32 priority = PRIORITY_NORMAL | (U32) job->mDetail;
+		if (!addRequest(new GenerationRequest(generateHandle(), priority, job)))
+		{
+			LL_WARNS() << "Volume generation request added after shutdown" << LL_ENDL;
+		}
+	}
+};
+
 
 //============================================================================
 
@@ -54,6 +146,7 @@ LLVolumeMgr::LLVolumeMgr()
 LLVolumeMgr::~LLVolumeMgr()
 {
 	cleanup();
+	stopGenerationThreads();
 
 	delete mDataMutex;
 	mDataMutex = NULL;
@@ -61,6 +154,9 @@ LLVolumeMgr::~LLVolumeMgr()
 
 BOOL LLVolumeMgr::cleanup()
 {
+	// pending LODs pin their groups
+	stopGenerationThreads();
+
 	BOOL no_refs = TRUE;
 	if (mDataMutex)
 	{
@@ -218,6 +314,297 @@ void LLVolumeMgr::useMutex()
 	}
 }
 
+void LLVolumeMgr::startGenerationThreads(U32 count)
+{
+	while (mGenerationThreads.size() < count)
+	{
+		mGenerationThreads.push_back(new LLVolumeGenThread());
+	}
+	if (count)
+	{
+		LL_INFOS() << "Generating volumes on " << count << " threads" << LL_ENDL;
+	}
+}
+
+void LLVolumeMgr::stopGenerationThreads()
+{
+	if (mGenerationThreads.empty())
+	{
+		return;
+	}
+
+	bool stopped = true;
+	for (U32 i = 0; i < mGenerationThreads.size(); ++i)
+	{
+		mGenerationThreads[i]->shutdown();
+		stopped = stopped && mGenerationThreads[i]->isStopped();
+	}
+
+	for (generation_job_list_t::iterator iter = mGenerationJobs.begin();
+		 iter != mGenerationJobs.end(); ++iter)
+	{
+		GenerationJob* job = *iter;
+		if (job->mGroup)
+		{
+			job->mGroup->endPendingLOD(job->mDetail, NULL);
+			if (job->mGroup->getNumRefs() == 0)
+			{
+				mVolumeLODGroups.erase(job->mGroup->getVolumeParams());
+				delete job->mGroup;
+			}
+		}
+		if (job->mDone)
+		{
+			LLPointer<LLVolume> discard = job->mResult;
+		}
+		if (job->mDone || stopped)
+		{
+			delete job;
+		}
+		else
+		{
+			// a hung worker may still be writing to it
+			LL_WARNS() << "Leaking volume generation job of a stuck thread" << LL_ENDL;
+		}
+	}
+	mGenerationJobs.clear();
+
+	if (stopped)
+	{
+		for (U32 i = 0; i < mGenerationThreads.size(); ++i)
+		{
+			delete mGenerationThreads[i];
+		}
+	}
+	mGenerationThreads.clear();
+}
+
+void LLVolumeMgr::queueGenerationJob(GenerationJob* job)
+{
+	LLVolumeGenThread* thread = mGenerationThreads[0];
+	S32 pending = thread->getPending();
+	for (U32 i = 1; i < mGenerationThreads.size() && pending > 0; ++i)
+	{
+		S32 count = mGenerationThreads[i]->getPending();
+		if (count < pending)
+		{
+			thread = mGenerationThreads[i];
+			pending = count;
+		}
+	}
+
+	mGenerationJobs.push_back(job);
+	thread->generate(job);
+}
+
+LLVolume* LLVolumeMgr::refVolumeAsync(const LLVolumeParams &volume_params, const S32 detail,
+									  GenerationObserver* observer, const SculptMap* sculpt)
+{
+	if (mGenerationThreads.empty())
+	{
+		return refVolume(volume_params, detail);
+	}
+
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	LLVolumeLODGroup* volgroupp;
+	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
+	if (iter == mVolumeLODGroups.end())
+	{
+		volgroupp = createNewGroup(volume_params);
+	}
+	else
+	{
+		volgroupp = iter->second;
+	}
+
+	if (volgroupp->hasLOD(detail))
+	{
+		if (mDataMutex)
+		{
+			mDataMutex->unlock();
+		}
+		return volgroupp->refLOD(detail);
+	}
+
+	GenerationJob* job = NULL;
+	if (volgroupp->isLODPending(detail))
+	{
+		for (generation_job_list_t::iterator job_iter = mGenerationJobs.begin();
+			 job_iter != mGenerationJobs.end(); ++job_iter)
+		{
+			if ((*job_iter)->mGroup == volgroupp && (*job_iter)->mDetail == detail)
+			{
+				job = *job_iter;
+				break;
+			}
+		}
+		llassert(job);
+	}
+	else
+	{
+		volgroupp->beginPendingLOD(detail);
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+
+	if (!job)
+	{
+		job = new GenerationJob(volume_params, detail);
+		job->mGroup = volgroupp;
+		if (sculpt)
+		{
+			job->mSculpt = *sculpt;
+			job->mHasSculpt = true;
+		}
+		queueGenerationJob(job);
+	}
+
+	if (observer && std::find(job->mObservers.begin(), job->mObservers.end(), observer) == job->mObservers.end())
+	{
+		job->mObservers.push_back(observer);
+	}
+	return NULL;
+}
+
+bool LLVolumeMgr::sculptAsync(LLVolume* volumep, const SculptMap& sculpt, GenerationObserver* observer)
+{
+	if (mGenerationThreads.empty() || !volumep || volumep->isUnique())
+	{
+		return false;
+	}
+
+	std::vector<GenerationObserver*> observers;
+	for (generation_job_list_t::iterator iter = mGenerationJobs.begin();
+		 iter != mGenerationJobs.end(); ++iter)
+	{
+		GenerationJob* job = *iter;
+		if (job->mTarget == volumep && !job->mSuperseded)
+		{
+			if (job->mSculpt.mLevel == sculpt.mLevel)
+			{
+				// already on its way
+				if (observer && std::find(job->mObservers.begin(), job->mObservers.end(), observer) == job->mObservers.end())
+				{
+					job->mObservers.push_back(observer);
+				}
+				return true;
+			}
+			// a better map arrived, the older result gets dropped
+			job->mSuperseded = true;
+			observers.swap(job->mObservers);
+		}
+	}
+
+	GenerationJob* job = new GenerationJob(volumep->getParams(),
+		LLVolumeLODGroup::getVolumeDetailFromScale(volumep->getDetail()));
+	job->mTarget = volumep;
+	job->mSculpt = sculpt;
+	job->mHasSculpt = true;
+	job->mObservers.swap(observers);
+	if (observer && std::find(job->mObservers.begin(), job->mObservers.end(), observer) == job->mObservers.end())
+	{
+		job->mObservers.push_back(observer);
+	}
+	queueGenerationJob(job);
+	return true;
+}
+
+void LLVolumeMgr::cancelGenerationRequests(GenerationObserver* observer)
+{
+	for (generation_job_list_t::iterator iter = mGenerationJobs.begin();
+		 iter != mGenerationJobs.end(); ++iter)
+	{
+		std::vector<GenerationObserver*>& observers = (*iter)->mObservers;
+		observers.erase(std::remove(observers.begin(), observers.end(), observer), observers.end());
+	}
+}
+
+void LLVolumeMgr::updateGeneration()
+{
+	if (mGenerationThreads.empty())
+	{
+		return;
+	}
+
+	for (U32 i = 0; i < mGenerationThreads.size(); ++i)
+	{
+		mGenerationThreads[i]->update(0.f);
+	}
+
+	// observers may queue new jobs from their callbacks
+	std::vector<GenerationJob*> done;
+	for (generation_job_list_t::iterator iter = mGenerationJobs.begin();
+		 iter != mGenerationJobs.end(); )
+	{
+		if ((*iter)->mDone)
+		{
+			done.push_back(*iter);
+			iter = mGenerationJobs.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	for (U32 i = 0; i < done.size(); ++i)
+	{
+		finishGenerationJob(done[i]);
+		delete done[i];
+	}
+}
+
+void LLVolumeMgr::finishGenerationJob(GenerationJob* job)
+{
+	LLPointer<LLVolume> result = job->mResult;
+	job->mResult = NULL;
+
+	if (job->mTarget.notNull())
+	{
+		// nobody else left to see it if we hold the last ref
+		if (job->mSuperseded || job->mTarget->getNumRefs() == 1)
+		{
+			return;
+		}
+		job->mTarget->swapGeometry(*result);
+		for (U32 i = 0; i < job->mObservers.size(); ++i)
+		{
+			job->mObservers[i]->onSculptGenerated(job->mTarget);
+		}
+		return;
+	}
+
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	LLVolumeLODGroup* volgroupp = job->mGroup;
+	volgroupp->endPendingLOD(job->mDetail, result);
+	bool orphaned = volgroupp->getNumRefs() == 0;
+	if (orphaned)
+	{
+		mVolumeLODGroups.erase(volgroupp->getVolumeParams());
+		delete volgroupp;
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+
+	if (!orphaned)
+	{
+		for (U32 i = 0; i < job->mObservers.size(); ++i)
+		{
+			job->mObservers[i]->onVolumeGenerated(job->mParams, job->mDetail);
+		}
+	}
+}
+
 std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 {
 	s << "{ numLODgroups=" << volume_mgr.mVolumeLODGroups.size() << ", ";
@@ -253,6 +640,7 @@ LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params)
 	{
 		mLODRefs[i] = 0;
 		mAccessCount[i] = 0;
+		mLODPending[i] = FALSE;
 	}
 }
 
@@ -301,6 +689,27 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
 	return mVolumeLODs[detail];
 }
 
+void LLVolumeLODGroup::beginPendingLOD(const S32 detail)
+{
+	llassert(detail >=0 && detail < NUM_LODS);
+	llassert(!mLODPending[detail]);
+	mLODPending[detail] = TRUE;
+	mRefs++;
+}
+
+void LLVolumeLODGroup::endPendingLOD(const S32 detail, LLVolume* volumep)
+{
+	llassert(mLODPending[detail]);
+	mLODPending[detail] = FALSE;
+	llassert_always(mRefs > 0);
+	mRefs--;
+	// refLOD() may have needed it first and built it synchronously
+	if (mVolumeLODs[detail].isNull())
+	{
+		mVolumeLODs[detail] = volumep;
+	}
+}
+
 BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 {
 	llassert_always(mRefs > 0);
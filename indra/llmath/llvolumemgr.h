@@ -27,7 +27,9 @@
 #ifndef LL_LLVOLUMEMGR_H
 #define LL_LLVOLUMEMGR_H
 
+#include <list>
 #include <map>
+#include <vector>
 
 #include "llvolume.h"
 #include "llpointer.h"
@@ -58,6 +60,14 @@ public:
 	LLVolume* refLOD(const S32 detail);
 	BOOL derefLOD(LLVolume *volumep);
 	S32 getNumRefs() const { return mRefs; }
+
+	// A pending LOD is being generated by a volume worker thread.  The
+	// group holds an extra ref for it until endPendingLOD() installs the
+	// result (or drops it if refLOD() already built the LOD synchronously).
+	BOOL hasLOD(const S32 detail) const { return mVolumeLODs[detail].notNull(); }
+	BOOL isLODPending(const S32 detail) const { return mLODPending[detail]; }
+	void beginPendingLOD(const S32 detail);
+	void endPendingLOD(const S32 detail, LLVolume* volumep);
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
 
@@ -70,14 +80,45 @@ protected:
 	S32 mRefs;
 	S32 mLODRefs[NUM_LODS];
 	LLPointer<LLVolume> mVolumeLODs[NUM_LODS];
+	BOOL	mLODPending[NUM_LODS];
 	static F32 mDetailThresholds[NUM_LODS];
 	static F32 mDetailScales[NUM_LODS];
 	S32		mAccessCount[NUM_LODS];
 };
 
+class LLVolumeGenThread;
+
 class LLVolumeMgr
 {
 public:
+	// Receives completions of asynchronous generation requests, always on
+	// the thread calling updateGeneration().
+	class GenerationObserver
+	{
+	public:
+		virtual ~GenerationObserver() {}
+
+		// LOD detail of params is now available from refVolume() without
+		// generating anything.
+		virtual void onVolumeGenerated(const LLVolumeParams& params, const S32 detail) = 0;
+
+		// sculpted geometry has been swapped into volumep
+		virtual void onSculptGenerated(LLVolume* volumep) = 0;
+	};
+
+	// private copy of a sculpt map, the source image may go away while
+	// the volume is generated
+	struct SculptMap
+	{
+		SculptMap() : mWidth(0), mHeight(0), mComponents(0), mLevel(-1) {}
+
+		U16 mWidth;
+		U16 mHeight;
+		S8 mComponents;
+		S32 mLevel;
+		std::vector<U8> mData;
+	};
+
 	LLVolumeMgr();
 	virtual ~LLVolumeMgr();
 	BOOL cleanup();			// Cleanup all volumes being managed, returns TRUE if no dangling references
@@ -95,6 +136,32 @@ public:
 	// manually call this for mutex magic
 	void useMutex();
 
+	// Background generation.  With no threads started the async calls
+	// below fall back to (or tell the caller to use) synchronous generation.
+	void startGenerationThreads(U32 count);
+	void stopGenerationThreads();
+	bool isGenerationThreaded() const { return !mGenerationThreads.empty(); }
+
+	// Returns a referenced volume if the LOD already exists.  Otherwise
+	// marks the LOD pending, queues it and returns NULL; observer is told
+	// once it can be referenced.  A sculpt map, if given, is applied on the
+	// worker so the LOD arrives already sculpted.
+	LLVolume* refVolumeAsync(const LLVolumeParams &volume_params, const S32 detail,
+							 GenerationObserver* observer, const SculptMap* sculpt = NULL);
+
+	// Sculpts a copy of volumep on a worker and swaps the result into
+	// volumep from updateGeneration().  Returns false if the caller should
+	// sculpt synchronously.
+	bool sculptAsync(LLVolume* volumep, const SculptMap& sculpt, GenerationObserver* observer);
+
+	// observer will not be called back again
+	void cancelGenerationRequests(GenerationObserver* observer);
+
+	// install finished volumes and notify observers, call once per frame
+	void updateGeneration();
+
+	U32 getPendingGenerationCount() const { return mGenerationJobs.size(); }
+
 	friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
@@ -107,6 +174,17 @@ protected:
 	volume_lod_group_map_t mVolumeLODGroups;
 
 	LLMutex* mDataMutex;
+
+private:
+	friend class LLVolumeGenThread;
+	struct GenerationJob;
+	typedef std::list<GenerationJob*> generation_job_list_t;
+
+	void queueGenerationJob(GenerationJob* job);
+	void finishGenerationJob(GenerationJob* job);
+
+	std::vector<LLVolumeGenThread*> mGenerationThreads;
+	generation_job_list_t mGenerationJobs;
 };
 
 #endif // LL_LLVOLUMEMGR_H
@@ -0,0 +1,232 @@
+/**
+ * @file lloctree_test.cpp
+ * @brief Tests and benchmarks for LLOctreeNode and LLOctreePool.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../lloctree.h"
+#include "lltimer.h"
+
+// normally owned by the viewer's spatial partition code
+U32 gOctreeMaxCapacity = 128;
+F32 gOctreeMinSize = 0.01f;
+
+namespace
+{
+	const U32 ELEMENT_COUNT = 20000;
+
+	LL_ALIGN_PREFIX(16)
+	class OctreeElement : public LLRefCount
+	{
+	public:
+		void* operator new(size_t size)
+		{
+			return ll_aligned_malloc_16(size);
+		}
+
+		void operator delete(void* ptr)
+		{
+			ll_aligned_free_16(ptr);
+		}
+
+		OctreeElement(const LLVector4a& pos, F32 radius)
+		:	mPosition(pos),
+			mRadius(radius),
+			mBinIndex(-1)
+		{
+		}
+
+		const LLVector4a& getPositionGroup() const	{ return mPosition; }
+		F32 getBinRadius() const					{ return mRadius; }
+		S32 getBinIndex() const						{ return mBinIndex; }
+		void setBinIndex(S32 index) const			{ mBinIndex = index; }
+
+	private:
+		LLVector4a mPosition;
+		F32 mRadius;
+		mutable S32 mBinIndex;
+	} LL_ALIGN_POSTFIX(16);
+
+	typedef LLOctreeNode<OctreeElement> test_node;
+	typedef LLOctreeRoot<OctreeElement> test_root;
+	typedef LLOctreePool<OctreeElement> test_pool;
+
+	class CountTraveler : public LLOctreeTraveler<OctreeElement>
+	{
+	public:
+		CountTraveler() : mNodes(0), mElements(0) { }
+
+		virtual void visit(const test_node* node)
+		{
+			++mNodes;
+			mElements += node->getElementCount();
+		}
+
+		U32 mNodes;
+		U32 mElements;
+	};
+
+	// deterministic scatter over a 256m region, like a sim full of prims
+	void make_elements(std::vector<LLPointer<OctreeElement> >& elements)
+	{
+		U32 seed = 12345;
+		elements.reserve(ELEMENT_COUNT);
+		for (U32 i = 0; i < ELEMENT_COUNT; ++i)
+		{
+			F32 v[4];
+			for (U32 j = 0; j < 4; ++j)
+			{
+				seed = seed * 1664525 + 1013904223;
+				v[j] = (F32) (seed >> 8) / (F32) (1 << 24);
+			}
+			LLVector4a pos(v[0] * 256.f, v[1] * 256.f, v[2] * 256.f);
+			elements.push_back(new OctreeElement(pos, 0.05f + v[3] * 4.f));
+		}
+	}
+
+	test_root* make_root(test_pool* pool)
+	{
+		LLVector4a center, size;
+		center.splat(0.f);
+		size.splat(1.f);
+		test_root* root = new test_root(center, size, NULL);
+		root->setPool(pool);
+		return root;
+	}
+
+	F64 time_insert(test_root* root, std::vector<LLPointer<OctreeElement> >& elements)
+	{
+		LLTimer timer;
+		for (U32 i = 0; i < elements.size(); ++i)
+		{
+			root->insert(elements[i]);
+		}
+		return timer.getElapsedTimeF64();
+	}
+
+	F64 time_traverse(test_root* root, CountTraveler& counter)
+	{
+		LLTimer timer;
+		for (U32 i = 0; i < 100; ++i)
+		{
+			counter = CountTraveler();
+			counter.traverse(root);
+		}
+		return timer.getElapsedTimeF64();
+	}
+}
+
+namespace tut
+{
+	struct lloctree_test
+	{
+	};
+	typedef test_group<lloctree_test> lloctree_test_t;
+	typedef lloctree_test_t::object lloctree_test_object_t;
+	tut::lloctree_test_t tut_lloctree_test("LLOctree");
+
+	// insertion into a pooled tree keeps every element and every node
+	// but the root in the pool
+	template<> template<>
+	void lloctree_test_object_t::test<1>()
+	{
+		std::vector<LLPointer<OctreeElement> > elements;
+		make_elements(elements);
+
+		test_pool pool;
+		test_root* root = make_root(&pool);
+		time_insert(root, elements);
+
+		CountTraveler counter;
+		counter.traverse(root);
+		ensure_equals("all elements inserted", counter.mElements, ELEMENT_COUNT);
+		ensure_equals("all non-root nodes pooled", pool.getNodeCount(), counter.mNodes - 1);
+		ensure("pool is densely packed", pool.getAllocatedBytes() < 2 * pool.getNodeCount() * sizeof(test_root) + 8192);
+
+		for (U32 i = 0; i < elements.size(); ++i)
+		{
+			ensure_not_equals("element has a bin", elements[i]->getBinIndex(), -1);
+		}
+
+		delete root;
+		ensure_equals("pool empty after destroying tree", pool.getNodeCount(), 0U);
+	}
+
+	// removing everything collapses the tree and hands the nodes back
+	template<> template<>
+	void lloctree_test_object_t::test<2>()
+	{
+		std::vector<LLPointer<OctreeElement> > elements;
+		make_elements(elements);
+
+		test_pool pool;
+		test_root* root = make_root(&pool);
+		time_insert(root, elements);
+		U32 broods = pool.getBroodCount();
+
+		for (U32 i = 0; i < elements.size(); ++i)
+		{
+			root->getNodeAt(elements[i])->remove(elements[i]);
+			ensure_equals("element removed", elements[i]->getBinIndex(), -1);
+		}
+		ensure_equals("all pooled nodes released", pool.getNodeCount(), 0U);
+
+		//a second fill recycles the same broods
+		time_insert(root, elements);
+		ensure_equals("broods recycled", pool.getBroodCount(), broods);
+
+		delete root;
+	}
+
+	// insertion/traversal benchmark, pooled vs. heap allocated nodes
+	template<> template<>
+	void lloctree_test_object_t::test<3>()
+	{
+		std::vector<LLPointer<OctreeElement> > elements;
+		make_elements(elements);
+
+		test_root* heap_root = make_root(NULL);
+		F64 heap_insert = time_insert(heap_root, elements);
+		CountTraveler heap_count;
+		F64 heap_traverse = time_traverse(heap_root, heap_count);
+		delete heap_root;
+
+		test_pool pool;
+		test_root* pool_root = make_root(&pool);
+		F64 pool_insert = time_insert(pool_root, elements);
+		CountTraveler pool_count;
+		F64 pool_traverse = time_traverse(pool_root, pool_count);
+		delete pool_root;
+
+		ensure_equals("same tree shape", pool_count.mNodes, heap_count.mNodes);
+		ensure_equals("same element count", pool_count.mElements, heap_count.mElements);
+
+		LL_INFOS("OctreeBench") << ELEMENT_COUNT << " elements, " << pool_count.mNodes << " nodes: "
+			<< "insert heap " << heap_insert * 1000.0 << "ms pool " << pool_insert * 1000.0 << "ms, "
+			<< "100 traversals heap " << heap_traverse * 1000.0 << "ms pool " << pool_traverse * 1000.0 << "ms"
+			<< LL_ENDL;
+	}
+}
@@ -0,0 +1,565 @@
+/**
+ * @file llvolume_test.cpp
+ * @brief Tests and benchmarks for LLVolumeFace.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include <algorithm>
+
+#include "../llvolume.h"
+#include "lltimer.h"
+
+// normally owned by the viewer
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+F32 gOctreeMinSize = 0.01f;
+
+namespace
+{
+	// The pre-linear-time optimizer, kept as the baseline for the ACMR and
+	// runtime comparison below.
+	class LLVCacheTriangleData;
+
+	class LLVCacheVertexData
+	{
+	public:
+		S32 mIdx;
+		S32 mCacheTag;
+		F64 mScore;
+		U32 mActiveTriangles;
+		std::vector<LLVCacheTriangleData*> mTriangles;
+
+		LLVCacheVertexData()
+		{
+			mCacheTag = -1;
+			mScore = 0.0;
+			mActiveTriangles = 0;
+			mIdx = -1;
+		}
+	};
+
+	class LLVCacheTriangleData
+	{
+	public:
+		bool mActive;
+		F64 mScore;
+		LLVCacheVertexData* mVertex[3];
+
+		LLVCacheTriangleData()
+		{
+			mActive = true;
+			mScore = 0.0;
+			mVertex[0] = mVertex[1] = mVertex[2] = NULL;
+		}
+
+		void complete()
+		{
+			mActive = false;
+			for (S32 i = 0; i < 3; ++i)
+			{
+				if (mVertex[i])
+				{
+					llassert(mVertex[i]->mActiveTriangles > 0);
+					mVertex[i]->mActiveTriangles--;
+				}
+			}
+		}
+
+		bool operator<(const LLVCacheTriangleData& rhs) const
+		{ //highest score first
+			return rhs.mScore < mScore;
+		}
+	};
+
+	const F64 FindVertexScore_CacheDecayPower = 1.5;
+	const F64 FindVertexScore_LastTriScore = 0.75;
+	const F64 FindVertexScore_ValenceBoostScale = 2.0;
+	const F64 FindVertexScore_ValenceBoostPower = 0.5;
+	const U32 MaxSizeVertexCache = 32;
+	const F64 FindVertexScore_Scaler = 1.0/(MaxSizeVertexCache-3);
+
+	F64 find_vertex_score(LLVCacheVertexData& data)
+	{
+		F64 score = -1.0;
+
+		score = 0.0;
+
+		S32 cache_idx = data.mCacheTag;
+
+		if (cache_idx < 0)
+		{
+			//not in cache
+		}
+		else
+		{
+			if (cache_idx < 3)
+			{ //vertex was in the last triangle
+				score = FindVertexScore_LastTriScore;
+			}
+			else
+			{ //more points for being higher in the cache
+					score = 1.0-((cache_idx-3)*FindVertexScore_Scaler);
+					score = pow(score, FindVertexScore_CacheDecayPower);
+			}
+		}
+
+		//bonus points for having low valence
+		F64 valence_boost = pow((F64)data.mActiveTriangles, -FindVertexScore_ValenceBoostPower);
+		score += FindVertexScore_ValenceBoostScale * valence_boost;
+
+		return score;
+	}
+
+	class LLVCacheFIFO
+	{
+	public:
+		LLVCacheVertexData* mCache[MaxSizeVertexCache];
+		U32 mMisses;
+
+		LLVCacheFIFO()
+		{
+			mMisses = 0;
+			for (U32 i = 0; i < MaxSizeVertexCache; ++i)
+			{
+				mCache[i] = NULL;
+			}
+		}
+
+		void addVertex(LLVCacheVertexData* data)
+		{
+			if (data->mCacheTag == -1)
+			{
+				mMisses++;
+
+				S32 end = MaxSizeVertexCache-1;
+
+				if (mCache[end])
+				{
+					mCache[end]->mCacheTag = -1;
+				}
+
+				for (S32 i = end; i > 0; --i)
+				{
+					mCache[i] = mCache[i-1];
+					if (mCache[i])
+					{
+						mCache[i]->mCacheTag = i;
+					}
+				}
+
+				mCache[0] = data;
+				data->mCacheTag = 0;
+			}
+		}
+	};
+
+	class LLVCacheLRU
+	{
+	public:
+		LLVCacheVertexData* mCache[MaxSizeVertexCache+3];
+
+		LLVCacheTriangleData* mBestTriangle;
+	
+		U32 mMisses;
+
+		LLVCacheLRU()
+		{
+			for (U32 i = 0; i < MaxSizeVertexCache+3; ++i)
+			{
+				mCache[i] = NULL;
+			}
+
+			mBestTriangle = NULL;
+			mMisses = 0;
+		}
+
+		void addVertex(LLVCacheVertexData* data)
+		{
+			S32 end = MaxSizeVertexCache+2;
+			if (data->mCacheTag != -1)
+			{ //just moving a vertex to the front of the cache
+				end = data->mCacheTag;
+			}
+			else
+			{
+				mMisses++;
+				if (mCache[end])
+				{ //adding a new vertex, vertex at end of cache falls off
+					mCache[end]->mCacheTag = -1;
+				}
+			}
+
+			for (S32 i = end; i > 0; --i)
+			{ //adjust cache pointers and tags
+				mCache[i] = mCache[i-1];
+
+				if (mCache[i])
+				{
+					mCache[i]->mCacheTag = i;			
+				}
+			}
+
+			mCache[0] = data;
+			mCache[0]->mCacheTag = 0;
+		}
+
+		void addTriangle(LLVCacheTriangleData* data)
+		{
+			addVertex(data->mVertex[0]);
+			addVertex(data->mVertex[1]);
+			addVertex(data->mVertex[2]);
+		}
+
+		void updateScores()
+		{
+			LLVCacheVertexData** data_iter = mCache+MaxSizeVertexCache;
+			LLVCacheVertexData** end_data = mCache+MaxSizeVertexCache+3;
+
+			while(data_iter != end_data)
+			{
+				LLVCacheVertexData* data = *data_iter++;
+				//trailing 3 vertices aren't actually in the cache for scoring purposes
+				if (data)
+				{
+					data->mCacheTag = -1;
+				}
+			}
+
+			data_iter = mCache;
+			end_data = mCache+MaxSizeVertexCache;
+
+			while (data_iter != end_data)
+			{ //update scores of vertices in cache
+				LLVCacheVertexData* data = *data_iter++;
+				if (data)
+				{
+					data->mScore = find_vertex_score(*data);
+				}
+			}
+
+			mBestTriangle = NULL;
+			//update triangle scores
+			data_iter = mCache;
+			end_data = mCache+MaxSizeVertexCache+3;
+
+			while (data_iter != end_data)
+			{
+				LLVCacheVertexData* data = *data_iter++;
+				if (data)
+				{
+					for (std::vector<LLVCacheTriangleData*>::iterator iter = data->mTriangles.begin(), end_iter = data->mTriangles.end(); iter != end_iter; ++iter)
+					{
+						LLVCacheTriangleData* tri = *iter;
+						if (tri->mActive)
+						{
+							tri->mScore = tri->mVertex[0]->mScore;
+							tri->mScore += tri->mVertex[1]->mScore;
+							tri->mScore += tri->mVertex[2]->mScore;
+
+							if (!mBestTriangle || mBestTriangle->mScore < tri->mScore)
+							{
+								mBestTriangle = tri;
+							}
+						}
+					}
+				}
+			}
+
+			//knock trailing 3 vertices off the cache
+			data_iter = mCache+MaxSizeVertexCache;
+			end_data = mCache+MaxSizeVertexCache+3;
+			while (data_iter != end_data)
+			{
+				LLVCacheVertexData* data = *data_iter;
+				if (data)
+				{
+					llassert(data->mCacheTag == -1);
+					*data_iter = NULL;
+				}
+				++data_iter;
+			}
+		}
+	};
+
+	void legacy_cache_optimize(U16* indices, U32 num_indices, U32 num_vertices)
+	{
+		LLVCacheLRU cache;
+
+		std::vector<LLVCacheVertexData> vertex_data(num_vertices);
+		std::vector<LLVCacheTriangleData> triangle_data(num_indices/3);
+
+		for (U32 i = 0; i < num_indices; i++)
+		{
+			U16 idx = indices[i];
+			U32 tri_idx = i/3;
+
+			vertex_data[idx].mTriangles.push_back(&(triangle_data[tri_idx]));
+			vertex_data[idx].mIdx = idx;
+			triangle_data[tri_idx].mVertex[i%3] = &(vertex_data[idx]);
+		}
+
+		for (U32 i = 0; i < num_vertices; i++)
+		{
+			LLVCacheVertexData& data = vertex_data[i];
+
+			data.mScore = find_vertex_score(data);
+			data.mActiveTriangles = data.mTriangles.size();
+
+			for (U32 j = 0; j < data.mActiveTriangles; ++j)
+			{
+				data.mTriangles[j]->mScore += data.mScore;
+			}
+		}
+
+		std::sort(triangle_data.begin(), triangle_data.end());
+
+		std::vector<U16> new_indices;
+		LLVCacheTriangleData* tri = &(triangle_data[0]);
+		cache.addTriangle(tri);
+		new_indices.push_back(tri->mVertex[0]->mIdx);
+		new_indices.push_back(tri->mVertex[1]->mIdx);
+		new_indices.push_back(tri->mVertex[2]->mIdx);
+		tri->complete();
+
+		for (U32 i = 1; i < num_indices/3; ++i)
+		{
+			cache.updateScores();
+			tri = cache.mBestTriangle;
+			if (!tri)
+			{
+				for (U32 j = 0; j < triangle_data.size(); ++j)
+				{
+					if (triangle_data[j].mActive)
+					{
+						tri = &(triangle_data[j]);
+						break;
+					}
+				}
+			}
+
+			cache.addTriangle(tri);
+			new_indices.push_back(tri->mVertex[0]->mIdx);
+			new_indices.push_back(tri->mVertex[1]->mIdx);
+			new_indices.push_back(tri->mVertex[2]->mIdx);
+			tri->complete();
+		}
+
+		memcpy(indices, &new_indices[0], new_indices.size()*sizeof(U16));
+	}
+
+	// average cache miss ratio of a FIFO post-transform cache
+	F32 calc_acmr(const U16* indices, U32 num_indices, U32 cache_size)
+	{
+		std::vector<S32> cache(cache_size, -1);
+		U32 head = 0;
+		U32 misses = 0;
+		for (U32 i = 0; i < num_indices; ++i)
+		{
+			if (std::find(cache.begin(), cache.end(), (S32) indices[i]) == cache.end())
+			{
+				misses++;
+				cache[head] = indices[i];
+				head = (head + 1) % cache_size;
+			}
+		}
+		return (F32) misses / (F32) (num_indices/3);
+	}
+
+	struct TriangleKey
+	{
+		F32 mV[9];
+
+		bool operator<(const TriangleKey& rhs) const
+		{
+			return std::lexicographical_compare(mV, mV+9, rhs.mV, rhs.mV+9);
+		}
+
+		bool operator==(const TriangleKey& rhs) const
+		{
+			return std::equal(mV, mV+9, rhs.mV);
+		}
+	};
+
+	// triangles by vertex position, rotated to a canonical first vertex
+	// so winding is kept but index order does not matter
+	void get_triangles(const LLVolumeFace& face, std::vector<TriangleKey>& tris)
+	{
+		tris.clear();
+		for (S32 i = 0; i+2 < face.mNumIndices; i += 3)
+		{
+			TriangleKey rot[3];
+			for (U32 r = 0; r < 3; ++r)
+			{
+				for (U32 j = 0; j < 3; ++j)
+				{
+					const F32* p = face.mPositions[face.mIndices[i+(j+r)%3]].getF32ptr();
+					rot[r].mV[j*3+0] = p[0];
+					rot[r].mV[j*3+1] = p[1];
+					rot[r].mV[j*3+2] = p[2];
+				}
+			}
+			tris.push_back(*std::min_element(rot, rot+3));
+		}
+		std::sort(tris.begin(), tris.end());
+	}
+
+	// a sculpt map shaped like a lumpy sphere, large enough to produce
+	// 64x64 quads at the highest LOD
+	void make_sculpt_map(std::vector<U8>& data, U16 size)
+	{
+		data.resize(size*size*3);
+		for (U16 y = 0; y < size; ++y)
+		{
+			for (U16 x = 0; x < size; ++x)
+			{
+				F32 u = (F32) x / (size-1) * F_TWO_PI;
+				F32 v = (F32) y / (size-1) * F_PI;
+				F32 r = 0.4f + 0.1f * sinf(u*3.f) * sinf(v*5.f);
+				U8* p = &data[(y*size+x)*3];
+				p[0] = (U8) llclamp(128.f + r * cosf(u) * sinf(v) * 255.f, 0.f, 255.f);
+				p[1] = (U8) llclamp(128.f + r * sinf(u) * sinf(v) * 255.f, 0.f, 255.f);
+				p[2] = (U8) llclamp(128.f + r * cosf(v) * 255.f, 0.f, 255.f);
+			}
+		}
+	}
+
+	// faces of a few detailed prims and a sculpt
+	void make_corpus(std::vector<LLPointer<LLVolume> >& volumes)
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setRatio(1.f, 0.25f);
+		volumes.push_back(new LLVolume(params, 4.f));
+
+		params.setType(LL_PCODE_PROFILE_CIRCLE_HALF, LL_PCODE_PATH_CIRCLE);
+		params.setRatio(1.f, 1.f);
+		volumes.push_back(new LLVolume(params, 4.f));
+
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_LINE);
+		params.setHollow(0.5f);
+		params.setTwistEnd(1.f);
+		volumes.push_back(new LLVolume(params, 4.f));
+
+		LLVolumeParams sculpt_params;
+		sculpt_params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		sculpt_params.setSculptID(LLUUID::generateNewID(), LL_SCULPT_TYPE_SPHERE);
+		LLVolume* sculpt = new LLVolume(sculpt_params, 4.f);
+		std::vector<U8> map;
+		make_sculpt_map(map, 64);
+		sculpt->sculpt(64, 64, 3, &map[0], 0);
+		volumes.push_back(sculpt);
+	}
+}
+
+namespace tut
+{
+	struct llvolume_test
+	{
+	};
+	typedef test_group<llvolume_test> llvolume_test_t;
+	typedef llvolume_test_t::object llvolume_test_object_t;
+	tut::llvolume_test_t tut_llvolume_test("LLVolume");
+
+	// cacheOptimize() only reorders, every triangle survives with its winding
+	template<> template<>
+	void llvolume_test_object_t::test<1>()
+	{
+		std::vector<LLPointer<LLVolume> > volumes;
+		make_corpus(volumes);
+
+		for (U32 i = 0; i < volumes.size(); ++i)
+		{
+			for (S32 f = 0; f < volumes[i]->getNumVolumeFaces(); ++f)
+			{
+				LLVolumeFace face(volumes[i]->getVolumeFace(f));
+				std::vector<TriangleKey> before, after;
+				get_triangles(face, before);
+
+				face.cacheOptimize();
+				get_triangles(face, after);
+
+				ensure("face optimized", face.mOptimized);
+				ensure("same triangles", before == after);
+				for (S32 j = 0; j < face.mNumIndices; ++j)
+				{
+					ensure("index in range", face.mIndices[j] < face.mNumVertices);
+				}
+			}
+		}
+	}
+
+	// ACMR and runtime against the previous optimizer
+	template<> template<>
+	void llvolume_test_object_t::test<2>()
+	{
+		std::vector<LLPointer<LLVolume> > volumes;
+		make_corpus(volumes);
+
+		const U32 CACHE_SIZE = 24;
+		U32 triangles = 0;
+		F64 input_misses = 0.0, legacy_misses = 0.0, linear_misses = 0.0;
+		F64 legacy_time = 0.0, linear_time = 0.0;
+
+		for (U32 i = 0; i < volumes.size(); ++i)
+		{
+			for (S32 f = 0; f < volumes[i]->getNumVolumeFaces(); ++f)
+			{
+				const LLVolumeFace& src = volumes[i]->getVolumeFace(f);
+				if (src.mNumIndices < 3)
+				{
+					continue;
+				}
+				U32 num_tris = src.mNumIndices/3;
+				triangles += num_tris;
+				input_misses += calc_acmr(src.mIndices, src.mNumIndices, CACHE_SIZE) * num_tris;
+
+				std::vector<U16> legacy(src.mIndices, src.mIndices + src.mNumIndices);
+				LLTimer timer;
+				legacy_cache_optimize(&legacy[0], legacy.size(), src.mNumVertices);
+				legacy_time += timer.getElapsedTimeF64();
+				legacy_misses += calc_acmr(&legacy[0], legacy.size(), CACHE_SIZE) * num_tris;
+
+				// includes the vertex fetch remap the baseline above skips
+				LLVolumeFace face(src);
+				timer.reset();
+				face.cacheOptimize();
+				linear_time += timer.getElapsedTimeF64();
+				linear_misses += calc_acmr(face.mIndices, face.mNumIndices, CACHE_SIZE) * num_tris;
+			}
+		}
+
+		F32 input_acmr = input_misses / triangles;
+		F32 legacy_acmr = legacy_misses / triangles;
+		F32 linear_acmr = linear_misses / triangles;
+
+		LL_INFOS("VCacheBench") << triangles << " triangles, ACMR (FIFO " << CACHE_SIZE << ") input "
+			<< input_acmr << " legacy " << legacy_acmr << " linear " << linear_acmr
+			<< ", time legacy " << legacy_time * 1000.0 << "ms linear " << linear_time * 1000.0 << "ms" << LL_ENDL;
+
+		ensure("optimizer improves on input order", linear_acmr <= input_acmr);
+		ensure("optimizer matches legacy quality", linear_acmr <= legacy_acmr * 1.05f);
+	}
+}
@@ -0,0 +1,316 @@
+/**
+ * @file llvolumecache_test.cpp
+ * @brief Tests for LLVolumeCache.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+
+#include "../llvolume.h"
+#include "../llvolumecache.h"
+#include "llfile.h"
+
+#include <boost/filesystem.hpp>
+
+// normally owned by the viewer
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+F32 gOctreeMinSize = 0.01f;
+
+namespace
+{
+	// hollow, cut torus, detailed enough to be cached
+	LLVolumeParams make_torus_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setBeginAndEndS(0.1f, 0.8f);
+		params.setBeginAndEndT(0.f, 1.f);
+		params.setRatio(1.f, 0.25f);
+		params.setHollow(0.5f);
+		return params;
+	}
+
+	struct CacheEntry
+	{
+		boost::filesystem::path	mPath;
+		U64						mSize;
+	};
+
+	// the entries of the cache in dir, and their total size
+	U64 list_entries(const std::string& dir, std::vector<CacheEntry>& entries)
+	{
+		entries.clear();
+		U64 total = 0;
+		boost::filesystem::recursive_directory_iterator end;
+		for (boost::filesystem::recursive_directory_iterator iter(dir); iter != end; ++iter)
+		{
+			if (iter->path().extension() == ".vol")
+			{
+				CacheEntry entry;
+				entry.mPath = iter->path();
+				entry.mSize = boost::filesystem::file_size(entry.mPath);
+				entries.push_back(entry);
+				total += entry.mSize;
+			}
+		}
+		return total;
+	}
+
+	std::vector<U8> read_file(const std::string& filename)
+	{
+		std::vector<U8> data;
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (fp)
+		{
+			U8 buffer[4096];
+			size_t count;
+			while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			{
+				data.insert(data.end(), buffer, buffer + count);
+			}
+			LLFile::close(fp);
+		}
+		return data;
+	}
+
+	void write_file(const std::string& filename, const std::vector<U8>& data)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "wb");
+		if (fp)
+		{
+			fwrite(&data[0], 1, data.size(), fp);
+			LLFile::close(fp);
+		}
+	}
+
+	bool same_faces(const LLVolume* a, const LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+		{
+			return false;
+		}
+		for (S32 i = 0; i < a->getNumVolumeFaces(); ++i)
+		{
+			const LLVolumeFace& x = a->getVolumeFace(i);
+			const LLVolumeFace& y = b->getVolumeFace(i);
+			if (x.mNumVertices != y.mNumVertices || x.mNumIndices != y.mNumIndices
+				|| x.mTypeMask != y.mTypeMask || x.mEdge != y.mEdge
+				|| memcmp(x.mPositions, y.mPositions, x.mNumVertices * sizeof(LLVector4a))
+				|| memcmp(x.mNormals, y.mNormals, x.mNumVertices * sizeof(LLVector4a))
+				|| memcmp(x.mTexCoords, y.mTexCoords, x.mNumVertices * sizeof(LLVector2))
+				|| memcmp(x.mIndices, y.mIndices, x.mNumIndices * sizeof(U16)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+namespace tut
+{
+	struct llvolumecache_test
+	{
+		llvolumecache_test()
+		{
+			mCacheDir = std::string(LLFile::tmpdir()) + "llvolumecache_test";
+			LLVolumeCache::initClass(mCacheDir);
+		}
+
+		~llvolumecache_test()
+		{
+			LLVolumeCache::cleanupClass();
+		}
+
+		std::string mCacheDir;
+	};
+	typedef test_group<llvolumecache_test> llvolumecache_test_t;
+	typedef llvolumecache_test_t::object llvolumecache_test_object_t;
+	tut::llvolumecache_test_t tut_llvolumecache_test("LLVolumeCache");
+
+	// a second volume with the same params comes from the cache, bit for bit
+	template<> template<>
+	void llvolumecache_test_object_t::test<1>()
+	{
+		LLVolumeParams params = make_torus_params();
+		// vary the detail per run so the first volume always misses
+		F32 detail = 4.f + (F32) (time(NULL) % 1000) * 0.001f;
+
+		U32 hits = LLVolumeCache::getHits();
+		LLPointer<LLVolume> built = new LLVolume(params, detail);
+		ensure("generated volume is cacheable", LLVolumeCache::shouldCache(built));
+		ensure_equals("first volume generated", LLVolumeCache::getHits(), hits);
+
+		LLPointer<LLVolume> cached = new LLVolume(params, detail);
+		ensure_equals("second volume loaded", LLVolumeCache::getHits(), hits + 1);
+		ensure("faces round trip", same_faces(built, cached));
+	}
+
+	// simple prims and flexies are never cached
+	template<> template<>
+	void llvolumecache_test_object_t::test<2>()
+	{
+		LLVolumeParams cube;
+		cube.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		LLPointer<LLVolume> volume = new LLVolume(cube, 1.f);
+		ensure("cube not cached", !LLVolumeCache::shouldCache(volume));
+
+		LLVolumeParams flexi = make_torus_params();
+		flexi.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_FLEXIBLE);
+		volume = new LLVolume(flexi, 4.f, FALSE, TRUE);
+		ensure("flexible not cached", !LLVolumeCache::shouldCache(volume));
+	}
+
+	// over budget, the least recently used entries go first, and leftover
+	// temporary files always go
+	template<> template<>
+	void llvolumecache_test_object_t::test<3>()
+	{
+		LLVolumeCache::cleanupClass();
+		std::string cache_dir = std::string(LLFile::tmpdir()) + "llvolumecache_prune_test";
+		boost::filesystem::remove_all(cache_dir);
+		LLVolumeCache::initClass(cache_dir);
+
+		LLVolumeParams params = make_torus_params();
+		const F32 details[] = { 4.f, 4.5f, 5.f, 5.5f };
+		for (U32 i = 0; i < 4; ++i)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(params, details[i]);
+		}
+		std::vector<CacheEntry> entries;
+		const U64 total = list_entries(cache_dir, entries);
+		ensure_equals("one entry per volume", entries.size(), (size_t) 4);
+
+		// everything last used an hour ago, then the first volume again
+		const std::time_t an_hour_ago = std::time(NULL) - 3600;
+		for (U32 i = 0; i < entries.size(); ++i)
+		{
+			boost::filesystem::last_write_time(entries[i].mPath, an_hour_ago);
+		}
+		U32 hits = LLVolumeCache::getHits();
+		LLPointer<LLVolume> used = new LLVolume(params, details[0]);
+		ensure_equals("first volume loaded", LLVolumeCache::getHits(), hits + 1);
+		U64 used_size = 0;
+		for (U32 i = 0; i < entries.size(); ++i)
+		{
+			if (boost::filesystem::last_write_time(entries[i].mPath) != an_hour_ago)
+			{
+				used_size = entries[i].mSize;
+			}
+		}
+		ensure("hit marked its entry", used_size != 0);
+
+		std::string temp_name = entries[0].mPath.string() + ".7.tmp";
+		LLFILE* fp = LLFile::fopen(temp_name, "wb");
+		ensure("temporary file", fp != NULL);
+		LLFile::close(fp);
+
+		// within budget nothing but the temporary file goes
+		LLVolumeCache::cleanupClass();
+		LLVolumeCache::initClass(cache_dir, false, total);
+		ensure_equals("within budget", list_entries(cache_dir, entries), total);
+		ensure("temporary file removed", !LLFile::isfile(temp_name));
+
+		// over budget, down to 80% of it, keeping the one just used
+		const U64 budget = total - 1;
+		LLVolumeCache::cleanupClass();
+		LLVolumeCache::initClass(cache_dir, false, budget);
+		const U64 pruned = list_entries(cache_dir, entries);
+		ensure("pruned", entries.size() < 4);
+		ensure("down to 80% of the budget", pruned * 5 <= budget * 4);
+
+		hits = LLVolumeCache::getHits();
+		used = new LLVolume(params, details[0]);
+		ensure_equals("used volume still loads", LLVolumeCache::getHits(), hits + 1);
+
+		LLVolumeCache::cleanupClass();
+		boost::filesystem::remove_all(cache_dir);
+		LLVolumeCache::initClass(mCacheDir);
+	}
+
+	// damaged face counts are a miss, whatever size they work out to
+	template<> template<>
+	void llvolumecache_test_object_t::test<4>()
+	{
+		LLVolumeCache::cleanupClass();
+		std::string cache_dir = std::string(LLFile::tmpdir()) + "llvolumecache_corrupt_test";
+		boost::filesystem::remove_all(cache_dir);
+		LLVolumeCache::initClass(cache_dir);
+
+		LLVolumeParams params = make_torus_params();
+		LLPointer<LLVolume> built = new LLVolume(params, 4.f);
+		std::vector<CacheEntry> entries;
+		list_entries(cache_dir, entries);
+		ensure_equals("one entry", entries.size(), (size_t) 1);
+		const std::string filename = entries[0].mPath.string();
+		const std::vector<U8> data = read_file(filename);
+
+		// The first face header follows the 16 byte file header and the
+		// key, padded to 16 bytes.  Its vertex, index and edge counts are
+		// at 24, 28 and 32.
+		U32 key_size;
+		memcpy(&key_size, &data[8], sizeof(key_size));
+		const size_t face_offset = (16 + key_size + 15) & ~15;
+		struct Damage
+		{
+			const char*	mName;
+			size_t		mOffset;
+			U32			mValue;
+		};
+		const Damage damages[] = {
+			{ "vertex count wrapping 32 bits", 24, 0x10000001 },
+			{ "negative vertex count", 24, 0xffffffff },
+			{ "vertex count past U16 indices", 24, 65537 },
+			{ "index count wrapping 32 bits", 28, 0x7fffffff },
+			{ "edge count wrapping to no bytes", 32, 0x40000000 },
+			{ "huge edge count", 32, 0xffffffff }
+		};
+		for (U32 i = 0; i < sizeof(damages) / sizeof(damages[0]); ++i)
+		{
+			std::vector<U8> damaged(data);
+			memcpy(&damaged[face_offset + damages[i].mOffset], &damages[i].mValue, sizeof(U32));
+			write_file(filename, damaged);
+
+			U32 hits = LLVolumeCache::getHits();
+			U32 misses = LLVolumeCache::getMisses();
+			LLPointer<LLVolume> volume = new LLVolume(params, 4.f);
+			ensure_equals(damages[i].mName, LLVolumeCache::getHits(), hits);
+			ensure_equals(damages[i].mName, LLVolumeCache::getMisses(), misses + 1);
+			ensure(damages[i].mName, same_faces(built, volume));
+		}
+
+		// cut off inside the first face's data
+		std::vector<U8> truncated(data.begin(), data.begin() + face_offset + 256);
+		write_file(filename, truncated);
+		U32 hits = LLVolumeCache::getHits();
+		LLPointer<LLVolume> volume = new LLVolume(params, 4.f);
+		ensure_equals("truncated", LLVolumeCache::getHits(), hits);
+		ensure("truncated rebuilt", same_faces(built, volume));
+
+		LLVolumeCache::cleanupClass();
+		boost::filesystem::remove_all(cache_dir);
+		LLVolumeCache::initClass(mCacheDir);
+	}
+}
@@ -0,0 +1,347 @@
+/**
+ * @file llvolumemgr_test.cpp
+ * @brief Tests for LLVolumeMgr's background generation, the order
+ * completions are delivered in, cancellation and shutdown.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolumemgr.h"
+#include "../llvolume.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+// normally owned by the viewer
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+F32 gOctreeMinSize = 0.01f;
+
+namespace
+{
+	LLVolumeParams make_params(F32 hollow)
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setBeginAndEndS(0.f, 1.f);
+		params.setBeginAndEndT(0.f, 1.f);
+		params.setRatio(1.f, 0.25f);
+		params.setHollow(hollow);
+		return params;
+	}
+
+	LLVolumeParams make_sculpt_params()
+	{
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setSculptID(LLUUID("5748decc-f629-461c-9a36-a35a221fe21f"), LL_SCULPT_TYPE_SPHERE);
+		return params;
+	}
+
+	// an RGB map whose positions grow with scale
+	LLVolumeMgr::SculptMap make_sculpt_map(U8 scale, S32 level)
+	{
+		LLVolumeMgr::SculptMap map;
+		map.mWidth = 16;
+		map.mHeight = 16;
+		map.mComponents = 3;
+		map.mLevel = level;
+		for (S32 y = 0; y < map.mHeight; ++y)
+		{
+			for (S32 x = 0; x < map.mWidth; ++x)
+			{
+				map.mData.push_back((U8) (x * scale));
+				map.mData.push_back((U8) (y * scale));
+				map.mData.push_back((U8) ((x + y) * scale / 2));
+			}
+		}
+		return map;
+	}
+
+	bool same_positions(const LLVolume* a, const LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+		{
+			return false;
+		}
+		for (S32 i = 0; i < a->getNumVolumeFaces(); ++i)
+		{
+			const LLVolumeFace& fa = a->getVolumeFace(i);
+			const LLVolumeFace& fb = b->getVolumeFace(i);
+			if (fa.mNumVertices != fb.mNumVertices ||
+				memcmp(fa.mPositions, fb.mPositions, fa.mNumVertices * sizeof(LLVector4a)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Records every completion, and checks each one is delivered from
+	// inside updateGeneration() with its result already in place.
+	class TestObserver : public LLVolumeMgr::GenerationObserver
+	{
+	public:
+		TestObserver(LLVolumeMgr& mgr, const bool& updating)
+		:	mMgr(mgr),
+			mUpdating(updating),
+			mOutsideUpdate(0),
+			mNotInstalled(0)
+		{
+		}
+
+		/*virtual*/ void onVolumeGenerated(const LLVolumeParams& params, const S32 detail)
+		{
+			mOutsideUpdate += mUpdating ? 0 : 1;
+			LLVolumeLODGroup* group = mMgr.getGroup(params);
+			if (!group || !group->hasLOD(detail) || group->isLODPending(detail))
+			{
+				++mNotInstalled;
+			}
+			mVolumes.push_back(std::make_pair(params.getProfileParams().getHollow(), detail));
+		}
+
+		/*virtual*/ void onSculptGenerated(LLVolume* volumep)
+		{
+			mOutsideUpdate += mUpdating ? 0 : 1;
+			mSculpts.push_back(volumep);
+		}
+
+		LLVolumeMgr& mMgr;
+		const bool& mUpdating;
+		S32 mOutsideUpdate;
+		S32 mNotInstalled;
+		std::vector<std::pair<F32, S32> > mVolumes;
+		std::vector<LLVolume*> mSculpts;
+	};
+}
+
+namespace tut
+{
+	struct volumemgr_test
+	{
+		volumemgr_test()
+		:	mUpdating(false)
+		{
+		}
+
+		~volumemgr_test()
+		{
+			mMgr.stopGenerationThreads();
+		}
+
+		// runs frames until nothing is pending, a generous while at most
+		bool runUntilDone()
+		{
+			LLTimer timer;
+			while (mMgr.getPendingGenerationCount() && timer.getElapsedTimeF32() < 30.f)
+			{
+				mUpdating = true;
+				mMgr.updateGeneration();
+				mUpdating = false;
+				if (mMgr.getPendingGenerationCount())
+				{
+					ms_sleep(1);
+				}
+			}
+			return mMgr.getPendingGenerationCount() == 0;
+		}
+
+		LLVolumeMgr mMgr;
+		bool mUpdating;
+	};
+	typedef test_group<volumemgr_test> volumemgr_t;
+	typedef volumemgr_t::object volumemgr_object_t;
+	tut::volumemgr_t tut_volumemgr("LLVolumeMgr");
+
+	// every request is answered once, on the updating thread, after its
+	// LOD is installed; requests for a pending LOD join the queued job
+	template<> template<>
+	void volumemgr_object_t::test<1>()
+	{
+		TestObserver first(mMgr, mUpdating), second(mMgr, mUpdating);
+		mMgr.startGenerationThreads(2);
+
+		// objects keep their current LOD referenced while a finer one is made
+		LLVolumeParams params[3] = { make_params(0.f), make_params(0.25f), make_params(0.5f) };
+		std::vector<LLPointer<LLVolume> > held;
+		for (S32 i = 0; i < 3; ++i)
+		{
+			held.push_back(mMgr.refVolume(params[i], 0));
+		}
+
+		for (S32 i = 0; i < 3; ++i)
+		{
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+			{
+				ensure("queued", mMgr.refVolumeAsync(params[i], detail, &first) == NULL);
+				ensure("pending", mMgr.getGroup(params[i])->isLODPending(detail));
+			}
+		}
+		ensure("joined", mMgr.refVolumeAsync(params[1], 2, &second) == NULL);
+		ensure("joined twice", mMgr.refVolumeAsync(params[1], 2, &second) == NULL);
+		ensure_equals("one job per LOD", mMgr.getPendingGenerationCount(), (U32) 9);
+
+		ensure("finished", runUntilDone());
+		ensure_equals("all answered", first.mVolumes.size(), (size_t) 9);
+		ensure_equals("joined answered once", second.mVolumes.size(), (size_t) 1);
+		ensure_equals("joined LOD", second.mVolumes[0].second, 2);
+		ensure_equals("only from updateGeneration()", first.mOutsideUpdate + second.mOutsideUpdate, 0);
+		ensure_equals("installed before answering", first.mNotInstalled + second.mNotInstalled, 0);
+
+		std::sort(first.mVolumes.begin(), first.mVolumes.end());
+		ensure("no duplicates", std::unique(first.mVolumes.begin(), first.mVolumes.end()) == first.mVolumes.end());
+
+		// finished LODs are handed out right away, the same as refVolume()
+		for (S32 i = 0; i < 3; ++i)
+		{
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+			{
+				LLVolume* volumep = mMgr.refVolumeAsync(params[i], detail, &first);
+				ensure("ready", volumep != NULL);
+				ensure_equals("same detail", volumep->getDetail(), LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+				mMgr.unrefVolume(volumep);
+			}
+		}
+		ensure_equals("nothing queued", mMgr.getPendingGenerationCount(), (U32) 0);
+
+		for (S32 i = 0; i < 3; ++i)
+		{
+			mMgr.unrefVolume(held[i]);
+		}
+		held.clear();
+		ensure("no dangling references", mMgr.cleanup());
+	}
+
+	// a newer sculpt map replaces one still being applied, and only the
+	// newer result reaches the volume, whichever finishes first
+	template<> template<>
+	void volumemgr_object_t::test<2>()
+	{
+		TestObserver observer(mMgr, mUpdating);
+		mMgr.startGenerationThreads(2);
+
+		LLVolumeParams params = make_sculpt_params();
+		LLPointer<LLVolume> volumep = mMgr.refVolume(params, 3);
+		ensure("older map queued", mMgr.sculptAsync(volumep, make_sculpt_map(4, 2), &observer));
+		ensure("newer map queued", mMgr.sculptAsync(volumep, make_sculpt_map(8, 0), &observer));
+		ensure("same map joins", mMgr.sculptAsync(volumep, make_sculpt_map(8, 0), &observer));
+		ensure_equals("both jobs run", mMgr.getPendingGenerationCount(), (U32) 2);
+
+		ensure("finished", runUntilDone());
+		ensure_equals("answered once", observer.mSculpts.size(), (size_t) 1);
+		ensure("for the volume", observer.mSculpts[0] == volumep.get());
+		ensure_equals("only from updateGeneration()", observer.mOutsideUpdate, 0);
+
+		LLPointer<LLVolume> expected = new LLVolume(params, volumep->getDetail(), FALSE, TRUE);
+		LLVolumeMgr::SculptMap newer = make_sculpt_map(8, 0);
+		expected->sculpt(newer.mWidth, newer.mHeight, newer.mComponents, &newer.mData[0], newer.mLevel);
+		ensure("newer map applied", same_positions(volumep, expected));
+		ensure_equals("sculpt level", volumep->getSculptLevel(), 0);
+
+		mMgr.unrefVolume(volumep);
+		volumep = NULL;
+		ensure("no dangling references", mMgr.cleanup());
+	}
+
+	// a cancelled observer hears nothing while the rest still do, and a
+	// LOD nobody holds any more is dropped without an answer
+	template<> template<>
+	void volumemgr_object_t::test<3>()
+	{
+		TestObserver cancelled(mMgr, mUpdating), kept(mMgr, mUpdating);
+		mMgr.startGenerationThreads(1);
+
+		LLVolumeParams params = make_params(0.3f);
+		LLPointer<LLVolume> held = mMgr.refVolume(params, 0);
+		mMgr.refVolumeAsync(params, 3, &cancelled);
+		mMgr.refVolumeAsync(params, 3, &kept);
+		mMgr.refVolumeAsync(params, 2, &cancelled);
+		mMgr.cancelGenerationRequests(&cancelled);
+
+		// nobody references this group but its pending LOD
+		LLVolumeParams orphan = make_params(0.6f);
+		mMgr.refVolumeAsync(orphan, 3, &kept);
+
+		ensure("finished", runUntilDone());
+		ensure_equals("cancelled", cancelled.mVolumes.size(), (size_t) 0);
+		ensure_equals("kept answered", kept.mVolumes.size(), (size_t) 1);
+		ensure_equals("kept LOD", kept.mVolumes[0].second, 3);
+		ensure("cancelled LODs still installed", mMgr.getGroup(params)->hasLOD(2) && mMgr.getGroup(params)->hasLOD(3));
+		ensure("orphan dropped", mMgr.getGroup(orphan) == NULL);
+
+		mMgr.unrefVolume(held);
+		held = NULL;
+		ensure("no dangling references", mMgr.cleanup());
+	}
+
+	// stopping with work queued answers nobody, clears every pending LOD,
+	// and later requests are generated synchronously
+	template<> template<>
+	void volumemgr_object_t::test<4>()
+	{
+		TestObserver observer(mMgr, mUpdating);
+		mMgr.startGenerationThreads(2);
+
+		std::vector<LLVolumeParams> params;
+		std::vector<LLPointer<LLVolume> > held;
+		for (S32 i = 0; i < 20; ++i)
+		{
+			params.push_back(make_params(i * 0.04f));
+			held.push_back(mMgr.refVolume(params.back(), 0));
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+			{
+				mMgr.refVolumeAsync(params.back(), detail, &observer);
+			}
+		}
+		ensure_equals("queued", mMgr.getPendingGenerationCount(), (U32) 60);
+
+		mMgr.stopGenerationThreads();
+		ensure("stopped", !mMgr.isGenerationThreaded());
+		ensure_equals("nothing left", mMgr.getPendingGenerationCount(), (U32) 0);
+		mMgr.updateGeneration();
+		ensure_equals("nobody answered", observer.mVolumes.size(), (size_t) 0);
+
+		for (U32 i = 0; i < params.size(); ++i)
+		{
+			LLVolumeLODGroup* group = mMgr.getGroup(params[i]);
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; ++detail)
+			{
+				ensure("not pending", !group->isLODPending(detail));
+			}
+		}
+
+		LLVolume* volumep = mMgr.refVolumeAsync(params[0], 3, &observer);
+		ensure("synchronous after stopping", volumep != NULL);
+		ensure("still nobody answered", observer.mVolumes.empty());
+		mMgr.unrefVolume(volumep);
+
+		for (U32 i = 0; i < held.size(); ++i)
+		{
+			mMgr.unrefVolume(held[i]);
+		}
+		held.clear();
+		ensure("no dangling references", mMgr.cleanup());
+	}
+}
@@ -150,6 +150,13 @@ public:
 
 	void update();
 	void updateMatrix(BOOL update_bounds = TRUE);
+	// takes what updateMatrix(FALSE) would have worked out
+	void setWorldTransform(const LLVector3& pos, const LLQuaternion& rot, const LLMatrix4& mat)
+	{
+		mWorldPosition = pos;
+		mWorldRotation = rot;
+		mWorldMatrix = mat;
+	}
 	void getMinMax(LLVector3& min,LLVector3& max) const;
 
 protected:
@@ -0,0 +1,275 @@
+/**
+ * @file llmessagereceivethread.cpp
+ * @brief LLMessageReceiveThread class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmessagereceivethread.h"
+
+#include "llmemory.h"
+#include "llpacketring.h"
+#include "lltimer.h"
+#include "message.h"
+#include "net.h"
+
+static const U32 RECORD_ALIGNMENT = 16;
+static const S32 RECEIVE_BATCH = 32;
+// how long the thread blocks in the socket before checking for shutdown
+static const S32 WAIT_TIMEOUT_MS = 50;
+
+LLMessageReceiveThread::LLMessageReceiveThread(LLPacketRing& packet_ring, S32 socket, U32 buffer_size)
+:	LLThread("Message receive"),
+	mPacketRing(packet_ring),
+	mSocket(socket),
+	mBufferSize(RECORD_ALIGNMENT),
+	mHead(0),
+	mTail(0),
+	mPacketsReceived(0),
+	mReceiveCalls(0),
+	mStalls(0),
+	mConsumerWaiting(false),
+	mProducerWaiting(false)
+{
+	// room for at least a couple of the largest records
+	buffer_size = llmax(buffer_size, (U32) (sizeof(Packet) + MAX_BUFFER_SIZE) * 4);
+	while (mBufferSize < buffer_size)
+	{
+		mBufferSize <<= 1;
+	}
+	mBuffer = (U8*) ll_aligned_malloc_16(mBufferSize);
+}
+
+LLMessageReceiveThread::~LLMessageReceiveThread()
+{
+	ll_aligned_free_16(mBuffer);
+}
+
+void LLMessageReceiveThread::run()
+{
+	std::vector<char> storage(RECEIVE_BATCH * NET_BUFFER_SIZE);
+	LLNetPacket packets[RECEIVE_BATCH];
+	for (S32 i = 0; i < RECEIVE_BATCH; ++i)
+	{
+		packets[i].mData = &storage[i * NET_BUFFER_SIZE];
+	}
+
+	while (!isQuitting())
+	{
+		if (!wait_for_packets(mSocket, WAIT_TIMEOUT_MS))
+		{
+			continue;
+		}
+
+		S32 count = mPacketRing.receivePackets(mSocket, packets, RECEIVE_BATCH);
+		mReceiveCalls++;
+
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (!push(packets[i]))
+			{
+				return;
+			}
+		}
+		mPacketsReceived += count;
+		if (count)
+		{
+			wake(mConsumerWaiting);
+		}
+	}
+}
+
+void LLMessageReceiveThread::wake(LLAtomic32<bool>& waiting)
+{
+	// The waiter sets its flag under the lock before it looks at the ring
+	// again, so either it sees what we just published or we see the flag.
+	if (waiting)
+	{
+		mCondition.lock();
+		mCondition.signal();
+		mCondition.unlock();
+	}
+}
+
+bool LLMessageReceiveThread::push(const LLNetPacket& packet)
+{
+	const U8* data = (const U8*) packet.mData;
+	S32 size = packet.mSize;
+
+	// Only the part in front of the appended acks is zero coded.  Packets
+	// with a broken ack count or too short to be valid are passed on as
+	// they are, checkMessages() has the logic to reject them.
+	S32 body_size = size;
+	bool zero_coded = size >= LL_MINIMUM_VALID_PACKET_SIZE && (data[0] & LL_ZERO_CODE_FLAG);
+	if (zero_coded && (data[0] & LL_ACK_FLAG))
+	{
+		S32 acks = data[--body_size];
+		if (body_size >= (S32) (acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+		{
+			body_size -= acks * sizeof(TPACKETID);
+		}
+		else
+		{
+			zero_coded = false;
+		}
+	}
+
+	U32 record_size = sizeof(Packet) + size + (zero_coded ? MAX_BUFFER_SIZE : 0);
+	record_size = (record_size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+
+	// records never wrap, pad out the end of the ring instead
+	U32 head = mHead;
+	U32 offset = head & (mBufferSize - 1);
+	U32 padding = mBufferSize - offset;
+	if (padding >= record_size)
+	{
+		padding = 0;
+	}
+
+	if (mBufferSize - (head - mTail) < padding + record_size)
+	{
+		// the main thread is behind by a whole ring, let the kernel
+		// buffer take up the slack until pop() makes room
+		mStalls++;
+		mCondition.lock();
+		mProducerWaiting = true;
+		while (mBufferSize - (head - mTail) < padding + record_size)
+		{
+			if (isQuitting())
+			{
+				mProducerWaiting = false;
+				mCondition.unlock();
+				return false;
+			}
+			mCondition.wait_for(mCondition, boost::chrono::milliseconds(WAIT_TIMEOUT_MS));
+		}
+		mProducerWaiting = false;
+		mCondition.unlock();
+	}
+
+	if (padding)
+	{
+		if (padding >= sizeof(Packet))
+		{
+			Packet* pad = (Packet*) (mBuffer + offset);
+			pad->mRecordSize = padding;
+			pad->mSize = -1;
+		}
+		head += padding;
+		offset = 0;
+	}
+
+	Packet* packetp = (Packet*) (mBuffer + offset);
+	packetp->mSize = size;
+	packetp->mExpandedSize = NOT_ZERO_CODED;
+	packetp->mSenderIP = packet.mSenderIP;
+	packetp->mSenderPort = packet.mSenderPort;
+	packetp->mReceivingIP = packet.mReceivingIP;
+	U8* dest = (U8*) (packetp + 1);
+	memcpy(dest, data, size);	/* Flawfinder: ignore */
+
+	if (zero_coded)
+	{
+		S32 expanded_size = LLMessageSystem::zeroCodeExpandBuffer(data, body_size, dest + size);
+		packetp->mExpandedSize = expanded_size < 0 ? EXPAND_FAILED : expanded_size;
+		// give back what the decoded body did not use
+		U32 used = sizeof(Packet) + size + llmax(expanded_size, 0);
+		record_size = (used + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+	}
+	packetp->mRecordSize = record_size;
+
+	// publish the record after its contents
+	mHead = head + record_size;
+	return true;
+}
+
+const LLMessageReceiveThread::Packet* LLMessageReceiveThread::front()
+{
+	U32 tail = mTail;
+	const U32 head = mHead;
+	const U32 start = tail;
+	const Packet* packetp = NULL;
+
+	while (tail != head)
+	{
+		U32 offset = tail & (mBufferSize - 1);
+		U32 contiguous = mBufferSize - offset;
+		if (contiguous < sizeof(Packet))
+		{
+			// padding too short to hold a header
+			tail += contiguous;
+			continue;
+		}
+
+		const Packet* recordp = (const Packet*) (mBuffer + offset);
+		if (recordp->mSize < 0)
+		{
+			tail += recordp->mRecordSize;
+			continue;
+		}
+
+		packetp = recordp;
+		break;
+	}
+
+	if (tail != start)
+	{
+		mTail = tail;
+	}
+	return packetp;
+}
+
+void LLMessageReceiveThread::pop()
+{
+	const Packet* packetp = front();
+	if (packetp)
+	{
+		mTail = mTail + packetp->mRecordSize;
+		wake(mProducerWaiting);
+	}
+}
+
+bool LLMessageReceiveThread::waitForPacket(F32 seconds)
+{
+	if (front())
+	{
+		return true;
+	}
+
+	LLTimer timer;
+	mCondition.lock();
+	mConsumerWaiting = true;
+	while (!front())
+	{
+		F32 remaining = seconds - timer.getElapsedTimeF32();
+		if (remaining <= 0.f)
+		{
+			break;
+		}
+		mCondition.wait_for(mCondition, boost::chrono::microseconds((S64) (remaining * 1000000.f)));
+	}
+	mConsumerWaiting = false;
+	mCondition.unlock();
+	return front() != NULL;
+}
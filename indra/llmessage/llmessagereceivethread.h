@@ -0,0 +1,123 @@
+/**
+ * @file llmessagereceivethread.h
+ * @brief LLMessageReceiveThread class, drains the message system socket
+ * on its own thread.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESSAGERECEIVETHREAD_H
+#define LL_LLMESSAGERECEIVETHREAD_H
+
+#include "llatomic.h"
+#include "llhost.h"
+#include "llmutex.h"
+#include "llthread.h"
+
+class LLPacketRing;
+struct LLNetPacket;
+
+// Keeps the socket drained while the main thread is busy with a long
+// frame, so bursts land in a large user space ring instead of overflowing
+// the kernel receive buffer.  Packets are received in batches through
+// LLPacketRing::receivePackets() and zero decoded on this thread, then
+// handed to LLMessageSystem::checkMessages() in arrival order through a
+// single producer, single consumer ring.
+//
+// Circuits and acks are main thread state, so ack and ping processing
+// stays in checkMessages().
+class LLMessageReceiveThread : public LLThread
+{
+public:
+	enum
+	{
+		NOT_ZERO_CODED = -1,	// mExpandedSize of packets to use as received
+		EXPAND_FAILED = -2		// decoding would overflow MAX_BUFFER_SIZE
+	};
+
+	// One received datagram, followed in the ring by its bytes and, if it
+	// was zero coded, by its decoded body without the appended acks.
+	struct Packet
+	{
+		U32		mRecordSize;	// bytes used in the ring, including this header
+		S32		mSize;			// of the datagram, -1 for padding up to the end of the ring
+		S32		mExpandedSize;	// of the decoded body, or one of the values above
+		U32		mSenderIP;
+		U32		mSenderPort;
+		U32		mReceivingIP;
+		U32		mPadding[2];
+
+		LLHost getSender() const			{ return LLHost(mSenderIP, mSenderPort); }
+		LLHost getReceivingInterface() const	{ return LLHost(mReceivingIP, INVALID_PORT); }
+		const U8* getData() const			{ return (const U8*)(this + 1); }
+		const U8* getExpandedData() const	{ return getData() + mSize; }
+	};
+
+	// buffer_size is rounded up to a power of two
+	LLMessageReceiveThread(LLPacketRing& packet_ring, S32 socket, U32 buffer_size = 4 * 1024 * 1024);
+	~LLMessageReceiveThread();
+
+	// Main thread side.  The oldest packet, NULL if none is waiting; it
+	// stays valid until pop().
+	const Packet* front();
+	void pop();
+	// Blocks until a packet is waiting or the time is up, true if one is.
+	bool waitForPacket(F32 seconds);
+
+	U32 getPacketsReceived() const	{ return mPacketsReceived; }
+	U32 getReceiveCalls() const		{ return mReceiveCalls; }
+	U32 getRingFullStalls() const	{ return mStalls; }
+	U32 getBytesQueued() const		{ return mHead - mTail; }
+
+protected:
+	/*virtual*/ void run();
+
+private:
+	// frames packet into the ring, false if the thread is quitting
+	bool push(const LLNetPacket& packet);
+	// wakes the other side if it is blocked in waitForPacket() or push()
+	void wake(LLAtomic32<bool>& waiting);
+
+	LLPacketRing&	mPacketRing;
+	S32				mSocket;
+
+	U8*				mBuffer;
+	U32				mBufferSize;
+
+	// byte positions, only ever increase; mHead is written by the network
+	// thread, mTail by the main thread
+	LLAtomicU32		mHead;
+	LLAtomicU32		mTail;
+
+	LLAtomicU32		mPacketsReceived;
+	LLAtomicU32		mReceiveCalls;
+	LLAtomicU32		mStalls;
+
+	// Either side blocks on mCondition rather than polling: the main
+	// thread for a packet, this thread for room in a full ring.  The
+	// flags keep the other side from locking it when nobody waits.
+	LLCondition			mCondition;
+	LLAtomic32<bool>	mConsumerWaiting;
+	LLAtomic32<bool>	mProducerWaiting;
+};
+
+#endif // LL_LLMESSAGERECEIVETHREAD_H
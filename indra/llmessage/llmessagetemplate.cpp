@@ -171,6 +171,251 @@ std::ostream& operator<<(std::ostream& s, LLMessageTemplate &msg)
 	return s;
 }
 
+// LLMessageTemplateIndex
+
+LLMessageTemplateIndex::LLMessageTemplateIndex(const LLMessageTemplate& message_template)
+{
+	for (LLMessageTemplate::message_block_map_t::const_iterator iter = message_template.mMemberBlocks.begin();
+		 iter != message_template.mMemberBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* blockp = *iter;
+
+		Block block;
+		block.mName = blockp->mName;
+		block.mType = blockp->mType;
+		block.mNumber = blockp->mNumber;
+		block.mFirstVariable = mVariables.size();
+		block.mNumVariables = blockp->mMemberVariables.size();
+		mBlocks.push_back(block);
+
+		for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+			 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+		{
+			const LLMessageVariable* varp = *var_iter;
+
+			Variable var;
+			var.mName = varp->getName();
+			var.mType = varp->getType();
+			var.mSize = varp->getSize();
+			mVariables.push_back(var);
+		}
+	}
+
+	// keep the tables at most half full
+	U32 slots = 8;
+	while (slots < mVariables.size()*2 || slots < mBlocks.size()*2)
+	{
+		slots <<= 1;
+	}
+	mSlotMask = slots - 1;
+	mBlockSlots.assign(slots, -1);
+	mVariableSlots.assign(slots, -1);
+
+	for (U32 i = 0; i < mBlocks.size(); ++i)
+	{
+		U32 slot = hashName(mBlocks[i].mName, 0) & mSlotMask;
+		while (mBlockSlots[slot] != -1)
+		{
+			slot = (slot + 1) & mSlotMask;
+		}
+		mBlockSlots[slot] = i;
+
+		for (U32 j = 0; j < mBlocks[i].mNumVariables; ++j)
+		{
+			slot = hashName(mVariables[mBlocks[i].mFirstVariable + j].mName, i) & mSlotMask;
+			while (mVariableSlots[slot] != -1)
+			{
+				slot = (slot + 1) & mSlotMask;
+			}
+			mVariableSlots[slot] = mBlocks[i].mFirstVariable + j;
+		}
+	}
+}
+
+S32 LLMessageTemplateIndex::findBlock(const char* name) const
+{
+	for (U32 slot = hashName(name, 0) & mSlotMask; mBlockSlots[slot] != -1; slot = (slot + 1) & mSlotMask)
+	{
+		if (mBlocks[mBlockSlots[slot]].mName == name)
+		{
+			return mBlockSlots[slot];
+		}
+	}
+	return -1;
+}
+
+S32 LLMessageTemplateIndex::findVariable(S32 block, const char* name) const
+{
+	const U32 first = mBlocks[block].mFirstVariable;
+	for (U32 slot = hashName(name, block) & mSlotMask; mVariableSlots[slot] != -1; slot = (slot + 1) & mSlotMask)
+	{
+		const S32 var = mVariableSlots[slot];
+		if (mVariables[var].mName == name && (U32) var - first < mBlocks[block].mNumVariables)
+		{
+			return var - first;
+		}
+	}
+	return -1;
+}
+
+// LLMessageTemplateTable
+
+LLMessageTemplateTable::LLMessageTemplateTable()
+:	mBucketMask(0),
+	mSlotMask(0),
+	mNameHashDirty(true)
+{
+	memset(mHigh, 0, sizeof(mHigh));
+	memset(mMedium, 0, sizeof(mMedium));
+	memset(mFixed, 0, sizeof(mFixed));
+}
+
+void LLMessageTemplateTable::add(LLMessageTemplate* templatep)
+{
+	// a template with the same name replaces the old one, like it would in
+	// the name map
+	std::vector<LLMessageTemplate*>::iterator it = mTemplates.begin();
+	for ( ; it != mTemplates.end(); ++it)
+	{
+		if ((*it)->mName == templatep->mName)
+		{
+			LLMessageTemplate** slotp = numberSlot((*it)->mMessageNumber);
+			if (slotp && *slotp == *it)
+			{
+				*slotp = NULL;
+			}
+			*it = templatep;
+			break;
+		}
+	}
+	if (it == mTemplates.end())
+	{
+		mTemplates.push_back(templatep);
+	}
+	mNameHashDirty = true;
+
+	U32 number = templatep->mMessageNumber;
+	if ((number >> 16) == 0xFFFF && (number & 0xFFFF) >= mLow.size() && ((number >> 8) & 0xFF) != 0xFF)
+	{
+		mLow.resize((number & 0xFFFF) + 1, NULL);
+	}
+	LLMessageTemplate** slotp = numberSlot(number);
+	if (slotp)
+	{
+		*slotp = templatep;
+	}
+	else
+	{
+		LL_WARNS() << "Message " << templatep->mName << " has number " << std::hex << number << std::dec
+			<< " outside of the frequency ranges" << LL_ENDL;
+	}
+}
+
+LLMessageTemplate** LLMessageTemplateTable::numberSlot(U32 number)
+{
+	if (number < 0xFF)
+	{
+		return &mHigh[number];
+	}
+	if ((number >> 8) == 0xFF)
+	{
+		return &mMedium[number & 0xFF];
+	}
+	if ((number >> 16) == 0xFFFF)
+	{
+		U32 low = number & 0xFFFF;
+		if ((low >> 8) == 0xFF)
+		{
+			return &mFixed[low & 0xFF];
+		}
+		return low < mLow.size() ? &mLow[low] : NULL;
+	}
+	return NULL;
+}
+
+void LLMessageTemplateTable::buildNameHash() const
+{
+	const U32 count = mTemplates.size();
+	U32 buckets = 1;
+	while (buckets * 2 < count)
+	{
+		buckets <<= 1;
+	}
+	U32 slots = 1;
+	while (slots < count * 2)
+	{
+		slots <<= 1;
+	}
+
+	std::vector<std::vector<LLMessageTemplate*> > bucket_templates(buckets);
+	for (U32 i = 0; i < count; ++i)
+	{
+		bucket_templates[hashName(mTemplates[i]->mName, 0) & (buckets - 1)].push_back(mTemplates[i]);
+	}
+
+	// place the fullest buckets first, while most slots are free
+	std::vector<std::pair<U32, U32> > order;
+	for (U32 i = 0; i < buckets; ++i)
+	{
+		if (!bucket_templates[i].empty())
+		{
+			order.push_back(std::make_pair((U32) bucket_templates[i].size(), i));
+		}
+	}
+	std::sort(order.rbegin(), order.rend());
+
+	const U32 MAX_SALT = 1 << 16;
+	bool placed = false;
+	while (!placed)
+	{
+		mDisplacements.assign(buckets, 0);
+		mNameSlots.assign(slots, NULL);
+		mBucketMask = buckets - 1;
+		mSlotMask = slots - 1;
+
+		placed = true;
+		for (U32 i = 0; i < order.size() && placed; ++i)
+		{
+			const std::vector<LLMessageTemplate*>& members = bucket_templates[order[i].second];
+			U32 salt = 1;
+			for ( ; salt < MAX_SALT; ++salt)
+			{
+				U32 j = 0;
+				for ( ; j < members.size(); ++j)
+				{
+					U32 slot = hashName(members[j]->mName, salt) & mSlotMask;
+					if (mNameSlots[slot])
+					{
+						break;
+					}
+					// claim it now so the rest of the bucket can't collide with it
+					mNameSlots[slot] = members[j];
+				}
+				if (j == members.size())
+				{
+					break;
+				}
+				while (j--)
+				{
+					mNameSlots[hashName(members[j]->mName, salt) & mSlotMask] = NULL;
+				}
+			}
+
+			if (salt == MAX_SALT)
+			{
+				// practically never, give it more room and start over
+				slots <<= 1;
+				placed = false;
+			}
+			else
+			{
+				mDisplacements[order[i].second] = salt;
+			}
+		}
+	}
+	mNameHashDirty = false;
+}
+
 void LLMessageTemplate::banUdp()
 {
 	static const char* deprecation[] = {
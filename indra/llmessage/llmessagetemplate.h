@@ -30,6 +30,8 @@
 #include "message.h" // TODO: babbage: Remove...
 #include "llstl.h"
 #include "llindexedvector.h"
+#include "llpointer.h"
+#include "llrefcount.h"
 
 class LLMsgVarData
 {
@@ -101,6 +103,12 @@ public:
 		temp->addData(data, size, type, data_size);
 	}
 
+	// by position, addVariable() was called in template order
+	void addData(S32 var_index, const void *data, S32 size, EMsgVariableType type, S32 data_size = -1)
+	{
+		mMemberVarData.at(var_index).addData(data, size, type, data_size);
+	}
+
 	S32									mBlockNumber;
 	typedef LLIndexedVector<LLMsgVarData, const char *, 8> msg_var_data_map_t;
 	msg_var_data_map_t					mMemberVarData;
@@ -264,6 +272,58 @@ enum EMsgDeprecation
 };
 
 
+class LLMessageTemplate;
+
+// Flattened copy of a message template's blocks and variables in template
+// order, so a decoded message can be stored in flat arrays and blocks and
+// variables found by their canonical name pointers in constant time.
+class LLMessageTemplateIndex : public LLRefCount
+{
+public:
+	struct Variable
+	{
+		char*				mName;
+		EMsgVariableType	mType;
+		S32					mSize;	// bytes of data, or of the length prefix for MVT_VARIABLE
+	};
+
+	struct Block
+	{
+		char*				mName;
+		EMsgBlockType		mType;
+		S32					mNumber;
+		U32					mFirstVariable;	// index into mVariables
+		U32					mNumVariables;
+	};
+
+	LLMessageTemplateIndex(const LLMessageTemplate& message_template);
+
+	// -1 if name is not a block of this message
+	S32 findBlock(const char* name) const;
+
+	// index of the variable within block, -1 if it isn't one of its variables
+	S32 findVariable(S32 block, const char* name) const;
+
+	const Variable& getVariable(S32 block, S32 var) const
+	{
+		return mVariables[mBlocks[block].mFirstVariable + var];
+	}
+
+	std::vector<Block>		mBlocks;
+	std::vector<Variable>	mVariables;
+
+private:
+	static U32 hashName(const char* name, U32 salt)
+	{ // canonical names are unique pointers, the low bits are mostly alignment
+		return (U32) (((uintptr_t) name >> 4) * 2654435761u) ^ (salt * 0x9E3779B1u);
+	}
+
+	// open addressed, power of two sized, -1 marks an empty slot
+	std::vector<S32>		mBlockSlots;
+	std::vector<S32>		mVariableSlots;
+	U32						mSlotMask;
+};
+
 class LLMessageTemplate
 {
 public:
@@ -306,6 +366,7 @@ public:
 				<< "has already been used as a block name!" << LL_ENDL;
 		}
 		*member_blockp = blockp;
+		mIndex = NULL;
 		if (  (mTotalSize != -1)
 			&&(blockp->mTotalSize != -1)
 			&&(  (blockp->mType == MBT_SINGLE)
@@ -391,6 +452,16 @@ public:
 		return iter != mMemberBlocks.end()? *iter : NULL;
 	}
 
+	// built on first use, templates must be complete by then
+	const LLMessageTemplateIndex* getIndex() const
+	{
+		if (mIndex.isNull())
+		{
+			mIndex = new LLMessageTemplateIndex(*this);
+		}
+		return mIndex;
+	}
+
 public:
 	typedef LLIndexedVector<LLMessageBlock*, char*, 8> message_block_map_t;
 	message_block_map_t						mMemberBlocks;
@@ -416,6 +487,86 @@ private:
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
 	void									**mUserData;
+
+	mutable LLPointer<LLMessageTemplateIndex>	mIndex;
+};
+
+// Finds registered templates without map lookups.  Message numbers come
+// in three dense ranges, one per frequency, and are direct indexed.  Names
+// are canonical string table pointers and go through a perfect hash that
+// is regenerated on the first lookup after templates were added, i.e.
+// once after message_template.msg is loaded.
+class LLMessageTemplateTable
+{
+public:
+	LLMessageTemplateTable();
+
+	// does not take ownership
+	void add(LLMessageTemplate* templatep);
+
+	LLMessageTemplate* findByNumber(U32 number) const
+	{
+		if (number < 0xFF)
+		{
+			return mHigh[number];
+		}
+		if ((number >> 8) == 0xFF)
+		{
+			return mMedium[number & 0xFF];
+		}
+		if ((number >> 16) == 0xFFFF)
+		{
+			U32 low = number & 0xFFFF;
+			if ((low >> 8) == 0xFF)
+			{
+				return mFixed[low & 0xFF];
+			}
+			return low < mLow.size() ? mLow[low] : NULL;
+		}
+		return NULL;
+	}
+
+	LLMessageTemplate* findByName(const char* name) const
+	{
+		if (mNameHashDirty)
+		{
+			buildNameHash();
+		}
+		U32 salt = mDisplacements[hashName(name, 0) & mBucketMask];
+		LLMessageTemplate* templatep = mNameSlots[hashName(name, salt) & mSlotMask];
+		return templatep && templatep->mName == name ? templatep : NULL;
+	}
+
+	S32 size() const						{ return (S32) mTemplates.size(); }
+
+private:
+	static U32 hashName(const char* name, U32 salt)
+	{
+		U64 x = (U64) (uintptr_t) name ^ ((U64) salt * 0x9E3779B97F4A7C15ULL);
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDULL;
+		x ^= x >> 33;
+		return (U32) x;
+	}
+
+	// where number lives in the tables below, NULL if it is out of range
+	LLMessageTemplate** numberSlot(U32 number);
+	void buildNameHash() const;
+
+	std::vector<LLMessageTemplate*>	mTemplates;
+
+	LLMessageTemplate*				mHigh[0xFF];		// 1 to 0xFE, one byte
+	LLMessageTemplate*				mMedium[0x100];		// 0xFF01 to 0xFFFE, two bytes
+	std::vector<LLMessageTemplate*>	mLow;				// 0xFFFF0001 up, four bytes
+	LLMessageTemplate*				mFixed[0x100];		// 0xFFFFFF00 up, the Fixed numbers
+
+	// hash and displace: every bucket has a salt that sends its names to
+	// free slots, so a lookup is two hashes and one compare
+	mutable std::vector<U32>				mDisplacements;
+	mutable std::vector<LLMessageTemplate*>	mNameSlots;
+	mutable U32								mBucketMask;
+	mutable U32								mSlotMask;
+	mutable bool							mNameHashDirty;
 };
 
 #endif // LL_LLMESSAGETEMPLATE_H
@@ -37,12 +37,21 @@
 
 // linden library includes
 #include "llerror.h"
+#include "llfasttimer.h"
 #include "lltimer.h"
+#include "lltrace.h"
 #include "llproxy.h"
 #include "llrand.h"
 #include "message.h"
 #include "u64.h"
 
+// enough for a busy frame, more than that is sent early
+static const S32 MAX_QUEUED_SENDS = 64;
+
+static LLTrace::CountStatHandle<> sSendSyscalls("udpsendcalls", "Number of system calls made to send UDP packets");
+static LLTrace::CountStatHandle<> sPacketsSent("udppacketssent", "Number of UDP packets handed to the OS");
+static LLTrace::BlockTimerStatHandle FTM_SEND_PACKETS("Send Packets");
+
 ///////////////////////////////////////////////////////////
 LLPacketRing::LLPacketRing () :
 	mUseInThrottle(FALSE),
@@ -55,7 +64,11 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mBatchSends(FALSE),
+	mQueuedSendCount(0),
+	mQueuedSendSocket(0),
+	mQueuedSendFailures(0)
 {
 }
 
@@ -88,17 +101,20 @@ void LLPacketRing::cleanup ()
 ///////////////////////////////////////////////////////////
 void LLPacketRing::dropPackets (U32 num_to_drop)
 {
+	LLMutexLock lock(&mReceiveMutex);
 	mPacketsToDrop += num_to_drop;
 }
 
 ///////////////////////////////////////////////////////////
 void LLPacketRing::setDropPercentage (F32 percent_to_drop)
 {
+	LLMutexLock lock(&mReceiveMutex);
 	mDropPercentage = percent_to_drop;
 }
 
 void LLPacketRing::setUseInThrottle(const BOOL use_throttle)
 {
+	LLMutexLock lock(&mReceiveMutex);
 	mUseInThrottle = use_throttle;
 }
 
@@ -107,8 +123,22 @@ void LLPacketRing::setUseOutThrottle(const BOOL use_throttle)
 	mUseOutThrottle = use_throttle;
 }
 
+void LLPacketRing::setBatchSends(const BOOL batch_sends)
+{
+	if (!batch_sends && mQueuedSendCount)
+	{
+		flushSends(mQueuedSendSocket);
+	}
+	mBatchSends = batch_sends;
+	if (mBatchSends && mQueuedSends.empty())
+	{
+		mQueuedSends.resize(MAX_QUEUED_SENDS);
+	}
+}
+
 void LLPacketRing::setInBandwidth(const F32 bps)
 {
+	LLMutexLock lock(&mReceiveMutex);
 	mInThrottle.setRate(bps);
 }
 
@@ -117,7 +147,7 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 	mOutThrottle.setRate(bps);
 }
 ///////////////////////////////////////////////////////////
-S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
+S32 LLPacketRing::receiveFromRing (S32 socket, char *datap, LLHost& sender, LLHost& receiving_if)
 {
 
 	if (mInThrottle.checkOverflow(0))
@@ -142,8 +172,8 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 		memcpy(datap, packetp->getData(), packet_size);	/*Flawfinder: ignore*/
 	}
 	// need to set sender IP/port!!
-	mLastSender = packetp->getHost();
-	mLastReceivingIF = packetp->getReceivingInterface();
+	sender = packetp->getHost();
+	receiving_if = packetp->getReceivingInterface();
 	delete packetp;
 
 	this->mInBufferLength -= packet_size;
@@ -155,6 +185,12 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receivePacket (S32 socket, char *datap)
+{
+	LLMutexLock lock(&mReceiveMutex);
+	return receivePacket(socket, datap, mLastSender, mLastReceivingIF);
+}
+
+S32 LLPacketRing::receivePacket (S32 socket, char *datap, LLHost& sender, LLHost& receiving_if)
 {
 	S32 packet_size = 0;
 
@@ -219,7 +255,7 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 
 		// Now, grab data off of the receive queue according to our
 		// throttled bandwidth settings.
-		packet_size = receiveFromRing(socket, datap);
+		packet_size = receiveFromRing(socket, datap, sender, receiving_if);
 	}
 	else
 	{
@@ -234,8 +270,8 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 				// *FIX We are assuming ATYP is 0x01 (IPv4), not 0x03 (hostname) or 0x04 (IPv6)
 				memcpy(datap, buffer + SOCKS_HEADER_SIZE, packet_size - SOCKS_HEADER_SIZE);
 				proxywrap_t * header = static_cast<proxywrap_t*>(static_cast<void*>(buffer));
-				mLastSender.setAddress(header->addr);
-				mLastSender.setPort(ntohs(header->port));
+				sender.setAddress(header->addr);
+				sender.setPort(ntohs(header->port));
 
 				packet_size -= SOCKS_HEADER_SIZE; // The unwrapped packet size
 			}
@@ -247,10 +283,10 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		else
 		{
 			packet_size = receive_packet(socket, datap);
-			mLastSender = ::get_sender();
+			sender = ::get_sender();
 		}
 
-		mLastReceivingIF = ::get_receiving_interface();
+		receiving_if = ::get_receiving_interface();
 
 		if (packet_size)  // did we actually get a packet?
 		{
@@ -270,6 +306,59 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	return packet_size;
 }
 
+S32 LLPacketRing::receivePackets (S32 socket, LLNetPacket* packets, S32 count)
+{
+	LLMutexLock lock(&mReceiveMutex);
+	S32 received = 0;
+
+	if (mUseInThrottle || LLProxy::isSOCKSProxyEnabled())
+	{
+		// simulated bandwidth and proxy unwrapping stay one packet at a time
+		while (received < count)
+		{
+			LLNetPacket& packet = packets[received];
+			LLHost sender;
+			LLHost receiving_if;
+			packet.mSize = receivePacket(socket, packet.mData, sender, receiving_if);
+			if (!packet.mSize)
+			{
+				break;
+			}
+			packet.mSenderIP = sender.getAddress();
+			packet.mSenderPort = sender.getPort();
+			packet.mReceivingIP = receiving_if.getAddress();
+			++received;
+		}
+		return received;
+	}
+
+	S32 batch = receive_packets(socket, packets, count);
+	for (S32 i = 0; i < batch; ++i)
+	{
+		if (packets[i].mSize)
+		{
+			if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
+			{
+				mPacketsToDrop++;
+			}
+
+			if (mPacketsToDrop)
+			{
+				mPacketsToDrop--;
+				continue;
+			}
+		}
+
+		if (received != i)
+		{
+			// swap rather than copy, so every buffer stays owned by one entry
+			std::swap(packets[received], packets[i]);
+		}
+		++received;
+	}
+	return received;
+}
+
 BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host)
 {
 	BOOL status = TRUE;
@@ -344,9 +433,84 @@ BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LL
 	return status;
 }
 
+S32 LLPacketRing::flushSends(int h_socket)
+{
+	S32 failures = mQueuedSendFailures;
+	mQueuedSendFailures = 0;
+	if (!mQueuedSendCount)
+	{
+		return failures;
+	}
+	LL_RECORD_BLOCK_TIME(FTM_SEND_PACKETS);
+
+	LLNetSendPacket packets[MAX_QUEUED_SENDS];
+	for (S32 i = 0; i < mQueuedSendCount; ++i)
+	{
+		QueuedPacket& queued = mQueuedSends[i];
+		LLNetSendPacket& packet = packets[i];
+		packet.mData = queued.mData;
+		packet.mSize = queued.mSize + queued.mHeaderSize;
+		if (queued.mHeaderSize)
+		{
+			packet.mRecipientIP = LLProxy::getInstance()->getUDPProxy().getAddress();
+			packet.mRecipientPort = LLProxy::getInstance()->getUDPProxy().getPort();
+		}
+		else
+		{
+			packet.mRecipientIP = queued.mHost.getAddress();
+			packet.mRecipientPort = queued.mHost.getPort();
+		}
+		packet.mSent = FALSE;
+	}
+
+	S32 calls = send_packets(h_socket, packets, mQueuedSendCount);
+	add(sSendSyscalls, calls);
+	add(sPacketsSent, mQueuedSendCount);
+
+	for (S32 i = 0; i < mQueuedSendCount; ++i)
+	{
+		if (!packets[i].mSent)
+		{
+			failures++;
+		}
+	}
+	mQueuedSendCount = 0;
+	return failures;
+}
+
 BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host)
 {
-	
+	if (mBatchSends)
+	{
+		if (mQueuedSendCount == MAX_QUEUED_SENDS
+			|| (mQueuedSendCount && h_socket != mQueuedSendSocket))
+		{
+			// reported by the next flushSends()
+			mQueuedSendFailures += flushSends(mQueuedSendSocket);
+		}
+
+		QueuedPacket& queued = mQueuedSends[mQueuedSendCount++];
+		queued.mHost = host;
+		queued.mSize = buf_size;
+		queued.mHeaderSize = 0;
+		if (LLProxy::isSOCKSProxyEnabled())
+		{
+			proxywrap_t *socks_header = static_cast<proxywrap_t*>(static_cast<void*>(queued.mData));
+			socks_header->rsv   = 0;
+			socks_header->addr  = host.getAddress();
+			socks_header->port  = htons(host.getPort());
+			socks_header->atype = ADDRESS_IPV4;
+			socks_header->frag  = 0;
+			queued.mHeaderSize = SOCKS_HEADER_SIZE;
+		}
+		memcpy(queued.getPacket(), send_buffer, buf_size);	/* Flawfinder: ignore */
+		mQueuedSendSocket = h_socket;
+		return TRUE;
+	}
+
+	add(sSendSyscalls, 1);
+	add(sPacketsSent, 1);
+
 	if (!LLProxy::isSOCKSProxyEnabled())
 	{
 		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
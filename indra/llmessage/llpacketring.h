@@ -29,8 +29,10 @@
 #define LL_LLPACKETRING_H
 
 #include <queue>
+#include <vector>
 
 #include "llhost.h"
+#include "llmutex.h"
 #include "llpacketbuffer.h"
 #include "llproxy.h"
 #include "llthrottle.h"
@@ -51,16 +53,46 @@ public:
 	void setInBandwidth(const F32 bps);
 	void setOutBandwidth(const F32 bps);
 	S32  receivePacket (S32 socket, char *datap);
-	S32  receiveFromRing (S32 socket, char *datap);
+
+	// Batched receivePacket() for the network receive thread, which then
+	// owns the receive side of the ring.  Fills in up to count packets,
+	// returns how many.  Each packet carries its own sender, the last
+	// sender is left to receivePacket().
+	S32  receivePackets (S32 socket, LLNetPacket* packets, S32 count);
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
+	// With batching on, sendPacket() holds packets back until
+	// flushSends(), which hands them to the OS a batch at a time.
+	void setBatchSends(const BOOL batch_sends);
+	BOOL getBatchSends() const					{ return mBatchSends; }
+	// Returns the number of packets that failed to send.
+	S32  flushSends(int h_socket);
+
+	// A packet held back for the next flushSends()
+	struct QueuedPacket
+	{
+		LLHost	mHost;			// destination circuit, also when sent through the SOCKS proxy
+		S32		mSize;			// without the proxy header
+		S32		mHeaderSize;	// of the proxy header in front of the packet
+		char	mData[NET_BUFFER_SIZE + SOCKS_HEADER_SIZE];
+
+		char* getPacket()						{ return mData + mHeaderSize; }
+	};
+	S32 getQueuedSendCount() const				{ return mQueuedSendCount; }
+	QueuedPacket& getQueuedSend(S32 i)			{ return mQueuedSends[i]; }
+
 	inline LLHost getLastSender();
 	inline LLHost getLastReceivingInterface();
 
-	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
+	S32 getAndResetActualInBits()				{ LLMutexLock lock(&mReceiveMutex); S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
 protected:
+	// Guards the receive side below, which the main thread sets up and the
+	// message receive thread uses: in-throttle, simulated drops and the
+	// last sender.
+	LLMutex mReceiveMutex;
+
 	BOOL mUseInThrottle;
 	BOOL mUseOutThrottle;
 	
@@ -83,18 +115,30 @@ protected:
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
+	BOOL mBatchSends;
+	std::vector<QueuedPacket> mQueuedSends;
+	S32 mQueuedSendCount;
+	S32 mQueuedSendSocket;
+	S32 mQueuedSendFailures;	// from flushes forced by a full queue
+
 private:
+	// mReceiveMutex is held, the sender is returned rather than kept
+	S32  receivePacket (S32 socket, char *datap, LLHost& sender, LLHost& receiving_if);
+	S32  receiveFromRing (S32 socket, char *datap, LLHost& sender, LLHost& receiving_if);
+
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host);
 };
 
 
 inline LLHost LLPacketRing::getLastSender()
 {
+	LLMutexLock lock(&mReceiveMutex);
 	return mLastSender;
 }
 
 inline LLHost LLPacketRing::getLastReceivingInterface()
 {
+	LLMutexLock lock(&mReceiveMutex);
 	return mLastReceivingIF;
 }
 
@@ -298,6 +298,10 @@ private:
 	// Instead use enableHTTPProxy() and disableHTTPProxy() instead.
 	mutable LLAtomic32<bool> mHTTPProxyEnabled;
 
+	// Is the UDP proxy enabled? Safe to read in any thread, the message
+	// receive thread checks it for every batch.  Only written in the main thread.
+	static LLAtomic32<bool> sUDPProxyEnabled;
+
 	// Mutex to protect shared members in non-main thread calls to applyProxySettings().
 	mutable LLMutex mProxyMutex;
 
@@ -305,9 +309,6 @@ private:
 	MEMBERS READ AND WRITTEN ONLY IN THE MAIN THREAD. DO NOT SHARE!
 	###########################################################################################*/
 
-	// Is the UDP proxy enabled?
-	static bool sUDPProxyEnabled;
-
 	// UDP proxy address and port
 	LLHost mUDPProxy;
 	// TCP proxy control channel address and port
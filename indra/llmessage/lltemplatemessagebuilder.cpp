@@ -29,6 +29,7 @@
 #include "lltemplatemessagebuilder.h"
 
 #include "llmessagetemplate.h"
+#include "llzerocode.h"
 #include "llmath.h"
 #include "llquaternion.h"
 #include "u64.h"
@@ -36,16 +37,18 @@
 #include "v3math.h"
 #include "v4math.h"
 
-LLTemplateMessageBuilder::LLTemplateMessageBuilder(const message_template_name_map_t& name_template_map) :
+LLTemplateMessageBuilder::LLTemplateMessageBuilder(const LLMessageTemplateTable& message_templates) :
 	mCurrentSMessageData(NULL),
 	mCurrentSMessageTemplate(NULL),
+	mCurrentSMessageIndex(NULL),
 	mCurrentSDataBlock(NULL),
 	mCurrentSMessageName(NULL),
 	mCurrentSBlockName(NULL),
+	mCurrentSBlockIndex(-1),
 	mbSBuilt(FALSE),
 	mbSClear(TRUE),
 	mCurrentSendTotal(0),
-	mMessageTemplates(name_template_map)
+	mMessageTemplates(message_templates)
 {
 }
 
@@ -68,16 +71,18 @@ void LLTemplateMessageBuilder::newMessage(const char *name)
 	mCurrentSMessageData = NULL;
 
 	char* namep = (char*)name; 
-	if (mMessageTemplates.count(namep) > 0)
+	const LLMessageTemplate* msg_template = mMessageTemplates.findByName(namep);
+	if (msg_template)
 	{
-		mCurrentSMessageTemplate = mMessageTemplates.find(name)->second;
+		mCurrentSMessageTemplate = msg_template;
+		mCurrentSMessageIndex = msg_template->getIndex();
 		mCurrentSMessageData = new LLMsgData(namep);
 		mCurrentSMessageName = namep;
 		mCurrentSDataBlock = NULL;
 		mCurrentSBlockName = NULL;
+		mCurrentSBlockIndex = -1;
 
 		// add at one of each block
-		const LLMessageTemplate* msg_template = mMessageTemplates.find(name)->second;
 
 		if (msg_template->getDeprecation() != MD_NOTDEPRECATED)
 		{
@@ -109,6 +114,7 @@ void LLTemplateMessageBuilder::clearMessage()
 	mCurrentSendTotal = 0;
 
 	mCurrentSMessageTemplate = NULL;
+	mCurrentSMessageIndex = NULL;
 
 	delete mCurrentSMessageData;
 	mCurrentSMessageData = NULL;
@@ -116,6 +122,7 @@ void LLTemplateMessageBuilder::clearMessage()
 	mCurrentSMessageName = NULL;
 	mCurrentSDataBlock = NULL;
 	mCurrentSBlockName = NULL;
+	mCurrentSBlockIndex = -1;
 }
 
 // virtual
@@ -130,13 +137,14 @@ void LLTemplateMessageBuilder::nextBlock(const char* blockname)
 	}
 
 	// now, does this block exist?
-	const LLMessageBlock* template_data = mCurrentSMessageTemplate->getBlock(bnamep);
-	if (!template_data)
+	S32 block_index = mCurrentSMessageIndex->findBlock(bnamep);
+	if (block_index < 0)
 	{
 		LL_ERRS() << "LLTemplateMessageBuilder::nextBlock " << bnamep
 			<< " not a block in " << mCurrentSMessageTemplate->mName << LL_ENDL;
 		return;
 	}
+	const LLMessageTemplateIndex::Block* template_data = &mCurrentSMessageIndex->mBlocks[block_index];
 	
 	// ok, have we already set this block?
 	LLMsgBlkData* block_data = mCurrentSMessageData->mMemberBlocks[bnamep];
@@ -146,13 +154,14 @@ void LLTemplateMessageBuilder::nextBlock(const char* blockname)
 		block_data->mBlockNumber = 1;
 		mCurrentSDataBlock = block_data;
 		mCurrentSBlockName = bnamep;
+		mCurrentSBlockIndex = block_index;
 
-		// add placeholders for each of the variables
-		for (LLMessageBlock::message_variable_map_t::const_iterator iter = template_data->mMemberVariables.begin();
-			 iter != template_data->mMemberVariables.end(); iter++)
+		// add placeholders for each of the variables, in template order
+		// so addData() can find them by position
+		for (U32 i = 0; i < template_data->mNumVariables; ++i)
 		{
-			LLMessageVariable& ci = **iter;
-			mCurrentSDataBlock->addVariable(ci.getName(), ci.getType());
+			const LLMessageTemplateIndex::Variable& ci = mCurrentSMessageIndex->getVariable(block_index, i);
+			mCurrentSDataBlock->addVariable(ci.mName, ci.mType);
 		}
 		return;
 	}
@@ -205,15 +214,13 @@ void LLTemplateMessageBuilder::nextBlock(const char* blockname)
 		mCurrentSDataBlock = new LLMsgBlkData(bnamep, count);
 		mCurrentSDataBlock->mName = nbnamep;
 		mCurrentSMessageData->mMemberBlocks[nbnamep] = mCurrentSDataBlock;
+		mCurrentSBlockIndex = block_index;
 
 		// add placeholders for each of the variables
-		for (LLMessageBlock::message_variable_map_t::const_iterator
-				 iter = template_data->mMemberVariables.begin(),
-				 end = template_data->mMemberVariables.end();
-			 iter != end; iter++)
+		for (U32 i = 0; i < template_data->mNumVariables; ++i)
 		{
-			LLMessageVariable& ci = **iter;
-			mCurrentSDataBlock->addVariable(ci.getName(), ci.getType());
+			const LLMessageTemplateIndex::Variable& ci = mCurrentSMessageIndex->getVariable(block_index, i);
+			mCurrentSDataBlock->addVariable(ci.mName, ci.mType);
 		}
 		return;
 	}
@@ -302,18 +309,19 @@ void LLTemplateMessageBuilder::addData(const char *varname, const void *data, EM
 	}
 
 	// kewl, add the data if it exists
-	const LLMessageVariable* var_data = mCurrentSMessageTemplate->getBlock(mCurrentSBlockName)->getVariable(vnamep);
-	if (!var_data || !var_data->getName())
+	S32 var_index = mCurrentSMessageIndex->findVariable(mCurrentSBlockIndex, vnamep);
+	if (var_index < 0)
 	{
 		LL_ERRS() << vnamep << " not a variable in block " << mCurrentSBlockName << " of " << mCurrentSMessageTemplate->mName << LL_ENDL;
 		return;
 	}
+	const LLMessageTemplateIndex::Variable* var_data = &mCurrentSMessageIndex->getVariable(mCurrentSBlockIndex, var_index);
 
 	// ok, it seems ok. . . are we the correct size?
-	if (var_data->getType() == MVT_VARIABLE)
+	if (var_data->mType == MVT_VARIABLE)
 	{
 		// Variable 1 can only store 255 bytes, make sure our data is smaller
-		if ((var_data->getSize() == 1) &&
+		if ((var_data->mSize == 1) &&
 			(size > 255))
 		{
 			LL_WARNS() << "Field " << varname << " is a Variable 1 but program "
@@ -325,19 +333,19 @@ void LLTemplateMessageBuilder::addData(const char *varname, const void *data, EM
 		}
 
 		// no correct size for MVT_VARIABLE, instead we need to tell how many bytes the size will be encoded as
-		mCurrentSDataBlock->addData(vnamep, data, size, type, var_data->getSize());
+		mCurrentSDataBlock->addData(var_index, data, size, type, var_data->mSize);
 		mCurrentSendTotal += size;
 	}
 	else
 	{
-		if (size != var_data->getSize())
+		if (size != var_data->mSize)
 		{
 			LL_ERRS() << varname << " is type MVT_FIXED but request size " << size << " doesn't match template size "
-				   << var_data->getSize() << LL_ENDL;
+				   << var_data->mSize << LL_ENDL;
 			return;
 		}
 		// alright, smash it in
-		mCurrentSDataBlock->addData(vnamep, data, size, type);
+		mCurrentSDataBlock->addData(var_index, data, size, type);
 		mCurrentSendTotal += size;
 	}
 }
@@ -362,15 +370,16 @@ void LLTemplateMessageBuilder::addData(const char *varname, const void *data, EM
 	}
 
 	// kewl, add the data if it exists
-	const LLMessageVariable* var_data = mCurrentSMessageTemplate->getBlock(mCurrentSBlockName)->getVariable(vnamep);
-	if (!var_data->getName())
+	S32 var_index = mCurrentSMessageIndex->findVariable(mCurrentSBlockIndex, vnamep);
+	if (var_index < 0)
 	{
 		LL_ERRS() << vnamep << " not a variable in block " << mCurrentSBlockName << " of " << mCurrentSMessageTemplate->mName << LL_ENDL;
 		return;
 	}
+	const LLMessageTemplateIndex::Variable* var_data = &mCurrentSMessageIndex->getVariable(mCurrentSBlockIndex, var_index);
 
 	// ok, it seems ok. . . are we MVT_VARIABLE?
-	if (var_data->getType() == MVT_VARIABLE)
+	if (var_data->mType == MVT_VARIABLE)
 	{
 		// nope
 		LL_ERRS() << vnamep << " is type MVT_VARIABLE. Call using addData(name, data, size)" << LL_ENDL;
@@ -378,8 +387,8 @@ void LLTemplateMessageBuilder::addData(const char *varname, const void *data, EM
 	}
 	else
 	{
-		mCurrentSDataBlock->addData(vnamep, data, var_data->getSize(), type);
-		mCurrentSendTotal += var_data->getSize();
+		mCurrentSDataBlock->addData(var_index, data, var_data->mSize, type);
+		mCurrentSendTotal += var_data->mSize;
 	}
 }
 
@@ -500,63 +509,12 @@ static S32 zero_code(U8 **data, U32 *data_size)
 	// coding can potentially increase the size of the send data.
 	static U8 encodedSendBuffer[2 * MAX_BUFFER_SIZE];
 
-	S32 count = *data_size;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)encodedSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE ; ++ii)
-	{
-		count--;
-		*outptr++ = *inptr++;
-	}
-
-// build encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					*outptr++ = num_zeroes;
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				*outptr++ = 0;
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				*outptr++ = num_zeroes;
-				num_zeroes = 0;
-			}
-			*outptr++ = *inptr++;
-		}
-	}
-
-	if (num_zeroes)
-	{
-		*outptr++ = num_zeroes;
-	}
+	// skip the packet id field
+	memcpy(encodedSendBuffer, *data, LL_PACKET_ID_SIZE);	/* Flawfinder: ignore */
+	S32 encoded_size = LL_PACKET_ID_SIZE + ll_zero_code(*data + LL_PACKET_ID_SIZE,
+														(S32) *data_size - LL_PACKET_ID_SIZE,
+														encodedSendBuffer + LL_PACKET_ID_SIZE);
+	S32 net_gain = encoded_size - (S32) *data_size;
 
 	if (net_gain < 0)
 	{
@@ -27,23 +27,21 @@
 #ifndef LL_LLTEMPLATEMESSAGEBUILDER_H
 #define LL_LLTEMPLATEMESSAGEBUILDER_H
 
-#include <map>
-
 #include "llmessagebuilder.h"
 #include "llmsgvariabletype.h"
 
 class LLMsgData;
 class LLMessageTemplate;
+class LLMessageTemplateIndex;
+class LLMessageTemplateTable;
 class LLMsgBlkData;
 class LLMessageTemplate;
 
 class LLTemplateMessageBuilder : public LLMessageBuilder
 {
 public:
-	
-	typedef std::map<const char* , LLMessageTemplate*> message_template_name_map_t;
 
-	LLTemplateMessageBuilder(const message_template_name_map_t&);
+	LLTemplateMessageBuilder(const LLMessageTemplateTable&);
 	virtual ~LLTemplateMessageBuilder();
 
 	virtual void newMessage(const char* name);
@@ -103,13 +101,15 @@ private:
 
 	LLMsgData* mCurrentSMessageData;
 	const LLMessageTemplate* mCurrentSMessageTemplate;
+	const LLMessageTemplateIndex* mCurrentSMessageIndex;
 	LLMsgBlkData* mCurrentSDataBlock;
 	char* mCurrentSMessageName;
 	char* mCurrentSBlockName;
+	S32 mCurrentSBlockIndex;	// into mCurrentSMessageIndex
 	BOOL mbSBuilt;
 	BOOL mbSClear;
 	S32	 mCurrentSendTotal;
-	const message_template_name_map_t& mMessageTemplates;
+	const LLMessageTemplateTable& mMessageTemplates;
 };
 
 #endif // LL_LLTEMPLATEMESSAGEBUILDER_H
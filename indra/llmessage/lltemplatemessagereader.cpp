@@ -38,20 +38,20 @@
 #include "v3math.h"
 #include "v4math.h"
 
-LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
-												 number_template_map) :
+LLTemplateMessageReader::LLTemplateMessageReader(const LLMessageTemplateTable&
+												 message_templates) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mCurrentRMessageIndex(NULL),
+	mArenaUsed(0),
+	mMessageTemplates(message_templates)
 {
+	mArena.resize(MAX_BUFFER_SIZE);
 }
 
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
@@ -59,8 +59,31 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mCurrentRMessageIndex = NULL;
+	mBlockData.clear();
+	mVarData.clear();
+	mArenaUsed = 0;
+}
+
+const LLTemplateMessageReader::VarData* LLTemplateMessageReader::findVarData(const char* blockname, S32 blocknum, const char* varname, bool& has_block) const
+{
+	has_block = false;
+
+	S32 block = mCurrentRMessageIndex->findBlock(blockname);
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockData[block].mCount)
+	{
+		return NULL;
+	}
+	has_block = true;
+
+	S32 var = mCurrentRMessageIndex->findVariable(block, varname);
+	if (var < 0)
+	{
+		return NULL;
+	}
+
+	const LLMessageTemplateIndex::Block& block_info = mCurrentRMessageIndex->mBlocks[block];
+	return &mVarData[mBlockData[block].mFirstVar + blocknum*block_info.mNumVariables + var];
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -72,79 +95,73 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageIndex)
 	{
-		LL_ERRS() << "Invalid mCurrentMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "Invalid mCurrentRMessageIndex in getData!" << LL_ENDL;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
+	bool has_block;
+	const VarData* vardata = findVarData(blockname, blocknum, varname, has_block);
 
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (!has_block)
 	{
 		LL_ERRS() << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << LL_ENDL;
+			<< " not in message " << mCurrentRMessageTemplate->mName << LL_ENDL;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgBlkData::msg_var_data_map_t &var_data_map = msg_block_data->mMemberVarData;
-
-	if (var_data_map.find(vnamep) == var_data_map.end())
+	if (!vardata)
 	{
-		LL_ERRS() << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << LL_ENDL;
+		LL_ERRS() << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return;
 	}
 
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
-
-	if (size && size != vardata.getSize())
+	if (size && size != vardata->mSize)
 	{
-		LL_ERRS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_ERRS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << vardata->mSize
 			<< " but copying into buffer of size " << size
 			<< LL_ENDL;
 		return;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
+	const U8* src = &mArena[0] + vardata->mOffset;
+	const S32 vardata_size = vardata->mSize;
 	if( max_size >= vardata_size )
 	{   
+		// arena offsets are unaligned, fixed size copies still compile
+		// down to single moves
 		switch( vardata_size )
 		{ 
 		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
+			*((U8*)datap) = *src;
 			break;
 		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
+			memcpy(datap, src, 2);
 			break;
 		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
+			memcpy(datap, src, 4);
 			break;
 		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
+			memcpy(datap, src, 8);
 			break;
 		default:
-			memcpy(datap, vardata.getData(), vardata_size);
+			memcpy(datap, src, vardata_size);
 			break;
 		}
 	}
 	else
 	{
-		LL_WARNS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_WARNS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but truncated to max size of " << max_size
 			<< LL_ENDL;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, src, max_size);
 	}
 }
 
@@ -157,22 +174,20 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageIndex)
 	{
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "Invalid mCurrentRMessageIndex in getData!" << LL_ENDL;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+	S32 block = mCurrentRMessageIndex->findBlock(blockname);
 	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (block < 0)
 	{
 		return 0;
 	}
 
-	return (iter->second)->mBlockNumber;
+	return mBlockData[block].mCount;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -184,43 +199,37 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageIndex)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "Invalid mCurrentRMessageIndex in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+	bool has_block;
+	const VarData* vardata = findVarData(blockname, 0, varname, has_block);
 	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (!has_block)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " not in message "
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	if (!vardata)
 	{	// don't crash
 		LL_INFOS() << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	if (mCurrentRMessageIndex->mBlocks[mCurrentRMessageIndex->findBlock(blockname)].mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		LL_ERRS() << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return vardata->mSize;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -232,35 +241,30 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageIndex)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
+		LL_ERRS() << "Invalid mCurrentRMessageIndex in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+	bool has_block;
+	const VarData* vardata = findVarData(blockname, blocknum, varname, has_block);
 	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (!has_block)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	if (!vardata)
 	{	// don't crash
-		LL_INFOS() << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+		LL_INFOS() << "Variable " << varname << " not in message "
+			<<  mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return vardata->mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -492,7 +496,7 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		return(FALSE);
 	}
 
-	LLMessageTemplate* temp = get_ptr_in_map(mMessageNumbers,num);
+	LLMessageTemplate* temp = mMessageTemplates.findByNumber(num);
 	if (temp)
 	{
 		*msg_template = temp;
@@ -529,45 +533,56 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 
 static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
 
+U8* LLTemplateMessageReader::allocData(S32 size)
+{
+	if (mArenaUsed + size > mArena.size())
+	{
+		mArena.resize(llmax((U32)mArena.size() * 2, mArenaUsed + size));
+	}
+	U8* data = &mArena[0] + mArenaUsed;
+	mArenaUsed += size;
+	return data;
+}
+
 // decode a given message
 BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender )
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+	llassert( !mCurrentRMessageIndex );
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
-	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
+	// every variable of every block instance lands in one flat table, in
+	// template order, with its bytes in the arena.  Nothing is allocated
+	// once the vectors have grown to fit the largest message seen.
+	mCurrentRMessageIndex = mCurrentRMessageTemplate->getIndex();
+	mBlockData.resize(mCurrentRMessageIndex->mBlocks.size());
+	mVarData.clear();
+	mArenaUsed = 0;
+	bool has_blocks = false;
+
+	for (U32 block = 0; block < mCurrentRMessageIndex->mBlocks.size(); ++block)
 	{
-		LLMessageBlock* mbci = *iter;
+		const LLMessageTemplateIndex::Block& block_info = mCurrentRMessageIndex->mBlocks[block];
 		U8	repeat_number;
-		S32	i;
 
 		// how many of this block?
 
-		if (mbci->mType == MBT_SINGLE)
+		if (block_info.mType == MBT_SINGLE)
 		{
 			// just one
 			repeat_number = 1;
 		}
-		else if (mbci->mType == MBT_MULTIPLE)
+		else if (block_info.mType == MBT_MULTIPLE)
 		{
 			// a known number
-			repeat_number = mbci->mNumber;
+			repeat_number = block_info.mNumber;
 		}
-		else if (mbci->mType == MBT_VARIABLE)
+		else if (block_info.mType == MBT_VARIABLE)
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
@@ -592,42 +607,25 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		mBlockData[block].mFirstVar = mVarData.size();
+		mBlockData[block].mCount = repeat_number;
+		has_blocks |= repeat_number > 0;
 
 		// now loop through the block
-		for (i = 0; i < repeat_number; i++)
+		for (S32 i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
-			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
+			for (U32 var = 0; var < block_info.mNumVariables; ++var)
 			{
-				const LLMessageVariable& mvci = **iter;
+				const LLMessageTemplateIndex::Variable& var_info =
+					mCurrentRMessageIndex->mVariables[block_info.mFirstVariable + var];
 
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				VarData vardata;
 
 				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
+				if (var_info.mType == MVT_VARIABLE)
 				{
 					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
+					S32 data_size = var_info.mSize;
 					U8 tsizeb = 0;
 					U16 tsizeh = 0;
 					U32 tsize = 0;
@@ -661,38 +659,50 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					if (tsize > (U32)llmax(mReceiveSize - decode_pos, 0))
+					{
+						// length prefix points past the end of the packet
+						logRanOffEndOfPacket(sender, decode_pos, tsize);
+						tsize = 0;
+					}
+
+					vardata.mOffset = mArenaUsed;
+					vardata.mSize = tsize;
+					if (tsize)
+					{
+						htonmemcpy(allocData(tsize), &buffer[decode_pos], MVT_VARIABLE, tsize);
+					}
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					// so, copy data and set data size to fixed size
+					S32 size = var_info.mSize;
+					vardata.mOffset = mArenaUsed;
+					vardata.mSize = size;
+					U8* data = allocData(size);
+					if ((decode_pos + size) > mReceiveSize)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						logRanOffEndOfPacket(sender, decode_pos, size);
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						memset(data, 0, size);
 					}
 					else
 					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
+						htonmemcpy(data, &buffer[decode_pos], var_info.mType, size);
 					}
-					decode_pos += mvci.getSize();
+					decode_pos += size;
 				}
+
+				mVarData.push_back(vardata);
 			}
 		}
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (!has_blocks
+		&& !mCurrentRMessageIndex->mBlocks.empty())
 	{
 		LL_DEBUGS() << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << LL_ENDL;
 		return FALSE;
@@ -701,7 +711,7 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 	{
 		static LLTimer decode_timer;
 
-		if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
+		if(LLMessageReader::getTimeDecodes() || (gMessageSystem && gMessageSystem->getTimingCallback()))
 		{
 			decode_timer.reset();
 		}
@@ -714,11 +724,11 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			}
 		}
 
-		if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
+		if(LLMessageReader::getTimeDecodes() || (gMessageSystem && gMessageSystem->getTimingCallback()))
 		{
 			F32 decode_time = decode_timer.getElapsedTimeF32();
 
-			if (gMessageSystem->getTimingCallback())
+			if (gMessageSystem && gMessageSystem->getTimingCallback())
 			{
 				(gMessageSystem->getTimingCallback())(mCurrentRMessageTemplate->mName,
 								decode_time,
@@ -826,5 +836,50 @@ void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+	LLMsgData* data = buildMessageData();
+	builder.copyFromMessageData(*data);
+	delete data;
+}
+
+LLMsgData* LLTemplateMessageReader::buildMessageData() const
+{
+	LLMsgData* data = new LLMsgData(mCurrentRMessageTemplate->mName);
+	if (!mCurrentRMessageIndex)
+	{
+		return data;
+	}
+
+	for (U32 block = 0; block < mCurrentRMessageIndex->mBlocks.size(); ++block)
+	{
+		const LLMessageTemplateIndex::Block& block_info = mCurrentRMessageIndex->mBlocks[block];
+		S32 repeat_number = mBlockData[block].mCount;
+		const VarData* vardata = mVarData.empty() ? NULL : &mVarData[mBlockData[block].mFirstVar];
+		for (S32 i = 0; i < repeat_number; i++)
+		{
+			LLMsgBlkData* cur_data_block = new LLMsgBlkData(block_info.mName, repeat_number);
+			// build new name to prevent collisions
+			cur_data_block->mName = block_info.mName + i;
+			data->addBlock(cur_data_block);
+
+			for (U32 var = 0; var < block_info.mNumVariables; ++var, ++vardata)
+			{
+				const LLMessageTemplateIndex::Variable& var_info =
+					mCurrentRMessageIndex->mVariables[block_info.mFirstVariable + var];
+				cur_data_block->addVariable(var_info.mName, var_info.mType);
+				if (var_info.mType == MVT_VARIABLE)
+				{
+					cur_data_block->addData(var_info.mName, &mArena[0] + vardata->mOffset,
+											vardata->mSize, var_info.mType);
+				}
+				else
+				{
+					// arena holds host order, addData() swaps from network order
+					std::vector<U8> wire(vardata->mSize);
+					htonmemcpy(&wire[0], &mArena[0] + vardata->mOffset, var_info.mType, vardata->mSize);
+					cur_data_block->addData(var_info.mName, &wire[0], vardata->mSize, var_info.mType);
+				}
+			}
+		}
+	}
+	return data;
 }
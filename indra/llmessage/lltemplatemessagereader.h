@@ -30,17 +30,18 @@
 #include "llmessagereader.h"
 
 #include <map>
+#include <vector>
 
 class LLMessageTemplate;
+class LLMessageTemplateIndex;
+class LLMessageTemplateTable;
 class LLMsgData;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
 public:
 
-	typedef std::map<U32, LLMessageTemplate*> message_template_number_map_t;
-
-	LLTemplateMessageReader(message_template_number_map_t&);
+	LLTemplateMessageReader(const LLMessageTemplateTable&);
 	virtual ~LLTemplateMessageReader();
 
 	/** All get* methods expect pointers to canonical strings. */
@@ -111,6 +112,9 @@ private:
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
+	// rebuilds the map based message data, only needed to copy a message
+	LLMsgData* buildMessageData() const;
+
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template ); // outputs
 
@@ -118,10 +122,33 @@ private:
 
 	BOOL decodeData(const U8* buffer, const LLHost& sender );
 
+	// Decoded message, laid out flat in template order.  Each template block
+	// gets a BlockData, each variable of each block instance a VarData
+	// pointing into the arena.  The vectors keep their capacity between
+	// messages so decoding does not allocate once they have grown.
+	struct BlockData
+	{
+		U32		mFirstVar;	// index into mVarData of the first instance's first variable
+		S32		mCount;		// number of instances in this message
+	};
+
+	struct VarData
+	{
+		U32		mOffset;	// into mArena
+		S32		mSize;
+	};
+
+	const VarData* findVarData(const char* blockname, S32 blocknum, const char* varname, bool& has_block) const;
+	U8* allocData(S32 size);
+
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
-	message_template_number_map_t& mMessageNumbers;
+	const LLMessageTemplateIndex* mCurrentRMessageIndex;
+	std::vector<BlockData> mBlockData;
+	std::vector<VarData> mVarData;
+	std::vector<U8> mArena;
+	U32 mArenaUsed;
+	const LLMessageTemplateTable& mMessageTemplates;
 };
 
 #endif // LL_LLTEMPLATEMESSAGEREADER_H
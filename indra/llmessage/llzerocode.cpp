@@ -0,0 +1,189 @@
+/**
+ * @file llzerocode.cpp
+ * @brief Zero coding of message bodies.
+ *
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#include <emmintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const S32 CHUNK_SIZE = sizeof(__m128i);
+
+	inline U32 zero_mask(const U8* p)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*) p);
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+	}
+
+	inline U32 first_set_bit(U32 mask)
+	{
+#if LL_WINDOWS
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+}
+
+S32 ll_zero_code(const U8* in, S32 in_size, U8* out)
+{
+	const U8* inp = in;
+	const U8* in_end = in + llmax(in_size, 0);
+	S32 size = 0;
+
+	while (inp < in_end)
+	{
+		// bytes up to the next zero are copied as they are
+		const U8* literals = inp;
+		while (in_end - inp >= CHUNK_SIZE)
+		{
+			U32 mask = zero_mask(inp);
+			if (mask)
+			{
+				inp += first_set_bit(mask);
+				break;
+			}
+			inp += CHUNK_SIZE;
+		}
+		while (inp < in_end && *inp)
+		{
+			++inp;
+		}
+		if (out)
+		{
+			memcpy(out + size, literals, inp - literals);	/* Flawfinder: ignore */
+		}
+		size += inp - literals;
+
+		if (inp == in_end)
+		{
+			break;
+		}
+
+		// then the zeroes up to the next byte that isn't one
+		const U8* zeroes = inp;
+		while (in_end - inp >= CHUNK_SIZE)
+		{
+			U32 mask = zero_mask(inp) ^ 0xffff;
+			if (mask)
+			{
+				inp += first_set_bit(mask);
+				break;
+			}
+			inp += CHUNK_SIZE;
+		}
+		while (inp < in_end && !*inp)
+		{
+			++inp;
+		}
+
+		S32 run = inp - zeroes;
+		for ( ; run > 0; run -= 255)
+		{
+			if (out)
+			{
+				out[size] = 0;
+				out[size + 1] = (U8) llmin(run, 255);
+			}
+			size += 2;
+		}
+	}
+	return size;
+}
+
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+{
+	const U8* inp = in;
+	const U8* in_end = in + llmax(in_size, 0);
+	U8* outp = out;
+	U8* out_end = out + out_size;
+
+	while (inp < in_end)
+	{
+		// Copies whole chunks while both sides have room for one.  The
+		// chunk with the next zero in it is stored too, the bytes from the
+		// zero on are overwritten by what follows.
+		while (in_end - inp >= CHUNK_SIZE && out_end - outp >= CHUNK_SIZE)
+		{
+			__m128i chunk = _mm_loadu_si128((const __m128i*) inp);
+			_mm_storeu_si128((__m128i*) outp, chunk);
+			U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+			if (mask)
+			{
+				U32 literals = first_set_bit(mask);
+				inp += literals;
+				outp += literals;
+				break;
+			}
+			inp += CHUNK_SIZE;
+			outp += CHUNK_SIZE;
+		}
+		while (inp < in_end && *inp)
+		{
+			if (outp == out_end)
+			{
+				return -1;
+			}
+			*outp++ = *inp++;
+		}
+
+		if (inp == in_end)
+		{
+			break;
+		}
+
+		// A zero and its count.  Every extra zero in front of the count
+		// stands for another 256 zeroes, ll_zero_code() never writes those
+		// but the format allows them.
+		++inp;
+		S32 run = 1;
+		while (inp < in_end && !*inp)
+		{
+			run += 256;
+			++inp;
+		}
+		if (inp < in_end)
+		{
+			run += *inp++ - 1;
+		}
+
+		if (out_end - outp < run)
+		{
+			return -1;
+		}
+		memset(outp, 0, run);
+		outp += run;
+	}
+	return (S32) (outp - out);
+}
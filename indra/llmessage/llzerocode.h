@@ -0,0 +1,46 @@
+/**
+ * @file llzerocode.h
+ * @brief Zero coding of message bodies.
+ *
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+// Zero coding squeezes the runs of zero bytes out of a message body.  Each
+// run becomes a 0 followed by its length, runs of more than 255 zeroes
+// taking several of those.  The packet header in front of the body is not
+// coded.  Both directions find the zeroes 16 bytes at a time and fall back
+// to checking every byte near the ends of the buffers.
+
+// Zero codes in_size bytes into out, which must hold 2 * in_size bytes, or
+// only measures the result if out is NULL.  Returns the coded size.
+S32 ll_zero_code(const U8* in, S32 in_size, U8* out);
+
+// Expands the zero coded in_size bytes into out.  Returns the expanded
+// size, or -1 if it would take more than out_size bytes.  Nothing past
+// out_size is ever written.
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size);
+
+#endif // LL_LLZEROCODE_H
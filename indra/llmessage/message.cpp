@@ -54,6 +54,7 @@
 #include "llmd5.h"
 #include "llmessagebuilder.h"
 #include "llmessageconfig.h"
+#include "llmessagereceivethread.h"
 #include "lltemplatemessagedispatcher.h"
 #include "llpumpio.h"
 #include "lltemplatemessagebuilder.h"
@@ -69,6 +70,7 @@
 #include "lltransfermanager.h"
 #include "lluuid.h"
 #include "llxfermanager.h"
+#include "llzerocode.h"
 #include "llquaternion.h"
 #include "u64.h"
 #include "v3dmath.h"
@@ -143,6 +145,14 @@ static const char* nullToEmpty(const char* s)
 	return s? s : emptyString;
 }
 
+static LLTrace::CountStatHandle<> sAppendedAcks("appendedacks", "Number of packet acks appended to packets already queued for sending");
+
+// PacketAck is Fixed 0xFFFFFFFB in the template
+static bool is_packet_ack(const U8* message, S32 size)
+{
+	return size >= 4 && message[0] == 0xFF && message[1] == 0xFF && message[2] == 0xFF && message[3] == 0xFB;
+}
+
 void LLMessageSystem::init()
 {
 	// initialize member variables
@@ -189,6 +199,8 @@ void LLMessageSystem::init()
 
 	mMessageBuilder = NULL;
 	mMessageReader = NULL;
+
+	mReceiveThread = NULL;
 }
 
 // Read file and build message templates
@@ -198,6 +210,7 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 								 S32 version_patch,
 								 bool failure_is_fatal,
 								 const F32 circuit_heartbeat_interval, const F32 circuit_timeout) :
+	mTemplateTable(new LLMessageTemplateTable),
 	mCircuitInfo(F32Seconds(circuit_heartbeat_interval), F32Seconds(circuit_timeout)),
 	mLastMessageFromTrustedMessageService(false)
 {
@@ -223,11 +236,11 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 
 	loadTemplateFile(filename, failure_is_fatal);
 
-	mTemplateMessageBuilder = new LLTemplateMessageBuilder(mMessageTemplates);
+	mTemplateMessageBuilder = new LLTemplateMessageBuilder(*mTemplateTable);
 	mLLSDMessageBuilder = new LLSDMessageBuilder();
 	mMessageBuilder = NULL;
 
-	mTemplateMessageReader = new LLTemplateMessageReader(mMessageNumbers);
+	mTemplateMessageReader = new LLTemplateMessageReader(*mTemplateTable);
 	mLLSDMessageReader = new LLSDMessageReader();
 	mMessageReader = NULL;
 
@@ -320,9 +333,12 @@ LLMessageSystem::~LLMessageSystem()
 	mMessageTemplates.clear(); // don't delete templates.
 	for_each(mMessageNumbers.begin(), mMessageNumbers.end(), DeletePairedPointer());
 	mMessageNumbers.clear();
+
+	stopReceiveThread();
 	
 	if (!mbError)
 	{
+		flushSends();
 		end_net(mSocket);
 	}
 	mSocket = 0;
@@ -341,6 +357,9 @@ LLMessageSystem::~LLMessageSystem()
 	delete mLLSDMessageBuilder;
 	mLLSDMessageBuilder = NULL;
 
+	delete mTemplateTable;
+	mTemplateTable = NULL;
+
 	delete mPollInfop;
 	mPollInfop = NULL;
 
@@ -359,8 +378,39 @@ void LLMessageSystem::clearReceiveState()
 }
 
 
+void LLMessageSystem::startReceiveThread(U32 buffer_size)
+{
+	if (mReceiveThread || mbError)
+	{
+		return;
+	}
+
+	LL_INFOS("Messaging") << "Receiving on a network thread, " << buffer_size << " byte buffer" << LL_ENDL;
+	mReceiveThread = new LLMessageReceiveThread(mPacketRing, mSocket, buffer_size);
+	mReceiveThread->start();
+}
+
+void LLMessageSystem::stopReceiveThread()
+{
+	if (!mReceiveThread)
+	{
+		return;
+	}
+
+	mReceiveThread->shutdown();
+	// anything still queued is dropped, as if it had stayed in the kernel
+	delete mReceiveThread;
+	mReceiveThread = NULL;
+}
+
 BOOL LLMessageSystem::poll(F32 seconds)
 {
+	if (mReceiveThread)
+	{
+		// the network thread keeps the socket empty
+		return mReceiveThread->waitForPacket(seconds);
+	}
+
 	S32 num_socks;
 	apr_status_t status;
 	status = apr_poll(&(mPollInfop->mPollFD), 1, &num_socks,(U64)(seconds*1000000.f));
@@ -399,29 +449,26 @@ bool LLMessageSystem::isTrustedSender() const
 		isTrustedSender(getSender());
 }
 
-static LLMessageSystem::message_template_name_map_t::const_iterator 
-findTemplate(const LLMessageSystem::message_template_name_map_t& templates, 
-			 std::string name)
+static const LLMessageTemplate* findTemplate(const LLMessageTemplateTable& templates, 
+											 std::string name)
 {
 	const char* namePrehash = LLMessageStringTable::getInstance()->getString(name.c_str());
-	if(NULL == namePrehash) {return templates.end();}
-	return templates.find(namePrehash);
+	if(NULL == namePrehash) {return NULL;}
+	return templates.findByName(namePrehash);
 }
 
 bool LLMessageSystem::isTrustedMessage(const std::string& name) const
 {
-	message_template_name_map_t::const_iterator iter = 
-		findTemplate(mMessageTemplates, name);
-	if(iter == mMessageTemplates.end()) {return false;}
-	return iter->second->getTrust() == MT_TRUST;
+	const LLMessageTemplate* msg_template = findTemplate(*mTemplateTable, name);
+	if(!msg_template) {return false;}
+	return msg_template->getTrust() == MT_TRUST;
 }
 
 bool LLMessageSystem::isUntrustedMessage(const std::string& name) const
 {
-	message_template_name_map_t::const_iterator iter = 
-		findTemplate(mMessageTemplates, name);
-	if(iter == mMessageTemplates.end()) {return false;}
-	return iter->second->getTrust() == MT_NOTRUST;
+	const LLMessageTemplate* msg_template = findTemplate(*mTemplateTable, name);
+	if(!msg_template) {return false;}
+	return msg_template->getTrust() == MT_NOTRUST;
 }
 
 LLCircuitData* LLMessageSystem::findCircuit(const LLHost& host,
@@ -508,14 +555,37 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 		S32 true_rcv_size = 0;
 
 		U8* buffer = mTrueReceiveBuffer;
-		
-		mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
+		S32 expanded_size = LLMessageReceiveThread::NOT_ZERO_CODED;
+
+		if (mReceiveThread)
+		{
+			// received and zero decoded on the network thread
+			const LLMessageReceiveThread::Packet* packetp = mReceiveThread->front();
+			mTrueReceiveSize = 0;
+			if (packetp)
+			{
+				mTrueReceiveSize = packetp->mSize;
+				memcpy(mTrueReceiveBuffer, packetp->getData(), mTrueReceiveSize);	/* Flawfinder: ignore */
+				expanded_size = packetp->mExpandedSize;
+				if (expanded_size > 0)
+				{
+					memcpy(mEncodedRecvBuffer, packetp->getExpandedData(), expanded_size);	/* Flawfinder: ignore */
+				}
+				mLastSender = packetp->getSender();
+				mLastReceivingIF = packetp->getReceivingInterface();
+				mReceiveThread->pop();
+			}
+		}
+		else
+		{
+			mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
+			mLastSender = mPacketRing.getLastSender();
+			mLastReceivingIF = mPacketRing.getLastReceivingInterface();
+		}
 		// If you want to dump all received packets into SecondLife.log, uncomment this
 		//dumpPacketToLog();
 		
 		receive_size = mTrueReceiveSize;
-		mLastSender = mPacketRing.getLastSender();
-		mLastReceivingIF = mPacketRing.getLastReceivingInterface();
 		
 		if (receive_size < (S32) LL_MINIMUM_VALID_PACKET_SIZE)
 		{
@@ -556,7 +626,7 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 			}
 
 			// process the message as normal
-			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size, expanded_size);
 			mCurrentRecvPacketID = ntohl(*((U32*)(&buffer[1])));
 			host = getSender();
 
@@ -772,6 +842,10 @@ void LLMessageSystem::processAcks(F32 collect_time)
 		//resend any necessary packets
 		mCircuitInfo.resendUnackedPackets(mUnackedListDepth, mUnackedListSize);
 
+		// packets leaving this frame carry as many acks as they can, so
+		// fewer PacketAck messages are needed below
+		appendAcksToQueuedSends();
+
 		//cycle through ack list for each host we need to send acks to
 		mCircuitInfo.sendAcks(collect_time);
 
@@ -815,6 +889,66 @@ void LLMessageSystem::processAcks(F32 collect_time)
 		mResendDumpTime = mt_sec;
 		mCircuitInfo.dumpResends();
 	}
+
+	flushSends();
+}
+
+void LLMessageSystem::flushSends()
+{
+	mSendPacketFailureCount += mPacketRing.flushSends(mSocket);
+}
+
+void LLMessageSystem::appendAcksToQueuedSends()
+{
+	const S32 MAX_ACKS = 250;
+	// newest first, like sendMessage() the template's own PacketAck
+	// messages are left alone
+	for (S32 i = mPacketRing.getQueuedSendCount() - 1; i >= 0; --i)
+	{
+		LLPacketRing::QueuedPacket& queued = mPacketRing.getQueuedSend(i);
+		LLCircuitData* cdp = mCircuitInfo.findCircuit(queued.mHost);
+		if (!cdp || cdp->mAcks.empty())
+		{
+			continue;
+		}
+
+		U8* buf_ptr = (U8*) queued.getPacket();
+		S32 buffer_length = queued.mSize;
+		if (buffer_length < LL_MINIMUM_VALID_PACKET_SIZE
+			|| is_packet_ack(buf_ptr + LL_PACKET_ID_SIZE + buf_ptr[PHL_OFFSET], buffer_length - LL_PACKET_ID_SIZE - buf_ptr[PHL_OFFSET]))
+		{
+			continue;
+		}
+
+		S32 appended = 0;
+		if (buf_ptr[0] & LL_ACK_FLAG)
+		{
+			// sendMessage() got there first, take its count off the end
+			appended = buf_ptr[--buffer_length];
+		}
+		S32 space_left = (MTUBYTES - buffer_length) / sizeof(TPACKETID);
+		S32 append_ack_count = llmin(llmin(space_left, MAX_ACKS - appended), (S32) cdp->mAcks.size());
+		if (append_ack_count <= 0)
+		{
+			continue;
+		}
+
+		for (S32 ack = 0; ack < append_ack_count; ++ack)
+		{
+			TPACKETID packet_id = htonl(cdp->mAcks[ack]);
+			memcpy(&buf_ptr[buffer_length], &packet_id, sizeof(TPACKETID));	/* Flawfinder: ignore */
+			buffer_length += sizeof(TPACKETID);
+		}
+		cdp->mAcks.erase(cdp->mAcks.begin(), cdp->mAcks.begin() + append_ack_count);
+		buf_ptr[0] |= LL_ACK_FLAG;
+		buf_ptr[buffer_length++] = (U8) (appended + append_ack_count);
+
+		S32 added = buffer_length - queued.mSize;
+		queued.mSize = buffer_length;
+		cdp->addBytesOut((S32Bytes) added);
+		mTotalBytesOut += added;
+		add(sAppendedAcks, append_ack_count);
+	}
 }
 
 void LLMessageSystem::copyMessageReceivedToSend()
@@ -860,7 +994,7 @@ LLSD LLMessageSystem::wrapReceivedTemplateData() const
 {
 	if(mMessageReader == mTemplateMessageReader)
 	{
-		LLTemplateMessageBuilder builder(mMessageTemplates);
+		LLTemplateMessageBuilder builder(*mTemplateTable);
 		builder.newMessage(mMessageReader->getMessageName());
 		mMessageReader->copyToBuilder(builder);
 		U8 buffer[MAX_BUFFER_SIZE];
@@ -1702,23 +1836,23 @@ std::ostream& operator<<(std::ostream& s, LLMessageSystem &msg)
 		
 		s << "\nHigh frequency messages:\n";
 
-		for (i = 1; msg.mMessageNumbers[i] && (i < 255); i++)
+		for (i = 1; msg.mTemplateTable->findByNumber(i) && (i < 255); i++)
 		{
-			s << *(msg.mMessageNumbers[i]);
+			s << *msg.mTemplateTable->findByNumber(i);
 		}
 		
 		s << "\nMedium frequency messages:\n";
 
-		for (i = (255 << 8) + 1; msg.mMessageNumbers[i] && (i < (255 << 8) + 255); i++)
+		for (i = (255 << 8) + 1; msg.mTemplateTable->findByNumber(i) && (i < (255 << 8) + 255); i++)
 		{
-			s << *msg.mMessageNumbers[i];
+			s << *msg.mTemplateTable->findByNumber(i);
 		}
 		
 		s << "\nLow frequency messages:\n";
 
-		for (i = (0xFFFF0000) + 1; msg.mMessageNumbers[i] && (i < 0xFFFFFFFF); i++)
+		for (i = (0xFFFF0000) + 1; msg.mTemplateTable->findByNumber(i) && (i < 0xFFFFFFFF); i++)
 		{
-			s << *msg.mMessageNumbers[i];
+			s << *msg.mTemplateTable->findByNumber(i);
 		}
 	}
 	return s;
@@ -2039,9 +2173,8 @@ void LLMessageSystem::dispatch(
 	const LLSD& message,
 	LLHTTPNode::ResponsePtr responsep)
 {
-	if ((gMessageSystem->mMessageTemplates.find
-			(LLMessageStringTable::getInstance()->getString(msg_name.c_str())) ==
-				gMessageSystem->mMessageTemplates.end()) &&
+	if (!gMessageSystem->mTemplateTable->findByName
+			(LLMessageStringTable::getInstance()->getString(msg_name.c_str())) &&
 		!LLMessageConfig::isValidMessage(msg_name))
 	{
 		LL_WARNS("Messaging") << "Ignoring unknown message " << msg_name << LL_ENDL;
@@ -2677,7 +2810,7 @@ void LLMessageSystem::dumpReceiveCounts()
 	S32 i;
 	for (i = 0; i < mNumMessageCounts; i++)
 	{
-		mt = get_ptr_in_map(mMessageNumbers,mMessageCountList[i].mMessageNum);
+		mt = mTemplateTable->findByNumber(mMessageCountList[i].mMessageNum);
 		if (mt)
 		{
 			mt->mReceiveCount++;
@@ -2752,54 +2885,9 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 	// TODO: babbage: remove this horror
 	mMessageBuilder->setBuilt(FALSE);
 
-	S32 count = mSendSize;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)mSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
-	{
-		count--;
-		inptr++;
-	}
-
-// don't actually build, just test
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				num_zeroes = 0;
-			}
-			inptr++;
-		}
-	}
+	// skip the packet id field, don't actually build, just measure
+	S32 net_gain = ll_zero_code(mSendBuffer + LL_PACKET_ID_SIZE, mSendSize - LL_PACKET_ID_SIZE, NULL)
+		- (mSendSize - LL_PACKET_ID_SIZE);
 	if (net_gain < 0)
 	{
 		return net_gain;
@@ -2812,7 +2900,7 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 
 
 
-S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
+S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size, S32 expanded_size)
 {
 	if ((*data_size ) < LL_MINIMUM_VALID_PACKET_SIZE)
 	{
@@ -2831,80 +2919,44 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	S32 in_size = *data_size;
 	mCompressedPacketsIn++;
 	mCompressedBytesIn += *data_size;
-	
-	*data[0] &= (~LL_ZERO_CODE_FLAG);
-
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
 
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	if (expanded_size == LLMessageReceiveThread::NOT_ZERO_CODED)
 	{
-		count--;
-		*outptr++ = *inptr++;
+		expanded_size = zeroCodeExpandBuffer(*data, in_size, mEncodedRecvBuffer);
 	}
+	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
+	if (expanded_size < 0)
 	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << LL_ENDL;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+		expanded_size = 0;
 	}
-	
+
 	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data_size = expanded_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
 }
 
+//static
+S32 LLMessageSystem::zeroCodeExpandBuffer(const U8* in, S32 in_size, U8* out)
+{
+	if (in_size < LL_PACKET_ID_SIZE)
+	{
+		return -1;
+	}
+
+	// skip the packet id field
+	memcpy(out, in, LL_PACKET_ID_SIZE);	/* Flawfinder: ignore */
+	out[0] &= (~LL_ZERO_CODE_FLAG);
+
+	S32 body_size = ll_zero_code_expand(in + LL_PACKET_ID_SIZE, in_size - LL_PACKET_ID_SIZE,
+										out + LL_PACKET_ID_SIZE, MAX_BUFFER_SIZE - LL_PACKET_ID_SIZE);
+	return body_size < 0 ? -1 : LL_PACKET_ID_SIZE + body_size;
+}
+
 
 void LLMessageSystem::addTemplate(LLMessageTemplate *templatep)
 {
@@ -2915,12 +2967,13 @@ void LLMessageSystem::addTemplate(LLMessageTemplate *templatep)
 	}
 	mMessageTemplates[templatep->mName] = templatep;
 	mMessageNumbers[templatep->mMessageNumber] = templatep;
+	mTemplateTable->add(templatep);
 }
 
 
 void LLMessageSystem::setHandlerFuncFast(const char *name, void (*handler_func)(LLMessageSystem *msgsystem, void **user_data), void **user_data)
 {
-	LLMessageTemplate* msgtemplate = get_ptr_in_map(mMessageTemplates, name);
+	LLMessageTemplate* msgtemplate = mTemplateTable->findByName(name);
 	if (msgtemplate)
 	{
 		msgtemplate->setHandlerFunc(handler_func, user_data);
@@ -2935,16 +2988,14 @@ bool LLMessageSystem::callHandler(const char *name,
 		bool trustedSource, LLMessageSystem* msg)
 {
 	name = LLMessageStringTable::getInstance()->getString(name);
-	message_template_name_map_t::const_iterator iter;
-	iter = mMessageTemplates.find(name);
-	if(iter == mMessageTemplates.end())
+	const LLMessageTemplate* msg_template = mTemplateTable->findByName(name);
+	if(!msg_template)
 	{
 		LL_WARNS("Messaging") << "LLMessageSystem::callHandler: unknown message " 
 			<< name << LL_ENDL;
 		return false;
 	}
 
-	const LLMessageTemplate* msg_template = iter->second;
 	if (msg_template->isBanned(trustedSource))
 	{
 		LL_WARNS("Messaging") << "LLMessageSystem::callHandler: banned message " 
@@ -3986,12 +4037,12 @@ bool LLMessageSystem::checkAllMessages(S64 frame_count, LLPumpIO* http_pump)
 
 void LLMessageSystem::banUdpMessage(const std::string& name)
 {
-	message_template_name_map_t::iterator itt = mMessageTemplates.find(
+	LLMessageTemplate* msg_template = mTemplateTable->findByName(
 		LLMessageStringTable::getInstance()->getString(name.c_str())
 		);
-	if(itt != mMessageTemplates.end())
+	if(msg_template)
 	{
-		itt->second->banUdp();
+		msg_template->banUdp();
 	}
 	else
 	{
@@ -178,8 +178,10 @@ typedef void (*msg_exception_callback)(LLMessageSystem*,void*,EMessageException)
 class LLMsgData;
 class LLMsgBlkData;
 class LLMessageTemplate;
+class LLMessageTemplateTable;
 
 class LLMessagePollInfo;
+class LLMessageReceiveThread;
 class LLMessageBuilder;
 class LLTemplateMessageBuilder;
 class LLSDMessageBuilder;
@@ -220,8 +222,11 @@ class LLMessageSystem : public LLMessageSenderInterface
 	typedef std::map<U32, LLMessageTemplate*> message_template_number_map_t;
 
 private:
+	// mMessageTemplates and mMessageNumbers own the templates and are only
+	// iterated over, every lookup goes through mTemplateTable
 	message_template_name_map_t		mMessageTemplates;
 	message_template_number_map_t	mMessageNumbers;
+	LLMessageTemplateTable*			mTemplateTable;
 
 public:
 	S32					mSystemVersionMajor;
@@ -331,7 +336,16 @@ public:
 
 	BOOL	poll(F32 seconds); // Number of seconds that we want to block waiting for data, returns if data was received
 	BOOL	checkMessages( S64 frame_count = 0 );
+
+	// Receive and zero decode packets on a network thread from now on,
+	// checkMessages() then only takes them from its queue.
+	void	startReceiveThread(U32 buffer_size);
+	void	stopReceiveThread();
+	LLMessageReceiveThread* getReceiveThread() const { return mReceiveThread; }
 	void	processAcks(F32 collect_time = 0.f);
+	// Sends whatever mPacketRing holds back when batching sends, done at
+	// the end of processAcks().
+	void	flushSends();
 
 	BOOL	isMessageFast(const char *msg);
 	BOOL	isMessage(const char *msg)
@@ -452,7 +466,14 @@ public:
 	//void	buildMessage();
 
 	S32     zeroCode(U8 **data, S32 *data_size);
-	S32		zeroCodeExpand(U8 **data, S32 *data_size);
+	// expanded_size is the size of a body the receive thread already
+	// decoded into mEncodedRecvBuffer, or one of its EXPAND_* values
+	S32		zeroCodeExpand(U8 **data, S32 *data_size, S32 expanded_size = -1);
+
+	// Expands the zero coded packet in into out, which must hold
+	// MAX_BUFFER_SIZE bytes.  Returns the expanded size, or -1 if it would
+	// not fit.  Touches no message system state.
+	static S32 zeroCodeExpandBuffer(const U8* in, S32 in_size, U8* out);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
 	// Uses ping-based retry
@@ -761,6 +782,8 @@ private:
 	void		logTrustedMsgFromUntrustedCircuit( const LLHost& sender );
 	void		logValidMsg(LLCircuitData *cdp, const LLHost& sender, BOOL recv_reliable, BOOL recv_resent, BOOL recv_acks );
 	void		logRanOffEndOfPacket( const LLHost& sender );
+	// appends pending acks to packets still waiting for flushSends()
+	void		appendAcksToQueuedSends();
 
 	class LLMessageCountInfo
 	{
@@ -771,6 +794,7 @@ private:
 	};
 
 	LLMessagePollInfo						*mPollInfop;
+	LLMessageReceiveThread					*mReceiveThread;
 
 	U8	mEncodedRecvBuffer[MAX_BUFFER_SIZE];
 	U8	mTrueReceiveBuffer[MAX_BUFFER_SIZE];
@@ -40,6 +40,7 @@
 	#include <arpa/inet.h>
 	#include <fcntl.h>
 	#include <errno.h>
+	#include <poll.h>
 #endif
 
 // linden library includes
@@ -338,6 +339,48 @@ S32 receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+S32 receive_packets(int hSocket, LLNetPacket* packets, S32 count)
+{
+	S32 received = 0;
+	while (received < count)
+	{
+		LLNetPacket& packet = packets[received];
+		SOCKADDR_IN src_addr;
+		int addr_size = sizeof(src_addr);
+		int nRet = recvfrom(hSocket, packet.mData, NET_BUFFER_SIZE, 0, (struct sockaddr*)&src_addr, &addr_size);
+		if (nRet == SOCKET_ERROR)
+		{
+			if (WSAECONNRESET == WSAGetLastError())
+			{
+				// ICMP port unreachable for an earlier send, skip it
+				continue;
+			}
+			if (WSAEWOULDBLOCK != WSAGetLastError())
+			{
+				LL_INFOS() << "receive_packets() failed, Error: " << WSAGetLastError() << LL_ENDL;
+			}
+			break;
+		}
+		packet.mSize = nRet;
+		packet.mSenderIP = src_addr.sin_addr.s_addr;
+		packet.mSenderPort = ntohs(src_addr.sin_port);
+		packet.mReceivingIP = INVALID_HOST_IP_ADDRESS;
+		++received;
+	}
+	return received;
+}
+
+BOOL wait_for_packets(int hSocket, S32 timeout_ms)
+{
+	fd_set read_set;
+	FD_ZERO(&read_set);
+	FD_SET(hSocket, &read_set);
+	timeval timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;
+	return select(hSocket + 1, &read_set, NULL, NULL, &timeout) > 0;
+}
+
 // Returns TRUE on success.
 BOOL send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort)
 {
@@ -376,6 +419,16 @@ BOOL send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, i
 	return (nRet != SOCKET_ERROR);
 }
 
+S32 send_packets(int hSocket, LLNetSendPacket* packets, S32 count)
+{
+	for (S32 i = 0; i < count; ++i)
+	{
+		LLNetSendPacket& packet = packets[i];
+		packet.mSent = send_packet(hSocket, packet.mData, packet.mSize, packet.mRecipientIP, packet.mRecipientPort);
+	}
+	return count;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Linux Versions
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -598,6 +651,98 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+#if LL_LINUX
+S32 receive_packets(int hSocket, LLNetPacket* packets, S32 count)
+{
+	const S32 MAX_BATCH = 64;
+	struct mmsghdr msgs[MAX_BATCH];
+	struct iovec iovs[MAX_BATCH];
+	struct sockaddr_in src_addrs[MAX_BATCH];
+	char cmsgs[MAX_BATCH][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+	S32 received = 0;
+	while (received < count)
+	{
+		S32 batch = llmin(count - received, MAX_BATCH);
+		memset(msgs, 0, sizeof(msgs[0]) * batch);
+		for (S32 i = 0; i < batch; ++i)
+		{
+			iovs[i].iov_base = packets[received + i].mData;
+			iovs[i].iov_len = NET_BUFFER_SIZE;
+			msgs[i].msg_hdr.msg_name = &src_addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(src_addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = cmsgs[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i]);
+		}
+
+		int nRet = recvmmsg(hSocket, msgs, batch, MSG_DONTWAIT, NULL);
+		if (nRet <= 0)
+		{
+			break;
+		}
+
+		for (S32 i = 0; i < nRet; ++i)
+		{
+			LLNetPacket& packet = packets[received + i];
+			packet.mSize = msgs[i].msg_len;
+			packet.mSenderIP = src_addrs[i].sin_addr.s_addr;
+			packet.mSenderPort = ntohs(src_addrs[i].sin_port);
+			packet.mReceivingIP = INVALID_HOST_IP_ADDRESS;
+			for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsgptr != NULL;
+				 cmsgptr = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsgptr))
+			{
+				if (cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO)
+				{
+					// same choice as recvfrom_destip()
+					packet.mReceivingIP = ((in_pktinfo*)CMSG_DATA(cmsgptr))->ipi_spec_dst.s_addr;
+				}
+			}
+		}
+		received += nRet;
+
+		if (nRet < batch)
+		{
+			// socket drained
+			break;
+		}
+	}
+	return received;
+}
+#else
+S32 receive_packets(int hSocket, LLNetPacket* packets, S32 count)
+{
+	S32 received = 0;
+	while (received < count)
+	{
+		LLNetPacket& packet = packets[received];
+		struct sockaddr_in src_addr;
+		socklen_t addr_size = sizeof(src_addr);
+		int nRet = recvfrom(hSocket, packet.mData, NET_BUFFER_SIZE, 0, (struct sockaddr*)&src_addr, &addr_size);
+		if (nRet == -1)
+		{
+			break;
+		}
+		packet.mSize = nRet;
+		packet.mSenderIP = src_addr.sin_addr.s_addr;
+		packet.mSenderPort = ntohs(src_addr.sin_port);
+		packet.mReceivingIP = INVALID_HOST_IP_ADDRESS;
+		++received;
+	}
+	return received;
+}
+#endif
+
+BOOL wait_for_packets(int hSocket, S32 timeout_ms)
+{
+	struct pollfd fds;
+	fds.fd = hSocket;
+	fds.events = POLLIN;
+	fds.revents = 0;
+	return poll(&fds, 1, timeout_ms) > 0;
+}
+
 BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient, int nPort)
 {
 	int		ret;
@@ -658,6 +803,80 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 	return success;
 }
 
+#if LL_LINUX
+S32 send_packets(int hSocket, LLNetSendPacket* packets, S32 count)
+{
+	const S32 MAX_BATCH = 64;
+	struct mmsghdr msgs[MAX_BATCH];
+	struct iovec iovs[MAX_BATCH];
+	struct sockaddr_in dst_addrs[MAX_BATCH];
+
+	S32 calls = 0;
+	S32 sent = 0;
+	S32 send_attempts = 0;
+	while (sent < count)
+	{
+		S32 batch = llmin(count - sent, MAX_BATCH);
+		memset(msgs, 0, sizeof(msgs[0]) * batch);
+		for (S32 i = 0; i < batch; ++i)
+		{
+			LLNetSendPacket& packet = packets[sent + i];
+			iovs[i].iov_base = (void*) packet.mData;
+			iovs[i].iov_len = packet.mSize;
+			memset(&dst_addrs[i], 0, sizeof(dst_addrs[i]));
+			dst_addrs[i].sin_family = AF_INET;
+			dst_addrs[i].sin_addr.s_addr = packet.mRecipientIP;
+			dst_addrs[i].sin_port = htons(packet.mRecipientPort);
+			msgs[i].msg_hdr.msg_name = &dst_addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(dst_addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int nRet = sendmmsg(hSocket, msgs, batch, 0);
+		calls++;
+		if (nRet > 0)
+		{
+			for (S32 i = 0; i < nRet; ++i)
+			{
+				packets[sent + i].mSent = TRUE;
+			}
+			sent += nRet;
+			send_attempts = 0;
+			continue;
+		}
+
+		// the first packet of the batch failed, retry it the way
+		// send_packet() does and then move on
+		LLNetSendPacket& packet = packets[sent];
+		struct in_addr addr;
+		addr.s_addr = packet.mRecipientIP;
+		if ((errno == EAGAIN || errno == ECONNREFUSED) && ++send_attempts < 3)
+		{
+			LL_INFOS() << "sendmmsg() reported " << strerror(errno) << ", resending (attempt " << send_attempts << ")" << LL_ENDL;
+			LL_INFOS() << inet_ntoa(addr) << ":" << packet.mRecipientPort << LL_ENDL;
+			continue;
+		}
+		LL_INFOS() << "sendmmsg() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
+		LL_INFOS() << inet_ntoa(addr) << ":" << packet.mRecipientPort << LL_ENDL;
+		packet.mSent = FALSE;
+		sent++;
+		send_attempts = 0;
+	}
+	return calls;
+}
+#else
+S32 send_packets(int hSocket, LLNetSendPacket* packets, S32 count)
+{
+	for (S32 i = 0; i < count; ++i)
+	{
+		LLNetSendPacket& packet = packets[i];
+		packet.mSent = send_packet(hSocket, packet.mData, packet.mSize, packet.mRecipientIP, packet.mRecipientPort);
+	}
+	return count;
+}
+#endif
+
 #endif
 
 //EOF
@@ -43,8 +43,44 @@ void	end_net(S32& socket_out);
 // returns size of packet or -1 in case of error
 S32		receive_packet(int hSocket, char * receiveBuffer);
 
+// One datagram of a receive_packets() batch.  The caller points mData at
+// NET_BUFFER_SIZE bytes, the rest is filled in.
+struct LLNetPacket
+{
+	char*	mData;
+	S32		mSize;
+	U32		mSenderIP;
+	U32		mSenderPort;
+	U32		mReceivingIP;	// INVALID_HOST_IP_ADDRESS where the OS can't tell
+};
+
+// Receives up to count queued datagrams without blocking, with a single
+// system call where the OS allows it.  Returns the number received.
+// Unlike receive_packet() this does not touch the get_sender() globals,
+// so it may be used from a network thread.
+S32		receive_packets(int hSocket, LLNetPacket* packets, S32 count);
+
+// Blocks until hSocket is readable or timeout_ms have passed, TRUE if readable.
+BOOL	wait_for_packets(int hSocket, S32 timeout_ms);
+
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// One datagram of a send_packets() batch.
+struct LLNetSendPacket
+{
+	const char*	mData;
+	S32			mSize;
+	U32			mRecipientIP;
+	U32			mRecipientPort;
+	BOOL		mSent;		// set by send_packets()
+};
+
+// Sends count datagrams, with a single system call per batch where the OS
+// allows it.  Failures are logged and reported through mSent, like
+// send_packet() the whole batch is attempted.  Returns the number of
+// system calls made.
+S32		send_packets(int hSocket, LLNetSendPacket* packets, S32 count);
+
 //void	get_sender(char * tmp);
 LLHost	get_sender();
 U32		get_sender_port();
@@ -0,0 +1,304 @@
+/**
+ * @file llmessagereceivethread_test.cpp
+ * @brief Loopback tests for LLMessageReceiveThread.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmessagereceivethread.h"
+#include "../llcircuit.h"
+#include "../llpacketring.h"
+#include "../message.h"
+#include "../net.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// zero codes body the way LLMessageSystem::zeroCode() does
+	std::vector<U8> zero_code(const std::vector<U8>& packet)
+	{
+		std::vector<U8> out(packet.begin(), packet.begin() + LL_PACKET_ID_SIZE);
+		out[0] |= LL_ZERO_CODE_FLAG;
+		U8 zeroes = 0;
+		for (size_t i = LL_PACKET_ID_SIZE; i < packet.size(); ++i)
+		{
+			if (packet[i] == 0 && zeroes < 255)
+			{
+				if (!zeroes++)
+				{
+					out.push_back(0);
+				}
+				continue;
+			}
+			if (zeroes)
+			{
+				out.push_back(zeroes);
+				zeroes = 0;
+				if (packet[i] == 0)
+				{
+					out.push_back(0);
+					zeroes = 1;
+					continue;
+				}
+			}
+			out.push_back(packet[i]);
+		}
+		if (zeroes)
+		{
+			out.push_back(zeroes);
+		}
+		return out;
+	}
+
+	// header, then a body with long runs of zeroes
+	std::vector<U8> make_packet(U32 packet_id, S32 body_size)
+	{
+		std::vector<U8> packet(LL_PACKET_ID_SIZE + body_size, 0);
+		packet[1] = (U8) (packet_id >> 24);
+		packet[2] = (U8) (packet_id >> 16);
+		packet[3] = (U8) (packet_id >> 8);
+		packet[4] = (U8) packet_id;
+		for (S32 i = 0; i < body_size; i += 7)
+		{
+			packet[LL_PACKET_ID_SIZE + i] = (U8) (packet_id + i) | 1;
+		}
+		return packet;
+	}
+
+	void append_acks(std::vector<U8>& packet, U8 count)
+	{
+		packet[0] |= LL_ACK_FLAG;
+		for (U8 i = 0; i < count; ++i)
+		{
+			packet.insert(packet.end(), sizeof(TPACKETID), i + 1);
+		}
+		packet.push_back(count);
+	}
+
+	U32 packet_id(const U8* data)
+	{
+		return (data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+	}
+}
+
+namespace tut
+{
+	struct llmessagereceivethread_test
+	{
+		llmessagereceivethread_test()
+		:	mReceiveSocket(0),
+			mSendSocket(0),
+			mPort(NET_USE_OS_ASSIGNED_PORT),
+			mSendPort(NET_USE_OS_ASSIGNED_PORT),
+			mThread(NULL)
+		{
+			ensure_equals("receive socket", start_net(mReceiveSocket, mPort), 0);
+			ensure_equals("send socket", start_net(mSendSocket, mSendPort), 0);
+			mLoopback = ip_string_to_u32("127.0.0.1");
+			mThread = new LLMessageReceiveThread(mPacketRing, mReceiveSocket);
+			mThread->start();
+		}
+
+		~llmessagereceivethread_test()
+		{
+			mThread->shutdown();
+			delete mThread;
+			end_net(mSendSocket);
+			end_net(mReceiveSocket);
+		}
+
+		void send(const std::vector<U8>& packet)
+		{
+			send_packet(mSendSocket, (const char*) &packet[0], packet.size(), mLoopback, mPort);
+		}
+
+		// waits a while for the next packet to come through
+		const LLMessageReceiveThread::Packet* next()
+		{
+			LLTimer timer;
+			const LLMessageReceiveThread::Packet* packetp = mThread->front();
+			while (!packetp && timer.getElapsedTimeF32() < 5.f)
+			{
+				ms_sleep(1);
+				packetp = mThread->front();
+			}
+			return packetp;
+		}
+
+		// waits a generous while for the network thread to have taken count
+		// packets off the socket, without reading any of them
+		bool waitForReceived(U32 count)
+		{
+			LLTimer timer;
+			while (mThread->getPacketsReceived() < count && timer.getElapsedTimeF32() < 10.f)
+			{
+				ms_sleep(1);
+			}
+			return mThread->getPacketsReceived() >= count;
+		}
+
+		S32 mReceiveSocket;
+		S32 mSendSocket;
+		int mPort;
+		int mSendPort;
+		U32 mLoopback;
+		LLPacketRing mPacketRing;
+		LLMessageReceiveThread* mThread;
+	};
+	typedef test_group<llmessagereceivethread_test> llmessagereceivethread_test_t;
+	typedef llmessagereceivethread_test_t::object llmessagereceivethread_test_object_t;
+	tut::llmessagereceivethread_test_t tut_llmessagereceivethread_test("LLMessageReceiveThread");
+
+	// plain packets come through as sent, zero coded ones are also decoded
+	// up to their appended acks
+	template<> template<>
+	void llmessagereceivethread_test_object_t::test<1>()
+	{
+		std::vector<U8> plain = make_packet(1, 100);
+		append_acks(plain, 3);
+		send(plain);
+
+		std::vector<U8> body = make_packet(2, 1000);
+		std::vector<U8> coded = zero_code(body);
+		append_acks(coded, 2);
+		send(coded);
+
+		const LLMessageReceiveThread::Packet* packetp = next();
+		ensure("plain packet received", packetp != NULL);
+		ensure_equals("plain size", packetp->mSize, (S32) plain.size());
+		ensure("plain contents", !memcmp(packetp->getData(), &plain[0], plain.size()));
+		ensure_equals("plain not decoded", packetp->mExpandedSize, (S32) LLMessageReceiveThread::NOT_ZERO_CODED);
+		ensure_equals("sender port", packetp->getSender().getPort(), (U32) mSendPort);
+		mThread->pop();
+
+		packetp = next();
+		ensure("coded packet received", packetp != NULL);
+		ensure_equals("coded size", packetp->mSize, (S32) coded.size());
+		ensure("coded contents", !memcmp(packetp->getData(), &coded[0], coded.size()));
+		ensure_equals("expanded size", packetp->mExpandedSize, (S32) body.size());
+		ensure_equals("zero code flag cleared", (U32) packetp->getExpandedData()[0], (U32) (coded[0] & ~LL_ZERO_CODE_FLAG));
+		ensure("expanded body", !memcmp(packetp->getExpandedData() + 1, &body[1], body.size() - 1));
+		mThread->pop();
+
+		ensure("drained", mThread->front() == NULL);
+	}
+
+	// a burst much larger than the kernel buffer arrives complete and in
+	// order while the main thread is stuck in a long frame
+	template<> template<>
+	void llmessagereceivethread_test_object_t::test<2>()
+	{
+		const U32 PACKETS = 5000;
+		for (U32 i = 0; i < PACKETS; ++i)
+		{
+			std::vector<U8> packet = make_packet(i, 200 + (i % 600));
+			if (i & 1)
+			{
+				packet = zero_code(packet);
+			}
+			append_acks(packet, i % 4);
+			send(packet);
+			if (!(i % 50))
+			{
+				// keep the sender from outrunning the loopback interface
+				ms_sleep(1);
+			}
+		}
+		// the long frame, lasting until the whole burst is off the socket
+		ensure("burst received while not reading", waitForReceived(PACKETS));
+
+		U32 received = 0;
+		const LLMessageReceiveThread::Packet* packetp;
+		while (received < PACKETS && (packetp = next()))
+		{
+			ensure_equals("in order", packet_id(packetp->getData()), received);
+			ensure_equals("decoded", packetp->mExpandedSize < 0, !(received & 1));
+			mThread->pop();
+			++received;
+		}
+
+		LL_INFOS() << PACKETS << " packets in " << mThread->getReceiveCalls() << " receive calls, "
+			<< mThread->getRingFullStalls() << " ring full stalls" << LL_ENDL;
+		ensure_equals("no loss", received, PACKETS);
+		ensure_equals("counted", mThread->getPacketsReceived(), PACKETS);
+		ensure_equals("ring empty", mThread->getBytesQueued(), (U32) 0);
+	}
+
+	// a ring much smaller than the traffic wraps around, with padding
+	// records, and the network thread waits for the reader when it is full
+	template<> template<>
+	void llmessagereceivethread_test_object_t::test<3>()
+	{
+		mThread->shutdown();
+		delete mThread;
+		mThread = new LLMessageReceiveThread(mPacketRing, mReceiveSocket, 1);
+		mThread->start();
+
+		const U32 PACKETS = 2000;
+		U32 received = 0;
+		for (U32 i = 0; i < PACKETS; ++i)
+		{
+			std::vector<U8> packet = make_packet(i, 100 + (i * 37) % 1100);
+			if (i % 3)
+			{
+				packet = zero_code(packet);
+			}
+			send(packet);
+			if (!(i % 20))
+			{
+				// read slowly enough for the ring to fill up now and then
+				ms_sleep(1);
+				const LLMessageReceiveThread::Packet* packetp;
+				while ((packetp = mThread->front()) && received + 200 < i)
+				{
+					ensure_equals("in order", packet_id(packetp->getData()), received);
+					mThread->pop();
+					++received;
+				}
+			}
+		}
+
+		const LLMessageReceiveThread::Packet* packetp;
+		while (received < PACKETS && (packetp = next()))
+		{
+			ensure_equals("in order", packet_id(packetp->getData()), received);
+			std::vector<U8> packet = make_packet(received, 100 + (received * 37) % 1100);
+			if (received % 3)
+			{
+				ensure_equals("expanded size", packetp->mExpandedSize, (S32) packet.size());
+				ensure("expanded body", !memcmp(packetp->getExpandedData() + 1, &packet[1], packet.size() - 1));
+			}
+			else
+			{
+				ensure("plain contents", !memcmp(packetp->getData(), &packet[0], packet.size()));
+			}
+			mThread->pop();
+			++received;
+		}
+		ensure_equals("no loss", received, PACKETS);
+		ensure("ring filled up", mThread->getRingFullStalls() > 0);
+	}
+}
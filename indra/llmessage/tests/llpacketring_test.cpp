@@ -0,0 +1,144 @@
+/**
+ * @file llpacketring_test.cpp
+ * @brief Loopback tests for the LLPacketRing batched send path.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketring.h"
+#include "../net.h"
+#include "llformat.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct llpacketring_test
+	{
+		llpacketring_test()
+		:	mReceiveSocket(0),
+			mSendSocket(0),
+			mPort(NET_USE_OS_ASSIGNED_PORT),
+			mSendPort(NET_USE_OS_ASSIGNED_PORT)
+		{
+			ensure_equals("receive socket", start_net(mReceiveSocket, mPort), 0);
+			ensure_equals("send socket", start_net(mSendSocket, mSendPort), 0);
+			mHost = LLHost(ip_string_to_u32("127.0.0.1"), mPort);
+		}
+
+		~llpacketring_test()
+		{
+			end_net(mSendSocket);
+			end_net(mReceiveSocket);
+		}
+
+		// everything that arrives within timeout_ms, in order
+		std::vector<std::string> receive(S32 timeout_ms)
+		{
+			std::vector<std::string> received;
+			char buffer[NET_BUFFER_SIZE];
+			while (wait_for_packets(mReceiveSocket, timeout_ms))
+			{
+				S32 size = receive_packet(mReceiveSocket, buffer);
+				if (size > 0)
+				{
+					received.push_back(std::string(buffer, size));
+				}
+			}
+			return received;
+		}
+
+		S32 mReceiveSocket;
+		S32 mSendSocket;
+		int mPort;
+		int mSendPort;
+		LLHost mHost;
+		LLPacketRing mPacketRing;
+	};
+	typedef test_group<llpacketring_test> llpacketring_test_t;
+	typedef llpacketring_test_t::object llpacketring_test_object_t;
+	tut::llpacketring_test_t tut_llpacketring_test("LLPacketRing");
+
+	// batched packets are held back until the flush, then all arrive in order
+	template<> template<>
+	void llpacketring_test_object_t::test<1>()
+	{
+		mPacketRing.setBatchSends(TRUE);
+
+		const S32 PACKETS = 40;
+		for (S32 i = 0; i < PACKETS; ++i)
+		{
+			std::string packet = llformat("packet %d", i) + std::string(i * 10, 'x');
+			ensure("queued", mPacketRing.sendPacket(mSendSocket, &packet[0], packet.size(), mHost));
+		}
+		ensure_equals("queued count", mPacketRing.getQueuedSendCount(), PACKETS);
+		ensure("held back", receive(50).empty());
+
+		ensure_equals("no failures", mPacketRing.flushSends(mSendSocket), 0);
+		ensure_equals("queue empty", mPacketRing.getQueuedSendCount(), 0);
+
+		std::vector<std::string> received = receive(200);
+		ensure_equals("all received", (S32) received.size(), PACKETS);
+		for (S32 i = 0; i < PACKETS; ++i)
+		{
+			ensure_equals("in order", received[i], llformat("packet %d", i) + std::string(i * 10, 'x'));
+		}
+	}
+
+	// a full queue is sent early, queued packets can still be added to
+	// before the flush and turning batching off sends what is left
+	template<> template<>
+	void llpacketring_test_object_t::test<2>()
+	{
+		mPacketRing.setBatchSends(TRUE);
+
+		const S32 PACKETS = 150;
+		for (S32 i = 0; i < PACKETS; ++i)
+		{
+			std::string packet = llformat("%d", i);
+			mPacketRing.sendPacket(mSendSocket, &packet[0], packet.size(), mHost);
+		}
+		ensure("full queues sent", mPacketRing.getQueuedSendCount() < PACKETS);
+
+		LLPacketRing::QueuedPacket& last = mPacketRing.getQueuedSend(mPacketRing.getQueuedSendCount() - 1);
+		ensure("destination kept", last.mHost == mHost);
+		memcpy(last.getPacket() + last.mSize, "!", 1);
+		last.mSize++;
+
+		mPacketRing.setBatchSends(FALSE);
+		ensure_equals("flushed", mPacketRing.getQueuedSendCount(), 0);
+
+		std::vector<std::string> received = receive(200);
+		ensure_equals("all received", (S32) received.size(), PACKETS);
+		ensure_equals("first", received.front(), std::string("0"));
+		ensure_equals("appended to", received.back(), llformat("%d!", PACKETS - 1));
+
+		// unbatched sends go straight out
+		std::string packet("direct");
+		mPacketRing.sendPacket(mSendSocket, &packet[0], packet.size(), mHost);
+		received = receive(200);
+		ensure_equals("sent directly", received.size(), (size_t) 1);
+	}
+}
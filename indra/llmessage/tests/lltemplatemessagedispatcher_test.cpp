@@ -74,8 +74,6 @@ void fillVector(std::vector<U8>& vector_data, const char* data)
 
 namespace tut
 {
-		static LLTemplateMessageReader::message_template_number_map_t numberMap;
-
 		struct LLTemplateMessageDispatcherData
 		{
 			LLTemplateMessageDispatcherData()
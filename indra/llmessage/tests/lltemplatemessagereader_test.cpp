@@ -0,0 +1,398 @@
+/**
+ * @file lltemplatemessagereader_test.cpp
+ * @brief Tests and replay benchmark for LLTemplateMessageReader decoding.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmessagetemplate.h"
+#include "../lltemplatemessagebuilder.h"
+#include "../lltemplatemessagereader.h"
+#include "llformat.h"
+#include "lltimer.h"
+#include "lluuid.h"
+#include "v3math.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	char* name(const char* str)
+	{
+		return LLMessageStringTable::getInstance()->getString(str);
+	}
+
+	// cut down ObjectUpdate: a single header block and a variable block
+	// mixing fixed and variable length fields
+	LLMessageTemplate* make_template()
+	{
+		LLMessageTemplate* msg_template = new LLMessageTemplate(name("TestObjectUpdate"), 12, MFT_HIGH);
+
+		LLMessageBlock* region = new LLMessageBlock(name("RegionData"), MBT_SINGLE);
+		region->addVariable(name("RegionHandle"), MVT_U64, 8);
+		region->addVariable(name("TimeDilation"), MVT_U16, 2);
+		msg_template->addBlock(region);
+
+		LLMessageBlock* objects = new LLMessageBlock(name("ObjectData"), MBT_VARIABLE);
+		objects->addVariable(name("ID"), MVT_U32, 4);
+		objects->addVariable(name("FullID"), MVT_LLUUID, 16);
+		objects->addVariable(name("PCode"), MVT_U8, 1);
+		objects->addVariable(name("Scale"), MVT_LLVector3, 12);
+		objects->addVariable(name("ObjectData"), MVT_VARIABLE, 1);
+		objects->addVariable(name("NameValue"), MVT_VARIABLE, 2);
+		msg_template->addBlock(objects);
+
+		return msg_template;
+	}
+
+	std::string name_value(U32 id)
+	{
+		std::ostringstream str;
+		str << "Object " << id;
+		for (U32 i = 0; i < id % 7; ++i)
+		{
+			str << " padding";
+		}
+		return str.str();
+	}
+
+	// the map based decode the reader used to do, kept as a baseline for
+	// the replay benchmark
+	LLMsgData* legacy_decode(const LLMessageTemplate* msg_template, const U8* buffer, S32 size)
+	{
+		S32 decode_pos = LL_PACKET_ID_SIZE + (S32) msg_template->mFrequency + buffer[PHL_OFFSET];
+		LLMsgData* data = new LLMsgData(msg_template->mName);
+
+		for (LLMessageTemplate::message_block_map_t::const_iterator iter = msg_template->mMemberBlocks.begin();
+			 iter != msg_template->mMemberBlocks.end(); ++iter)
+		{
+			const LLMessageBlock* block = *iter;
+			U8 repeat_number = 1;
+			if (block->mType == MBT_MULTIPLE)
+			{
+				repeat_number = block->mNumber;
+			}
+			else if (block->mType == MBT_VARIABLE)
+			{
+				repeat_number = decode_pos < size ? buffer[decode_pos++] : 0;
+			}
+
+			for (S32 i = 0; i < repeat_number; ++i)
+			{
+				LLMsgBlkData* block_data = new LLMsgBlkData(block->mName, repeat_number);
+				block_data->mName = block->mName + i;
+				data->addBlock(block_data);
+
+				for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+					 var_iter != block->mMemberVariables.end(); ++var_iter)
+				{
+					const LLMessageVariable& var = **var_iter;
+					block_data->addVariable(var.getName(), var.getType());
+					S32 var_size = var.getSize();
+					if (var.getType() == MVT_VARIABLE)
+					{
+						U32 tsize = 0;
+						if (var_size == 1)
+						{
+							tsize = buffer[decode_pos];
+						}
+						else
+						{
+							U16 tsizeh;
+							htonmemcpy(&tsizeh, &buffer[decode_pos], MVT_U16, 2);
+							tsize = tsizeh;
+						}
+						decode_pos += var_size;
+						var_size = tsize;
+					}
+					block_data->addData(var.getName(), &buffer[decode_pos], var_size, var.getType());
+					decode_pos += var_size;
+				}
+			}
+		}
+		return data;
+	}
+}
+
+namespace tut
+{
+	struct lltemplatemessagereader_test
+	{
+		lltemplatemessagereader_test()
+		{
+			mTemplate = make_template();
+			mTemplateTable.add(mTemplate);
+		}
+
+		~lltemplatemessagereader_test()
+		{
+			delete mTemplate;
+		}
+
+		// packet with num_objects ObjectData blocks, returns its size
+		U32 buildPacket(U8* buffer, U32 buffer_size, U32 first_id, S32 num_objects)
+		{
+			LLTemplateMessageBuilder builder(mTemplateTable);
+			builder.newMessage(mTemplate->mName);
+			builder.nextBlock(name("RegionData"));
+			builder.addU64(name("RegionHandle"), U64L(0x0003e80000040600) + first_id);
+			builder.addU16(name("TimeDilation"), 65535);
+			for (S32 i = 0; i < num_objects; ++i)
+			{
+				U32 id = first_id + i;
+				LLUUID full_id;
+				full_id.generate(name_value(id));
+				U8 extra[16];
+				memset(extra, (U8) id, sizeof(extra));
+
+				builder.nextBlock(name("ObjectData"));
+				builder.addU32(name("ID"), id);
+				builder.addUUID(name("FullID"), full_id);
+				builder.addU8(name("PCode"), (U8) (id % 3 + 9));
+				builder.addVector3(name("Scale"), LLVector3((F32) id, 0.5f, 2.f));
+				builder.addBinaryData(name("ObjectData"), extra, id % sizeof(extra));
+				builder.addString(name("NameValue"), name_value(id));
+			}
+			memset(buffer, 0, LL_PACKET_ID_SIZE);
+			return builder.buildMessage(buffer, buffer_size, 0);
+		}
+
+		bool decode(LLTemplateMessageReader& reader, const U8* buffer, U32 size)
+		{
+			reader.clearMessage();
+			return reader.validateMessage(buffer, size, LLHost()) && reader.readMessage(buffer, LLHost());
+		}
+
+		LLMessageTemplate* mTemplate;
+		LLMessageTemplateTable mTemplateTable;
+	};
+	typedef test_group<lltemplatemessagereader_test> lltemplatemessagereader_test_t;
+	typedef lltemplatemessagereader_test_t::object lltemplatemessagereader_test_object_t;
+	tut::lltemplatemessagereader_test_t tut_lltemplatemessagereader_test("LLTemplateMessageReader");
+
+	// every field of every block comes back as built
+	template<> template<>
+	void lltemplatemessagereader_test_object_t::test<1>()
+	{
+		U8 buffer[MAX_BUFFER_SIZE];
+		U32 size = buildPacket(buffer, sizeof(buffer), 100, 5);
+
+		LLTemplateMessageReader reader(mTemplateTable);
+		ensure("decoded", decode(reader, buffer, size));
+		ensure_equals("message name", std::string(reader.getMessageName()), std::string("TestObjectUpdate"));
+
+		U64 handle;
+		reader.getU64(name("RegionData"), name("RegionHandle"), handle);
+		ensure("region handle", handle == U64L(0x0003e80000040600) + 100);
+		ensure_equals("object blocks", reader.getNumberOfBlocks(name("ObjectData")), 5);
+		ensure_equals("missing block", reader.getNumberOfBlocks(name("Missing")), 0);
+		ensure_equals("fixed size", reader.getSize(name("RegionData"), name("TimeDilation")), 2);
+
+		for (S32 i = 0; i < 5; ++i)
+		{
+			U32 id = 100 + i;
+			U32 read_id;
+			LLUUID full_id, expected_id;
+			U8 pcode;
+			LLVector3 scale;
+			std::string nv;
+			expected_id.generate(name_value(id));
+
+			reader.getU32(name("ObjectData"), name("ID"), read_id, i);
+			reader.getUUID(name("ObjectData"), name("FullID"), full_id, i);
+			reader.getU8(name("ObjectData"), name("PCode"), pcode, i);
+			reader.getVector3(name("ObjectData"), name("Scale"), scale, i);
+			reader.getString(name("ObjectData"), name("NameValue"), nv, i);
+
+			ensure_equals("id", read_id, id);
+			ensure_equals("full id", full_id, expected_id);
+			ensure_equals("pcode", pcode, (U8) (id % 3 + 9));
+			ensure_equals("scale", scale, LLVector3((F32) id, 0.5f, 2.f));
+			ensure_equals("name value", nv, name_value(id));
+
+			S32 extra_size = reader.getSize(name("ObjectData"), i, name("ObjectData"));
+			ensure_equals("variable size", extra_size, (S32) (id % 16));
+			if (extra_size)
+			{
+				U8 extra[16];
+				reader.getBinaryData(name("ObjectData"), name("ObjectData"), extra, extra_size, i);
+				ensure_equals("variable data", extra[extra_size - 1], (U8) id);
+			}
+		}
+
+		ensure_equals("block past the end", reader.getSize(name("ObjectData"), 5, name("ID")), (S32) LL_BLOCK_NOT_IN_MESSAGE);
+		ensure_equals("unknown variable", reader.getSize(name("ObjectData"), 0, name("Missing")), (S32) LL_VARIABLE_NOT_IN_BLOCK);
+	}
+
+	// copying a decoded message to a builder reproduces the packet
+	template<> template<>
+	void lltemplatemessagereader_test_object_t::test<2>()
+	{
+		U8 buffer[MAX_BUFFER_SIZE];
+		U32 size = buildPacket(buffer, sizeof(buffer), 7, 9);
+
+		LLTemplateMessageReader reader(mTemplateTable);
+		ensure("decoded", decode(reader, buffer, size));
+
+		LLTemplateMessageBuilder builder(mTemplateTable);
+		builder.newMessage(reader.getMessageName());
+		reader.copyToBuilder(builder);
+		U8 copy[MAX_BUFFER_SIZE];
+		memset(copy, 0, LL_PACKET_ID_SIZE);
+		U32 copy_size = builder.buildMessage(copy, sizeof(copy), 0);
+
+		ensure_equals("copied size", copy_size, size);
+		ensure("copied bytes", !memcmp(buffer, copy, size));
+	}
+
+	// the reader is reused across messages of different shapes
+	template<> template<>
+	void lltemplatemessagereader_test_object_t::test<3>()
+	{
+		U8 big[MAX_BUFFER_SIZE];
+		U8 small[MAX_BUFFER_SIZE];
+		U32 big_size = buildPacket(big, sizeof(big), 1000, 20);
+		U32 small_size = buildPacket(small, sizeof(small), 3, 1);
+
+		LLTemplateMessageReader reader(mTemplateTable);
+		ensure("big decoded", decode(reader, big, big_size));
+		ensure_equals("big blocks", reader.getNumberOfBlocks(name("ObjectData")), 20);
+		ensure("small decoded", decode(reader, small, small_size));
+		ensure_equals("small blocks", reader.getNumberOfBlocks(name("ObjectData")), 1);
+
+		std::string nv;
+		reader.getString(name("ObjectData"), name("NameValue"), nv, 0);
+		ensure_equals("small name value", nv, name_value(3));
+	}
+
+	// replay a stream of ObjectUpdates through both decoders
+	template<> template<>
+	void lltemplatemessagereader_test_object_t::test<4>()
+	{
+		const S32 NUM_PACKETS = 64;
+		const S32 NUM_PASSES = 50;
+
+		std::vector<std::vector<U8> > packets(NUM_PACKETS);
+		for (S32 i = 0; i < NUM_PACKETS; ++i)
+		{
+			U8 buffer[MAX_BUFFER_SIZE];
+			U32 size = buildPacket(buffer, sizeof(buffer), i * 16, 1 + i % 12);
+			packets[i].assign(buffer, buffer + size);
+		}
+
+		LLTemplateMessageReader reader(mTemplateTable);
+		U32 checksum = 0;
+		LLTimer timer;
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_PACKETS; ++i)
+			{
+				decode(reader, &packets[i][0], packets[i].size());
+				S32 count = reader.getNumberOfBlocks(name("ObjectData"));
+				for (S32 block = 0; block < count; ++block)
+				{
+					U32 id;
+					reader.getU32(name("ObjectData"), name("ID"), id, block);
+					checksum += id;
+				}
+			}
+		}
+		F32 arena_time = timer.getElapsedTimeF32();
+
+		U32 legacy_checksum = 0;
+		timer.reset();
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_PACKETS; ++i)
+			{
+				LLMsgData* data = legacy_decode(mTemplate, &packets[i][0], packets[i].size());
+				for (LLMsgData::msg_blk_data_map_t::iterator iter = data->mMemberBlocks.begin();
+					 iter != data->mMemberBlocks.end(); ++iter)
+				{
+					LLMsgBlkData::msg_var_data_map_t::const_iterator var = iter->second->mMemberVarData.find(name("ID"));
+					if (var != iter->second->mMemberVarData.end())
+					{
+						legacy_checksum += *(const U32*) var->getData();
+					}
+				}
+				delete data;
+			}
+		}
+		F32 legacy_time = timer.getElapsedTimeF32();
+
+		ensure_equals("same ids decoded", checksum, legacy_checksum);
+		LL_INFOS("MessageBench") << NUM_PACKETS * NUM_PASSES << " packets, arena decode "
+			<< arena_time * 1000.f << " ms, map decode " << legacy_time * 1000.f << " ms" << LL_ENDL;
+	}
+
+	// templates are found by number in every frequency range and by name
+	// through the perfect hash, a later template replaces one of the same
+	// name and unknown names and numbers miss
+	template<> template<>
+	void lltemplatemessagereader_test_object_t::test<5>()
+	{
+		const S32 NUM_TEMPLATES = 600;
+		std::vector<LLMessageTemplate*> templates;
+		LLMessageTemplateTable table;
+		for (S32 i = 0; i < NUM_TEMPLATES; ++i)
+		{
+			U32 number;
+			EMsgFrequency frequency;
+			switch (i % 4)
+			{
+			case 0:		number = 1 + i / 4;					frequency = MFT_HIGH;	break;
+			case 1:		number = 0xFF01 + i / 4;			frequency = MFT_MEDIUM;	break;
+			case 2:		number = 0xFFFF0001 + i / 4;		frequency = MFT_LOW;	break;
+			default:	number = 0xFFFFFF00 + i / 4 % 0x100;	frequency = MFT_LOW;	break;
+			}
+			templates.push_back(new LLMessageTemplate(name(llformat("TableMessage%d", i).c_str()), number, frequency));
+			table.add(templates.back());
+		}
+		ensure_equals("all added", table.size(), NUM_TEMPLATES);
+
+		for (S32 i = 0; i < NUM_TEMPLATES; ++i)
+		{
+			ensure("by name", table.findByName(templates[i]->mName) == templates[i]);
+			ensure("by number", table.findByNumber(templates[i]->mMessageNumber) == templates[i]);
+		}
+		ensure("unknown name", table.findByName(name("NotATableMessage")) == NULL);
+		ensure("unknown high", table.findByNumber(0xFE) == NULL);
+		ensure("unknown low", table.findByNumber(0xFFFF8000) == NULL);
+		ensure("out of range", table.findByNumber(0x12345) == NULL);
+
+		LLMessageTemplate* replacement = new LLMessageTemplate(templates[10]->mName, 0xFFFF1000, MFT_LOW);
+		table.add(replacement);
+		ensure_equals("replaced, not added", table.size(), NUM_TEMPLATES);
+		ensure("new template by name", table.findByName(replacement->mName) == replacement);
+		ensure("new template by number", table.findByNumber(0xFFFF1000) == replacement);
+		ensure("old number dropped", table.findByNumber(templates[10]->mMessageNumber) == NULL);
+		ensure("others kept", table.findByName(templates[11]->mName) == templates[11]);
+
+		delete replacement;
+		for (S32 i = 0; i < NUM_TEMPLATES; ++i)
+		{
+			delete templates[i];
+		}
+	}
+}
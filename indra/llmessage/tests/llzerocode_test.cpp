@@ -0,0 +1,364 @@
+/**
+ * @file llzerocode_test.cpp
+ * @brief Round trip, fuzz and throughput tests for zero coding.
+ *
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llzerocode.h"
+#include "../message.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// the scalar coder the template message builder used to have
+	S32 legacy_zero_code(const U8* in, S32 in_size, U8* out)
+	{
+		S32 count = in_size;
+		U8 num_zeroes = 0;
+		const U8* inptr = in;
+		U8* outptr = out;
+
+		while (count--)
+		{
+			if (!(*inptr))
+			{
+				if (num_zeroes)
+				{
+					if (++num_zeroes > 254)
+					{
+						*outptr++ = num_zeroes;
+						num_zeroes = 0;
+					}
+				}
+				else
+				{
+					*outptr++ = 0;
+					num_zeroes = 1;
+				}
+				inptr++;
+			}
+			else
+			{
+				if (num_zeroes)
+				{
+					*outptr++ = num_zeroes;
+					num_zeroes = 0;
+				}
+				*outptr++ = *inptr++;
+			}
+		}
+		if (num_zeroes)
+		{
+			*outptr++ = num_zeroes;
+		}
+		return (S32) (outptr - out);
+	}
+
+	// the scalar expander LLMessageSystem used to have, out_size stands in
+	// for MAX_BUFFER_SIZE.  A zero in the last byte followed by more of
+	// them wrote one byte past out_size.
+	S32 legacy_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+	{
+		S32 count = in_size;
+		const U8* inptr = in;
+		U8* outptr = out;
+
+		while (count--)
+		{
+			if (outptr > (&out[out_size - 1]))
+			{
+				return -1;
+			}
+			if (!((*outptr++ = *inptr++)))
+			{
+				while (((count--)) && (!(*inptr)))
+				{
+					*outptr++ = *inptr++;
+					if (outptr > (&out[out_size - 256]))
+					{
+						return -1;
+					}
+					memset(outptr, 0, 255);
+					outptr += 255;
+				}
+				if (count < 0)
+				{
+					break;
+				}
+				if (outptr > (&out[out_size - (*inptr)]))
+				{
+					return -1;
+				}
+				memset(outptr, 0, (*inptr) - 1);
+				outptr += ((*inptr) - 1);
+				inptr++;
+			}
+		}
+		return (S32) (outptr - out);
+	}
+
+	// fixed seed, so a failure can be reproduced
+	struct Random
+	{
+		Random() : mState(0x9e3779b9) {}
+
+		U32 next(U32 range)
+		{
+			mState ^= mState << 13;
+			mState ^= mState >> 17;
+			mState ^= mState << 5;
+			return mState % range;
+		}
+
+		U32 mState;
+	};
+
+	// something like an object update: runs of zeroes of all lengths
+	// between runs of other bytes
+	std::vector<U8> make_body(Random& random, S32 size)
+	{
+		std::vector<U8> body;
+		body.reserve(size);
+		while ((S32) body.size() < size)
+		{
+			S32 run = 1 + random.next(random.next(4) ? 24 : 700);
+			bool zeroes = random.next(2);
+			for (S32 i = 0; i < run && (S32) body.size() < size; ++i)
+			{
+				body.push_back(zeroes ? 0 : 1 + random.next(255));
+			}
+		}
+		return body;
+	}
+
+	const U8 GUARD = 0xcd;
+	const S32 GUARD_SIZE = 64;
+}
+
+namespace tut
+{
+	struct llzerocode_test
+	{
+		// codes the body both ways and checks that it expands back
+		void roundTrip(const std::vector<U8>& body)
+		{
+			S32 size = body.size();
+			const U8* in = size ? &body[0] : NULL;
+			std::vector<U8> coded(2 * size + GUARD_SIZE, GUARD);
+			std::vector<U8> legacy(2 * size + GUARD_SIZE, GUARD);
+
+			S32 coded_size = ll_zero_code(in, size, &coded[0]);
+			S32 legacy_size = legacy_zero_code(in, size, &legacy[0]);
+			ensure_equals("coded size", coded_size, legacy_size);
+			ensure("coded like before", !memcmp(&coded[0], &legacy[0], coded_size));
+			ensure_equals("measured size", ll_zero_code(in, size, NULL), coded_size);
+			ensure_equals("within bound", coded[2 * size], GUARD);
+
+			std::vector<U8> expanded(size + GUARD_SIZE, GUARD);
+			ensure_equals("expanded size", ll_zero_code_expand(&coded[0], coded_size, &expanded[0], size), size);
+			ensure("expanded back", !size || !memcmp(&expanded[0], in, size));
+			ensure_equals("nothing past the end", expanded[size], GUARD);
+			if (size)
+			{
+				std::fill(expanded.begin(), expanded.end(), GUARD);
+				ensure_equals("one byte short", ll_zero_code_expand(&coded[0], coded_size, &expanded[0], size - 1), -1);
+				ensure_equals("still nothing past the end", expanded[size - 1], GUARD);
+			}
+		}
+	};
+	typedef test_group<llzerocode_test> llzerocode_test_t;
+	typedef llzerocode_test_t::object llzerocode_test_object_t;
+	tut::llzerocode_test_t tut_llzerocode_test("LLZeroCode");
+
+	// runs around the 255 byte limit and the chunk size, at every offset
+	template<> template<>
+	void llzerocode_test_object_t::test<1>()
+	{
+		roundTrip(std::vector<U8>());
+
+		const S32 runs[] = { 1, 2, 15, 16, 17, 31, 32, 33, 254, 255, 256, 509, 510, 511, 1000 };
+		for (S32 r = 0; r < LL_ARRAY_SIZE(runs); ++r)
+		{
+			for (S32 offset = 0; offset < 20; ++offset)
+			{
+				std::vector<U8> body(offset, 'x');
+				body.resize(offset + runs[r], 0);
+				roundTrip(body);
+				body.resize(body.size() + 19, 'y');
+				roundTrip(body);
+			}
+		}
+
+		std::vector<U8> alternating;
+		for (S32 i = 0; i < 100; ++i)
+		{
+			alternating.push_back(i & 1);
+			roundTrip(alternating);
+		}
+
+		// the wrap the coder never writes: 0 0 3 is 1 + 256 + 2 zeroes
+		const U8 wrap[] = { 'a', 0, 0, 3, 'b' };
+		U8 out[300];
+		ensure_equals("wrap", ll_zero_code_expand(wrap, sizeof(wrap), out, sizeof(out)), 261);
+		ensure_equals("wrap start", out[0], 'a');
+		ensure_equals("wrap end", out[260], 'b');
+		for (S32 i = 1; i < 260; ++i)
+		{
+			ensure_equals("wrap zeroes", out[i], 0);
+		}
+
+		// a zero at the very end has no count
+		const U8 trailing[] = { 'a', 0 };
+		ensure_equals("trailing zero", ll_zero_code_expand(trailing, sizeof(trailing), out, sizeof(out)), 2);
+	}
+
+	// random bodies of all sizes up to a packet
+	template<> template<>
+	void llzerocode_test_object_t::test<2>()
+	{
+		Random random;
+		for (S32 i = 0; i < 20000; ++i)
+		{
+			roundTrip(make_body(random, random.next(MAX_BUFFER_SIZE)));
+		}
+	}
+
+	// random input to the expander, as a broken or hostile packet would
+	// have.  It must never write past the buffer and give what the old
+	// expander did, which gave up up to 256 bytes before it had to.
+	template<> template<>
+	void llzerocode_test_object_t::test<3>()
+	{
+		Random random;
+		const S32 OUT_SIZE = MAX_BUFFER_SIZE;
+		std::vector<U8> out(OUT_SIZE + GUARD_SIZE);
+		std::vector<U8> legacy(OUT_SIZE + 1);
+		S32 overflows = 0;
+
+		for (S32 i = 0; i < 50000; ++i)
+		{
+			std::vector<U8> in(random.next(600));
+			U32 zeroes = 1 + random.next(8);
+			for (size_t j = 0; j < in.size(); ++j)
+			{
+				in[j] = random.next(zeroes) ? random.next(256) : 0;
+			}
+			const U8* inp = in.empty() ? NULL : &in[0];
+
+			std::fill(out.begin(), out.end(), GUARD);
+			S32 size = ll_zero_code_expand(inp, in.size(), &out[0], OUT_SIZE);
+			S32 legacy_size = legacy_zero_code_expand(inp, in.size(), &legacy[0], OUT_SIZE);
+			for (S32 j = OUT_SIZE; j < OUT_SIZE + GUARD_SIZE; ++j)
+			{
+				ensure_equals("nothing past the end", out[j], GUARD);
+			}
+
+			if (legacy_size >= 0)
+			{
+				ensure_equals("size", size, legacy_size);
+				ensure("contents", !memcmp(&out[0], &legacy[0], size));
+			}
+			else if (size >= 0)
+			{
+				ensure("old expander only stricter near the end", size > OUT_SIZE - 256);
+			}
+			else
+			{
+				++overflows;
+			}
+		}
+		ensure("overflows covered", overflows > 1000);
+	}
+
+	// throughput against the old scalar loops on update sized bodies
+	template<> template<>
+	void llzerocode_test_object_t::test<4>()
+	{
+		const S32 NUM_BODIES = 256;
+		const S32 NUM_PASSES = 200;
+
+		Random random;
+		std::vector<std::vector<U8> > bodies(NUM_BODIES);
+		std::vector<std::vector<U8> > coded(NUM_BODIES);
+		S64 total = 0;
+		for (S32 i = 0; i < NUM_BODIES; ++i)
+		{
+			bodies[i] = make_body(random, 200 + random.next(1000));
+			coded[i].resize(2 * bodies[i].size());
+			coded[i].resize(ll_zero_code(&bodies[i][0], bodies[i].size(), &coded[i][0]));
+			total += bodies[i].size();
+		}
+		total *= NUM_PASSES;
+
+		std::vector<U8> buffer(2 * MAX_BUFFER_SIZE);
+		S64 checksum = 0;
+		S64 legacy_checksum = 0;
+		LLTimer timer;
+
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_BODIES; ++i)
+			{
+				checksum += ll_zero_code(&bodies[i][0], bodies[i].size(), &buffer[0]);
+			}
+		}
+		F64 code_time = timer.getElapsedTimeF64();
+		timer.reset();
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_BODIES; ++i)
+			{
+				legacy_checksum += legacy_zero_code(&bodies[i][0], bodies[i].size(), &buffer[0]);
+			}
+		}
+		F64 legacy_code_time = timer.getElapsedTimeF64();
+		timer.reset();
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_BODIES; ++i)
+			{
+				checksum += ll_zero_code_expand(&coded[i][0], coded[i].size(), &buffer[0], MAX_BUFFER_SIZE);
+			}
+		}
+		F64 expand_time = timer.getElapsedTimeF64();
+		timer.reset();
+		for (S32 pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			for (S32 i = 0; i < NUM_BODIES; ++i)
+			{
+				legacy_checksum += legacy_zero_code_expand(&coded[i][0], coded[i].size(), &buffer[0], MAX_BUFFER_SIZE);
+			}
+		}
+		F64 legacy_expand_time = timer.getElapsedTimeF64();
+
+		F64 mb = total / (1024.0 * 1024.0);
+		LL_INFOS() << "zero code " << mb / code_time << " MB/s (was " << mb / legacy_code_time << "), expand "
+			<< mb / expand_time << " MB/s (was " << mb / legacy_expand_time << ")" << LL_ENDL;
+		ensure_equals("same results", checksum, legacy_checksum);
+	}
+}
@@ -1277,9 +1277,6 @@ BOOL LLPrimitive::packTEMessage(LLDataPacker &dp) const
 S32 LLPrimitive::parseTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num, LLTEContents& tec)
 {
 	S32 retval = 0;
-   // temp buffer for material ID processing
-   // data will end up in tec.material_id[]	
-   U8 material_data[LLTEContents::MAX_TES*16];
 
 	if (block_num < 0)
 	{
@@ -1305,7 +1302,23 @@ S32 LLPrimitive::parseTEMessage(LLMessageSystem* mesgsys, char const* block_name
 		mesgsys->getBinaryDataFast(block_name, _PREHASH_TextureEntry, tec.packed_buffer, 0, block_num, LLTEContents::MAX_TE_BUFFER);
 	}
 
-	tec.face_count = llmin((U32)getNumTEs(),(U32)LLTEContents::MAX_TES);
+	return parseTEContents(tec, getNumTEs());
+}
+
+//static
+S32 LLPrimitive::parseTEContents(LLTEContents& tec, U32 face_count)
+{
+	// temp buffer for material ID processing
+	// data will end up in tec.material_id[]
+	U8 material_data[LLTEContents::MAX_TES*16];
+
+	if (tec.size == 0)
+	{
+		tec.face_count = 0;
+		return 0;
+	}
+
+	tec.face_count = llmin(face_count, (U32)LLTEContents::MAX_TES);
 
 	U8 *cur_ptr = tec.packed_buffer;
 	cur_ptr += unpackTEField(cur_ptr, tec.packed_buffer+tec.size, (U8 *)tec.image_data, 16, tec.face_count, MVT_LLUUID);
@@ -1343,9 +1356,8 @@ S32 LLPrimitive::parseTEMessage(LLMessageSystem* mesgsys, char const* block_name
 		tec.material_ids[i].set(&material_data[i * 16]);
 	}
 	
-	retval = 1;
-	return retval;
-	}
+	return 1;
+}
 	
 S32 LLPrimitive::applyParsedTEMessage(LLTEContents& tec)
 {
@@ -184,6 +184,16 @@ PFNGLISVERTEXARRAYPROC glIsVertexArray = NULL;
 PFNGLMAPBUFFERRANGEPROC			glMapBufferRange = NULL;
 PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange = NULL;
 
+// GL_ARB_copy_buffer
+#ifdef GL_ARB_copy_buffer
+PFNGLCOPYBUFFERSUBDATAPROC		glCopyBufferSubData = NULL;
+#endif
+
+// GL_ARB_buffer_storage
+#ifdef GL_ARB_buffer_storage
+PFNGLBUFFERSTORAGEPROC			glBufferStorage = NULL;
+#endif
+
 // GL_ARB_sync
 PFNGLFENCESYNCPROC				glFenceSync = NULL;
 PFNGLISSYNCPROC					glIsSync = NULL;
@@ -428,6 +438,8 @@ LLGLManager::LLGLManager() :
 	mHasVertexArrayObject(FALSE),
 	mHasMapBufferRange(FALSE),
 	mHasFlushBufferRange(FALSE),
+	mHasCopyBuffer(FALSE),
+	mHasBufferStorage(FALSE),
 	mHasPBuffer(FALSE),
 	mHasShaderObjects(FALSE),
 	mHasVertexShader(FALSE),
@@ -996,6 +1008,8 @@ void LLGLManager::initExtensions()
 	mHasSync = ExtensionExists("GL_ARB_sync", gGLHExts.mSysExts);
 	mHasMapBufferRange = ExtensionExists("GL_ARB_map_buffer_range", gGLHExts.mSysExts);
 	mHasFlushBufferRange = ExtensionExists("GL_APPLE_flush_buffer_range", gGLHExts.mSysExts);
+	mHasCopyBuffer = ExtensionExists("GL_ARB_copy_buffer", gGLHExts.mSysExts);
+	mHasBufferStorage = ExtensionExists("GL_ARB_buffer_storage", gGLHExts.mSysExts);
 	//mHasDepthClamp = ExtensionExists("GL_ARB_depth_clamp", gGLHExts.mSysExts) || ExtensionExists("GL_NV_depth_clamp", gGLHExts.mSysExts);
 	mHasDepthClamp = FALSE;
 	// mask out FBO support when packed_depth_stencil isn't there 'cause we need it for LLRenderTarget -Brad
@@ -1228,6 +1242,18 @@ void LLGLManager::initExtensions()
 		glMapBufferRange = (PFNGLMAPBUFFERRANGEPROC) GLH_EXT_GET_PROC_ADDRESS("glMapBufferRange");
 		glFlushMappedBufferRange = (PFNGLFLUSHMAPPEDBUFFERRANGEPROC) GLH_EXT_GET_PROC_ADDRESS("glFlushMappedBufferRange");
 	}
+#ifdef GL_ARB_copy_buffer
+	if (mHasCopyBuffer)
+	{
+		glCopyBufferSubData = (PFNGLCOPYBUFFERSUBDATAPROC) GLH_EXT_GET_PROC_ADDRESS("glCopyBufferSubData");
+	}
+#endif
+#ifdef GL_ARB_buffer_storage
+	if (mHasBufferStorage)
+	{
+		glBufferStorage = (PFNGLBUFFERSTORAGEPROC) GLH_EXT_GET_PROC_ADDRESS("glBufferStorage");
+	}
+#endif
 	if (mHasFramebufferObject)
 	{
 		LL_INFOS() << "initExtensions() FramebufferObject-related procs..." << LL_ENDL;
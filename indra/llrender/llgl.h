@@ -92,6 +92,8 @@ public:
 	BOOL mHasSync;
 	BOOL mHasMapBufferRange;
 	BOOL mHasFlushBufferRange;
+	BOOL mHasCopyBuffer;
+	BOOL mHasBufferStorage;
 	BOOL mHasPBuffer;
 	BOOL mHasShaderObjects;
 	BOOL mHasVertexShader;
@@ -75,6 +75,12 @@ extern PFNGLBUFFERPARAMETERIAPPLEPROC	glBufferParameteriAPPLE;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEAPPLEPROC glFlushMappedBufferRangeAPPLE;
 extern PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
+#ifdef GL_ARB_copy_buffer
+extern PFNGLCOPYBUFFERSUBDATAPROC		glCopyBufferSubData;
+#endif
+#ifdef GL_ARB_buffer_storage
+extern PFNGLBUFFERSTORAGEPROC			glBufferStorage;
+#endif
 extern PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI;
 extern PFNGLISOBJECTBUFFERATIPROC			glIsObjectBufferATI;
 extern PFNGLUPDATEOBJECTBUFFERATIPROC		glUpdateObjectBufferATI;
@@ -295,6 +301,12 @@ extern PFNGLBUFFERPARAMETERIAPPLEPROC	glBufferParameteriAPPLE;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEAPPLEPROC glFlushMappedBufferRangeAPPLE;
 extern PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
+#ifdef GL_ARB_copy_buffer
+extern PFNGLCOPYBUFFERSUBDATAPROC		glCopyBufferSubData;
+#endif
+#ifdef GL_ARB_buffer_storage
+extern PFNGLBUFFERSTORAGEPROC			glBufferStorage;
+#endif
 extern PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI;
 extern PFNGLISOBJECTBUFFERATIPROC			glIsObjectBufferATI;
 extern PFNGLUPDATEOBJECTBUFFERATIPROC		glUpdateObjectBufferATI;
@@ -498,6 +510,12 @@ extern PFNGLBUFFERPARAMETERIAPPLEPROC	glBufferParameteriAPPLE;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEAPPLEPROC glFlushMappedBufferRangeAPPLE;
 extern PFNGLMAPBUFFERRANGEPROC			glMapBufferRange;
 extern PFNGLFLUSHMAPPEDBUFFERRANGEPROC	glFlushMappedBufferRange;
+#ifdef GL_ARB_copy_buffer
+extern PFNGLCOPYBUFFERSUBDATAPROC		glCopyBufferSubData;
+#endif
+#ifdef GL_ARB_buffer_storage
+extern PFNGLBUFFERSTORAGEPROC			glBufferStorage;
+#endif
 extern PFNGLNEWOBJECTBUFFERATIPROC			glNewObjectBufferATI;
 extern PFNGLISOBJECTBUFFERATIPROC			glIsObjectBufferATI;
 extern PFNGLUPDATEOBJECTBUFFERATIPROC		glUpdateObjectBufferATI;
@@ -117,6 +117,7 @@ bool LLVertexBuffer::sMapped = false;
 bool LLVertexBuffer::sUseStreamDraw = true;
 bool LLVertexBuffer::sUseVAO = false;
 bool LLVertexBuffer::sPreferStreamDraw = false;
+U32 LLVertexBuffer::sStreamRingSize = 0;
 
 
 U32 LLVBOPool::genBuffer()
@@ -144,10 +145,175 @@ void LLVBOPool::deleteBuffer(U32 name)
 
 
 LLVBOPool::LLVBOPool(U32 vboUsage, U32 vboType)
-: mUsage(vboUsage), mType(vboType)
+: mUsage(vboUsage), mType(vboType),
+  mHits(0),
+  mMisses(0),
+  mRingName(0),
+  mRingData(NULL),
+  mRingSize(0),
+  mRingHead(0),
+  mRingSegment(0),
+  mStreamHits(0),
+  mStreamMisses(0),
+  mStreamStalls(0),
+  mStreamedBytes(0)
 {
 	mMissCount.resize(LL_VBO_POOL_SEED_COUNT);
 	std::fill(mMissCount.begin(), mMissCount.end(), 0);
+
+	for (U32 i = 0; i < STREAM_RING_SEGMENTS; ++i)
+	{
+		mRingFence[i] = NULL;
+	}
+}
+
+bool LLVBOPool::initStreamRing(U32 size)
+{
+	if (mRingData)
+	{
+		return true;
+	}
+
+#if defined(GL_ARB_buffer_storage) && defined(GL_ARB_copy_buffer)
+	if (!gGLManager.mHasBufferStorage || !gGLManager.mHasCopyBuffer ||
+		!gGLManager.mHasSync || !gGLManager.mHasMapBufferRange)
+	{
+		return false;
+	}
+
+	//keep segments a multiple of the 64 byte copy alignment
+	const U32 granularity = STREAM_RING_SEGMENTS*64;
+	size -= size % granularity;
+	if (size == 0)
+	{
+		return false;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	mRingName = genBuffer();
+	glBindBufferARB(GL_COPY_READ_BUFFER, mRingName);
+	glBufferStorage(GL_COPY_READ_BUFFER, size, NULL, flags);
+	mRingData = (volatile U8*) glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags);
+	glBindBufferARB(GL_COPY_READ_BUFFER, 0);
+	stop_glerror();
+
+	if (!mRingData)
+	{
+		LL_WARNS() << "Unable to map " << size << " byte stream ring, falling back to glBufferSubData." << LL_ENDL;
+		glDeleteBuffersARB(1, &mRingName);
+		mRingName = 0;
+		return false;
+	}
+
+	mRingSize = size;
+	mRingHead = 0;
+	mRingSegment = 0;
+	for (U32 i = 0; i < STREAM_RING_SEGMENTS; ++i)
+	{
+		mRingFence[i] = new LLGLSyncFence();
+	}
+
+	if (mType == GL_ARRAY_BUFFER_ARB)
+	{
+		LLVertexBuffer::sAllocatedBytes += size;
+	}
+	else
+	{
+		LLVertexBuffer::sAllocatedIndexBytes += size;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void LLVBOPool::cleanupStreamRing()
+{
+	if (!mRingData)
+	{
+		return;
+	}
+
+	//the fence destructors release their sync objects
+	for (U32 i = 0; i < STREAM_RING_SEGMENTS; ++i)
+	{
+		delete mRingFence[i];
+		mRingFence[i] = NULL;
+	}
+
+#if defined(GL_ARB_buffer_storage) && defined(GL_ARB_copy_buffer)
+	if (gGLManager.mInited)
+	{
+		glBindBufferARB(GL_COPY_READ_BUFFER, mRingName);
+		glUnmapBufferARB(GL_COPY_READ_BUFFER);
+		glBindBufferARB(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffersARB(1, &mRingName);
+	}
+#endif
+
+	if (mType == GL_ARRAY_BUFFER_ARB)
+	{
+		LLVertexBuffer::sAllocatedBytes -= mRingSize;
+	}
+	else
+	{
+		LLVertexBuffer::sAllocatedIndexBytes -= mRingSize;
+	}
+
+	mRingName = 0;
+	mRingData = NULL;
+	mRingSize = 0;
+}
+
+bool LLVBOPool::streamData(U32 offset, U32 length, const volatile U8* data)
+{
+	if (!mRingData)
+	{
+		return false;
+	}
+
+#if defined(GL_ARB_buffer_storage) && defined(GL_ARB_copy_buffer)
+	const U32 segment_size = mRingSize/STREAM_RING_SEGMENTS;
+	const U32 aligned_length = (length+0x3F) & ~0x3F;
+
+	if (aligned_length > segment_size)
+	{ //would span segments, let the caller upload it directly
+		mStreamMisses++;
+		return false;
+	}
+
+	if (mRingHead + aligned_length > (mRingSegment+1)*segment_size)
+	{ //fence off the segment we're leaving and wait for the GPU to finish
+		//copying out of the one we're entering, which was fenced a full lap ago
+		mRingFence[mRingSegment]->placeFence();
+		mRingSegment = (mRingSegment+1) % STREAM_RING_SEGMENTS;
+		mRingHead = mRingSegment*segment_size;
+
+		LLGLSyncFence* fence = mRingFence[mRingSegment];
+		if (!fence->isCompleted())
+		{
+			mStreamStalls++;
+			fence->wait();
+		}
+	}
+
+	//the ring is coherently mapped, so the copy sees this write without a flush
+	memcpy((U8*) mRingData+mRingHead, (const U8*) data, length);
+
+	glBindBufferARB(GL_COPY_READ_BUFFER, mRingName);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, mType, mRingHead, offset, length);
+	stop_glerror();
+
+	mRingHead += aligned_length;
+	mStreamHits++;
+	mStreamedBytes += length;
+
+	return true;
+#else
+	return false;
+#endif
 }
 
 volatile U8* LLVBOPool::allocate(U32& name, U32 size, bool for_seed)
@@ -170,9 +336,13 @@ volatile U8* LLVBOPool::allocate(U32& name, U32 size, bool for_seed)
 		
 		glBindBufferARB(mType, name);
 
-		if (!for_seed && i < LL_VBO_POOL_SEED_COUNT)
+		if (!for_seed)
 		{ //record this miss
-			mMissCount[i]++;	
+			mMisses++;
+			if (i < LL_VBO_POOL_SEED_COUNT)
+			{
+				mMissCount[i]++;
+			}
 		}
 
 		if (mType == GL_ARRAY_BUFFER_ARB)
@@ -222,6 +392,7 @@ volatile U8* LLVBOPool::allocate(U32& name, U32 size, bool for_seed)
 	{
 		name = mFreeList[i].front().mGLName;
 		ret = mFreeList[i].front().mClientData;
+		mHits++;
 
 		if (mType == GL_ARRAY_BUFFER_ARB)
 		{
@@ -873,6 +1044,19 @@ void LLVertexBuffer::initClass(bool use_vbo, bool no_vbo_mapping)
 {
 	sEnableVBOs = use_vbo && gGLManager.mHasVertexBufferObject;
 	sDisableVBOMapping = sEnableVBOs && no_vbo_mapping;
+
+	if (sEnableVBOs && sStreamRingSize > 0)
+	{ //indices are a fraction of the vertex data streamed
+		if (sStreamVBOPool.initStreamRing(sStreamRingSize) &&
+			sStreamIBOPool.initStreamRing(sStreamRingSize/4))
+		{
+			LL_INFOS("RenderInit") << "Streaming vertex data through a " << sStreamRingSize/(1024*1024) << " MB ring." << LL_ENDL;
+		}
+		else
+		{
+			sStreamVBOPool.cleanupStreamRing();
+		}
+	}
 }
 
 //static 
@@ -915,6 +1099,9 @@ void LLVertexBuffer::cleanupClass()
 	sStreamVBOPool.cleanup();
 	sDynamicVBOPool.cleanup();
 	sDynamicCopyVBOPool.cleanup();
+
+	sStreamVBOPool.cleanupStreamRing();
+	sStreamIBOPool.cleanupStreamRing();
 }
 
 //----------------------------------------------------------------------------
@@ -1892,13 +2079,16 @@ void LLVertexBuffer::unmapBuffer()
 					const MappedRegion& region = mMappedVertexRegions[i];
 					S32 offset = region.mIndex >= 0 ? mOffsets[region.mType]+sTypeSize[region.mType]*region.mIndex : 0;
 					S32 length = sTypeSize[region.mType]*region.mCount;
-					glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, offset, length, (U8*) mMappedData+offset);
+					if (mUsage != GL_STREAM_DRAW_ARB || !sStreamVBOPool.streamData(offset, length, mMappedData+offset))
+					{
+						glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, offset, length, (U8*) mMappedData+offset);
+					}
 					stop_glerror();
 				}
 
 				mMappedVertexRegions.clear();
 			}
-			else
+			else if (mUsage != GL_STREAM_DRAW_ARB || !sStreamVBOPool.streamData(0, getSize(), mMappedData))
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ARRAY_BUFFER_ARB, getSize(), NULL, mUsage);
@@ -1963,13 +2153,16 @@ void LLVertexBuffer::unmapBuffer()
 					const MappedRegion& region = mMappedIndexRegions[i];
 					S32 offset = region.mIndex >= 0 ? sizeof(U16)*region.mIndex : 0;
 					S32 length = sizeof(U16)*region.mCount;
-					glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, offset, length, (U8*) mMappedIndexData+offset);
+					if (mUsage != GL_STREAM_DRAW_ARB || !sStreamIBOPool.streamData(offset, length, mMappedIndexData+offset))
+					{
+						glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, offset, length, (U8*) mMappedIndexData+offset);
+					}
 					stop_glerror();
 				}
 
 				mMappedIndexRegions.clear();
 			}
-			else
+			else if (mUsage != GL_STREAM_DRAW_ARB || !sStreamIBOPool.streamData(0, getIndicesSize(), mMappedIndexData))
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, getIndicesSize(), NULL, mUsage);
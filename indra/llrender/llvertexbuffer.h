@@ -78,6 +78,23 @@ public:
 	U32 genBuffer();
 	void deleteBuffer(U32 name);
 
+	//create a persistently mapped ring of size bytes that streamData() copies through
+	//requires GL_ARB_buffer_storage, GL_ARB_copy_buffer and GL_ARB_sync
+	bool initStreamRing(U32 size);
+	void cleanupStreamRing();
+	bool hasStreamRing() const { return mRingData != NULL; }
+
+	//upload length bytes of data to offset in the buffer currently bound to mType
+	//without mapping it, returns false if the caller must upload the data itself
+	bool streamData(U32 offset, U32 length, const volatile U8* data);
+
+	U32 getHitCount() const { return mHits; }
+	U32 getMissCount() const { return mMisses; }
+	U32 getStreamHitCount() const { return mStreamHits; }
+	U32 getStreamMissCount() const { return mStreamMisses; }
+	U32 getStreamStallCount() const { return mStreamStalls; }
+	U64 getStreamedBytes() const { return mStreamedBytes; }
+
 	class Record
 	{
 	public:
@@ -89,6 +106,25 @@ public:
 	std::vector<record_list_t> mFreeList;
 	std::vector<U32> mMissCount;
 
+private:
+	//the ring is split into segments, each fenced when the head leaves it so it
+	//is only written again once the GPU is done copying out of it
+	enum { STREAM_RING_SEGMENTS = 4 };
+
+	U32 mHits;
+	U32 mMisses;
+
+	U32 mRingName;
+	volatile U8* mRingData;
+	U32 mRingSize;
+	U32 mRingHead;
+	U32 mRingSegment;
+	LLGLSyncFence* mRingFence[STREAM_RING_SEGMENTS];
+
+	U32 mStreamHits;
+	U32 mStreamMisses;
+	U32 mStreamStalls;
+	U64 mStreamedBytes;
 };
 
 
@@ -139,6 +175,9 @@ public:
 	static U32 getVAOName();
 	static void releaseVAOName(U32 name);
 
+	//size of the stream upload ring for vertex data, 0 to disable
+	static U32 sStreamRingSize;
+
 	static void initClass(bool use_vbo, bool no_vbo_mapping);
 	static void cleanupClass();
 	static void setupClientArrays(U32 data_mask);
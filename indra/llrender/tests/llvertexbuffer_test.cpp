@@ -0,0 +1,369 @@
+/**
+ * @file llvertexbuffer_test.cpp
+ * @brief LLVBOPool stream ring tests, run on a surfaceless EGL context so
+ * they need no window, and on a headless box draw on Mesa's llvmpipe.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvertexbuffer.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../llgl.h"
+#include "../llglheaders.h"
+#include "../llglslshader.h"
+#include "../llrender.h"
+#include "../llshadermgr.h"
+
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+BOOL gDebugGL = FALSE;
+BOOL gDebugSession = FALSE;
+std::ofstream gFailLog;
+void assert_glerror() {}
+void log_glerror() {}
+
+// the flags are set from the context's extensions when it is made current
+LLGLManager::LLGLManager() {}
+LLGLManager gGLManager;
+
+// The entry points llgl.cpp would load, loaded from the test context instead.
+PFNGLBINDBUFFERARBPROC				glBindBufferARB = NULL;
+PFNGLDELETEBUFFERSARBPROC			glDeleteBuffersARB = NULL;
+PFNGLGENBUFFERSARBPROC				glGenBuffersARB = NULL;
+PFNGLBUFFERDATAARBPROC				glBufferDataARB = NULL;
+PFNGLBUFFERSUBDATAARBPROC			glBufferSubDataARB = NULL;
+PFNGLGETBUFFERSUBDATAARBPROC		glGetBufferSubDataARB = NULL;
+PFNGLMAPBUFFERARBPROC				glMapBufferARB = NULL;
+PFNGLUNMAPBUFFERARBPROC				glUnmapBufferARB = NULL;
+PFNGLGETBUFFERPARAMETERIVARBPROC	glGetBufferParameterivARB = NULL;
+PFNGLMAPBUFFERRANGEPROC				glMapBufferRange = NULL;
+PFNGLFLUSHMAPPEDBUFFERRANGEPROC		glFlushMappedBufferRange = NULL;
+PFNGLCOPYBUFFERSUBDATAPROC			glCopyBufferSubData = NULL;
+PFNGLBUFFERSTORAGEPROC				glBufferStorage = NULL;
+PFNGLFENCESYNCPROC					glFenceSync = NULL;
+PFNGLDELETESYNCPROC					glDeleteSync = NULL;
+PFNGLCLIENTWAITSYNCPROC				glClientWaitSync = NULL;
+PFNGLBINDVERTEXARRAYPROC			glBindVertexArray = NULL;
+PFNGLGENVERTEXARRAYSPROC			glGenVertexArrays = NULL;
+PFNGLBINDBUFFERRANGEPROC			glBindBufferRange = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYARBPROC	glEnableVertexAttribArrayARB = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYARBPROC glDisableVertexAttribArrayARB = NULL;
+PFNGLVERTEXATTRIBPOINTERARBPROC		glVertexAttribPointerARB = NULL;
+PFNGLVERTEXATTRIBIPOINTERPROC		glVertexAttribIPointer = NULL;
+PFNGLBUFFERPARAMETERIAPPLEPROC		glBufferParameteriAPPLE = NULL;
+PFNGLFLUSHMAPPEDBUFFERRANGEAPPLEPROC glFlushMappedBufferRangeAPPLE = NULL;
+
+// Fences on real sync objects, the ring's stall count depends on when the GPU gets to them.
+LLGLSyncFence::LLGLSyncFence() : mSync(0) {}
+LLGLSyncFence::~LLGLSyncFence() { if (mSync) glDeleteSync(mSync); }
+void LLGLSyncFence::placeFence() { if (mSync) glDeleteSync(mSync); mSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); }
+bool LLGLSyncFence::isCompleted() { return !mSync || glClientWaitSync(mSync, 0, 0) != GL_TIMEOUT_EXPIRED; }
+void LLGLSyncFence::wait() { while (mSync && glClientWaitSync(mSync, 0, 1000000) == GL_TIMEOUT_EXPIRED) {} }
+
+LLRender::LLRender() {}
+LLRender::~LLRender() {}
+void LLRender::syncMatrices() {}
+bool LLRender::sGLCoreProfile = false;
+LLRender gGL;
+
+LLGLSLShader* LLGLSLShader::sCurBoundShaderPtr = NULL;
+bool LLGLSLShader::sNoFixedFunction = false;
+void LLGLSLShader::startProfile() {}
+void LLGLSLShader::stopProfile(U32 count, U32 mode) {}
+GLint LLGLSLShader::getAttribLocation(U32 attrib) { return -1; }
+
+LLShaderMgr* LLShaderMgr::instance() { return NULL; }
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	// 4 segments of 1 KB
+	const U32 RING_SIZE = 4096;
+	const U32 SEGMENT_SIZE = RING_SIZE / 4;
+
+	bool has_extension(const std::string& extensions, const char* name)
+	{
+		return (" " + extensions + " ").find(std::string(" ") + name + " ") != std::string::npos;
+	}
+
+	template <class T> void load_proc(T& proc, const char* name)
+	{
+		proc = (T) eglGetProcAddress(name);
+	}
+
+	// A context without a window or pbuffer.  Mesa's surfaceless platform
+	// renders on llvmpipe when there is no GPU, so this runs on build hosts.
+	// Made once and kept current for every test.
+	bool make_context_current()
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (!get_platform_display)
+		{
+			return false;
+		}
+
+		EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		EGLint major, minor;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+		{
+			return false;
+		}
+
+		EGLContext context = eglCreateContext(display, (EGLConfig) 0, EGL_NO_CONTEXT, NULL);
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			return false;
+		}
+
+		const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+		std::string ext = extensions ? extensions : "";
+		gGLManager.mHasVertexBufferObject = has_extension(ext, "GL_ARB_vertex_buffer_object");
+		gGLManager.mHasMapBufferRange = has_extension(ext, "GL_ARB_map_buffer_range");
+		gGLManager.mHasSync = has_extension(ext, "GL_ARB_sync");
+		gGLManager.mHasCopyBuffer = has_extension(ext, "GL_ARB_copy_buffer");
+		gGLManager.mHasBufferStorage = has_extension(ext, "GL_ARB_buffer_storage");
+		gGLManager.mInited = TRUE;
+
+		load_proc(glBindBufferARB, "glBindBufferARB");
+		load_proc(glDeleteBuffersARB, "glDeleteBuffersARB");
+		load_proc(glGenBuffersARB, "glGenBuffersARB");
+		load_proc(glBufferDataARB, "glBufferDataARB");
+		load_proc(glBufferSubDataARB, "glBufferSubDataARB");
+		load_proc(glGetBufferSubDataARB, "glGetBufferSubDataARB");
+		load_proc(glMapBufferARB, "glMapBufferARB");
+		load_proc(glUnmapBufferARB, "glUnmapBufferARB");
+		load_proc(glGetBufferParameterivARB, "glGetBufferParameterivARB");
+		load_proc(glMapBufferRange, "glMapBufferRange");
+		load_proc(glFlushMappedBufferRange, "glFlushMappedBufferRange");
+		load_proc(glCopyBufferSubData, "glCopyBufferSubData");
+		load_proc(glBufferStorage, "glBufferStorage");
+		load_proc(glFenceSync, "glFenceSync");
+		load_proc(glDeleteSync, "glDeleteSync");
+		load_proc(glClientWaitSync, "glClientWaitSync");
+		load_proc(glBindVertexArray, "glBindVertexArray");
+		load_proc(glGenVertexArrays, "glGenVertexArrays");
+		load_proc(glBindBufferRange, "glBindBufferRange");
+		load_proc(glEnableVertexAttribArrayARB, "glEnableVertexAttribArrayARB");
+		load_proc(glDisableVertexAttribArrayARB, "glDisableVertexAttribArrayARB");
+		load_proc(glVertexAttribPointerARB, "glVertexAttribPointerARB");
+		load_proc(glVertexAttribIPointer, "glVertexAttribIPointer");
+
+		return gGLManager.mHasVertexBufferObject && gGLManager.mHasMapBufferRange &&
+			gGLManager.mHasSync && gGLManager.mHasCopyBuffer && gGLManager.mHasBufferStorage;
+	}
+
+	void fill_pattern(std::vector<U8>& data, U32 seed)
+	{
+		for (U32 i = 0; i < data.size(); ++i)
+		{
+			data[i] = (U8) (i * 31 + seed * 7 + 1);
+		}
+	}
+
+	std::vector<U8> read_back(U32 target, U32 offset, U32 length)
+	{
+		std::vector<U8> data(length);
+		glGetBufferSubDataARB(target, offset, length, &data[0]);
+		return data;
+	}
+}
+
+namespace tut
+{
+	struct vertexbuffer_test
+	{
+		vertexbuffer_test()
+		:	mPool(GL_STREAM_DRAW_ARB, GL_ARRAY_BUFFER_ARB),
+			mBuffer(0)
+		{
+			static bool has_context = make_context_current();
+			mHasContext = has_context;
+		}
+
+		~vertexbuffer_test()
+		{
+			if (mBuffer)
+			{
+				glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+				glDeleteBuffersARB(1, &mBuffer);
+			}
+			mPool.cleanupStreamRing();
+		}
+
+		// a zeroed buffer of size bytes bound to GL_ARRAY_BUFFER, for the ring to copy into
+		void makeRingAndBuffer(U32 size)
+		{
+			if (!mHasContext)
+			{
+				skip("no surfaceless EGL context with buffer storage, copy buffer and sync");
+			}
+
+			ensure("ring made", mPool.initStreamRing(RING_SIZE));
+			ensure("has ring", mPool.hasStreamRing());
+
+			std::vector<U8> zeros(size, 0);
+			glGenBuffersARB(1, &mBuffer);
+			glBindBufferARB(GL_ARRAY_BUFFER_ARB, mBuffer);
+			glBufferDataARB(GL_ARRAY_BUFFER_ARB, size, &zeros[0], GL_STREAM_DRAW_ARB);
+		}
+
+		LLVBOPool mPool;
+		U32 mBuffer;
+		bool mHasContext;
+	};
+	typedef test_group<vertexbuffer_test> vertexbuffer_t;
+	typedef vertexbuffer_t::object vertexbuffer_object_t;
+	tut::vertexbuffer_t tut_vertexbuffer("LLVertexBuffer");
+
+	// uploads land where they were asked to and count as ring hits
+	template<> template<>
+	void vertexbuffer_object_t::test<1>()
+	{
+		makeRingAndBuffer(RING_SIZE);
+
+		std::vector<U8> first(300), second(1000);
+		fill_pattern(first, 1);
+		fill_pattern(second, 2);
+		ensure("first streamed", mPool.streamData(100, first.size(), &first[0]));
+		ensure("second streamed", mPool.streamData(2000, second.size(), &second[0]));
+
+		ensure("first uploaded", read_back(GL_ARRAY_BUFFER_ARB, 100, first.size()) == first);
+		ensure("second uploaded", read_back(GL_ARRAY_BUFFER_ARB, 2000, second.size()) == second);
+		ensure("nothing in between", read_back(GL_ARRAY_BUFFER_ARB, 400, 1600) == std::vector<U8>(1600, 0));
+		ensure_equals("hits", mPool.getStreamHitCount(), 2U);
+		ensure_equals("misses", mPool.getStreamMissCount(), 0U);
+		ensure_equals("bytes", mPool.getStreamedBytes(), (U64) 1300);
+		ensure_equals("no errors", glGetError(), (GLenum) GL_NO_ERROR);
+	}
+
+	// an upload larger than a segment is left to the caller
+	template<> template<>
+	void vertexbuffer_object_t::test<2>()
+	{
+		makeRingAndBuffer(RING_SIZE);
+
+		std::vector<U8> data(SEGMENT_SIZE + 1);
+		fill_pattern(data, 3);
+		ensure("not streamed", !mPool.streamData(0, data.size(), &data[0]));
+		ensure("buffer untouched", read_back(GL_ARRAY_BUFFER_ARB, 0, data.size()) == std::vector<U8>(data.size(), 0));
+		ensure_equals("hits", mPool.getStreamHitCount(), 0U);
+		ensure_equals("misses", mPool.getStreamMissCount(), 1U);
+
+		data.resize(SEGMENT_SIZE);
+		ensure("a full segment is streamed", mPool.streamData(0, data.size(), &data[0]));
+		ensure("full segment uploaded", read_back(GL_ARRAY_BUFFER_ARB, 0, data.size()) == data);
+	}
+
+	// many laps around the ring upload every block intact, and a segment the
+	// GPU is done with is reused without a stall.  llvmpipe copies in order,
+	// so a missing fence wait only shows up on a GPU that copies later.
+	template<> template<>
+	void vertexbuffer_object_t::test<3>()
+	{
+		const U32 UPLOADS = 64;
+		const U32 LENGTH = SEGMENT_SIZE - 24;
+		makeRingAndBuffer(UPLOADS * LENGTH);
+
+		std::vector<std::vector<U8> > uploads(UPLOADS, std::vector<U8>(LENGTH));
+		for (U32 i = 0; i < UPLOADS; ++i)
+		{
+			fill_pattern(uploads[i], i);
+			ensure(llformat("upload %d streamed", i), mPool.streamData(i * LENGTH, LENGTH, &uploads[i][0]));
+		}
+
+		for (U32 i = 0; i < UPLOADS; ++i)
+		{
+			ensure(llformat("upload %d intact", i), read_back(GL_ARRAY_BUFFER_ARB, i * LENGTH, LENGTH) == uploads[i]);
+		}
+		ensure_equals("hits", mPool.getStreamHitCount(), UPLOADS);
+		ensure("stalls bounded by segment changes", mPool.getStreamStallCount() < UPLOADS);
+
+		glFinish();
+		const U32 stalls = mPool.getStreamStallCount();
+		ensure("streamed after finish", mPool.streamData(0, LENGTH, &uploads[1][0]));
+		ensure_equals("no stall once the GPU is done", mPool.getStreamStallCount(), stalls);
+		ensure("rewritten", read_back(GL_ARRAY_BUFFER_ARB, 0, LENGTH) == uploads[1]);
+	}
+
+	// a stream vertex buffer goes through the ring when it is flushed
+	template<> template<>
+	void vertexbuffer_object_t::test<4>()
+	{
+		if (!mHasContext)
+		{
+			skip("no surfaceless EGL context with buffer storage, copy buffer and sync");
+		}
+
+		LLVertexBuffer::sStreamRingSize = 64 * 1024;
+		LLVertexBuffer::initClass(true, false);
+		ensure("vertex ring", LLVertexBuffer::sStreamVBOPool.hasStreamRing());
+		ensure("index ring", LLVertexBuffer::sStreamIBOPool.hasStreamRing());
+
+		const S32 VERTICES = 16;
+		const U32 hits = LLVertexBuffer::sStreamVBOPool.getStreamHitCount();
+		{
+			LLPointer<LLVertexBuffer> buffer = new LLVertexBuffer(LLVertexBuffer::MAP_VERTEX, GL_STREAM_DRAW_ARB);
+			buffer->allocateBuffer(VERTICES, 0, true);
+
+			LLStrider<LLVector3> vertices;
+			ensure("mapped", buffer->getVertexStrider(vertices));
+			for (S32 i = 0; i < VERTICES; ++i)
+			{
+				*(vertices++) = LLVector3((F32) i, (F32) -i, 0.5f);
+			}
+			buffer->flush();
+			ensure_equals("streamed once", LLVertexBuffer::sStreamVBOPool.getStreamHitCount(), hits + 1);
+
+			// flushing leaves the buffer bound
+			const S32 stride = LLVertexBuffer::sTypeSize[LLVertexBuffer::TYPE_VERTEX];
+			std::vector<U8> data = read_back(GL_ARRAY_BUFFER_ARB, 0, stride * VERTICES);
+			for (S32 i = 0; i < VERTICES; ++i)
+			{
+				const F32* v = (const F32*) &data[i * stride];
+				ensure_equals(llformat("vertex %d x", i), v[0], (F32) i);
+				ensure_equals(llformat("vertex %d y", i), v[1], (F32) -i);
+				ensure_equals(llformat("vertex %d z", i), v[2], 0.5f);
+			}
+		}
+
+		LLVertexBuffer::cleanupClass();
+		LLVertexBuffer::sStreamRingSize = 0;
+		ensure("ring released", !LLVertexBuffer::sStreamVBOPool.hasStreamRing());
+		ensure_equals("no errors", glGetError(), (GLenum) GL_NO_ERROR);
+	}
+}
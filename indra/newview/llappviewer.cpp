@@ -120,6 +120,7 @@
 #include "llurlentry.h"
 #include "llvfile.h"
 #include "llvfsthread.h"
+#include "llvolumecache.h"
 #include "llvolumemgr.h"
 #include "llxfermanager.h"
 #include "llphysicsextensions.h"
@@ -159,6 +160,8 @@
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
+#include "llinflateservice.h"
+#include "lltexlayercomposite.h"
 #include "llevents.h"
 
 // The files below handle dependencies from cleanup.
@@ -1776,9 +1779,26 @@ bool LLAppViewer::cleanup()
 
 	LL_INFOS() << "Cleaning Up" << LL_ENDL;
 
+	// shut down inflating first, its jobs hand their results to the mesh
+	// streamer; queued jobs are dropped
+	gInflateService.stopThreads();
+
 	// shut down mesh streamer
 	gMeshRepo.shutdown();
 
+	// shut down volume generation, pending LODs are dropped
+	LLPrimitive::getVolumeManager()->stopGenerationThreads();
+	LLVolumeCache::cleanupClass();
+
+	// shut down object update decoding
+	gObjectList.stopUpdateDecoder();
+
+	// shut down avatar animation evaluation
+	LLVOAvatar::stopAnimationThreads();
+
+	// shut down baked texture compositing, pending bakes are dropped
+	LLTexLayerSetComposite::stopThreads();
+
 	// shut down Havok
 	LLPhysicsExtensions::quitSystem();
 
@@ -2194,9 +2214,24 @@ bool LLAppViewer::initThreads()
 		mFastTimerLogThread->start();
 	}
 
+	// Mesh LOD and zipped LLSD inflating
+	gInflateService.startThreads(enable_threads ? gSavedSettings.getU32("PVNetwork_InflateThreads") : 0);
+
 	// Mesh streaming and caching
 	gMeshRepo.init();
 
+	// Background prim and sculpt volume generation
+	LLPrimitive::getVolumeManager()->startGenerationThreads(enable_threads ? gSavedSettings.getU32("PVRender_VolumeGenerationThreads") : 0);
+
+	// Object update decoding
+	gObjectList.startUpdateDecoder(enable_threads ? gSavedSettings.getU32("PVNetwork_ObjectDecodeThreads") : 0);
+
+	// Avatar animation evaluation
+	LLVOAvatar::startAnimationThreads(enable_threads ? gSavedSettings.getU32("PVRender_AnimationThreads") : 0);
+
+	// Baked texture compositing on the CPU
+	LLTexLayerSetComposite::startThreads(enable_threads ? gSavedSettings.getU32("PVRender_SoftwareBakeThreads") : 0);
+
 	LLFilePickerThread::initClass();
 
 	// *FIX: no error handling here!
@@ -4473,6 +4508,10 @@ bool LLAppViewer::initCache()
 
 	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion()) ;
 
+	// Generated prim and sculpt faces
+	LLVolumeCache::initClass(gSavedSettings.getBOOL("PVRender_VolumeCache") ? gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "volumes") : std::string(), read_only,
+							 (U64) gSavedSettings.getU32("PVRender_VolumeCacheSize") * MB);
+
 	// Init the VFS
 	vfs_size = llmin(vfs_size + extra, MAX_VFS_SIZE);
 	vfs_size = (vfs_size / MB) * MB; // make sure it is MB aligned
@@ -4641,6 +4680,11 @@ void LLAppViewer::purgeCache()
 		// cef does not support clear_cache and clear_cookies, so clear what we can manually.
 		gDirUtilp->deleteDirAndContents(browser_cache);
 	}
+	std::string volume_cache = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "volumes");
+	if (LLFile::isdir(volume_cache))
+	{
+		gDirUtilp->deleteDirAndContents(volume_cache);
+	}
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, ""), "*");
 }
 
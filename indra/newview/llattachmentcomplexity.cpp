@@ -0,0 +1,88 @@
+/**
+ * @file llattachmentcomplexity.cpp
+ * @brief LLAttachmentComplexity class, the complexity of an avatar's
+ * attachments kept per attached linkset.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llattachmentcomplexity.h"
+
+LLAttachmentComplexity::LLAttachmentComplexity()
+:	mTotal(0),
+	mChanged(false)
+{
+}
+
+void LLAttachmentComplexity::add(LLViewerObject* root)
+{
+	Entry& entry = mEntries[root];
+	mTotal -= entry.mCost;
+	entry = Entry();
+	mStale.insert(root);
+	mChanged = true;
+}
+
+void LLAttachmentComplexity::remove(LLViewerObject* root)
+{
+	entry_map_t::iterator iter = mEntries.find(root);
+	if (iter != mEntries.end())
+	{
+		mTotal -= iter->second.mCost;
+		mEntries.erase(iter);
+	}
+	mStale.erase(root);
+	mChanged = true;
+}
+
+void LLAttachmentComplexity::invalidate(LLViewerObject* root)
+{
+	if (mEntries.find(root) != mEntries.end())
+	{
+		mStale.insert(root);
+		mChanged = true;
+	}
+}
+
+void LLAttachmentComplexity::clear()
+{
+	mEntries.clear();
+	mStale.clear();
+	mTotal = 0;
+	mChanged = true;
+}
+
+void LLAttachmentComplexity::update(const cost_func_t& cost_func)
+{
+	for (std::set<LLViewerObject*>::iterator iter = mStale.begin(); iter != mStale.end(); ++iter)
+	{
+		Entry& entry = mEntries[*iter];
+		mTotal -= entry.mCost;
+		entry = Entry();
+		cost_func(*iter, entry);
+		mTotal += entry.mCost;
+	}
+	mStale.clear();
+	mChanged = false;
+}
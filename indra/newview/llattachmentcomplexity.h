@@ -0,0 +1,86 @@
+/**
+ * @file llattachmentcomplexity.h
+ * @brief LLAttachmentComplexity class, the complexity of an avatar's
+ * attachments kept per attached linkset.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLATTACHMENTCOMPLEXITY_H
+#define LL_LLATTACHMENTCOMPLEXITY_H
+
+#include <map>
+#include <set>
+
+#include <boost/function.hpp>
+
+#include "llavatarrendernotifier.h"
+
+class LLViewerObject;
+
+// What each attached linkset adds to an avatar's complexity, kept by the
+// linkset's root so that a change to one linkset only costs that one
+// again.  The costing itself is the avatar's, handed to update().
+class LLAttachmentComplexity
+{
+public:
+	struct Entry
+	{
+		Entry() : mCost(0), mHasHUD(false) {}
+
+		U32				mCost;		// counted in getTotal()
+		bool			mHasHUD;	// your own HUD attachments
+		LLHUDComplexity	mHUD;
+	};
+	typedef std::map<LLViewerObject*, Entry> entry_map_t;
+
+	// fills in a fresh entry for the linkset under root
+	typedef boost::function<void (LLViewerObject* root, Entry& entry)> cost_func_t;
+
+	LLAttachmentComplexity();
+
+	// a linkset attached, costed on the next update()
+	void	add(LLViewerObject* root);
+	// a linkset detached, its cost leaves the total right away
+	void	remove(LLViewerObject* root);
+	// something in the linkset under root changed, ignored for a root
+	// that isn't attached
+	void	invalidate(LLViewerObject* root);
+	// forgets every linkset, add() the attached ones again
+	void	clear();
+
+	// whether the total may have changed since the last update()
+	bool	needsUpdate() const					{ return mChanged; }
+	// costs the linksets added or invalidated since the last one
+	void	update(const cost_func_t& cost_func);
+
+	U32		getTotal() const					{ return mTotal; }
+	const entry_map_t& getEntries() const		{ return mEntries; }
+
+private:
+	entry_map_t					mEntries;
+	std::set<LLViewerObject*>	mStale;
+	U32							mTotal;
+	bool						mChanged;
+};
+
+#endif // LL_LLATTACHMENTCOMPLEXITY_H
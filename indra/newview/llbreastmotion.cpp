@@ -61,7 +61,9 @@ static const std::string breast_param_names_driven[N_PARAMS] =
 
 LLBreastMotion::LLBreastMotion(const LLUUID &id) : 
 	LLMotion(id),
-	mCharacter(NULL)
+	mCharacter(NULL),
+	mAvatarPhysics(NULL),
+	mAvatarPhysicsTest(NULL)
 {
 	mName = "breast_motion";
 	mChestState = new LLJointState;
@@ -89,6 +91,8 @@ LLBreastMotion::LLBreastMotion(const LLUUID &id) :
 
 LLBreastMotion::~LLBreastMotion()
 {
+	delete mAvatarPhysics;
+	delete mAvatarPhysicsTest;
 }
 
 BOOL LLBreastMotion::onActivate() 
@@ -104,6 +108,12 @@ LLMotion::LLMotionInitStatus LLBreastMotion::onInitialize(LLCharacter *character
 {
 	mCharacter = character;
 
+	if (!mAvatarPhysics)
+	{
+		mAvatarPhysics = new LLCachedControl<bool>(gSavedSettings, "AvatarPhysics");
+		mAvatarPhysicsTest = new LLCachedControl<bool>(gSavedSettings, "AvatarPhysicsTest");
+	}
+
 	if (!mChestState->setJoint(character->getJoint("mChest")))
 	{
 		return STATUS_FAILURE;
@@ -198,8 +208,7 @@ LLVector3 LLBreastMotion::calculateAcceleration_local(const LLVector3 &new_char_
 BOOL LLBreastMotion::onUpdate(F32 time, U8* joint_mask)
 {
 	// Skip if disabled globally.
-	static LLCachedControl<bool> avatar_physics(gSavedSettings, "AvatarPhysics");
-	if (!avatar_physics)
+	if (!*mAvatarPhysics)
 	{
 		return TRUE;
 	}
@@ -321,8 +330,7 @@ BOOL LLBreastMotion::onUpdate(F32 time, U8* joint_mask)
 	mBreastVelocity_local_vec.clamp(-mBreastMaxVelocityParam*100.0, mBreastMaxVelocityParam*100.0);
 
 	// Temporary debugging setting to cause all avatars to move, for profiling purposes.
-	static LLCachedControl<bool> avatar_physics_test(gSavedSettings, "AvatarPhysicsTest");
-	if (avatar_physics_test)
+	if (*mAvatarPhysicsTest)
 	{
 		mBreastVelocity_local_vec[0] = sin(mTimer.getElapsedTimeF32()*4.0)*5.0;
 		mBreastVelocity_local_vec[1] = sin(mTimer.getElapsedTimeF32()*3.0)*5.0;
@@ -33,6 +33,8 @@
 #include "llmotion.h"
 #include "llframetimer.h"
 
+template <class T> class LLCachedControl;
+
 #define BREAST_MOTION_FADEIN_TIME 1.0f
 #define BREAST_MOTION_FADEOUT_TIME 1.0f
 
@@ -100,6 +102,8 @@ public:
 	// must return FALSE when the motion is completed.
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
 
+	virtual BOOL canUpdateOffThread() { return TRUE; }
+
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
@@ -148,6 +152,11 @@ private:
 	F32             mLastTime;
 	
 	U32            mFileTicks;
+
+	// made on the main thread in onInitialize(), onUpdate() runs on the
+	// motion threads
+	LLCachedControl<bool>*	mAvatarPhysics;
+	LLCachedControl<bool>*	mAvatarPhysicsTest;
 };
 
 #endif // LL_LLBREASTMOTION_H
@@ -349,7 +349,7 @@ void LLFace::dirtyTexture()
 					LLVOAvatar* avatar = vobj->getAvatar();
 					if (avatar)
 					{ //avatar render cost may have changed
-						avatar->updateVisualComplexity();
+						avatar->updateAttachmentComplexity(vobj);
 					}
 				}
 				gPipeline.markRebuild(drawablep, LLDrawable::REBUILD_VOLUME, FALSE);
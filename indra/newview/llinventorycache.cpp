@@ -0,0 +1,463 @@
+/**
+ * @file llinventorycache.cpp
+ * @brief LLInventoryCache class, the binary inventory cache file.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include <algorithm>
+
+#include "llfile.h"
+
+static const char * const LOG_INV("Inventory");
+
+namespace
+{
+	const U32 CACHE_MAGIC = 0x43494c4c; // "LLIC"
+
+	struct FileHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mCategoryCount;
+		U32 mItemCount;
+		U32 mStringsSize;
+		U32 mPad[3];
+	};
+
+	typedef std::pair<S32, const LLInventoryItem*> indexed_item_t;
+	typedef LLInventoryCache::category_list_t::value_type category_t;
+
+	bool category_id_less(const category_t& a, const category_t& b)
+	{
+		return a.first < b.first;
+	}
+
+	bool category_less_than_id(const category_t& category, const LLUUID& id)
+	{
+		return category.first < id;
+	}
+
+	bool item_category_less(const indexed_item_t& a, const indexed_item_t& b)
+	{
+		return a.first < b.first;
+	}
+
+	// names and descriptions, each stored once
+	class StringTable
+	{
+	public:
+		StringTable()
+		:	mData(1, '\0')
+		{
+		}
+
+		U32 add(const std::string& str)
+		{
+			if (str.empty())
+			{
+				return 0;
+			}
+			std::pair<std::map<std::string, U32>::iterator, bool> result =
+				mOffsets.insert(std::make_pair(str, (U32) mData.size()));
+			if (result.second)
+			{
+				mData.insert(mData.end(), str.begin(), str.end());
+				mData.push_back('\0');
+			}
+			return result.first->second;
+		}
+
+		const std::vector<char>& getData() const { return mData; }
+
+	private:
+		std::map<std::string, U32> mOffsets;
+		std::vector<char> mData;
+	};
+}
+
+struct LLInventoryCache::CategoryRecord
+{
+	enum
+	{
+		FLAG_HAS_LINKS = 1 << 0
+	};
+
+	LLUUID	mID;
+	S32		mVersion;
+	U32		mFirstItem;
+	U32		mItemCount;
+	U32		mFlags;
+};
+
+struct LLInventoryCache::ItemRecord
+{
+	LLUUID	mID;
+	LLUUID	mAssetID;
+	LLUUID	mCreator;
+	LLUUID	mOwner;
+	LLUUID	mLastOwner;
+	LLUUID	mGroup;
+	U32		mMaskBase;
+	U32		mMaskOwner;
+	U32		mMaskGroup;
+	U32		mMaskEveryone;
+	U32		mMaskNext;
+	U32		mFlags;
+	S32		mSalePrice;
+	S32		mCreationDate;
+	U32		mName;
+	U32		mDescription;
+	S8		mType;
+	S8		mInventoryType;
+	U8		mSaleType;
+	U8		mGroupOwned;
+};
+
+struct LLInventoryCache::ItemIndexRecord
+{
+	LLUUID	mID;
+	U32		mCategory;
+	U32		mPad;
+
+	bool operator<(const ItemIndexRecord& other) const { return mID < other.mID; }
+};
+
+LLInventoryCache::LLInventoryCache()
+:	mCategories(NULL),
+	mItems(NULL),
+	mItemIndex(NULL),
+	mStrings(NULL),
+	mCategoryCount(0),
+	mItemCount(0),
+	mStringsSize(0)
+{
+}
+
+bool LLInventoryCache::open(const std::string& filename, S32 version, bool& is_obsolete)
+{
+	is_obsolete = false;
+	if (!mFile.open(filename))
+	{
+		LL_INFOS(LOG_INV) << "unable to load inventory from: " << filename << LL_ENDL;
+		return false;
+	}
+
+	const FileHeader* header = (const FileHeader*) mFile.data();
+	if (mFile.size() < sizeof(FileHeader) || header->mMagic != CACHE_MAGIC)
+	{
+		LL_WARNS(LOG_INV) << "Not an inventory cache: " << filename << LL_ENDL;
+		is_obsolete = true;
+		mFile.close();
+		return false;
+	}
+	if (header->mVersion != (U32) version)
+	{
+		is_obsolete = true;
+		mFile.close();
+		return false;
+	}
+
+	const U64 expected_size = sizeof(FileHeader)
+		+ (U64) header->mCategoryCount * sizeof(CategoryRecord)
+		+ (U64) header->mItemCount * (sizeof(ItemRecord) + sizeof(ItemIndexRecord))
+		+ header->mStringsSize;
+	if (expected_size != mFile.size()
+		|| header->mCategoryCount > (U32) S32_MAX
+		|| header->mStringsSize == 0)
+	{
+		LL_WARNS(LOG_INV) << "Truncated inventory cache: " << filename << LL_ENDL;
+		is_obsolete = true;
+		mFile.close();
+		return false;
+	}
+	const U8* categories = mFile.data() + sizeof(FileHeader);
+	const U8* items = categories + (size_t) header->mCategoryCount * sizeof(CategoryRecord);
+	const U8* item_index = items + (size_t) header->mItemCount * sizeof(ItemRecord);
+	const char* strings = (const char*) (item_index + (size_t) header->mItemCount * sizeof(ItemIndexRecord));
+	if (strings[header->mStringsSize - 1] != '\0')
+	{
+		LL_WARNS(LOG_INV) << "Truncated inventory cache: " << filename << LL_ENDL;
+		is_obsolete = true;
+		mFile.close();
+		return false;
+	}
+
+	mCategories = (const CategoryRecord*) categories;
+	mItems = (const ItemRecord*) items;
+	mItemIndex = (const ItemIndexRecord*) item_index;
+	mStrings = strings;
+	mCategoryCount = header->mCategoryCount;
+	mItemCount = header->mItemCount;
+	mStringsSize = header->mStringsSize;
+
+	bool damaged = false;
+	for (S32 i = 0; i < mCategoryCount && !damaged; ++i)
+	{
+		const CategoryRecord& category = mCategories[i];
+		damaged = category.mFirstItem > mItemCount
+			|| category.mItemCount > mItemCount - category.mFirstItem;
+	}
+	for (U32 i = 0; i < mItemCount && !damaged; ++i)
+	{
+		damaged = mItemIndex[i].mCategory >= (U32) mCategoryCount;
+	}
+	if (damaged)
+	{
+		LL_WARNS(LOG_INV) << "Damaged inventory cache: " << filename << LL_ENDL;
+		is_obsolete = true;
+		mCategoryCount = 0;
+		mItemCount = 0;
+		mFile.close();
+		return false;
+	}
+	return true;
+}
+
+S32 LLInventoryCache::findCategory(const LLUUID& id) const
+{
+	S32 low = 0;
+	S32 high = mCategoryCount;
+	while (low < high)
+	{
+		S32 mid = (low + high) / 2;
+		if (mCategories[mid].mID < id)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return (low < mCategoryCount && mCategories[low].mID == id) ? low : -1;
+}
+
+const LLUUID& LLInventoryCache::getCategoryID(S32 index) const
+{
+	llassert(index >= 0 && index < mCategoryCount);
+	return mCategories[index].mID;
+}
+
+S32 LLInventoryCache::getCategoryVersion(S32 index) const
+{
+	llassert(index >= 0 && index < mCategoryCount);
+	return mCategories[index].mVersion;
+}
+
+S32 LLInventoryCache::getItemCount(S32 index) const
+{
+	llassert(index >= 0 && index < mCategoryCount);
+	return mCategories[index].mItemCount;
+}
+
+bool LLInventoryCache::hasLinks(S32 index) const
+{
+	llassert(index >= 0 && index < mCategoryCount);
+	return (mCategories[index].mFlags & CategoryRecord::FLAG_HAS_LINKS) != 0;
+}
+
+S32 LLInventoryCache::findItemCategory(const LLUUID& item_id) const
+{
+	ItemIndexRecord key;
+	key.mID = item_id;
+	const ItemIndexRecord* end = mItemIndex + mItemCount;
+	const ItemIndexRecord* found = std::lower_bound(mItemIndex, end, key);
+	return (found != end && found->mID == item_id) ? (S32) found->mCategory : -1;
+}
+
+void LLInventoryCache::getItems(S32 index, item_data_list_t& items) const
+{
+	llassert(index >= 0 && index < mCategoryCount);
+	const CategoryRecord& category = mCategories[index];
+	items.reserve(items.size() + category.mItemCount);
+	for (U32 i = 0; i < category.mItemCount; ++i)
+	{
+		const ItemRecord& record = mItems[category.mFirstItem + i];
+		if (record.mID.isNull())
+		{
+			continue;
+		}
+
+		items.push_back(ItemData());
+		ItemData& item = items.back();
+		item.mID = record.mID;
+		item.mParentID = category.mID;
+		item.mAssetID = record.mAssetID;
+		item.mPermissions.init(record.mCreator, record.mOwner, record.mLastOwner, record.mGroup);
+		item.mPermissions.initMasks(record.mMaskBase, record.mMaskOwner, record.mMaskEveryone,
+									record.mMaskGroup, record.mMaskNext);
+		item.mPermissions.yesReallySetOwner(record.mOwner, record.mGroupOwned != 0);
+		item.mType = (LLAssetType::EType) record.mType;
+		item.mInventoryType = (LLInventoryType::EType) record.mInventoryType;
+		item.mName = getString(record.mName);
+		item.mDescription = getString(record.mDescription);
+		item.mSaleInfo = LLSaleInfo((LLSaleInfo::EForSale) record.mSaleType, record.mSalePrice);
+		item.mFlags = record.mFlags;
+		item.mCreationDate = record.mCreationDate;
+	}
+}
+
+const char* LLInventoryCache::getString(U32 offset) const
+{
+	return offset < mStringsSize ? mStrings + offset : "";
+}
+
+// static
+bool LLInventoryCache::save(const std::string& filename, S32 version,
+							const category_list_t& categories,
+							const item_list_t& items)
+{
+	category_list_t cached_categories(categories);
+	std::sort(cached_categories.begin(), cached_categories.end(), category_id_less);
+
+	// items by the index of their folder, dropping the ones in folders
+	// that won't be used anyway
+	std::vector<indexed_item_t> cached_items;
+	cached_items.reserve(items.size());
+	for (item_list_t::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		if ((*it)->getUUID().isNull())
+		{
+			continue;
+		}
+		const LLUUID& parent_id = (*it)->getParentUUID();
+		category_list_t::const_iterator cat_it =
+			std::lower_bound(cached_categories.begin(), cached_categories.end(), parent_id, category_less_than_id);
+		if (cat_it != cached_categories.end() && cat_it->first == parent_id)
+		{
+			cached_items.push_back(std::make_pair((S32) (cat_it - cached_categories.begin()), *it));
+		}
+	}
+	std::stable_sort(cached_items.begin(), cached_items.end(), item_category_less);
+
+	std::vector<CategoryRecord> category_records(cached_categories.size());
+	for (U32 i = 0; i < cached_categories.size(); ++i)
+	{
+		category_records[i].mID = cached_categories[i].first;
+		category_records[i].mVersion = cached_categories[i].second;
+		category_records[i].mFirstItem = 0;
+		category_records[i].mItemCount = 0;
+		category_records[i].mFlags = 0;
+	}
+
+	StringTable strings;
+	std::vector<ItemRecord> item_records(cached_items.size());
+	std::vector<ItemIndexRecord> index_records(cached_items.size());
+	for (U32 i = 0; i < cached_items.size(); ++i)
+	{
+		CategoryRecord& category = category_records[cached_items[i].first];
+		if (!category.mItemCount)
+		{
+			category.mFirstItem = i;
+		}
+		category.mItemCount++;
+
+		// what the item itself holds, not what links point at
+		const LLInventoryItem* item = cached_items[i].second;
+		if (item->LLInventoryItem::getIsLinkType())
+		{
+			category.mFlags |= CategoryRecord::FLAG_HAS_LINKS;
+		}
+		const LLPermissions& perm = item->LLInventoryItem::getPermissions();
+		const LLSaleInfo& sale_info = item->LLInventoryItem::getSaleInfo();
+		ItemRecord& record = item_records[i];
+		record.mID = item->getUUID();
+		record.mAssetID = item->LLInventoryItem::getAssetUUID();
+		record.mCreator = perm.getCreator();
+		record.mOwner = perm.getOwner();
+		record.mLastOwner = perm.getLastOwner();
+		record.mGroup = perm.getGroup();
+		record.mMaskBase = perm.getMaskBase();
+		record.mMaskOwner = perm.getMaskOwner();
+		record.mMaskGroup = perm.getMaskGroup();
+		record.mMaskEveryone = perm.getMaskEveryone();
+		record.mMaskNext = perm.getMaskNextOwner();
+		record.mFlags = item->LLInventoryItem::getFlags();
+		record.mSalePrice = sale_info.getSalePrice();
+		record.mCreationDate = (S32) item->LLInventoryItem::getCreationDate();
+		record.mName = strings.add(item->LLInventoryItem::getName());
+		record.mDescription = strings.add(item->LLInventoryItem::getDescription());
+		record.mType = (S8) item->LLInventoryItem::getType();
+		record.mInventoryType = (S8) item->LLInventoryItem::getInventoryType();
+		record.mSaleType = (U8) sale_info.getSaleType();
+		record.mGroupOwned = perm.isGroupOwned() ? 1 : 0;
+
+		index_records[i].mID = record.mID;
+		index_records[i].mCategory = cached_items[i].first;
+		index_records[i].mPad = 0;
+	}
+	std::sort(index_records.begin(), index_records.end());
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mMagic = CACHE_MAGIC;
+	header.mVersion = version;
+	header.mCategoryCount = category_records.size();
+	header.mItemCount = item_records.size();
+	header.mStringsSize = strings.getData().size();
+
+	// write under another name so a failed save leaves no partial cache
+	std::string temp_name = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(temp_name, "wb");
+	if (!fp)
+	{
+		LL_WARNS(LOG_INV) << "unable to save inventory to: " << filename << LL_ENDL;
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (written && !category_records.empty())
+	{
+		written = fwrite(&category_records[0], sizeof(CategoryRecord), category_records.size(), fp) == category_records.size();
+	}
+	if (written && !item_records.empty())
+	{
+		written = fwrite(&item_records[0], sizeof(ItemRecord), item_records.size(), fp) == item_records.size()
+			&& fwrite(&index_records[0], sizeof(ItemIndexRecord), index_records.size(), fp) == index_records.size();
+	}
+	if (written)
+	{
+		written = fwrite(&strings.getData()[0], 1, strings.getData().size(), fp) == strings.getData().size();
+	}
+	LLFile::close(fp);
+
+	if (written)
+	{
+		if (LLFile::isfile(filename))
+		{
+			LLFile::remove(filename);
+		}
+		if (LLFile::rename(temp_name, filename) == 0)
+		{
+			LL_INFOS(LOG_INV) << "Saved " << category_records.size() << " categories and "
+							  << item_records.size() << " items to " << filename << LL_ENDL;
+			return true;
+		}
+	}
+	LL_WARNS(LOG_INV) << "unable to save inventory to: " << filename << LL_ENDL;
+	LLFile::remove(temp_name);
+	return false;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file llinventorycache.h
+ * @brief LLInventoryCache class, the binary inventory cache file.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include <vector>
+
+#include "llinventory.h"
+#include "llmappedfile.h"
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// LLInventoryCache
+//
+// The agent's inventory as it was at logout, for the folders whose version
+// the next login's skeleton still matches.  The file is a header, a
+// category index sorted by folder id, fixed size item records grouped by
+// folder, an index of the items sorted by id and a table of the names and
+// descriptions they refer to.  It is mapped rather than read and stays
+// mapped while folders are still unbuilt, so items are only built for the
+// folders asked for, the first time they are.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLInventoryCache
+{
+public:
+	// What an item is built from.  The strings point into the mapped file.
+	struct ItemData
+	{
+		LLUUID					mID;
+		LLUUID					mParentID;
+		LLUUID					mAssetID;
+		LLPermissions			mPermissions;
+		LLAssetType::EType		mType;
+		LLInventoryType::EType	mInventoryType;
+		const char*				mName;
+		const char*				mDescription;
+		LLSaleInfo				mSaleInfo;
+		U32						mFlags;
+		S32						mCreationDate;
+	};
+	typedef std::vector<ItemData> item_data_list_t;
+
+	// folder id and version
+	typedef std::vector<std::pair<LLUUID, S32> > category_list_t;
+	typedef std::vector<const LLInventoryItem*> item_list_t;
+
+	LLInventoryCache();
+
+	// False if there is no usable cache in filename.  is_obsolete is set
+	// if there is one, but for another version.
+	bool open(const std::string& filename, S32 version, bool& is_obsolete);
+
+	S32 getCategoryCount() const				{ return mCategoryCount; }
+	// the index of the cached folder, -1 if it isn't cached
+	S32 findCategory(const LLUUID& id) const;
+	const LLUUID& getCategoryID(S32 index) const;
+	S32 getCategoryVersion(S32 index) const;
+	S32 getItemCount(S32 index) const;
+	// true if any of the folder's items is a link
+	bool hasLinks(S32 index) const;
+	// the index of the cached folder the item is in, -1 if it isn't cached
+	S32 findItemCategory(const LLUUID& item_id) const;
+	// Adds the folder's items to items.
+	void getItems(S32 index, item_data_list_t& items) const;
+
+	// Saves the categories and the items in them, other items are dropped.
+	static bool save(const std::string& filename, S32 version,
+					 const category_list_t& categories,
+					 const item_list_t& items);
+
+private:
+	struct CategoryRecord;
+	struct ItemRecord;
+	struct ItemIndexRecord;
+
+	const char* getString(U32 offset) const;
+
+	LLMappedFile			mFile;
+	const CategoryRecord*	mCategories;
+	const ItemRecord*		mItems;
+	const ItemIndexRecord*	mItemIndex;
+	const char*				mStrings;
+	S32						mCategoryCount;
+	U32						mItemCount;
+	U32						mStringsSize;
+};
+
+#endif // LL_LLINVENTORYCACHE_H
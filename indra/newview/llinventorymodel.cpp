@@ -37,6 +37,7 @@
 #include "llclipboard.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventoryobserver.h"
 #include "llinventorypanel.h"
@@ -52,6 +53,7 @@
 #include "llappviewer.h"
 #include "llviewerregion.h"
 #include "llcallbacklist.h"
+#include "llfanout.h"
 #include "llvoavatarself.h"
 #include "llgesturemgr.h"
 #include "llsdutil.h"
@@ -70,7 +72,8 @@
 
 // Increment this if the inventory contents change in a non-backwards-compatible way.
 // For viewer 2, the addition of link items makes a pre-viewer-2 cache incorrect.
-const S32 LLInventoryModel::sCurrentInvCacheVersion = 2;
+// Version 3 is the binary LLInventoryCache file, version 4 added its item index.
+const S32 LLInventoryModel::sCurrentInvCacheVersion = 4;
 BOOL LLInventoryModel::sFirstTimeInViewer2 = TRUE;
 
 ///----------------------------------------------------------------------------
@@ -80,8 +83,17 @@ BOOL LLInventoryModel::sFirstTimeInViewer2 = TRUE;
 //BOOL decompress_file(const char* src_filename, const char* dst_filename);
 static const char PRODUCTION_CACHE_FORMAT_STRING[] = "%s.inv";
 static const char GRID_CACHE_FORMAT_STRING[] = "%s.%s.inv";
+// binary caches go next to where the gzipped text ones were
+static const char BINARY_CACHE_SUFFIX[] = ".bin";
 static const char * const LOG_INV("Inventory");
 
+// without adding an entry for every id ever checked
+static bool is_locked(const LLUUIDHashMap<bool>& locks, const LLUUID& id)
+{
+	LLUUIDHashMap<bool>::const_iterator it = locks.find(id);
+	return it != locks.end() && it->second;
+}
+
 struct InventoryIDPtrLess
 {
 	bool operator()(const LLViewerInventoryCategory* i1, const LLViewerInventoryCategory* i2) const
@@ -319,6 +331,10 @@ LLViewerInventoryItem* LLInventoryModel::getItem(const LLUUID& id) const
 	else
 	{
 		item_map_t::const_iterator iter = mItemMap.find(id);
+		if (iter == mItemMap.end() && !mCachedFolders.empty() && buildCachedItemFolder(id))
+		{
+			iter = mItemMap.find(id);
+		}
 		if (iter != mItemMap.end())
 		{
 			item = iter->second;
@@ -359,6 +375,7 @@ void LLInventoryModel::getDirectDescendentsOf(const LLUUID& cat_id,
 											  cat_array_t*& categories,
 											  item_array_t*& items) const
 {
+	buildCachedItems(cat_id);
 	categories = get_ptr_in_map(mParentChildCategoryTree, cat_id);
 	items = get_ptr_in_map(mParentChildItemTree, cat_id);
 }
@@ -405,8 +422,8 @@ void LLInventoryModel::lockDirectDescendentArrays(const LLUUID& cat_id,
 
 void LLInventoryModel::unlockDirectDescendentArrays(const LLUUID& cat_id)
 {
-	mCategoryLock[cat_id] = false;
-	mItemLock[cat_id] = false;
+	mCategoryLock.erase(cat_id);
+	mItemLock.erase(cat_id);
 }
 
 void LLInventoryModel::consolidateForType(const LLUUID& main_id, LLFolderType::EType type)
@@ -719,6 +736,8 @@ void LLInventoryModel::collectDescendents(const LLUUID& id,
 	collectDescendentsIf(id, cats, items, include_trash, always);
 }
 
+static LLTrace::BlockTimerStatHandle FTM_COLLECT_DESCENDENTS("Collect Inventory Descendents");
+
 //void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 //											cat_array_t& cats,
 //											item_array_t& items,
@@ -732,13 +751,24 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 											LLInventoryCollectFunctor& add,
 											bool follow_folder_links)
 // [/RLVa:KB]
+{
+	LL_RECORD_BLOCK_TIME(FTM_COLLECT_DESCENDENTS);
+	// Look the trash up once, not in every folder on the way down.
+	const LLUUID excluded_id = include_trash ? LLUUID::null : findCategoryUUIDForType(LLFolderType::FT_TRASH);
+	collectDescendentsExcluding(id, cats, items, excluded_id, add, follow_folder_links);
+}
+
+void LLInventoryModel::collectDescendentsExcluding(const LLUUID& id,
+												   cat_array_t& cats,
+												   item_array_t& items,
+												   const LLUUID& excluded_id,
+												   LLInventoryCollectFunctor& add,
+												   bool follow_folder_links)
 {
 	// Start with categories
-	if(!include_trash)
+	if(excluded_id.notNull() && (excluded_id == id))
 	{
-		const LLUUID trash_id = findCategoryUUIDForType(LLFolderType::FT_TRASH);
-		if(trash_id.notNull() && (trash_id == id))
-			return;
+		return;
 	}
 	cat_array_t* cat_array = get_ptr_in_map(mParentChildCategoryTree, id);
 	if(cat_array)
@@ -752,13 +782,14 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 				cats.push_back(cat);
 			}
 // [RLVa:KB] - Checked: 2013-04-15 (RLVa-1.4.8)
-			collectDescendentsIf(cat->getUUID(), cats, items, include_trash, add, follow_folder_links);
+			collectDescendentsExcluding(cat->getUUID(), cats, items, excluded_id, add, follow_folder_links);
 // [/RLVa:KB]
 //			collectDescendentsIf(cat->getUUID(), cats, items, include_trash, add);
 		}
 	}
 
 	LLViewerInventoryItem* item = NULL;
+	buildCachedItems(id);
 	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
 
 	// Move onto items
@@ -806,7 +837,7 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 						// outfit traversal.
 						cats.push_back(LLPointer<LLViewerInventoryCategory>(linked_cat));
 					}
-					collectDescendentsIf(linked_cat->getUUID(), cats, items, include_trash, add, false);
+					collectDescendentsExcluding(linked_cat->getUUID(), cats, items, excluded_id, add, false);
 				}
 			}
 		}
@@ -1069,17 +1100,18 @@ LLInventoryModel::cat_array_t* LLInventoryModel::getUnlockedCatArray(const LLUUI
 	cat_array_t* cat_array = get_ptr_in_map(mParentChildCategoryTree, id);
 	if (cat_array)
 	{
-		llassert_always(mCategoryLock[id] == false);
+		llassert_always(!is_locked(mCategoryLock, id));
 	}
 	return cat_array;
 }
 
 LLInventoryModel::item_array_t* LLInventoryModel::getUnlockedItemArray(const LLUUID& id)
 {
+	buildCachedItems(id);
 	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
 	if (item_array)
 	{
-		llassert_always(mItemLock[id] == false);
+		llassert_always(!is_locked(mItemLock, id));
 	}
 	return item_array;
 }
@@ -1151,8 +1183,8 @@ void LLInventoryModel::updateCategory(const LLViewerInventoryCategory* cat, U32
 		}
 
 		// make space in the tree for this category's children.
-		llassert_always(mCategoryLock[new_cat->getUUID()] == false);
-		llassert_always(mItemLock[new_cat->getUUID()] == false);
+		llassert_always(!is_locked(mCategoryLock, new_cat->getUUID()));
+		llassert_always(!is_locked(mItemLock, new_cat->getUUID()));
 		cat_array_t* catsp = new cat_array_t;
 		item_array_t* itemsp = new item_array_t;
 		mParentChildCategoryTree[new_cat->getUUID()] = catsp;
@@ -1673,6 +1705,7 @@ bool LLInventoryModel::fetchDescendentsOf(const LLUUID& folder_id) const
 						  << folder_id << LL_ENDL;
 		return false;
 	}
+	buildCachedItems(folder_id);
 	//S32 known_descendents = 0;
 	///cat_array_t* categories = get_ptr_in_map(mParentChildCategoryTree, folder_id);
 	//item_array_t* items = get_ptr_in_map(mParentChildItemTree, folder_id);
@@ -1730,19 +1763,29 @@ void LLInventoryModel::cache(
 		items,
 		INCLUDE_TRASH,
 		can_cache);
-	std::string inventory_filename = getInvCacheAddres(agent_id);
-	saveToFile(inventory_filename, categories, items);
-	std::string gzip_filename(inventory_filename);
-	gzip_filename.append(".gz");
-	if(gzip_file(inventory_filename, gzip_filename))
+
+	// The cache about to be replaced may still be mapped, and nothing
+	// may be left only in there.
+	while (!mCachedFolders.empty())
 	{
-		LL_DEBUGS(LOG_INV) << "Successfully compressed " << inventory_filename << LL_ENDL;
-		LLFile::remove(inventory_filename);
+		CachedFolder folder = mCachedFolders.begin()->second;
+		buildCachedFolder(folder);
 	}
-	else
+	releaseItemCaches();
+
+	LLInventoryCache::category_list_t cached_categories;
+	cached_categories.reserve(categories.size());
+	for (cat_array_t::const_iterator it = categories.begin(); it != categories.end(); ++it)
 	{
-		LL_WARNS(LOG_INV) << "Unable to compress " << inventory_filename << LL_ENDL;
+		if ((*it)->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			cached_categories.push_back(std::make_pair((*it)->getUUID(), (*it)->getVersion()));
+		}
 	}
+	LLInventoryCache::item_list_t cached_items(items.begin(), items.end());
+	std::string inventory_filename = getInvCacheAddres(agent_id);
+	inventory_filename.append(BINARY_CACHE_SUFFIX);
+	LLInventoryCache::save(inventory_filename, sCurrentInvCacheVersion, cached_categories, cached_items);
 }
 
 
@@ -1861,9 +1904,88 @@ void LLInventoryModel::empty()
 	mCategoryMap.clear(); // remove all references (should delete entries)
 	mItemMap.clear(); // remove all references (should delete entries)
 	mLastItem = NULL;
+	releaseItemCaches();
 	//mInventory.clear();
 }
 
+// the item the way it was built from the cache before it was lazy
+static LLViewerInventoryItem* new_cached_item(const LLInventoryCache::ItemData& data)
+{
+	LLViewerInventoryItem* item =
+		new LLViewerInventoryItem(data.mID, data.mParentID, data.mPermissions, data.mAssetID,
+								  data.mType, data.mInventoryType, data.mName, data.mDescription,
+								  data.mSaleInfo, data.mFlags, data.mCreationDate);
+	item->setComplete(FALSE);
+	return item;
+}
+
+void LLInventoryModel::buildCachedItems(const LLUUID& cat_id) const
+{
+	if (mCachedFolders.empty())
+	{
+		return;
+	}
+	cached_folder_map_t::const_iterator it = mCachedFolders.find(cat_id);
+	if (it != mCachedFolders.end())
+	{
+		CachedFolder folder = it->second;
+		const_cast<LLInventoryModel*>(this)->buildCachedFolder(folder);
+	}
+}
+
+bool LLInventoryModel::buildCachedItemFolder(const LLUUID& item_id) const
+{
+	for (std::vector<LLInventoryCache*>::const_iterator it = mItemCaches.begin(); it != mItemCaches.end(); ++it)
+	{
+		S32 index = (*it)->findItemCategory(item_id);
+		if (index < 0)
+		{
+			continue;
+		}
+		cached_folder_map_t::const_iterator folder_it = mCachedFolders.find((*it)->getCategoryID(index));
+		if (folder_it != mCachedFolders.end() && folder_it->second.mCache == *it)
+		{
+			CachedFolder folder = folder_it->second;
+			const_cast<LLInventoryModel*>(this)->buildCachedFolder(folder);
+			return true;
+		}
+	}
+	return false;
+}
+
+void LLInventoryModel::buildCachedFolder(const CachedFolder& folder)
+{
+	// gone before anything below looks the folder up again
+	const LLUUID cat_id = folder.mCache->getCategoryID(folder.mIndex);
+	mCachedFolders.erase(cat_id);
+
+	LLInventoryCache::item_data_list_t cached_items;
+	folder.mCache->getItems(folder.mIndex, cached_items);
+	// Before buildParentChildMap() there are no child arrays yet and it
+	// files the items itself.
+	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, cat_id);
+	for (LLInventoryCache::item_data_list_t::const_iterator it = cached_items.begin(); it != cached_items.end(); ++it)
+	{
+		if (mItemMap.count(it->mID))
+		{
+			continue;
+		}
+		LLPointer<LLViewerInventoryItem> item = new_cached_item(*it);
+		addItem(item);
+		if (item_array && mItemMap.count(it->mID))
+		{
+			item_array->push_back(item);
+		}
+	}
+}
+
+void LLInventoryModel::releaseItemCaches()
+{
+	mCachedFolders.clear();
+	std::for_each(mItemCaches.begin(), mItemCaches.end(), DeletePointer());
+	mItemCaches.clear();
+}
+
 void LLInventoryModel::accountForUpdate(const LLCategoryUpdate& update) const
 {
 	LLViewerInventoryCategory* cat = getCategory(update.mCategoryID);
@@ -2030,7 +2152,6 @@ bool LLInventoryModel::loadSkeleton(
 	if(!temp_cats.empty())
 	{
 		update_map_t child_counts;
-		cat_array_t categories;
 		item_array_t items;
 		item_array_t possible_broken_links;
 		cat_set_t invalid_categories; // Used to mark categories that weren't successfully loaded.
@@ -2038,51 +2159,34 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
-		bool remove_inventory_file = false;
-		if(fp)
+		if (LLFile::isfile(gzip_filename))
 		{
-			fclose(fp);
-			fp = NULL;
-			if(gunzip_file(gzip_filename, inventory_filename))
-			{
-				// we only want to remove the inventory file if it was
-				// gzipped before we loaded, and we successfully
-				// gunziped it.
-				remove_inventory_file = true;
-			}
-			else
-			{
-				LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
-			}
+			// gzipped text caches are not read anymore
+			LL_INFOS(LOG_INV) << "Removing old inventory cache " << gzip_filename << LL_ENDL;
+			LLFile::remove(gzip_filename);
 		}
+		std::string cache_filename(inventory_filename);
+		cache_filename.append(BINARY_CACHE_SUFFIX);
 		bool is_cache_obsolete = false;
-		if(loadFromFile(inventory_filename, categories, items, is_cache_obsolete))
+		LLInventoryCache* inventory_cache = new LLInventoryCache;
+		if(inventory_cache->open(cache_filename, sCurrentInvCacheVersion, is_cache_obsolete))
 		{
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
-			// will go through each category loaded and if the version
-			// does not match, invalidate the version.
-			S32 count = categories.size();
-			cat_set_t::iterator not_cached = temp_cats.end();
+			// will go through each category in the skeleton and if the
+			// cached version does not match, invalidate the version.
 			std::set<LLUUID> cached_ids;
-			for(S32 i = 0; i < count; ++i)
+			std::vector<S32> cached_indices;
+			for(cat_set_t::iterator it = temp_cats.begin(); it != temp_cats.end(); ++it)
 			{
-				LLViewerInventoryCategory* cat = categories[i];
-				cat_set_t::iterator cit = temp_cats.find(cat);
-				if (cit == temp_cats.end())
-				{
-					continue; // cache corruption?? not sure why this happens -SJB
-				}
-				LLViewerInventoryCategory* tcat = *cit;
-				
-				// we can safely ignore anything loaded from file, but
-				// not sent down in the skeleton. Must have been removed from inventory.
-				if (cit == not_cached)
+				LLViewerInventoryCategory* tcat = *it;
+				S32 cache_index = inventory_cache->findCategory(tcat->getUUID());
+				if (cache_index < 0)
 				{
+					// not cached, the version gets stripped below
 					continue;
 				}
-				else if (cat->getVersion() != tcat->getVersion())
+				else if (inventory_cache->getCategoryVersion(cache_index) != tcat->getVersion())
 				{
 					// if the cached version does not match the server version,
 					// throw away the version we have so we can fetch the
@@ -2097,6 +2201,7 @@ bool LLInventoryModel::loadSkeleton(
 				else
 				{
 					cached_ids.insert(tcat->getUUID());
+					cached_indices.push_back(cache_index);
 				}
 			}
 
@@ -2117,6 +2222,37 @@ bool LLInventoryModel::loadSkeleton(
 				++child_counts[(*it)->getParentUUID()];
 			}
 
+			// Only folders with links are built now, their links get checked
+			// against everything else that was cached.  The other current
+			// folders are built when they are first looked at, until then
+			// their record count stands in for their items.
+			for (std::vector<S32>::const_iterator it = cached_indices.begin(); it != cached_indices.end(); ++it)
+			{
+				const LLUUID& cat_id = inventory_cache->getCategoryID(*it);
+				if (inventory_cache->hasLinks(*it))
+				{
+					LLInventoryCache::item_data_list_t cached_items;
+					inventory_cache->getItems(*it, cached_items);
+					for (LLInventoryCache::item_data_list_t::const_iterator item_it = cached_items.begin();
+						 item_it != cached_items.end();
+						 ++item_it)
+					{
+						items.push_back(new_cached_item(*item_it));
+					}
+				}
+				else if (mCategoryMap.count(cat_id))
+				{
+					CachedFolder& folder = mCachedFolders[cat_id];
+					folder.mCache = inventory_cache;
+					folder.mIndex = *it;
+					const S32 item_count = inventory_cache->getItemCount(*it);
+					child_counts[cat_id].mValue += item_count;
+					cached_item_count += item_count;
+				}
+			}
+			// the link checks below can already need it
+			mItemCaches.push_back(inventory_cache);
+
 			// Add all the items loaded which are parented to a
 			// category with a correctly cached parent
 			S32 bad_link_count = 0;
@@ -2201,6 +2337,18 @@ bool LLInventoryModel::loadSkeleton(
 			}
 		}
 
+		// kept mapped while any of its folders wait to be built
+		bool cache_in_use = false;
+		for (cached_folder_map_t::const_iterator it = mCachedFolders.begin(); it != mCachedFolders.end() && !cache_in_use; ++it)
+		{
+			cache_in_use = it->second.mCache == inventory_cache;
+		}
+		if (!cache_in_use)
+		{
+			mItemCaches.erase(std::remove(mItemCaches.begin(), mItemCaches.end(), inventory_cache), mItemCaches.end());
+			delete inventory_cache;
+		}
+
 		// Invalidate all categories that failed fetching descendents for whatever
 		// reason (e.g. one of the descendents was a broken link).
 		for (cat_set_t::iterator invalid_cat_it = invalid_categories.begin();
@@ -2235,18 +2383,12 @@ bool LLInventoryModel::loadSkeleton(
 			}
 		}
 
-		if(remove_inventory_file)
-		{
-			// clean up the gunzipped file.
-			LLFile::remove(inventory_filename);
-		}
 		if(is_cache_obsolete)
 		{
-			// If out of date, remove the gzipped file too.
+			// If out of date, remove the cache file.
 			LL_WARNS(LOG_INV) << "Inv cache out of date, removing" << LL_ENDL;
-			LLFile::remove(gzip_filename);
+			LLFile::remove(cache_filename);
 		}
-		categories.clear(); // will unref and delete entries
 	}
 
 	LL_INFOS(LOG_INV) << "Successfully loaded " << cached_category_count
@@ -2256,12 +2398,61 @@ bool LLInventoryModel::loadSkeleton(
 	return rv;
 }
 
+// below this many objects the workers cost more to wake than they save
+static const U32 MIN_PARALLEL_PARENT_LOOKUPS = 4096;
+// objects looked up per index handed to the workers
+static const U32 PARENT_LOOKUP_SLICE = 2048;
+
+static LLTrace::BlockTimerStatHandle FTM_BUILD_PARENT_CHILD_MAP("Build Inventory Parent/Child Map");
+
+struct LLInventoryModel::ParentArrayLookup
+{
+	const LLInventoryModel* mModel;
+	const cat_array_t* mCats;
+	const item_array_t* mItems;
+	std::vector<cat_array_t*>* mCatParents;
+	std::vector<item_array_t*>* mItemParents;
+};
+
+//static
+void LLInventoryModel::findParentArraySlice(void* context, S32 slice)
+{
+	const ParentArrayLookup* lookup = (const ParentArrayLookup*)context;
+	const U32 begin = slice * PARENT_LOOKUP_SLICE;
+	lookup->mModel->findParentArrays(*lookup->mCats, *lookup->mItems,
+									 *lookup->mCatParents, *lookup->mItemParents,
+									 begin, begin + PARENT_LOOKUP_SLICE);
+}
+
+// Only reads the trees, which nothing changes while the workers run.
+void LLInventoryModel::findParentArrays(const cat_array_t& cats,
+										const item_array_t& items,
+										std::vector<cat_array_t*>& cat_parents,
+										std::vector<item_array_t*>& item_parents,
+										U32 begin,
+										U32 end) const
+{
+	const U32 cat_count = cats.size();
+	end = llmin(end, (U32) (cat_count + items.size()));
+	for (U32 i = begin; i < end && i < cat_count; ++i)
+	{
+		cat_parents[i] = get_ptr_in_map(mParentChildCategoryTree, cats[i]->getParentUUID());
+	}
+	for (U32 i = llmax(begin, cat_count); i < end; ++i)
+	{
+		item_parents[i - cat_count] = get_ptr_in_map(mParentChildItemTree, items[i - cat_count]->getParentUUID());
+	}
+}
+
 // This is a brute force method to rebuild the entire parent-child
-// relations. The overall operation has O(NlogN) performance, which
-// should be sufficient for our needs. 
+// relations. The parents of a big skeleton are looked up on
+// PVInventory_ParentChildMapThreads workers and the main thread, then
+// everything is filed here in the same order as before.
 void LLInventoryModel::buildParentChildMap()
 {
+	LL_RECORD_BLOCK_TIME(FTM_BUILD_PARENT_CHILD_MAP);
 	LL_INFOS(LOG_INV) << "LLInventoryModel::buildParentChildMap()" << LL_ENDL;
+	LLTimer build_timer;
 
 	// *NOTE: I am skipping the logic around folder version
 	// synchronization here because it seems if a folder is lost, we
@@ -2274,20 +2465,23 @@ void LLInventoryModel::buildParentChildMap()
 	cat_array_t cats;
 	cat_array_t* catsp;
 	item_array_t* itemsp;
-	
+
+	cats.reserve(mCategoryMap.size());
+	mParentChildCategoryTree.reserve(mCategoryMap.size() + 1);
+	mParentChildItemTree.reserve(mCategoryMap.size());
 	for(cat_map_t::iterator cit = mCategoryMap.begin(); cit != mCategoryMap.end(); ++cit)
 	{
 		LLViewerInventoryCategory* cat = cit->second;
 		cats.push_back(cat);
 		if (mParentChildCategoryTree.count(cat->getUUID()) == 0)
 		{
-			llassert_always(mCategoryLock[cat->getUUID()] == false);
+			llassert_always(!is_locked(mCategoryLock, cat->getUUID()));
 			catsp = new cat_array_t;
 			mParentChildCategoryTree[cat->getUUID()] = catsp;
 		}
 		if (mParentChildItemTree.count(cat->getUUID()) == 0)
 		{
-			llassert_always(mItemLock[cat->getUUID()] == false);
+			llassert_always(!is_locked(mItemLock, cat->getUUID()));
 			itemsp = new item_array_t;
 			mParentChildItemTree[cat->getUUID()] = itemsp;
 		}
@@ -2303,6 +2497,30 @@ void LLInventoryModel::buildParentChildMap()
 		mParentChildCategoryTree[LLUUID::null] = catsp;
 	}
 
+	// Every array is allocated now, so the parents of the items can be
+	// looked up along with those of the categories. Lost categories get
+	// filed below, which can add Lost And Found, but a new category has
+	// no items yet and the arrays themselves never move.
+	item_array_t items;
+	items.reserve(mItemMap.size());
+	for(item_map_t::iterator iit = mItemMap.begin(); iit != mItemMap.end(); ++iit)
+	{
+		items.push_back(iit->second);
+	}
+
+	std::vector<cat_array_t*> cat_parents(cats.size());
+	std::vector<item_array_t*> item_parents(items.size());
+	const U32 lookup_count = cats.size() + items.size();
+	U32 thread_count = 0;
+	{
+		static LLCachedControl<U32> parent_threads(gSavedSettings, "PVInventory_ParentChildMapThreads", 3);
+		thread_count = (lookup_count >= MIN_PARALLEL_PARENT_LOOKUPS) ? (U32)parent_threads : 0;
+		// only around while the map is built, login doesn't do this often
+		LLFanOut fan_out("Inventory parent lookup", thread_count);
+		ParentArrayLookup lookup = { this, &cats, &items, &cat_parents, &item_parents };
+		fan_out.run((lookup_count + PARENT_LOOKUP_SLICE - 1) / PARENT_LOOKUP_SLICE, findParentArraySlice, &lookup);
+	}
+
 	// Now we have a structure with all of the categories that we can
 	// iterate over and insert into the correct place in the child
 	// category tree. 
@@ -2313,7 +2531,8 @@ void LLInventoryModel::buildParentChildMap()
 	for(i = 0; i < count; ++i)
 	{
 		LLViewerInventoryCategory* cat = cats.at(i);
-		catsp = getUnlockedCatArray(cat->getParentUUID());
+		catsp = cat_parents[i];
+		llassert_always(!catsp || !is_locked(mCategoryLock, cat->getParentUUID()));
 		if(catsp &&
 		   // Only the two root folders should be children of null.
 		   // Others should go to lost & found.
@@ -2381,19 +2600,8 @@ void LLInventoryModel::buildParentChildMap()
 	sFirstTimeInViewer2 = !COF_exists || gAgent.isFirstLogin();
 
 
-	// Now the items. We allocated in the last step, so now all we
-	// have to do is iterate over the items and put them in the right
-	// place.
-	item_array_t items;
-	if(!mItemMap.empty())
-	{
-		LLPointer<LLViewerInventoryItem> item;
-		for(item_map_t::iterator iit = mItemMap.begin(); iit != mItemMap.end(); ++iit)
-		{
-			item = (*iit).second;
-			items.push_back(item);
-		}
-	}
+	// Now the items. Their arrays were looked up with the categories',
+	// so all we have to do is put them in the right place.
 	count = items.size();
 	lost = 0;
 	uuid_vec_t lost_item_ids;
@@ -2401,7 +2609,8 @@ void LLInventoryModel::buildParentChildMap()
 	{
 		LLPointer<LLViewerInventoryItem> item;
 		item = items.at(i);
-		itemsp = getUnlockedItemArray(item->getParentUUID());
+		itemsp = item_parents[i];
+		llassert_always(!itemsp || !is_locked(mItemLock, item->getParentUUID()));
 		if(itemsp)
 		{
 			itemsp->push_back(item);
@@ -2473,6 +2682,9 @@ void LLInventoryModel::buildParentChildMap()
 			
 			std::string name = "My Inventory";
 			LLUUID prev_root_id = mRootFolderID;
+			// The trees aren't in id order, so pick the same one of
+			// several broken roots whatever order they come in.
+			LLUUID found_root_id;
 			for (parent_cat_map_t::const_iterator it = mParentChildCategoryTree.begin(),
 					 it_end = mParentChildCategoryTree.end(); it != it_end; ++it)
 			{
@@ -2486,14 +2698,18 @@ void LLInventoryModel::buildParentChildMap()
 						continue;
 					if ( category && 0 == LLStringUtil::compareInsensitive(name, category->getName()) )
 					{
-						if(category->getUUID()!=mRootFolderID)
+						if (found_root_id.isNull() || found_root_id < category->getUUID())
 						{
-							LLUUID& new_inv_root_folder_id = const_cast<LLUUID&>(mRootFolderID);
-							new_inv_root_folder_id = category->getUUID();
+							found_root_id = category->getUUID();
 						}
 					}
 				}
 			}
+			if (found_root_id.notNull() && found_root_id != mRootFolderID)
+			{
+				LLUUID& new_inv_root_folder_id = const_cast<LLUUID&>(mRootFolderID);
+				new_inv_root_folder_id = found_root_id;
+			}
 
 			// 'My Inventory',
 			// root of the agent's inv found.
@@ -2507,6 +2723,10 @@ void LLInventoryModel::buildParentChildMap()
 		}
 	}
 
+	LL_INFOS(LOG_INV) << "Built the parent/child map of " << cats.size() << " categories and "
+					  << items.size() << " items on " << thread_count + 1 << " threads in "
+					  << build_timer.getElapsedTimeF32() * 1000.f << " ms" << LL_ENDL;
+
 	if (!gInventory.validate())
 	{
 	 	LL_WARNS(LOG_INV) << "model failed validity check!" << LL_ENDL;
@@ -2624,145 +2844,6 @@ bool LLUUIDAndName::operator>(const LLUUIDAndName& rhs) const
 	return (mID > rhs.mID);
 }
 
-// static
-bool LLInventoryModel::loadFromFile(const std::string& filename,
-									LLInventoryModel::cat_array_t& categories,
-									LLInventoryModel::item_array_t& items,
-									bool &is_cache_obsolete)
-{
-	if(filename.empty())
-	{
-		LL_ERRS(LOG_INV) << "Filename is Null!" << LL_ENDL;
-		return false;
-	}
-	LL_INFOS(LOG_INV) << "LLInventoryModel::loadFromFile(" << filename << ")" << LL_ENDL;
-	LLFILE* file = LLFile::fopen(filename, "rb");		/*Flawfinder: ignore*/
-	if(!file)
-	{
-		LL_INFOS(LOG_INV) << "unable to load inventory from: " << filename << LL_ENDL;
-		return false;
-	}
-	// *NOTE: This buffer size is hard coded into scanf() below.
-	char buffer[MAX_STRING];		/*Flawfinder: ignore*/
-	char keyword[MAX_STRING];		/*Flawfinder: ignore*/
-	char value[MAX_STRING];			/*Flawfinder: ignore*/
-	is_cache_obsolete = true;  		// Obsolete until proven current
-	while(!feof(file) && fgets(buffer, MAX_STRING, file)) 
-	{
-		sscanf(buffer, " %126s %126s", keyword, value);	/* Flawfinder: ignore */
-		if(0 == strcmp("inv_cache_version", keyword))
-		{
-			S32 version;
-			int succ = sscanf(value,"%d",&version);
-			if ((1 == succ) && (version == sCurrentInvCacheVersion))
-			{
-				// Cache is up to date
-				is_cache_obsolete = false;
-				continue;
-			}
-			else
-			{
-				// Cache is out of date
-				break;
-			}
-		}
-		else if(0 == strcmp("inv_category", keyword))
-		{
-			if (is_cache_obsolete)
-				break;
-			
-			LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(LLUUID::null);
-			if(inv_cat->importFileLocal(file))
-			{
-				categories.push_back(inv_cat);
-			}
-			else
-			{
-				LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory category: " << inv_cat->getName() << LL_ENDL;
-				//delete inv_cat; // automatic when inv_cat is reassigned or destroyed
-			}
-		}
-		else if(0 == strcmp("inv_item", keyword))
-		{
-			if (is_cache_obsolete)
-				break;
-
-			LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
-			if( inv_item->importFileLocal(file) )
-			{
-				// *FIX: Need a better solution, this prevents the
-				// application from freezing, but breaks inventory
-				// caching.
-				if(inv_item->getUUID().isNull())
-				{
-					//delete inv_item; // automatic when inv_cat is reassigned or destroyed
-					LL_WARNS(LOG_INV) << "Ignoring inventory with null item id: "
-									  << inv_item->getName() << LL_ENDL;
-						
-				}
-				else
-				{
-					items.push_back(inv_item);
-				}
-			}
-			else
-			{
-				LL_WARNS(LOG_INV) << "loadInventoryFromFile().  Ignoring invalid inventory item: " << inv_item->getName() << LL_ENDL;
-				//delete inv_item; // automatic when inv_cat is reassigned or destroyed
-			}
-		}
-		else
-		{
-			LL_WARNS(LOG_INV) << "Unknown token in inventory file '" << keyword << "'"
-							  << LL_ENDL;
-		}
-	}
-	fclose(file);
-	if (is_cache_obsolete)
-		return false;
-	return true;
-}
-
-// static
-bool LLInventoryModel::saveToFile(const std::string& filename,
-								  const cat_array_t& categories,
-								  const item_array_t& items)
-{
-	if(filename.empty())
-	{
-		LL_ERRS(LOG_INV) << "Filename is Null!" << LL_ENDL;
-		return false;
-	}
-	LL_INFOS(LOG_INV) << "LLInventoryModel::saveToFile(" << filename << ")" << LL_ENDL;
-	LLFILE* file = LLFile::fopen(filename, "wb");		/*Flawfinder: ignore*/
-	if(!file)
-	{
-		LL_WARNS(LOG_INV) << "unable to save inventory to: " << filename << LL_ENDL;
-		return false;
-	}
-
-	fprintf(file, "\tinv_cache_version\t%d\n",sCurrentInvCacheVersion);
-	S32 count = categories.size();
-	S32 i;
-	for(i = 0; i < count; ++i)
-	{
-		LLViewerInventoryCategory* cat = categories[i];
-		if(cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
-		{
-			cat->exportFileLocal(file);
-		}
-	}
-
-	count = items.size();
-	for(i = 0; i < count; ++i)
-	{
-		items[i]->exportFile(file);
-	}
-
-	fclose(file);
-	return true;
-}
-
 // message handling functionality
 // static
 void LLInventoryModel::registerCallbacks(LLMessageSystem* msg)
@@ -3665,26 +3746,32 @@ bool LLInventoryModel::validate() const
 						<< getLibraryRootFolderID() << ")" << LL_ENDL;
 			}
 		}
-		cat_array_t* cats;
-		item_array_t* items;
-		getDirectDescendentsOf(cat_id,cats,items);
+		// looked up directly, checking shouldn't build the cached folders
+		cat_array_t* cats = get_ptr_in_map(mParentChildCategoryTree, cat_id);
+		item_array_t* items = get_ptr_in_map(mParentChildItemTree, cat_id);
 		if (!cats || !items)
 		{
 			LL_WARNS() << "invalid direct descendents for " << cat_id << LL_ENDL;
 			valid = false;
 			continue;
 		}
+		S32 unbuilt_count = 0;
+		cached_folder_map_t::const_iterator cached_it = mCachedFolders.find(cat_id);
+		if (cached_it != mCachedFolders.end())
+		{
+			unbuilt_count = cached_it->second.mCache->getItemCount(cached_it->second.mIndex);
+		}
 		if (cat->getDescendentCount() == LLViewerInventoryCategory::DESCENDENT_COUNT_UNKNOWN)
 		{
 			desc_unknown_count++;
 		}
-		else if (cats->size() + items->size() != cat->getDescendentCount())
+		else if (cats->size() + items->size() + unbuilt_count != cat->getDescendentCount())
 		{
 			LL_WARNS() << "invalid desc count for " << cat_id << " name [" << cat->getName()
 					<< "] parent " << cat->getParentUUID()
 					<< " cached " << cat->getDescendentCount()
-					<< " expected " << cats->size() << "+" << items->size()
-					<< "=" << cats->size() +items->size() << LL_ENDL;
+					<< " expected " << cats->size() << "+" << items->size() << "+" << unbuilt_count
+					<< "=" << cats->size() + items->size() + unbuilt_count << LL_ENDL;
 			valid = false;
 		}
 		if (cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
@@ -3765,9 +3852,7 @@ bool LLInventoryModel::validate() const
 		const LLUUID& parent_id = cat->getParentUUID();
 		if (!parent_id.isNull())
 		{
-			cat_array_t* cats;
-			item_array_t* items;
-			getDirectDescendentsOf(parent_id,cats,items);
+			cat_array_t* cats = get_ptr_in_map(mParentChildCategoryTree, parent_id);
 			if (!cats)
 			{
 				LL_WARNS() << "cat " << cat_id << " name [" << cat->getName()
@@ -3812,9 +3897,7 @@ bool LLInventoryModel::validate() const
 		}
 		else
 		{
-			cat_array_t* cats;
-			item_array_t* items;
-			getDirectDescendentsOf(parent_id,cats,items);
+			item_array_t* items = get_ptr_in_map(mParentChildItemTree, parent_id);
 			if (!items)
 			{
 				LL_WARNS() << "item " << item_id << " name [" << item->getName()
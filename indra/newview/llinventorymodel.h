@@ -36,6 +36,7 @@
 #include "llfoldertype.h"
 #include "llframetimer.h"
 #include "lluuid.h"
+#include "lluuidhashmap.h"
 #include "llpermissionsflags.h"
 #include "llviewerinventory.h"
 #include "llstring.h"
@@ -52,6 +53,7 @@ class LLInventoryObserver;
 class LLInventoryObject;
 class LLInventoryItem;
 class LLInventoryCategory;
+class LLInventoryCache;
 class LLMessageSystem;
 class LLInventoryCollectFunctor;
 
@@ -170,21 +172,55 @@ public:
 	// Call on logout to save a terse representation.
 	void cache(const LLUUID& parent_folder_id, const LLUUID& agent_id);
 private:
+	// For buildParentChildMap(), the child arrays of the parents of
+	// cats[begin..end) followed by items, in the same order.
+	struct ParentArrayLookup;
+	static void findParentArraySlice(void* context, S32 slice);
+	void findParentArrays(const cat_array_t& cats,
+						  const item_array_t& items,
+						  std::vector<cat_array_t*>& cat_parents,
+						  std::vector<item_array_t*>& item_parents,
+						  U32 begin,
+						  U32 end) const;
+
 	// Information for tracking the actual inventory. We index this
 	// information in a lot of different ways so we can access
 	// the inventory using several different identifiers.
 	// mInventory member data is the 'master' list of inventory, and
 	// mCategoryMap and mItemMap store uuid->object mappings. 
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryCategory> > cat_map_t;
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryItem> > item_map_t;
+	typedef LLUUIDHashMap<LLPointer<LLViewerInventoryCategory> > cat_map_t;
+	typedef LLUUIDHashMap<LLPointer<LLViewerInventoryItem> > item_map_t;
 	cat_map_t mCategoryMap;
 	item_map_t mItemMap;
 	// This last set of indices is used to map parents to children.
-	typedef std::map<LLUUID, cat_array_t*> parent_cat_map_t;
-	typedef std::map<LLUUID, item_array_t*> parent_item_map_t;
+	// The arrays are allocated once per category and outlive any
+	// rehashing of the maps, so hold on to those rather than iterators.
+	typedef LLUUIDHashMap<cat_array_t*> parent_cat_map_t;
+	typedef LLUUIDHashMap<item_array_t*> parent_item_map_t;
 	parent_cat_map_t mParentChildCategoryTree;
 	parent_item_map_t mParentChildItemTree;
 
+	// Folders loaded from the cache whose items haven't been built yet.
+	// A folder's items are built the first time anything looks at its
+	// contents or at one of them, and the cache files stay mapped until
+	// the logout save.
+	struct CachedFolder
+	{
+		LLInventoryCache*	mCache;
+		S32					mIndex;
+	};
+	typedef LLUUIDHashMap<CachedFolder> cached_folder_map_t;
+	cached_folder_map_t mCachedFolders;
+	std::vector<LLInventoryCache*> mItemCaches;
+	// Builds the folder's cached items if it still has some to build.
+	// Nothing that can be seen from outside changes, so const lookups
+	// do this too.
+	void buildCachedItems(const LLUUID& cat_id) const;
+	// The same for the folder the item is cached in, true if it was built.
+	bool buildCachedItemFolder(const LLUUID& item_id) const;
+	void buildCachedFolder(const CachedFolder& folder);
+	void releaseItemCaches();
+
 	// Track links to items and categories. We do not store item or
 	// category pointers here, because broken links are also supported.
 	typedef std::multimap<LLUUID, LLUUID> backlink_mmap_t;
@@ -275,6 +311,13 @@ public:
 
 private:
 	U32 getDescendentsCountRecursive(const LLUUID& id, U32 max_item_limit);
+	// collectDescendentsIf() below id, skipping the folder excluded_id
+	void collectDescendentsExcluding(const LLUUID& id,
+									 cat_array_t& categories,
+									 item_array_t& items,
+									 const LLUUID& excluded_id,
+									 LLInventoryCollectFunctor& add,
+									 bool follow_folder_links);
 	
 	//--------------------------------------------------------------------
 	// Find
@@ -613,18 +656,6 @@ public:
 	bool callbackEmptyFolderType(const LLSD& notification, const LLSD& response, LLFolderType::EType preferred_type);
 	static void registerCallbacks(LLMessageSystem* msg);
 
-	//--------------------------------------------------------------------
-	// File I/O
-	//--------------------------------------------------------------------
-protected:
-	static bool loadFromFile(const std::string& filename,
-							 cat_array_t& categories,
-							 item_array_t& items,
-							 bool& is_cache_obsolete); 
-	static bool saveToFile(const std::string& filename,
-						   const cat_array_t& categories,
-						   const item_array_t& items); 
-
 	//--------------------------------------------------------------------
 	// Message handling functionality
 	//--------------------------------------------------------------------
@@ -654,8 +685,8 @@ protected:
 	cat_array_t* getUnlockedCatArray(const LLUUID& id);
 	item_array_t* getUnlockedItemArray(const LLUUID& id);
 private:
-	std::map<LLUUID, bool> mCategoryLock;
-	std::map<LLUUID, bool> mItemLock;
+	LLUUIDHashMap<bool> mCategoryLock;
+	LLUUIDHashMap<bool> mItemLock;
 	
 	//--------------------------------------------------------------------
 	// Debugging
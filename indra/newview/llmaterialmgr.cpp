@@ -26,6 +26,7 @@
 
 #include "llviewerprecompiledheaders.h"
 
+#include "llinflateservice.h"
 #include "llsdserialize.h"
 #include "llsdutil.h"
 
@@ -392,6 +393,42 @@ const LLMaterialPtr LLMaterialMgr::setMaterial(const LLUUID& region_id, const LL
 	return itMaterial->second;
 }
 
+// Inflates a get or getAll response for LLMaterialMgr::processInflatedQueue().
+class LLMaterialsInflateJob : public LLInflateService::LLSDJob
+{
+public:
+	LLMaterialsInflateJob(LLMaterialMgr* mgr, bool get_all, const LLUUID& region_id, const LLSD::Binary& content)
+	:	LLInflateService::LLSDJob(content.empty() ? NULL : &content[0], content.size()),
+		mMgr(mgr),
+		mGetAll(get_all),
+		mRegionId(region_id)
+	{
+	}
+
+	/*virtual*/ void finished(bool success)
+	{
+		if (!success)
+		{
+			LL_WARNS("Materials") << "Cannot unzip LLSD binary content" << LL_ENDL;
+			return;
+		}
+
+		LLMutexLock lock(&mMgr->mInflatedMutex);
+		mMgr->mInflatedQueue.push_back(LLMaterialMgr::InflatedResponse());
+		LLMaterialMgr::InflatedResponse& response = mMgr->mInflatedQueue.back();
+		response.mGetAll = mGetAll;
+		response.mRegionId = mRegionId;
+		// dropped under the lock, LLSD reference counts aren't atomic
+		response.mData = mData;
+		mData.clear();
+	}
+
+private:
+	LLMaterialMgr* mMgr;
+	bool mGetAll;
+	LLUUID mRegionId;
+};
+
 void LLMaterialMgr::onGetResponse(bool success, const LLSD& content, const LLUUID& region_id)
 {
 	if (!success)
@@ -405,17 +442,12 @@ void LLMaterialMgr::onGetResponse(bool success, const LLSD& content, const LLUUI
 	llassert(content.has(MATERIALS_CAP_ZIP_FIELD));
 	llassert(content[MATERIALS_CAP_ZIP_FIELD].isBinary());
 
-	LLSD::Binary content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
-	std::string content_string(reinterpret_cast<const char*>(content_binary.data()), content_binary.size());
-	std::istringstream content_stream(content_string);
-
-	LLSD response_data;
-	if (!unzip_llsd(response_data, content_stream, content_binary.size()))
-	{
-		LL_WARNS("Materials") << "Cannot unzip LLSD binary content" << LL_ENDL;
-		return;
-	}
+	const LLSD::Binary& content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
+	gInflateService.post(new LLMaterialsInflateJob(this, false, region_id, content_binary));
+}
 
+void LLMaterialMgr::onGetInflated(const LLSD& response_data, const LLUUID& region_id)
+{
 	llassert(response_data.isArray());
 	LL_DEBUGS("Materials") << "response has "<< response_data.size() << " materials" << LL_ENDL;
 	for (LLSD::array_const_iterator itMaterial = response_data.beginArray(); itMaterial != response_data.endArray(); ++itMaterial)
@@ -447,17 +479,12 @@ void LLMaterialMgr::onGetAllResponse(bool success, const LLSD& content, const LL
 	llassert(content.has(MATERIALS_CAP_ZIP_FIELD));
 	llassert(content[MATERIALS_CAP_ZIP_FIELD].isBinary());
 
-	LLSD::Binary content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
-	std::string content_string(reinterpret_cast<const char*>(content_binary.data()), content_binary.size());
-	std::istringstream content_stream(content_string);
-
-	LLSD response_data;
-	if (!unzip_llsd(response_data, content_stream, content_binary.size()))
-	{
-		LL_WARNS("Materials") << "Cannot unzip LLSD binary content" << LL_ENDL;
-		return;
-	}
+	const LLSD::Binary& content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
+	gInflateService.post(new LLMaterialsInflateJob(this, true, region_id, content_binary));
+}
 
+void LLMaterialMgr::onGetAllInflated(const LLSD& response_data, const LLUUID& region_id)
+{
 	get_queue_t::iterator itQueue = mGetQueue.find(region_id);
 	material_map_t materials;
 
@@ -515,12 +542,10 @@ void LLMaterialMgr::onPutResponse(bool success, const LLSD& content)
 	llassert(content.has(MATERIALS_CAP_ZIP_FIELD));
 	llassert(content[MATERIALS_CAP_ZIP_FIELD].isBinary());
 
-	LLSD::Binary content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
-	std::string content_string(reinterpret_cast<const char*>(content_binary.data()), content_binary.size());
-	std::istringstream content_stream(content_string);
+	const LLSD::Binary& content_binary = content[MATERIALS_CAP_ZIP_FIELD].asBinary();
 
 	LLSD response_data;
-	if (!unzip_llsd(response_data, content_stream, content_binary.size()))
+	if (!unzip_llsd(response_data, content_binary.data(), content_binary.size()))
 	{
 		LL_WARNS("Materials") << "Cannot unzip LLSD binary content" << LL_ENDL;
 		return;
@@ -579,6 +604,29 @@ void LLMaterialMgr::onIdle(void*)
 	}
 
 	instancep->mHttpRequest->update(0L);
+
+	instancep->processInflatedQueue();
+}
+
+void LLMaterialMgr::processInflatedQueue()
+{
+	std::list<InflatedResponse> responses;
+	{
+		LLMutexLock lock(&mInflatedMutex);
+		responses.swap(mInflatedQueue);
+	}
+
+	for (std::list<InflatedResponse>::const_iterator it = responses.begin(); it != responses.end(); ++it)
+	{
+		if (it->mGetAll)
+		{
+			onGetAllInflated(it->mData, it->mRegionId);
+		}
+		else
+		{
+			onGetInflated(it->mData, it->mRegionId);
+		}
+	}
 }
 
 /*static*/
@@ -29,6 +29,7 @@
 
 #include "llmaterial.h"
 #include "llmaterialid.h"
+#include "llmutex.h"
 #include "llsingleton.h"
 #include "httprequest.h"
 #include "httpheaders.h"
@@ -73,9 +74,12 @@ private:
 	void processGetQueue();
     void processGetQueueCoro();
 	void onGetResponse(bool success, const LLSD& content, const LLUUID& region_id);
+	void onGetInflated(const LLSD& response_data, const LLUUID& region_id);
 	void processGetAllQueue();
     void processGetAllQueueCoro(LLUUID regionId);
 	void onGetAllResponse(bool success, const LLSD& content, const LLUUID& region_id);
+	void onGetAllInflated(const LLSD& response_data, const LLUUID& region_id);
+	void processInflatedQueue();
 	void processPutQueue();
 	void onPutResponse(bool success, const LLSD& content);
 	void onRegionRemoved(LLViewerRegion* regionp);
@@ -135,6 +139,17 @@ private:
 	put_queue_t				mPutQueue;
 	material_map_t			mMaterials;
 
+	// get and getAll responses inflated by gInflateService, handled in onIdle()
+	friend class LLMaterialsInflateJob;
+	struct InflatedResponse
+	{
+		bool	mGetAll;
+		LLUUID	mRegionId;
+		LLSD	mData;
+	};
+	LLMutex							mInflatedMutex;
+	std::list<InflatedResponse>		mInflatedQueue;
+
 	LLCore::HttpRequest::ptr_t		mHttpRequest;
 	LLCore::HttpHeaders::ptr_t		mHttpHeaders;
 	LLCore::HttpOptions::ptr_t		mHttpOptions;
@@ -40,6 +40,7 @@
 #include "lleconomy.h"
 #include "llimagej2c.h"
 #include "llhost.h"
+#include "llinflateservice.h"
 #include "llmath.h"
 #include "llnotificationsutil.h"
 #include "llsd.h"
@@ -107,6 +108,8 @@
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
 //   decom    Worker thread for mesh decomposition requests
 //   core     HTTP worker thread:  does the work but doesn't intrude here
+//   inflate  gInflateService workers, inflate and unpack LOD blocks
+//            (the repo thread does it itself without them)
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
 //
 // Sequence of Operations
@@ -145,9 +148,14 @@
 //                             ...
 //                             onCompleted() invoked for GET
 //                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               LLMeshLODJob posted
+//                             ...
+//                                                 inflate thread
+//                                                 LLMeshLODJob inflated
+//                                                   lodInflated() invoked
+//                                                     unpack data into LLVolume
+//                                                     append LoadedMesh to mLoadedQ
+//                                                   data written to VFS
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -251,8 +259,8 @@
 //     mDecompositionQ          mMutex        rw.repo.mMutex, rw.main.mMutex [5] (was:  [0])
 //     mHeaderReqQ              mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mLODReqQ                 mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
-//     mUnavailableQ            mMutex        rw.repo.none [0], ro.main.none [5], rw.main.mMutex
-//     mLoadedQ                 mMutex        rw.repo.mMutex, ro.main.none [5], rw.main.mMutex
+//     mUnavailableQ            mMutex        rw.repo.none [0], wo.inflate.mMutex, ro.main.none [5], rw.main.mMutex
+//     mLoadedQ                 mMutex        rw.repo.mMutex, wo.inflate.mMutex, ro.main.none [5], rw.main.mMutex
 //     mPendingLOD              mMutex        rw.repo.mMutex, rw.any.mMutex
 //     mGetMeshCapability       mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMesh2Capability      mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
@@ -642,6 +650,42 @@ public:
 };
 
 
+// Inflates and unpacks a LOD block, from the cache or the sim.
+//
+// Thread:  inflate, or whichever thread posts it without inflate threads
+class LLMeshLODJob : public LLInflateService::Job
+{
+public:
+	LLMeshLODJob(const LLVolumeParams& mesh_params, S32 lod, const U8* data, S32 data_size)
+	:	LLInflateService::Job(data, data_size),
+		mMeshParams(mesh_params),
+		mLOD(lod),
+		mFromCache(true),
+		mOffset(0)
+	{
+	}
+
+	// fetched blocks are written to the cache once they unpack
+	LLMeshLODJob(const LLVolumeParams& mesh_params, S32 lod, const U8* data, S32 data_size, S32 offset)
+	:	LLInflateService::Job(data, data_size),
+		mMeshParams(mesh_params),
+		mLOD(lod),
+		mFromCache(false),
+		mOffset(offset)
+	{
+	}
+
+	/*virtual*/ bool inflated(U8* data, size_t size);
+	/*virtual*/ void finished(bool success);
+
+private:
+	LLVolumeParams mMeshParams;
+	S32 mLOD;
+	bool mFromCache;
+	S32 mOffset;
+};
+
+
 // Subclass for skin info fetches.
 //
 // Thread:  repo
@@ -904,7 +948,7 @@ void LLMeshRepoThread::run()
 			LLMeshRepository::sLODProcessing--;
 			mMutex->unlock();
 
-			if (!fetchMeshLOD(req.mMeshParams, req.mLOD))		// failed, resubmit
+			if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.mSkipCache))		// failed, resubmit
 			{
 				mMutex->lock();
 				mLODReqQ.push(req); 
@@ -1589,7 +1633,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 }
 
 //return false if failed to get mesh lod.
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool skip_cache)
 {
 	if (!mHeaderMutex)
 	{
@@ -1617,7 +1661,7 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 
 			//check VFS for mesh asset
 			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			if (!skip_cache && file.getSize() >= offset+size)
 			{
 				LLMeshRepository::sCacheBytesRead += size;
 				++LLMeshRepository::sCacheReads;
@@ -1633,12 +1677,10 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //attempt to parse, comes back as a skip_cache request if it doesn't
+					gInflateService.post(new LLMeshLODJob(mesh_params, lod, buffer, size));
+					delete[] buffer;
+					return true;
 				}
 
 				delete[] buffer;
@@ -1694,27 +1736,24 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 	U32 header_size = 0;
 	if (data_size > 0)
 	{
-		std::string res_str((char*) data, data_size);
-
 		std::string deprecated_header("<? LLSD/Binary ?>");
 
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
+		if (data_size > (S32) deprecated_header.size()
+			&& !memcmp(data, deprecated_header.data(), deprecated_header.size()))
 		{
-			res_str = res_str.substr(deprecated_header.size()+1, data_size);
 			header_size = deprecated_header.size()+1;
 		}
-		data_size = res_str.size();
-
-		std::istringstream stream(res_str);
 
-		if (!LLSDSerialize::fromBinary(header, stream, data_size))
+		// parsed in place, the rest of the asset is the LODs
+		size_t used = 0;
+		if (LLSDSerialize::fromBinary(header, data + header_size, data_size - header_size, &used) <= 0)
 		{
 			LL_WARNS(LOG_MESH) << "Mesh header parse error.  Not a valid mesh asset!  ID:  " << mesh_id
 							   << LL_ENDL;
 			return false;
 		}
 
-		header_size += stream.tellg();
+		header_size += used;
 	}
 	else
 	{
@@ -1751,18 +1790,10 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 	return true;
 }
 
-bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
+bool LLMeshRepoThread::lodInflated(const LLVolumeParams& mesh_params, S32 lod, LLSD& mdl)
 {
-	if (data == NULL || data_size == 0)
-	{
-		return false;
-	}
-
 	LLPointer<LLVolume> volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
-	std::string mesh_string((char*) data, data_size);
-	std::istringstream stream(mesh_string);
-
-	if (volume->unpackVolumeFaces(stream, data_size))
+	if (volume->unpackVolumeFaces(mdl))
 	{
 		if (volume->getNumFaces() > 0)
 		{
@@ -1784,11 +1815,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 
 	if (data_size > 0)
 	{
-		std::string res_str((char*) data, data_size);
-
-		std::istringstream stream(res_str);
-
-		if (!unzip_llsd(skin, stream, data_size))
+		if (!unzip_llsd(skin, data, data_size))
 		{
 			LL_WARNS(LOG_MESH) << "Mesh skin info parse error.  Not a valid mesh asset!  ID:  " << mesh_id
 							   << LL_ENDL;
@@ -1816,11 +1843,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
 
 	if (data_size > 0)
 	{ 
-		std::string res_str((char*) data, data_size);
-
-		std::istringstream stream(res_str);
-
-		if (!unzip_llsd(decomp, stream, data_size))
+		if (!unzip_llsd(decomp, data, data_size))
 		{
 			LL_WARNS(LOG_MESH) << "Mesh decomposition parse error.  Not a valid mesh asset!  ID:  " << mesh_id
 							   << LL_ENDL;
@@ -1857,10 +1880,7 @@ bool LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32
 		volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
 		volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
 		LLPointer<LLVolume> volume = new LLVolume(volume_params,0);
-		std::string mesh_string((char*) data, data_size);
-		std::istringstream stream(mesh_string);
-
-		if (volume->unpackVolumeFaces(stream, data_size))
+		if (volume->unpackVolumeFaces(data, data_size))
 		{
 			//load volume faces into decomposition buffer
 			S32 vertex_count = 0;
@@ -3125,18 +3145,53 @@ void LLMeshLODHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
 								   U8 * data, S32 data_size)
 {
-	if ((! MESH_LOD_PROCESS_FAILED) && gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size))
+	if ((! MESH_LOD_PROCESS_FAILED) && data && data_size > 0)
+	{
+		// cached by the job once it unpacks
+		gInflateService.post(new LLMeshLODJob(mMeshParams, mLOD, data, llmin(data_size, (S32) mRequestedBytes), mOffset));
+	}
+	else
+	{
+		LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
+						   << ", Unknown reason.  Not retrying."
+						   << LL_ENDL;
+		LLMutexLock lock(gMeshRepo.mThread->mMutex);
+		gMeshRepo.mThread->mUnavailableQ.push(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
+	}
+}
+
+bool LLMeshLODJob::inflated(U8* data, size_t size)
+{
+	LLSD mdl;
+	return parse_unzipped_llsd(mdl, data, size)
+		&& gMeshRepo.mThread->lodInflated(mMeshParams, mLOD, mdl);
+}
+
+void LLMeshLODJob::finished(bool success)
+{
+	if (mFromCache)
+	{
+		if (!success)
+		{
+			LL_WARNS(LOG_MESH) << "Cached mesh LOD didn't unpack.  ID:  " << mMeshParams.getSculptID()
+							   << ", fetching it again." << LL_ENDL;
+			LLMutexLock lock(gMeshRepo.mThread->mMutex);
+			gMeshRepo.mThread->mLODReqQ.push(LLMeshRepoThread::LODRequest(mMeshParams, mLOD, true));
+			LLMeshRepository::sLODProcessing++;
+		}
+	}
+	else if (success)
 	{
 		// good fetch from sim, write to VFS for caching
 		LLVFile file(gVFS, mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLVFile::WRITE);
 
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
+		const std::vector<U8>& data = getCompressed();
+		S32 size = data.size();
 
-		if (file.getSize() >= offset+size)
+		if (file.getSize() >= mOffset+size)
 		{
-			file.seek(offset);
-			file.write(data, size);
+			file.seek(mOffset);
+			file.write(&data[0], size);
 			LLMeshRepository::sCacheBytesWritten += size;
 			++LLMeshRepository::sCacheWrites;
 		}
@@ -3869,6 +3924,16 @@ const LLMeshSkinInfo* LLMeshRepository::getSkinInfo(const LLUUID& mesh_id, const
 	return NULL;
 }
 
+const LLMeshSkinInfo* LLMeshRepository::findSkinInfo(const LLUUID& mesh_id) const
+{
+	skin_map::const_iterator iter = mSkinMap.find(mesh_id);
+	if (iter != mSkinMap.end())
+	{
+		return &(iter->second);
+	}
+	return NULL;
+}
+
 void LLMeshRepository::fetchPhysicsShape(const LLUUID& mesh_id)
 {
 	LL_RECORD_BLOCK_TIME(FTM_MESH_FETCH);
@@ -213,9 +213,10 @@ public:
 		LLVolumeParams  mMeshParams;
 		S32 mLOD;
 		F32 mScore;
+		bool mSkipCache;	// the cached copy didn't unpack, go to the sim
 
-		LODRequest(const LLVolumeParams&  mesh_params, S32 lod)
-			: mMeshParams(mesh_params), mLOD(lod), mScore(0.f)
+		LODRequest(const LLVolumeParams&  mesh_params, S32 lod, bool skip_cache = false)
+			: mMeshParams(mesh_params), mLOD(lod), mScore(0.f), mSkipCache(skip_cache)
 		{
 		}
 	};
@@ -301,9 +302,11 @@ public:
 	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool skip_cache = false);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
-	bool lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
+	// LOD blocks are inflated by gInflateService, this takes it from there
+	// on any thread
+	bool lodInflated(const LLVolumeParams& mesh_params, S32 lod, LLSD& mdl);
 	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
@@ -500,6 +503,9 @@ public:
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 	static S32 getActualMeshLOD(LLSD& header, S32 lod);
 	const LLMeshSkinInfo* getSkinInfo(const LLUUID& mesh_id, const LLVOVolume* requesting_obj);
+	// Already loaded skin info only, nothing is requested.  Safe from the
+	// animation threads while the main thread waits on them.
+	const LLMeshSkinInfo* findSkinInfo(const LLUUID& mesh_id) const;
 	LLModel::Decomposition* getDecomposition(const LLUUID& mesh_id);
 	void fetchPhysicsShape(const LLUUID& mesh_id);
 	bool hasPhysicsShape(const LLUUID& mesh_id);
@@ -0,0 +1,366 @@
+/**
+ * @file llobjectupdatedecoder.cpp
+ * @brief LLObjectUpdateDecoder class implementation
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectupdatedecoder.h"
+
+#include "lldatapacker.h"
+#include "llfasttimer.h"
+#include "llquantize.h"
+#include "llvolumemessage.h"
+#include "message.h"
+#include "object_flags.h"
+
+// below this the workers cost more to wake than they save
+static const S32 MIN_PARALLEL_BLOCKS = 8;
+
+// same as LLViewerObject's
+static const S32 MAX_OBJECT_PARAMS_SIZE = 1024;
+
+static LLTrace::BlockTimerStatHandle FTM_DECODE_OBJECT_UPDATES("Decode Object Updates");
+
+LLObjectUpdateDecoder::LLObjectUpdateDecoder(U32 threads)
+:	mFanOut("Object update decode", threads),
+	mCount(0),
+	mMessage(NULL),
+	mUpdateType(OUT_UNKNOWN),
+	mCompressed(false)
+{
+}
+
+void LLObjectUpdateDecoder::decode(LLMessageSystem* msg, EObjectUpdateType update_type, bool compressed)
+{
+	LL_RECORD_BLOCK_TIME(FTM_DECODE_OBJECT_UPDATES);
+
+	S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+	if ((S32) mRecords.size() < count)
+	{
+		mRecords.resize(count);
+	}
+	mCount = count;
+
+	mMessage = msg;
+	mUpdateType = update_type;
+	mCompressed = compressed;
+	mFanOut.run(count, decodeIndex, this, MIN_PARALLEL_BLOCKS);
+	mMessage = NULL;
+}
+
+//static
+void LLObjectUpdateDecoder::decodeIndex(void* context, S32 block)
+{
+	LLObjectUpdateDecoder* decoder = (LLObjectUpdateDecoder*)context;
+	decodeBlock(decoder->mMessage, decoder->mUpdateType, decoder->mCompressed, block, decoder->mRecords[block]);
+}
+
+LLNetworkData* LLObjectUpdateRecord::getExtraParams(U16 param_type)
+{
+	switch (param_type)
+	{
+	case LLNetworkData::PARAMS_FLEXIBLE:
+		return &mFlexibleParams;
+	case LLNetworkData::PARAMS_LIGHT:
+		return &mLightParams;
+	case LLNetworkData::PARAMS_SCULPT:
+	case LLNetworkData::PARAMS_MESH:
+		return &mSculptParams;
+	case LLNetworkData::PARAMS_LIGHT_IMAGE:
+		return &mLightImageParams;
+	default:
+		return NULL;
+	}
+}
+
+// Mirrors what LLViewerObjectList::processObjectUpdate() used to read itself,
+// and only reads the message.
+//static
+void LLObjectUpdateDecoder::decodeBlock(LLMessageSystem* msg, EObjectUpdateType update_type, bool compressed,
+										S32 block, LLObjectUpdateRecord& record)
+{
+	record.mBlock = block;
+	record.mLocalID = 0;
+	record.mFullID.setNull();
+	record.mPCode = 0;
+	record.mUpdateFlags = 0;
+	record.mDataSize = 0;
+	record.mHasVolumeParams = false;
+	record.mTEResult = 0;
+	record.mHasBody = false;
+
+	if (compressed)
+	{
+		record.mDataSize = llclamp(msg->getSizeFast(_PREHASH_ObjectData, block, _PREHASH_Data),
+								   0, (S32) LLObjectUpdateRecord::MAX_DATA_SIZE);
+		msg->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, record.mData, 0, block,
+							   LLObjectUpdateRecord::MAX_DATA_SIZE);
+		LLDataPackerBinaryBuffer dp(record.mData, record.mDataSize);
+
+		if (update_type != OUT_TERSE_IMPROVED)
+		{
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, record.mUpdateFlags, block);
+			if (!(record.mUpdateFlags & FLAGS_TEMPORARY_ON_REZ))
+			{
+				// the whole block goes to the object cache, which unpacks it
+				// when the object is loaded from there
+				return;
+			}
+		}
+		unpackCompressed(dp, update_type, record);
+	}
+	else if (update_type != OUT_FULL)
+	{
+		msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, record.mLocalID, block);
+	}
+	else
+	{
+		msg->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, record.mFullID, block);
+		msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, record.mLocalID, block);
+		msg->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, record.mPCode, block);
+
+		if (record.mPCode == LL_PCODE_VOLUME)
+		{
+			record.mHasVolumeParams = LLVolumeMessage::unpackVolumeParams(&record.mVolumeParams, msg, _PREHASH_ObjectData, block);
+
+			// the object's face count isn't known yet, parse them all
+			LLTEContents& tec = record.mTEContents;
+			tec.size = llclamp(msg->getSizeFast(_PREHASH_ObjectData, block, _PREHASH_TextureEntry),
+							   0, (S32) LLTEContents::MAX_TE_BUFFER);
+			if (tec.size)
+			{
+				msg->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, tec.packed_buffer, 0, block,
+									   LLTEContents::MAX_TE_BUFFER);
+			}
+			record.mTEResult = LLPrimitive::parseTEContents(tec, LLTEContents::MAX_TES);
+		}
+	}
+}
+
+// Reads what LLViewerObject::processUpdateMessage() and, for volumes,
+// LLVOVolume::processUpdateMessage() used to read from the packed data
+// themselves, in the same order.  They only apply the record now.
+//static
+void LLObjectUpdateDecoder::unpackCompressed(LLDataPackerBinaryBuffer& dp, EObjectUpdateType update_type,
+											 LLObjectUpdateRecord& record)
+{
+	record.mHasVolumeParams = false;
+	record.mTEResult = 0;
+
+	if (update_type == OUT_TERSE_IMPROVED)
+	{
+		dp.unpackU32(record.mLocalID, "LocalID");
+	}
+	else
+	{
+		dp.unpackUUID(record.mFullID, "ID");
+		dp.unpackU32(record.mLocalID, "LocalID");
+		dp.unpackU8(record.mPCode, "PCode");
+	}
+	record.mHasBody = true;
+
+	dp.unpackU8(record.mState, "State");
+
+	U16 val[4];
+	if (update_type == OUT_TERSE_IMPROVED)
+	{
+		U8 value;
+		dp.unpackU8(value, "agent");
+		record.mHasFootPlane = value != 0;
+		if (record.mHasFootPlane)
+		{
+			dp.unpackVector4(record.mFootPlane, "Plane");
+		}
+		dp.unpackVector3(record.mPosition, "Pos");
+		dp.unpackU16(val[VX], "VelX");
+		dp.unpackU16(val[VY], "VelY");
+		dp.unpackU16(val[VZ], "VelZ");
+		record.mVelocity.set(U16_to_F32(val[VX], -128.f, 128.f),
+							 U16_to_F32(val[VY], -128.f, 128.f),
+							 U16_to_F32(val[VZ], -128.f, 128.f));
+		dp.unpackU16(val[VX], "AccX");
+		dp.unpackU16(val[VY], "AccY");
+		dp.unpackU16(val[VZ], "AccZ");
+		record.mAcceleration.set(U16_to_F32(val[VX], -64.f, 64.f),
+								 U16_to_F32(val[VY], -64.f, 64.f),
+								 U16_to_F32(val[VZ], -64.f, 64.f));
+
+		dp.unpackU16(val[VX], "ThetaX");
+		dp.unpackU16(val[VY], "ThetaY");
+		dp.unpackU16(val[VZ], "ThetaZ");
+		dp.unpackU16(val[VS], "ThetaS");
+		record.mRotation.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
+		record.mRotation.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
+		record.mRotation.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
+		record.mRotation.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
+		dp.unpackU16(val[VX], "AccX");
+		dp.unpackU16(val[VY], "AccY");
+		dp.unpackU16(val[VZ], "AccZ");
+		record.mAngularVelocity.set(U16_to_F32(val[VX], -64.f, 64.f),
+									U16_to_F32(val[VY], -64.f, 64.f),
+									U16_to_F32(val[VZ], -64.f, 64.f));
+		return;
+	}
+
+	dp.unpackU32(record.mCRC, "CRC");
+	dp.unpackU8(record.mMaterial, "Material");
+	dp.unpackU8(record.mClickAction, "ClickAction");
+	dp.unpackVector3(record.mScale, "Scale");
+	dp.unpackVector3(record.mPosition, "Pos");
+	LLVector3 vec;
+	dp.unpackVector3(vec, "Rot");
+	record.mRotation.unpackFromVector3(vec);
+
+	U32 value;
+	dp.unpackU32(value, "SpecialCode");
+	record.mPassFlags = value;
+	dp.unpackUUID(record.mOwnerID, "Owner");
+
+	if (value & 0x80)
+	{
+		dp.unpackVector3(record.mAngularVelocity, "Omega");
+	}
+
+	record.mParentID = 0;
+	if (value & 0x20)
+	{
+		dp.unpackU32(record.mParentID, "ParentID");
+	}
+
+	record.mScratchPadSize = 0;
+	record.mScratchPad.clear();
+	if (value & 0x2)
+	{
+		record.mScratchPadSize = 1;
+		record.mScratchPad.resize(1);
+		dp.unpackU8(record.mScratchPad[0], "TreeData");
+	}
+	else if (value & 0x1)
+	{
+		dp.unpackU32(record.mScratchPadSize, "ScratchPadSize");
+		// never more than what is left of the block
+		S32 sp_size = 0;
+		record.mScratchPad.resize(llmax(dp.getBufferSize(), 1));
+		dp.unpackBinaryData(&record.mScratchPad[0], sp_size, "PartData");
+		record.mScratchPad.resize(sp_size);
+	}
+
+	record.mText.clear();
+	if (value & 0x4)
+	{
+		dp.unpackString(record.mText, "Text");
+		dp.unpackBinaryDataFixed(record.mTextColor.mV, 4, "Color");
+		record.mTextColor.mV[3] = 255 - record.mTextColor.mV[3];
+	}
+
+	record.mMediaURL.clear();
+	if (value & 0x200)
+	{
+		dp.unpackString(record.mMediaURL, "MediaURL");
+	}
+
+	record.mHasLegacyPartSys = false;
+	if (value & 0x8)
+	{
+		record.mHasLegacyPartSys = record.mLegacyPartSys.unpackLegacy(dp);
+	}
+
+	// unknown types are left out, as the object would have
+	record.mParamTypes.clear();
+	U8 num_parameters = 0;
+	dp.unpackU8(num_parameters, "num_params");
+	U8 param_block[MAX_OBJECT_PARAMS_SIZE];
+	for (U8 param = 0; param < num_parameters; ++param)
+	{
+		U16 param_type = 0;
+		S32 param_size = 0;
+		dp.unpackU16(param_type, "param_type");
+		dp.unpackBinaryData(param_block, param_size, "param_data");
+		if (LLNetworkData::PARAMS_MESH == param_type)
+		{
+			param_type = LLNetworkData::PARAMS_SCULPT;
+		}
+		LLNetworkData* params = record.getExtraParams(param_type);
+		if (params)
+		{
+			LLDataPackerBinaryBuffer dp2(param_block, param_size);
+			params->unpack(dp2);
+			if (std::find(record.mParamTypes.begin(), record.mParamTypes.end(), param_type) == record.mParamTypes.end())
+			{
+				record.mParamTypes.push_back(param_type);
+			}
+		}
+	}
+
+	record.mSoundID.setNull();
+	record.mSoundGain = 0.f;
+	record.mSoundFlags = 0;
+	record.mSoundRadius = 0.f;
+	if (value & 0x10)
+	{
+		dp.unpackUUID(record.mSoundID, "SoundUUID");
+		dp.unpackF32(record.mSoundGain, "SoundGain");
+		dp.unpackU8(record.mSoundFlags, "SoundFlags");
+		dp.unpackF32(record.mSoundRadius, "SoundRadius");
+	}
+
+	record.mNameValues.clear();
+	if (value & 0x100)
+	{
+		dp.unpackString(record.mNameValues, "NV");
+	}
+
+	if (record.mPCode != LL_PCODE_VOLUME)
+	{
+		return;
+	}
+
+	record.mHasVolumeParams = LLVolumeMessage::unpackVolumeParams(&record.mVolumeParams, dp);
+
+	// the object's face count isn't known yet, parse them all
+	LLTEContents& tec = record.mTEContents;
+	S32 te_size = 0;
+	if (!dp.unpackBinaryData(tec.packed_buffer, te_size, "TextureEntry"))
+	{
+		record.mTEResult = TEM_INVALID;
+	}
+	else
+	{
+		tec.size = te_size;
+		record.mTEResult = LLPrimitive::parseTEContents(tec, LLTEContents::MAX_TES);
+	}
+
+	record.mTextureAnim.reset();
+	if (value & 0x40)
+	{
+		record.mTextureAnim.unpackTAMessage(dp);
+	}
+
+	record.mHasPartSys = false;
+	if (value & 0x400)
+	{
+		record.mHasPartSys = record.mPartSys.unpack(dp);
+	}
+}
@@ -0,0 +1,161 @@
+/**
+ * @file llobjectupdatedecoder.h
+ * @brief LLObjectUpdateDecoder class, decodes object update blocks on
+ * worker threads.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEDECODER_H
+#define LL_LLOBJECTUPDATEDECODER_H
+
+#include "llfanout.h"
+#include "llpartdata.h"
+#include "llprimitive.h"
+#include "llquaternion.h"
+#include "lltextureanim.h"
+#include "lluuid.h"
+#include "llviewerobject.h"
+#include "llvolume.h"
+#include "v4coloru.h"
+#include "v4math.h"
+
+class LLDataPackerBinaryBuffer;
+class LLMessageSystem;
+
+// One ObjectData block of an ObjectUpdate or ObjectUpdateCompressed message,
+// unpacked into plain data that doesn't depend on any viewer object.
+struct LLObjectUpdateRecord
+{
+	enum { MAX_DATA_SIZE = 2048 };
+
+	S32				mBlock;
+	U32				mLocalID;
+	LLUUID			mFullID;		// null if the block doesn't carry it
+	LLPCode			mPCode;
+	U32				mUpdateFlags;
+
+	// compressed updates: the packed object data
+	U8				mData[MAX_DATA_SIZE];
+	S32				mDataSize;
+
+	// full updates of volumes, compressed or not
+	bool			mHasVolumeParams;
+	LLVolumeParams	mVolumeParams;
+	S32				mTEResult;		// 0 if there were no texture entries, TEM_INVALID if they were bad
+	LLTEContents	mTEContents;	// parsed for LLTEContents::MAX_TES faces
+
+	// Compressed and cached updates: the packed object data unpacked by
+	// LLObjectUpdateDecoder::unpackCompressed(), what follows is only set
+	// when mHasBody is.
+	bool			mHasBody;
+	U8				mState;
+
+	// terse updates
+	bool			mHasFootPlane;
+	LLVector4		mFootPlane;
+	LLVector3		mVelocity;
+	LLVector3		mAcceleration;
+
+	// terse and full updates
+	LLVector3		mPosition;
+	LLQuaternion	mRotation;
+	LLVector3		mAngularVelocity;	// full updates only carry it with flag 0x80
+
+	// full updates
+	U32				mCRC;
+	U8				mMaterial;
+	U8				mClickAction;
+	LLVector3		mScale;
+	U32				mPassFlags;			// the SpecialCode flags, what else is packed
+	LLUUID			mOwnerID;
+	U32				mParentID;
+	U32				mScratchPadSize;	// tree data or scratch pad, as sent
+	std::vector<U8>	mScratchPad;
+	std::string		mText;
+	LLColor4U		mTextColor;
+	std::string		mMediaURL;
+	bool			mHasLegacyPartSys;	// flag 0x8 and it unpacked
+	LLPartSysData	mLegacyPartSys;
+	std::vector<U16> mParamTypes;		// extra parameters sent, in message order
+	LLFlexibleObjectData mFlexibleParams;
+	LLLightParams	mLightParams;
+	LLSculptParams	mSculptParams;		// also for PARAMS_MESH
+	LLLightImageParams mLightImageParams;
+	LLUUID			mSoundID;
+	F32				mSoundGain;
+	U8				mSoundFlags;
+	F32				mSoundRadius;
+	std::string		mNameValues;
+
+	// full updates of volumes, after the above
+	LLTextureAnim	mTextureAnim;		// flag 0x40
+	bool			mHasPartSys;		// flag 0x400 and it unpacked
+	LLPartSysData	mPartSys;
+
+	// NULL for extra parameter types the viewer doesn't know
+	LLNetworkData* getExtraParams(U16 param_type);
+	const LLNetworkData* getExtraParams(U16 param_type) const
+	{
+		return const_cast<LLObjectUpdateRecord*>(this)->getExtraParams(param_type);
+	}
+};
+
+// Decodes the blocks of the object update being processed into
+// LLObjectUpdateRecords, fanned out over the worker threads and the calling
+// thread when there are enough of them.  Everything that creates or changes
+// objects stays with the caller on the main thread.
+class LLObjectUpdateDecoder
+{
+public:
+	// no threads decodes every block on the calling thread
+	LLObjectUpdateDecoder(U32 threads);
+
+	// The message must stay current until this returns.
+	void decode(LLMessageSystem* msg, EObjectUpdateType update_type, bool compressed);
+
+	S32 getCount() const						{ return mCount; }
+	LLObjectUpdateRecord& getRecord(S32 i)		{ return mRecords[i]; }
+	U32 getThreadCount() const					{ return mFanOut.getThreadCount(); }
+
+	static void decodeBlock(LLMessageSystem* msg, EObjectUpdateType update_type, bool compressed,
+							S32 block, LLObjectUpdateRecord& record);
+
+	// Unpacks all of a compressed or cached block, from its ID on, into the
+	// record.  Only touches the record, so it runs on any thread.
+	static void unpackCompressed(LLDataPackerBinaryBuffer& dp, EObjectUpdateType update_type,
+								 LLObjectUpdateRecord& record);
+
+private:
+	static void decodeIndex(void* context, S32 block);
+
+	LLFanOut							mFanOut;
+	std::vector<LLObjectUpdateRecord>	mRecords;
+	S32									mCount;
+
+	// the message being decoded, only set while decode() runs
+	LLMessageSystem*	mMessage;
+	EObjectUpdateType	mUpdateType;
+	bool				mCompressed;
+};
+
+#endif // LL_LLOBJECTUPDATEDECODER_H
@@ -149,7 +149,7 @@ protected:
 				const controller_map_t::const_iterator& entry = mParamControllers.find(controller_key[param]);
                 if (entry == mParamControllers.end())
                 {
-                        return sDefaultController[controller_key[param]];
+                        return getDefaultValue(controller_key[param]);
                 }
                 const std::string& param_name = (*entry).second.c_str();
                 mParamCache[param] = mCharacter->getVisualParam(param_name.c_str());
@@ -161,10 +161,17 @@ protected:
 			}
 			else
 			{
-				return sDefaultController[controller_key[param]];
+				return getDefaultValue(controller_key[param]);
 			}
 		}
 
+		// find(), not operator[]: updates run on several threads at once
+		static F32 getDefaultValue(const std::string& key)
+		{
+			default_controller_map_t::const_iterator it = sDefaultController.find(key);
+			return it != sDefaultController.end() ? it->second : 0.f;
+		}
+
         
         void setParamValue(const LLViewerVisualParam *param,
                            const F32 new_value_local,
@@ -450,10 +457,19 @@ F32 LLPhysicsMotion::calculateAcceleration_local(const F32 velocity_local)
         return smoothed_acceleration_local;
 }
 
+bool LLPhysicsMotionController::sEnabled = true;
+
+//static
+void LLPhysicsMotionController::updateEnabled()
+{
+	static LLCachedControl<bool> avatar_physics(gSavedSettings, "AvatarPhysics");
+	sEnabled = avatar_physics;
+}
+
 BOOL LLPhysicsMotionController::onUpdate(F32 time, U8* joint_mask)
 {
         // Skip if disabled globally.
-        if (!gSavedSettings.getBOOL("AvatarPhysics"))
+        if (!sEnabled)
         {
                 return TRUE;
         }
@@ -100,15 +100,22 @@ public:
 	// must return FALSE when the motion is completed.
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
 
+	virtual BOOL canUpdateOffThread() { return TRUE; }
+
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
 	LLCharacter* getCharacter() { return mCharacter; }
 
+	// Reads AvatarPhysics for this frame's updates. Main thread only,
+	// since the updates may run on animation threads.
+	static void updateEnabled();
+
 protected:
 	void addMotion(LLPhysicsMotion *motion);
 private:
 	LLCharacter*		mCharacter;
+	static bool			sEnabled;
 
 	typedef std::vector<LLPhysicsMotion *> motion_vec_t;
 	motion_vec_t mMotions;
@@ -103,7 +103,7 @@ void LLSkinningUtil::initSkinningMatrixPalette(
 #ifdef MAT_USE_SSE
             LLMatrix4a bind, world, res;
             bind.loadu(skin->mInvBindMatrix[j]);
-            world.loadu(joint->getWorldMatrix());
+            joint->loadWorldMatrix(world);
             matMul(bind,world,res);
             memcpy(mat[j].mMatrix,res.mMatrix,16*sizeof(float));
 #else
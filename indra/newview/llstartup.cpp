@@ -650,6 +650,15 @@ bool idle_startup()
 				msg->mPacketRing.setUseOutThrottle(TRUE);
 				msg->mPacketRing.setOutBandwidth(outBandwidth);
 			}
+
+			msg->mPacketRing.setBatchSends(gSavedSettings.getBOOL("PVNetwork_BatchSends"));
+
+			// after the packet ring is configured, the thread receives through it
+			U32 receive_buffer_kb = gSavedSettings.getU32("PVNetwork_ReceiveThreadBuffer");
+			if (receive_buffer_kb)
+			{
+				msg->startReceiveThread(receive_buffer_kb * 1024);
+			}
 		}
 
 		LL_INFOS("AppInit") << "Message System Initialized." << LL_ENDL;
@@ -66,6 +66,7 @@
 #include "llfloatertools.h"
 #include "llfollowcam.h"
 #include "llhudtext.h"
+#include "llobjectupdatedecoder.h"
 #include "llselectmgr.h"
 #include "llrendersphere.h"
 #include "lltooldraganddrop.h"
@@ -237,6 +238,7 @@ LLViewerObject::LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRe
 	mPhysicsRestitution(0),
 	mDrawable(),
 	mCreateSelected(FALSE),
+	mDecodedUpdate(NULL),
 	mRenderMedia(FALSE),
 	mBestUpdatePrecision(0),
 	mText(),
@@ -1681,19 +1683,12 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 	else
 	{
-		// handle the compressed case
-		LLUUID sound_uuid;
-		LLUUID	owner_id;
-		F32    gain = 0;
-		U8     sound_flags = 0;
-		F32		cutoff = 0;
+		// handle the compressed case, already unpacked off the main thread
+		// by LLObjectUpdateDecoder::unpackCompressed()
+		llassert(mDecodedUpdate && mDecodedUpdate->mHasBody);
+		const LLObjectUpdateRecord& update = *mDecodedUpdate;
 
-		U16 val[4];
-
-		U8		state;
-
-		dp->unpackU8(state, "State");
-		mState = state;
+		mState = update.mState;
 
 		switch(update_type)
 		{
@@ -1702,43 +1697,16 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 #ifdef DEBUG_UPDATE_TYPE
 				LL_INFOS() << "CompTI:" << getID() << LL_ENDL;
 #endif
-				U8		value;
-				dp->unpackU8(value, "agent");
-				if (value)
+				if (update.mHasFootPlane)
 				{
-					LLVector4 collision_plane;
-					dp->unpackVector4(collision_plane, "Plane");
-					((LLVOAvatar*)this)->setFootPlane(collision_plane);
+					((LLVOAvatar*)this)->setFootPlane(update.mFootPlane);
 				}
 				test_pos_parent = getPosition();
-				dp->unpackVector3(new_pos_parent, "Pos");
-				dp->unpackU16(val[VX], "VelX");
-				dp->unpackU16(val[VY], "VelY");
-				dp->unpackU16(val[VZ], "VelZ");
-				setVelocity(U16_to_F32(val[VX], -128.f, 128.f),
-							U16_to_F32(val[VY], -128.f, 128.f),
-							U16_to_F32(val[VZ], -128.f, 128.f));
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				setAcceleration(U16_to_F32(val[VX], -64.f, 64.f),
-								U16_to_F32(val[VY], -64.f, 64.f),
-								U16_to_F32(val[VZ], -64.f, 64.f));
-
-				dp->unpackU16(val[VX], "ThetaX");
-				dp->unpackU16(val[VY], "ThetaY");
-				dp->unpackU16(val[VZ], "ThetaZ");
-				dp->unpackU16(val[VS], "ThetaS");
-				new_rot.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
-				new_rot.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
-				new_rot.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
-				new_rot.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				new_angv.set(U16_to_F32(val[VX], -64.f, 64.f),
-									U16_to_F32(val[VY], -64.f, 64.f),
-									U16_to_F32(val[VZ], -64.f, 64.f));
+				new_pos_parent = update.mPosition;
+				setVelocity(update.mVelocity);
+				setAcceleration(update.mAcceleration);
+				new_rot = update.mRotation;
+				new_angv = update.mAngularVelocity;
 				setAngularVelocity(new_angv);
 			}
 			break;
@@ -1755,9 +1723,9 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					gFloaterTools->dirty();
 				}
 	
-				dp->unpackU32(crc, "CRC");
+				crc = update.mCRC;
 				mTotalCRC = crc;
-				dp->unpackU8(material, "Material");
+				material = update.mMaterial;
 				U8 old_material = getMaterial();
 				if (old_material != material)
 				{
@@ -1767,52 +1735,34 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 						gPipeline.markMoved(mDrawable, FALSE); // undamped
 					}
 				}
-				dp->unpackU8(click_action, "ClickAction");
+				click_action = update.mClickAction;
 				setClickAction(click_action);
-				dp->unpackVector3(new_scale, "Scale");
-				dp->unpackVector3(new_pos_parent, "Pos");
-				LLVector3 vec;
-				dp->unpackVector3(vec, "Rot");
-				new_rot.unpackFromVector3(vec);
+				new_scale = update.mScale;
+				new_pos_parent = update.mPosition;
+				new_rot = update.mRotation;
 				setAcceleration(LLVector3::zero);
 
-				U32 value;
-				dp->unpackU32(value, "SpecialCode");
-				dp->setPassFlags(value);
-				dp->unpackUUID(owner_id, "Owner");
+				U32 value = update.mPassFlags;
+				const LLUUID& owner_id = update.mOwnerID;
 
 				mOwnerID = owner_id;
 
 				if (value & 0x80)
 				{
-					dp->unpackVector3(new_angv, "Omega");
+					new_angv = update.mAngularVelocity;
 					setAngularVelocity(new_angv);
 				}
 
-				if (value & 0x20)
-				{
-					dp->unpackU32(parent_id, "ParentID");
-				}
-				else
-				{
-					parent_id = 0;
-				}
+				parent_id = update.mParentID;
 
-				S32 sp_size;
-				U32 size;
-				if (value & 0x2)
-				{
-					sp_size = 1;
-					delete [] mData;
-					mData = new U8[1];
-					dp->unpackU8(((U8*)mData)[0], "TreeData");
-				}
-				else if (value & 0x1)
+				if (value & 0x3)
 				{
-					dp->unpackU32(size, "ScratchPadSize");
 					delete [] mData;
-					mData = new U8[size];
-					dp->unpackBinaryData((U8 *)mData, sp_size, "PartData");
+					mData = new U8[update.mScratchPadSize];
+					if (!update.mScratchPad.empty())
+					{
+						memcpy(mData, &update.mScratchPad[0], llmin((U32) update.mScratchPad.size(), update.mScratchPadSize));
+					}
 				}
 				else
 				{
@@ -1827,11 +1777,8 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 
 				if (value & 0x4)
 				{
-					std::string temp_string;
-					dp->unpackString(temp_string, "Text");
-					LLColor4U coloru;
-					dp->unpackBinaryDataFixed(coloru.mV, 4, "Color");
-					coloru.mV[3] = 255 - coloru.mV[3];
+					const std::string& temp_string = update.mText;
+					LLColor4U coloru = update.mTextColor;
 					mText->setColor(LLColor4(coloru));
 					mText->setString(temp_string);
 // [RLVa:KB] - Checked: 2010-03-27 (RLVa-1.4.0a) | Added: RLVa-1.0.0f
@@ -1856,19 +1803,14 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					mHudText.clear();
 				}
 
-                std::string media_url;
-				if (value & 0x200)
-				{
-					dp->unpackString(media_url, "MediaURL");
-				}
-                retval |= checkMediaURL(media_url);
+                retval |= checkMediaURL(update.mMediaURL);
 
 				//
-				// Unpack particle system data (legacy)
+				// Particle system data (legacy)
 				//
 				if (value & 0x8)
 				{
-					unpackParticleSource(*dp, owner_id, true);
+					applyParticleSource(update.mHasLegacyPartSys ? &update.mLegacyPartSys : NULL, owner_id);
 				}
 				else if (!(value & 0x400))
 				{
@@ -1882,19 +1824,11 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					iter->second->in_use = FALSE;
 				}
 
-				// Unpack extra params
-				U8 num_parameters;
-				dp->unpackU8(num_parameters, "num_params");
-				U8 param_block[MAX_OBJECT_PARAMS_SIZE];
-				for (U8 param=0; param<num_parameters; ++param)
+				// Apply extra params
+				for (std::vector<U16>::const_iterator type_it = update.mParamTypes.begin();
+					 type_it != update.mParamTypes.end(); ++type_it)
 				{
-					U16 param_type;
-					S32 param_size;
-					dp->unpackU16(param_type, "param_type");
-					dp->unpackBinaryData(param_block, param_size, "param_data");
-					//LL_INFOS() << "Param type: " << param_type << ", Size: " << param_size << LL_ENDL;
-					LLDataPackerBinaryBuffer dp2(param_block, param_size);
-					unpackParameterEntry(param_type, &dp2);
+					applyParameterEntry(*type_it, *update.getExtraParams(*type_it));
 				}
 
 				for (iter = mExtraParameterList.begin(); iter != mExtraParameterList.end(); ++iter)
@@ -1906,25 +1840,14 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					}
 				}
 
-				if (value & 0x10)
-				{
-					dp->unpackUUID(sound_uuid, "SoundUUID");
-					dp->unpackF32(gain, "SoundGain");
-					dp->unpackU8(sound_flags, "SoundFlags");
-					dp->unpackF32(cutoff, "SoundRadius");
-				}
-
 				if (value & 0x100)
 				{
-					std::string name_value_list;
-					dp->unpackString(name_value_list, "NV");
-
-					setNameValueList(name_value_list);
+					setNameValueList(update.mNameValues);
 				}
 
 				mTotalCRC = crc;
 
-				setAttachedSound(sound_uuid, owner_id, gain, sound_flags);
+				setAttachedSound(update.mSoundID, owner_id, update.mSoundGain, update.mSoundFlags);
 
 				// only get these flags on updates from sim, not cached ones
 				// Preload these five flags for every object.
@@ -1932,9 +1855,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 				// stores the extended permission info.
 				if(mesgsys != NULL)
 				{
-				U32 flags;
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, block_num);
-				loadFlags(flags);					
+				loadFlags(update.mUpdateFlags);
 				}
 			}
 			break;
@@ -5283,7 +5204,9 @@ void LLViewerObject::unpackParticleSource(const S32 block_num, const LLUUID& own
 	}
 }
 
-void LLViewerObject::unpackParticleSource(LLDataPacker &dp, const LLUUID& owner_id, bool legacy)
+// As unpackParticleSource(), with the data already unpacked, NULL if it
+// didn't unpack.
+void LLViewerObject::applyParticleSource(const LLPartSysData* particle_parameters, const LLUUID& owner_id)
 {
 	if (!mPartSourcep.isNull() && mPartSourcep->isDead())
 	{
@@ -5292,21 +5215,24 @@ void LLViewerObject::unpackParticleSource(LLDataPacker &dp, const LLUUID& owner_
 	if (mPartSourcep)
 	{
 		// If we've got one already, just update the existing source (or remove it)
-		if (!LLViewerPartSourceScript::unpackPSS(this, mPartSourcep, dp, legacy))
+		if (!particle_parameters)
 		{
 			mPartSourcep->setDead();
 			mPartSourcep = NULL;
 		}
+		else
+		{
+			LLViewerPartSourceScript::updatePSS(mPartSourcep, *particle_parameters);
+		}
 	}
-	else
+	else if (particle_parameters)
 	{
-		LLPointer<LLViewerPartSourceScript> pss = LLViewerPartSourceScript::unpackPSS(this, NULL, dp, legacy);
+		LLPointer<LLViewerPartSourceScript> pss = LLViewerPartSourceScript::createPSS(this, *particle_parameters);
 		//If the owner is muted, don't create the system
 		if(LLMuteList::getInstance()->isMuted(owner_id, LLMute::flagParticles)) return;
 		// We need to be able to deal with a particle source that hasn't changed, but still got an update!
 		if (pss)
 		{
-// 			LL_INFOS() << "Making particle system with owner " << owner_id << LL_ENDL;
 			pss->setOwnerUUID(owner_id);
 			mPartSourcep = pss;
 			LLViewerPartSim::getInstance()->addPartSource(pss);
@@ -5505,6 +5431,27 @@ bool LLViewerObject::unpackParameterEntry(U16 param_type, LLDataPacker *dp)
 	}
 }
 
+// As unpackParameterEntry(), with the data already unpacked.
+bool LLViewerObject::applyParameterEntry(U16 param_type, const LLNetworkData& data)
+{
+	if (LLNetworkData::PARAMS_MESH == param_type)
+	{
+		param_type = LLNetworkData::PARAMS_SCULPT;
+	}
+	ExtraParameter* param = getExtraParameterEntryCreate(param_type);
+	if (param)
+	{
+		param->data->copy(data);
+		param->in_use = TRUE;
+		parameterChanged(param_type, param->data, TRUE, false);
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
 LLViewerObject::ExtraParameter* LLViewerObject::createNewParameterEntry(U16 param_type)
 {
 	LLNetworkData* new_block = NULL;
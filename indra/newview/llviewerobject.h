@@ -54,6 +54,7 @@ class LLHUDText;
 class LLHost;
 class LLMessageSystem;
 class LLNameValue;
+struct LLObjectUpdateRecord;
 class LLPartSysData;
 class LLPipeline;
 class LLTextureEntry;
@@ -592,6 +593,7 @@ private:
 	ExtraParameter* getExtraParameterEntry(U16 param_type) const;
 	ExtraParameter* getExtraParameterEntryCreate(U16 param_type);
 	bool unpackParameterEntry(U16 param_type, LLDataPacker *dp);
+	bool applyParameterEntry(U16 param_type, const LLNetworkData& data);
 
     // This function checks to see if the given media URL has changed its version
     // and the update wasn't due to this agent's last action.
@@ -672,6 +674,10 @@ public:
 	// Band-aid to select object after all creation initialization is done
 	BOOL mCreateSelected;
 
+	// The block processUpdateMessage() is working on, decoded ahead of time
+	// by LLObjectUpdateDecoder; NULL if it has to be read from the message
+	LLObjectUpdateRecord* mDecodedUpdate;
+
 	// Replace textures with web pages on this object while drawing
 	BOOL mRenderMedia;
 
@@ -717,7 +723,7 @@ protected:
 	BOOL isOnMap();
 
 	void unpackParticleSource(const S32 block_num, const LLUUID& owner_id);
-	void unpackParticleSource(LLDataPacker &dp, const LLUUID& owner_id, bool legacy);
+	void applyParticleSource(const LLPartSysData* particle_parameters, const LLUUID& owner_id);
 	void deleteParticleSource();
 	void setParticleSource(const LLPartSysData& particle_parameters, const LLUUID& owner_id);
 	
@@ -79,6 +79,7 @@
 #include "llfloaterperms.h"
 #include "llvocache.h"
 #include "llcorehttputil.h"
+#include "llobjectupdatedecoder.h"
 
 #include <algorithm>
 #include <iterator>
@@ -114,6 +115,7 @@ LLViewerObjectList::LLViewerObjectList()
 	mWasPaused = FALSE;
 	mNumDeadObjectUpdates = 0;
 	mNumUnknownUpdates = 0;
+	mUpdateDecoder = NULL;
 }
 
 LLViewerObjectList::~LLViewerObjectList()
@@ -123,6 +125,7 @@ LLViewerObjectList::~LLViewerObjectList()
 
 void LLViewerObjectList::destroy()
 {
+	stopUpdateDecoder();
 	killAllObjects();
 
 	resetObjectBeacons();
@@ -226,6 +229,22 @@ void LLViewerObjectList::setUUIDAndLocal(const LLUUID &id,
 	//	<< ", local ID " << local_id << ", ip " << ip << ":" << port << LL_ENDL;
 }
 
+void LLViewerObjectList::startUpdateDecoder(U32 threads)
+{
+	stopUpdateDecoder();
+	mUpdateDecoder = new LLObjectUpdateDecoder(threads);
+	if (threads)
+	{
+		LL_INFOS() << "Decoding object updates on " << threads << " threads" << LL_ENDL;
+	}
+}
+
+void LLViewerObjectList::stopUpdateDecoder()
+{
+	delete mUpdateDecoder;
+	mUpdateDecoder = NULL;
+}
+
 S32 gFullObjectUpdates = 0;
 S32 gTerseObjectUpdates = 0;
 
@@ -235,7 +254,8 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 										   const EObjectUpdateType update_type, 
 										   LLDataPacker* dpp, 
 										   bool just_created,
-										   bool from_cache)
+										   bool from_cache,
+										   LLObjectUpdateRecord* decoded)
 {
 	LLMessageSystem* msg = NULL;
 	
@@ -245,7 +265,9 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 	}
 
 	// ignore returned flags
+	objectp->mDecodedUpdate = decoded;
 	objectp->processUpdateMessage(msg, user_data, i, update_type, dpp);
+	objectp->mDecodedUpdate = NULL;
 		
 	if (objectp->isDead())
 	{
@@ -302,7 +324,7 @@ static LLTrace::BlockTimerStatHandle FTM_PROCESS_OBJECTS("Process Objects");
 
 LLViewerObject* LLViewerObjectList::processObjectUpdateFromCache(LLVOCacheEntry* entry, LLViewerRegion* regionp)
 {
-	LLDataPacker *cached_dpp = entry->getDP();
+	LLDataPackerBinaryBuffer *cached_dpp = entry->getDP();
 
 	if (!cached_dpp)
 	{
@@ -318,10 +340,17 @@ LLViewerObject* LLViewerObjectList::processObjectUpdateFromCache(LLVOCacheEntry*
 	// Cache Hit.
 	record(LLStatViewer::OBJECT_CACHE_HIT_RATE, LLUnits::Ratio::fromValue(1));
 
+	// unpacked the same way as the compressed updates the decoder threads
+	// handle, so there is one way of applying them
 	cached_dpp->reset();
-	cached_dpp->unpackUUID(fullid, "ID");
-	cached_dpp->unpackU32(local_id, "LocalID");
-	cached_dpp->unpackU8(pcode, "PCode");
+	LLObjectUpdateRecord record;
+	record.mBlock = 0;
+	record.mUpdateFlags = entry->getUpdateFlags();
+	record.mDataSize = 0;
+	LLObjectUpdateDecoder::unpackCompressed(*cached_dpp, OUT_FULL_CACHED, record);
+	fullid = record.mFullID;
+	local_id = record.mLocalID;
+	pcode = record.mPCode;
 
 	// <FS:Ansariel> Don't process derendered objects
 	if (mDerendered.end() != mDerendered.find(fullid))
@@ -379,7 +408,7 @@ LLViewerObject* LLViewerObjectList::processObjectUpdateFromCache(LLVOCacheEntry*
 		LL_WARNS() << "Dead object " << objectp->mID << " in UUID map 1!" << LL_ENDL;
 	}
 		
-	processUpdateCore(objectp, NULL, 0, OUT_FULL_CACHED, cached_dpp, justCreated, true);
+	processUpdateCore(objectp, NULL, 0, OUT_FULL_CACHED, cached_dpp, justCreated, true, &record);
 	objectp->loadFlags(entry->getUpdateFlags()); //just in case, reload update flags from cache.
 	
 	if(entry->getHitCount() > 0)
@@ -464,8 +493,13 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		return;
 	}
 
-	U8 compressed_dpbuffer[2048];
-	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
+	if (!mUpdateDecoder)
+	{
+		mUpdateDecoder = new LLObjectUpdateDecoder(0);
+	}
+	// unpack the blocks first, off the main thread when there are many
+	mUpdateDecoder->decode(mesgsys, update_type, compressed);
+
 	LLViewerStatsRecorder& recorder = LLViewerStatsRecorder::instance();
 
 	for (i = 0; i < num_objects; i++)
@@ -476,36 +510,28 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		S32	msg_size = 0;
 		bool update_cache = false; //update object cache if it is a full-update or terse update
 
+		LLObjectUpdateRecord& record = mUpdateDecoder->getRecord(i);
+		local_id = record.mLocalID;
+		fullid = record.mFullID;
+		pcode = record.mPCode;
+		// wraps the block's data, assignBuffer() would free the previous one;
+		// the decoder already unpacked all of it into the record
+		LLDataPackerBinaryBuffer compressed_dp(record.mData, record.mDataSize);
+
 		if (compressed)
 		{
-			S32							uncompressed_length = 2048;
-			compressed_dp.reset();
-
-			uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-			mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i);
-			compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
-
 			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
 			{
-				U32 flags = 0;
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
-                
-				if(flags & FLAGS_TEMPORARY_ON_REZ)
-				{
-                    compressed_dp.unpackUUID(fullid, "ID");
-                    compressed_dp.unpackU32(local_id, "LocalID");
-                    compressed_dp.unpackU8(pcode, "PCode");
-                }
-				else //send to object cache
+				if(!(record.mUpdateFlags & FLAGS_TEMPORARY_ON_REZ))
 				{
-					regionp->cacheFullUpdate(compressed_dp, flags);
+					//send to object cache
+					regionp->cacheFullUpdate(compressed_dp, record.mUpdateFlags);
 					continue;
 				}
 			}
 			else //OUT_TERSE_IMPROVED
 			{
 				update_cache = true;
-				compressed_dp.unpackU32(local_id, "LocalID");
 				getUUIDFromLocal(fullid,
 								 local_id,
 								 gMessageSystem->getSenderIP(),
@@ -519,7 +545,6 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		}
 		else if (update_type != OUT_FULL) // !compressed, !OUT_FULL ==> OUT_FULL_CACHED only?
 		{
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
 			msg_size += sizeof(U32);
 
 			getUUIDFromLocal(fullid,
@@ -535,8 +560,6 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		else // OUT_FULL only?
 		{
 			update_cache = true;
-			mesgsys->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, fullid, i);
-			mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
 			msg_size += sizeof(LLUUID);
 			msg_size += sizeof(U32);
 			// LL_INFOS() << "Full Update, obj " << local_id << ", global ID" << fullid << "from " << mesgsys->getSender() << LL_ENDL;
@@ -602,7 +625,6 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 					continue;
 				}
 
-				mesgsys->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, pcode, i);
 				msg_size += sizeof(U8);
 
 			}
@@ -650,7 +672,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			{
 				objectp->mLocalID = local_id;
 			}
-			processUpdateCore(objectp, user_data, i, update_type, &compressed_dp, justCreated);
+			processUpdateCore(objectp, user_data, i, update_type, &compressed_dp, justCreated, false, &record);
 
 #if 0
 			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
@@ -673,7 +695,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			{
 				objectp->mLocalID = local_id;
 			}
-			processUpdateCore(objectp, user_data, i, update_type, NULL, justCreated);
+			processUpdateCore(objectp, user_data, i, update_type, NULL, justCreated, false, &record);
 		}
 		recorder.objectUpdateEvent(local_id, update_type, objectp, msg_size);
 		objectp->setLastUpdateType(update_type);
@@ -943,6 +965,8 @@ void LLViewerObjectList::update(LLAgent &agent)
 
 	std::vector<LLViewerObject*>::iterator idle_end = idle_list.begin()+idle_count;
 
+	LLVOAvatar::startAnimationFrame();
+
 	// <FS:Ansariel> Speed up debug settings
 	//if (gSavedSettings.getBOOL("FreezeTime"))
 	if (freezeTime)
@@ -958,15 +982,41 @@ void LLViewerObjectList::update(LLAgent &agent)
 				objectp->idleUpdate(agent, frame_time);
 			}
 		}
+
+		// avatars waiting on their animations finish their idle update
+		LLVOAvatar::updateQueuedAnimations();
+		LLVOAvatar::updateQueuedIdleUpdates();
+		LLVOAvatar::applyQueuedMorphs();
 	}
 	else
 	{
+		// Avatars go first so their queued animations are joined before
+		// anything that follows a joint (attachments, particle sources,
+		// flexis) runs its idle update against this frame's skeleton.
 		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
 			idle_iter != idle_end; idle_iter++)
 		{
 			objectp = *idle_iter;
 			llassert(objectp->isActive());
-			objectp->idleUpdate(agent, frame_time);
+			if (objectp->isAvatar())
+			{
+				objectp->idleUpdate(agent, frame_time);
+			}
+		}
+
+		// avatars waiting on their animations finish their idle update
+		LLVOAvatar::updateQueuedAnimations();
+		LLVOAvatar::updateQueuedIdleUpdates();
+		LLVOAvatar::applyQueuedMorphs();
+
+		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
+			idle_iter != idle_end; idle_iter++)
+		{
+			objectp = *idle_iter;
+			if (!objectp->isAvatar())
+			{
+				objectp->idleUpdate(agent, frame_time);
+			}
 		}
 
 		//update flexible objects
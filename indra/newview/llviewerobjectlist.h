@@ -43,6 +43,8 @@ class LLCamera;
 class LLNetMap;
 class LLDebugBeacon;
 class LLVOCacheEntry;
+class LLObjectUpdateDecoder;
+struct LLObjectUpdateRecord;
 
 const U32 CLOSE_BIN_SIZE = 10;
 const U32 NUM_BINS = 128;
@@ -62,6 +64,11 @@ public:
 
 	void destroy();
 
+	// Threads for decoding object update blocks, none decodes them on the
+	// main thread.
+	void startUpdateDecoder(U32 threads);
+	void stopUpdateDecoder();
+
 	// For internal use only.  Does NOT take a local id, takes an index into
 	// an internal dynamic array.
 	inline LLViewerObject *getObject(const S32 index);
@@ -83,7 +90,8 @@ public:
 
 	// Simulator and viewer side object updates...
 	void processUpdateCore(LLViewerObject* objectp, void** data, U32 block, const EObjectUpdateType update_type, 
-		                   LLDataPacker* dpp, bool justCreated, bool from_cache = false);
+		                   LLDataPacker* dpp, bool justCreated, bool from_cache = false,
+		                   LLObjectUpdateRecord* decoded = NULL);
 	LLViewerObject* processObjectUpdateFromCache(LLVOCacheEntry* entry, LLViewerRegion* regionp);
 	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool compressed=false);
 	void processCompressedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
@@ -197,6 +205,8 @@ public:
 	S32 mNumDeadObjectUpdates;
 	S32 mNumDeadObjects;
 protected:
+	LLObjectUpdateDecoder*	mUpdateDecoder;
+
 	std::vector<U64>	mOrphanParents;	// LocalID/ip,port of orphaned objects
 	std::vector<OrphanInfo> mOrphanChildren;	// UUID's of orphaned objects
 	S32 mNumOrphans;
@@ -452,6 +452,78 @@ void LLViewerOctreeEntryData::resetVisible() const
 //class LLViewerOctreeGroup definitions
 //-----------------------------------------------------------------------------------
 
+//Free lists of group sized blocks, one per 64 byte size class.  Blocks are
+//carved out of slabs so that groups created together (a freshly loaded
+//region) end up next to each other, and are never returned to the heap.
+//Only touched from the main thread.
+namespace
+{
+	const size_t GROUP_BLOCK_ALIGN = 64;
+	const U32 GROUP_BUCKET_COUNT = 32;
+	const U32 GROUP_BLOCKS_PER_SLAB = 64;
+
+	struct FreeGroupBlock
+	{
+		FreeGroupBlock* mNext;
+	};
+
+	FreeGroupBlock* sFreeGroupBlocks[GROUP_BUCKET_COUNT] = { NULL };
+
+	U32 get_group_bucket(size_t size)
+	{
+		return (U32) ((size + GROUP_BLOCK_ALIGN - 1) / GROUP_BLOCK_ALIGN) - 1;
+	}
+}
+
+//static
+void* LLViewerOctreeGroup::operator new(size_t size)
+{
+#if LL_TRACE_ENABLED
+	LLTrace::claim_alloc(getMemStatHandle(), size);
+#endif
+
+	U32 bucket = get_group_bucket(size);
+	if (bucket >= GROUP_BUCKET_COUNT)
+	{
+		return ll_aligned_malloc<GROUP_BLOCK_ALIGN>(size);
+	}
+
+	if (!sFreeGroupBlocks[bucket])
+	{
+		const size_t block_size = (bucket + 1) * GROUP_BLOCK_ALIGN;
+		U8* slab = (U8*) ll_aligned_malloc<GROUP_BLOCK_ALIGN>(block_size * GROUP_BLOCKS_PER_SLAB);
+		for (S32 i = GROUP_BLOCKS_PER_SLAB - 1; i >= 0; --i)
+		{
+			FreeGroupBlock* block = (FreeGroupBlock*) (slab + i * block_size);
+			block->mNext = sFreeGroupBlocks[bucket];
+			sFreeGroupBlocks[bucket] = block;
+		}
+	}
+
+	FreeGroupBlock* block = sFreeGroupBlocks[bucket];
+	sFreeGroupBlocks[bucket] = block->mNext;
+	return block;
+}
+
+//static
+void LLViewerOctreeGroup::operator delete(void* ptr, size_t size)
+{
+#if LL_TRACE_ENABLED
+	LLTrace::disclaim_alloc(getMemStatHandle(), size);
+#endif
+
+	U32 bucket = get_group_bucket(size);
+	if (bucket >= GROUP_BUCKET_COUNT)
+	{
+		ll_aligned_free<GROUP_BLOCK_ALIGN>(ptr);
+		return;
+	}
+
+	FreeGroupBlock* block = (FreeGroupBlock*) ptr;
+	block->mNext = sFreeGroupBlocks[bucket];
+	sFreeGroupBlocks[bucket] = block;
+}
+
 LLViewerOctreeGroup::~LLViewerOctreeGroup()
 {
 	//empty here
@@ -1328,6 +1400,7 @@ LLViewerOctreePartition::LLViewerOctreePartition() :
 	size.splat(1.f);
 
 	mOctree = new OctreeRoot(center,size, NULL);
+	mOctree->setPool(&mNodePool);
 }
 	
 LLViewerOctreePartition::~LLViewerOctreePartition()
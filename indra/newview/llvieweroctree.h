@@ -50,6 +50,7 @@ typedef LLTreeNode<LLViewerOctreeEntry>			TreeNode;
 typedef LLOctreeNode<LLViewerOctreeEntry>		OctreeNode;
 typedef LLOctreeRoot<LLViewerOctreeEntry>		OctreeRoot;
 typedef LLOctreeTraveler<LLViewerOctreeEntry>	OctreeTraveler;
+typedef LLOctreePool<LLViewerOctreeEntry>		OctreePool;
 
 #if LL_OCTREE_PARANOIA_CHECK
 #define assert_octree_valid(x) x->validate()
@@ -206,6 +207,11 @@ public:
 		*this = rhs;
 	}
 
+	//groups come and go with their octree nodes, recycle them through
+	//size-bucketed free lists rather than the general heap
+	void* operator new(size_t size);
+	void operator delete(void* ptr, size_t size);
+
 	bool removeFromGroup(LLViewerOctreeEntryData* data);
 	bool removeFromGroup(LLViewerOctreeEntry* entry);
 
@@ -355,6 +361,7 @@ public:
 	U32              mPartitionType;
 	U32              mDrawableType;
 	OctreeNode*      mOctree;
+	OctreePool       mNodePool; // backing store for every node of mOctree except the root
 	LLViewerRegion*  mRegionp; // the region this partition belongs to.
 	BOOL             mOcclusionEnabled; // if TRUE, occlusion culling is performed
 	U32              mLODSeed;
@@ -465,61 +465,6 @@ LLPointer<LLViewerPartSourceScript> LLViewerPartSourceScript::unpackPSS(LLViewer
 }
 
 
-LLPointer<LLViewerPartSourceScript> LLViewerPartSourceScript::unpackPSS(LLViewerObject *source_objp, LLPointer<LLViewerPartSourceScript> pssp, LLDataPacker &dp, bool legacy)
-{
-	if (!pssp)
-	{
-		LLPointer<LLViewerPartSourceScript> new_pssp = new LLViewerPartSourceScript(source_objp);
-		if (legacy)
-		{
-			if (!new_pssp->mPartSysData.unpackLegacy(dp))
-			{
-				return NULL;
-			}
-		}
-		else
-		{
-			if (!new_pssp->mPartSysData.unpack(dp))
-			{
-				return NULL;
-			}
-		}
-		
-		if (new_pssp->mPartSysData.mTargetUUID.notNull())
-		{
-			LLViewerObject *target_objp = gObjectList.findObject(new_pssp->mPartSysData.mTargetUUID);
-			new_pssp->setTargetObject(target_objp);
-		}
-		
-		return new_pssp;
-	}
-	else
-	{
-		if (legacy)
-		{
-			if (!pssp->mPartSysData.unpackLegacy(dp))
-			{
-				return NULL;
-			}
-		}
-		else
-		{
-			if (!pssp->mPartSysData.unpack(dp))
-			{
-				return NULL;
-			}
-		}
-
-		if (pssp->mPartSysData.mTargetUUID.notNull())
-		{
-			LLViewerObject *target_objp = gObjectList.findObject(pssp->mPartSysData.mTargetUUID);
-			pssp->setTargetObject(target_objp);
-		}
-		return pssp;
-	}
-}
-
-
 /* static */
 LLPointer<LLViewerPartSourceScript> LLViewerPartSourceScript::createPSS(LLViewerObject *source_objp, const LLPartSysData& particle_parameters)
 {
@@ -535,6 +480,18 @@ LLPointer<LLViewerPartSourceScript> LLViewerPartSourceScript::createPSS(LLViewer
 	return new_pssp;
 }
 
+/* static */
+void LLViewerPartSourceScript::updatePSS(LLViewerPartSourceScript *pssp, const LLPartSysData& particle_parameters)
+{
+	pssp->mPartSysData = particle_parameters;
+
+	if (pssp->mPartSysData.mTargetUUID.notNull())
+	{
+		LLViewerObject *target_objp = gObjectList.findObject(pssp->mPartSysData.mTargetUUID);
+		pssp->setTargetObject(target_objp);
+	}
+}
+
 
 void LLViewerPartSourceScript::setImage(LLViewerTexture *imagep)
 {
@@ -38,6 +38,8 @@
 #include "llvoavatarself.h"
 #include "pipeline.h"
 #include "llviewercontrol.h"
+#include "llrender2dutils.h"
+#include "lltexlayercomposite.h"
 
 // runway consolidate
 extern std::string self_av_string();
@@ -157,6 +159,88 @@ void LLViewerTexLayerSetBuffer::postRenderTexLayerSet(BOOL success)
 	LLViewerDynamicTexture::postRender(success);
 }
 
+// virtual
+BOOL LLViewerTexLayerSetBuffer::render()
+{
+	static LLCachedControl<bool> software_bake(gSavedSettings, "PVRender_SoftwareBake");
+	if (software_bake || mSoftwareComposite.notNull())
+	{
+		return renderSoftwareComposite();
+	}
+	return renderTexLayerSet();
+}
+
+// Walks the layers into a composite and posts it, and on a later frame
+// once it's done draws what it made into the framebuffer for postRender()
+// to take, like renderTexLayerSet() would have.  Until then nothing is
+// copied and needsRender() keeps asking.  A walk that can't find all of
+// its pixels yet bakes with GL this time instead.  The pixels it asked for
+// are kept for the next bake, or until the texture list drops them as
+// unused.
+BOOL LLViewerTexLayerSetBuffer::renderSoftwareComposite()
+{
+	if (mSoftwareComposite.isNull())
+	{
+		LLPointer<LLTexLayerSetComposite> composite = new LLTexLayerSetComposite(getFullWidth(), getFullHeight());
+		if (!mTexLayerSet->paint(*composite))
+		{
+			return renderTexLayerSet();
+		}
+		mSoftwareComposite = composite;
+		mSoftwareComposite->post();
+	}
+
+	if (!mSoftwareComposite->isDone())
+	{
+		return FALSE;
+	}
+
+	LLPointer<LLTexLayerSetComposite> composite = mSoftwareComposite;
+	mSoftwareComposite = NULL;
+	composite->finish(mTexLayerSet);
+	composite->releaseRawImages();
+
+	LLPointer<LLViewerTexture> tex = LLViewerTextureManager::getLocalTexture(composite->getImage(), FALSE);
+
+	bool use_shaders = LLGLSLShader::sNoFixedFunction;
+	if (use_shaders)
+	{
+		gAlphaMaskProgram.bind();
+		gAlphaMaskProgram.setMinimumAlpha(0.f);
+	}
+	else
+	{
+		gGL.setAlphaRejectSettings(LLRender::CF_DEFAULT);
+	}
+
+	LLVertexBuffer::unbind();
+
+	{
+		LLGLSUIDefault gls_ui;
+		gGL.setColorMask(true, true);
+		gGL.setSceneBlendType(LLRender::BT_REPLACE);
+		gGL.color4f(1.f, 1.f, 1.f, 1.f);
+		gGL.getTexUnit(0)->bind(tex);
+		gl_rect_2d_simple_tex(getFullWidth(), getFullHeight());
+		gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
+		gGL.flush();
+	}
+
+	midRenderTexLayerSet(TRUE);
+
+	if (use_shaders)
+	{
+		gAlphaMaskProgram.unbind();
+	}
+
+	LLVertexBuffer::unbind();
+
+	// reset GL state
+	gGL.setSceneBlendType(LLRender::BT_ALPHA);
+
+	return TRUE;
+}
+
 // virtual
 void LLViewerTexLayerSetBuffer::midRenderTexLayerSet(BOOL success)
 {
@@ -31,6 +31,7 @@
 #include "llextendedstatus.h"
 #include "lltexlayer.h"
 
+class LLTexLayerSetComposite;
 class LLVOAvatarSelf;
 class LLViewerTexLayerSetBuffer;
 
@@ -111,7 +112,11 @@ protected:
 	// Pass these along for tex layer rendering.
 	virtual void			preRender(BOOL clear_depth) { preRenderTexLayerSet(); }
 	virtual void			postRender(BOOL success) { postRenderTexLayerSet(success); }
-	virtual BOOL			render() { return renderTexLayerSet(); }
+	virtual BOOL			render();
+private:
+	// LLTexLayerSetComposite instead of renderTexLayerSet(), over frames
+	BOOL					renderSoftwareComposite();
+	LLPointer<LLTexLayerSetComposite>	mSoftwareComposite;
 	
 	//--------------------------------------------------------------------
 	// Updates
@@ -355,6 +355,45 @@ class LLViewerTextureManagerBridge : public LLTextureManagerBridge
 	{
 		return LLViewerTextureManager::getFetchedTexture(image_id);
 	}
+
+	/*virtual*/ LLImageRaw* getRawImage(LLGLTexture* tex)
+	{
+		LLViewerFetchedTexture* fetched = LLViewerTextureManager::staticCastToFetchedTexture(tex);
+		if (!fetched)
+		{
+			return NULL;
+		}
+		if (!fetched->hasSavedRawImage())
+		{
+			if (!fetched->needsToSaveRawImage())
+			{
+				mKeptRawImages.insert(fetched->getID());
+			}
+			// saves the cached raw image right away if there is one
+			fetched->forceToSaveRawImage(0);
+			if (!fetched->hasSavedRawImage())
+			{
+				return NULL;
+			}
+		}
+		return fetched->getSavedRawImage();
+	}
+
+	/*virtual*/ void releaseRawImage(const LLUUID& image_id)
+	{
+		if (mKeptRawImages.erase(image_id))
+		{
+			LLViewerFetchedTexture* fetched = gTextureList.findImage(image_id, TEX_LIST_STANDARD);
+			if (fetched)
+			{
+				fetched->releaseSavedRawImage();
+			}
+		}
+	}
+
+private:
+	// the textures getRawImage() asked to keep their pixels
+	uuid_set_t mKeptRawImages;
 };
 
 
@@ -3120,6 +3159,20 @@ void LLViewerFetchedTexture::destroySavedRawImage()
 	}
 }
 
+void LLViewerFetchedTexture::releaseSavedRawImage()
+{
+	if(mSaveRawImage)
+	{
+		return; //loaded callbacks still want it.
+	}
+
+	mForceToSaveRawImage = FALSE ;
+	mSavedRawImage = NULL ;
+	mSavedRawDiscardLevel = -1 ;
+	mDesiredSavedRawDiscardLevel = -1 ;
+	mKeptSavedRawImageTime = 0.f ;
+}
+
 LLImageRaw* LLViewerFetchedTexture::getSavedRawImage() 
 {
 	mLastReferencedSavedRawImageTime = sCurrentTime;
@@ -568,6 +568,23 @@ public:
 			addText(xpos, ypos, llformat("%d Vertex Buffer Sets", LLVertexBuffer::sSetCount));
 			ypos += y_inc;
 
+			addText(xpos, ypos, llformat("VBO Pool %d/%d Stream %d/%d Dynamic Hit/Miss",
+				LLVertexBuffer::sStreamVBOPool.getHitCount() + LLVertexBuffer::sStreamIBOPool.getHitCount(),
+				LLVertexBuffer::sStreamVBOPool.getMissCount() + LLVertexBuffer::sStreamIBOPool.getMissCount(),
+				LLVertexBuffer::sDynamicVBOPool.getHitCount() + LLVertexBuffer::sDynamicIBOPool.getHitCount(),
+				LLVertexBuffer::sDynamicVBOPool.getMissCount() + LLVertexBuffer::sDynamicIBOPool.getMissCount()));
+			ypos += y_inc;
+
+			if (LLVertexBuffer::sStreamVBOPool.hasStreamRing())
+			{
+				addText(xpos, ypos, llformat("%d MB Streamed (%d/%d Ring Hit/Miss, %d Stalls)",
+					(S32) ((LLVertexBuffer::sStreamVBOPool.getStreamedBytes() + LLVertexBuffer::sStreamIBOPool.getStreamedBytes())/(1024*1024)),
+					LLVertexBuffer::sStreamVBOPool.getStreamHitCount() + LLVertexBuffer::sStreamIBOPool.getStreamHitCount(),
+					LLVertexBuffer::sStreamVBOPool.getStreamMissCount() + LLVertexBuffer::sStreamIBOPool.getStreamMissCount(),
+					LLVertexBuffer::sStreamVBOPool.getStreamStallCount() + LLVertexBuffer::sStreamIBOPool.getStreamStallCount()));
+				ypos += y_inc;
+			}
+
 			addText(xpos, ypos, llformat("%d Texture Binds", LLImageGL::sBindCount));
 			ypos += y_inc;
 
@@ -614,6 +631,17 @@ public:
 			
 			ypos += y_inc;
 
+			addText(xpos, ypos, llformat("%d/%d/%d/%d Avatars animated at 1/2/4/8 frames, %d evaluated, %d eased, %d deferred",
+				LLVOAvatar::sNumAnimatedAtRate[LLAnimationLOD::RATE_FULL],
+				LLVOAvatar::sNumAnimatedAtRate[LLAnimationLOD::RATE_HALF],
+				LLVOAvatar::sNumAnimatedAtRate[LLAnimationLOD::RATE_QUARTER],
+				LLVOAvatar::sNumAnimatedAtRate[LLAnimationLOD::RATE_EIGHTH],
+				LLVOAvatar::sNumAnimationsEvaluated,
+				LLVOAvatar::sNumAnimationsInterpolated,
+				LLVOAvatar::sNumAnimationsDeferred));
+
+			ypos += y_inc;
+
 			addText(xpos,ypos, llformat("%d Lights visible", LLPipeline::sVisibleLightCount));
 			
 			ypos += y_inc;
@@ -1787,6 +1815,7 @@ LLViewerWindow::LLViewerWindow(const Params& p)
 	{
 		gSavedSettings.setBOOL("RenderVBOEnable", FALSE);
 	}
+	LLVertexBuffer::sStreamRingSize = gSavedSettings.getU32("PVRender_StreamRingSize")*1024*1024;
 	LLVertexBuffer::initClass(gSavedSettings.getBOOL("RenderVBOEnable"), gSavedSettings.getBOOL("RenderVBOMappingDisable"));
 	LL_INFOS("RenderInit") << "LLVertexBuffer initialization done." << LL_ENDL ;
 	gGL.init() ;
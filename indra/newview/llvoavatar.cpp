@@ -66,6 +66,7 @@
 #include "llkeyframewalkmotion.h"
 #include "llmanipscale.h"  // for get_default_max_prim_scale()
 #include "llmeshrepository.h"
+#include "llmotionevaluator.h"
 #include "llmutelist.h"
 #include "llmoveview.h"
 #include "llnotificationsutil.h"
@@ -609,6 +610,16 @@ F32 LLVOAvatar::sUnbakedTime = 0.f;
 F32 LLVOAvatar::sUnbakedUpdateTime = 0.f;
 F32 LLVOAvatar::sGreyTime = 0.f;
 F32 LLVOAvatar::sGreyUpdateTime = 0.f;
+LLMotionEvaluator* LLVOAvatar::sMotionEvaluator = NULL;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sQueuedAnimations;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sQueuedIdleUpdates;
+S32 LLVOAvatar::sNumAnimatedAtRate[LLAnimationLOD::NUM_RATES] = { 0, 0, 0, 0 };
+S32 LLVOAvatar::sNumAnimationsEvaluated = 0;
+S32 LLVOAvatar::sNumAnimationsInterpolated = 0;
+S32 LLVOAvatar::sNumAnimationsDeferred = 0;
+S32 LLVOAvatar::sAnimatedAtRate[LLAnimationLOD::NUM_RATES] = { 0, 0, 0, 0 };
+S32 LLVOAvatar::sAnimationsInterpolated = 0;
+LLAnimationLOD::Budget LLVOAvatar::sAnimationBudget;
 
 //-----------------------------------------------------------------------------
 // Helper functions
@@ -623,6 +634,12 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 					   LLViewerRegion* regionp) :
 	LLAvatarAppearance(&gAgentWearables),
 	LLViewerObject(id, pcode, regionp),
+	mQueuedUpdateType(LLCharacter::NORMAL_UPDATE),
+	mIdleDetailedUpdate(FALSE),
+	mIdleVoiceEnabled(false),
+	mIdleNameTag(false),
+	mIdleNewName(FALSE),
+	mWasSitGroundConstrained(false),
 	mSpecialRenderMode(0),
 	mAttachmentSurfaceArea(0.f),
 	mReportedVisualComplexity(VISUAL_COMPLEXITY_UNKNOWN),
@@ -676,6 +693,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mVisualComplexity(VISUAL_COMPLEXITY_UNKNOWN),
 	mLoadedCallbacksPaused(FALSE),
 	mRenderUnloadedAvatar(LLCachedControl<bool>(gSavedSettings, "RenderUnloadedAvatar", false)),
+	mShowMyComplexityChanges(LLCachedControl<U32>(gSavedSettings, "ShowMyComplexityChanges", 20)),
 	mLastRezzedStatus(-1),
 	mIsEditingAppearance(FALSE),
 	mUseLocalAppearance(FALSE),
@@ -1121,6 +1139,192 @@ void LLVOAvatar::cleanupClass()
 {
 }
 
+//static
+void LLVOAvatar::startAnimationThreads(U32 threads)
+{
+	stopAnimationThreads();
+	if (threads)
+	{
+		sMotionEvaluator = new LLMotionEvaluator(threads);
+		LL_INFOS() << "Evaluating avatar animations on " << threads << " threads" << LL_ENDL;
+	}
+}
+
+//static
+void LLVOAvatar::stopAnimationThreads()
+{
+	// nothing is queued outside of LLViewerObjectList::update()
+	llassert(sQueuedAnimations.empty());
+	llassert(sQueuedIdleUpdates.empty());
+	delete sMotionEvaluator;
+	sMotionEvaluator = NULL;
+}
+
+static LLTrace::BlockTimerStatHandle FTM_QUEUED_ANIMATIONS("Queued Avatar Animations");
+
+//static
+void LLVOAvatar::updateQueuedAnimations()
+{
+	if (sQueuedAnimations.empty())
+	{
+		return;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_QUEUED_ANIMATIONS);
+
+	static std::vector<LLCharacter*> characters;
+	characters.clear();
+	for (U32 i = 0; i < sQueuedAnimations.size(); ++i)
+	{
+		characters.push_back(sQueuedAnimations[i]);
+	}
+
+	F64 start = LLTimer::getTotalSeconds();
+	if (sMotionEvaluator)
+	{
+		sMotionEvaluator->evaluate(characters);
+	}
+	else
+	{
+		for (U32 i = 0; i < characters.size(); ++i)
+		{
+			characters[i]->evaluateMotions();
+		}
+	}
+	sAnimationBudget.addCost(LLTimer::getTotalSeconds() - start, characters.size());
+
+	// back on the main thread, in queue order
+	for (U32 i = 0; i < sQueuedAnimations.size(); ++i)
+	{
+		LLVOAvatar* avatarp = sQueuedAnimations[i];
+		avatarp->commitMotions();
+		if (!avatarp->isDead())
+		{
+			avatarp->endAnimationPose();
+			avatarp->finishIdleUpdate(avatarp->endCharacterUpdate(avatarp->mQueuedUpdateType));
+		}
+	}
+	sQueuedAnimations.clear();
+}
+
+static void idle_update_independent(LLCharacter* character)
+{
+	((LLVOAvatar*)character)->idleUpdateIndependent();
+}
+
+static LLTrace::BlockTimerStatHandle FTM_QUEUED_IDLE_UPDATES("Queued Avatar Idle Updates");
+
+//static
+void LLVOAvatar::updateQueuedIdleUpdates()
+{
+	if (sQueuedIdleUpdates.empty())
+	{
+		return;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_QUEUED_IDLE_UPDATES);
+
+	static std::vector<LLCharacter*> characters;
+	characters.clear();
+	for (U32 i = 0; i < sQueuedIdleUpdates.size(); ++i)
+	{
+		LLVOAvatar* avatarp = sQueuedIdleUpdates[i];
+		if (!avatarp->isDead())
+		{
+			characters.push_back(avatarp);
+		}
+	}
+
+	// each avatar only writes its own state
+	if (sMotionEvaluator)
+	{
+		sMotionEvaluator->run(characters, idle_update_independent);
+	}
+	else
+	{
+		for (U32 i = 0; i < characters.size(); ++i)
+		{
+			idle_update_independent(characters[i]);
+		}
+	}
+
+	// back on the main thread, in queue order
+	for (U32 i = 0; i < characters.size(); ++i)
+	{
+		((LLVOAvatar*)characters[i])->commitIdleUpdate();
+	}
+	sQueuedIdleUpdates.clear();
+}
+
+static void apply_morphs(LLCharacter* character)
+{
+	((LLVOAvatar*)character)->applyMorphs();
+}
+
+static LLTrace::BlockTimerStatHandle FTM_QUEUED_MORPHS("Queued Avatar Morphs");
+
+//static
+void LLVOAvatar::applyQueuedMorphs()
+{
+	static std::vector<LLCharacter*> characters;
+	characters.clear();
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		LLVOAvatar* avatarp = (LLVOAvatar*)*iter;
+		if (avatarp->hasQueuedMorphs())
+		{
+			characters.push_back(avatarp);
+		}
+	}
+	if (characters.empty())
+	{
+		return;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_QUEUED_MORPHS);
+
+	// each avatar only writes its own meshes
+	if (sMotionEvaluator)
+	{
+		sMotionEvaluator->run(characters, apply_morphs);
+	}
+	else
+	{
+		for (U32 i = 0; i < characters.size(); ++i)
+		{
+			apply_morphs(characters[i]);
+		}
+	}
+}
+
+// virtual
+bool LLVOAvatar::isMorphingDeferred() const
+{
+	// the agent's own avatar and previews rebuild their meshes right away
+	return !isSelf() && !mIsDummy;
+}
+
+//static
+void LLVOAvatar::startAnimationFrame()
+{
+	static LLCachedControl<F32> budget_ms(gSavedSettings, "PVRender_AnimationBudget", 2.f);
+
+	for (S32 i = 0; i < LLAnimationLOD::NUM_RATES; ++i)
+	{
+		sNumAnimatedAtRate[i] = sAnimatedAtRate[i];
+		sAnimatedAtRate[i] = 0;
+	}
+	sNumAnimationsEvaluated = sAnimationBudget.mEvaluated;
+	sNumAnimationsInterpolated = sAnimationsInterpolated;
+	sNumAnimationsDeferred = sAnimationBudget.mDeferred;
+	sAnimationsInterpolated = 0;
+	sAnimationBudget.startFrame();
+	sAnimationBudget.mLimit = budget_ms * 0.001f;
+
+	LLPhysicsMotionController::updateEnabled();
+}
+
 // virtual
 void LLVOAvatar::initInstance(void)
 {
@@ -2377,8 +2581,66 @@ void LLVOAvatar::idleUpdate(LLAgent &agent, const F64 &time)
 	// animate the character
 	// store off last frame's root position to be consistent with camera position
 	mLastRootPos = mRoot->getWorldPosition();
-	BOOL detailed_update = updateCharacter(agent);
 
+	// Your own avatar stays on the serial path, its motions drive the agent.
+	if (sMotionEvaluator && !isSelf())
+	{
+		LLCharacter::e_update_t update_type;
+		if (!beginCharacterUpdate(agent, update_type))
+		{
+			finishIdleUpdate(FALSE);
+			return;
+		}
+
+		if (!isAnimationDue(update_type))
+		{
+			interpolateAnimationPose();
+			finishIdleUpdate(endCharacterUpdate(update_type));
+			return;
+		}
+
+		beginAnimationPose();
+		if (prepareMotions(update_type))
+		{
+			// finished by updateQueuedAnimations()
+			mQueuedUpdateType = update_type;
+			sQueuedAnimations.push_back(this);
+		}
+		else
+		{
+			endAnimationPose();
+			finishIdleUpdate(endCharacterUpdate(update_type));
+		}
+		return;
+	}
+
+	finishIdleUpdate(updateCharacter(agent));
+}
+
+//------------------------------------------------------------------------
+// finishIdleUpdate()
+// the part of idleUpdate() that needs the animated skeleton
+//------------------------------------------------------------------------
+void LLVOAvatar::finishIdleUpdate(BOOL detailed_update)
+{
+	beginIdleUpdate(detailed_update);
+
+	// Your own avatar stays on the serial path, like its animation.
+	if (sMotionEvaluator && !isSelf())
+	{
+		// finished by updateQueuedIdleUpdates()
+		sQueuedIdleUpdates.push_back(this);
+		return;
+	}
+
+	idleUpdateIndependent();
+	commitIdleUpdate();
+}
+
+// Pipeline, HUD object, particle and voice client updates, in the same
+// order as always relative to other objects' idle updates.
+void LLVOAvatar::beginIdleUpdate(BOOL detailed_update)
+{
 	static LLUICachedControl<bool> visualizers_in_calls("ShowVoiceVisualizersInCalls", false);
 	bool voice_enabled = (visualizers_in_calls || LLVoiceClient::getInstance()->inProximalChannel()) &&
 						 LLVoiceClient::getInstance()->getVoiceEnabled(mID);
@@ -2388,16 +2650,50 @@ void LLVOAvatar::idleUpdate(LLAgent &agent, const F64 &time)
 	idleUpdateAppearanceAnimation();
 	if (detailed_update)
 	{
-		idleUpdateLipSync( voice_enabled );
+		// lip sync needs to know now whether this one is speaking
+		voice_enabled = voice_enabled && LLVoiceClient::getInstance()->lipSyncEnabled() &&
+						LLVoiceClient::getInstance()->getIsSpeaking(mID);
 		idleUpdateLoadingEffect();
 		idleUpdateBelowWater();	// wind effect uses this
+	}
+
+	mIdleDetailedUpdate = detailed_update;
+	mIdleVoiceEnabled = voice_enabled;
+	mIdleNameTag = idleUpdateNameTag();
+}
+
+// Only reads shared state; the main thread doesn't change any while this
+// runs on the animation threads.
+void LLVOAvatar::idleUpdateIndependent()
+{
+	if (mIdleDetailedUpdate)
+	{
+		idleUpdateLipSync( mIdleVoiceEnabled );
 		idleUpdateWindEffect();
 	}
-		
-	idleUpdateNameTag( mLastRootPos );
+
+	if (mIdleNameTag)
+	{
+		idleUpdateNameTagPosition( mLastRootPos );
+	}
 	idleUpdateRenderComplexity();
 }
 
+// Name tag and debug text, which go through UI singletons.
+void LLVOAvatar::commitIdleUpdate()
+{
+	if (mIdleNameTag && mNameText)
+	{
+		idleUpdateNameTagText( mIdleNewName );
+		// Wolfspirit: Following thing is already handled in LLHUDNameTag::lineSegmentIntersect
+		// Fixing bubblechat alpha flashing with commenting this out.
+		// idleUpdateNameTagAlpha(mIdleNewName, alpha);
+	}
+	mIdleNameTag = false;
+
+	idleUpdateRenderComplexityText();
+}
+
 void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
 {
 	bool render_visualizer = voice_enabled;
@@ -2710,10 +3006,14 @@ F32 LLVOAvatar::calcMorphAmount()
 	return morph_amt;
 }
 
+// voice_enabled is whether this one is speaking with lip sync on, which
+// beginIdleUpdate() asks the voice client.  The lip sync params only
+// drive this avatar's morphs, queued by LLPolyMorph::apply() for
+// applyQueuedMorphs().
 void LLVOAvatar::idleUpdateLipSync(bool voice_enabled)
 {
 	// Use the Lipsync_Ooh and Lipsync_Aah morphs for lip sync
-	if ( voice_enabled && (LLVoiceClient::getInstance()->lipSyncEnabled()) && LLVoiceClient::getInstance()->getIsSpeaking( mID ) )
+	if ( voice_enabled )
 	{
 		F32 ooh_morph_amount = 0.0f;
 		F32 aah_morph_amount = 0.0f;
@@ -2877,7 +3177,7 @@ void LLVOAvatar::idleUpdateWindEffect()
 	}
 }
 
-void LLVOAvatar::idleUpdateNameTag(const LLVector3& root_pos_last)
+bool LLVOAvatar::idleUpdateNameTag()
 {
 	// update chat bubble
 	//--------------------------------------------------------------------
@@ -2941,7 +3241,7 @@ void LLVOAvatar::idleUpdateNameTag(const LLVector3& root_pos_last)
 			mNameText = NULL;
 			sNumVisibleChatBubbles--;
 		}
-		return;
+		return false;
 	}
 
 	BOOL new_name = FALSE;
@@ -3003,7 +3303,7 @@ void LLVOAvatar::idleUpdateNameTag(const LLVector3& root_pos_last)
 			mNameText = NULL;
 			sNumVisibleChatBubbles--;
 		}
-		return;
+		return false;
 	}
 
 	if (!mNameText)
@@ -3019,13 +3319,10 @@ void LLVOAvatar::idleUpdateNameTag(const LLVector3& root_pos_last)
 		sNumVisibleChatBubbles++;
 		new_name = TRUE;
     }
-				
-	idleUpdateNameTagPosition(root_pos_last);
-	idleUpdateNameTagText(new_name);			
-	// Wolfspirit: Following thing is already handled in LLHUDNameTag::lineSegmentIntersect
-	// Fixing bubblechat alpha flashing with commenting this out.
-	// idleUpdateNameTagAlpha(new_name, alpha);
 
+	// position and text follow, in idleUpdateIndependent() and commitIdleUpdate()
+	mIdleNewName = new_name;
+	return true;
 }
 
 void LLVOAvatar::idleUpdateNameTagText(BOOL new_name)
@@ -3521,7 +3818,7 @@ void LLVOAvatar::slamPosition()
 	{
 		gPipeline.updateMoveNormalAsync(mDrawable);
 	}
-	mRoot->updateWorldMatrixChildren();
+	updateWorldMatrices();
 }
 
 bool LLVOAvatar::isVisuallyMuted()
@@ -3704,11 +4001,85 @@ void LLVOAvatar::updateDebugText()
 //------------------------------------------------------------------------
 BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 {	
+	LLCharacter::e_update_t update_type;
+	if (!beginCharacterUpdate(agent, update_type))
+	{
+		return FALSE;
+	}
+
+	if (!isAnimationDue(update_type))
+	{
+		interpolateAnimationPose();
+		return endCharacterUpdate(update_type);
+	}
+
+	beginAnimationPose();
+	F64 start = LLTimer::getTotalSeconds();
+	updateMotions(update_type);
+	if (update_type == LLCharacter::NORMAL_UPDATE)
+	{
+		sAnimationBudget.addCost(LLTimer::getTotalSeconds() - start, 1);
+	}
+	endAnimationPose();
+
+	return endCharacterUpdate(update_type);
+}
+
+//------------------------------------------------------------------------
+// isAnimationDue()
+// whether a character update evaluates the motions this frame or eases
+// the skeleton toward the last pose they set
+//------------------------------------------------------------------------
+bool LLVOAvatar::isAnimationDue(LLCharacter::e_update_t update_type)
+{
+	if (update_type != LLCharacter::NORMAL_UPDATE || mUpdatePeriod > 1)
+	{
+		// hidden, preview and impostor updates keep their own pace
+		mAnimationLOD.setRate(LLAnimationLOD::RATE_FULL);
+		return true;
+	}
+
+	sAnimatedAtRate[mAnimationLOD.getRate()]++;
+	return mAnimationLOD.isDue(LLDrawable::getCurrentFrame(), mSkeleton.size(), sAnimationBudget);
+}
+
+//------------------------------------------------------------------------
+// beginAnimationPose()
+//------------------------------------------------------------------------
+void LLVOAvatar::beginAnimationPose()
+{
+	mAnimationLOD.beginPose(mSkeleton);
+}
+
+//------------------------------------------------------------------------
+// endAnimationPose()
+//------------------------------------------------------------------------
+void LLVOAvatar::endAnimationPose()
+{
+	mAnimationLOD.endPose(mSkeleton, LLDrawable::getCurrentFrame(), mID.mData[0]);
+}
+
+//------------------------------------------------------------------------
+// interpolateAnimationPose()
+//------------------------------------------------------------------------
+void LLVOAvatar::interpolateAnimationPose()
+{
+	sAnimationsInterpolated++;
+	mAnimationLOD.interpolatePose(mSkeleton, LLDrawable::getCurrentFrame());
+}
+
+//------------------------------------------------------------------------
+// beginCharacterUpdate()
+// updateCharacter() up to updating the motions, returns false if the
+// character isn't animated at all
+//------------------------------------------------------------------------
+bool LLVOAvatar::beginCharacterUpdate(LLAgent &agent, LLCharacter::e_update_t& update_type)
+{
 	updateDebugText();
 	
 	if (!mIsBuilt)
 	{
-		return FALSE;
+		return false;
 	}
 
 	BOOL visible = isVisible();
@@ -3776,8 +4147,8 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// even when your avatar is offscreen
 	if (!visible && !isSelf())
 	{
-		updateMotions(LLCharacter::HIDDEN_UPDATE);
-		return FALSE;
+		update_type = LLCharacter::HIDDEN_UPDATE;
+		return true;
 	}
 
 	// <FS:Zi> Optionally disable the usage of timesteps, testing if this affects performance or
@@ -4083,19 +4454,33 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	//-------------------------------------------------------------------------
 	// store data relevant to motions
 	mSpeed = speed;
+	mWasSitGroundConstrained = was_sit_ground_constrained;
 
 	// update animations
 	if (mSpecialRenderMode == 1) // Animation Preview
 	{
-		updateMotions(LLCharacter::FORCE_UPDATE);
+		update_type = LLCharacter::FORCE_UPDATE;
 	}
 	else
 	{
-		updateMotions(LLCharacter::NORMAL_UPDATE);
+		update_type = LLCharacter::NORMAL_UPDATE;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------
+// endCharacterUpdate()
+// the rest of updateCharacter(), once the motions are updated
+//------------------------------------------------------------------------
+BOOL LLVOAvatar::endCharacterUpdate(LLCharacter::e_update_t update_type)
+{
+	if (update_type == LLCharacter::HIDDEN_UPDATE)
+	{
+		return FALSE;
 	}
 
 	// Special handling for sitting on ground.
-	if (!getParent() && (mIsSitting || was_sit_ground_constrained))
+	if (!getParent() && (mIsSitting || mWasSitGroundConstrained))
 	{
 		
 		F32 off_z = LLVector3d(getHoverOffset()).mdV[VZ];
@@ -4121,6 +4506,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 
 	LLVector3 ankle_left_ground_agent = ankle_left_pos_agent;
 	LLVector3 ankle_right_ground_agent = ankle_right_pos_agent;
+	LLVector3 normal;
 	resolveHeightAgent(ankle_left_pos_agent, ankle_left_ground_agent, normal);
 	resolveHeightAgent(ankle_right_pos_agent, ankle_right_ground_agent, normal);
 
@@ -4190,7 +4576,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		}
 	}
 
-	mRoot->updateWorldMatrixChildren();
+	updateWorldMatrices();
 
 	//mesh vertices need to be reskinned
 	mNeedsSkin = TRUE;
@@ -4293,7 +4679,7 @@ void LLVOAvatar::debugBodySize() const
 //------------------------------------------------------------------------
 void LLVOAvatar::postPelvisSetRecalc()
 {		
-	mRoot->updateWorldMatrixChildren();			
+	updateWorldMatrices();			
 	computeBodySize();
 	dirtyMesh(2);
 }
@@ -4438,6 +4824,24 @@ void LLVOAvatar::updateVisibility()
         LL_DEBUGS("AvatarRender") << "visible was " << mVisible << " now " << visible << LL_ENDL;
     }
 	mVisible = visible;
+
+	updateAnimationRate(visible);
+}
+
+//------------------------------------------------------------------------
+// updateAnimationRate()
+//------------------------------------------------------------------------
+void LLVOAvatar::updateAnimationRate(BOOL visible)
+{
+	static LLCachedControl<bool> animation_lod(gSavedSettings, "PVRender_AnimationLOD", true);
+
+	if (!animation_lod || !visible || isSelf() || mIsDummy || mDrawable.isNull())
+	{
+		mAnimationLOD.setRate(LLAnimationLOD::RATE_FULL);
+		return;
+	}
+
+	mAnimationLOD.setRate(LLAnimationLOD::selectRate(mPixelArea, mDrawable->mDistanceWRTCamera));
 }
 
 // private
@@ -6334,6 +6738,13 @@ void LLVOAvatar::initAttachmentPoints(bool ignore_hud_joints)
 //-----------------------------------------------------------------------------
 void LLVOAvatar::updateVisualParams()
 {
+	if (mMotionController.deferVisualParamUpdate())
+	{
+		// called by a motion on an animation thread, commitMotions() gets
+		// back to it
+		return;
+	}
+
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
 	LLCharacter::updateVisualParams();
@@ -6342,7 +6753,7 @@ void LLVOAvatar::updateVisualParams()
 	{
 		computeBodySize();
 		mLastSkeletonSerialNum = mSkeletonSerialNum;
-		mRoot->updateWorldMatrixChildren();
+		updateWorldMatrices();
 	}
 
 	dirtyMesh();
@@ -6666,7 +7077,8 @@ const LLViewerJointAttachment *LLVOAvatar::attachObject(LLViewerObject *viewer_o
 		return 0;
 	}
 
-	updateVisualComplexity();
+	// costed on the next complexity update
+	mAttachmentComplexity.add(viewer_object);
 
 	if (viewer_object->isSelected())
 	{
@@ -6842,7 +7254,8 @@ BOOL LLVOAvatar::detachObject(LLViewerObject *viewer_object)
 		if (attachment && attachment->isObjectAttached(viewer_object))
 		// </FS:Ansariel>
 		{
-            updateVisualComplexity();
+			mAttachmentComplexity.remove(viewer_object);
+
 			cleanupAttachedMesh( viewer_object );
 		
 			attachment->removeObject(viewer_object);
@@ -6931,7 +7344,7 @@ void LLVOAvatar::sitOnObject(LLViewerObject *sit_object)
 	mRoot->getXform()->setParent(&sit_object->mDrawable->mXform); // LLVOAvatar::sitOnObject
 	// SL-315
 	mRoot->setPosition(getPosition());
-	mRoot->updateWorldMatrixChildren();
+	updateWorldMatrices();
 
 	stopMotion(ANIM_AGENT_BODY_NOISE);
 
@@ -9307,7 +9720,10 @@ void LLVOAvatar::idleUpdateRenderComplexity()
 {
     // Render Complexity
     calculateUpdateRenderComplexity(); // Update mVisualComplexity if needed	
+}
 
+void LLVOAvatar::idleUpdateRenderComplexityText()
+{
 	if (gPipeline.hasRenderDebugMask(LLPipeline::RENDER_DEBUG_AVATAR_DRAW_INFO))
 	{
 		std::string info_line;
@@ -9397,6 +9813,136 @@ void LLVOAvatar::updateVisualComplexity()
 	mVisualComplexityStale = true;
 }
 
+void LLVOAvatar::updateAttachmentComplexity(LLViewerObject* object)
+{
+	// costs are kept by the root of the attached linkset
+	mAttachmentComplexity.invalidate(object->getRootEdit());
+}
+
+// What one attached linkset adds to the complexity, or to your HUD
+// complexity, the way calculateUpdateRenderComplexity() always costed it.
+void LLVOAvatar::calculateAttachmentComplexity(LLViewerObject* attached_object, LLAttachmentComplexity::Entry& complexity)
+{
+	LLVOVolume::texture_cost_t textures;
+	if (!attached_object->isHUDAttachment())
+	{
+		const LLDrawable* drawable = attached_object->mDrawable;
+		if (drawable)
+		{
+			const LLVOVolume* volume = drawable->getVOVolume();
+			if (volume)
+			{
+				U32 attachment_total_cost = 0;
+				U32 attachment_volume_cost = 0;
+				U32 attachment_texture_cost = 0;
+				U32 attachment_children_cost = 0;
+
+				attachment_volume_cost += volume->getRenderCost(textures);
+
+				const_child_list_t children = volume->getChildren();
+				for (const_child_list_t::const_iterator child_iter = children.begin();
+					  child_iter != children.end();
+					  ++child_iter)
+				{
+					LLViewerObject* child_obj = *child_iter;
+					LLVOVolume *child = dynamic_cast<LLVOVolume*>( child_obj );
+					if (child)
+					{
+						attachment_children_cost += child->getRenderCost(textures);
+					}
+				}
+
+				for (LLVOVolume::texture_cost_t::iterator volume_texture = textures.begin();
+					 volume_texture != textures.end();
+					 ++volume_texture)
+				{
+					// add the cost of each individual texture in the linkset
+					attachment_texture_cost += volume_texture->second;
+				}
+
+				attachment_total_cost = attachment_volume_cost + attachment_texture_cost + attachment_children_cost;
+				LL_DEBUGS("ARCdetail") << "Attachment costs " << attached_object->getAttachmentItemID()
+									   << " total: " << attachment_total_cost
+									   << ", volume: " << attachment_volume_cost
+									   << ", textures: " << attachment_texture_cost
+									   << ", " << volume->numChildren()
+									   << " children: " << attachment_children_cost
+									   << LL_ENDL;
+				complexity.mCost = attachment_total_cost;
+			}
+		}
+	}
+	else if (isSelf()
+		&& !attached_object->isTempAttachment()
+		&& attached_object->mDrawable)
+	{
+		const LLVOVolume* volume = attached_object->mDrawable->getVOVolume();
+		if (volume)
+		{
+			LLHUDComplexity& hud_object_complexity = complexity.mHUD;
+			hud_object_complexity.objectName = attached_object->getAttachmentItemName();
+			hud_object_complexity.objectId = attached_object->getAttachmentItemID();
+			std::string joint_name;
+			gAgentAvatarp->getAttachedPointName(attached_object->getAttachmentItemID(), joint_name);
+			hud_object_complexity.jointName = joint_name;
+			// get cost and individual textures
+			hud_object_complexity.objectsCost += volume->getRenderCost(textures);
+			hud_object_complexity.objectsCount++;
+
+			LLViewerObject::const_child_list_t& child_list = attached_object->getChildren();
+			for (LLViewerObject::child_list_t::const_iterator iter = child_list.begin();
+				iter != child_list.end(); ++iter)
+			{
+				LLViewerObject* childp = *iter;
+				const LLVOVolume* chld_volume = dynamic_cast<LLVOVolume*>(childp);
+				if (chld_volume)
+				{
+					// get cost and individual textures
+					hud_object_complexity.objectsCost += chld_volume->getRenderCost(textures);
+					hud_object_complexity.objectsCount++;
+				}
+			}
+
+			hud_object_complexity.texturesCount += textures.size();
+
+			for (LLVOVolume::texture_cost_t::iterator volume_texture = textures.begin();
+				volume_texture != textures.end();
+				++volume_texture)
+			{
+				// add the cost of each individual texture (ignores duplicates)
+				hud_object_complexity.texturesCost += volume_texture->second;
+				LLViewerFetchedTexture *tex = LLViewerTextureManager::getFetchedTexture(volume_texture->first);
+				if (tex)
+				{
+					// Note: Texture memory might be incorect since texture might be still loading.
+					hud_object_complexity.texturesMemoryTotal += tex->getTextureMemory();
+					if (tex->getOriginalHeight() * tex->getOriginalWidth() >= HUD_OVERSIZED_TEXTURE_DATA_SIZE)
+					{
+						hud_object_complexity.largeTexturesCount++;
+					}
+				}
+			}
+			complexity.mHasHUD = true;
+		}
+	}
+
+	// Diagnostic output to identify all avatar-related textures.
+	// Does not affect rendering cost calculation.
+	// Could be wrapped in a debug option if output becomes problematic.
+	if (isSelf())
+	{
+		// print the textures of this linkset, each once
+		for (LLVOVolume::texture_cost_t::iterator it = textures.begin(); it != textures.end(); ++it)
+		{
+			LLUUID image_id = it->first;
+			if( ! (image_id.isNull() || image_id == IMG_DEFAULT || image_id == IMG_DEFAULT_AVATAR))
+			{
+				LL_DEBUGS("ARCdetail") << "attachment_texture: " << image_id.asString() << LL_ENDL;
+			}
+		}
+	}
+}
+
 // Calculations for mVisualComplexity value
 void LLVOAvatar::calculateUpdateRenderComplexity()
 {
@@ -9408,31 +9954,15 @@ void LLVOAvatar::calculateUpdateRenderComplexity()
      *****************************************************************/
 	static const U32 COMPLEXITY_BODY_PART_COST = 200;
 
-	// Diagnostic list of all textures on our avatar
-	static std::set<LLUUID> all_textures;
+	if (!mVisualComplexityStale && !mAttachmentComplexity.needsUpdate())
+	{
+		return;
+	}
 
 	if (mVisualComplexityStale)
 	{
-		U32 cost = VISUAL_COMPLEXITY_UNKNOWN;
-		LLVOVolume::texture_cost_t textures;
-		hud_complexity_list_t hud_complexity_list;
-
-		for (U8 baked_index = 0; baked_index < BAKED_NUM_INDICES; baked_index++)
-		{
-		    const LLAvatarAppearanceDictionary::BakedEntry *baked_dict
-				= LLAvatarAppearanceDictionary::getInstance()->getBakedTexture((EBakedTextureIndex)baked_index);
-			ETextureIndex tex_index = baked_dict->mTextureIndex;
-			if ((tex_index != TEX_SKIRT_BAKED) || (isWearingWearableType(LLWearableType::WT_SKIRT)))
-			{
-				if (isTextureVisible(tex_index))
-				{
-					cost +=COMPLEXITY_BODY_PART_COST;
-				}
-			}
-		}
-        LL_DEBUGS("ARCdetail") << "Avatar body parts complexity: " << cost << LL_ENDL;
-
-
+		// cost every attachment again
+		mAttachmentComplexity.clear();
 		for (attachment_map_t::const_iterator attachment_point = mAttachmentPoints.begin(); 
 			 attachment_point != mAttachmentPoints.end();
 			 ++attachment_point)
@@ -9450,182 +9980,100 @@ void LLVOAvatar::calculateUpdateRenderComplexity()
 				 attachment_iter != attachment->mAttachedObjects.end();
 				 ++attachment_iter)
 			{
-				const LLViewerObject* attached_object = (*attachment_iter);
-				if (attached_object && !attached_object->isHUDAttachment())
+				LLViewerObject* attached_object = (*attachment_iter);
+				if (attached_object)
 				{
-					textures.clear();
-					const LLDrawable* drawable = attached_object->mDrawable;
-					if (drawable)
-					{
-						const LLVOVolume* volume = drawable->getVOVolume();
-						if (volume)
-						{
-                            U32 attachment_total_cost = 0;
-                            U32 attachment_volume_cost = 0;
-                            U32 attachment_texture_cost = 0;
-                            U32 attachment_children_cost = 0;
-
-							attachment_volume_cost += volume->getRenderCost(textures);
-
-							const_child_list_t children = volume->getChildren();
-							for (const_child_list_t::const_iterator child_iter = children.begin();
-								  child_iter != children.end();
-								  ++child_iter)
-							{
-								LLViewerObject* child_obj = *child_iter;
-								LLVOVolume *child = dynamic_cast<LLVOVolume*>( child_obj );
-								if (child)
-								{
-									attachment_children_cost += child->getRenderCost(textures);
-								}
-							}
-
-							for (LLVOVolume::texture_cost_t::iterator volume_texture = textures.begin();
-								 volume_texture != textures.end();
-								 ++volume_texture)
-							{
-								// add the cost of each individual texture in the linkset
-								attachment_texture_cost += volume_texture->second;
-							}
-
-                            attachment_total_cost = attachment_volume_cost + attachment_texture_cost + attachment_children_cost;
-                            LL_DEBUGS("ARCdetail") << "Attachment costs " << attached_object->getAttachmentItemID()
-                                                   << " total: " << attachment_total_cost
-                                                   << ", volume: " << attachment_volume_cost
-                                                   << ", textures: " << attachment_texture_cost
-                                                   << ", " << volume->numChildren()
-                                                   << " children: " << attachment_children_cost
-                                                   << LL_ENDL;
-                            cost += attachment_total_cost;
-						}
-					}
+					mAttachmentComplexity.add(attached_object);
 				}
-                if (isSelf()
-                    && attached_object
-                    && attached_object->isHUDAttachment()
-                    && !attached_object->isTempAttachment()
-                    && attached_object->mDrawable)
-                {
-                    textures.clear();
-
-                    const LLVOVolume* volume = attached_object->mDrawable->getVOVolume();
-                    if (volume)
-                    {
-                        LLHUDComplexity hud_object_complexity;
-                        hud_object_complexity.objectName = attached_object->getAttachmentItemName();
-                        hud_object_complexity.objectId = attached_object->getAttachmentItemID();
-                        std::string joint_name;
-                        gAgentAvatarp->getAttachedPointName(attached_object->getAttachmentItemID(), joint_name);
-                        hud_object_complexity.jointName = joint_name;
-                        // get cost and individual textures
-                        hud_object_complexity.objectsCost += volume->getRenderCost(textures);
-                        hud_object_complexity.objectsCount++;
-
-                        LLViewerObject::const_child_list_t& child_list = attached_object->getChildren();
-                        for (LLViewerObject::child_list_t::const_iterator iter = child_list.begin();
-                            iter != child_list.end(); ++iter)
-                        {
-                            LLViewerObject* childp = *iter;
-                            const LLVOVolume* chld_volume = dynamic_cast<LLVOVolume*>(childp);
-                            if (chld_volume)
-                            {
-                                // get cost and individual textures
-                                hud_object_complexity.objectsCost += chld_volume->getRenderCost(textures);
-                                hud_object_complexity.objectsCount++;
-                            }
-                        }
-
-                        hud_object_complexity.texturesCount += textures.size();
-
-                        for (LLVOVolume::texture_cost_t::iterator volume_texture = textures.begin();
-                            volume_texture != textures.end();
-                            ++volume_texture)
-                        {
-                            // add the cost of each individual texture (ignores duplicates)
-                            hud_object_complexity.texturesCost += volume_texture->second;
-                            LLViewerFetchedTexture *tex = LLViewerTextureManager::getFetchedTexture(volume_texture->first);
-                            if (tex)
-                            {
-                                // Note: Texture memory might be incorect since texture might be still loading.
-                                hud_object_complexity.texturesMemoryTotal += tex->getTextureMemory();
-                                if (tex->getOriginalHeight() * tex->getOriginalWidth() >= HUD_OVERSIZED_TEXTURE_DATA_SIZE)
-                                {
-                                    hud_object_complexity.largeTexturesCount++;
-                                }
-                            }
-                        }
-                        hud_complexity_list.push_back(hud_object_complexity);
-                    }
-                }
 			}
 		}
+	}
 
-		// Diagnostic output to identify all avatar-related textures.
-		// Does not affect rendering cost calculation.
-		// Could be wrapped in a debug option if output becomes problematic.
-		if (isSelf())
+	// only the attachments that changed since
+	mAttachmentComplexity.update(boost::bind(&LLVOAvatar::calculateAttachmentComplexity, this, _1, _2));
+
+	U32 cost = VISUAL_COMPLEXITY_UNKNOWN;
+
+	for (U8 baked_index = 0; baked_index < BAKED_NUM_INDICES; baked_index++)
+	{
+	    const LLAvatarAppearanceDictionary::BakedEntry *baked_dict
+			= LLAvatarAppearanceDictionary::getInstance()->getBakedTexture((EBakedTextureIndex)baked_index);
+		ETextureIndex tex_index = baked_dict->mTextureIndex;
+		if ((tex_index != TEX_SKIRT_BAKED) || (isWearingWearableType(LLWearableType::WT_SKIRT)))
 		{
-			// print any attachment textures we didn't already know about.
-			for (LLVOVolume::texture_cost_t::iterator it = textures.begin(); it != textures.end(); ++it)
+			if (isTextureVisible(tex_index))
 			{
-				LLUUID image_id = it->first;
-				if( ! (image_id.isNull() || image_id == IMG_DEFAULT || image_id == IMG_DEFAULT_AVATAR)
-				   && (all_textures.find(image_id) == all_textures.end()))
-				{
-					// attachment texture not previously seen.
-					LL_DEBUGS("ARCdetail") << "attachment_texture: " << image_id.asString() << LL_ENDL;
-					all_textures.insert(image_id);
-				}
+				cost +=COMPLEXITY_BODY_PART_COST;
 			}
+		}
+	}
+    LL_DEBUGS("ARCdetail") << "Avatar body parts complexity: " << cost << LL_ENDL;
 
-			// print any avatar textures we didn't already know about
-		    for (LLAvatarAppearanceDictionary::Textures::const_iterator iter = LLAvatarAppearanceDictionary::getInstance()->getTextures().begin();
-			 iter != LLAvatarAppearanceDictionary::getInstance()->getTextures().end();
-				 ++iter)
+	cost += mAttachmentComplexity.getTotal();
+
+	// Diagnostic output to identify all avatar-related textures.
+	// Does not affect rendering cost calculation.
+	// Could be wrapped in a debug option if output becomes problematic.
+	if (isSelf() && mVisualComplexityStale)
+	{
+		std::set<LLUUID> all_textures;
+
+		// print each avatar texture once
+	    for (LLAvatarAppearanceDictionary::Textures::const_iterator iter = LLAvatarAppearanceDictionary::getInstance()->getTextures().begin();
+		 iter != LLAvatarAppearanceDictionary::getInstance()->getTextures().end();
+			 ++iter)
+		{
+		    const LLAvatarAppearanceDictionary::TextureEntry *texture_dict = iter->second;
+			// TODO: MULTI-WEARABLE: handle multiple textures for self
+			const LLViewerTexture* te_image = getImage(iter->first,0);
+			if (!te_image)
+				continue;
+			LLUUID image_id = te_image->getID();
+			if( image_id.isNull() || image_id == IMG_DEFAULT || image_id == IMG_DEFAULT_AVATAR)
+				continue;
+			if (all_textures.find(image_id) == all_textures.end())
 			{
-			    const LLAvatarAppearanceDictionary::TextureEntry *texture_dict = iter->second;
-				// TODO: MULTI-WEARABLE: handle multiple textures for self
-				const LLViewerTexture* te_image = getImage(iter->first,0);
-				if (!te_image)
-					continue;
-				LLUUID image_id = te_image->getID();
-				if( image_id.isNull() || image_id == IMG_DEFAULT || image_id == IMG_DEFAULT_AVATAR)
-					continue;
-				if (all_textures.find(image_id) == all_textures.end())
-				{
-					LL_DEBUGS("ARCdetail") << "local_texture: " << texture_dict->mName << ": " << image_id << LL_ENDL;
-					all_textures.insert(image_id);
-				}
+				LL_DEBUGS("ARCdetail") << "local_texture: " << texture_dict->mName << ": " << image_id << LL_ENDL;
+				all_textures.insert(image_id);
 			}
 		}
+	}
 
-        if ( cost != mVisualComplexity )
-        {
-            LL_DEBUGS("AvatarRender") << "Avatar "<< getID()
-                                      << " complexity updated was " << mVisualComplexity << " now " << cost
-                                      << " reported " << mReportedVisualComplexity
-                                      << LL_ENDL;
-        }
-        else
-        {
-            LL_DEBUGS("AvatarRender") << "Avatar "<< getID()
-                                      << " complexity updated no change " << mVisualComplexity
-                                      << " reported " << mReportedVisualComplexity
-                                      << LL_ENDL;
-        }
-		mVisualComplexity = cost;
-		mVisualComplexityStale = false;
-
-        static LLCachedControl<U32> show_my_complexity_changes(gSavedSettings, "ShowMyComplexityChanges", 20);
+    if ( cost != mVisualComplexity )
+    {
+        LL_DEBUGS("AvatarRender") << "Avatar "<< getID()
+                                  << " complexity updated was " << mVisualComplexity << " now " << cost
+                                  << " reported " << mReportedVisualComplexity
+                                  << LL_ENDL;
+    }
+    else
+    {
+        LL_DEBUGS("AvatarRender") << "Avatar "<< getID()
+                                  << " complexity updated no change " << mVisualComplexity
+                                  << " reported " << mReportedVisualComplexity
+                                  << LL_ENDL;
+    }
+	mVisualComplexity = cost;
+	mVisualComplexityStale = false;
 
-        if (isSelf() && show_my_complexity_changes)
-        {
-            // Avatar complexity
-            LLAvatarRenderNotifier::getInstance()->updateNotificationAgent(mVisualComplexity);
+    if (isSelf() && mShowMyComplexityChanges)
+    {
+        // Avatar complexity
+        LLAvatarRenderNotifier::getInstance()->updateNotificationAgent(mVisualComplexity);
 
-            // HUD complexity
-            LLHUDRenderNotifier::getInstance()->updateNotificationHUD(hud_complexity_list);
-        }
+        // HUD complexity
+		hud_complexity_list_t hud_complexity_list;
+		const LLAttachmentComplexity::entry_map_t& entries = mAttachmentComplexity.getEntries();
+		for (LLAttachmentComplexity::entry_map_t::const_iterator iter = entries.begin();
+			 iter != entries.end();
+			 ++iter)
+		{
+			if (iter->second.mHasHUD)
+			{
+				hud_complexity_list.push_back(iter->second.mHUD);
+			}
+		}
+        LLHUDRenderNotifier::getInstance()->updateNotificationHUD(hud_complexity_list);
     }
 }
 
@@ -30,12 +30,16 @@
 
 #include <map>
 #include <deque>
+#include <set>
 //#include <string>
 #include <vector>
 
 #include <boost/signals2/trackable.hpp>
 
+#include "llanimationlod.h"
+#include "llattachmentcomplexity.h"
 #include "llavatarappearance.h"
+#include "llavatarrendernotifier.h"
 #include "llchat.h"
 #include "lldrawpoolalpha.h"
 #include "llviewerobject.h"
@@ -68,6 +72,7 @@ class LLVoiceVisualizer;
 class LLHUDNameTag;
 class LLHUDEffectSpiral;
 class LLTexGlobalColor;
+class LLMotionEvaluator;
 
 struct LLAppearanceMessageContents;
 class LLViewerJointMesh;
@@ -246,13 +251,24 @@ private: //aligned members
 public:
 	void			updateDebugText();
 	virtual BOOL 	updateCharacter(LLAgent &agent);
+	// updateCharacter() on either side of updating the motions
+	bool			beginCharacterUpdate(LLAgent &agent, LLCharacter::e_update_t& update_type);
+	BOOL			endCharacterUpdate(LLCharacter::e_update_t update_type);
+	void			finishIdleUpdate(BOOL detailed_update);
+	// finishIdleUpdate() in three phases: what touches shared state, what
+	// only touches this avatar and can run on any thread, and what has to
+	// wait for the latter and goes back to the main thread
+	void			beginIdleUpdate(BOOL detailed_update);
+	void			idleUpdateIndependent();
+	void			commitIdleUpdate();
 	void 			idleUpdateVoiceVisualizer(bool voice_enabled);
 	void 			idleUpdateMisc(bool detailed_update);
 	virtual void	idleUpdateAppearanceAnimation();
 	void 			idleUpdateLipSync(bool voice_enabled);
 	void 			idleUpdateLoadingEffect();
 	void 			idleUpdateWindEffect();
-	void 			idleUpdateNameTag(const LLVector3& root_pos_last);
+	// returns whether there's a name tag to position and fill in
+	bool 			idleUpdateNameTag();
 	void			idleUpdateNameTagText(BOOL new_name);
 	void			idleUpdateNameTagPosition(const LLVector3& root_pos_last);
 	void			idleUpdateNameTagAlpha(BOOL new_name, F32 alpha);
@@ -266,9 +282,13 @@ public:
 	void			addNameTagLine(const std::string& line, const LLColor4& color, S32 style, const LLFontGL* font, bool is_name = false);
 	// </FS:Ansariel>
 	void 			idleUpdateRenderComplexity();
+	void			idleUpdateRenderComplexityText();
 	void			calculateUpdateRenderComplexity();
 	static const U32 VISUAL_COMPLEXITY_UNKNOWN;
+	// everything that goes into the complexity may have changed
 	void			updateVisualComplexity();
+	// only the cost of the attached linkset object is in may have changed
+	void			updateAttachmentComplexity(LLViewerObject* object);
 	
 	U32				getVisualComplexity()			{ return mVisualComplexity;				};		// Numbers calculated here by rendering AV
 	F32				getAttachmentSurfaceArea()		{ return mAttachmentSurfaceArea;		};		// estimated surface area of attachments
@@ -284,6 +304,69 @@ public:
 
 	void 			idleUpdateBelowWater();
 
+	// Other avatars evaluate their motions in parallel when there are
+	// animation threads: idleUpdate() queues them once their motions are
+	// prepared, and updateQueuedAnimations() evaluates the queue and then
+	// commits and finishes each avatar's idle update on the main thread.
+	static void		startAnimationThreads(U32 threads);
+	static void		stopAnimationThreads();
+	static void		updateQueuedAnimations();
+
+	// With animation threads, finishIdleUpdate() does the shared part of
+	// other avatars' idle updates right away and queues them, and this runs
+	// their independent parts on the threads and then commits them.
+	static void		updateQueuedIdleUpdates();
+
+	// Other avatars queue their morph targets, and this applies them after
+	// the idle updates, on the animation threads when there are any.
+	static void		applyQueuedMorphs();
+	/*virtual*/ bool isMorphingDeferred() const;
+
+private:
+	static LLMotionEvaluator*	sMotionEvaluator;
+	static std::vector<LLPointer<LLVOAvatar> > sQueuedAnimations;
+	LLCharacter::e_update_t	mQueuedUpdateType;
+	static std::vector<LLPointer<LLVOAvatar> > sQueuedIdleUpdates;
+	// carried from beginIdleUpdate() to the later phases
+	BOOL			mIdleDetailedUpdate;
+	bool			mIdleVoiceEnabled;
+	bool			mIdleNameTag;
+	BOOL			mIdleNewName;
+	bool			mWasSitGroundConstrained;
+
+	//--------------------------------------------------------------------
+	// Animation LOD
+	//--------------------------------------------------------------------
+	// Other avatars that are small on screen or far away evaluate their
+	// motions every few frames, see LLAnimationLOD.  All of them share one
+	// budget a frame.
+public:
+	// called once a frame before the avatars' idle updates
+	static void		startAnimationFrame();
+
+	// last frame's numbers: avatars animated at each rate, how many of
+	// them evaluated their motions and how many eased their pose instead,
+	// the budget holding back some of those
+	static S32		sNumAnimatedAtRate[LLAnimationLOD::NUM_RATES];
+	static S32		sNumAnimationsEvaluated;
+	static S32		sNumAnimationsInterpolated;
+	static S32		sNumAnimationsDeferred;
+
+private:
+	void			updateAnimationRate(BOOL visible);
+	// whether to evaluate the motions this frame, false to ease the pose
+	bool			isAnimationDue(LLCharacter::e_update_t update_type);
+	// around evaluating the motions of an update isAnimationDue() allowed
+	void			beginAnimationPose();
+	void			endAnimationPose();
+	void			interpolateAnimationPose();
+
+	LLAnimationLOD	mAnimationLOD;
+
+	static S32		sAnimatedAtRate[LLAnimationLOD::NUM_RATES];
+	static S32		sAnimationsInterpolated;
+	static LLAnimationLOD::Budget sAnimationBudget;
+
 	//--------------------------------------------------------------------
 	// Static preferences (controlled by user settings/menus)
 	//--------------------------------------------------------------------
@@ -440,6 +523,10 @@ public:
 	// the isTooComplex method uses these mutable values to avoid recalculating too frequently
 	mutable U32  mVisualComplexity;
 	mutable bool mVisualComplexityStale;
+
+	// what the attachments add to mVisualComplexity
+	void		calculateAttachmentComplexity(LLViewerObject* attached_object, LLAttachmentComplexity::Entry& complexity);
+	LLAttachmentComplexity mAttachmentComplexity;
 	U32          mReportedVisualComplexity; // from other viewers through the simulator
 
 	bool		mCachedInMuteList;
@@ -507,6 +594,8 @@ private:
 	LLVector3	mLastAnimExtents[2];  
 	
 	LLCachedControl<bool> mRenderUnloadedAvatar;
+	// made here, on the main thread; the complexity is costed on the animation threads
+	LLCachedControl<U32> mShowMyComplexityChanges;
 
 	//--------------------------------------------------------------------
 	// Wind rippling in clothes
@@ -82,6 +82,7 @@
 #include "llvoavatar.h"
 #include "llvocache.h"
 #include "llmaterialmgr.h"
+#include "llobjectupdatedecoder.h"
 // [RLVa:KB] - Checked: RLVa-2.0.0
 #include "rlvactions.h"
 #include "rlvlocks.h"
@@ -237,6 +238,11 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 
 LLVOVolume::~LLVOVolume()
 {
+	if (getVolumeManager())
+	{
+		getVolumeManager()->cancelGenerationRequests(this);
+	}
+
 	delete mTextureAnimp;
 	mTextureAnimp = NULL;
 	delete mVolumeImpl;
@@ -275,6 +281,11 @@ void LLVOVolume::markDead()
 		{
 			mSculptTexture->removeVolume(this);
 		}
+
+		if (getVolumeManager())
+		{
+			getVolumeManager()->cancelGenerationRequests(this);
+		}
 	}
 	
 	LLViewerObject::markDead();
@@ -367,7 +378,14 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 
 			// Unpack volume data
 			LLVolumeParams volume_params;
-			LLVolumeMessage::unpackVolumeParams(&volume_params, mesgsys, _PREHASH_ObjectData, block_num);
+			if (mDecodedUpdate && mDecodedUpdate->mHasVolumeParams)
+			{
+				volume_params = mDecodedUpdate->mVolumeParams;
+			}
+			else
+			{
+				LLVolumeMessage::unpackVolumeParams(&volume_params, mesgsys, _PREHASH_ObjectData, block_num);
+			}
 			volume_params.setSculptID(sculpt_id, sculpt_type);
 
 			if (setVolume(volume_params, 0))
@@ -382,7 +400,20 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		// Unpack texture entry data
 		//
 
-		S32 result = unpackTEMessage(mesgsys, _PREHASH_ObjectData, static_cast<S32>(block_num));
+		S32 result = 0;
+		if (mDecodedUpdate && mDecodedUpdate->mPCode == LL_PCODE_VOLUME)
+		{
+			// parsed for every face, only apply the ones the volume has
+			if (mDecodedUpdate->mTEResult)
+			{
+				mDecodedUpdate->mTEContents.face_count = llmin((U32) getNumTEs(), (U32) LLTEContents::MAX_TES);
+				result = applyParsedTEMessage(mDecodedUpdate->mTEContents);
+			}
+		}
+		else
+		{
+			result = unpackTEMessage(mesgsys, _PREHASH_ObjectData, static_cast<S32>(block_num));
+		}
 		if (result & teDirtyBits)
 		{
 			updateTEData();
@@ -394,11 +425,17 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 	else
 	{
-		if (update_type != OUT_TERSE_IMPROVED)
+		// unpacked off the main thread by LLObjectUpdateDecoder::unpackCompressed()
+		LLObjectUpdateRecord& update = *mDecodedUpdate;
+		if (update_type != OUT_TERSE_IMPROVED && update.mPCode != LL_PCODE_VOLUME)
 		{
-			LLVolumeParams volume_params;
-			BOOL res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
-			if (!res)
+			// the volume part is only unpacked for volumes
+			LL_WARNS() << "Volume update without volume data for object " << getID() << LL_ENDL;
+		}
+		else if (update_type != OUT_TERSE_IMPROVED)
+		{
+			LLVolumeParams volume_params = update.mVolumeParams;
+			if (!update.mHasVolumeParams)
 			{
 				LL_WARNS() << "Bogus volume parameters in object " << getID() << LL_ENDL;
 				LL_WARNS() << getRegion()->getOriginGlobal() << LL_ENDL;
@@ -410,7 +447,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				markForUpdate(TRUE);
 			}
-			S32 res2 = unpackTEMessage(*dp);
+			S32 res2 = update.mTEResult;
 			if (TEM_INVALID == res2)
 			{
 				// There's something bogus in the data that we're unpacking.
@@ -426,6 +463,12 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			}
 			else 
 			{
+				if (res2)
+				{
+					// parsed for every face, only apply the ones the volume has
+					update.mTEContents.face_count = llmin((U32) getNumTEs(), (U32) LLTEContents::MAX_TES);
+					res2 = applyParsedTEMessage(update.mTEContents);
+				}
 				if (res2 & teDirtyBits) 
 				{
 					updateTEData();
@@ -436,7 +479,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 				}
 			}
 
-			U32 value = dp->getPassFlags();
+			U32 value = update.mPassFlags;
 
 			if (value & 0x40)
 			{
@@ -452,7 +495,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 					}
 				}
 				mTexAnimMode = 0;
-				mTextureAnimp->unpackTAMessage(*dp);
+				static_cast<LLTextureAnim&>(*mTextureAnimp) = update.mTextureAnim;
 			}
 			else if (mTextureAnimp)
 			{
@@ -465,7 +508,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 
 			if (value & 0x400)
 			{ //particle system (new)
-				unpackParticleSource(*dp, mOwnerID, false);
+				applyParticleSource(update.mHasPartSys ? &update.mPartSys : NULL, mOwnerID);
 			}
 		}
 		else
@@ -1023,6 +1066,28 @@ BOOL LLVOVolume::setVolume(const LLVolumeParams &params_in, const S32 detail, bo
 
 	}
 
+	// A LOD switch to a shape nobody has generated yet goes to the volume
+	// workers; the current LOD keeps rendering until onVolumeGenerated().
+	LLVolumeMgr* volume_mgr = getVolumeManager();
+	if (volume_mgr && volume_mgr->isGenerationThreaded() && !mVolumeImpl && !is404 && !mSculptChanged
+		&& mVolumep.notNull() && lod != last_lod && volume_params == mVolumep->getParams()
+		&& (volume_params.getSculptType() & LL_SCULPT_TYPE_MASK) != LL_SCULPT_TYPE_MESH)
+	{
+		LLVolumeLODGroup* group = volume_mgr->getGroup(volume_params);
+		if (!group || !group->hasLOD(lod))
+		{
+			LLVolumeMgr::SculptMap sculpt_map;
+			bool has_map = isSculpted() && copySculptMap(sculpt_map);
+			LLVolume* volumep = volume_mgr->refVolumeAsync(volume_params, lod, this, has_map ? &sculpt_map : NULL);
+			if (!volumep)
+			{
+				return FALSE;
+			}
+			// LLPrimitive::setVolume() takes its own reference
+			volume_mgr->unrefVolume(volumep);
+		}
+	}
+
 	if ((LLPrimitive::setVolume(volume_params, lod, (mVolumeImpl && mVolumeImpl->isVolumeUnique()))) || mSculptChanged)
 	{
 		mFaceMappingChanged = TRUE;
@@ -1126,6 +1191,70 @@ void LLVOVolume::updateSculptTexture()
 	
 }
 
+void LLVOVolume::onVolumeGenerated(const LLVolumeParams& params, const S32 detail)
+{
+	if (mDrawable.notNull() && !isDead() && detail == mLOD
+		&& mVolumep.notNull() && mVolumep->getParams() == params)
+	{
+		mLODChanged = TRUE;
+		gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
+	}
+}
+
+void LLVOVolume::onSculptGenerated(LLVolume* volumep)
+{
+	if (mSculptTexture.isNull())
+	{
+		return;
+	}
+
+	//rebuild every VOVolume that references this sculpty volume, including this one
+	for (S32 i = 0; i < mSculptTexture->getNumVolumes(); ++i)
+	{
+		LLVOVolume* volume = (*(mSculptTexture->getVolumeList()))[i];
+		if (volume->getVolume() == volumep && volume->mDrawable.notNull())
+		{
+			volume->mSculptChanged = TRUE;
+			gPipeline.markRebuild(volume->mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
+		}
+	}
+}
+
+static void fill_sculpt_map(LLVolumeMgr::SculptMap& sculpt_map, U16 width, U16 height, S8 components, const U8* data, S32 level)
+{
+	sculpt_map.mWidth = width;
+	sculpt_map.mHeight = height;
+	sculpt_map.mComponents = components;
+	sculpt_map.mLevel = level;
+	if (data)
+	{
+		sculpt_map.mData.assign(data, data + (U32) width * height * components);
+	}
+	else
+	{
+		sculpt_map.mData.clear();
+	}
+}
+
+bool LLVOVolume::copySculptMap(LLVolumeMgr::SculptMap& sculpt_map) const
+{
+	if (mSculptTexture.isNull())
+	{
+		return false;
+	}
+
+	S32 discard_level = llmin(mSculptTexture->getCachedRawImageLevel(), (S32) mSculptTexture->getMaxDiscardLevel());
+	LLImageRaw* raw_image = mSculptTexture->getCachedRawImage();
+	if (!raw_image || discard_level < 0 || discard_level > MAX_DISCARD_LEVEL)
+	{
+		return false;
+	}
+
+	fill_sculpt_map(sculpt_map, raw_image->getWidth(), raw_image->getHeight(),
+					raw_image->getComponents(), raw_image->getData(), discard_level);
+	return true;
+}
+
 void LLVOVolume::notifyMeshLoaded()
 { 
 	mSculptChanged = TRUE;
@@ -1134,7 +1263,7 @@ void LLVOVolume::notifyMeshLoaded()
 	LLVOAvatar* avatar = getAvatar();
 	if (avatar)
 	{
-		avatar->updateVisualComplexity();
+		avatar->updateAttachmentComplexity(this);
 	}
 }
 
@@ -1230,6 +1359,18 @@ void LLVOVolume::sculpt()
 				mSculptTexture->updateBindStatsForTester() ;
 			}
 		}
+		LLVolumeMgr* volume_mgr = getVolumeManager();
+		if (volume_mgr && volume_mgr->isGenerationThreaded() && !getVolume()->isUnique())
+		{
+			// rebuilds are triggered from onSculptGenerated()
+			LLVolumeMgr::SculptMap sculpt_map;
+			fill_sculpt_map(sculpt_map, sculpt_width, sculpt_height, sculpt_components, sculpt_data, discard_level);
+			if (volume_mgr->sculptAsync(getVolume(), sculpt_map, this))
+			{
+				return;
+			}
+		}
+
 		getVolume()->sculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_data, discard_level);
 
 		//notify rebuild any other VOVolumes that reference this sculpty volume
@@ -1344,6 +1485,15 @@ BOOL LLVOVolume::updateLOD()
 	{
 		gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
 		mLODChanged = TRUE;
+
+		if (isAttachment() && isMesh())
+		{ // a mesh costs what its current LOD weighs
+			LLVOAvatar* avatar = getAvatar();
+			if (avatar)
+			{
+				avatar->updateAttachmentComplexity(this);
+			}
+		}
 	}
 	else
 	{
@@ -3482,7 +3632,10 @@ U32 LLVOVolume::getRenderCost(texture_cost_t &textures) const
 			S32 size = gMeshRepo.getMeshSize(volume_params.getSculptID(), getLOD());
 			if ( size > 0)
 			{
-				if (gMeshRepo.getSkinInfo(volume_params.getSculptID(), this))
+				// Looked up rather than requested, like the sculpt texture
+				// below.  Drawing the mesh requests its skin, and its arrival
+				// costs the linkset again.
+				if (gMeshRepo.findSkinInfo(volume_params.getSculptID()))
 				{
 					// weighted attachment - 1 point for every 3 bytes
 					weighted_mesh = 1;
@@ -3501,12 +3654,16 @@ U32 LLVOVolume::getRenderCost(texture_cost_t &textures) const
 			LLUUID sculpt_id = sculpt_params->getSculptTexture();
 			if (textures.find(sculpt_id) == textures.end())
 			{
-				LLViewerFetchedTexture *texture = LLViewerTextureManager::getFetchedTexture(sculpt_id);
+				// Looked up rather than created, avatar complexity runs on the
+				// animation threads.  One that doesn't exist yet would have
+				// no size anyway.
+				LLViewerFetchedTexture *texture = LLViewerTextureManager::findFetchedTexture(sculpt_id, TEX_LIST_STANDARD);
+				S32 texture_cost = 256;
 				if (texture)
 				{
-					S32 texture_cost = 256 + static_cast<S32>(ARC_TEXTURE_COST * (texture->getFullHeight() / 128.f + texture->getFullWidth() / 128.f));
-					textures.insert(texture_cost_t::value_type(sculpt_id, texture_cost));
+					texture_cost += static_cast<S32>(ARC_TEXTURE_COST * (texture->getFullHeight() / 128.f + texture->getFullWidth() / 128.f));
 				}
+				textures.insert(texture_cost_t::value_type(sculpt_id, texture_cost));
 			}
 		}
 	}
@@ -28,6 +28,7 @@
 #define LL_LLVOVOLUME_H
 
 #include "llviewerobject.h"
+#include "llvolumemgr.h"
 #include "llviewertexture.h"
 #include "llviewermedia.h"
 #include "llframetimer.h"
@@ -87,7 +88,7 @@ public:
 };
 
 // Class which embodies all Volume objects (with pcode LL_PCODE_VOLUME)
-class LLVOVolume : public LLViewerObject
+class LLVOVolume : public LLViewerObject, public LLVolumeMgr::GenerationObserver
 {
 	LOG_CLASS(LLVOVolume);
 protected:
@@ -207,6 +208,7 @@ public:
 				void	updateSculptTexture();
 				void    setIndexInTex(S32 index) { mIndexInTex = index ;}
 				void	sculpt();
+				bool	copySculptMap(LLVolumeMgr::SculptMap& sculpt_map) const;
 	 static     void    rebuildMeshAssetCallback(LLVFS *vfs,
 														  const LLUUID& asset_uuid,
 														  LLAssetType::EType type,
@@ -300,6 +302,10 @@ public:
 	LLVector3 getApproximateFaceNormal(U8 face_id) const;
 	
 	void notifyMeshLoaded();
+
+	// background volume generation (LLVolumeMgr::GenerationObserver)
+	/*virtual*/ void onVolumeGenerated(const LLVolumeParams& params, const S32 detail);
+	/*virtual*/ void onSculptGenerated(LLVolume* volumep);
 	
 	// Returns 'true' iff the media data for this object is in flight
 	bool isMediaDataBeingFetched() const;
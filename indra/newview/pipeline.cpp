@@ -2990,6 +2990,7 @@ void LLPipeline::rebuildPriorityGroups()
 	assertInitialized();
 
 	gMeshRepo.notifyLoadedMeshes();
+	LLPrimitive::getVolumeManager()->updateGeneration();
 
 	mGroupQ1Locked = true;
 	// Iterate through all drawables on the priority build queue,
@@ -7460,6 +7461,7 @@ void LLPipeline::doResetVertexBuffers(bool forced)
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
 	LLVertexBuffer::sUseVAO = gSavedSettings.getBOOL("RenderUseVAO");
 	LLVertexBuffer::sPreferStreamDraw = gSavedSettings.getBOOL("RenderPreferStreamDraw");
+	LLVertexBuffer::sStreamRingSize = gSavedSettings.getU32("PVRender_StreamRingSize")*1024*1024;
 	LLVertexBuffer::sEnableVBOs = gSavedSettings.getBOOL("RenderVBOEnable");
 	LLVertexBuffer::sDisableVBOMapping = LLVertexBuffer::sEnableVBOs && gSavedSettings.getBOOL("RenderVBOMappingDisable") ;
 	sBakeSunlight = gSavedSettings.getBOOL("RenderBakeSunlight");
@@ -0,0 +1,261 @@
+/**
+ * @file llattachmentcomplexity_test.cpp
+ * @brief LLAttachmentComplexity tests, which linksets get costed again as
+ * attachments come, go and change.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llviewerprecompiledheaders.h"
+
+#include "../llattachmentcomplexity.h"
+
+#include <boost/bind.hpp>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 NUM_LINKSETS = 3;
+}
+
+namespace tut
+{
+	struct attachmentcomplexity_data
+	{
+		attachmentcomplexity_data()
+		{
+			for (S32 i = 0; i < NUM_LINKSETS; ++i)
+			{
+				mCosts[i] = 100 * (i + 1);
+				mCalls[i] = 0;
+			}
+		}
+
+		// The roots of the attached linksets.  LLAttachmentComplexity only
+		// keys on them, they are never looked at.
+		LLViewerObject* root(S32 i)
+		{
+			return reinterpret_cast<LLViewerObject*>(&mRoots[i]);
+		}
+
+		S32 index(LLViewerObject* object)
+		{
+			return reinterpret_cast<char*>(object) - mRoots;
+		}
+
+		// stands in for LLVOAvatar::calculateAttachmentComplexity()
+		void cost(LLViewerObject* object, LLAttachmentComplexity::Entry& entry)
+		{
+			S32 i = index(object);
+			ensure("costing an attached linkset", i >= 0 && i < NUM_LINKSETS);
+			ensure_equals("costing a fresh entry", entry.mCost, (U32) 0);
+			++mCalls[i];
+			entry.mCost = mCosts[i];
+		}
+
+		// a HUD attachment costs nothing toward the total
+		void costHUD(LLViewerObject* object, LLAttachmentComplexity::Entry& entry)
+		{
+			++mCalls[index(object)];
+			entry.mHasHUD = true;
+			entry.mHUD.objectsCost = 42;
+		}
+
+		void update()
+		{
+			mComplexity.update(boost::bind(&attachmentcomplexity_data::cost, this, _1, _2));
+		}
+
+		void ensureCalls(const std::string& msg, S32 a, S32 b, S32 c)
+		{
+			ensure_equals(msg + ": first costed", mCalls[0], a);
+			ensure_equals(msg + ": second costed", mCalls[1], b);
+			ensure_equals(msg + ": third costed", mCalls[2], c);
+		}
+
+		char mRoots[NUM_LINKSETS];
+		U32 mCosts[NUM_LINKSETS];
+		S32 mCalls[NUM_LINKSETS];
+		LLAttachmentComplexity mComplexity;
+	};
+
+	typedef test_group<attachmentcomplexity_data> attachmentcomplexity_t;
+	typedef attachmentcomplexity_t::object attachmentcomplexity_object_t;
+	tut::attachmentcomplexity_t tut_attachmentcomplexity("LLAttachmentComplexity");
+
+	// attaching costs the linkset on the next update
+	template<> template<>
+	void attachmentcomplexity_object_t::test<1>()
+	{
+		ensure("nothing to do at first", !mComplexity.needsUpdate());
+		ensure_equals("nothing attached", mComplexity.getTotal(), (U32) 0);
+
+		mComplexity.add(root(0));
+		mComplexity.add(root(1));
+		ensure("attached", mComplexity.needsUpdate());
+		ensure_equals("not costed yet", mComplexity.getTotal(), (U32) 0);
+		ensureCalls("before the update", 0, 0, 0);
+
+		update();
+		ensure("updated", !mComplexity.needsUpdate());
+		ensure_equals("both costed", mComplexity.getTotal(), (U32) 300);
+		ensureCalls("after the update", 1, 1, 0);
+		ensure_equals("entries", mComplexity.getEntries().size(), (size_t) 2);
+
+		update();
+		ensureCalls("nothing changed since", 1, 1, 0);
+	}
+
+	// a face or volume change in one linkset costs only that one again
+	template<> template<>
+	void attachmentcomplexity_object_t::test<2>()
+	{
+		for (S32 i = 0; i < NUM_LINKSETS; ++i)
+		{
+			mComplexity.add(root(i));
+		}
+		update();
+		ensure_equals("all costed", mComplexity.getTotal(), (U32) 600);
+
+		mCosts[1] = 50;
+		mComplexity.invalidate(root(1));
+		mComplexity.invalidate(root(1));
+		ensure("changed", mComplexity.needsUpdate());
+		update();
+		ensureCalls("one changed", 1, 2, 1);
+		ensure_equals("cheaper", mComplexity.getTotal(), (U32) 450);
+
+		mCosts[0] = 1000;
+		mCosts[2] = 1;
+		mComplexity.invalidate(root(0));
+		mComplexity.invalidate(root(2));
+		update();
+		ensureCalls("two changed", 2, 2, 2);
+		ensure_equals("both changes in", mComplexity.getTotal(), (U32) 1051);
+	}
+
+	// detaching takes the cost off right away, and later changes to the
+	// linkset are no longer its avatar's
+	template<> template<>
+	void attachmentcomplexity_object_t::test<3>()
+	{
+		mComplexity.add(root(0));
+		mComplexity.add(root(1));
+		update();
+
+		mComplexity.remove(root(0));
+		ensure("detached", mComplexity.needsUpdate());
+		ensure_equals("cost taken off", mComplexity.getTotal(), (U32) 200);
+
+		mComplexity.invalidate(root(0));
+		update();
+		ensureCalls("detached linkset not costed", 1, 1, 0);
+		ensure_equals("still off", mComplexity.getTotal(), (U32) 200);
+		ensure_equals("entries", mComplexity.getEntries().size(), (size_t) 1);
+
+		mCosts[0] = 10;
+		mComplexity.add(root(0));
+		update();
+		ensureCalls("attached again", 2, 1, 0);
+		ensure_equals("back on", mComplexity.getTotal(), (U32) 210);
+
+		mComplexity.remove(root(2));
+		ensure_equals("never attached", mComplexity.getTotal(), (U32) 210);
+	}
+
+	// a linkset detached before it was costed never is
+	template<> template<>
+	void attachmentcomplexity_object_t::test<4>()
+	{
+		mComplexity.add(root(0));
+		update();
+
+		mComplexity.add(root(1));
+		mComplexity.invalidate(root(0));
+		mComplexity.remove(root(1));
+		mComplexity.remove(root(0));
+		update();
+		ensureCalls("none costed", 1, 0, 0);
+		ensure_equals("nothing attached", mComplexity.getTotal(), (U32) 0);
+		ensure("no entries", mComplexity.getEntries().empty());
+	}
+
+	// changes to linksets that aren't attached change nothing
+	template<> template<>
+	void attachmentcomplexity_object_t::test<5>()
+	{
+		mComplexity.add(root(0));
+		update();
+
+		mComplexity.invalidate(root(1));
+		ensure("nothing to do", !mComplexity.needsUpdate());
+		update();
+		ensureCalls("not costed", 1, 0, 0);
+		ensure("not added", mComplexity.getEntries().find(root(1)) == mComplexity.getEntries().end());
+	}
+
+	// attaching a linkset again, or everything again after the whole
+	// appearance changed, doesn't count anything twice
+	template<> template<>
+	void attachmentcomplexity_object_t::test<6>()
+	{
+		mComplexity.add(root(0));
+		mComplexity.add(root(1));
+		update();
+
+		mComplexity.add(root(1));
+		ensure_equals("its old cost taken off", mComplexity.getTotal(), (U32) 100);
+		update();
+		ensure_equals("counted once", mComplexity.getTotal(), (U32) 300);
+
+		mComplexity.clear();
+		ensure("cleared", mComplexity.needsUpdate());
+		ensure_equals("nothing left", mComplexity.getTotal(), (U32) 0);
+		for (S32 i = 0; i < NUM_LINKSETS; ++i)
+		{
+			mComplexity.add(root(i));
+		}
+		update();
+		ensureCalls("all costed again", 2, 3, 1);
+		ensure_equals("all counted once", mComplexity.getTotal(), (U32) 600);
+	}
+
+	// what the costing fills in beyond the cost is kept with the linkset
+	template<> template<>
+	void attachmentcomplexity_object_t::test<7>()
+	{
+		mComplexity.add(root(0));
+		mComplexity.update(boost::bind(&attachmentcomplexity_data::costHUD, this, _1, _2));
+
+		const LLAttachmentComplexity::Entry& entry = mComplexity.getEntries().find(root(0))->second;
+		ensure("a HUD", entry.mHasHUD);
+		ensure_equals("HUD cost", entry.mHUD.objectsCost, (U32) 42);
+		ensure_equals("HUDs aren't in the total", mComplexity.getTotal(), (U32) 0);
+
+		mComplexity.invalidate(root(0));
+		update();
+		const LLAttachmentComplexity::Entry& costed = mComplexity.getEntries().find(root(0))->second;
+		ensure("no longer a HUD", !costed.mHasHUD);
+		ensure_equals("HUD cost gone", costed.mHUD.objectsCost, (U32) 0);
+	}
+}
@@ -0,0 +1,290 @@
+/**
+ * @file llinventorycache_test.cpp
+ * @brief LLInventoryCache tests, the binary cache written, read back and
+ * refused when damaged.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llinventorycache.h"
+
+#include "llfile.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 TEST_VERSION = 4;
+
+	// The file layout, as the tests below damage it: a header of eight
+	// U32, the 32 byte category records, the 140 byte item records, the
+	// 24 byte item index records and the strings.
+	const size_t HEADER_SIZE = 32;
+	const size_t CATEGORY_SIZE = 32;
+	const size_t ITEM_SIZE = 140;
+	const size_t ITEM_INDEX_SIZE = 24;
+	const size_t ITEM_COUNT_OFFSET = 12;
+	const size_t FIRST_ITEM_OFFSET = 20;
+
+	LLPointer<LLInventoryItem> make_item(const LLUUID& parent_id, LLAssetType::EType type,
+										 LLInventoryType::EType inv_type, const std::string& name,
+										 const std::string& desc)
+	{
+		LLPermissions perm;
+		perm.init(LLUUID::generateNewID(), LLUUID::generateNewID(), LLUUID::null, LLUUID::null);
+		perm.initMasks(PERM_ALL, PERM_ALL, PERM_NONE, PERM_NONE, PERM_MOVE | PERM_TRANSFER);
+		return new LLInventoryItem(LLUUID::generateNewID(), parent_id, perm, LLUUID::generateNewID(),
+								   type, inv_type, name, desc,
+								   LLSaleInfo(LLSaleInfo::FS_COPY, 25), 0x12, 1400000000);
+	}
+
+	std::vector<U8> read_file(const std::string& filename)
+	{
+		std::vector<U8> data;
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (fp)
+		{
+			U8 buffer[4096];
+			size_t count;
+			while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			{
+				data.insert(data.end(), buffer, buffer + count);
+			}
+			LLFile::close(fp);
+		}
+		return data;
+	}
+
+	void write_file(const std::string& filename, const std::vector<U8>& data)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "wb");
+		if (fp)
+		{
+			if (!data.empty())
+			{
+				fwrite(&data[0], 1, data.size(), fp);
+			}
+			LLFile::close(fp);
+		}
+	}
+
+	void set_u32(std::vector<U8>& data, size_t offset, U32 value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	// true if data, written out, is turned down as obsolete
+	bool rejected(const std::string& filename, const std::vector<U8>& data)
+	{
+		write_file(filename, data);
+		LLInventoryCache cache;
+		bool is_obsolete = false;
+		return !cache.open(filename, TEST_VERSION, is_obsolete) && is_obsolete;
+	}
+}
+
+namespace tut
+{
+	struct llinventorycache_test
+	{
+		llinventorycache_test()
+		:	mFilename(std::string(LLFile::tmpdir()) + "llinventorycache_test.inv"),
+			mFolder(LLUUID::generateNewID()),
+			mLinkFolder(LLUUID::generateNewID()),
+			mEmptyFolder(LLUUID::generateNewID())
+		{
+			mItems.push_back(make_item(mFolder, LLAssetType::AT_NOTECARD, LLInventoryType::IT_NOTECARD,
+									   "Notes", "what to bring"));
+			mItems.push_back(make_item(mFolder, LLAssetType::AT_TEXTURE, LLInventoryType::IT_TEXTURE,
+									   "Notes", ""));
+			mItems.push_back(make_item(mLinkFolder, LLAssetType::AT_LINK, LLInventoryType::IT_NOTECARD,
+									   "Notes link", ""));
+			// in a folder that isn't saved
+			mItems.push_back(make_item(LLUUID::generateNewID(), LLAssetType::AT_OBJECT, LLInventoryType::IT_OBJECT,
+									   "Dropped", ""));
+
+			mCategories.push_back(std::make_pair(mFolder, 7));
+			mCategories.push_back(std::make_pair(mLinkFolder, 12));
+			mCategories.push_back(std::make_pair(mEmptyFolder, 1));
+		}
+
+		~llinventorycache_test()
+		{
+			LLFile::remove(mFilename);
+		}
+
+		bool save()
+		{
+			LLInventoryCache::item_list_t items;
+			for (U32 i = 0; i < mItems.size(); ++i)
+			{
+				items.push_back(mItems[i]);
+			}
+			return LLInventoryCache::save(mFilename, TEST_VERSION, mCategories, items);
+		}
+
+		std::string mFilename;
+		LLUUID mFolder;
+		LLUUID mLinkFolder;
+		LLUUID mEmptyFolder;
+		LLInventoryCache::category_list_t mCategories;
+		std::vector<LLPointer<LLInventoryItem> > mItems;
+	};
+	typedef test_group<llinventorycache_test> llinventorycache_test_t;
+	typedef llinventorycache_test_t::object llinventorycache_test_object_t;
+	tut::llinventorycache_test_t tut_llinventorycache_test("LLInventoryCache");
+
+	// what is saved reads back the same, folder by folder
+	template<> template<>
+	void llinventorycache_test_object_t::test<1>()
+	{
+		ensure("saved", save());
+
+		LLInventoryCache cache;
+		bool is_obsolete = true;
+		ensure("opened", cache.open(mFilename, TEST_VERSION, is_obsolete));
+		ensure("not obsolete", !is_obsolete);
+		ensure_equals("categories", cache.getCategoryCount(), 3);
+
+		S32 folder = cache.findCategory(mFolder);
+		S32 link_folder = cache.findCategory(mLinkFolder);
+		S32 empty_folder = cache.findCategory(mEmptyFolder);
+		ensure("folders found", folder >= 0 && link_folder >= 0 && empty_folder >= 0);
+		ensure_equals("unknown folder", cache.findCategory(mItems[3]->getParentUUID()), -1);
+		ensure_equals("folder id", cache.getCategoryID(folder), mFolder);
+		ensure_equals("folder version", cache.getCategoryVersion(folder), 7);
+		ensure_equals("link folder version", cache.getCategoryVersion(link_folder), 12);
+		ensure_equals("folder items", cache.getItemCount(folder), 2);
+		ensure_equals("link folder items", cache.getItemCount(link_folder), 1);
+		ensure_equals("empty folder items", cache.getItemCount(empty_folder), 0);
+		ensure("folder has no links", !cache.hasLinks(folder));
+		ensure("link folder has links", cache.hasLinks(link_folder));
+
+		ensure_equals("item folder", cache.findItemCategory(mItems[1]->getUUID()), folder);
+		ensure_equals("link folder", cache.findItemCategory(mItems[2]->getUUID()), link_folder);
+		ensure_equals("dropped item", cache.findItemCategory(mItems[3]->getUUID()), -1);
+
+		LLInventoryCache::item_data_list_t items;
+		cache.getItems(folder, items);
+		ensure_equals("items read", items.size(), 2);
+		for (U32 i = 0; i < items.size(); ++i)
+		{
+			const LLInventoryCache::ItemData& data = items[i];
+			const LLInventoryItem* item = mItems[i];
+			ensure_equals("id", data.mID, item->getUUID());
+			ensure_equals("parent", data.mParentID, mFolder);
+			ensure_equals("asset", data.mAssetID, item->getAssetUUID());
+			ensure("permissions", data.mPermissions == item->getPermissions());
+			ensure_equals("type", data.mType, item->getType());
+			ensure_equals("inventory type", data.mInventoryType, item->getInventoryType());
+			ensure_equals("name", std::string(data.mName), item->getName());
+			ensure_equals("description", std::string(data.mDescription), item->getDescription());
+			ensure("sale info", data.mSaleInfo == item->getSaleInfo());
+			ensure_equals("flags", data.mFlags, item->getFlags());
+			ensure_equals("creation date", (time_t) data.mCreationDate, item->getCreationDate());
+		}
+		ensure("shared name stored once", items[0].mName == items[1].mName);
+	}
+
+	// no file is not obsolete, another version is
+	template<> template<>
+	void llinventorycache_test_object_t::test<2>()
+	{
+		LLFile::remove(mFilename);
+		LLInventoryCache cache;
+		bool is_obsolete = true;
+		ensure("no file", !cache.open(mFilename, TEST_VERSION, is_obsolete));
+		ensure("no file isn't obsolete", !is_obsolete);
+
+		ensure("saved", save());
+		ensure("other version", !cache.open(mFilename, TEST_VERSION + 1, is_obsolete));
+		ensure("other version is obsolete", is_obsolete);
+	}
+
+	// every cut short file is refused
+	template<> template<>
+	void llinventorycache_test_object_t::test<3>()
+	{
+		ensure("saved", save());
+		const std::vector<U8> data = read_file(mFilename);
+		ensure("file read", data.size() > HEADER_SIZE);
+
+		for (size_t size = 1; size < data.size(); ++size)
+		{
+			std::vector<U8> truncated(data.begin(), data.begin() + size);
+			ensure(llformat("truncated to %u bytes", (U32) size), rejected(mFilename, truncated));
+		}
+		std::vector<U8> extended(data);
+		extended.push_back(0);
+		ensure("trailing byte", rejected(mFilename, extended));
+	}
+
+	// counts, item ranges and strings that don't fit the file are refused
+	template<> template<>
+	void llinventorycache_test_object_t::test<4>()
+	{
+		ensure("saved", save());
+		const std::vector<U8> data = read_file(mFilename);
+		const size_t item_index_offset = HEADER_SIZE + 3 * CATEGORY_SIZE + 3 * ITEM_SIZE;
+		ensure("layout", data.size() > item_index_offset + 3 * ITEM_INDEX_SIZE);
+
+		std::vector<U8> damaged(data);
+		damaged[0] ^= 0xff;
+		ensure("bad magic", rejected(mFilename, damaged));
+
+		damaged = data;
+		set_u32(damaged, ITEM_COUNT_OFFSET, 0x40000000);
+		ensure("item count past the end", rejected(mFilename, damaged));
+
+		damaged = data;
+		set_u32(damaged, ITEM_COUNT_OFFSET, 0xffffffff);
+		ensure("huge item count", rejected(mFilename, damaged));
+
+		// the first folder's items starting past the last item
+		damaged = data;
+		set_u32(damaged, HEADER_SIZE + FIRST_ITEM_OFFSET, 3);
+		set_u32(damaged, HEADER_SIZE + FIRST_ITEM_OFFSET + 4, 1);
+		ensure("item range past the end", rejected(mFilename, damaged));
+
+		// a count that would wrap the end of the range around
+		damaged = data;
+		set_u32(damaged, HEADER_SIZE + FIRST_ITEM_OFFSET, 1);
+		set_u32(damaged, HEADER_SIZE + FIRST_ITEM_OFFSET + 4, 0xffffffff);
+		ensure("wrapping item range", rejected(mFilename, damaged));
+
+		// an item indexed under a folder that isn't there
+		damaged = data;
+		set_u32(damaged, item_index_offset + 16, 3);
+		ensure("item index past the folders", rejected(mFilename, damaged));
+
+		damaged = data;
+		damaged.back() = 'x';
+		ensure("unterminated strings", rejected(mFilename, damaged));
+
+		write_file(mFilename, data);
+		LLInventoryCache cache;
+		bool is_obsolete = false;
+		ensure("undamaged copy opens", cache.open(mFilename, TEST_VERSION, is_obsolete));
+	}
+}
@@ -0,0 +1,644 @@
+/**
+ * @file llobjectupdatedecoder_test.cpp
+ * @brief LLObjectUpdateDecoder tests, blocks of a simulated message decoded
+ * with and without the decoder threads.
+ *
+ * $LicenseInfo:firstyear=2016&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2016, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llobjectupdatedecoder.h"
+
+#include "lldatapacker.h"
+#include "llquantize.h"
+#include "llthread.h"
+#include "lltimer.h"
+#include "llvolumemessage.h"
+#include "message.h"
+#include "object_flags.h"
+
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+// A simulated ObjectData block, the message getters below read the block
+// they are asked for and nothing else.
+struct TestBlock
+{
+	LLUUID				mFullID;
+	U32					mID;
+	U8					mPCode;
+	U32					mUpdateFlags;
+	std::vector<U8>		mData;
+	std::vector<U8>		mTextureEntry;
+};
+static std::vector<TestBlock> sBlocks;
+
+// the threads that read the message, to tell where a batch was decoded
+static LLMutex* sReadersMutex = NULL;
+static std::set<boost::thread::id> sReaders;
+
+static void note_reader()
+{
+	LLMutexLock lock(sReadersMutex);
+	sReaders.insert(LLThread::currentID());
+}
+
+char const* const _PREHASH_ObjectData = "ObjectData";
+char const* const _PREHASH_Data = "Data";
+char const* const _PREHASH_UpdateFlags = "UpdateFlags";
+char const* const _PREHASH_ID = "ID";
+char const* const _PREHASH_FullID = "FullID";
+char const* const _PREHASH_PCode = "PCode";
+char const* const _PREHASH_TextureEntry = "TextureEntry";
+
+static const std::vector<U8>& binary_var(S32 blocknum, const char* varname)
+{
+	return varname == _PREHASH_Data ? sBlocks[blocknum].mData : sBlocks[blocknum].mTextureEntry;
+}
+
+S32 LLMessageSystem::getNumberOfBlocksFast(const char* blockname) const
+{
+	return sBlocks.size();
+}
+
+S32 LLMessageSystem::getSizeFast(const char* blockname, S32 blocknum, const char* varname) const
+{
+	return binary_var(blocknum, varname).size();
+}
+
+void LLMessageSystem::getBinaryDataFast(const char* blockname, const char* varname, void* datap, S32 size, S32 blocknum, S32 max_size)
+{
+	note_reader();
+	const std::vector<U8>& data = binary_var(blocknum, varname);
+	memcpy(datap, &data[0], llmin((S32) data.size(), max_size));
+}
+
+void LLMessageSystem::getU32Fast(const char* block, const char* var, U32& data, S32 blocknum)
+{
+	note_reader();
+	data = var == _PREHASH_UpdateFlags ? sBlocks[blocknum].mUpdateFlags : sBlocks[blocknum].mID;
+}
+
+void LLMessageSystem::getUUIDFast(const char* block, const char* var, LLUUID& uuid, S32 blocknum)
+{
+	uuid = sBlocks[blocknum].mFullID;
+}
+
+void LLMessageSystem::getU8Fast(const char* block, const char* var, U8& data, S32 blocknum)
+{
+	data = sBlocks[blocknum].mPCode;
+}
+
+// hands the block's id over as the sculpt id, so it shows which block the
+// params came from
+bool LLVolumeMessage::unpackVolumeParams(LLVolumeParams* params, LLMessageSystem* mesgsys, char const* block_name, S32 block_num)
+{
+	LLProfileParams profile;
+	LLPathParams path;
+	*params = LLVolumeParams(profile, path, sBlocks[block_num].mFullID);
+	return true;
+}
+
+// reports the first packed byte, so it shows which block's entries it was
+// handed
+S32 LLPrimitive::parseTEContents(LLTEContents& tec, U32 face_count)
+{
+	tec.face_count = face_count;
+	return tec.size ? tec.packed_buffer[0] : 0;
+}
+
+// reads the sculpt id the test packed in place of the volume params
+bool LLVolumeMessage::unpackVolumeParams(LLVolumeParams* params, LLDataPacker& dp)
+{
+	LLUUID id;
+	dp.unpackUUID(id, "SculptID");
+	LLProfileParams profile;
+	LLPathParams path;
+	*params = LLVolumeParams(profile, path, id);
+	return true;
+}
+
+// Simulated extra parameters and texture animation, each reads a single
+// byte and keeps it where the test can see it.
+static BOOL unpack_byte(LLDataPacker& dp, U16& value)
+{
+	U8 byte = 0;
+	BOOL ok = dp.unpackU8(byte, "byte");
+	value = byte;
+	return ok;
+}
+
+LLLightParams::LLLightParams()											{ mType = 0; }
+BOOL LLLightParams::pack(LLDataPacker& dp) const						{ return FALSE; }
+BOOL LLLightParams::unpack(LLDataPacker& dp)							{ return unpack_byte(dp, mType); }
+bool LLLightParams::operator==(const LLNetworkData& data) const			{ return false; }
+void LLLightParams::copy(const LLNetworkData& data)						{}
+LLFlexibleObjectData::LLFlexibleObjectData()							{ mType = 0; }
+BOOL LLFlexibleObjectData::pack(LLDataPacker& dp) const					{ return FALSE; }
+BOOL LLFlexibleObjectData::unpack(LLDataPacker& dp)						{ return unpack_byte(dp, mType); }
+bool LLFlexibleObjectData::operator==(const LLNetworkData& data) const	{ return false; }
+void LLFlexibleObjectData::copy(const LLNetworkData& data)				{}
+LLSculptParams::LLSculptParams()										{ mType = 0; }
+BOOL LLSculptParams::pack(LLDataPacker& dp) const						{ return FALSE; }
+BOOL LLSculptParams::unpack(LLDataPacker& dp)							{ return unpack_byte(dp, mType); }
+bool LLSculptParams::operator==(const LLNetworkData& data) const		{ return false; }
+void LLSculptParams::copy(const LLNetworkData& data)					{}
+LLLightImageParams::LLLightImageParams()								{ mType = 0; }
+BOOL LLLightImageParams::pack(LLDataPacker& dp) const					{ return FALSE; }
+BOOL LLLightImageParams::unpack(LLDataPacker& dp)						{ return unpack_byte(dp, mType); }
+bool LLLightImageParams::operator==(const LLNetworkData& data) const	{ return false; }
+void LLLightImageParams::copy(const LLNetworkData& data)				{}
+
+LLTextureAnim::LLTextureAnim()											{ reset(); }
+LLTextureAnim::~LLTextureAnim()											{}
+void LLTextureAnim::reset()												{ mMode = 0; }
+void LLTextureAnim::unpackTAMessage(LLDataPacker& dp)					{ dp.unpackU8(mMode, "Mode"); }
+
+LLMaterialID::LLMaterialID() {}
+LLMaterialID::LLMaterialID(const LLMaterialID& pOtherMaterialID) {}
+LLMaterialID::~LLMaterialID() {}
+
+// End Stubbing
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	const U32 BLOCKS = 40;
+
+	// never looked into, the message is sBlocks
+	char sMessageStandIn;
+	LLMessageSystem* message()						{ return reinterpret_cast<LLMessageSystem*>(&sMessageStandIn); }
+
+	LLUUID block_id(U32 i)
+	{
+		LLUUID id;
+		id.generate(llformat("block %d", i));
+		return id;
+	}
+
+	// full updates, every other block a volume with texture entries
+	void make_full_blocks(U32 count)
+	{
+		sBlocks.clear();
+		for (U32 i = 0; i < count; ++i)
+		{
+			TestBlock block;
+			block.mFullID = block_id(i);
+			block.mID = 1000 + i;
+			block.mPCode = i % 2 ? LL_PCODE_VOLUME : LL_PCODE_LEGACY_TREE;
+			block.mUpdateFlags = 0;
+			block.mTextureEntry.assign(8 + i, (U8) (i + 1));
+			sBlocks.push_back(block);
+		}
+	}
+
+	const U32 BODY_FLAGS = 0x80 | 0x20 | 0x1 | 0x4 | 0x200 | 0x10 | 0x100 | 0x40 | 0x400;
+	const U16 UNKNOWN_PARAMS = 0x70;
+
+	LLUUID owner_id(U32 i)
+	{
+		LLUUID id;
+		id.generate(llformat("owner %d", i));
+		return id;
+	}
+
+	// what a full compressed or cached update of a volume carries after its
+	// ids, with every optional part there
+	void pack_full_body(LLDataPacker& dp, U32 i)
+	{
+		dp.packU8(i, "State");
+		dp.packU32(100 + i, "CRC");
+		dp.packU8(3, "Material");
+		dp.packU8(1, "ClickAction");
+		dp.packVector3(LLVector3(1.f, 2.f, (F32) i), "Scale");
+		dp.packVector3(LLVector3(10.f, 20.f, (F32) i), "Pos");
+		dp.packVector3(LLVector3::zero, "Rot");
+		dp.packU32(BODY_FLAGS, "SpecialCode");
+		dp.packUUID(owner_id(i), "Owner");
+		dp.packVector3(LLVector3(0.f, 0.f, 1.f), "Omega");
+		dp.packU32(500 + i, "ParentID");
+		U8 scratch_pad[3] = { 7, 8, (U8) i };
+		dp.packU32(16, "ScratchPadSize");
+		dp.packBinaryData(scratch_pad, sizeof(scratch_pad), "PartData");
+		dp.packString(llformat("text %d", i), "Text");
+		U8 color[4] = { 1, 2, 3, 55 };
+		dp.packBinaryDataFixed(color, 4, "Color");
+		dp.packString("http://example.com/", "MediaURL");
+
+		// a light, one the viewer doesn't know and a mesh, kept as a sculpt
+		dp.packU8(3, "num_params");
+		U8 param = (U8) i;
+		dp.packU16(LLNetworkData::PARAMS_LIGHT, "param_type");
+		dp.packBinaryData(&param, 1, "param_data");
+		dp.packU16(UNKNOWN_PARAMS, "param_type");
+		dp.packBinaryData(&param, 1, "param_data");
+		param = 200;
+		dp.packU16(LLNetworkData::PARAMS_MESH, "param_type");
+		dp.packBinaryData(&param, 1, "param_data");
+
+		dp.packUUID(block_id(i), "SoundUUID");
+		dp.packF32(0.5f, "SoundGain");
+		dp.packU8(2, "SoundFlags");
+		dp.packF32(4.f, "SoundRadius");
+		dp.packString(llformat("Name STRING RW SV %d", i), "NV");
+
+		// the volume's own part
+		dp.packUUID(block_id(i), "SculptID");
+		U8 entries[4] = { (U8) (i + 1), 0, 0, 0 };
+		dp.packBinaryData(entries, sizeof(entries), "TextureEntry");
+		dp.packU8(LLTextureAnim::ON, "Mode");
+		// a particle system this viewer can't parse
+		dp.packS32(0, "syssize");
+		dp.packS32(0, "partsize");
+	}
+
+	void pack_terse_body(LLDataPacker& dp, U32 i)
+	{
+		dp.packU8(i, "State");
+		dp.packU8(i % 2, "agent");
+		if (i % 2)
+		{
+			dp.packVector4(LLVector4(0.f, 0.f, 1.f, (F32) i), "Plane");
+		}
+		dp.packVector3(LLVector3(5.f, 6.f, (F32) i), "Pos");
+		for (S32 axis = 0; axis < 3; ++axis)
+		{
+			dp.packU16(F32_to_U16(2.f, -128.f, 128.f), "Vel");
+		}
+		for (S32 axis = 0; axis < 3; ++axis)
+		{
+			dp.packU16(F32_to_U16(-1.f, -64.f, 64.f), "Acc");
+		}
+		for (S32 axis = 0; axis < 4; ++axis)
+		{
+			dp.packU16(F32_to_U16(axis == 3 ? 1.f : 0.f, -1.f, 1.f), "Theta");
+		}
+		for (S32 axis = 0; axis < 3; ++axis)
+		{
+			dp.packU16(F32_to_U16(3.f, -64.f, 64.f), "Omega");
+		}
+	}
+
+	// compressed updates, every third block temporary so it's unpacked
+	// rather than cached
+	void make_compressed_blocks(U32 count, bool terse)
+	{
+		sBlocks.clear();
+		for (U32 i = 0; i < count; ++i)
+		{
+			TestBlock block;
+			block.mID = 0;
+			block.mPCode = 0;
+			block.mUpdateFlags = i % 3 ? 0 : FLAGS_TEMPORARY_ON_REZ;
+
+			U8 buffer[1024];
+			LLDataPackerBinaryBuffer dp(buffer, sizeof(buffer));
+			if (!terse)
+			{
+				dp.packUUID(block_id(i), "ID");
+			}
+			dp.packU32(2000 + i, "LocalID");
+			if (!terse)
+			{
+				dp.packU8(LL_PCODE_VOLUME, "PCode");
+				pack_full_body(dp, i);
+			}
+			else
+			{
+				pack_terse_body(dp, i);
+			}
+			block.mData.assign(buffer, buffer + dp.getCurrentSize());
+			sBlocks.push_back(block);
+		}
+	}
+
+	bool is_close(const LLVector3& a, const LLVector3& b)
+	{
+		return dist_vec(a, b) < 0.01f;
+	}
+
+	void decode(LLObjectUpdateDecoder& decoder, EObjectUpdateType update_type, bool compressed)
+	{
+		{
+			LLMutexLock lock(sReadersMutex);
+			sReaders.clear();
+		}
+		decoder.decode(message(), update_type, compressed);
+	}
+}
+
+namespace tut
+{
+	struct objectupdatedecoder_test
+	{
+		objectupdatedecoder_test()
+		{
+			sReadersMutex = new LLMutex();
+		}
+
+		~objectupdatedecoder_test()
+		{
+			delete sReadersMutex;
+			sReadersMutex = NULL;
+			sBlocks.clear();
+		}
+
+		// every record holds its own block, the same way whichever thread
+		// decoded it
+		void ensure_full_records(const std::string& msg, LLObjectUpdateDecoder& decoder)
+		{
+			ensure_equals(msg + " count", decoder.getCount(), (S32) sBlocks.size());
+			for (S32 i = 0; i < decoder.getCount(); ++i)
+			{
+				const LLObjectUpdateRecord& record = decoder.getRecord(i);
+				const TestBlock& block = sBlocks[i];
+				std::string at = msg + llformat(" block %d", i);
+				ensure_equals(at + " block", record.mBlock, i);
+				ensure_equals(at + " full id", record.mFullID, block.mFullID);
+				ensure_equals(at + " local id", record.mLocalID, block.mID);
+				ensure_equals(at + " pcode", record.mPCode, block.mPCode);
+				ensure_equals(at + " no data", record.mDataSize, 0);
+				bool volume = block.mPCode == LL_PCODE_VOLUME;
+				ensure_equals(at + " volume params", record.mHasVolumeParams, volume);
+				if (volume)
+				{
+					ensure_equals(at + " volume params of the block", record.mVolumeParams.getSculptID(), block.mFullID);
+					ensure_equals(at + " texture entry size", record.mTEContents.size, (U32) block.mTextureEntry.size());
+					ensure_equals(at + " texture entries of the block", record.mTEResult, (S32) block.mTextureEntry[0]);
+					ensure_equals(at + " every face parsed", record.mTEContents.face_count, (U32) LLTEContents::MAX_TES);
+				}
+				else
+				{
+					ensure_equals(at + " no texture entries", record.mTEResult, 0);
+				}
+			}
+		}
+
+		void ensure_compressed_records(const std::string& msg, LLObjectUpdateDecoder& decoder, bool terse)
+		{
+			ensure_equals(msg + " count", decoder.getCount(), (S32) sBlocks.size());
+			for (S32 i = 0; i < decoder.getCount(); ++i)
+			{
+				const LLObjectUpdateRecord& record = decoder.getRecord(i);
+				const TestBlock& block = sBlocks[i];
+				std::string at = msg + llformat(" block %d", i);
+				ensure_equals(at + " block", record.mBlock, i);
+				ensure_equals(at + " data size", record.mDataSize, (S32) block.mData.size());
+				ensure(at + " data of the block", !memcmp(record.mData, &block.mData[0], block.mData.size()));
+				bool unpacked = terse || (block.mUpdateFlags & FLAGS_TEMPORARY_ON_REZ);
+				ensure_equals(at + " volume params", record.mHasVolumeParams, unpacked && !terse);
+				ensure_equals(at + " update flags", record.mUpdateFlags, terse ? 0U : block.mUpdateFlags);
+				ensure_equals(at + " local id", record.mLocalID, unpacked ? 2000U + i : 0U);
+				ensure_equals(at + " full id", record.mFullID, unpacked && !terse ? block_id(i) : LLUUID::null);
+				ensure_equals(at + " pcode", record.mPCode, (LLPCode) (unpacked && !terse ? LL_PCODE_VOLUME : 0));
+
+				ensure_equals(at + " unpacked", record.mHasBody, unpacked);
+				if (!unpacked)
+				{
+					// left for the object cache
+					continue;
+				}
+				ensure_equals(at + " state", record.mState, (U8) i);
+				if (terse)
+				{
+					ensure_terse_body(at, record, i);
+				}
+				else
+				{
+					ensure_full_body(at, record, i);
+				}
+			}
+		}
+
+		// everything pack_full_body() packed, as the objects will apply it
+		void ensure_full_body(const std::string& at, const LLObjectUpdateRecord& record, U32 i)
+		{
+			ensure_equals(at + " crc", record.mCRC, 100U + i);
+			ensure_equals(at + " material", record.mMaterial, (U8) 3);
+			ensure_equals(at + " click action", record.mClickAction, (U8) 1);
+			ensure_equals(at + " scale", record.mScale, LLVector3(1.f, 2.f, (F32) i));
+			ensure_equals(at + " position", record.mPosition, LLVector3(10.f, 20.f, (F32) i));
+			ensure_equals(at + " pass flags", record.mPassFlags, BODY_FLAGS);
+			ensure_equals(at + " owner", record.mOwnerID, owner_id(i));
+			ensure_equals(at + " angular velocity", record.mAngularVelocity, LLVector3(0.f, 0.f, 1.f));
+			ensure_equals(at + " parent", record.mParentID, 500U + i);
+			ensure_equals(at + " scratch pad size", record.mScratchPadSize, 16U);
+			ensure_equals(at + " scratch pad", record.mScratchPad.size(), (size_t) 3);
+			ensure_equals(at + " scratch pad data", record.mScratchPad[2], (U8) i);
+			ensure_equals(at + " text", record.mText, llformat("text %d", i));
+			ensure_equals(at + " text alpha", record.mTextColor.mV[3], (U8) 200);
+			ensure_equals(at + " media url", record.mMediaURL, std::string("http://example.com/"));
+			ensure(at + " no legacy particles", !record.mHasLegacyPartSys);
+
+			ensure_equals(at + " known params", record.mParamTypes.size(), (size_t) 2);
+			ensure_equals(at + " light first", record.mParamTypes[0], (U16) LLNetworkData::PARAMS_LIGHT);
+			ensure_equals(at + " mesh as sculpt", record.mParamTypes[1], (U16) LLNetworkData::PARAMS_SCULPT);
+			ensure_equals(at + " light data", record.getExtraParams(LLNetworkData::PARAMS_LIGHT)->mType, (U16) i);
+			ensure_equals(at + " mesh data", record.getExtraParams(LLNetworkData::PARAMS_SCULPT)->mType, (U16) 200);
+			ensure(at + " unknown params", !record.getExtraParams(UNKNOWN_PARAMS));
+
+			ensure_equals(at + " sound", record.mSoundID, block_id(i));
+			ensure_equals(at + " sound gain", record.mSoundGain, 0.5f);
+			ensure_equals(at + " sound flags", record.mSoundFlags, (U8) 2);
+			ensure_equals(at + " name values", record.mNameValues, llformat("Name STRING RW SV %d", i));
+
+			ensure(at + " volume params", record.mHasVolumeParams);
+			ensure_equals(at + " volume params of the block", record.mVolumeParams.getSculptID(), block_id(i));
+			ensure_equals(at + " texture entries of the block", record.mTEResult, (S32) i + 1);
+			ensure_equals(at + " every face parsed", record.mTEContents.face_count, (U32) LLTEContents::MAX_TES);
+			ensure_equals(at + " texture animation", record.mTextureAnim.mMode, (U8) LLTextureAnim::ON);
+			ensure(at + " particles this viewer can't parse", !record.mHasPartSys);
+		}
+
+		void ensure_terse_body(const std::string& at, const LLObjectUpdateRecord& record, U32 i)
+		{
+			ensure_equals(at + " foot plane", record.mHasFootPlane, (bool) (i % 2));
+			if (record.mHasFootPlane)
+			{
+				ensure_equals(at + " foot plane of the block", record.mFootPlane.mV[VW], (F32) i);
+			}
+			ensure_equals(at + " position", record.mPosition, LLVector3(5.f, 6.f, (F32) i));
+			ensure(at + " velocity", is_close(record.mVelocity, LLVector3(2.f, 2.f, 2.f)));
+			ensure(at + " acceleration", is_close(record.mAcceleration, LLVector3(-1.f, -1.f, -1.f)));
+			ensure(at + " rotation", dist_vec(LLVector4(record.mRotation.mQ), LLVector4(0.f, 0.f, 0.f, 1.f)) < 0.01f);
+			ensure(at + " angular velocity", is_close(record.mAngularVelocity, LLVector3(3.f, 3.f, 3.f)));
+		}
+	};
+	typedef test_group<objectupdatedecoder_test> objectupdatedecoder_t;
+	typedef objectupdatedecoder_t::object objectupdatedecoder_object_t;
+	tut::objectupdatedecoder_t tut_objectupdatedecoder("LLObjectUpdateDecoder");
+
+	// full updates come out in block order, on the caller alone and on the
+	// threads
+	template<> template<>
+	void objectupdatedecoder_object_t::test<1>()
+	{
+		make_full_blocks(BLOCKS);
+
+		LLObjectUpdateDecoder inline_decoder(0);
+		ensure_equals("no threads", inline_decoder.getThreadCount(), 0U);
+		decode(inline_decoder, OUT_FULL, false);
+		ensure_full_records("inline", inline_decoder);
+
+		LLObjectUpdateDecoder threaded_decoder(3);
+		ensure_equals("threads", threaded_decoder.getThreadCount(), 3U);
+		for (S32 pass = 0; pass < 20; ++pass)
+		{
+			decode(threaded_decoder, OUT_FULL, false);
+			ensure_full_records(llformat("threaded pass %d", pass), threaded_decoder);
+		}
+	}
+
+	// compressed and terse compressed updates are unpacked whole, apart from
+	// the blocks that go to the object cache
+	template<> template<>
+	void objectupdatedecoder_object_t::test<2>()
+	{
+		LLObjectUpdateDecoder inline_decoder(0);
+		LLObjectUpdateDecoder threaded_decoder(3);
+
+		make_compressed_blocks(BLOCKS, false);
+		decode(inline_decoder, OUT_FULL_COMPRESSED, true);
+		ensure_compressed_records("inline compressed", inline_decoder, false);
+		decode(threaded_decoder, OUT_FULL_COMPRESSED, true);
+		ensure_compressed_records("threaded compressed", threaded_decoder, false);
+
+		make_compressed_blocks(BLOCKS, true);
+		decode(inline_decoder, OUT_TERSE_IMPROVED, true);
+		ensure_compressed_records("inline terse", inline_decoder, true);
+		decode(threaded_decoder, OUT_TERSE_IMPROVED, true);
+		ensure_compressed_records("threaded terse", threaded_decoder, true);
+	}
+
+	// a small message is decoded on the calling thread without waking the
+	// threads, and a message without blocks decodes nothing
+	template<> template<>
+	void objectupdatedecoder_object_t::test<3>()
+	{
+		LLObjectUpdateDecoder decoder(3);
+
+		make_full_blocks(4);
+		decode(decoder, OUT_FULL, false);
+		ensure_full_records("small", decoder);
+		ensure_equals("one reader", sReaders.size(), (size_t) 1);
+		ensure("read by the caller", *sReaders.begin() == LLThread::currentID());
+
+		sBlocks.clear();
+		decode(decoder, OUT_FULL, false);
+		ensure_equals("no records", decoder.getCount(), 0);
+		ensure("nothing read", sReaders.empty());
+	}
+
+	// records are reused, a smaller message after a larger one leaves
+	// nothing of the larger one in the records it covers
+	template<> template<>
+	void objectupdatedecoder_object_t::test<4>()
+	{
+		LLObjectUpdateDecoder decoder(3);
+
+		make_full_blocks(BLOCKS);
+		decode(decoder, OUT_FULL, false);
+		ensure_full_records("full", decoder);
+
+		make_compressed_blocks(BLOCKS / 2, false);
+		decode(decoder, OUT_FULL_COMPRESSED, true);
+		ensure_compressed_records("compressed after full", decoder, false);
+
+		sBlocks.clear();
+		for (U32 i = 0; i < 10; ++i)
+		{
+			TestBlock block;
+			block.mID = 3000 + i;
+			block.mPCode = LL_PCODE_VOLUME;
+			block.mUpdateFlags = 0;
+			sBlocks.push_back(block);
+		}
+		decode(decoder, OUT_TERSE_IMPROVED, false);
+		ensure_equals("terse count", decoder.getCount(), 10);
+		for (S32 i = 0; i < decoder.getCount(); ++i)
+		{
+			const LLObjectUpdateRecord& record = decoder.getRecord(i);
+			std::string at = llformat("terse block %d", i);
+			ensure_equals(at + " block", record.mBlock, i);
+			ensure_equals(at + " local id", record.mLocalID, 3000U + i);
+			ensure_equals(at + " no full id", record.mFullID, LLUUID::null);
+			ensure_equals(at + " no pcode", record.mPCode, (LLPCode) 0);
+			ensure_equals(at + " no flags", record.mUpdateFlags, 0U);
+			ensure_equals(at + " no data", record.mDataSize, 0);
+			ensure(at + " nothing unpacked", !record.mHasBody);
+			ensure(at + " no volume params", !record.mHasVolumeParams);
+			ensure_equals(at + " no texture entries", record.mTEResult, 0);
+		}
+	}
+
+	// the threads go away with the decoder, whether they never had a batch
+	// or just finished one
+	template<> template<>
+	void objectupdatedecoder_object_t::test<5>()
+	{
+		LLTimer timer;
+		{
+			LLObjectUpdateDecoder idle(4);
+		}
+
+		make_full_blocks(BLOCKS);
+		for (S32 i = 0; i < 20; ++i)
+		{
+			LLObjectUpdateDecoder decoder(4);
+			decode(decoder, OUT_FULL, false);
+			ensure_full_records(llformat("decoder %d", i), decoder);
+		}
+		ensure("threads stopped promptly", timer.getElapsedTimeF32() < 10.f);
+	}
+
+	// a cached block unpacks on the main thread the same way the decoder
+	// threads unpack one that came in a message
+	template<> template<>
+	void objectupdatedecoder_object_t::test<6>()
+	{
+		make_compressed_blocks(3, false);
+		LLObjectUpdateDecoder decoder(0);
+		decode(decoder, OUT_FULL_COMPRESSED, true);
+		ensure_compressed_records("compressed", decoder, false);
+
+		// block 1 went to the cache
+		ensure("cached", !decoder.getRecord(1).mHasBody);
+		std::vector<U8> cached(sBlocks[1].mData);
+		LLDataPackerBinaryBuffer dp(&cached[0], cached.size());
+		LLObjectUpdateRecord record;
+		LLObjectUpdateDecoder::unpackCompressed(dp, OUT_FULL_CACHED, record);
+		ensure("unpacked", record.mHasBody);
+		ensure_equals("full id", record.mFullID, block_id(1));
+		ensure_equals("local id", record.mLocalID, 2001U);
+		ensure_equals("pcode", record.mPCode, (LLPCode) LL_PCODE_VOLUME);
+		ensure_equals("state", record.mState, (U8) 1);
+		ensure_full_body("cached", record, 1);
+	}
+}
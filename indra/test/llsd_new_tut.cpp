@@ -30,6 +30,7 @@
 #include "linden_common.h"
 #include "lltut.h"
 
+#include "llformat.h"
 #include "llsdtraits.h"
 #include "llstring.h"
 
@@ -811,6 +812,72 @@ namespace tut
 		ensure("type is a string", v.isString());
 	}
 
+	template<> template<>
+	void SDTestObject::test<15>()
+		// maps behave like the std::map they used to be, with short
+		// interned and long owned keys mixed
+	{
+		std::map<std::string, int> expected;
+		LLSD m = LLSD::emptyMap();
+		srand(15);
+		for (int i = 0; i < 50000; ++i)
+		{
+			std::string key = (rand() % 3) ? llformat("k%d", rand() % 200)
+										   : llformat("a key far too long to be worth interning %d", rand() % 40);
+			switch (rand() % 4)
+			{
+			case 0:
+				m[key] = i;
+				expected[key] = i;
+				break;
+			case 1:
+				m.insert(key, i);
+				expected.insert(std::make_pair(key, i));
+				break;
+			case 2:
+				m.erase(key);
+				expected.erase(key);
+				break;
+			default:
+				ensure_equals("has", m.has(key), expected.count(key) > 0);
+				ensure_equals("get", m.get(key).asInteger(), expected.count(key) ? expected[key] : 0);
+				break;
+			}
+
+			if (i % 5000 == 0)
+			{
+				ensure_equals("size", m.size(), (int) expected.size());
+				std::map<std::string, int>::const_iterator e = expected.begin();
+				for (LLSD::map_const_iterator it = m.beginMap(); it != m.endMap(); ++it, ++e)
+				{
+					ensure_equals("key order", it->first, e->first);
+					ensure_equals("value", it->second.asInteger(), e->second);
+				}
+
+				LLSD copy(m);
+				copy["~"] = 1;
+				ensure("copy on write", !m.has("~") && copy.has("~"));
+				ensure_equals("copy size", copy.size(), m.size() + 1);
+			}
+		}
+
+		// values don't move while their map grows
+		LLSD grown;
+		LLSD& value = grown["first"];
+		for (int i = 0; i < 1000; ++i)
+		{
+			grown[llformat("%04d", i)] = i;
+		}
+		value = "still here";
+		ensure_equals("reference kept", grown["first"].asString(), std::string("still here"));
+
+		LLSD::map_iterator it = grown.beginMap();
+		it->second = 7;
+		LLSD::map_const_iterator const_it = it;
+		ensure("iterators convert", const_it == grown.beginMap());
+		ensure_equals("written through iterator", grown["0000"].asInteger(), 7);
+	}
+
 	/* TO DO:
 		conversion of undefined to UUID, Date, URI and Binary
 		conversion of undefined to map and array
@@ -46,12 +46,13 @@
 
 namespace tut
 {	
-	static LLTemplateMessageBuilder::message_template_name_map_t templateNameMap;
-
     LLMsgData* messageData = NULL;
     LLMsgBlkData* messageBlockData = NULL;
 
 	struct LLSDMessageBuilderTestData {
+		// Tests add templates that live on their stack, so each one
+		// gets its own table.
+		LLMessageTemplateTable templateTable;
 
 		LLSDMessageBuilderTestData()
 		{
@@ -97,10 +98,10 @@ namespace tut
 			return result;
 		}
 
-		static LLTemplateMessageBuilder* defaultTemplateBuilder(LLMessageTemplate& messageTemplate, char* name = const_cast<char*>(_PREHASH_Test0))
+		LLTemplateMessageBuilder* defaultTemplateBuilder(LLMessageTemplate& messageTemplate, char* name = const_cast<char*>(_PREHASH_Test0))
 		{
-			templateNameMap[_PREHASH_TestMessage] = &messageTemplate;
-			LLTemplateMessageBuilder* builder = new LLTemplateMessageBuilder(templateNameMap);
+			templateTable.add(&messageTemplate);
+			LLTemplateMessageBuilder* builder = new LLTemplateMessageBuilder(templateTable);
 			builder->newMessage(_PREHASH_TestMessage);
 			builder->nextBlock(name);
 			return builder;
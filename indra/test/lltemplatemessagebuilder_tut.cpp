@@ -43,11 +43,12 @@
 
 namespace tut
 {	
-	static LLTemplateMessageBuilder::message_template_name_map_t nameMap;
-	static LLTemplateMessageReader::message_template_number_map_t numberMap;
-
 	struct LLTemplateMessageBuilderTestData 
 	{
+		// Tests add templates that live on their stack, so each one
+		// gets its own table.
+		LLMessageTemplateTable templateTable;
+
 		static LLMessageTemplate defaultTemplate()
 		{
 			static bool init = false;
@@ -88,29 +89,29 @@ namespace tut
 			return result;
 		}
 
-		static LLTemplateMessageBuilder* defaultBuilder(LLMessageTemplate& messageTemplate, char* name = const_cast<char*>(_PREHASH_Test0))
+		LLTemplateMessageBuilder* defaultBuilder(LLMessageTemplate& messageTemplate, char* name = const_cast<char*>(_PREHASH_Test0))
 		{
-			nameMap[_PREHASH_TestMessage] = &messageTemplate;
-			LLTemplateMessageBuilder* builder = new LLTemplateMessageBuilder(nameMap);
+			templateTable.add(&messageTemplate);
+			LLTemplateMessageBuilder* builder = new LLTemplateMessageBuilder(templateTable);
 			builder->newMessage(_PREHASH_TestMessage);
 			builder->nextBlock(name);
 			return builder;
 		}
 
 		/** Takes ownership of builder */
-		static LLTemplateMessageReader* setReader(
+		LLTemplateMessageReader* setReader(
 			LLMessageTemplate& messageTemplate,
 			LLTemplateMessageBuilder* builder,
 			U8 offset = 0)
 		{
-			numberMap[1] = &messageTemplate;
+			templateTable.add(&messageTemplate);
 			const U32 bufferSize = 1024;
 			U8 buffer[bufferSize];
 			// zero out the packet ID field
 			memset(buffer, 0, LL_PACKET_ID_SIZE);
 			U32 builtSize = builder->buildMessage(buffer, bufferSize, offset);
 			delete builder;
-			LLTemplateMessageReader* reader = new LLTemplateMessageReader(numberMap);
+			LLTemplateMessageReader* reader = new LLTemplateMessageReader(templateTable);
 			reader->validateMessage(buffer, builtSize, LLHost());
 			reader->readMessage(buffer, LLHost());
 			return reader;
@@ -884,9 +885,9 @@ namespace tut
 		messageTemplate.addBlock(createBlock(const_cast<char*>(_PREHASH_Test1), MVT_U32, 4, MBT_SINGLE));
 
 		// read message value and default value
-		numberMap[1] = &messageTemplate;
+		templateTable.add(&messageTemplate);
 		LLTemplateMessageReader* reader = 
-			new LLTemplateMessageReader(numberMap);
+			new LLTemplateMessageReader(templateTable);
 		reader->validateMessage(buffer, builtSize, LLHost());
 		reader->readMessage(buffer, LLHost());
 		reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outValue);
@@ -917,9 +918,9 @@ namespace tut
 		messageTemplate.addBlock(createBlock(const_cast<char*>(_PREHASH_Test1), MVT_U32, 4));
 
 		// read message value and check block repeat count
-		numberMap[1] = &messageTemplate;
+		templateTable.add(&messageTemplate);
 		LLTemplateMessageReader* reader = 
-			new LLTemplateMessageReader(numberMap);
+			new LLTemplateMessageReader(templateTable);
 		reader->validateMessage(buffer, builtSize, LLHost());
 		reader->readMessage(buffer, LLHost());
 		reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outValue);
@@ -951,9 +952,9 @@ namespace tut
 											 MBT_SINGLE));
 
 		// read message value and default string
-		numberMap[1] = &messageTemplate;
+		templateTable.add(&messageTemplate);
 		LLTemplateMessageReader* reader = 
-			new LLTemplateMessageReader(numberMap);
+			new LLTemplateMessageReader(templateTable);
 		reader->validateMessage(buffer, builtSize, LLHost());
 		reader->readMessage(buffer, LLHost());
 		reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outValue);